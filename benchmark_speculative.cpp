@@ -0,0 +1,224 @@
+#include "bolt/ai/direct_gguf_inference.hpp"
+#include "bolt/ai/speculative_decoder.hpp"
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace bolt::ai;
+
+void printUsage(const char* programName) {
+    std::cout << "Usage: " << programName << " [options]\n\n";
+    std::cout << "Compares tokens/sec of speculative decoding against plain decoding.\n";
+    std::cout << "With --model and --draft it runs the GGUF models; otherwise it runs\n";
+    std::cout << "simulated models whose passes cost a fixed time, as memory-bound decoding does.\n\n";
+    std::cout << "Options:\n";
+    std::cout << "  --help, -h                Show this help message\n";
+    std::cout << "  --model <file>            Main GGUF model\n";
+    std::cout << "  --draft <file>            Draft GGUF model sharing the main model's vocabulary\n";
+    std::cout << "  --prompt <text>           Code to complete (default: a C++ function header)\n";
+    std::cout << "  --tokens <n>              Tokens to generate per run (default: 128)\n";
+    std::cout << "  --draft-tokens <list>     Comma-separated proposal counts (default: 2,4,8)\n";
+    std::cout << "  --target-ms <ms>          Simulated main model pass (default: 20)\n";
+    std::cout << "  --draft-ms <ms>           Simulated draft model pass (default: 2)\n";
+    std::cout << "  --agreement <0..1>        Simulated share of draft tokens the main model accepts (default: 0.8)\n";
+    std::cout << "\nExamples:\n";
+    std::cout << "  " << programName << " --model codellama-7b.Q4_K_M.gguf --draft tinyllama-1.1b.Q4_K_M.gguf\n";
+    std::cout << "  " << programName << " --agreement 0.6 --draft-tokens 1,2,3,4,6\n";
+    std::cout << "\n";
+}
+
+struct RunResult {
+    size_t draft_tokens = 0;
+    size_t tokens = 0;
+    double seconds = 0.0;
+    SpeculativeStats stats;
+};
+
+void printResults(const std::vector<RunResult>& results) {
+    double baseline = results.empty() || results[0].seconds <= 0.0 ? 0.0 : results[0].tokens / results[0].seconds;
+    std::cout << "\n" << std::left << std::setw(14) << "Draft tokens"
+              << std::setw(12) << "Tokens"
+              << std::setw(14) << "Tokens/sec"
+              << std::setw(10) << "Speedup"
+              << std::setw(14) << "Acceptance"
+              << "Tokens/pass\n";
+    std::cout << std::string(74, '-') << "\n";
+    for (const auto& result : results) {
+        double rate = result.seconds > 0.0 ? result.tokens / result.seconds : 0.0;
+        std::cout << std::left << std::setw(14) << (result.draft_tokens ? std::to_string(result.draft_tokens) : "plain")
+                  << std::setw(12) << result.tokens
+                  << std::setw(14) << std::fixed << std::setprecision(1) << rate
+                  << std::setw(10) << std::setprecision(2) << (baseline > 0.0 ? rate / baseline : 0.0)
+                  << std::setw(14) << std::setprecision(1) << result.stats.acceptance_rate() * 100.0f
+                  << std::setprecision(2) << result.stats.tokens_per_round() << "\n";
+    }
+    std::cout << "\n";
+}
+
+// Predicts a fixed pseudo-random sequence; a draft instance disagrees with
+// it on a hash-chosen share of positions. Each pass sleeps a fixed time.
+class SimulatedModel : public SpeculativeModel {
+public:
+    SimulatedModel(std::chrono::microseconds pass_cost, double disagreement)
+        : pass_cost_(pass_cost), disagreement_(disagreement) {}
+
+    size_t n_vocab() const override { return VOCAB; }
+    size_t length() const override { return sequence_.size(); }
+
+    bool decode(const int32_t* tokens, size_t count, size_t logits_from) override {
+        std::this_thread::sleep_for(pass_cost_);
+        rows_.resize(count - logits_from);
+        for (size_t i = 0; i < count; ++i) {
+            sequence_.push_back(tokens[i]);
+            if (i >= logits_from) {
+                auto& row = rows_[i - logits_from];
+                row.assign(VOCAB, 0.0f);
+                row[next(sequence_.size())] = 10.0f;
+            }
+        }
+        return true;
+    }
+
+    float* logits(size_t i) override { return rows_[i].data(); }
+    void truncate(size_t length) override { sequence_.resize(std::min(length, sequence_.size())); }
+
+private:
+    static constexpr size_t VOCAB = 256;
+    std::chrono::microseconds pass_cost_;
+    double disagreement_;
+    std::vector<int32_t> sequence_;
+    std::vector<std::vector<float>> rows_;
+
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    int32_t next(size_t position) const {
+        uint64_t h = mix(position);
+        bool wrong = static_cast<double>(mix(h) % 10000) / 10000.0 < disagreement_;
+        return static_cast<int32_t>((h + (wrong ? 1 : 0)) % VOCAB);
+    }
+};
+
+RunResult runSimulated(size_t draft_tokens, size_t tokens, int target_ms, int draft_ms, double agreement) {
+    SimulatedModel target(std::chrono::milliseconds(target_ms), 0.0);
+    SimulatedModel draft(std::chrono::milliseconds(draft_ms), 1.0 - agreement);
+    SamplerParams params;
+    params.temperature = 0.0f;
+    params.repeat_penalty = 1.0f;
+    TokenSampler sampler(params);
+    SpeculativeDecoder decoder(target, draft, sampler, draft_tokens);
+
+    std::vector<int32_t> sequence{1, 2, 3, 4};
+    auto start = std::chrono::steady_clock::now();
+    RunResult result;
+    result.draft_tokens = draft_tokens;
+    result.tokens = decoder.generate(sequence, tokens, -1, nullptr);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.stats = decoder.stats();
+    return result;
+}
+
+RunResult runModel(DirectGGUFInference& inference, size_t draft_tokens, const std::string& prompt, size_t tokens) {
+    inference.set_draft_tokens(static_cast<int>(draft_tokens));
+    SpeculativeStats before = inference.speculative_stats();
+
+    RunResult result;
+    result.draft_tokens = draft_tokens;
+    auto start = std::chrono::steady_clock::now();
+    inference.generate_text_stream(prompt, static_cast<int>(tokens), 0.0f, [&](const std::string&) {
+        ++result.tokens;
+        return true;
+    });
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const SpeculativeStats& after = inference.speculative_stats();
+    result.stats.rounds = after.rounds - before.rounds;
+    result.stats.drafted = after.drafted - before.drafted;
+    result.stats.accepted = after.accepted - before.accepted;
+    result.stats.generated = after.generated - before.generated;
+    return result;
+}
+
+std::vector<size_t> parseList(const std::string& text) {
+    std::vector<size_t> values;
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = text.find(',', begin);
+        end = end == std::string::npos ? text.size() : end;
+        values.push_back(std::stoul(text.substr(begin, end - begin)));
+        begin = end + 1;
+    }
+    return values;
+}
+
+int main(int argc, char* argv[]) {
+    std::string model_path;
+    std::string draft_path;
+    std::string prompt = "// Return the n-th Fibonacci number\nint fibonacci(int n) {\n";
+    size_t tokens = 128;
+    std::vector<size_t> draft_counts{2, 4, 8};
+    int target_ms = 20;
+    int draft_ms = 2;
+    double agreement = 0.8;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg == "--model" && i + 1 < argc) {
+            model_path = argv[++i];
+        } else if (arg == "--draft" && i + 1 < argc) {
+            draft_path = argv[++i];
+        } else if (arg == "--prompt" && i + 1 < argc) {
+            prompt = argv[++i];
+        } else if (arg == "--tokens" && i + 1 < argc) {
+            tokens = std::stoul(argv[++i]);
+        } else if (arg == "--draft-tokens" && i + 1 < argc) {
+            draft_counts = parseList(argv[++i]);
+        } else if (arg == "--target-ms" && i + 1 < argc) {
+            target_ms = std::stoi(argv[++i]);
+        } else if (arg == "--draft-ms" && i + 1 < argc) {
+            draft_ms = std::stoi(argv[++i]);
+        } else if (arg == "--agreement" && i + 1 < argc) {
+            agreement = std::stod(argv[++i]);
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<RunResult> results;
+    if (!model_path.empty() && !draft_path.empty()) {
+        DirectGGUFInference inference;
+        if (!inference.load_model(model_path) || !inference.load_draft_model(draft_path)) {
+            std::cerr << "Could not load the models for speculative decoding\n";
+            return 1;
+        }
+        std::cout << "Main model: " << model_path << "\nDraft model: " << draft_path << "\n";
+        runModel(inference, 0, prompt, 8);  // Warm-up
+        results.push_back(runModel(inference, 0, prompt, tokens));
+        for (size_t count : draft_counts) {
+            results.push_back(runModel(inference, count, prompt, tokens));
+        }
+    } else {
+        std::cout << "Simulated models: main pass " << target_ms << " ms, draft pass " << draft_ms
+                  << " ms, agreement " << agreement * 100.0 << "%\n";
+        results.push_back(runSimulated(0, tokens, target_ms, draft_ms, agreement));
+        for (size_t count : draft_counts) {
+            results.push_back(runSimulated(count, tokens, target_ms, draft_ms, agreement));
+        }
+    }
+
+    printResults(results);
+    return 0;
+}
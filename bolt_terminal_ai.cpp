@@ -2,8 +2,22 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
 #include <unistd.h>  // For isatty
 
+// Reply being generated; Ctrl-C cancels it instead of quitting
+static std::atomic<const bolt::ai::CancellationToken*> g_active_reply{nullptr};
+
+static void handle_interrupt(int) {
+    if (const bolt::ai::CancellationToken* reply = g_active_reply.load()) {
+        reply->cancel();
+    } else {
+        std::_Exit(130);
+    }
+}
+
 class BoltTerminalAI {
 private:
     std::unique_ptr<bolt::ai::EnhancedAIManager> ai_manager_;
@@ -43,7 +57,8 @@ public:
             std::cout << "  /history - Show chat history\n";
             std::cout << "  /clear   - Clear chat history\n";
             std::cout << "  /load    - Try to load a GGUF model\n";
-            std::cout << "  /quit    - Exit the application\n\n";
+            std::cout << "  /quit    - Exit the application\n";
+            std::cout << "  Ctrl-C   - Stop the reply being generated\n\n";
             
             std::cout << "💬 Start chatting (type your message and press Enter):\n\n";
         }
@@ -90,12 +105,18 @@ public:
                 else break;
             }
             
-            // Send to AI
-            std::cout << "AI:  ";
-            auto response = ai_manager_->chat(input, session_id_);
+            // Send to AI, printing the reply as it is generated
+            std::cout << "AI:  " << std::flush;
+            bolt::ai::CancellationToken cancel;
+            g_active_reply = &cancel;
+            auto response = ai_manager_->chat_stream(input, session_id_, [](const std::string& piece) {
+                std::cout << piece << std::flush;
+                return true;
+            }, cancel);
+            g_active_reply = nullptr;
             
             if (response.success) {
-                std::cout << response.response << "\n";
+                std::cout << "\n";
                 if (response.inference_time_ms > 0) {
                     std::cout << "     ⏱️ " << response.inference_time_ms << "ms";
                     if (response.tokens_generated > 0) {
@@ -103,6 +124,8 @@ public:
                     }
                     std::cout << "\n";
                 }
+            } else if (response.error == bolt::ai::CANCELLED_ERROR) {
+                std::cout << "\n     ⏹️ Stopped\n";
             } else {
                 std::cout << "❌ Error: " << response.error << "\n";
             }
@@ -147,6 +170,7 @@ private:
 };
 
 int main() {
+    std::signal(SIGINT, handle_interrupt);
     try {
         BoltTerminalAI app;
         app.chat_loop();
@@ -0,0 +1,181 @@
+#include "bolt/collaboration/load_generator.hpp"
+#include "bolt/collaboration/collaboration_protocol.hpp"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace bolt::collaboration;
+
+void printUsage(const char* programName) {
+    std::cout << "Usage: " << programName << " [options]\n\n";
+    std::cout << "Runs simulated editors against a collaboration server and reports throughput,\n";
+    std::cout << "latency percentiles, server CPU and memory per client, and convergence.\n\n";
+    std::cout << "Options:\n";
+    std::cout << "  --help, -h                Show this help message\n";
+    std::cout << "  --clients <n>             Simulated clients (default: 100)\n";
+    std::cout << "  --per-document <n>        Clients editing each document (default: 10)\n";
+    std::cout << "  --per-line <n>            Clients sharing each line of a document (default: 2)\n";
+    std::cout << "  --duration <s>            Seconds of typing (default: 10)\n";
+    std::cout << "  --key-interval <ms>       Median time between keystrokes (default: 180)\n";
+    std::cout << "  --threads <n>             Client event loops (default: 4)\n";
+    std::cout << "  --connect-rate <n>        New connections per second (default: 1000)\n";
+    std::cout << "  --tick <ms>               Server tick interval for a spawned server (default: 5)\n";
+    std::cout << "  --port <n>                Port for the spawned server (default: 18081)\n";
+    std::cout << "  --connect <host:port>     Use a running server instead of spawning one\n";
+    std::cout << "  --server-pid <pid>        Sample CPU and memory of a running server\n";
+    std::cout << "  --seed <n>                Random seed (default: 1)\n";
+    std::cout << "  --output-json <file>      Write the report as JSON\n";
+    std::cout << "\nExamples:\n";
+    std::cout << "  " << programName << " --clients 2000 --per-document 20 --duration 60\n";
+    std::cout << "  " << programName << " --connect 127.0.0.1:8081 --server-pid 4242 --output-json load.json\n";
+    std::cout << "\n";
+}
+
+// Every client and every server connection needs a descriptor
+void raiseDescriptorLimit() {
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+// Runs the server in a child process so its CPU and memory can be sampled
+// apart from the clients. Returns the child's pid, or -1 if it did not start.
+// The child exits when the parent closes the control pipe.
+pid_t spawnServer(int port, int tickMs, int& controlFd) {
+    int ready[2], control[2];
+    if (pipe(ready) != 0 || pipe(control) != 0) {
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(ready[0]);
+        close(control[1]);
+        char status = 'R';
+        try {
+            auto& protocol = CollaborationProtocol::getInstance();
+            protocol.setTickInterval(std::chrono::milliseconds(tickMs));
+            protocol.initialize(port);
+        } catch (const std::exception& e) {
+            std::cerr << "Server failed to start: " << e.what() << std::endl;
+            status = 'E';
+        }
+        if (write(ready[1], &status, 1) != 1 || status != 'R') {
+            _exit(1);
+        }
+        char byte;
+        while (read(control[0], &byte, 1) > 0) {
+        }
+        _exit(0);
+    }
+
+    close(ready[1]);
+    close(control[0]);
+    char status = 'E';
+    if (pid < 0 || read(ready[0], &status, 1) != 1 || status != 'R') {
+        close(ready[0]);
+        close(control[1]);
+        if (pid > 0) {
+            waitpid(pid, nullptr, 0);
+        }
+        return -1;
+    }
+    close(ready[0]);
+    controlFd = control[1];
+    return pid;
+}
+
+int main(int argc, char* argv[]) {
+    LoadTestConfig config;
+    config.port = 18081;
+    std::string jsonOutput;
+    bool spawn = true;
+    int tickMs = 5;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg == "--clients" && hasValue) {
+            config.clients = std::stoul(argv[++i]);
+        } else if (arg == "--per-document" && hasValue) {
+            config.clientsPerDocument = std::stoul(argv[++i]);
+        } else if (arg == "--per-line" && hasValue) {
+            config.typistsPerLine = std::stoul(argv[++i]);
+        } else if (arg == "--duration" && hasValue) {
+            config.duration = std::chrono::milliseconds(static_cast<int64_t>(std::stod(argv[++i]) * 1000));
+        } else if (arg == "--key-interval" && hasValue) {
+            config.medianKeyInterval = std::chrono::milliseconds(std::stoi(argv[++i]));
+        } else if (arg == "--threads" && hasValue) {
+            config.threads = std::stoul(argv[++i]);
+        } else if (arg == "--connect-rate" && hasValue) {
+            config.connectRate = std::stoul(argv[++i]);
+        } else if (arg == "--tick" && hasValue) {
+            tickMs = std::stoi(argv[++i]);
+        } else if (arg == "--port" && hasValue) {
+            config.port = std::stoi(argv[++i]);
+        } else if (arg == "--connect" && hasValue) {
+            std::string target = argv[++i];
+            auto colon = target.rfind(':');
+            if (colon == std::string::npos) {
+                std::cerr << "Expected host:port, got " << target << std::endl;
+                return 1;
+            }
+            config.host = target.substr(0, colon);
+            config.port = std::stoi(target.substr(colon + 1));
+            spawn = false;
+        } else if (arg == "--server-pid" && hasValue) {
+            config.serverPid = std::stoi(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            config.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--output-json" && hasValue) {
+            jsonOutput = argv[++i];
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    raiseDescriptorLimit();
+
+    // Fork before the generator starts any threads
+    int controlFd = -1;
+    pid_t serverPid = -1;
+    if (spawn) {
+        serverPid = spawnServer(config.port, tickMs, controlFd);
+        if (serverPid < 0) {
+            std::cerr << "Could not start a server on port " << config.port << std::endl;
+            return 1;
+        }
+        config.serverPid = serverPid;
+    }
+
+    std::cout << "Collaboration Load Test\n";
+    std::cout << "=======================\n\n";
+    std::cout << "Running " << config.clients << " clients against " << config.host << ":" << config.port
+              << " for " << config.duration.count() / 1000.0 << " s...\n\n";
+
+    LoadGenerator generator(config);
+    LoadTestReport report = generator.run();
+
+    if (spawn) {
+        close(controlFd);
+        waitpid(serverPid, nullptr, 0);
+    }
+
+    report.print(std::cout);
+    if (!jsonOutput.empty()) {
+        std::ofstream out(jsonOutput);
+        out << report.toJson() << "\n";
+    }
+    return report.converged() ? 0 : 1;
+}
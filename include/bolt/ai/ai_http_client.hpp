@@ -3,6 +3,7 @@
 #include <map>
 #include <memory>
 #include "bolt/drawkern/ai_integration.hpp"
+#include "bolt/ai/ai_stream.hpp"
 
 namespace bolt {
 namespace ai {
@@ -32,7 +33,16 @@ struct AIHttpConfig {
     // Connection settings
     int timeout_seconds = 30;
     bool verify_ssl = true;
-    bool use_streaming = false;
+    bool use_streaming = false;  // Ask for server-sent events in chat_stream
+    
+    // Speculative decoding when generating with a local GGUF model; off
+    // while no draft model is set
+    std::string draft_model_path;
+    int draft_tokens = 4;
+    
+    // Sequence slots for continuous batching over a local GGUF model, so
+    // concurrent requests share decode steps; 0 runs them one at a time
+    int inference_slots = 0;
     
     // Retry settings
     int max_retries = 3;
@@ -57,6 +67,14 @@ public:
     drawkern::AIInferenceResponse chat(const std::string& message, const std::string& session_id);
     drawkern::AIInferenceResponse complete_code(const std::string& code, const std::string& language);
     
+    // Chat with the reply delivered piece by piece. With use_streaming the
+    // server streams events and each delta reaches on_token on arrival;
+    // otherwise the whole reply arrives as one piece. Cancelling aborts
+    // the transfer and the response reports CANCELLED_ERROR.
+    drawkern::AIInferenceResponse chat_stream(const std::string& message, const std::string& session_id,
+                                              const TokenCallback& on_token,
+                                              const CancellationToken& cancel = CancellationToken());
+    
     // Configuration and testing
     bool test_connection();
     void update_config(const AIHttpConfig& config);
@@ -68,7 +86,9 @@ private:
     
     // HTTP operations
     bolt::drawkern::AIInferenceResponse send_request(const HttpRequest& request);
-    HttpRequest create_chat_request(const std::string& message, const std::string& session_id);
+    bolt::drawkern::AIInferenceResponse send_streaming_request(const HttpRequest& request, const TokenCallback& on_token,
+                                                               const CancellationToken& cancel);
+    HttpRequest create_chat_request(const std::string& message, const std::string& session_id, bool stream = false);
     HttpRequest create_completion_request(const std::string& code, const std::string& language);
     bolt::drawkern::AIInferenceResponse parse_response(const std::string& response_data, APIType api_type);
 };
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace bolt {
+namespace ai {
+
+// AIInferenceResponse::error of a request that was cancelled
+inline constexpr const char* CANCELLED_ERROR = "Cancelled";
+
+// Receives each piece of generated text as soon as it is available;
+// returning false cancels the rest of the request
+using TokenCallback = std::function<bool(const std::string& piece)>;
+
+// Cooperative cancellation shared between a request and whoever may
+// abandon it. Copies refer to the same flag; generation checks it between
+// decode steps and received chunks. cancel() is safe from signal handlers.
+class CancellationToken {
+public:
+    CancellationToken() : cancelled_(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() const { cancelled_->store(true, std::memory_order_relaxed); }
+    bool is_cancelled() const { return cancelled_->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+// Incremental parser for text/event-stream bodies. Bytes may arrive split
+// anywhere; an event's data lines are joined with newlines and handed out
+// when the blank line ending the event arrives.
+class SSEParser {
+public:
+    using EventHandler = std::function<bool(const std::string& data)>;
+
+    // False once the handler returned false; the rest of the input is dropped
+    bool feed(std::string_view bytes, const EventHandler& on_event);
+    void reset();
+
+private:
+    std::string line_;   // Incomplete line carried to the next chunk
+    std::string data_;   // Data of the event being read
+    bool has_data_ = false;
+
+    bool dispatch_line(std::string_view line, const EventHandler& on_event);
+};
+
+} // namespace ai
+} // namespace bolt
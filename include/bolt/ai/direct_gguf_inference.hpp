@@ -3,12 +3,50 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
 #include "../drawkern/ai_integration.hpp"
+#include "ai_stream.hpp"
+#include "token_sampler.hpp"
+#include "speculative_decoder.hpp"
+#include "inference_engine.hpp"
 
 namespace bolt {
 namespace ai {
 
-// Direct GGUF file loader and inference engine
+// Tokens whose keys and values are held in an inference context. A new
+// prompt keeps the longest common prefix with them and only the rest
+// has to be decoded; everything past that prefix is evicted.
+class KVPrefixCache {
+public:
+    // Truncate to what `tokens` can reuse and return its length. At least
+    // the last token is left to decode, since sampling needs its logits.
+    size_t reuse(const std::vector<int32_t>& tokens);
+    
+    // Record tokens just decoded at the end of the sequence
+    void append(const int32_t* tokens, size_t count);
+    void append(int32_t token) { append(&token, 1); }
+    void clear() { tokens_.clear(); }
+    void truncate(size_t length) { tokens_.resize(std::min(length, tokens_.size())); }
+    
+    const std::vector<int32_t>& tokens() const { return tokens_; }
+    size_t size() const { return tokens_.size(); }
+    
+    // Totals over all prompts: positions kept from the cache and decoded
+    size_t reused_tokens() const { return reused_tokens_; }
+    size_t decoded_tokens() const { return decoded_tokens_; }
+    
+private:
+    std::vector<int32_t> tokens_;
+    size_t reused_tokens_ = 0;
+    size_t decoded_tokens_ = 0;
+};
+
+// Direct GGUF file loader and inference engine. The context's KV cache is
+// kept between calls, so a prompt that extends the previous one (the next
+// chat turn) only decodes its new suffix. Chat sessions each own a cache;
+// switching sessions saves the active one to disk and restores the other.
 class DirectGGUFInference {
 public:
     DirectGGUFInference();
@@ -24,12 +62,72 @@ public:
         float temperature = 0.7f
     );
     
-    // Chat-specific inference with conversation context
+    // Chat-specific inference with conversation context, in the given
+    // session's KV cache when there is one
     drawkern::AIInferenceResponse chat(
         const std::string& message,
-        const std::vector<std::string>& conversation_history = {}
+        const std::vector<std::string>& conversation_history = {},
+        const std::string& session_id = ""
     );
     
+    // Streaming variants: each piece of text goes to on_token as soon as
+    // it is decoded. A cancel is noticed between decode steps, including
+    // during prompt prefill; the response then reports CANCELLED_ERROR.
+    drawkern::AIInferenceResponse generate_text_stream(
+        const std::string& prompt,
+        int max_tokens,
+        float temperature,
+        const TokenCallback& on_token,
+        const CancellationToken& cancel = CancellationToken()
+    );
+    drawkern::AIInferenceResponse chat_stream(
+        const std::string& message,
+        const std::vector<std::string>& conversation_history,
+        const std::string& session_id,
+        const TokenCallback& on_token,
+        const CancellationToken& cancel = CancellationToken(),
+        RequestPriority priority = RequestPriority::Normal
+    );
+    
+    // Code completion continuing `code`, sampled under BalancedCodeGrammar
+    // so it never closes a bracket the code did not open
+    drawkern::AIInferenceResponse complete_code(const std::string& code, int max_tokens = 128);
+    
+    // Sampling for local generation; the temperature a call passes
+    // overrides the one set here
+    void set_sampler_params(const SamplerParams& params) { sampler_params_ = params; }
+    const SamplerParams& sampler_params() const { return sampler_params_; }
+    
+    // Speculative decoding: a small draft model sharing this model's
+    // vocabulary proposes draft_tokens tokens, which the model checks in
+    // one pass. Used whenever a draft is loaded and draft_tokens is not 0.
+    bool load_draft_model(const std::string& model_path);
+    void unload_draft_model();
+    bool has_draft_model() const;
+    void set_draft_tokens(int draft_tokens);
+    int draft_tokens() const { return draft_tokens_; }
+    const SpeculativeStats& speculative_stats() const { return speculative_stats_; }
+    
+    // Continuous batching: requests run as sequences in an engine over a
+    // second context with one KV region per slot, so concurrent callers
+    // share decode steps instead of waiting for each other. Chat sessions
+    // then live in the slots rather than on disk, and no draft is used.
+    // Models built on engine() must be dropped before this one reloads.
+    bool enable_engine(const EngineConfig& config = EngineConfig());
+    void disable_engine();
+    std::shared_ptr<InferenceEngine> engine() const { return engine_; }
+    
+    // Session KV caches. Switching saves the active session's cache to the
+    // session directory and restores the new session's saved one, if any;
+    // false when that restore failed and the session starts cold.
+    bool switch_session(const std::string& session_id);
+    void drop_session(const std::string& session_id);  // Also deletes its saved cache
+    const std::string& active_session() const;
+    void set_session_directory(const std::string& directory);
+    std::string session_cache_path(const std::string& session_id) const;
+    
+    const KVPrefixCache& kv_cache() const;
+    
     // Check if model is loaded
     bool is_loaded() const { return model_loaded_; }
     
@@ -44,11 +142,25 @@ private:
     std::unique_ptr<ModelData> model_data_;
     bool model_loaded_;
     std::string model_path_;
+    std::string session_directory_;
+    SamplerParams sampler_params_;
+    std::unique_ptr<ModelData> draft_data_;
+    int draft_tokens_ = 4;
+    SpeculativeStats speculative_stats_;
+    std::shared_ptr<InferenceEngine> engine_;
+    
+    drawkern::AIInferenceResponse generate_response(const std::string& prompt, int max_tokens, float temperature,
+                                                    const TokenCallback& on_token, const CancellationToken& cancel,
+                                                    const std::shared_ptr<SamplingGrammar>& grammar,
+                                                    RequestPriority priority);
     
-    // Internal text generation
-    std::string generate_internal(const std::string& prompt, int max_tokens, float temperature);
+    // Internal text generation; `cancelled` is set when generation stopped early
+    std::string generate_internal(const std::string& prompt, int max_tokens, float temperature,
+                                  const TokenCallback& on_token, const CancellationToken& cancel,
+                                  SamplingGrammar* grammar, bool& cancelled);
     
-    // Conversation formatting
+    // Conversation formatting. The history window starts on a multiple of
+    // its size, so consecutive turns share their prompt prefix.
     std::string format_chat_prompt(const std::string& message, const std::vector<std::string>& history);
     
     // Smart fallback responses
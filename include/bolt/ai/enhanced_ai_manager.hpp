@@ -5,6 +5,7 @@
 #include <memory>
 #include <string>
 #include <map>
+#include <mutex>
 #include <vector>
 
 namespace bolt {
@@ -41,6 +42,13 @@ public:
     bolt::drawkern::AIInferenceResponse complete_code(const std::string& code, const std::string& language = "cpp");
     bolt::drawkern::AIInferenceResponse analyze_code(const std::string& code, const std::string& language = "cpp");
     
+    // Chat with the reply handed to on_token piece by piece as the provider
+    // produces it. Cancelling stops generation at the next decode step or
+    // received chunk; the reply is then left out of the session history.
+    bolt::drawkern::AIInferenceResponse chat_stream(const std::string& message, const std::string& session_id,
+                                                    const TokenCallback& on_token,
+                                                    const CancellationToken& cancel = CancellationToken());
+    
     // Provider management
     bool switch_provider(const std::string& provider_name);
     bool test_connection();
@@ -83,12 +91,18 @@ private:
     std::unique_ptr<DirectGGUFInference> direct_inference_;
     std::map<std::string, std::vector<std::string>> session_history_;
     AIStats stats_;
+    mutable std::mutex mutex_;  // Guards session_history_ and stats_; requests may run concurrently
     std::string current_provider_;
     bool use_direct_inference_ = false;
     bool use_rwkv_direct_ = false;
     std::string rwkv_model_path_;
     
     bool initialize_active_provider();
+    // A local model with the batching engine serves higher priorities first
+    bolt::drawkern::AIInferenceResponse chat_with_priority(const std::string& message, const std::string& session_id,
+                                                           const TokenCallback& on_token,
+                                                           const CancellationToken& cancel, RequestPriority priority);
+    void apply_local_config(const AIHttpConfig& config);  // Sampling, draft model and batching for direct inference
     void update_stats(const bolt::drawkern::AIInferenceResponse& response);
 };
 
@@ -0,0 +1,157 @@
+#pragma once
+#include "ai_stream.hpp"
+#include "token_sampler.hpp"
+#include "../drawkern/ai_integration.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bolt {
+namespace ai {
+
+// Higher runs first: inline completion ahead of chat ahead of analysis
+enum class RequestPriority {
+    Background = 0,
+    Normal = 1,
+    Interactive = 2
+};
+
+// A model that decodes tokens from several sequences in one pass. Each
+// sequence slot owns a region of the KV cache addressed by its slot id.
+class BatchedModel {
+public:
+    struct Entry {
+        int32_t token;
+        int32_t position;
+        int32_t slot;
+        bool logits;
+    };
+
+    virtual ~BatchedModel() = default;
+
+    virtual size_t n_vocab() const = 0;
+    virtual size_t max_batch() const = 0;     // Entries per decode
+    virtual size_t slot_context() const = 0;  // Positions each slot holds
+    virtual int32_t eos() const = 0;
+
+    virtual std::vector<int32_t> tokenize(const std::string& text) = 0;
+    virtual std::string token_text(int32_t token) = 0;
+
+    virtual bool decode(const std::vector<Entry>& batch) = 0;
+    virtual float* logits(size_t i) = 0;  // After entry i of the last decode
+    virtual void evict(int32_t slot, size_t from) = 0;  // Drop the slot's positions from `from` on
+};
+
+struct EngineRequest {
+    std::string prompt;
+    int max_tokens = 128;
+    SamplerParams sampling;
+    RequestPriority priority = RequestPriority::Normal;
+    std::shared_ptr<SamplingGrammar> grammar;
+    TokenCallback on_token;  // Called on the engine thread
+    CancellationToken cancel;
+};
+
+struct EngineConfig {
+    size_t slots = 4;
+    size_t slot_context = 2048;
+    size_t prefill_chunk = 32;  // Prompt tokens per sequence per step
+    std::chrono::milliseconds aging{2000};  // Queued requests gain a priority level per interval
+};
+
+struct EngineStats {
+    size_t steps = 0;
+    size_t batch_entries = 0;
+    size_t completed = 0;         // Answered, including failures
+    size_t preempted = 0;
+    size_t prompt_tokens = 0;     // Prefilled after prefix reuse
+    size_t reused_tokens = 0;     // Found already in a slot's cache
+    size_t generated_tokens = 0;
+    size_t queued = 0;
+    size_t running = 0;
+
+    float average_batch() const { return steps ? static_cast<float>(batch_entries) / steps : 0.0f; }
+};
+
+// Continuous-batching inference over one model. Requests become sequences
+// in slots and advance together: every step decodes one token for each
+// generating sequence plus prompt chunks of new ones, so a request joins
+// the running batch as soon as a slot is free. A slot keeps its tokens
+// after a request ends, and a new request goes to the free slot sharing
+// the longest prefix with it. Higher priorities are admitted first and may
+// preempt lower ones when every slot is busy; a preempted sequence waits
+// in the queue and resumes from whatever its slot still holds.
+class InferenceEngine {
+public:
+    explicit InferenceEngine(std::unique_ptr<BatchedModel> model, const EngineConfig& config = EngineConfig());
+    ~InferenceEngine();  // Fails whatever has not finished
+
+    InferenceEngine(const InferenceEngine&) = delete;
+    InferenceEngine& operator=(const InferenceEngine&) = delete;
+
+    std::future<drawkern::AIInferenceResponse> submit(EngineRequest request);
+
+    EngineStats stats() const;
+    size_t slots() const;
+
+private:
+    struct Sequence;
+    struct Slot;
+
+    std::unique_ptr<BatchedModel> model_;
+    EngineConfig config_;
+    std::vector<Slot> slots_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::deque<std::unique_ptr<Sequence>> queue_;
+    size_t running_ = 0;
+    uint64_t next_order_ = 0;
+    bool stopping_ = false;
+    EngineStats stats_;
+    std::thread worker_;
+
+    void run();
+    void admit();
+    bool step();
+    void finish(Slot& slot, bool success, const std::string& error);
+    void complete(std::unique_ptr<Sequence> sequence, bool success, const std::string& error);
+    int effective_priority(const Sequence& sequence, std::chrono::steady_clock::time_point now) const;
+};
+
+// DrawKern model over an engine, so VM requests batched by
+// DrawKernAIManager share its decode steps. Task types map to priorities:
+// "completion" is interactive and "analysis" runs in the background.
+class EngineAIModel : public drawkern::AIModel {
+public:
+    EngineAIModel(std::shared_ptr<InferenceEngine> engine, const drawkern::AIModelConfig& config);
+
+    bool load() override;
+    void unload() override;
+    bool is_loaded() const override { return loaded_; }
+
+    drawkern::AIInferenceResponse generate(const drawkern::AIInferenceRequest& request) override;
+    drawkern::AIInferenceResponse chat(const std::string& message, const std::string& context = "") override;
+    drawkern::AIInferenceResponse complete_code(const std::string& code, const std::string& language = "cpp") override;
+    std::vector<drawkern::AIInferenceResponse> generate_batch(
+        const std::vector<drawkern::AIInferenceRequest>& requests) override;
+
+    std::string get_model_info() const override;
+    std::vector<std::string> get_capabilities() const override;
+
+private:
+    std::shared_ptr<InferenceEngine> engine_;
+
+    std::future<drawkern::AIInferenceResponse> start(const drawkern::AIInferenceRequest& request);
+};
+
+} // namespace ai
+} // namespace bolt
@@ -0,0 +1,75 @@
+#pragma once
+#include "token_sampler.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace bolt {
+namespace ai {
+
+// A model the speculative loop drives: a sequence of decoded tokens that
+// can be extended in batches and cut back
+class SpeculativeModel {
+public:
+    virtual ~SpeculativeModel() = default;
+
+    virtual size_t n_vocab() const = 0;
+    virtual size_t length() const = 0;
+
+    // Append tokens to the sequence. Logits are kept for the tokens from
+    // index logits_from on; false when the model could not take them.
+    virtual bool decode(const int32_t* tokens, size_t count, size_t logits_from) = 0;
+
+    // Logits after token logits_from + i of the last decode
+    virtual float* logits(size_t i) = 0;
+
+    // Forget everything past the first `length` tokens
+    virtual void truncate(size_t length) = 0;
+};
+
+struct SpeculativeStats {
+    size_t rounds = 0;       // Target passes
+    size_t drafted = 0;      // Tokens the draft proposed
+    size_t accepted = 0;     // Proposals the target agreed with
+    size_t generated = 0;
+
+    float acceptance_rate() const { return drafted ? static_cast<float>(accepted) / drafted : 0.0f; }
+    float tokens_per_round() const { return rounds ? static_cast<float>(generated) / rounds : 0.0f; }
+};
+
+// Speculative decoding: the draft model greedily proposes a few tokens, the
+// target decodes them all in one pass, and its sampler checks each in turn.
+// Matching proposals are kept, and the first mismatch is replaced by the
+// target's own token. Every emitted token is sampled from the target, so
+// output follows the target's distribution exactly. The draft only decides
+// how many tokens a single target pass can produce.
+class SpeculativeDecoder {
+public:
+    // Receives each generated token; returning false stops generation
+    using TokenHandler = std::function<bool(int32_t token)>;
+
+    SpeculativeDecoder(SpeculativeModel& target, SpeculativeModel& draft, TokenSampler& sampler,
+                       size_t draft_tokens);
+
+    // Extend `tokens` by up to max_tokens, stopping before eos. Either model
+    // may already hold a prefix of `tokens`, but not all of it: the last
+    // token is decoded here. Returns the number of tokens added.
+    size_t generate(std::vector<int32_t>& tokens, size_t max_tokens, int32_t eos, const TokenHandler& on_token);
+
+    const SpeculativeStats& stats() const { return stats_; }
+
+private:
+    SpeculativeModel& target_;
+    SpeculativeModel& draft_;
+    TokenSampler& sampler_;
+    size_t draft_tokens_;
+    SpeculativeStats stats_;
+    std::vector<int32_t> proposals_;
+    std::vector<int32_t> batch_;
+
+    void propose(const std::vector<int32_t>& tokens, int32_t eos);
+};
+
+} // namespace ai
+} // namespace bolt
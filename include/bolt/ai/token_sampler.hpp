@@ -0,0 +1,114 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bolt {
+namespace ai {
+
+// Sampling settings for local generation; a value of 0 (1 for the
+// penalty) switches that stage off
+struct SamplerParams {
+    float temperature = 0.7f;      // <= 0 picks the most likely token
+    int top_k = 40;
+    float top_p = 0.9f;
+    float min_p = 0.05f;           // Relative to the most likely token
+    float repeat_penalty = 1.1f;
+    int repeat_last_n = 64;        // Tokens the penalty looks back over
+    uint32_t seed = 0;
+};
+
+// Restricts which pieces of text may be generated next. The sampler asks
+// about a candidate before choosing it and reports the piece it chose.
+class SamplingGrammar {
+public:
+    virtual ~SamplingGrammar() = default;
+    virtual bool allows(std::string_view piece) const = 0;
+    virtual void accept(std::string_view piece) = 0;
+};
+
+// Keeps code completions syntactically closed: a bracket may only be
+// closed by its partner, and not at all once the completion has closed
+// every bracket that was open. Brackets inside string and character
+// literals and comments are ignored.
+class BalancedCodeGrammar : public SamplingGrammar {
+public:
+    bool allows(std::string_view piece) const override;
+    void accept(std::string_view piece) override;
+
+    size_t depth() const { return state_.open.size(); }
+
+private:
+    struct State {
+        std::string open;          // Unclosed brackets, innermost last
+        char quote = 0;
+        bool escape = false;
+        bool line_comment = false;
+        bool block_comment = false;
+        char prev = 0;
+    };
+    State state_;
+
+    // False when c closes the wrong bracket; strict rejects that outright
+    static bool advance(State& state, char c, bool strict);
+};
+
+// Chooses the next token from a logits row. One sampler is reused across
+// tokens and its buffers across calls, so after warm-up a step does no
+// allocation and touches the whole vocabulary once: a single pass keeps
+// the top_k best logits, and softmax, min-p and top-p then run over those
+// survivors only.
+class TokenSampler {
+public:
+    // Text of a token, for grammar checks
+    using TokenText = std::function<std::string(int32_t token)>;
+
+    explicit TokenSampler(const SamplerParams& params = SamplerParams());
+
+    void set_params(const SamplerParams& params);
+    const SamplerParams& params() const { return params_; }
+
+    // Constrain sampling; nullptr removes the grammar. Not owned.
+    void set_grammar(SamplingGrammar* grammar, TokenText token_text);
+
+    // Pick a token and record it in the penalty window and the grammar.
+    // The repetition penalty is applied to `logits` in place. -1 when the
+    // grammar rejects every candidate.
+    int32_t sample(float* logits, size_t n_vocab);
+
+    // Count tokens the model has already seen, such as the prompt, toward
+    // the repetition penalty
+    void add_history(const int32_t* tokens, size_t count);
+    void reset();
+
+private:
+    struct Candidate {
+        int32_t id;
+        float logit;
+        float p;
+    };
+
+    SamplerParams params_;
+    std::mt19937 rng_;
+    std::vector<Candidate> candidates_;
+    std::vector<int32_t> history_;     // Ring of the last repeat_last_n tokens
+    size_t history_next_ = 0;
+    std::vector<int32_t> penalized_;
+    SamplingGrammar* grammar_ = nullptr;
+    TokenText token_text_;
+    std::string piece_;                // Text of the candidate last checked
+
+    bool allowed(int32_t token);
+    void remember(int32_t token);
+    void apply_penalty(float* logits, size_t n_vocab);
+    void select_top_k(const float* logits, size_t n_vocab);
+    size_t truncate();
+    int32_t choose(size_t count);
+};
+
+} // namespace ai
+} // namespace bolt
@@ -0,0 +1,118 @@
+#ifndef BINARY_ENCODING_HPP
+#define BINARY_ENCODING_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bolt {
+namespace collaboration {
+
+/**
+ * Append-only writer for compact binary payloads.
+ *
+ * Integers use unsigned LEB128 varints, so the small clocks, lengths and
+ * counts that dominate collaboration traffic take one or two bytes.
+ */
+class BinaryWriter {
+public:
+    void writeByte(uint8_t value) {
+        buffer_.push_back(value);
+    }
+
+    void writeVarUInt(uint64_t value) {
+        while (value >= 0x80) {
+            buffer_.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        buffer_.push_back(static_cast<uint8_t>(value));
+    }
+
+    void writeBytes(const void* data, size_t length) {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        buffer_.insert(buffer_.end(), bytes, bytes + length);
+    }
+
+    // Length-prefixed string
+    void writeString(const std::string& value) {
+        writeVarUInt(value.size());
+        writeBytes(value.data(), value.size());
+    }
+
+    void writeRaw(const std::string& value) {
+        writeBytes(value.data(), value.size());
+    }
+
+    size_t size() const { return buffer_.size(); }
+    const std::vector<uint8_t>& data() const { return buffer_; }
+    std::vector<uint8_t> release() { return std::move(buffer_); }
+
+    // WebSocket frames carry payloads as std::string
+    std::string toString() const { return std::string(buffer_.begin(), buffer_.end()); }
+
+private:
+    std::vector<uint8_t> buffer_;
+};
+
+/**
+ * Bounds-checked reader matching BinaryWriter. Every read returns false on
+ * truncated or malformed input instead of throwing, so untrusted payloads
+ * can be rejected cheaply.
+ */
+class BinaryReader {
+public:
+    BinaryReader(const uint8_t* data, size_t length) : data_(data), length_(length), offset_(0) {}
+    explicit BinaryReader(const std::vector<uint8_t>& data) : BinaryReader(data.data(), data.size()) {}
+    explicit BinaryReader(const std::string& data)
+        : BinaryReader(reinterpret_cast<const uint8_t*>(data.data()), data.size()) {}
+
+    bool readByte(uint8_t& value) {
+        if (offset_ >= length_) {
+            return false;
+        }
+        value = data_[offset_++];
+        return true;
+    }
+
+    bool readVarUInt(uint64_t& value) {
+        value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            uint8_t byte;
+            if (!readByte(byte)) {
+                return false;
+            }
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false; // More than 10 bytes: not a valid 64-bit varint
+    }
+
+    bool readRaw(std::string& value, size_t length) {
+        if (length > remaining()) {
+            return false;
+        }
+        value.assign(reinterpret_cast<const char*>(data_ + offset_), length);
+        offset_ += length;
+        return true;
+    }
+
+    bool readString(std::string& value) {
+        uint64_t length;
+        return readVarUInt(length) && readRaw(value, static_cast<size_t>(length));
+    }
+
+    size_t remaining() const { return length_ - offset_; }
+    bool atEnd() const { return offset_ == length_; }
+
+private:
+    const uint8_t* data_;
+    size_t length_;
+    size_t offset_;
+};
+
+} // namespace collaboration
+} // namespace bolt
+
+#endif
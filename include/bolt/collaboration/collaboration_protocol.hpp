@@ -3,13 +3,16 @@
 
 #include "collaborative_session.hpp"
 #include "document_operation.hpp"
+#include "binary_encoding.hpp"
+#include "operation_batcher.hpp"
 #include "../network/websocket_server.hpp"
 #include <string>
+#include <string_view>
 #include <map>
-#include <set>
 #include <memory>
 #include <mutex>
 #include <functional>
+#include <vector>
 #include <cctype>
 #include <algorithm>
 
@@ -24,14 +27,61 @@ enum class MessageType {
     USER_JOINED,
     USER_LEFT,
     DOCUMENT_STATE,
-    ERROR_MESSAGE
+    ERROR_MESSAGE,
+    REVISION_ACK,
+    CRDT_SYNC,      // Client state vector; answered with the missing CRDT_UPDATE (binary only)
+    CRDT_UPDATE,    // Sequence CRDT update bytes (binary only)
+    BATCH,          // Several messages for one client, sent once per tick
+    SNAPSHOT_CHUNK, // Part of the document snapshot announced by DOCUMENT_STATE
+    OPERATION_ACK   // Revision an edit from this client became
+};
+
+// Encoding of messages on the WebSocket. JSON text frames remain the default
+// and are handy for debugging; clients opt into binary frames when joining.
+enum class WireFormat {
+    JSON,
+    BINARY
 };
 
 struct ProtocolMessage {
+    static constexpr uint8_t BINARY_VERSION = 1;
+    
     MessageType type;
     std::string documentId;
     std::string userId;
     std::string data;
+    WireFormat format = WireFormat::JSON;  // Format the message arrived in
+    
+    std::string serialize(WireFormat wireFormat) const {
+        return wireFormat == WireFormat::BINARY ? serializeBinary() : serialize();
+    }
+    
+    // Version byte, varint type, then length-prefixed ids and payload; the
+    // payload is carried as raw bytes, so nothing is escaped
+    std::string serializeBinary() const {
+        BinaryWriter writer;
+        writer.writeByte(BINARY_VERSION);
+        writer.writeVarUInt(static_cast<uint64_t>(type));
+        writer.writeString(documentId);
+        writer.writeString(userId);
+        writer.writeString(data);
+        return writer.toString();
+    }
+    
+    static bool deserializeBinary(const std::string& bytes, ProtocolMessage& msg) {
+        BinaryReader reader(bytes);
+        uint8_t version;
+        uint64_t type;
+        if (!reader.readByte(version) || version != BINARY_VERSION ||
+            !reader.readVarUInt(type) || type > static_cast<uint64_t>(MessageType::OPERATION_ACK) ||
+            !reader.readString(msg.documentId) || !reader.readString(msg.userId) ||
+            !reader.readString(msg.data) || !reader.atEnd()) {
+            return false;
+        }
+        msg.type = static_cast<MessageType>(type);
+        msg.format = WireFormat::BINARY;
+        return true;
+    }
     
     std::string serialize() const {
         std::string result = "{";
@@ -74,12 +124,26 @@ private:
         return std::stoi(data.substr(pos, end - pos));
     }
     
+    // Reads up to the closing quote, undoing escapeString so nested JSON
+    // (such as a serialized operation in data) survives the round trip
     static std::string extractString(const std::string& data, const std::string& key) {
         auto pos = data.find("\"" + key + "\":\"");
         if (pos == std::string::npos) return "";
         pos = data.find("\":\"", pos) + 3;
-        auto end = data.find("\"", pos);
-        return data.substr(pos, end - pos);
+        
+        std::string result;
+        for (; pos < data.length() && data[pos] != '"'; ++pos) {
+            if (data[pos] == '\\' && pos + 1 < data.length()) {
+                char escaped = data[++pos];
+                if (escaped == 'n') result += '\n';
+                else if (escaped == 'r') result += '\r';
+                else if (escaped == 't') result += '\t';
+                else result += escaped;
+            } else {
+                result += data[pos];
+            }
+        }
+        return result;
     }
 };
 
@@ -103,9 +167,7 @@ public:
         });
         
         wsServer.onMessage([this](const std::string& message, WebSocketConnection* conn, bool binary) {
-            if (!binary) {
-                handleMessage(message, conn);
-            }
+            handleMessage(message, conn, binary);
         });
         
         // Set up collaborative session callbacks
@@ -127,6 +189,16 @@ public:
             broadcastCursorUpdate(userId, pos, docId);
         });
         
+        session.onDocumentUpdate([this](const std::vector<uint8_t>& update, const std::string& docId) {
+            broadcastDocumentUpdate(update, docId);
+        });
+        
+        // Incoming cursor moves and outgoing fan-out are grouped per tick
+        if (tickInterval_.count() > 0) {
+            incoming_.setWindow(tickInterval_);
+            ticker_.start(tickInterval_, [this]() { tick(); });
+        }
+        
         // Start WebSocket server
         wsServer.start(port);
     }
@@ -135,61 +207,200 @@ public:
         auto& wsServer = WebSocketServer::getInstance();
         wsServer.stop();
         
+        ticker_.stop();
+        tick(true);
+        
         std::lock_guard<std::mutex> lock(connectionsMutex_);
         connections_.clear();
         userConnections_.clear();
+        userFormats_.clear();
+        outboxes_.clear();
+    }
+    
+    // Interval at which client edits are composed and updates fanned out;
+    // zero handles every message immediately. Takes effect on initialize().
+    void setTickInterval(std::chrono::milliseconds interval) {
+        tickInterval_ = interval;
     }
     
-    // Send document state to specific user
+    // Send document state to specific user as a stream: a DOCUMENT_STATE
+    // header, the snapshot text in SNAPSHOT_CHUNK messages, then the edits
+    // made since the snapshot as DOCUMENT_OPERATION messages. The state is
+    // captured and sent under the user's send lock, so every edit committed
+    // after it reaches the user after the stream; edits it already contains
+    // are dropped from the user's queue and later broadcasts. Other users
+    // and documents are not held up.
     void sendDocumentState(const std::string& userId, const std::string& documentId) {
+        WireFormat format;
+        auto peer = findPeer(userId, format);
+        if (!peer) {
+            return;
+        }
+        bool binary = format == WireFormat::BINARY;
+        
+        std::lock_guard<std::mutex> sendLock(peer->sendMutex);
+        if (!peer->open) {
+            return;
+        }
+        
         auto& session = CollaborativeSession::getInstance();
-        std::string content = session.getDocumentContent(documentId);
+        CollaborativeSession::JoinState state;
+        if (!session.getJoinState(documentId, state)) {
+            return;
+        }
         auto users = session.getActiveUsers(documentId);
+        const std::string empty;
+        const std::string& content = state.snapshot ? *state.snapshot : empty;
+        auto chunks = splitSnapshot(content);
         
         ProtocolMessage msg;
         msg.type = MessageType::DOCUMENT_STATE;
         msg.documentId = documentId;
         msg.userId = userId;
+        if (binary) {
+            BinaryWriter writer;
+            writer.writeVarUInt(state.revision);
+            writer.writeVarUInt(state.snapshotRevision);
+            writer.writeVarUInt(content.size());
+            writer.writeVarUInt(chunks.size());
+            writer.writeVarUInt(state.tail.size());
+            writer.writeVarUInt(users.size());
+            for (const auto& user : users) {
+                writer.writeString(user.userId);
+                writer.writeString(user.userName);
+                writer.writeVarUInt(user.cursorPosition.line);
+                writer.writeVarUInt(user.cursorPosition.character);
+            }
+            msg.data = writer.toString();
+        } else {
+            // Create document state data
+            std::string stateData = "{";
+            stateData += "\"revision\":" + std::to_string(state.revision) + ",";
+            stateData += "\"snapshotRevision\":" + std::to_string(state.snapshotRevision) + ",";
+            stateData += "\"length\":" + std::to_string(content.size()) + ",";
+            stateData += "\"chunks\":" + std::to_string(chunks.size()) + ",";
+            stateData += "\"tail\":" + std::to_string(state.tail.size()) + ",";
+            stateData += "\"users\":[";
+            for (size_t i = 0; i < users.size(); ++i) {
+                if (i > 0) stateData += ",";
+                stateData += "{\"userId\":\"" + users[i].userId + "\",";
+                stateData += "\"userName\":\"" + users[i].userName + "\",";
+                stateData += "\"cursorLine\":" + std::to_string(users[i].cursorPosition.line) + ",";
+                stateData += "\"cursorChar\":" + std::to_string(users[i].cursorPosition.character) + "}";
+            }
+            stateData += "]}";
+            msg.data = stateData;
+        }
+        
+        WebSocketConnection* conn = peer->connection;
+        conn->send(msg.serialize(format), binary);
         
-        // Create document state data
-        std::string stateData = "{";
-        stateData += "\"content\":\"" + escapeString(content) + "\",";
-        stateData += "\"users\":[";
-        for (size_t i = 0; i < users.size(); ++i) {
-            if (i > 0) stateData += ",";
-            stateData += "{\"userId\":\"" + users[i].userId + "\",";
-            stateData += "\"userName\":\"" + users[i].userName + "\",";
-            stateData += "\"cursorLine\":" + std::to_string(users[i].cursorPosition.line) + ",";
-            stateData += "\"cursorChar\":" + std::to_string(users[i].cursorPosition.character) + "}";
+        msg.type = MessageType::SNAPSHOT_CHUNK;
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            std::string_view chunk(content.data() + chunks[i].first, chunks[i].second);
+            if (binary) {
+                BinaryWriter writer;
+                writer.writeVarUInt(i);
+                writer.writeBytes(chunk.data(), chunk.size());
+                msg.data = writer.toString();
+            } else {
+                msg.data = "{\"index\":" + std::to_string(i) + ",\"content\":\"" +
+                           escapeString(std::string(chunk)) + "\"}";
+            }
+            conn->send(msg.serialize(format), binary);
+        }
+        
+        msg.type = MessageType::DOCUMENT_OPERATION;
+        for (const auto& op : state.tail) {
+            msg.userId = op.getUserId();
+            msg.data = binary ? op.encodeBinary() : op.serialize();
+            conn->send(msg.serialize(format), binary);
         }
-        stateData += "]}";
-        msg.data = stateData;
         
-        sendToUser(userId, msg.serialize());
+        peer->loadedRevisions[documentId] = state.revision;
+        sendQueued(userId, *peer, format, takeOutbox(userId));
+    }
+    
+    // Wire format negotiated by a user when joining
+    WireFormat getUserWireFormat(const std::string& userId) {
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        auto it = userFormats_.find(userId);
+        return it != userFormats_.end() ? it->second : WireFormat::JSON;
     }
 
 private:
+    static constexpr size_t SNAPSHOT_CHUNK_SIZE = 64 * 1024;
+    
+    // Revision recorded for a document whose state has not been sent yet
+    static constexpr uint64_t STATE_PENDING = UINT64_MAX;
+    
+    // An encoded message waiting for the recipient's next batch. Edits carry
+    // the revision they produced so ones the recipient's loaded state
+    // already contains can be dropped.
+    struct Outgoing {
+        std::string bytes;
+        std::string documentId;
+        uint64_t revision = 0;  // 0 for anything but a document edit
+    };
+    
+    // A client connection as seen by senders. Sends happen outside
+    // connectionsMutex_ under sendMutex, which also orders messages to the
+    // peer; open is cleared under sendMutex on disconnect, before the server
+    // deletes the connection.
+    struct Peer {
+        explicit Peer(WebSocketConnection* conn) : connection(conn) {}
+        
+        // Caller holds sendMutex
+        bool wants(const std::string& documentId, uint64_t revision) const {
+            if (revision == 0) {
+                return true;
+            }
+            auto it = loadedRevisions.find(documentId);
+            return it == loadedRevisions.end() || revision > it->second;
+        }
+        
+        WebSocketConnection* connection;
+        std::mutex sendMutex;
+        bool open = true;
+        std::map<std::string, uint64_t> loadedRevisions;  // documentId -> revision of the last state sent
+    };
+    
     CollaborationProtocol() = default;
     
     void handleConnection(WebSocketConnection* conn) {
         std::lock_guard<std::mutex> lock(connectionsMutex_);
-        connections_.insert(conn);
+        connections_.emplace(conn, std::make_shared<Peer>(conn));
     }
     
     void handleDisconnection(WebSocketConnection* conn) {
-        std::lock_guard<std::mutex> lock(connectionsMutex_);
-        
-        // Find and remove user from all documents
+        std::shared_ptr<Peer> peer;
         std::string disconnectedUserId;
-        for (auto it = userConnections_.begin(); it != userConnections_.end(); ++it) {
-            if (it->second == conn) {
-                disconnectedUserId = it->first;
-                userConnections_.erase(it);
-                break;
+        {
+            std::lock_guard<std::mutex> lock(connectionsMutex_);
+            
+            // Find and remove user from all documents
+            for (auto it = userConnections_.begin(); it != userConnections_.end(); ++it) {
+                if (it->second->connection == conn) {
+                    disconnectedUserId = it->first;
+                    userConnections_.erase(it);
+                    userFormats_.erase(disconnectedUserId);
+                    outboxes_.erase(disconnectedUserId);
+                    break;
+                }
+            }
+            
+            auto connIt = connections_.find(conn);
+            if (connIt != connections_.end()) {
+                peer = connIt->second;
+                connections_.erase(connIt);
             }
         }
         
-        connections_.erase(conn);
+        // Waits out a send in progress; nothing reaches the connection afterwards
+        if (peer) {
+            std::lock_guard<std::mutex> sendLock(peer->sendMutex);
+            peer->open = false;
+        }
         
         // Remove user from all collaborative sessions
         if (!disconnectedUserId.empty()) {
@@ -201,9 +412,18 @@ private:
         }
     }
     
-    void handleMessage(const std::string& message, WebSocketConnection* conn) {
+    void handleMessage(const std::string& message, WebSocketConnection* conn, bool binary = false) {
+        WireFormat replyFormat = binary ? WireFormat::BINARY : WireFormat::JSON;
         try {
-            ProtocolMessage msg = ProtocolMessage::deserialize(message);
+            ProtocolMessage msg;
+            if (binary) {
+                if (!ProtocolMessage::deserializeBinary(message, msg)) {
+                    sendError(conn, "Malformed binary message", replyFormat);
+                    return;
+                }
+            } else {
+                msg = ProtocolMessage::deserialize(message);
+            }
             
             switch (msg.type) {
                 case MessageType::JOIN_DOCUMENT:
@@ -218,27 +438,59 @@ private:
                 case MessageType::CURSOR_UPDATE:
                     handleCursorUpdate(msg, conn);
                     break;
+                case MessageType::REVISION_ACK:
+                    handleRevisionAck(msg, conn);
+                    break;
+                case MessageType::CRDT_SYNC:
+                    handleCrdtSync(msg, conn);
+                    break;
+                case MessageType::CRDT_UPDATE:
+                    handleCrdtUpdate(msg, conn);
+                    break;
                 default:
-                    sendError(conn, "Unknown message type");
+                    sendError(conn, "Unknown message type", replyFormat);
                     break;
             }
         } catch (const std::exception& e) {
-            sendError(conn, "Failed to parse message: " + std::string(e.what()));
+            sendError(conn, "Failed to parse message: " + std::string(e.what()), replyFormat);
         }
     }
     
     void handleJoinDocument(const ProtocolMessage& msg, WebSocketConnection* conn) {
         auto& session = CollaborativeSession::getInstance();
         
+        // Open the document from the store, or create it if it doesn't exist
+        if (!session.hasDocument(msg.documentId) && !session.recoverDocument(msg.documentId)) {
+            session.createDocument(msg.documentId);
+        }
+        
+        // Clients negotiate binary frames either by joining with a binary
+        // message or with {"wireFormat":"binary"} in data. Replicas of a CRDT
+        // document follow it through CRDT_UPDATE, which is binary only.
+        bool wantsBinary = msg.format == WireFormat::BINARY ||
+                           msg.data.find("\"wireFormat\":\"binary\"") != std::string::npos;
+        if (!wantsBinary && session.getDocumentBackend(msg.documentId) == DocumentBackend::SEQUENCE_CRDT) {
+            sendError(conn, "CRDT documents require binary frames", msg.format);
+            return;
+        }
+        
         // Associate user with connection
+        std::shared_ptr<Peer> joining;
         {
             std::lock_guard<std::mutex> lock(connectionsMutex_);
-            userConnections_[msg.userId] = conn;
+            auto& peer = connections_[conn];
+            if (!peer) {
+                peer = std::make_shared<Peer>(conn);
+            }
+            joining = peer;
+            userConnections_[msg.userId] = peer;
+            userFormats_[msg.userId] = wantsBinary ? WireFormat::BINARY : WireFormat::JSON;
         }
         
-        // Create document if it doesn't exist
-        if (session.getDocumentLines(msg.documentId).empty()) {
-            session.createDocument(msg.documentId);
+        // Edits broadcast from here on are either in the state or follow it
+        {
+            std::lock_guard<std::mutex> sendLock(joining->sendMutex);
+            joining->loadedRevisions[msg.documentId] = STATE_PENDING;
         }
         
         // Add user to document
@@ -247,7 +499,11 @@ private:
             // Send current document state to the user
             sendDocumentState(msg.userId, msg.documentId);
         } else {
-            sendError(conn, "Failed to join document");
+            {
+                std::lock_guard<std::mutex> sendLock(joining->sendMutex);
+                joining->loadedRevisions.erase(msg.documentId);
+            }
+            sendError(conn, "Failed to join document", msg.format);
         }
     }
     
@@ -258,39 +514,272 @@ private:
     
     void handleDocumentOperation(const ProtocolMessage& msg, WebSocketConnection* conn) {
         try {
-            auto operation = DocumentOperation::deserialize(msg.data);
-            auto& session = CollaborativeSession::getInstance();
-            
-            bool success = session.applyOperation(*operation, msg.documentId);
-            if (!success) {
-                sendError(conn, "Failed to apply operation");
+            auto operation = msg.format == WireFormat::BINARY ? DocumentOperation::decodeBinary(msg.data)
+                                                              : DocumentOperation::deserialize(msg.data);
+            if (!operation) {
+                sendError(conn, "Invalid operation", msg.format);
+                return;
             }
+            
+            // Clients keep one edit in flight and compose keystrokes while
+            // waiting (see CollaborativeEditorIntegration), so edits go
+            // straight to the document's strand
+            submitOperation(*operation, msg.documentId);
         } catch (const std::exception& e) {
-            sendError(conn, "Invalid operation: " + std::string(e.what()));
+            sendError(conn, "Invalid operation: " + std::string(e.what()), msg.format);
         }
     }
     
     void handleCursorUpdate(const ProtocolMessage& msg, WebSocketConnection* conn) {
         try {
             // Parse cursor position from data
-            Position pos = parseCursorPosition(msg.data);
+            Position pos;
+            if (!parseCursorPosition(msg, pos)) {
+                sendError(conn, "Invalid cursor update", msg.format);
+                return;
+            }
             
             DocumentOperation cursorOp(OperationType::CURSOR_MOVE, msg.userId, pos);
+            if (ticker_.isRunning()) {
+                // Only the last position per tick matters
+                incoming_.add(msg.documentId, cursorOp);
+                ticker_.schedule();
+            } else {
+                // Behind the sender's edits still on the strand
+                CollaborativeSession::getInstance().submitOperation(cursorOp, msg.documentId);
+            }
+        } catch (const std::exception& e) {
+            sendError(conn, "Invalid cursor update: " + std::string(e.what()), msg.format);
+        }
+    }
+    
+    void handleRevisionAck(const ProtocolMessage& msg, WebSocketConnection* conn) {
+        try {
+            uint64_t revision = 0;
+            if (msg.format == WireFormat::BINARY) {
+                BinaryReader reader(msg.data);
+                if (!reader.readVarUInt(revision) || !reader.atEnd()) {
+                    sendError(conn, "Invalid revision acknowledgement", msg.format);
+                    return;
+                }
+            } else {
+                revision = static_cast<uint64_t>(std::stoull(msg.data));
+            }
+            
             auto& session = CollaborativeSession::getInstance();
-            session.applyOperation(cursorOp, msg.documentId);
+            if (!session.acknowledgeRevision(msg.userId, msg.documentId, revision)) {
+                sendError(conn, "Invalid revision acknowledgement", msg.format);
+            }
         } catch (const std::exception& e) {
-            sendError(conn, "Invalid cursor update: " + std::string(e.what()));
+            sendError(conn, "Invalid revision acknowledgement: " + std::string(e.what()), msg.format);
+        }
+    }
+    
+    // Applied on the document's strand so a busy document never stalls
+    // the network thread; the connection is looked up again on completion
+    // because it may have closed in the meantime
+    void submitOperation(const DocumentOperation& operation, const std::string& documentId) {
+        std::string userId = operation.getUserId();
+        CollaborativeSession::getInstance().submitOperation(operation, documentId,
+            [this, userId, documentId](bool success) {
+                if (!success) {
+                    sendErrorToUser(userId, "Failed to apply operation");
+                    
+                    // The base revision may have fallen out of the retained history
+                    sendDocumentState(userId, documentId);
+                }
+            });
+    }
+    
+    // Once per tick: queue the latest cursor of every user behind the edits
+    // already on the document's strand, fan out cursors, then send each
+    // client its queued messages as a single frame. With force everything
+    // pending goes out regardless of age.
+    void tick(bool force = false) {
+        auto batches = force ? incoming_.takeAll() : incoming_.takeDue();
+        auto& session = CollaborativeSession::getInstance();
+        for (const auto& batch : batches) {
+            for (const auto& cursor : batch.cursors) {
+                session.submitOperation(cursor, batch.documentId);
+            }
+        }
+        
+        std::map<std::pair<std::string, std::string>, Position> cursors;
+        {
+            std::lock_guard<std::mutex> lock(cursorsMutex_);
+            cursors.swap(pendingCursors_);
+        }
+        for (const auto& [key, pos] : cursors) {
+            sendCursorUpdate(key.second, pos, key.first);
+        }
+        
+        flushOutboxes();
+        
+        if (!force && !incoming_.empty()) {
+            ticker_.schedule();
+        }
+    }
+    
+    // A slow client only delays its own batch; the outbox is taken under
+    // the peer's send lock so a direct send can't overtake it
+    void flushOutboxes() {
+        std::vector<std::string> userIds;
+        {
+            std::lock_guard<std::mutex> lock(connectionsMutex_);
+            for (const auto& [userId, messages] : outboxes_) {
+                if (!messages.empty()) {
+                    userIds.push_back(userId);
+                }
+            }
+        }
+        for (const auto& userId : userIds) {
+            WireFormat format;
+            if (auto peer = findPeer(userId, format)) {
+                deliver(userId, *peer, format, nullptr);
+            }
+        }
+    }
+    
+    // Caller holds the peer's send lock; edits the peer's loaded state
+    // already contains are skipped
+    void sendQueued(const std::string& userId, Peer& peer, WireFormat format,
+                    const std::vector<Outgoing>& queued) {
+        std::vector<std::string> messages;
+        messages.reserve(queued.size());
+        for (const auto& message : queued) {
+            if (peer.wants(message.documentId, message.revision)) {
+                messages.push_back(message.bytes);
+            }
+        }
+        if (messages.empty()) {
+            return;
+        }
+        
+        WebSocketConnection* conn = peer.connection;
+        if (messages.size() == 1) {
+            conn->send(messages.front(), format == WireFormat::BINARY);
+            return;
+        }
+        
+        ProtocolMessage batch;
+        batch.type = MessageType::BATCH;
+        batch.userId = userId;
+        if (format == WireFormat::BINARY) {
+            BinaryWriter writer;
+            writer.writeVarUInt(messages.size());
+            for (const auto& message : messages) {
+                writer.writeString(message);
+            }
+            batch.data = writer.toString();
+        } else {
+            batch.data = "[";
+            for (size_t i = 0; i < messages.size(); ++i) {
+                if (i > 0) batch.data += ",";
+                batch.data += messages[i];
+            }
+            batch.data += "]";
+        }
+        conn->send(batch.serialize(format), format == WireFormat::BINARY);
+    }
+    
+    // CRDT payloads are raw bytes, so CRDT sync is only offered over binary frames
+    void handleCrdtSync(const ProtocolMessage& msg, WebSocketConnection* conn) {
+        auto& session = CollaborativeSession::getInstance();
+        if (msg.format != WireFormat::BINARY ||
+            session.getDocumentBackend(msg.documentId) != DocumentBackend::SEQUENCE_CRDT) {
+            sendError(conn, "CRDT sync requires a sequence CRDT document and binary frames", msg.format);
+            return;
+        }
+        
+        std::vector<uint8_t> stateVector(msg.data.begin(), msg.data.end());
+        auto update = session.encodeStateAsUpdate(msg.documentId, stateVector);
+        if (update.empty()) {
+            sendError(conn, "Invalid state vector", msg.format);
+            return;
+        }
+        
+        ProtocolMessage reply;
+        reply.type = MessageType::CRDT_UPDATE;
+        reply.documentId = msg.documentId;
+        reply.userId = msg.userId;
+        reply.data.assign(update.begin(), update.end());
+        conn->send(reply.serializeBinary(), true);
+    }
+    
+    void handleCrdtUpdate(const ProtocolMessage& msg, WebSocketConnection* conn) {
+        auto& session = CollaborativeSession::getInstance();
+        std::vector<uint8_t> update(msg.data.begin(), msg.data.end());
+        if (msg.format != WireFormat::BINARY || !session.applyUpdate(msg.documentId, update)) {
+            sendError(conn, "Failed to apply CRDT update", msg.format);
         }
     }
     
     void broadcastOperation(const DocumentOperation& op, const std::string& documentId) {
+        bool edit = op.getType() == OperationType::INSERT || op.getType() == OperationType::DELETE;
         ProtocolMessage msg;
         msg.type = MessageType::DOCUMENT_OPERATION;
         msg.documentId = documentId;
         msg.userId = op.getUserId();
-        msg.data = op.serialize();
         
-        broadcastToDocument(documentId, msg.serialize(), op.getUserId());
+        // Clients of CRDT documents are binary replicas and receive CRDT_UPDATE instead
+        bool crdtDocument = CollaborativeSession::getInstance().getDocumentBackend(documentId) ==
+                            DocumentBackend::SEQUENCE_CRDT;
+        if (!crdtDocument) {
+            broadcastToDocument(documentId, msg, [&op](WireFormat format) {
+                return format == WireFormat::BINARY ? op.encodeBinary() : op.serialize();
+            }, op.getUserId(), AllRecipients, edit ? op.getBaseRevision() + 1 : 0);
+        }
+        
+        if (edit) {
+            sendOperationAck(op, documentId);
+        }
+    }
+    
+    // The author is excluded from the broadcast, so it is told separately
+    // which revision its edit became. Clients keep one edit in flight and
+    // send the next once the previous one is acknowledged.
+    void sendOperationAck(const DocumentOperation& op, const std::string& documentId) {
+        ProtocolMessage msg;
+        msg.type = MessageType::OPERATION_ACK;
+        msg.documentId = documentId;
+        msg.userId = op.getUserId();
+        uint64_t revision = op.getBaseRevision() + 1;
+        
+        std::unique_lock<std::mutex> lock(connectionsMutex_);
+        auto connIt = userConnections_.find(msg.userId);
+        if (connIt == userConnections_.end()) {
+            return;
+        }
+        auto peer = connIt->second;
+        
+        WireFormat format = formatOf(msg.userId);
+        if (format == WireFormat::BINARY) {
+            BinaryWriter writer;
+            writer.writeVarUInt(revision);
+            msg.data = writer.toString();
+        } else {
+            msg.data = std::to_string(revision);
+        }
+        
+        if (ticker_.isRunning()) {
+            outboxes_[msg.userId].push_back({msg.serialize(format)});
+            lock.unlock();
+            ticker_.schedule();
+        } else {
+            lock.unlock();
+            deliver(msg.userId, *peer, format, [&](WebSocketConnection* conn) {
+                conn->send(msg.serialize(format), format == WireFormat::BINARY);
+            });
+        }
+    }
+    
+    void broadcastDocumentUpdate(const std::vector<uint8_t>& update, const std::string& documentId) {
+        ProtocolMessage msg;
+        msg.type = MessageType::CRDT_UPDATE;
+        msg.documentId = documentId;
+        msg.data.assign(update.begin(), update.end());
+        
+        broadcastToDocument(documentId, msg, nullptr, "", OnlyBinaryRecipients);
     }
     
     void broadcastUserJoined(const UserSession& user, const std::string& documentId) {
@@ -300,7 +789,7 @@ private:
         msg.userId = user.userId;
         msg.data = user.userName;
         
-        broadcastToDocument(documentId, msg.serialize(), user.userId);
+        broadcastToDocument(documentId, msg, nullptr, user.userId);
     }
     
     void broadcastUserLeft(const std::string& userId, const std::string& documentId) {
@@ -309,55 +798,222 @@ private:
         msg.documentId = documentId;
         msg.userId = userId;
         
-        broadcastToDocument(documentId, msg.serialize(), userId);
+        broadcastToDocument(documentId, msg, nullptr, userId);
     }
     
     void broadcastCursorUpdate(const std::string& userId, const Position& pos, const std::string& documentId) {
+        if (ticker_.isRunning()) {
+            // Superseded positions are dropped; the latest one goes out on the next tick
+            {
+                std::lock_guard<std::mutex> lock(cursorsMutex_);
+                pendingCursors_[{documentId, userId}] = pos;
+            }
+            ticker_.schedule();
+            return;
+        }
+        
+        sendCursorUpdate(userId, pos, documentId);
+    }
+    
+    void sendCursorUpdate(const std::string& userId, const Position& pos, const std::string& documentId) {
         ProtocolMessage msg;
         msg.type = MessageType::CURSOR_UPDATE;
         msg.documentId = documentId;
         msg.userId = userId;
-        msg.data = "{\"line\":" + std::to_string(pos.line) + 
-                  ",\"character\":" + std::to_string(pos.character) + "}";
         
-        broadcastToDocument(documentId, msg.serialize(), userId);
+        broadcastToDocument(documentId, msg, [&pos](WireFormat format) {
+            if (format == WireFormat::BINARY) {
+                BinaryWriter writer;
+                writer.writeVarUInt(pos.line);
+                writer.writeVarUInt(pos.character);
+                return writer.toString();
+            }
+            return "{\"line\":" + std::to_string(pos.line) + 
+                   ",\"character\":" + std::to_string(pos.character) + "}";
+        }, userId);
     }
     
-    void broadcastToDocument(const std::string& documentId, const std::string& message, 
-                           const std::string& excludeUserId = "") {
+    // Builds the payload of a message for one wire format; when empty, msg.data is sent as is
+    using PayloadEncoder = std::function<std::string(WireFormat)>;
+    
+    enum RecipientFilter {
+        AllRecipients,
+        OnlyBinaryRecipients
+    };
+    
+    // Each recipient gets the message in its negotiated format; every format
+    // is encoded at most once per broadcast. While ticking, messages are queued
+    // and go out with the recipient's next batch; otherwise recipients are
+    // collected under connectionsMutex_ and sent to after it is released.
+    // An edit passes the revision it produced, so recipients whose loaded
+    // state already has it skip it.
+    void broadcastToDocument(const std::string& documentId, ProtocolMessage msg,
+                             const PayloadEncoder& payload, const std::string& excludeUserId = "",
+                             RecipientFilter filter = AllRecipients, uint64_t revision = 0) {
         auto& session = CollaborativeSession::getInstance();
         auto users = session.getActiveUsers(documentId);
         
-        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        std::string encoded[2];
+        bool ready[2] = {false, false};
+        bool queue = ticker_.isRunning();
+        
+        struct Recipient {
+            std::string userId;
+            std::shared_ptr<Peer> peer;
+            WireFormat format;
+        };
+        std::vector<Recipient> recipients;
+        
+        std::unique_lock<std::mutex> lock(connectionsMutex_);
         for (const auto& user : users) {
-            if (user.userId != excludeUserId) {
-                auto connIt = userConnections_.find(user.userId);
-                if (connIt != userConnections_.end()) {
-                    connIt->second->send(message);
+            if (user.userId == excludeUserId) {
+                continue;
+            }
+            auto connIt = userConnections_.find(user.userId);
+            if (connIt == userConnections_.end()) {
+                continue;
+            }
+            
+            WireFormat format = formatOf(user.userId);
+            if (filter == OnlyBinaryRecipients && format != WireFormat::BINARY) {
+                continue;
+            }
+            
+            size_t slot = format == WireFormat::BINARY ? 1 : 0;
+            if (!ready[slot]) {
+                if (payload) {
+                    msg.data = payload(format);
                 }
+                encoded[slot] = msg.serialize(format);
+                ready[slot] = true;
+            }
+            if (queue) {
+                outboxes_[user.userId].push_back({encoded[slot], documentId, revision});
+            } else {
+                recipients.push_back({user.userId, connIt->second, format});
             }
         }
+        lock.unlock();
+        
+        for (const auto& recipient : recipients) {
+            const std::string& message = encoded[recipient.format == WireFormat::BINARY ? 1 : 0];
+            Peer& peer = *recipient.peer;
+            deliver(recipient.userId, peer, recipient.format, [&](WebSocketConnection* conn) {
+                if (peer.wants(documentId, revision)) {
+                    conn->send(message, recipient.format == WireFormat::BINARY);
+                }
+            });
+        }
+        
+        if (queue && (ready[0] || ready[1])) {
+            ticker_.schedule();
+        }
     }
     
-    void sendToUser(const std::string& userId, const std::string& message) {
+    void sendToUser(const std::string& userId, ProtocolMessage msg, const PayloadEncoder& payload = nullptr) {
+        WireFormat format;
+        auto peer = findPeer(userId, format);
+        if (!peer) {
+            return;
+        }
+        if (payload) {
+            msg.data = payload(format);
+        }
+        deliver(userId, *peer, format, [&](WebSocketConnection* conn) {
+            conn->send(msg.serialize(format), format == WireFormat::BINARY);
+        });
+    }
+    
+    std::shared_ptr<Peer> findPeer(const std::string& userId, WireFormat& format) {
         std::lock_guard<std::mutex> lock(connectionsMutex_);
         auto it = userConnections_.find(userId);
-        if (it != userConnections_.end()) {
-            it->second->send(message);
+        if (it == userConnections_.end()) {
+            return nullptr;
         }
+        format = formatOf(userId);
+        return it->second;
     }
     
-    void sendError(WebSocketConnection* conn, const std::string& error) {
+    // Sends to a peer without holding connectionsMutex_. Anything already
+    // queued for the user was produced earlier and goes out first; send may
+    // be empty to only flush the queue. Does nothing once the peer is closed.
+    void deliver(const std::string& userId, Peer& peer, WireFormat format,
+                 const std::function<void(WebSocketConnection*)>& send) {
+        std::lock_guard<std::mutex> sendLock(peer.sendMutex);
+        if (!peer.open) {
+            return;
+        }
+        
+        sendQueued(userId, peer, format, takeOutbox(userId));
+        if (send) {
+            send(peer.connection);
+        }
+    }
+    
+    std::vector<Outgoing> takeOutbox(const std::string& userId) {
+        std::vector<Outgoing> queued;
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        auto outboxIt = outboxes_.find(userId);
+        if (outboxIt != outboxes_.end()) {
+            queued.swap(outboxIt->second);
+            outboxes_.erase(outboxIt);
+        }
+        return queued;
+    }
+    
+    // Snapshot text split into [offset, length) chunks that never cut a
+    // UTF-8 sequence in two
+    static std::vector<std::pair<size_t, size_t>> splitSnapshot(const std::string& content) {
+        std::vector<std::pair<size_t, size_t>> chunks;
+        size_t offset = 0;
+        while (offset < content.size()) {
+            size_t end = std::min(offset + SNAPSHOT_CHUNK_SIZE, content.size());
+            while (end < content.size() && end > offset + 1 &&
+                   (static_cast<unsigned char>(content[end]) & 0xC0) == 0x80) {
+                end--;
+            }
+            chunks.emplace_back(offset, end - offset);
+            offset = end;
+        }
+        return chunks;
+    }
+    
+    // Caller holds connectionsMutex_
+    WireFormat formatOf(const std::string& userId) const {
+        auto it = userFormats_.find(userId);
+        return it != userFormats_.end() ? it->second : WireFormat::JSON;
+    }
+    
+    void sendError(WebSocketConnection* conn, const std::string& error, WireFormat format = WireFormat::JSON) {
+        ProtocolMessage msg;
+        msg.type = MessageType::ERROR_MESSAGE;
+        msg.data = error;
+        conn->send(msg.serialize(format), format == WireFormat::BINARY);
+    }
+    
+    void sendErrorToUser(const std::string& userId, const std::string& error) {
         ProtocolMessage msg;
         msg.type = MessageType::ERROR_MESSAGE;
+        msg.userId = userId;
         msg.data = error;
-        conn->send(msg.serialize());
+        sendToUser(userId, msg);
     }
     
-    Position parseCursorPosition(const std::string& data) {
-        int line = extractInt(data, "line");
-        int character = extractInt(data, "character");
-        return Position(line, character);
+    bool parseCursorPosition(const ProtocolMessage& msg, Position& pos) {
+        if (msg.format == WireFormat::BINARY) {
+            BinaryReader reader(msg.data);
+            uint64_t line, character;
+            if (!reader.readVarUInt(line) || !reader.readVarUInt(character) || !reader.atEnd()) {
+                return false;
+            }
+            pos = Position(line, character);
+            return true;
+        }
+        
+        int line = extractInt(msg.data, "line");
+        int character = extractInt(msg.data, "character");
+        pos = Position(line, character);
+        return true;
     }
     
     static int extractInt(const std::string& data, const std::string& key) {
@@ -381,9 +1037,21 @@ private:
         return result;
     }
     
+    // Lookup tables only; never held while sending. Peer::sendMutex may be
+    // held while taking connectionsMutex_, never the other way around.
     std::mutex connectionsMutex_;
-    std::set<WebSocketConnection*> connections_;
-    std::map<std::string, WebSocketConnection*> userConnections_;
+    std::map<WebSocketConnection*, std::shared_ptr<Peer>> connections_;
+    std::map<std::string, std::shared_ptr<Peer>> userConnections_;
+    std::map<std::string, WireFormat> userFormats_;
+    std::map<std::string, std::vector<Outgoing>> outboxes_;  // userId -> messages for the next tick
+    
+    std::mutex cursorsMutex_;
+    std::map<std::pair<std::string, std::string>, Position> pendingCursors_;  // (documentId, userId)
+    
+    std::chrono::milliseconds tickInterval_{OperationBatcher::DEFAULT_WINDOW};
+    OperationBatcher incoming_;
+    // Declared last so the tick thread stops before the state it touches goes away
+    FlushScheduler ticker_;
 };
 
 } // namespace collaboration
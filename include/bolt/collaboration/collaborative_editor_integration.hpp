@@ -4,6 +4,7 @@
 #include "collaborative_session.hpp"
 #include "collaboration_protocol.hpp"
 #include "document_operation.hpp"
+#include "operation_batcher.hpp"
 #include "../core/editor_store.hpp"
 #include <string>
 #include <functional>
@@ -38,12 +39,20 @@ public:
         setupEditorStoreListeners();
         setupCollaborationListeners();
         
+        // Local keystrokes are composed for a short window before reaching the session
+        if (batcher_.getWindow().count() > 0) {
+            flusher_.start(batcher_.getWindow(), [this]() { flushDueEdits(); });
+        }
+        
         isInitialized_ = true;
     }
     
     void shutdown() {
         if (!isInitialized_) return;
         
+        flusher_.stop();
+        flushPendingEdits();
+        
         auto& protocol = CollaborationProtocol::getInstance();
         protocol.shutdown();
         
@@ -122,12 +131,10 @@ public:
             return false;
         }
         
-        auto& session = CollaborativeSession::getInstance();
-        
         OperationType opType = isDelete ? OperationType::DELETE : OperationType::INSERT;
         DocumentOperation op(opType, userId, position, text);
         
-        return session.applyOperation(op, it->second);
+        return submitEdit(it->second, op);
     }
     
     // Update cursor position
@@ -143,10 +150,30 @@ public:
             return false;
         }
         
-        auto& session = CollaborativeSession::getInstance();
         DocumentOperation cursorOp(OperationType::CURSOR_MOVE, userId, position);
         
-        return session.applyOperation(cursorOp, it->second);
+        return submitEdit(it->second, cursorOp);
+    }
+    
+    // Batching window for local edits; zero applies every edit immediately.
+    // Takes effect on the next initialize().
+    void setBatchWindow(std::chrono::milliseconds window) {
+        batcher_.setWindow(window);
+    }
+    
+    // Apply all batched edits now, e.g. before saving. Returns false if the
+    // session rejected any of them.
+    bool flushPendingEdits() {
+        return applyBatches(batcher_.takeAll());
+    }
+    
+    // Batched edits are applied after applyTextEdit() has returned; the
+    // callback hears about each one the session rejects, so the editor can
+    // resynchronize the file
+    using EditFailureCallback = std::function<void(const std::string& filePath, const DocumentOperation& operation)>;
+    void onEditFailed(EditFailureCallback callback) {
+        std::lock_guard<std::mutex> lock(callbackMutex_);
+        editFailedCallback_ = std::move(callback);
     }
     
     // Get remote users' cursor positions
@@ -196,6 +223,54 @@ public:
 private:
     CollaborativeEditorIntegration() : isInitialized_(false) {}
     
+    // With batching on, true means the edit was queued; a later rejection
+    // is reported through onEditFailed()
+    bool submitEdit(const std::string& docId, const DocumentOperation& op) {
+        if (batcher_.getWindow().count() > 0 && flusher_.isRunning()) {
+            batcher_.add(docId, op);
+            flusher_.schedule();
+            return true;
+        }
+        
+        return CollaborativeSession::getInstance().applyOperation(op, docId);
+    }
+    
+    void flushDueEdits() {
+        applyBatches(batcher_.takeDue());
+        if (!batcher_.empty()) {
+            flusher_.schedule();
+        }
+    }
+    
+    // Edits go first so each cursor lands after the edits it followed
+    bool applyBatches(const std::vector<OperationBatcher::Batch>& batches) {
+        auto& session = CollaborativeSession::getInstance();
+        bool allApplied = true;
+        for (const auto& batch : batches) {
+            for (const auto& op : batch.operations) {
+                if (!session.applyOperation(op, batch.documentId)) {
+                    allApplied = false;
+                    reportEditFailure(batch.documentId, op);
+                }
+            }
+            for (const auto& cursor : batch.cursors) {
+                session.applyOperation(cursor, batch.documentId);
+            }
+        }
+        return allApplied;
+    }
+    
+    void reportEditFailure(const std::string& docId, const DocumentOperation& op) {
+        EditFailureCallback callback;
+        {
+            std::lock_guard<std::mutex> lock(callbackMutex_);
+            callback = editFailedCallback_;
+        }
+        if (callback) {
+            callback(findFilePathForDocId(docId), op);
+        }
+    }
+    
     void setupEditorStoreListeners() {
         // Note: EditorStore doesn't have change callbacks in current implementation
         // In a real implementation, we would add callbacks to EditorStore
@@ -314,6 +389,10 @@ private:
     bool isInitialized_;
     mutable std::mutex collaborativeDocsMutex_;
     std::map<std::string, std::string> collaborativeDocs_; // filePath -> docId mapping
+    std::mutex callbackMutex_;
+    EditFailureCallback editFailedCallback_;
+    OperationBatcher batcher_;
+    FlushScheduler flusher_;
 };
 
 } // namespace collaboration
@@ -3,12 +3,17 @@
 
 #include "document_operation.hpp"
 #include "operational_transform.hpp"
+#include "document_registry.hpp"
+#include "sequence_crdt.hpp"
+#include "document_store.hpp"
 #include <string>
 #include <map>
 #include <vector>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <shared_mutex>
+#include <atomic>
+#include <deque>
 #include <functional>
 #include <chrono>
 
@@ -21,33 +26,97 @@ struct UserSession {
     Position cursorPosition;
     std::chrono::steady_clock::time_point lastActivity;
     bool isActive;
+    uint64_t acknowledgedRevision; // Latest document revision the client has seen
     
-    UserSession() : cursorPosition(0, 0), lastActivity(std::chrono::steady_clock::now()), isActive(true) {}
+    UserSession() : cursorPosition(0, 0), lastActivity(std::chrono::steady_clock::now()), isActive(true),
+                    acknowledgedRevision(0) {}
     
-    UserSession(const std::string& id, const std::string& name)
+    UserSession(const std::string& id, const std::string& name, uint64_t revision = 0)
         : userId(id), userName(name), cursorPosition(0, 0),
-          lastActivity(std::chrono::steady_clock::now()), isActive(true) {}
+          lastActivity(std::chrono::steady_clock::now()), isActive(true),
+          acknowledgedRevision(revision) {}
 };
 
 struct DocumentState {
     std::string documentId;
-    std::vector<std::string> lines;
-    std::vector<std::unique_ptr<DocumentOperation>> operationHistory;
+    DocumentBackend backend;
+    TextRope text;                           // Operational transform backend only
+    std::unique_ptr<SequenceCRDT> sequence;  // Sequence CRDT backend only
+    // Transformed edits since historyBaseRevision; the entry at index i moved the
+    // document from revision historyBaseRevision + i to historyBaseRevision + i + 1
+    std::deque<DocumentOperation> operationHistory;
     std::map<std::string, UserSession> activeUsers;
     uint64_t lastSequence;
+    uint64_t revision;
+    uint64_t historyBaseRevision;
+    bool removed;
     
-    DocumentState(const std::string& id) 
-        : documentId(id), lastSequence(0) {
-        lines.push_back(""); // Start with one empty line
+    // Guards all fields above plus the outbox; never held while callbacks run
+    mutable std::mutex mutex;
+    // Notifications produced under the lock, delivered in order after it is released
+    std::vector<std::function<void()>> outbox;
+    bool delivering;
+    
+    // Single-consumer queue of asynchronously submitted operations
+    struct PendingOperation {
+        DocumentOperation operation;
+        std::function<void(bool)> completion;
+    };
+    std::mutex queueMutex;
+    std::deque<PendingOperation> pendingOperations;
+    bool drainScheduled;
+    
+    // Latest snapshot and the edits applied since, guarded by mutex. Late
+    // joiners get the cached text plus this short tail instead of a fresh
+    // copy of the whole document; snapshotTail is empty for CRDT documents.
+    std::shared_ptr<const std::string> snapshotContent;
+    uint64_t snapshotRevision;
+    std::vector<DocumentOperation> snapshotTail;
+    
+    DocumentState(const std::string& id, DocumentBackend documentBackend = DocumentBackend::OPERATIONAL_TRANSFORM)
+        : documentId(id), backend(documentBackend), lastSequence(0), revision(0), historyBaseRevision(0), removed(false),
+          delivering(false), drainScheduled(false), snapshotRevision(0) {
+        if (backend == DocumentBackend::SEQUENCE_CRDT) {
+            sequence = std::make_unique<SequenceCRDT>();
+        }
     }
 };
 
+/**
+ * Registry of collaboratively edited documents.
+ *
+ * Each document is locked independently and the registry itself is sharded,
+ * so edits to unrelated documents proceed in parallel. Callbacks are queued
+ * while the document lock is held and invoked in order once it is released,
+ * which lets them call back into the session. submitOperation() feeds a
+ * per-document queue drained by a shared worker pool, so network threads
+ * never block on a busy document.
+ *
+ * Documents use operational transform by default. Documents created with
+ * DocumentBackend::SEQUENCE_CRDT hold a SequenceCRDT instead; replicas sync
+ * them with applyUpdate()/encodeStateAsUpdate() and the session still
+ * accepts line/character operations, applied at the current head.
+ *
+ * With a DocumentStore attached every applied edit is appended to the
+ * document's op log and a snapshot is taken every snapshot interval, so
+ * recoverDocument() can rebuild the document after a restart.
+ */
 class CollaborativeSession {
 public:
     using OperationCallback = std::function<void(const DocumentOperation&, const std::string&)>;
     using UserJoinCallback = std::function<void(const UserSession&, const std::string&)>;
     using UserLeaveCallback = std::function<void(const std::string&, const std::string&)>;
     using CursorUpdateCallback = std::function<void(const std::string&, const Position&, const std::string&)>;
+    using CompletionCallback = std::function<void(bool)>;
+    using DocumentUpdateCallback = std::function<void(const std::vector<uint8_t>&, const std::string&)>;
+    
+    // What a late joiner needs: the latest snapshot, then the edits since it
+    struct JoinState {
+        uint64_t revision = 0;          // Head revision once the tail is applied
+        uint64_t snapshotRevision = 0;
+        std::shared_ptr<const std::string> snapshot;
+        std::vector<DocumentOperation> tail;
+    };
     
     static CollaborativeSession& getInstance() {
         static CollaborativeSession instance;
@@ -55,216 +124,469 @@ public:
     }
     
     // Document management
-    bool createDocument(const std::string& documentId, const std::string& initialContent = "") {
-        std::lock_guard<std::mutex> lock(documentsMutex_);
-        
-        if (documents_.find(documentId) != documents_.end()) {
-            return false; // Document already exists
-        }
-        
-        auto doc = std::make_unique<DocumentState>(documentId);
+    bool createDocument(const std::string& documentId, const std::string& initialContent = "",
+                        DocumentBackend backend = DocumentBackend::OPERATIONAL_TRANSFORM) {
+        auto doc = std::make_shared<DocumentState>(documentId, backend);
         if (!initialContent.empty()) {
-            doc->lines = splitLines(initialContent);
+            if (doc->sequence) {
+                doc->sequence->insert(0, initialContent);
+            } else {
+                doc->text = TextRope(initialContent);
+            }
         }
         
-        documents_[documentId] = std::move(doc);
+        // Locked until the store has the initial snapshot, so no edit is logged before it
+        std::lock_guard<std::mutex> lock(doc->mutex);
+        if (!documents_.insert(documentId, doc)) {
+            return false;
+        }
+        auto store = getDocumentStore();
+        auto snapshot = takeSnapshot(*doc, store != nullptr);
+        if (store) {
+            store->create(documentId, std::move(snapshot));
+        }
         return true;
     }
     
+    // Remove the document, deleting its persisted state
     bool removeDocument(const std::string& documentId) {
-        std::lock_guard<std::mutex> lock(documentsMutex_);
+        return eraseDocument(documentId, true);
+    }
+    
+    // Drop the document from memory but keep its persisted state for recoverDocument()
+    bool closeDocument(const std::string& documentId) {
+        return eraseDocument(documentId, false);
+    }
+    
+    // Persist documents to the given store; nullptr turns persistence off.
+    // Documents already open are only persisted from their next snapshot on.
+    void setDocumentStore(std::shared_ptr<DocumentStore> store) {
+        std::unique_lock lock(callbacksMutex_);
+        store_ = std::move(store);
+    }
+    
+    std::shared_ptr<DocumentStore> getDocumentStore() const {
+        std::shared_lock lock(callbacksMutex_);
+        return store_;
+    }
+    
+    // Edits between snapshots; bounds both the op log replayed on recovery
+    // and the tail sent to late joiners
+    void setSnapshotInterval(size_t operations) {
+        snapshotInterval_ = std::max<size_t>(operations, 1);
+    }
+    
+    // Rebuild a document from the attached store: its snapshot plus the op
+    // log that follows. Fails if the document is already open or not stored.
+    bool recoverDocument(const std::string& documentId) {
+        auto store = getDocumentStore();
+        if (!store || documents_.find(documentId)) {
+            return false;
+        }
+        
+        DocumentSnapshot snapshot;
+        std::vector<LogRecord> records;
+        if (!store->load(documentId, snapshot, records)) {
+            return false;
+        }
+        
+        auto doc = std::make_shared<DocumentState>(documentId, snapshot.backend);
+        if (doc->sequence) {
+            if (!snapshot.state.empty() && !doc->sequence->applyUpdate(snapshot.state)) {
+                return false;
+            }
+        } else {
+            auto content = std::make_shared<const std::string>(snapshot.state.begin(), snapshot.state.end());
+            doc->text = TextRope(*content);
+            doc->snapshotContent = std::move(content);
+        }
+        doc->revision = doc->historyBaseRevision = doc->snapshotRevision = snapshot.revision;
         
-        auto it = documents_.find(documentId);
-        if (it == documents_.end()) {
+        bool replayedAll = true;
+        for (const auto& record : records) {
+            if (doc->sequence) {
+                if (!record.payload.empty() && !doc->sequence->applyUpdate(record.payload)) {
+                    replayedAll = false;
+                    break;
+                }
+            } else {
+                auto operation = DocumentOperation::decodeBinary(std::string(record.payload.begin(), record.payload.end()));
+                if (!operation || !operation->apply(doc->text)) {
+                    replayedAll = false;
+                    break;
+                }
+                doc->operationHistory.push_back(*operation);
+                doc->snapshotTail.push_back(*operation);
+            }
+            doc->revision = record.revision;
+        }
+        
+        std::lock_guard<std::mutex> lock(doc->mutex);
+        if (!documents_.insert(documentId, doc)) {
             return false;
         }
+        if (!replayedAll) {
+            // Records past the failure would clash with new revisions; restart the log here
+            store->create(documentId, takeSnapshot(*doc, true));
+        }
+        return true;
+    }
+    
+    // Recover every stored document that is not open yet
+    size_t recoverDocuments() {
+        auto store = getDocumentStore();
+        if (!store) {
+            return 0;
+        }
         
-        // Notify all users in this document
-        for (const auto& [userId, session] : it->second->activeUsers) {
-            if (userLeaveCallback_) {
-                userLeaveCallback_(userId, documentId);
+        size_t recovered = 0;
+        for (const auto& documentId : store->listDocuments()) {
+            if (recoverDocument(documentId)) {
+                recovered++;
             }
         }
+        return recovered;
+    }
+    
+    // State for a joining client. Cost depends on the document size and the
+    // snapshot interval, never on how many edits the session has seen.
+    // CRDT documents are sent as their current text with no tail.
+    bool getJoinState(const std::string& documentId, JoinState& state) const {
+        auto doc = documents_.find(documentId);
+        if (!doc) {
+            return false;
+        }
         
-        documents_.erase(it);
+        std::lock_guard<std::mutex> lock(doc->mutex);
+        state.revision = doc->revision;
+        if (doc->sequence) {
+            state.snapshotRevision = doc->revision;
+            state.snapshot = std::make_shared<const std::string>(doc->sequence->toString());
+            state.tail.clear();
+        } else {
+            state.snapshotRevision = doc->snapshotRevision;
+            state.snapshot = doc->snapshotContent;
+            state.tail = doc->snapshotTail;
+        }
         return true;
     }
     
     // User management
     bool joinDocument(const std::string& userId, const std::string& userName,
                      const std::string& documentId) {
-        std::lock_guard<std::mutex> lock(documentsMutex_);
-        
-        auto docIt = documents_.find(documentId);
-        if (docIt == documents_.end()) {
+        auto doc = documents_.find(documentId);
+        if (!doc) {
             return false; // Document doesn't exist
         }
         
-        auto& doc = *docIt->second;
-        
-        // Add user to document
-        UserSession session(userId, userName);
-        doc.activeUsers[userId] = session;
-        
-        // Notify other users
-        if (userJoinCallback_) {
-            userJoinCallback_(session, documentId);
+        {
+            std::lock_guard<std::mutex> lock(doc->mutex);
+            if (doc->removed) {
+                return false;
+            }
+            
+            // Add user to document; they receive the state as of the current revision
+            UserSession session(userId, userName, doc->revision);
+            doc->activeUsers[userId] = session;
+            
+            // Notify other users
+            if (auto callback = getUserJoinCallback()) {
+                doc->outbox.push_back([callback, session, documentId]() {
+                    callback(session, documentId);
+                });
+            }
         }
         
+        deliverNotifications(*doc);
         return true;
     }
     
     bool leaveDocument(const std::string& userId, const std::string& documentId) {
-        std::lock_guard<std::mutex> lock(documentsMutex_);
-        
-        auto docIt = documents_.find(documentId);
-        if (docIt == documents_.end()) {
+        auto doc = documents_.find(documentId);
+        if (!doc) {
             return false;
         }
         
-        auto& doc = *docIt->second;
-        auto userIt = doc.activeUsers.find(userId);
-        if (userIt == doc.activeUsers.end()) {
-            return false;
-        }
-        
-        doc.activeUsers.erase(userIt);
-        
-        // Notify other users
-        if (userLeaveCallback_) {
-            userLeaveCallback_(userId, documentId);
+        {
+            std::lock_guard<std::mutex> lock(doc->mutex);
+            
+            auto userIt = doc->activeUsers.find(userId);
+            if (userIt == doc->activeUsers.end()) {
+                return false;
+            }
+            
+            doc->activeUsers.erase(userIt);
+            pruneHistory(*doc);
+            
+            // Notify other users
+            if (auto callback = getUserLeaveCallback()) {
+                doc->outbox.push_back([callback, userId, documentId]() {
+                    callback(userId, documentId);
+                });
+            }
         }
         
+        deliverNotifications(*doc);
         return true;
     }
     
     // Operation handling
+    //
+    // The operation is transformed only against edits applied after its base
+    // revision. Operations without a base revision are treated as generated
+    // against the current head. Operations older than the retained history, and
+    // operations sent while an earlier edit by the same user was still unacknowledged,
+    // are rejected and the client must resynchronize from the document state.
     bool applyOperation(const DocumentOperation& operation, const std::string& documentId) {
-        std::lock_guard<std::mutex> lock(documentsMutex_);
+        auto doc = documents_.find(documentId);
+        if (!doc) {
+            return false;
+        }
         
-        auto docIt = documents_.find(documentId);
-        if (docIt == documents_.end()) {
+        return applyToDocument(*doc, operation);
+    }
+    
+    bool hasDocument(const std::string& documentId) const {
+        return documents_.find(documentId) != nullptr;
+    }
+    
+    DocumentBackend getDocumentBackend(const std::string& documentId) const {
+        auto doc = documents_.find(documentId);
+        return doc ? doc->backend : DocumentBackend::OPERATIONAL_TRANSFORM;
+    }
+    
+    // Merge a binary update from another replica of a sequence CRDT document.
+    // Updates may arrive in any order; ones that depend on missing edits are
+    // held back by the CRDT until those arrive. Returns false for unknown or
+    // non-CRDT documents and malformed updates.
+    bool applyUpdate(const std::string& documentId, const std::vector<uint8_t>& update) {
+        auto doc = documents_.find(documentId);
+        if (!doc) {
             return false;
         }
         
-        auto& doc = *docIt->second;
+        {
+            std::lock_guard<std::mutex> lock(doc->mutex);
+            if (doc->removed || !doc->sequence) {
+                return false;
+            }
+            
+            bool changed = false;
+            if (!doc->sequence->applyUpdate(update, &changed)) {
+                return false;
+            }
+            
+            if (changed) {
+                doc->revision++;
+                recordEdit(*doc, nullptr, update);
+                if (auto callback = getDocumentUpdateCallback()) {
+                    doc->outbox.push_back([callback, update, documentId]() {
+                        callback(update, documentId);
+                    });
+                }
+            }
+        }
         
-        // Create a copy of the operation for transformation
-        auto transformedOp = std::make_unique<DocumentOperation>(operation);
+        deliverNotifications(*doc);
+        return true;
+    }
+    
+    // Encoded state vector of a sequence CRDT document, for requesting a delta
+    std::vector<uint8_t> getStateVector(const std::string& documentId) const {
+        auto doc = documents_.find(documentId);
+        if (!doc) {
+            return {};
+        }
         
-        // Transform against all operations that have occurred since this operation was created
-        for (const auto& historyOp : doc.operationHistory) {
-            if (historyOp->getSequence() > operation.getSequence()) {
-                auto temp = OperationalTransform::transform(*transformedOp, *historyOp);
-                transformedOp = std::move(temp);
-            }
+        std::lock_guard<std::mutex> lock(doc->mutex);
+        return doc->sequence ? doc->sequence->encodeStateVector() : std::vector<uint8_t>{};
+    }
+    
+    // Everything a replica with the given encoded state vector is missing;
+    // an empty state vector yields the full document
+    std::vector<uint8_t> encodeStateAsUpdate(const std::string& documentId,
+                                             const std::vector<uint8_t>& remoteStateVector = {}) const {
+        auto doc = documents_.find(documentId);
+        if (!doc) {
+            return {};
         }
         
-        // Apply the transformed operation
-        bool success = transformedOp->apply(doc.lines);
-        if (success) {
-            // Add to history
-            doc.operationHistory.push_back(
-                std::make_unique<DocumentOperation>(*transformedOp));
-            doc.lastSequence = transformedOp->getSequence();
-            
-            // Update user cursor if it's a cursor move operation
-            if (transformedOp->getType() == OperationType::CURSOR_MOVE) {
-                auto userIt = doc.activeUsers.find(transformedOp->getUserId());
-                if (userIt != doc.activeUsers.end()) {
-                    userIt->second.cursorPosition = transformedOp->getPosition();
-                    userIt->second.lastActivity = std::chrono::steady_clock::now();
-                    
-                    if (cursorUpdateCallback_) {
-                        cursorUpdateCallback_(transformedOp->getUserId(),
-                                            transformedOp->getPosition(), documentId);
-                    }
-                }
+        SequenceCRDT::StateVector remote;
+        if (!SequenceCRDT::decodeStateVector(remoteStateVector, remote)) {
+            return {};
+        }
+        
+        std::lock_guard<std::mutex> lock(doc->mutex);
+        return doc->sequence ? doc->sequence->encodeStateAsUpdate(remote) : std::vector<uint8_t>{};
+    }
+    
+    // Queue an operation on the document's strand; it is applied by the worker
+    // pool in submission order and the completion reports whether it applied.
+    // Returns false immediately if the document does not exist.
+    bool submitOperation(const DocumentOperation& operation, const std::string& documentId,
+                         CompletionCallback completion = nullptr) {
+        auto doc = documents_.find(documentId);
+        if (!doc) {
+            if (completion) {
+                completion(false);
             }
-            
-            // Notify listeners
-            if (operationCallback_) {
-                operationCallback_(*transformedOp, documentId);
+            return false;
+        }
+        
+        bool schedule = false;
+        {
+            std::lock_guard<std::mutex> lock(doc->queueMutex);
+            doc->pendingOperations.push_back({operation, std::move(completion)});
+            if (!doc->drainScheduled) {
+                doc->drainScheduled = true;
+                schedule = true;
             }
         }
         
-        return success;
+        if (schedule) {
+            workers_.post([this, doc]() { drainOperations(doc); });
+        }
+        return true;
+    }
+    
+    size_t getPendingOperationCount(const std::string& documentId) const {
+        auto doc = documents_.find(documentId);
+        if (!doc) {
+            return 0;
+        }
+        
+        std::lock_guard<std::mutex> lock(doc->queueMutex);
+        return doc->pendingOperations.size();
+    }
+    
+    // Record that a client has seen every edit up to the given revision,
+    // allowing history below the minimum acknowledged revision to be dropped
+    bool acknowledgeRevision(const std::string& userId, const std::string& documentId, uint64_t revision) {
+        auto doc = documents_.find(documentId);
+        if (!doc) {
+            return false;
+        }
+        
+        std::lock_guard<std::mutex> lock(doc->mutex);
+        auto userIt = doc->activeUsers.find(userId);
+        if (userIt == doc->activeUsers.end() || revision > doc->revision) {
+            return false;
+        }
+        
+        userIt->second.acknowledgedRevision = std::max(userIt->second.acknowledgedRevision, revision);
+        pruneHistory(*doc);
+        return true;
+    }
+    
+    uint64_t getDocumentRevision(const std::string& documentId) const {
+        auto doc = documents_.find(documentId);
+        if (!doc) {
+            return 0;
+        }
+        
+        std::lock_guard<std::mutex> lock(doc->mutex);
+        return doc->revision;
+    }
+    
+    // Upper bound on retained history per document, regardless of acknowledgements
+    void setMaxHistorySize(size_t maxOperations) {
+        maxHistorySize_ = std::max<size_t>(maxOperations, 1);
+        for (const auto& doc : documents_.all()) {
+            std::lock_guard<std::mutex> lock(doc->mutex);
+            pruneHistory(*doc);
+        }
     }
     
     // Get document state
     std::vector<std::string> getDocumentLines(const std::string& documentId) const {
-        std::lock_guard<std::mutex> lock(documentsMutex_);
-        
-        auto it = documents_.find(documentId);
-        if (it != documents_.end()) {
-            return it->second->lines;
+        auto doc = documents_.find(documentId);
+        if (!doc) {
+            return {};
         }
-        return {};
+        
+        std::lock_guard<std::mutex> lock(doc->mutex);
+        return doc->sequence ? doc->sequence->toLines() : doc->text.toLines();
     }
     
     std::string getDocumentContent(const std::string& documentId) const {
-        auto lines = getDocumentLines(documentId);
-        if (lines.empty()) return "";
-        
-        std::string content;
-        for (size_t i = 0; i < lines.size(); ++i) {
-            content += lines[i];
-            if (i < lines.size() - 1) {
-                content += "\n";
-            }
+        auto doc = documents_.find(documentId);
+        if (!doc) {
+            return "";
         }
-        return content;
+        
+        std::lock_guard<std::mutex> lock(doc->mutex);
+        return doc->sequence ? doc->sequence->toString() : doc->text.toString();
     }
     
     // Get active users in document
     std::vector<UserSession> getActiveUsers(const std::string& documentId) const {
-        std::lock_guard<std::mutex> lock(documentsMutex_);
-        
         std::vector<UserSession> users;
-        auto it = documents_.find(documentId);
-        if (it != documents_.end()) {
-            for (const auto& [userId, session] : it->second->activeUsers) {
-                users.push_back(session);
-            }
+        auto doc = documents_.find(documentId);
+        if (!doc) {
+            return users;
+        }
+        
+        std::lock_guard<std::mutex> lock(doc->mutex);
+        for (const auto& [userId, session] : doc->activeUsers) {
+            users.push_back(session);
         }
         return users;
     }
     
     // Callback registration
     void onOperation(OperationCallback callback) {
+        std::unique_lock lock(callbacksMutex_);
         operationCallback_ = callback;
     }
     
     void onUserJoin(UserJoinCallback callback) {
+        std::unique_lock lock(callbacksMutex_);
         userJoinCallback_ = callback;
     }
     
     void onUserLeave(UserLeaveCallback callback) {
+        std::unique_lock lock(callbacksMutex_);
         userLeaveCallback_ = callback;
     }
     
     void onCursorUpdate(CursorUpdateCallback callback) {
+        std::unique_lock lock(callbacksMutex_);
         cursorUpdateCallback_ = callback;
     }
     
+    // Binary CRDT updates produced or merged by sequence CRDT documents, for relaying to replicas
+    void onDocumentUpdate(DocumentUpdateCallback callback) {
+        std::unique_lock lock(callbacksMutex_);
+        documentUpdateCallback_ = callback;
+    }
+    
     // Maintenance
     void cleanupInactiveUsers(std::chrono::seconds inactiveThreshold = std::chrono::seconds(300)) {
-        std::lock_guard<std::mutex> lock(documentsMutex_);
-        
         auto now = std::chrono::steady_clock::now();
+        auto callback = getUserLeaveCallback();
         
-        for (auto& [docId, doc] : documents_) {
-            auto userIt = doc->activeUsers.begin();
-            while (userIt != doc->activeUsers.end()) {
-                if (now - userIt->second.lastActivity > inactiveThreshold) {
-                    if (userLeaveCallback_) {
-                        userLeaveCallback_(userIt->second.userId, docId);
+        for (const auto& doc : documents_.all()) {
+            {
+                std::lock_guard<std::mutex> lock(doc->mutex);
+                
+                auto userIt = doc->activeUsers.begin();
+                while (userIt != doc->activeUsers.end()) {
+                    if (now - userIt->second.lastActivity > inactiveThreshold) {
+                        if (callback) {
+                            doc->outbox.push_back([callback, userId = userIt->second.userId,
+                                                   documentId = doc->documentId]() {
+                                callback(userId, documentId);
+                            });
+                        }
+                        userIt = doc->activeUsers.erase(userIt);
+                    } else {
+                        ++userIt;
                     }
-                    userIt = doc->activeUsers.erase(userIt);
-                } else {
-                    ++userIt;
                 }
+                pruneHistory(*doc);
             }
+            
+            deliverNotifications(*doc);
         }
     }
     
@@ -272,48 +594,342 @@ public:
     struct SessionStats {
         size_t totalDocuments;
         size_t totalActiveUsers;
-        size_t totalOperations;
+        size_t totalOperations;     // Edits applied over the session lifetime
+        size_t retainedOperations;  // Edits still held for transformation
     };
     
     SessionStats getStats() const {
-        std::lock_guard<std::mutex> lock(documentsMutex_);
+        SessionStats stats = {0, 0, 0, 0};
         
-        SessionStats stats = {0, 0, 0};
-        stats.totalDocuments = documents_.size();
-        
-        for (const auto& [docId, doc] : documents_) {
+        for (const auto& doc : documents_.all()) {
+            std::lock_guard<std::mutex> lock(doc->mutex);
+            stats.totalDocuments++;
             stats.totalActiveUsers += doc->activeUsers.size();
-            stats.totalOperations += doc->operationHistory.size();
+            stats.totalOperations += doc->revision;
+            stats.retainedOperations += doc->operationHistory.size();
         }
         
         return stats;
     }
 
 private:
+    static constexpr size_t DEFAULT_MAX_HISTORY_SIZE = 10000;
+    // Operations applied per drain task before yielding the worker to other documents
+    static constexpr size_t MAX_OPERATIONS_PER_DRAIN = 64;
+    static constexpr size_t DEFAULT_SNAPSHOT_INTERVAL = 1000;
+    
     CollaborativeSession() = default;
     
-    std::vector<std::string> splitLines(const std::string& content) const {
-        std::vector<std::string> lines;
-        std::string line;
-        for (char c : content) {
-            if (c == '\n') {
-                lines.push_back(line);
-                line.clear();
+    bool eraseDocument(const std::string& documentId, bool deletePersisted) {
+        auto doc = documents_.erase(documentId);
+        if (!doc) {
+            return false;
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(doc->mutex);
+            doc->removed = true;
+            if (auto store = getDocumentStore()) {
+                if (deletePersisted) {
+                    store->remove(documentId);
+                } else {
+                    store->flush();
+                }
+            }
+            
+            // Notify all users in this document
+            if (auto callback = getUserLeaveCallback()) {
+                for (const auto& [userId, session] : doc->activeUsers) {
+                    doc->outbox.push_back([callback, userId = userId, documentId]() {
+                        callback(userId, documentId);
+                    });
+                }
+            }
+        }
+        
+        deliverNotifications(*doc);
+        return true;
+    }
+    
+    bool applyToDocument(DocumentState& doc, const DocumentOperation& operation) {
+        bool success = false;
+        {
+            std::lock_guard<std::mutex> lock(doc.mutex);
+            if (doc.removed) {
+                return false;
+            }
+            
+            uint64_t baseRevision = operation.hasBaseRevision() ? operation.getBaseRevision() : doc.revision;
+            if (baseRevision > doc.revision) {
+                return false;
+            }
+            
+            DocumentOperation transformedOp(operation);
+            std::vector<uint8_t> update;
+            if (doc.sequence) {
+                // CRDT replicas converge through updates; line/character edits apply at head
+                transformedOp.setBaseRevision(doc.revision);
+                success = applyToSequence(*doc.sequence, transformedOp, update);
             } else {
-                line += c;
+                if (baseRevision < doc.historyBaseRevision) {
+                    return false;
+                }
+                
+                // Clients keep one edit in flight. An edit based on a revision
+                // before the author's previous one is pipelined: concurrent edits
+                // ahead of that one are not in the coordinates it was written in,
+                // so it is rejected and the client resyncs
+                size_t firstConcurrent = static_cast<size_t>(baseRevision - doc.historyBaseRevision);
+                for (size_t i = firstConcurrent; i < doc.operationHistory.size(); ++i) {
+                    if (doc.operationHistory[i].getUserId() == operation.getUserId()) {
+                        return false;
+                    }
+                }
+
+                // Transform against the concurrent edits the client had not yet seen
+                for (size_t i = firstConcurrent; i < doc.operationHistory.size(); ++i) {
+                    transformedOp = *OperationalTransform::transform(transformedOp, doc.operationHistory[i]);
+                }
+                transformedOp.setBaseRevision(doc.revision);
+                
+                // Apply the transformed operation
+                success = transformedOp.apply(doc.text);
+            }
+            if (success) {
+                doc.lastSequence = transformedOp.getSequence();
+                
+                auto userIt = doc.activeUsers.find(transformedOp.getUserId());
+                if (userIt != doc.activeUsers.end()) {
+                    // An operation without a base revision (a cursor move) says nothing
+                    // about what the client has seen; counting it as head would let
+                    // history its in-flight edits still need be pruned
+                    if (operation.hasBaseRevision()) {
+                        userIt->second.acknowledgedRevision = std::max(userIt->second.acknowledgedRevision,
+                                                                       baseRevision);
+                    }
+                    userIt->second.lastActivity = std::chrono::steady_clock::now();
+                }
+                
+                if (transformedOp.getType() == OperationType::CURSOR_MOVE) {
+                    // Cursor moves don't change the document, so they get no revision
+                    if (userIt != doc.activeUsers.end()) {
+                        userIt->second.cursorPosition = transformedOp.getPosition();
+                        
+                        if (auto callback = getCursorUpdateCallback()) {
+                            doc.outbox.push_back([callback, userId = transformedOp.getUserId(),
+                                                  position = transformedOp.getPosition(),
+                                                  documentId = doc.documentId]() {
+                                callback(userId, position, documentId);
+                            });
+                        }
+                    }
+                } else if (transformedOp.getType() != OperationType::NOOP) {
+                    if (!doc.sequence) {
+                        doc.operationHistory.push_back(transformedOp);
+                    }
+                    doc.revision++;
+                    recordEdit(doc, &transformedOp, update);
+                    pruneHistory(doc);
+                }
+                
+                if (!update.empty()) {
+                    if (auto callback = getDocumentUpdateCallback()) {
+                        doc.outbox.push_back([callback, update = std::move(update), documentId = doc.documentId]() {
+                            callback(update, documentId);
+                        });
+                    }
+                }
+                
+                // Notify listeners
+                if (auto callback = getOperationCallback()) {
+                    doc.outbox.push_back([callback, transformedOp, documentId = doc.documentId]() {
+                        callback(transformedOp, documentId);
+                    });
+                }
             }
         }
-        lines.push_back(line); // Add last line
-        return lines;
+        
+        deliverNotifications(doc);
+        return success;
     }
     
-    mutable std::mutex documentsMutex_;
-    std::map<std::string, std::unique_ptr<DocumentState>> documents_;
+    // Track a freshly applied edit for late joiners and the op log, and
+    // snapshot once enough edits have piled up. Caller holds doc.mutex.
+    void recordEdit(DocumentState& doc, const DocumentOperation* operation, const std::vector<uint8_t>& update) {
+        if (operation && !doc.sequence) {
+            doc.snapshotTail.push_back(*operation);
+        }
+        
+        auto store = getDocumentStore();
+        if (store) {
+            LogRecord record;
+            record.revision = doc.revision;
+            if (doc.sequence) {
+                record.payload = update;
+            } else if (operation) {
+                std::string encoded = operation->encodeBinary();
+                record.payload.assign(encoded.begin(), encoded.end());
+            }
+            store->append(doc.documentId, record);
+        }
+        
+        if (doc.revision - doc.snapshotRevision >= snapshotInterval_.load()) {
+            auto snapshot = takeSnapshot(doc, store != nullptr);
+            if (store) {
+                store->saveSnapshot(doc.documentId, std::move(snapshot));
+            }
+        }
+    }
+    
+    // Restart the snapshot tail at the current revision; CRDT state is only
+    // encoded when it is going to be persisted. Caller holds doc.mutex.
+    DocumentSnapshot takeSnapshot(DocumentState& doc, bool persist) {
+        DocumentSnapshot snapshot;
+        snapshot.backend = doc.backend;
+        snapshot.revision = doc.revision;
+        if (doc.sequence) {
+            if (persist) {
+                snapshot.state = doc.sequence->encodeStateAsUpdate({});
+            }
+        } else {
+            auto content = std::make_shared<const std::string>(doc.text.toString());
+            snapshot.state.assign(content->begin(), content->end());
+            doc.snapshotContent = std::move(content);
+        }
+        doc.snapshotRevision = doc.revision;
+        doc.snapshotTail.clear();
+        return snapshot;
+    }
     
+    // Line/character operation on a CRDT document, validated like
+    // DocumentOperation::apply on a rope
+    static bool applyToSequence(SequenceCRDT& sequence, const DocumentOperation& operation,
+                                std::vector<uint8_t>& update) {
+        const Position& pos = operation.getPosition();
+        if (operation.getType() == OperationType::CURSOR_MOVE || operation.getType() == OperationType::NOOP) {
+            return true;
+        }
+        if (pos.line >= sequence.lineCount() || pos.character > sequence.lineLength(pos.line)) {
+            return false;
+        }
+        
+        size_t offset = sequence.lineStart(pos.line) + pos.character;
+        if (operation.getType() == OperationType::INSERT) {
+            return sequence.insert(offset, operation.getContent(), &update);
+        }
+        return !operation.getContent().empty() && sequence.erase(offset, operation.getContent().length(), &update);
+    }
+    
+    void drainOperations(const std::shared_ptr<DocumentState>& doc) {
+        for (size_t processed = 0; processed < MAX_OPERATIONS_PER_DRAIN; ++processed) {
+            std::unique_ptr<DocumentState::PendingOperation> pending;
+            {
+                std::lock_guard<std::mutex> lock(doc->queueMutex);
+                if (doc->pendingOperations.empty()) {
+                    doc->drainScheduled = false;
+                    return;
+                }
+                pending = std::make_unique<DocumentState::PendingOperation>(
+                    std::move(doc->pendingOperations.front()));
+                doc->pendingOperations.pop_front();
+            }
+            
+            bool success = applyToDocument(*doc, pending->operation);
+            if (pending->completion) {
+                pending->completion(success);
+            }
+        }
+        
+        // Still busy: requeue behind other documents instead of monopolizing a worker
+        workers_.post([this, doc]() { drainOperations(doc); });
+    }
+    
+    // Run queued notifications outside the document lock. Only one thread
+    // delivers for a document at a time, which keeps callbacks in order;
+    // notifications queued by re-entrant calls are picked up by the same loop.
+    void deliverNotifications(DocumentState& doc) {
+        std::vector<std::function<void()>> batch;
+        {
+            std::lock_guard<std::mutex> lock(doc.mutex);
+            if (doc.delivering || doc.outbox.empty()) {
+                return;
+            }
+            doc.delivering = true;
+        }
+        
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(doc.mutex);
+                if (doc.outbox.empty()) {
+                    doc.delivering = false;
+                    return;
+                }
+                batch.swap(doc.outbox);
+            }
+            
+            for (auto& notify : batch) {
+                notify();
+            }
+            batch.clear();
+        }
+    }
+    
+    // Drop history every active client has acknowledged, then enforce the hard cap.
+    // Clients whose base revision falls below the retained window must resync.
+    void pruneHistory(DocumentState& doc) {
+        uint64_t minAcknowledged = doc.revision;
+        for (const auto& [userId, user] : doc.activeUsers) {
+            minAcknowledged = std::min(minAcknowledged, user.acknowledgedRevision);
+        }
+        
+        size_t maxHistory = maxHistorySize_.load();
+        while (!doc.operationHistory.empty() &&
+               (doc.historyBaseRevision < minAcknowledged ||
+                doc.operationHistory.size() > maxHistory)) {
+            doc.operationHistory.pop_front();
+            doc.historyBaseRevision++;
+        }
+    }
+    
+    OperationCallback getOperationCallback() const {
+        std::shared_lock lock(callbacksMutex_);
+        return operationCallback_;
+    }
+    
+    UserJoinCallback getUserJoinCallback() const {
+        std::shared_lock lock(callbacksMutex_);
+        return userJoinCallback_;
+    }
+    
+    UserLeaveCallback getUserLeaveCallback() const {
+        std::shared_lock lock(callbacksMutex_);
+        return userLeaveCallback_;
+    }
+    
+    CursorUpdateCallback getCursorUpdateCallback() const {
+        std::shared_lock lock(callbacksMutex_);
+        return cursorUpdateCallback_;
+    }
+    
+    DocumentUpdateCallback getDocumentUpdateCallback() const {
+        std::shared_lock lock(callbacksMutex_);
+        return documentUpdateCallback_;
+    }
+    
+    ShardedDocumentRegistry<DocumentState> documents_;
+    std::atomic<size_t> maxHistorySize_{DEFAULT_MAX_HISTORY_SIZE};
+    std::atomic<size_t> snapshotInterval_{DEFAULT_SNAPSHOT_INTERVAL};
+    
+    mutable std::shared_mutex callbacksMutex_;
     OperationCallback operationCallback_;
     UserJoinCallback userJoinCallback_;
     UserLeaveCallback userLeaveCallback_;
     CursorUpdateCallback cursorUpdateCallback_;
+    DocumentUpdateCallback documentUpdateCallback_;
+    std::shared_ptr<DocumentStore> store_;
+    
+    // Declared last so worker threads are joined before the state they touch is destroyed
+    CollaborationWorkerPool workers_;
 };
 
 } // namespace collaboration
@@ -1,6 +1,8 @@
 #ifndef DOCUMENT_OPERATION_HPP
 #define DOCUMENT_OPERATION_HPP
 
+#include "binary_encoding.hpp"
+#include "text_rope.hpp"
 #include <string>
 #include <vector>
 #include <memory>
@@ -8,6 +10,8 @@
 #include <iostream>
 #include <cctype>
 #include <algorithm>
+#include <limits>
+#include <atomic>
 
 // Windows compatibility: undefine conflicting macros
 #ifdef _WIN32
@@ -68,15 +72,29 @@ struct Position {
         }
         return Position(lines.size(), 0);
     }
+    
+    // O(log n) equivalents through the rope's line index
+    size_t toLinear(const TextRope& text) const {
+        return text.lineStart(line) + std::min(character, text.lineLength(line));
+    }
+    
+    static Position fromLinear(size_t linear, const TextRope& text) {
+        size_t line = text.lineOf(linear);
+        return Position(line, std::min(linear, text.length()) - text.lineStart(line));
+    }
 };
 
 class DocumentOperation {
 public:
+    // Base revision meaning "generated against the latest document state"
+    static constexpr uint64_t HEAD_REVISION = std::numeric_limits<uint64_t>::max();
+    
     DocumentOperation(OperationType type, const std::string& userId, 
-                     const Position& pos, const std::string& content = "")
+                     const Position& pos, const std::string& content = "",
+                     uint64_t baseRevision = HEAD_REVISION)
         : type_(type), userId_(userId), position_(pos), content_(content),
           timestamp_(std::chrono::steady_clock::now()),
-          sequence_(nextSequence()) {}
+          sequence_(nextSequence()), baseRevision_(baseRevision) {}
     
     virtual ~DocumentOperation() = default;
     
@@ -86,9 +104,16 @@ public:
     const std::string& getContent() const { return content_; }
     uint64_t getSequence() const { return sequence_; }
     
+    // Document revision the operation was generated against
+    uint64_t getBaseRevision() const { return baseRevision_; }
+    bool hasBaseRevision() const { return baseRevision_ != HEAD_REVISION; }
+    
     void setPosition(const Position& pos) { position_ = pos; }
+    void setContent(const std::string& content) { content_ = content; }
+    void setBaseRevision(uint64_t revision) { baseRevision_ = revision; }
     
-    // Apply operation to document lines
+    // Apply operation to document lines. Kept for line-vector callers: out of
+    // range inserts are padded and edits never cross line boundaries.
     virtual bool apply(std::vector<std::string>& lines) const {
         switch (type_) {
             case OperationType::INSERT:
@@ -103,6 +128,37 @@ public:
         return false;
     }
     
+    // Apply to a rope. The position is resolved to a linear offset and must
+    // be valid: the line has to exist and the character must not be past
+    // its end. Inserted text may contain newlines, and a delete may run
+    // across line ends as long as it stays inside the document. A delete
+    // whose text a concurrent one already removed is empty and changes nothing.
+    virtual bool apply(TextRope& text) const {
+        switch (type_) {
+            case OperationType::INSERT: {
+                size_t offset;
+                return resolveOffset(text, offset) && text.insert(offset, content_);
+            }
+            case OperationType::DELETE: {
+                size_t offset;
+                return resolveOffset(text, offset) && text.erase(offset, content_.length());
+            }
+            case OperationType::CURSOR_MOVE:
+            case OperationType::NOOP:
+                return true;
+        }
+        return false;
+    }
+    
+    // Linear offset of the position, or false if it lies outside the text
+    bool resolveOffset(const TextRope& text, size_t& offset) const {
+        if (position_.line >= text.lineCount() || position_.character > text.lineLength(position_.line)) {
+            return false;
+        }
+        offset = text.lineStart(position_.line) + position_.character;
+        return true;
+    }
+    
     // Create inverse operation
     virtual std::unique_ptr<DocumentOperation> createInverse() const {
         switch (type_) {
@@ -127,10 +183,51 @@ public:
                   ",\"character\":" + std::to_string(position_.character) + "},";
         result += "\"content\":\"" + escapeString(content_) + "\",";
         result += "\"sequence\":" + std::to_string(sequence_);
+        if (hasBaseRevision()) {
+            result += ",\"baseRevision\":" + std::to_string(baseRevision_);
+        }
         result += "}";
         return result;
     }
     
+    // Compact binary form used by the binary wire protocol: varint type,
+    // position and base revision (0 meaning head), length-prefixed strings
+    void encode(BinaryWriter& writer) const {
+        writer.writeVarUInt(static_cast<uint64_t>(type_));
+        writer.writeString(userId_);
+        writer.writeVarUInt(position_.line);
+        writer.writeVarUInt(position_.character);
+        writer.writeString(content_);
+        writer.writeVarUInt(hasBaseRevision() ? baseRevision_ + 1 : 0);
+    }
+    
+    std::string encodeBinary() const {
+        BinaryWriter writer;
+        encode(writer);
+        return writer.toString();
+    }
+    
+    // Returns nullptr for truncated or invalid input
+    static std::unique_ptr<DocumentOperation> decode(BinaryReader& reader) {
+        uint64_t type, line, character, baseRevision;
+        std::string userId, content;
+        if (!reader.readVarUInt(type) || type > static_cast<uint64_t>(OperationType::NOOP) ||
+            !reader.readString(userId) || !reader.readVarUInt(line) || !reader.readVarUInt(character) ||
+            !reader.readString(content) || !reader.readVarUInt(baseRevision)) {
+            return nullptr;
+        }
+        
+        return std::make_unique<DocumentOperation>(
+            static_cast<OperationType>(type), userId, Position(line, character), content,
+            baseRevision == 0 ? HEAD_REVISION : baseRevision - 1);
+    }
+    
+    static std::unique_ptr<DocumentOperation> decodeBinary(const std::string& data) {
+        BinaryReader reader(data);
+        auto operation = decode(reader);
+        return operation && reader.atEnd() ? std::move(operation) : nullptr;
+    }
+    
     // Deserialize from JSON-like string (simplified)
     static std::unique_ptr<DocumentOperation> deserialize(const std::string& data) {
         // Simplified JSON parsing - in production would use proper JSON library
@@ -139,9 +236,11 @@ public:
         auto line = extractInt(data, "position\":{\"line");
         auto character = extractInt(data, "character");
         auto content = extractString(data, "content");
+        auto baseRevision = extractUInt64(data, "baseRevision", HEAD_REVISION);
         
         return std::make_unique<DocumentOperation>(
-            static_cast<OperationType>(type), userId, Position(line, character), content);
+            static_cast<OperationType>(type), userId, Position(line, character), content,
+            baseRevision);
     }
 
 private:
@@ -151,9 +250,11 @@ private:
     std::string content_;
     std::chrono::steady_clock::time_point timestamp_;
     uint64_t sequence_;
+    uint64_t baseRevision_;
     
     static uint64_t nextSequence() {
-        static uint64_t counter = 0;
+        // Operations are created on many connection threads at once
+        static std::atomic<uint64_t> counter{0};
         return ++counter;
     }
     
@@ -199,7 +300,7 @@ private:
     static int extractInt(const std::string& data, const std::string& key) {
         auto pos = data.find("\"" + key + "\":");
         if (pos == std::string::npos) return 0;
-        pos = data.find(":", pos) + 1;
+        pos += key.length() + 3; // Skip past the quoted key and colon; keys may contain colons
         
         // Skip whitespace
         while (pos < data.length() && std::isspace(data[pos])) pos++;
@@ -222,6 +323,18 @@ private:
         }
     }
     
+    static uint64_t extractUInt64(const std::string& data, const std::string& key, uint64_t defaultValue) {
+        auto pos = data.find("\"" + key + "\":");
+        if (pos == std::string::npos) return defaultValue;
+        pos += key.length() + 3;
+        
+        try {
+            return std::stoull(data.substr(pos));
+        } catch (...) {
+            return defaultValue;
+        }
+    }
+    
     static std::string extractString(const std::string& data, const std::string& key) {
         auto pos = data.find("\"" + key + "\":\"");
         if (pos == std::string::npos) return "";
@@ -0,0 +1,174 @@
+#ifndef DOCUMENT_REGISTRY_HPP
+#define DOCUMENT_REGISTRY_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace bolt {
+namespace collaboration {
+
+/**
+ * Concurrent map from document id to document state.
+ *
+ * Documents are spread over independently locked shards so lookups for
+ * unrelated documents never contend; the shard lock is only held for the
+ * map operation itself, never while a document is being edited.
+ */
+template<typename Document>
+class ShardedDocumentRegistry {
+public:
+    static constexpr size_t SHARD_COUNT = 32;
+
+    std::shared_ptr<Document> find(const std::string& documentId) const {
+        const auto& shard = shardFor(documentId);
+        std::shared_lock lock(shard.mutex);
+        auto it = shard.documents.find(documentId);
+        return it != shard.documents.end() ? it->second : nullptr;
+    }
+
+    // Returns false if a document with this id is already registered
+    bool insert(const std::string& documentId, std::shared_ptr<Document> document) {
+        auto& shard = shardFor(documentId);
+        std::unique_lock lock(shard.mutex);
+        return shard.documents.emplace(documentId, std::move(document)).second;
+    }
+
+    std::shared_ptr<Document> erase(const std::string& documentId) {
+        auto& shard = shardFor(documentId);
+        std::unique_lock lock(shard.mutex);
+        auto it = shard.documents.find(documentId);
+        if (it == shard.documents.end()) {
+            return nullptr;
+        }
+        auto document = std::move(it->second);
+        shard.documents.erase(it);
+        return document;
+    }
+
+    // Snapshot of all registered documents; callers lock each document themselves
+    std::vector<std::shared_ptr<Document>> all() const {
+        std::vector<std::shared_ptr<Document>> documents;
+        for (const auto& shard : shards_) {
+            std::shared_lock lock(shard.mutex);
+            for (const auto& [id, document] : shard.documents) {
+                documents.push_back(document);
+            }
+        }
+        return documents;
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (const auto& shard : shards_) {
+            std::shared_lock lock(shard.mutex);
+            total += shard.documents.size();
+        }
+        return total;
+    }
+
+private:
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<Document>> documents;
+    };
+
+    std::array<Shard, SHARD_COUNT> shards_;
+
+    Shard& shardFor(const std::string& documentId) {
+        return shards_[std::hash<std::string>{}(documentId) % SHARD_COUNT];
+    }
+
+    const Shard& shardFor(const std::string& documentId) const {
+        return shards_[std::hash<std::string>{}(documentId) % SHARD_COUNT];
+    }
+};
+
+/**
+ * Small fixed-size worker pool that drains per-document operation queues.
+ * Threads are started on first use so purely synchronous users pay nothing.
+ */
+class CollaborationWorkerPool {
+public:
+    explicit CollaborationWorkerPool(size_t threadCount = 0)
+        : threadCount_(threadCount > 0 ? threadCount
+                                       : std::max(2u, std::thread::hardware_concurrency())),
+          stopping_(false) {}
+
+    ~CollaborationWorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        condition_.notify_all();
+        for (auto& worker : workers_) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+    CollaborationWorkerPool(const CollaborationWorkerPool&) = delete;
+    CollaborationWorkerPool& operator=(const CollaborationWorkerPool&) = delete;
+
+    // Once the pool is stopping, tasks run inline on the caller so queued
+    // operations still complete and their callbacks still fire
+    void post(std::function<void()> task) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (stopping_) {
+                lock.unlock();
+                task();
+                return;
+            }
+            if (workers_.empty()) {
+                for (size_t i = 0; i < threadCount_; ++i) {
+                    workers_.emplace_back([this]() { workerLoop(); });
+                }
+            }
+            tasks_.push(std::move(task));
+        }
+        condition_.notify_one();
+    }
+
+    size_t getThreadCount() const { return threadCount_; }
+
+private:
+    void workerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                condition_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+                if (stopping_ && tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop();
+            }
+            task();
+        }
+    }
+
+    size_t threadCount_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::queue<std::function<void()>> tasks_;
+    std::vector<std::thread> workers_;
+    bool stopping_;
+};
+
+} // namespace collaboration
+} // namespace bolt
+
+#endif
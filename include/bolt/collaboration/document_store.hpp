@@ -0,0 +1,598 @@
+#ifndef DOCUMENT_STORE_HPP
+#define DOCUMENT_STORE_HPP
+
+#include "binary_encoding.hpp"
+#include "operation_batcher.hpp"
+#include "../network/message_compression.hpp"
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace bolt {
+namespace collaboration {
+
+// How concurrent edits to a document are reconciled
+enum class DocumentBackend {
+    OPERATIONAL_TRANSFORM,  // Server transforms line/character operations against history
+    SEQUENCE_CRDT           // Replicas exchange CRDT updates; suited to large multi-site sessions
+};
+
+// One applied edit in a document's op log
+struct LogRecord {
+    uint64_t revision = 0;          // Document revision this edit produced
+    std::vector<uint8_t> payload;   // Encoded DocumentOperation, or a CRDT update
+};
+
+// Full document state at a revision; the op log holds everything after it
+struct DocumentSnapshot {
+    DocumentBackend backend = DocumentBackend::OPERATIONAL_TRANSFORM;
+    uint64_t revision = 0;
+    std::vector<uint8_t> state;     // Document text, or the full CRDT state as an update
+};
+
+/**
+ * Durable storage for collaborative documents.
+ *
+ * Every document has a snapshot file and an append-only op log next to it.
+ * Appended records are buffered and written by a background thread that
+ * syncs each touched log once per interval, so a burst of edits costs one
+ * fsync rather than one per keystroke. Snapshots are gzip-compressed when
+ * that helps, replaced atomically, and compact the log down to the records
+ * newer than the snapshot. Recovery reads the snapshot and replays the log,
+ * stopping at the first torn or corrupt record.
+ *
+ * Records are durable once flush() returns true or one sync interval after
+ * they were appended; a zero interval syncs on every append. Writes that
+ * fail stay buffered ahead of newer ones and are retried on the next flush;
+ * the background thread keeps retrying once per interval.
+ */
+class DocumentStore {
+public:
+    static constexpr std::chrono::milliseconds DEFAULT_SYNC_INTERVAL{5};
+
+    struct StoreStats {
+        size_t appendedRecords = 0;
+        size_t syncs = 0;             // fsync calls on op logs
+        size_t snapshotsWritten = 0;
+        size_t bytesWritten = 0;
+        size_t discardedBytes = 0;    // Torn log tails dropped during load
+        size_t failedWrites = 0;      // Document writes that failed and were requeued
+    };
+
+    explicit DocumentStore(const std::string& directory,
+                           std::chrono::milliseconds syncInterval = DEFAULT_SYNC_INTERVAL)
+        : directory_(directory), syncInterval_(syncInterval), compressor_(CompressionType::GZIP) {}
+
+    ~DocumentStore() {
+        flusher_.stop();
+        flush();
+        std::lock_guard<std::mutex> lock(ioMutex_);
+        for (auto& [documentId, fd] : logFiles_) {
+            ::close(fd);
+        }
+    }
+
+    DocumentStore(const DocumentStore&) = delete;
+    DocumentStore& operator=(const DocumentStore&) = delete;
+
+    // Create the directory and start group commit
+    bool open() {
+        std::error_code ec;
+        std::filesystem::create_directories(directory_, ec);
+        if (ec || !std::filesystem::is_directory(directory_, ec)) {
+            return false;
+        }
+        if (syncInterval_.count() > 0 && !flusher_.isRunning()) {
+            flusher_.start(syncInterval_, [this]() {
+                if (!flush()) {
+                    flusher_.schedule();
+                }
+            });
+        }
+        return true;
+    }
+
+    const std::string& getDirectory() const { return directory_; }
+
+    void append(const std::string& documentId, const LogRecord& record) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            encodeRecord(record, pending_[documentId].log);
+            stats_.appendedRecords++;
+        }
+        scheduleFlush();
+    }
+
+    // Replace the document's snapshot; log records up to its revision are dropped
+    void saveSnapshot(const std::string& documentId, DocumentSnapshot snapshot) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_[documentId].snapshot = std::make_unique<DocumentSnapshot>(std::move(snapshot));
+        }
+        scheduleFlush();
+    }
+
+    // Start a document afresh, discarding any log left by an earlier document with this id
+    void create(const std::string& documentId, DocumentSnapshot snapshot) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& pending = pending_[documentId];
+            pending.log.clear();
+            pending.reset = true;
+            pending.snapshot = std::make_unique<DocumentSnapshot>(std::move(snapshot));
+        }
+        scheduleFlush();
+    }
+
+    // Write and sync everything appended so far. On failure the unwritten
+    // part is kept for the next flush and false is returned.
+    bool flush() {
+        std::lock_guard<std::mutex> ioLock(ioMutex_);
+        std::map<std::string, PendingWrites> pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending.swap(pending_);
+        }
+
+        std::map<std::string, PendingWrites> failed;
+        for (auto& [documentId, writes] : pending) {
+            if (!writeDocument(documentId, writes)) {
+                failed.emplace(documentId, std::move(writes));
+            }
+        }
+        if (failed.empty()) {
+            return true;
+        }
+
+        // Failed writes are older than anything appended meanwhile
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& [documentId, writes] : failed) {
+            stats_.failedWrites++;
+            auto it = pending_.find(documentId);
+            if (it == pending_.end()) {
+                pending_.emplace(documentId, std::move(writes));
+            } else if (!it->second.reset) {
+                PendingWrites& newer = it->second;
+                writes.log.insert(writes.log.end(), newer.log.begin(), newer.log.end());
+                newer.log.swap(writes.log);
+                newer.reset = writes.reset;
+                if (!newer.snapshot) {
+                    newer.snapshot = std::move(writes.snapshot);
+                }
+            }
+            // A newer create() supersedes whatever failed
+        }
+        return false;
+    }
+
+    // Latest snapshot plus the consecutive log records that follow it.
+    // A torn record at the end of the log is truncated away.
+    bool load(const std::string& documentId, DocumentSnapshot& snapshot, std::vector<LogRecord>& records) {
+        std::lock_guard<std::mutex> ioLock(ioMutex_);
+        if (!readSnapshot(snapshotPath(documentId), snapshot)) {
+            return false;
+        }
+
+        records.clear();
+        std::string logPathName = logPath(documentId);
+        size_t validBytes = 0;
+        size_t fileBytes = readLog(logPathName, records, validBytes);
+        if (validBytes < fileBytes) {
+            closeLog(documentId);
+            std::error_code ec;
+            std::filesystem::resize_file(logPathName, validBytes, ec);
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.discardedBytes += fileBytes - validBytes;
+        }
+
+        // Records at or below the snapshot survive a crash between snapshot and compaction
+        std::vector<LogRecord> tail;
+        uint64_t expected = snapshot.revision + 1;
+        for (auto& record : records) {
+            if (record.revision < expected) {
+                continue;
+            }
+            if (record.revision != expected) {
+                break;
+            }
+            tail.push_back(std::move(record));
+            expected++;
+        }
+        records.swap(tail);
+        return true;
+    }
+
+    bool contains(const std::string& documentId) const {
+        std::error_code ec;
+        return std::filesystem::exists(snapshotPath(documentId), ec);
+    }
+
+    std::vector<std::string> listDocuments() const {
+        std::vector<std::string> documents;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(directory_, ec)) {
+            if (entry.path().extension() == SNAPSHOT_EXTENSION) {
+                std::string documentId;
+                if (decodeFileName(entry.path().stem().string(), documentId)) {
+                    documents.push_back(documentId);
+                }
+            }
+        }
+        return documents;
+    }
+
+    // Delete the document's files and anything still buffered for it
+    bool remove(const std::string& documentId) {
+        std::lock_guard<std::mutex> ioLock(ioMutex_);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_.erase(documentId);
+        }
+        closeLog(documentId);
+        std::error_code ec;
+        bool removed = std::filesystem::remove(snapshotPath(documentId), ec);
+        std::filesystem::remove(logPath(documentId), ec);
+        return removed;
+    }
+
+    std::string snapshotPath(const std::string& documentId) const {
+        return directory_ + "/" + encodeFileName(documentId) + SNAPSHOT_EXTENSION;
+    }
+
+    std::string logPath(const std::string& documentId) const {
+        return directory_ + "/" + encodeFileName(documentId) + LOG_EXTENSION;
+    }
+
+    StoreStats getStats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+private:
+    static constexpr const char* SNAPSHOT_EXTENSION = ".snapshot";
+    static constexpr const char* LOG_EXTENSION = ".oplog";
+    static constexpr const char* SNAPSHOT_MAGIC = "BSNP";
+    static constexpr uint8_t SNAPSHOT_VERSION = 1;
+    static constexpr uint8_t SNAPSHOT_COMPRESSED = 0x01;
+
+    struct PendingWrites {
+        std::vector<uint8_t> log;                     // Encoded records in append order
+        std::unique_ptr<DocumentSnapshot> snapshot;   // Latest requested snapshot
+        bool reset = false;                           // Truncate the log before appending
+    };
+
+    void scheduleFlush() {
+        if (flusher_.isRunning()) {
+            flusher_.schedule();
+        } else {
+            flush();
+        }
+    }
+
+    // Caller holds ioMutex_. Each step clears its part of writes once it is
+    // durable, so on failure writes holds exactly what still has to be done.
+    bool writeDocument(const std::string& documentId, PendingWrites& writes) {
+        if (writes.reset) {
+            closeLog(documentId);
+            std::error_code ec;
+            std::filesystem::remove(logPath(documentId), ec);
+            if (ec) {
+                return false;
+            }
+            writes.reset = false;
+        }
+
+        if (!writes.log.empty()) {
+            int fd = openLog(documentId);
+            if (fd < 0) {
+                return false;
+            }
+            off_t end = ::lseek(fd, 0, SEEK_END);
+            if (end < 0 || !writeAll(fd, writes.log.data(), writes.log.size()) || !syncFile(fd)) {
+                if (end >= 0) {
+                    // Cut off a partial write so the retry doesn't land behind a torn record
+                    int truncated = ::ftruncate(fd, end);
+                    static_cast<void>(truncated);
+                }
+                closeLog(documentId);
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.syncs++;
+            stats_.bytesWritten += writes.log.size();
+            writes.log.clear();
+        }
+
+        if (writes.snapshot) {
+            if (!writeSnapshot(documentId, *writes.snapshot) || !compactLog(documentId, writes.snapshot->revision)) {
+                return false;
+            }
+            writes.snapshot.reset();
+        }
+        return true;
+    }
+
+    bool writeSnapshot(const std::string& documentId, const DocumentSnapshot& snapshot) {
+        std::vector<uint8_t> payload = compressor_.compress(snapshot.state);
+        bool compressed = payload.size() < snapshot.state.size();
+        if (!compressed) {
+            payload = snapshot.state;
+        }
+
+        BinaryWriter writer;
+        writer.writeBytes(SNAPSHOT_MAGIC, 4);
+        writer.writeByte(SNAPSHOT_VERSION);
+        writer.writeByte(static_cast<uint8_t>(snapshot.backend));
+        writer.writeVarUInt(snapshot.revision);
+        writer.writeByte(compressed ? SNAPSHOT_COMPRESSED : 0);
+        writer.writeVarUInt(snapshot.state.size());
+        writer.writeVarUInt(payload.size());
+        writer.writeBytes(payload.data(), payload.size());
+        writeChecksum(writer, checksum(writer.data().data(), writer.size()));
+
+        if (!replaceFile(snapshotPath(documentId), writer.data())) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.snapshotsWritten++;
+        stats_.bytesWritten += writer.size();
+        return true;
+    }
+
+    bool readSnapshot(const std::string& path, DocumentSnapshot& snapshot) {
+        std::vector<uint8_t> bytes;
+        if (!readFile(path, bytes) || bytes.size() < 8 ||
+            checksum(bytes.data(), bytes.size() - 4) != readChecksum(bytes.data() + bytes.size() - 4)) {
+            return false;
+        }
+
+        BinaryReader reader(bytes.data(), bytes.size() - 4);
+        std::string magic;
+        uint8_t version, backend, flags;
+        uint64_t revision, stateLength, payloadLength;
+        std::string payload;
+        if (!reader.readRaw(magic, 4) || magic != SNAPSHOT_MAGIC ||
+            !reader.readByte(version) || version != SNAPSHOT_VERSION ||
+            !reader.readByte(backend) || backend > static_cast<uint8_t>(DocumentBackend::SEQUENCE_CRDT) ||
+            !reader.readVarUInt(revision) || !reader.readByte(flags) ||
+            !reader.readVarUInt(stateLength) || !reader.readVarUInt(payloadLength) ||
+            !reader.readRaw(payload, static_cast<size_t>(payloadLength)) || !reader.atEnd()) {
+            return false;
+        }
+
+        std::vector<uint8_t> state(payload.begin(), payload.end());
+        if (flags & SNAPSHOT_COMPRESSED) {
+            state = compressor_.decompressToBytes(state);
+        }
+        if (state.size() != stateLength) {
+            return false;
+        }
+
+        snapshot.backend = static_cast<DocumentBackend>(backend);
+        snapshot.revision = revision;
+        snapshot.state = std::move(state);
+        return true;
+    }
+
+    // Rewrite the log without the records the snapshot already covers
+    bool compactLog(const std::string& documentId, uint64_t snapshotRevision) {
+        std::string path = logPath(documentId);
+        std::vector<LogRecord> records;
+        size_t validBytes = 0;
+        readLog(path, records, validBytes);
+
+        std::vector<uint8_t> kept;
+        for (const auto& record : records) {
+            if (record.revision > snapshotRevision) {
+                encodeRecord(record, kept);
+            }
+        }
+
+        closeLog(documentId);
+        return replaceFile(path, kept);
+    }
+
+    // Record: varint revision, length-prefixed payload, checksum of both
+    static void encodeRecord(const LogRecord& record, std::vector<uint8_t>& out) {
+        BinaryWriter writer;
+        writer.writeVarUInt(record.revision);
+        writer.writeVarUInt(record.payload.size());
+        writer.writeBytes(record.payload.data(), record.payload.size());
+        writeChecksum(writer, checksum(writer.data().data(), writer.size()));
+        out.insert(out.end(), writer.data().begin(), writer.data().end());
+    }
+
+    // Parses records until the end of the file or the first damaged one;
+    // returns the file size and sets validBytes to the length of the good prefix
+    static size_t readLog(const std::string& path, std::vector<LogRecord>& records, size_t& validBytes) {
+        std::vector<uint8_t> bytes;
+        validBytes = 0;
+        if (!readFile(path, bytes)) {
+            return 0;
+        }
+
+        while (validBytes < bytes.size()) {
+            BinaryReader reader(bytes.data() + validBytes, bytes.size() - validBytes);
+            LogRecord record;
+            uint64_t length;
+            std::string payload;
+            if (!reader.readVarUInt(record.revision) || !reader.readVarUInt(length) ||
+                !reader.readRaw(payload, static_cast<size_t>(length)) || reader.remaining() < 4) {
+                break;
+            }
+
+            size_t recordLength = bytes.size() - validBytes - reader.remaining();
+            const uint8_t* start = bytes.data() + validBytes;
+            if (checksum(start, recordLength) != readChecksum(start + recordLength)) {
+                break;
+            }
+
+            record.payload.assign(payload.begin(), payload.end());
+            records.push_back(std::move(record));
+            validBytes += recordLength + 4;
+        }
+        return bytes.size();
+    }
+
+    // FNV-1a; catches torn writes and bit rot, not tampering
+    static uint32_t checksum(const uint8_t* data, size_t length) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < length; ++i) {
+            hash = (hash ^ data[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    static void writeChecksum(BinaryWriter& writer, uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            writer.writeByte(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    static uint32_t readChecksum(const uint8_t* data) {
+        return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+               (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    }
+
+    // Caller holds ioMutex_
+    int openLog(const std::string& documentId) {
+        auto it = logFiles_.find(documentId);
+        if (it != logFiles_.end()) {
+            return it->second;
+        }
+        int fd = ::open(logPath(documentId).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd >= 0) {
+            logFiles_[documentId] = fd;
+        }
+        return fd;
+    }
+
+    void closeLog(const std::string& documentId) {
+        auto it = logFiles_.find(documentId);
+        if (it != logFiles_.end()) {
+            ::close(it->second);
+            logFiles_.erase(it);
+        }
+    }
+
+    // Write to a temporary file, sync it, then rename over the target so
+    // readers see either the old or the new contents
+    bool replaceFile(const std::string& path, const std::vector<uint8_t>& bytes) {
+        std::string temporary = path + ".tmp";
+        int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = writeAll(fd, bytes.data(), bytes.size()) && syncFile(fd);
+        ::close(fd);
+        if (!ok || ::rename(temporary.c_str(), path.c_str()) != 0) {
+            ::unlink(temporary.c_str());
+            return false;
+        }
+
+        // Make the rename itself durable
+        int dirFd = ::open(directory_.c_str(), O_RDONLY);
+        if (dirFd >= 0) {
+            ::fsync(dirFd);
+            ::close(dirFd);
+        }
+        return true;
+    }
+
+    static bool writeAll(int fd, const uint8_t* data, size_t length) {
+        while (length > 0) {
+            ssize_t written = ::write(fd, data, length);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            length -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    static bool syncFile(int fd) {
+#ifdef __linux__
+        return ::fdatasync(fd) == 0;
+#else
+        return ::fsync(fd) == 0;
+#endif
+    }
+
+    static bool readFile(const std::string& path, std::vector<uint8_t>& bytes) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    // Ids may contain any byte; everything but [A-Za-z0-9_-] is %XX-escaped
+    static std::string encodeFileName(const std::string& documentId) {
+        static const char* hex = "0123456789ABCDEF";
+        std::string name;
+        for (unsigned char c : documentId) {
+            if (std::isalnum(c) || c == '_' || c == '-') {
+                name += static_cast<char>(c);
+            } else {
+                name += '%';
+                name += hex[c >> 4];
+                name += hex[c & 0x0F];
+            }
+        }
+        return name;
+    }
+
+    static bool decodeFileName(const std::string& name, std::string& documentId) {
+        documentId.clear();
+        for (size_t i = 0; i < name.length(); ++i) {
+            if (name[i] != '%') {
+                documentId += name[i];
+                continue;
+            }
+            if (i + 2 >= name.length() || !std::isxdigit(static_cast<unsigned char>(name[i + 1])) ||
+                !std::isxdigit(static_cast<unsigned char>(name[i + 2]))) {
+                return false;
+            }
+            documentId += static_cast<char>(std::stoi(name.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        }
+        return true;
+    }
+
+    std::string directory_;
+    std::chrono::milliseconds syncInterval_;
+
+    // Guards pending_ and stats_; held only briefly by appenders
+    mutable std::mutex mutex_;
+    std::map<std::string, PendingWrites> pending_;
+    StoreStats stats_;
+
+    // Serializes file I/O so flushes land in append order
+    std::mutex ioMutex_;
+    std::map<std::string, int> logFiles_;
+    MessageCompressor compressor_;
+
+    // Declared last so the flush thread stops before the state it touches is destroyed
+    FlushScheduler flusher_;
+};
+
+} // namespace collaboration
+} // namespace bolt
+
+#endif
@@ -0,0 +1,1265 @@
+#ifndef LOAD_GENERATOR_HPP
+#define LOAD_GENERATOR_HPP
+
+#include "collaboration_protocol.hpp"
+#include "document_operation.hpp"
+#include "operation_batcher.hpp"
+#include "operational_transform.hpp"
+#include "text_rope.hpp"
+#include "../network/latency_histogram.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// The generator drives sockets directly and samples the server through /proc
+#ifndef _WIN32
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace bolt {
+namespace collaboration {
+
+struct LoadTestConfig {
+    std::string host = "127.0.0.1";
+    int port = 8081;
+    int serverPid = 0;                  // Sampled for CPU and memory when non-zero (Linux)
+    size_t clients = 100;
+    size_t clientsPerDocument = 10;
+    size_t typistsPerLine = 2;          // Members starting at the same spot of a shared line
+    size_t threads = 4;                 // Client event loops
+    size_t connectRate = 1000;          // New connections per second
+    std::chrono::milliseconds duration{10000};
+
+    // Typing model: log-normal inter-key intervals with occasional pauses
+    std::chrono::milliseconds medianKeyInterval{180};
+    double keyIntervalSpread = 0.5;     // Sigma of the underlying normal distribution
+    double pauseProbability = 0.03;
+    std::chrono::milliseconds meanPause{1500};
+    double typoRate = 0.04;             // Wrong key, corrected with backspace
+    double cursorMoveRate = 0.05;       // Arrow, Home or End instead of a key
+
+    std::chrono::milliseconds cursorInterval{100};  // Presence updates are throttled like editors do
+    std::chrono::milliseconds ackInterval{1000};    // REVISION_ACK cadence
+    std::chrono::milliseconds setupTimeout{30000};
+    std::chrono::milliseconds drainTimeout{10000};
+    uint32_t seed = 1;
+    std::string documentPrefix = "loadtest";
+};
+
+struct LoadTestReport {
+    size_t clients = 0;
+    size_t documents = 0;
+    size_t connectedClients = 0;
+    size_t desyncedClients = 0;         // Lost their connection or saw a protocol error
+    size_t documentsConverged = 0;
+    size_t clientsDiverged = 0;
+
+    double typingSeconds = 0.0;
+    uint64_t keystrokes = 0;
+    uint64_t operationsSent = 0;
+    uint64_t operationsAcknowledged = 0;
+    uint64_t operationsRejected = 0;
+    uint64_t cursorUpdatesSent = 0;
+    uint64_t messagesReceived = 0;
+    uint64_t bytesSent = 0;
+    uint64_t bytesReceived = 0;
+    uint64_t protocolErrors = 0;
+    std::string lastProtocolError;      // Error text from one of the failing clients
+    double keystrokesPerSecond = 0.0;
+    double operationsPerSecond = 0.0;   // Edits acknowledged by the server while typing
+    double messagesPerSecond = 0.0;     // Messages delivered to clients while typing
+
+    // Microseconds
+    HistogramSnapshot propagationLatency;   // Sent by the author until applied by a peer
+    HistogramSnapshot acknowledgementLatency;
+    HistogramSnapshot joinLatency;          // JOIN_DOCUMENT until the document state is loaded
+
+    bool serverSampled = false;
+    double serverCpuCores = 0.0;            // Average cores busy while typing
+    double serverCpuPerClient = 0.0;        // Percent of a core per client
+    uint64_t serverRssBaseline = 0;
+    uint64_t serverRssJoined = 0;
+    uint64_t serverRssEnd = 0;
+    uint64_t serverRssPeak = 0;
+    double serverMemoryPerClient = 0.0;     // Bytes of RSS growth per client at the end of typing
+    double clientCpuSeconds = 0.0;
+
+    std::string error;
+
+    bool converged() const {
+        return error.empty() && connectedClients == clients && desyncedClients == 0 &&
+               clientsDiverged == 0 && documentsConverged == documents;
+    }
+
+    void print(std::ostream& out) const {
+        out << "Clients: " << connectedClients << "/" << clients << " connected, "
+            << documents << " documents\n";
+        if (!error.empty()) {
+            out << "Error: " << error << "\n";
+        }
+        out << std::fixed << std::setprecision(1);
+        out << "Typing: " << typingSeconds << " s, " << keystrokes << " keystrokes ("
+            << keystrokesPerSecond << "/s)\n";
+        out << "Operations: " << operationsAcknowledged << " acknowledged (" << operationsPerSecond << "/s), "
+            << operationsRejected << " rejected, " << cursorUpdatesSent << " cursor updates\n";
+        out << "Delivered: " << messagesReceived << " messages (" << messagesPerSecond << "/s), "
+            << bytesReceived / 1024 << " KiB in, " << bytesSent / 1024 << " KiB out\n";
+        printLatency(out, "Propagation", propagationLatency);
+        printLatency(out, "Acknowledgement", acknowledgementLatency);
+        printLatency(out, "Join", joinLatency);
+        if (serverSampled) {
+            out << std::setprecision(3);
+            out << "Server CPU: " << serverCpuCores << " cores, " << serverCpuPerClient << "% of a core per client\n";
+            out << "Server RSS: " << serverRssBaseline / 1024 << " KiB idle, " << serverRssJoined / 1024
+                << " KiB joined, " << serverRssEnd / 1024 << " KiB after typing (peak "
+                << serverRssPeak / 1024 << " KiB), " << std::setprecision(1)
+                << serverMemoryPerClient / 1024.0 << " KiB per client\n";
+        }
+        out << std::setprecision(2) << "Client CPU: " << clientCpuSeconds << " s\n";
+        out << "Convergence: " << documentsConverged << "/" << documents << " documents, "
+            << clientsDiverged << " diverged, " << desyncedClients << " desynced, "
+            << protocolErrors << " protocol errors\n";
+        if (!lastProtocolError.empty()) {
+            out << "Last protocol error: " << lastProtocolError << "\n";
+        }
+        out << std::defaultfloat;
+    }
+
+    // Flat JSON object for tracking capacity from release to release
+    std::string toJson() const {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(3) << "{";
+        out << "\"clients\":" << clients << ",\"documents\":" << documents;
+        out << ",\"connectedClients\":" << connectedClients << ",\"desyncedClients\":" << desyncedClients;
+        out << ",\"documentsConverged\":" << documentsConverged << ",\"clientsDiverged\":" << clientsDiverged;
+        out << ",\"typingSeconds\":" << typingSeconds << ",\"keystrokes\":" << keystrokes;
+        out << ",\"operationsSent\":" << operationsSent << ",\"operationsAcknowledged\":" << operationsAcknowledged;
+        out << ",\"operationsRejected\":" << operationsRejected << ",\"cursorUpdatesSent\":" << cursorUpdatesSent;
+        out << ",\"messagesReceived\":" << messagesReceived << ",\"bytesSent\":" << bytesSent;
+        out << ",\"bytesReceived\":" << bytesReceived << ",\"protocolErrors\":" << protocolErrors;
+        out << ",\"keystrokesPerSecond\":" << keystrokesPerSecond;
+        out << ",\"operationsPerSecond\":" << operationsPerSecond;
+        out << ",\"messagesPerSecond\":" << messagesPerSecond;
+        writeLatency(out, "propagationLatencyUs", propagationLatency);
+        writeLatency(out, "acknowledgementLatencyUs", acknowledgementLatency);
+        writeLatency(out, "joinLatencyUs", joinLatency);
+        out << ",\"serverSampled\":" << (serverSampled ? "true" : "false");
+        out << ",\"serverCpuCores\":" << serverCpuCores << ",\"serverCpuPerClient\":" << serverCpuPerClient;
+        out << ",\"serverRssBaseline\":" << serverRssBaseline << ",\"serverRssJoined\":" << serverRssJoined;
+        out << ",\"serverRssEnd\":" << serverRssEnd << ",\"serverRssPeak\":" << serverRssPeak;
+        out << ",\"serverMemoryPerClient\":" << serverMemoryPerClient;
+        out << ",\"clientCpuSeconds\":" << clientCpuSeconds;
+        out << ",\"converged\":" << (converged() ? "true" : "false");
+        out << "}";
+        return out.str();
+    }
+
+private:
+    static void printLatency(std::ostream& out, const char* name, const HistogramSnapshot& latency) {
+        if (latency.empty()) {
+            return;
+        }
+        out << std::setprecision(2) << name << " latency (ms): p50 " << latency.valueAtPercentile(50) / 1000.0
+            << ", p90 " << latency.valueAtPercentile(90) / 1000.0
+            << ", p99 " << latency.valueAtPercentile(99) / 1000.0
+            << ", p99.9 " << latency.valueAtPercentile(99.9) / 1000.0
+            << ", max " << latency.getMax() / 1000.0 << " (" << latency.getTotalCount() << " samples)\n";
+    }
+
+    static void writeLatency(std::ostream& out, const char* name, const HistogramSnapshot& latency) {
+        out << ",\"" << name << "\":{\"count\":" << latency.getTotalCount()
+            << ",\"p50\":" << latency.valueAtPercentile(50) << ",\"p90\":" << latency.valueAtPercentile(90)
+            << ",\"p99\":" << latency.valueAtPercentile(99) << ",\"p999\":" << latency.valueAtPercentile(99.9)
+            << ",\"max\":" << latency.getMax() << "}";
+    }
+};
+
+/**
+ * CPU time and memory of a process, read from /proc. Unavailable (all
+ * zero) on systems without procfs.
+ */
+struct ProcessUsage {
+    bool available = false;
+    double cpuSeconds = 0.0;
+    uint64_t rssBytes = 0;
+    uint64_t peakRssBytes = 0;
+
+    static ProcessUsage sample(int pid) {
+        ProcessUsage usage;
+        std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+        std::string line;
+        if (!std::getline(stat, line)) {
+            return usage;
+        }
+
+        // The command name may contain spaces; fields resume after its closing parenthesis
+        std::istringstream fields(line.substr(line.rfind(')') + 2));
+        std::string field;
+        uint64_t utime = 0, stime = 0;
+        for (int i = 3; i <= 15 && fields >> field; ++i) {
+            if (i == 14) utime = std::stoull(field);
+            if (i == 15) stime = std::stoull(field);
+        }
+        usage.cpuSeconds = static_cast<double>(utime + stime) / static_cast<double>(sysconf(_SC_CLK_TCK));
+
+        std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+        while (std::getline(status, line)) {
+            if (line.rfind("VmRSS:", 0) == 0) {
+                usage.rssBytes = std::stoull(line.substr(6)) * 1024;
+            } else if (line.rfind("VmHWM:", 0) == 0) {
+                usage.peakRssBytes = std::stoull(line.substr(6)) * 1024;
+            }
+        }
+        usage.available = true;
+        return usage;
+    }
+};
+
+/**
+ * Load generator for the collaboration server.
+ *
+ * Simulated clients connect over WebSocket with binary frames, join
+ * documents in groups and type with human-like timing. Each client keeps
+ * a replica of its document and runs the client side of the OT protocol:
+ * one edit in flight until the server acknowledges it, later keystrokes
+ * composed into a buffer, and remote edits transformed against both.
+ * Typists share lines and start at the same spot, so the comparison at the
+ * end covers concurrent edits at one position and the tie-breaking between
+ * them as well as the server's fan-out and acknowledgement ordering.
+ *
+ * A run connects and joins all clients, lets one client per document add
+ * the shared lines, types for the configured duration, waits for the edit
+ * streams to drain, and then joins one verifier per document whose fresh
+ * copy every member's replica must match.
+ */
+class LoadGenerator {
+public:
+    explicit LoadGenerator(LoadTestConfig config) : config_(std::move(config)) {
+        config_.clients = std::max<size_t>(config_.clients, 1);
+        config_.clientsPerDocument = std::max<size_t>(config_.clientsPerDocument, 1);
+        config_.typistsPerLine = std::max<size_t>(config_.typistsPerLine, 1);
+        config_.threads = std::max<size_t>(config_.threads, 1);
+        config_.connectRate = std::max<size_t>(config_.connectRate, 1);
+    }
+
+    LoadGenerator(const LoadGenerator&) = delete;
+    LoadGenerator& operator=(const LoadGenerator&) = delete;
+
+    LoadTestReport run() {
+        LoadTestReport report;
+        report.clients = config_.clients;
+        report.documents = (config_.clients + config_.clientsPerDocument - 1) / config_.clientsPerDocument;
+        if (!resolveAddress()) {
+            report.error = "Cannot resolve " + config_.host;
+            return report;
+        }
+        createClients(report.documents);
+
+        ProcessUsage baseline = sampleServer();
+        phase_ = Phase::CONNECT;
+        for (auto& loop : loops_) {
+            loop->thread = std::thread([this, &loop]() { runLoop(*loop); });
+        }
+
+        // Everyone joins, then each document's first client adds the shared lines
+        size_t typists = config_.clients;
+        waitUntil(config_.setupTimeout, [&]() { return joined_ + failed_ >= typists; });
+        phase_ = Phase::SETUP;
+        waitUntil(config_.setupTimeout, [&]() { return linesAssigned_ + failed_ >= typists; });
+
+        ProcessUsage joinedUsage = sampleServer();
+        auto typingStart = std::chrono::steady_clock::now();
+        phase_ = Phase::TYPE;
+        std::this_thread::sleep_for(config_.duration);
+        phase_ = Phase::DRAIN;
+        auto typingEnd = std::chrono::steady_clock::now();
+        ProcessUsage endUsage = sampleServer();
+
+        waitUntil(config_.drainTimeout, [this]() { return isQuiescent(); });
+        phase_ = Phase::VERIFY;
+        waitUntil(config_.setupTimeout, [this]() { return verified_ >= verifiers_.size(); });
+
+        phase_ = Phase::STOP;
+        for (auto& loop : loops_) {
+            loop->thread.join();
+        }
+
+        report.typingSeconds = std::chrono::duration<double>(typingEnd - typingStart).count();
+        collectReport(report);
+        if (baseline.available && joinedUsage.available && endUsage.available && report.connectedClients > 0) {
+            double clients = static_cast<double>(report.connectedClients);
+            report.serverSampled = true;
+            report.serverCpuCores = (endUsage.cpuSeconds - joinedUsage.cpuSeconds) / report.typingSeconds;
+            report.serverCpuPerClient = report.serverCpuCores * 100.0 / clients;
+            report.serverRssBaseline = baseline.rssBytes;
+            report.serverRssJoined = joinedUsage.rssBytes;
+            report.serverRssEnd = endUsage.rssBytes;
+            report.serverRssPeak = endUsage.peakRssBytes;
+            report.serverMemoryPerClient =
+                (static_cast<double>(endUsage.rssBytes) - static_cast<double>(baseline.rssBytes)) / clients;
+        }
+        return report;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Phase { CONNECT, SETUP, TYPE, DRAIN, VERIFY, STOP };
+    enum class ClientState { IDLE, CONNECTING, HANDSHAKE, OPEN, CLOSED };
+
+    struct Client {
+        size_t document = 0;
+        size_t slot = 0;                    // Position within the document's group; 0 adds the lines
+        bool verifier = false;
+        std::string userId;
+        std::mt19937 rng;
+
+        int fd = -1;
+        ClientState state = ClientState::IDLE;
+        Clock::time_point connectAt;
+        Clock::time_point joinSentAt;
+        std::string readBuffer;
+        std::string writeBuffer;
+        size_t writeOffset = 0;
+
+        // Replica of the document
+        TextRope text;
+        uint64_t revision = 0;
+        bool joined = false;                // Loaded the document state at least once
+        bool synced = false;                // Document state loaded
+        bool loading = false;               // Between DOCUMENT_STATE and the end of its stream
+        size_t chunksExpected = 0;
+        size_t tailExpected = 0;
+        std::string snapshot;
+        bool desynced = false;
+        std::string lastError;
+
+        // Client side of the OT protocol
+        std::optional<DocumentOperation> inflight;
+        Clock::time_point inflightSentAt;
+        std::vector<DocumentOperation> buffer;
+
+        // Typing
+        bool hasLine = false;
+        Position cursor;
+        Clock::time_point nextKeyAt;
+        std::string word;
+        size_t wordsOnLine = 0;
+        size_t lineWords = 8;
+        bool typoPending = false;
+        bool cursorDirty = false;
+        Clock::time_point nextCursorAt;
+        uint64_t revisionAcked = 0;
+        Clock::time_point nextRevisionAckAt;
+
+        // Latency: each author logs when it sent every edit, and a peer's n-th
+        // edit from that author is the author's n-th accepted one
+        bool recordLatency = true;
+        std::unordered_map<std::string, uint64_t> editsReceived;
+        std::mutex sentMutex;
+        std::deque<Clock::time_point> sentTimes;
+
+        // Read by the driver thread
+        std::atomic<bool> idle{true};
+        std::atomic<bool> healthy{false};
+        std::atomic<uint64_t> seenRevision{0};
+
+        uint64_t keystrokes = 0;
+        uint64_t operationsSent = 0;
+        uint64_t operationsAcknowledged = 0;
+        uint64_t acknowledgedWhileTyping = 0;
+        uint64_t operationsRejected = 0;
+        uint64_t cursorUpdatesSent = 0;
+        uint64_t messagesReceived = 0;
+        uint64_t messagesWhileTyping = 0;
+        uint64_t bytesSent = 0;
+        uint64_t bytesReceived = 0;
+        uint64_t protocolErrors = 0;
+    };
+
+    struct Loop {
+        std::vector<Client*> clients;
+        std::thread thread;
+        double cpuSeconds = 0.0;
+    };
+
+    static constexpr size_t MAX_FRAME_PAYLOAD = 64 * 1024 * 1024;
+    static constexpr std::chrono::milliseconds MAX_POLL_WAIT{20};
+    static constexpr const char* WORDS[] = {
+        "the", "value", "return", "if", "for", "const", "auto", "result", "index", "buffer",
+        "size", "document", "update", "while", "string", "count", "next", "state", "error", "true"
+    };
+
+    bool resolveAddress() {
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(config_.host.c_str(), nullptr, &hints, &result) != 0 || !result) {
+            return false;
+        }
+        std::memcpy(&address_, result->ai_addr, sizeof(address_));
+        address_.sin_port = htons(static_cast<uint16_t>(config_.port));
+        freeaddrinfo(result);
+        return true;
+    }
+
+    void createClients(size_t documents) {
+        // Fresh ids per run, so a long-lived server never mixes runs
+        runId_ = std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        for (size_t i = 0; i < config_.threads; ++i) {
+            loops_.push_back(std::make_unique<Loop>());
+        }
+
+        auto start = Clock::now();
+        auto connectSpacing = std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1)) /
+                              static_cast<Clock::rep>(config_.connectRate);
+        for (size_t i = 0; i < config_.clients; ++i) {
+            auto client = std::make_unique<Client>();
+            client->document = i / config_.clientsPerDocument;
+            client->slot = i % config_.clientsPerDocument;
+            client->userId = config_.documentPrefix + "-" + runId_ + "-user-" + std::to_string(i);
+            client->rng.seed(config_.seed + static_cast<uint32_t>(i));
+            client->connectAt = start + connectSpacing * static_cast<Clock::rep>(i);
+            loops_[i % loops_.size()]->clients.push_back(client.get());
+            clientsByUser_[client->userId] = client.get();
+            clients_.push_back(std::move(client));
+        }
+        for (size_t d = 0; d < documents; ++d) {
+            auto verifier = std::make_unique<Client>();
+            verifier->document = d;
+            verifier->verifier = true;
+            verifier->userId = config_.documentPrefix + "-" + runId_ + "-verifier-" + std::to_string(d);
+            verifier->recordLatency = false;
+            loops_[d % loops_.size()]->clients.push_back(verifier.get());
+            verifiers_.push_back(std::move(verifier));
+        }
+    }
+
+    std::string documentId(size_t document) const {
+        return config_.documentPrefix + "-" + runId_ + "-doc-" + std::to_string(document);
+    }
+
+    size_t groupSize(size_t document) const {
+        return std::min(config_.clientsPerDocument, config_.clients - document * config_.clientsPerDocument);
+    }
+
+    size_t sharedLines(size_t document) const {
+        return (groupSize(document) + config_.typistsPerLine - 1) / config_.typistsPerLine;
+    }
+
+    ProcessUsage sampleServer() const {
+        return config_.serverPid > 0 ? ProcessUsage::sample(config_.serverPid) : ProcessUsage{};
+    }
+
+    template<typename Predicate>
+    void waitUntil(std::chrono::milliseconds timeout, Predicate done) {
+        auto deadline = Clock::now() + timeout;
+        while (!done() && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    // Every healthy member of a document is idle and all of them have been at
+    // the same revision for two consecutive checks
+    bool isQuiescent() {
+        std::vector<uint64_t> revisions(verifiers_.size(), UINT64_MAX);
+        bool settled = true;
+        for (const auto& client : clients_) {
+            if (!client->healthy) {
+                continue;
+            }
+            uint64_t revision = client->seenRevision;
+            uint64_t& documentRevision = revisions[client->document];
+            if (!client->idle || (documentRevision != UINT64_MAX && documentRevision != revision)) {
+                settled = false;
+            }
+            documentRevision = revision;
+        }
+        bool stable = settled && revisions == lastRevisions_;
+        lastRevisions_ = revisions;
+        if (!stable) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        return stable;
+    }
+
+    // Event loop
+
+    void runLoop(Loop& loop) {
+        std::vector<pollfd> fds;
+        std::vector<Client*> polled;
+        while (phase_ != Phase::STOP) {
+            auto now = Clock::now();
+            auto wake = now + MAX_POLL_WAIT;
+            for (Client* client : loop.clients) {
+                service(*client, now, wake);
+            }
+
+            fds.clear();
+            polled.clear();
+            for (Client* client : loop.clients) {
+                if (client->fd < 0) {
+                    continue;
+                }
+                short events = POLLIN;
+                if (client->state == ClientState::CONNECTING || client->writeOffset < client->writeBuffer.size()) {
+                    events |= POLLOUT;
+                }
+                fds.push_back({client->fd, events, 0});
+                polled.push_back(client);
+            }
+
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(wake - Clock::now()).count();
+            int timeout = static_cast<int>(std::max<long long>(wait, 0));
+            if (fds.empty()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+                continue;
+            }
+            if (poll(fds.data(), fds.size(), timeout) <= 0) {
+                continue;
+            }
+            for (size_t i = 0; i < fds.size(); ++i) {
+                if (fds[i].revents & POLLOUT) {
+                    onWritable(*polled[i]);
+                }
+                if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                    onReadable(*polled[i]);
+                }
+            }
+        }
+
+        for (Client* client : loop.clients) {
+            closeClient(*client);
+        }
+        timespec cpu{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+        loop.cpuSeconds = static_cast<double>(cpu.tv_sec) + static_cast<double>(cpu.tv_nsec) / 1e9;
+    }
+
+    // Timers: connecting, the document setup, keystrokes and throttled updates
+    void service(Client& client, Clock::time_point now, Clock::time_point& wake) {
+        Phase phase = phase_;
+        if (client.state == ClientState::IDLE) {
+            bool due = client.verifier ? phase >= Phase::VERIFY : now >= client.connectAt;
+            if (due) {
+                startConnect(client);
+            } else if (!client.verifier) {
+                wake = std::min(wake, client.connectAt);
+            }
+            return;
+        }
+        if (client.state != ClientState::OPEN || !client.synced || client.verifier || client.desynced) {
+            return;
+        }
+
+        if (phase == Phase::SETUP && client.slot == 0 && !client.hasLine && !client.inflight) {
+            addMemberLines(client);
+        }
+        if (phase == Phase::TYPE && client.hasLine) {
+            if (now >= client.nextKeyAt) {
+                typeKey(client);
+                client.nextKeyAt = now + nextKeyInterval(client);
+            }
+            wake = std::min(wake, client.nextKeyAt);
+        }
+        if (client.cursorDirty) {
+            if (now >= client.nextCursorAt) {
+                sendCursor(client);
+                client.nextCursorAt = now + config_.cursorInterval;
+            }
+            wake = std::min(wake, client.nextCursorAt);
+        }
+        // The server prunes history up to the acknowledged revision, so the
+        // edit in flight must still be transformable against what follows it
+        uint64_t acknowledgeable = client.inflight ? client.inflight->getBaseRevision() : client.revision;
+        if (acknowledgeable > client.revisionAcked && now >= client.nextRevisionAckAt) {
+            BinaryWriter writer;
+            writer.writeVarUInt(acknowledgeable);
+            sendMessage(client, MessageType::REVISION_ACK, writer.toString());
+            client.revisionAcked = acknowledgeable;
+            client.nextRevisionAckAt = now + config_.ackInterval;
+        }
+    }
+
+    // Connection handling
+
+    void startConnect(Client& client) {
+        client.fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (client.fd < 0) {
+            fail(client);
+            return;
+        }
+        fcntl(client.fd, F_SETFL, fcntl(client.fd, F_GETFL, 0) | O_NONBLOCK);
+        int noDelay = 1;
+        setsockopt(client.fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        client.state = ClientState::CONNECTING;
+        if (connect(client.fd, reinterpret_cast<const sockaddr*>(&address_), sizeof(address_)) == 0) {
+            onConnected(client);
+        } else if (errno != EINPROGRESS) {
+            fail(client);
+        }
+    }
+
+    void onConnected(Client& client) {
+        client.state = ClientState::HANDSHAKE;
+        // The server does not check the key, so a fixed one is enough
+        client.writeBuffer += "GET / HTTP/1.1\r\nHost: " + config_.host + ":" + std::to_string(config_.port) +
+                              "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                              "Sec-WebSocket-Version: 13\r\n\r\n";
+        flushWrites(client);
+    }
+
+    void onWritable(Client& client) {
+        if (client.state == ClientState::CONNECTING) {
+            int error = 0;
+            socklen_t length = sizeof(error);
+            if (getsockopt(client.fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+                fail(client);
+                return;
+            }
+            onConnected(client);
+            return;
+        }
+        flushWrites(client);
+    }
+
+    void flushWrites(Client& client) {
+        while (client.fd >= 0 && client.writeOffset < client.writeBuffer.size()) {
+            auto sent = ::send(client.fd, client.writeBuffer.data() + client.writeOffset,
+                               client.writeBuffer.size() - client.writeOffset, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    fail(client);
+                }
+                return;
+            }
+            client.writeOffset += static_cast<size_t>(sent);
+        }
+        client.writeBuffer.clear();
+        client.writeOffset = 0;
+    }
+
+    void onReadable(Client& client) {
+        char buffer[16 * 1024];
+        while (client.fd >= 0) {
+            auto received = recv(client.fd, buffer, sizeof(buffer), 0);
+            if (received > 0) {
+                client.readBuffer.append(buffer, static_cast<size_t>(received));
+                client.bytesReceived += static_cast<uint64_t>(received);
+                continue;
+            }
+            if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                fail(client);
+                return;
+            }
+            break;
+        }
+
+        if (client.state == ClientState::HANDSHAKE) {
+            auto headerEnd = client.readBuffer.find("\r\n\r\n");
+            if (headerEnd == std::string::npos) {
+                return;
+            }
+            if (client.readBuffer.compare(0, 12, "HTTP/1.1 101") != 0) {
+                fail(client);
+                return;
+            }
+            client.readBuffer.erase(0, headerEnd + 4);
+            client.state = ClientState::OPEN;
+            client.joinSentAt = Clock::now();
+            client.recordLatency = client.recordLatency && phase_ == Phase::CONNECT;
+            sendMessage(client, MessageType::JOIN_DOCUMENT, "");
+        }
+
+        // Server frames are unmasked and never fragmented
+        size_t offset = 0;
+        while (client.state == ClientState::OPEN) {
+            const auto* data = reinterpret_cast<const uint8_t*>(client.readBuffer.data()) + offset;
+            size_t available = client.readBuffer.size() - offset;
+            if (available < 2) {
+                break;
+            }
+            uint64_t length = data[1] & 0x7F;
+            size_t header = 2;
+            if (length == 126 || length == 127) {
+                header += length == 126 ? 2 : 8;
+                if (available < header) {
+                    break;
+                }
+                length = 0;
+                for (size_t i = 2; i < header; ++i) {
+                    length = (length << 8) | data[i];
+                }
+            }
+            if (length > MAX_FRAME_PAYLOAD) {
+                fail(client);
+                return;
+            }
+            if (available < header + length) {
+                break;
+            }
+
+            uint8_t opcode = data[0] & 0x0F;
+            if (opcode == 0x08) {
+                fail(client);
+                return;
+            }
+            if (opcode == 0x02) {
+                handleMessage(client, std::string(reinterpret_cast<const char*>(data) + header, length));
+            }
+            offset += header + length;
+        }
+        if (client.fd >= 0) {
+            client.readBuffer.erase(0, offset);
+        }
+    }
+
+    void closeClient(Client& client) {
+        if (client.fd >= 0) {
+            close(client.fd);
+            client.fd = -1;
+        }
+        client.state = ClientState::CLOSED;
+    }
+
+    // A connection that fails before STOP takes its client out of the run
+    void fail(Client& client) {
+        closeClient(client);
+        if (phase_ == Phase::STOP) {
+            return;
+        }
+        client.desynced = true;
+        client.healthy = false;
+        client.idle = true;
+        if (client.verifier) {
+            verified_++;
+        } else if (!client.joined) {
+            failed_++;
+        }
+    }
+
+    void desync(Client& client) {
+        client.lastError = client.userId + " desynced at revision " + std::to_string(client.revision);
+        client.protocolErrors++;
+        client.desynced = true;
+        client.healthy = false;
+        client.idle = true;
+    }
+
+    void sendMessage(Client& client, MessageType type, const std::string& data) {
+        ProtocolMessage msg;
+        msg.type = type;
+        msg.documentId = documentId(client.document);
+        msg.userId = client.userId;
+        msg.data = data;
+        std::string payload = msg.serializeBinary();
+
+        // Client frames are masked, as browsers do
+        std::string& out = client.writeBuffer;
+        size_t start = out.size();
+        out.push_back(static_cast<char>(0x82));
+        if (payload.size() <= 125) {
+            out.push_back(static_cast<char>(0x80 | payload.size()));
+        } else if (payload.size() <= 65535) {
+            out.push_back(static_cast<char>(0x80 | 126));
+            out.push_back(static_cast<char>(payload.size() >> 8));
+            out.push_back(static_cast<char>(payload.size() & 0xFF));
+        } else {
+            out.push_back(static_cast<char>(0x80 | 127));
+            for (int i = 7; i >= 0; --i) {
+                out.push_back(static_cast<char>((static_cast<uint64_t>(payload.size()) >> (i * 8)) & 0xFF));
+            }
+        }
+        uint32_t maskValue = client.rng();
+        char mask[4];
+        std::memcpy(mask, &maskValue, sizeof(mask));
+        out.append(mask, sizeof(mask));
+        for (size_t i = 0; i < payload.size(); ++i) {
+            out.push_back(static_cast<char>(payload[i] ^ mask[i % 4]));
+        }
+        client.bytesSent += out.size() - start;
+        flushWrites(client);
+    }
+
+    // Incoming messages
+
+    void handleMessage(Client& client, const std::string& bytes) {
+        ProtocolMessage msg;
+        if (!ProtocolMessage::deserializeBinary(bytes, msg)) {
+            client.protocolErrors++;
+            return;
+        }
+        if (msg.type == MessageType::BATCH) {
+            BinaryReader reader(msg.data);
+            uint64_t count;
+            std::string message;
+            if (!reader.readVarUInt(count)) {
+                client.protocolErrors++;
+                return;
+            }
+            for (uint64_t i = 0; i < count && reader.readString(message); ++i) {
+                handleMessage(client, message);
+            }
+            return;
+        }
+
+        client.messagesReceived++;
+        if (phase_ == Phase::TYPE) {
+            client.messagesWhileTyping++;
+        }
+        switch (msg.type) {
+            case MessageType::DOCUMENT_STATE:
+                beginState(client, msg);
+                break;
+            case MessageType::SNAPSHOT_CHUNK:
+                addSnapshotChunk(client, msg);
+                break;
+            case MessageType::DOCUMENT_OPERATION:
+                if (client.synced || client.loading) {
+                    auto operation = DocumentOperation::decodeBinary(msg.data);
+                    if (!operation) {
+                        client.protocolErrors++;
+                    } else if (operation->getType() == OperationType::INSERT ||
+                               operation->getType() == OperationType::DELETE) {
+                        applyRemote(client, *operation);
+                        if (client.loading && client.tailExpected > 0 && --client.tailExpected == 0) {
+                            finishState(client);
+                        }
+                    }
+                }
+                break;
+            case MessageType::OPERATION_ACK:
+                if (client.synced) {
+                    BinaryReader reader(msg.data);
+                    uint64_t revision;
+                    if (reader.readVarUInt(revision)) {
+                        onAcknowledged(client, revision);
+                    } else {
+                        client.protocolErrors++;
+                    }
+                }
+                break;
+            case MessageType::ERROR_MESSAGE:
+                client.lastError = client.userId + ": " + msg.data;
+                client.protocolErrors++;
+                if (client.inflight && msg.data == "Failed to apply operation") {
+                    // The server resends the document; the pending edits are lost
+                    client.operationsRejected++;
+                    {
+                        std::lock_guard<std::mutex> lock(client.sentMutex);
+                        client.sentTimes.pop_back();
+                    }
+                    client.inflight.reset();
+                    client.buffer.clear();
+                    client.synced = false;
+                    client.recordLatency = false;
+                }
+                break;
+            default:
+                break; // Presence and CRDT traffic is only counted
+        }
+    }
+
+    void beginState(Client& client, const ProtocolMessage& msg) {
+        BinaryReader reader(msg.data);
+        uint64_t revision, snapshotRevision, length, chunks, tail;
+        if (!reader.readVarUInt(revision) || !reader.readVarUInt(snapshotRevision) ||
+            !reader.readVarUInt(length) || !reader.readVarUInt(chunks) || !reader.readVarUInt(tail)) {
+            desync(client);
+            return;
+        }
+        client.loading = true;
+        client.synced = false;
+        client.revision = snapshotRevision;
+        client.snapshot.clear();
+        client.snapshot.reserve(static_cast<size_t>(length));
+        client.chunksExpected = static_cast<size_t>(chunks);
+        client.tailExpected = static_cast<size_t>(tail);
+        client.inflight.reset();
+        client.buffer.clear();
+        if (client.chunksExpected == 0) {
+            client.text = TextRope();
+            if (client.tailExpected == 0) {
+                finishState(client);
+            }
+        }
+    }
+
+    void addSnapshotChunk(Client& client, const ProtocolMessage& msg) {
+        if (!client.loading || client.chunksExpected == 0) {
+            return;
+        }
+        BinaryReader reader(msg.data);
+        uint64_t index;
+        std::string chunk;
+        if (!reader.readVarUInt(index) || !reader.readRaw(chunk, reader.remaining())) {
+            desync(client);
+            return;
+        }
+        client.snapshot += chunk;
+        if (--client.chunksExpected == 0) {
+            client.text = TextRope(client.snapshot);
+            client.snapshot.clear();
+            if (client.tailExpected == 0) {
+                finishState(client);
+            }
+        }
+    }
+
+    void finishState(Client& client) {
+        client.loading = false;
+        client.synced = true;
+        client.seenRevision = client.revision;
+        client.idle = true;
+        if (client.hasLine) {
+            // Back from a resync; stay on the same line
+            client.cursor.line = std::min(client.cursor.line, client.text.lineCount() - 1);
+            client.cursor.character = std::min(client.cursor.character, client.text.lineLength(client.cursor.line));
+        }
+        if (client.joined) {
+            return;
+        }
+
+        client.joined = true;
+        client.healthy = true;
+        joinLatency_.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - client.joinSentAt).count()));
+        if (client.verifier) {
+            verified_++;
+        } else {
+            joined_++;
+        }
+    }
+
+    // Jupiter-style client transform: the remote edit is transformed past the
+    // edit in flight and the buffered ones, and they past it
+    void applyRemote(Client& client, const DocumentOperation& operation) {
+        if (operation.getBaseRevision() < client.revision) {
+            return; // Already part of the loaded state
+        }
+        if (operation.getBaseRevision() > client.revision) {
+            desync(client);
+            return;
+        }
+
+        DocumentOperation remote(operation);
+        auto transformPending = [&remote](DocumentOperation& pending) {
+            auto transformedRemote = OperationalTransform::transform(remote, pending);
+            pending = *OperationalTransform::transform(pending, remote);
+            remote = *transformedRemote;
+        };
+        if (client.inflight) {
+            transformPending(*client.inflight);
+        }
+        for (auto& pending : client.buffer) {
+            transformPending(pending);
+        }
+        if (!remote.apply(client.text)) {
+            desync(client);
+            return;
+        }
+
+        DocumentOperation cursor(OperationType::CURSOR_MOVE, client.userId, client.cursor);
+        client.cursor = OperationalTransform::transform(cursor, remote)->getPosition();
+        client.revision = operation.getBaseRevision() + 1;
+        client.seenRevision = client.revision;
+
+        if (!client.hasLine && !client.verifier && isMemberLines(client, remote)) {
+            assignLine(client, remote);
+        }
+
+        const std::string& author = remote.getUserId();
+        if (client.recordLatency && !client.loading && author != client.userId) {
+            uint64_t index = client.editsReceived[author]++;
+            auto authorIt = clientsByUser_.find(author);
+            if (authorIt != clientsByUser_.end()) {
+                Client& source = *authorIt->second;
+                std::lock_guard<std::mutex> lock(source.sentMutex);
+                if (index < source.sentTimes.size()) {
+                    propagationLatency_.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                        Clock::now() - source.sentTimes[static_cast<size_t>(index)]).count()));
+                }
+            }
+        }
+    }
+
+    void onAcknowledged(Client& client, uint64_t revision) {
+        if (!client.inflight || revision != client.revision + 1) {
+            desync(client);
+            return;
+        }
+        auto now = Clock::now();
+        acknowledgementLatency_.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(now - client.inflightSentAt).count()));
+        client.operationsAcknowledged++;
+        if (phase_ == Phase::TYPE) {
+            client.acknowledgedWhileTyping++;
+        }
+        client.revision = revision;
+        client.seenRevision = revision;
+
+        DocumentOperation acknowledged = std::move(*client.inflight);
+        client.inflight.reset();
+        if (!client.hasLine && isMemberLines(client, acknowledged)) {
+            assignLine(client, acknowledged);
+        }
+        while (!client.buffer.empty() && !client.inflight) {
+            DocumentOperation next = std::move(client.buffer.front());
+            client.buffer.erase(client.buffer.begin());
+            // A typo typed and deleted while buffered composes to nothing;
+            // the server would drop it unacknowledged
+            if (next.getType() != OperationType::INSERT || !next.getContent().empty()) {
+                sendOperation(client, std::move(next));
+            }
+        }
+        client.idle = !client.inflight && client.buffer.empty();
+    }
+
+    // Editing
+
+    // The edit that opens the group's shared lines after the text
+    void addMemberLines(Client& client) {
+        size_t lastLine = client.text.lineCount() - 1;
+        Position end(lastLine, client.text.lineLength(lastLine));
+        DocumentOperation operation(OperationType::INSERT, client.userId, end,
+                                    std::string(sharedLines(client.document), '\n'));
+        if (!operation.apply(client.text)) {
+            desync(client);
+            return;
+        }
+        submitEdit(client, std::move(operation));
+    }
+
+    bool isMemberLines(const Client& client, const DocumentOperation& operation) const {
+        const Client& leader = *clients_[client.document * config_.clientsPerDocument];
+        return operation.getUserId() == leader.userId && operation.getType() == OperationType::INSERT &&
+               operation.getContent() == std::string(sharedLines(client.document), '\n');
+    }
+
+    void assignLine(Client& client, const DocumentOperation& memberLines) {
+        client.hasLine = true;
+        client.cursor = Position(memberLines.getPosition().line + 1 + client.slot / config_.typistsPerLine, 0);
+        client.nextKeyAt = Clock::now() + nextKeyInterval(client);
+        linesAssigned_++;
+    }
+
+    void typeKey(Client& client) {
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+        Position& cursor = client.cursor;
+        size_t lineLength = client.text.lineLength(cursor.line);
+        double roll = chance(client.rng);
+        client.keystrokes++;
+
+        if (client.typoPending) {
+            client.typoPending = false;
+            backspace(client);
+        } else if (roll < config_.cursorMoveRate) {
+            switch (client.rng() % 4) {
+                case 0: cursor.character = cursor.character > 0 ? cursor.character - 1 : 0; break;
+                case 1: cursor.character = std::min(cursor.character + 1, lineLength); break;
+                case 2: cursor.character = 0; break;
+                default: cursor.character = lineLength; break;
+            }
+            client.cursorDirty = true;
+        } else if (roll < config_.cursorMoveRate + config_.typoRate) {
+            insertText(client, std::string(1, static_cast<char>('a' + client.rng() % 26)));
+            client.typoPending = true;
+        } else if (!client.word.empty()) {
+            insertText(client, client.word.substr(0, 1));
+            client.word.erase(0, 1);
+        } else if (client.wordsOnLine >= client.lineWords) {
+            insertText(client, "\n");
+            client.wordsOnLine = 0;
+            client.lineWords = 4 + client.rng() % 12;
+        } else {
+            client.word = WORDS[client.rng() % (sizeof(WORDS) / sizeof(WORDS[0]))];
+            client.wordsOnLine++;
+            if (cursor.character > 0) {
+                insertText(client, " ");
+            } else {
+                insertText(client, client.word.substr(0, 1));
+                client.word.erase(0, 1);
+            }
+        }
+    }
+
+    void insertText(Client& client, const std::string& text) {
+        DocumentOperation operation(OperationType::INSERT, client.userId, client.cursor, text);
+        if (!operation.apply(client.text)) {
+            desync(client);
+            return;
+        }
+        if (text == "\n") {
+            client.cursor = Position(client.cursor.line + 1, 0);
+        } else {
+            client.cursor.character += text.length();
+        }
+        client.cursorDirty = true;
+        submitEdit(client, std::move(operation));
+    }
+
+    // Backspace stops at the start of the line; the character before the
+    // cursor may be a line mate's, typed concurrently
+    void backspace(Client& client) {
+        if (client.cursor.character == 0) {
+            return;
+        }
+        Position position(client.cursor.line, client.cursor.character - 1);
+        std::string removed = client.text.substr(position.toLinear(client.text), 1);
+        DocumentOperation operation(OperationType::DELETE, client.userId, position, removed);
+        if (!operation.apply(client.text)) {
+            desync(client);
+            return;
+        }
+        client.cursor = position;
+        client.cursorDirty = true;
+        submitEdit(client, std::move(operation));
+    }
+
+    // Send now if nothing is in flight, else fold into the buffer
+    void submitEdit(Client& client, DocumentOperation operation) {
+        if (!client.inflight) {
+            sendOperation(client, std::move(operation));
+        } else if (client.buffer.empty() || !OperationBatcher::compose(client.buffer.back(), operation)) {
+            client.buffer.push_back(std::move(operation));
+        }
+        client.idle = false;
+    }
+
+    void sendOperation(Client& client, DocumentOperation operation) {
+        auto now = Clock::now();
+        operation.setBaseRevision(client.revision);
+        {
+            std::lock_guard<std::mutex> lock(client.sentMutex);
+            client.sentTimes.push_back(now);
+        }
+        sendMessage(client, MessageType::DOCUMENT_OPERATION, operation.encodeBinary());
+        client.inflight = std::move(operation);
+        client.inflightSentAt = now;
+        client.operationsSent++;
+    }
+
+    void sendCursor(Client& client) {
+        BinaryWriter writer;
+        writer.writeVarUInt(client.cursor.line);
+        writer.writeVarUInt(client.cursor.character);
+        sendMessage(client, MessageType::CURSOR_UPDATE, writer.toString());
+        client.cursorDirty = false;
+        client.cursorUpdatesSent++;
+    }
+
+    Clock::duration nextKeyInterval(Client& client) {
+        std::lognormal_distribution<double> interval(std::log(static_cast<double>(config_.medianKeyInterval.count())),
+                                                     config_.keyIntervalSpread);
+        double milliseconds = interval(client.rng);
+        if (std::uniform_real_distribution<double>(0.0, 1.0)(client.rng) < config_.pauseProbability) {
+            milliseconds += std::exponential_distribution<double>(
+                1.0 / static_cast<double>(std::max<int64_t>(config_.meanPause.count(), 1)))(client.rng);
+        }
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(milliseconds));
+    }
+
+    // Results, once the loops have stopped
+
+    void collectReport(LoadTestReport& report) {
+        for (const auto& client : clients_) {
+            report.connectedClients += client->joined ? 1 : 0;
+            report.desyncedClients += client->desynced ? 1 : 0;
+            report.keystrokes += client->keystrokes;
+            report.operationsSent += client->operationsSent;
+            report.operationsAcknowledged += client->operationsAcknowledged;
+            report.operationsRejected += client->operationsRejected;
+            report.cursorUpdatesSent += client->cursorUpdatesSent;
+            report.messagesReceived += client->messagesReceived;
+            report.bytesSent += client->bytesSent;
+            report.bytesReceived += client->bytesReceived;
+            report.protocolErrors += client->protocolErrors;
+            if (!client->lastError.empty()) {
+                report.lastProtocolError = client->lastError;
+            }
+            report.operationsPerSecond += static_cast<double>(client->acknowledgedWhileTyping);
+            report.messagesPerSecond += static_cast<double>(client->messagesWhileTyping);
+        }
+        if (report.typingSeconds > 0.0) {
+            report.keystrokesPerSecond = static_cast<double>(report.keystrokes) / report.typingSeconds;
+            report.operationsPerSecond /= report.typingSeconds;
+            report.messagesPerSecond /= report.typingSeconds;
+        }
+
+        for (const auto& verifier : verifiers_) {
+            if (!verifier->healthy) {
+                continue;
+            }
+            std::string expected = verifier->text.toString();
+            size_t diverged = 0;
+            for (size_t i = verifier->document * config_.clientsPerDocument;
+                 i < std::min(config_.clients, (verifier->document + 1) * config_.clientsPerDocument); ++i) {
+                const Client& member = *clients_[i];
+                if (member.healthy && (member.revision != verifier->revision || member.text.toString() != expected)) {
+                    diverged++;
+                }
+            }
+            report.clientsDiverged += diverged;
+            report.documentsConverged += diverged == 0 ? 1 : 0;
+        }
+
+        report.propagationLatency = propagationLatency_.snapshot();
+        report.acknowledgementLatency = acknowledgementLatency_.snapshot();
+        report.joinLatency = joinLatency_.snapshot();
+        for (const auto& loop : loops_) {
+            report.clientCpuSeconds += loop->cpuSeconds;
+        }
+    }
+
+    LoadTestConfig config_;
+    sockaddr_in address_{};
+    std::string runId_;
+    std::vector<std::unique_ptr<Client>> clients_;
+    std::vector<std::unique_ptr<Client>> verifiers_;
+    std::unordered_map<std::string, Client*> clientsByUser_;  // Read-only once the loops run
+    std::vector<std::unique_ptr<Loop>> loops_;
+    std::vector<uint64_t> lastRevisions_;
+
+    std::atomic<Phase> phase_{Phase::CONNECT};
+    std::atomic<size_t> joined_{0};
+    std::atomic<size_t> failed_{0};
+    std::atomic<size_t> linesAssigned_{0};
+    std::atomic<size_t> verified_{0};
+
+    LatencyHistogram propagationLatency_;
+    LatencyHistogram acknowledgementLatency_;
+    LatencyHistogram joinLatency_;
+};
+
+} // namespace collaboration
+} // namespace bolt
+
+#endif // _WIN32
+
+#endif
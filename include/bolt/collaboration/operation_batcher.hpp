@@ -0,0 +1,276 @@
+#ifndef OPERATION_BATCHER_HPP
+#define OPERATION_BATCHER_HPP
+
+#include "document_operation.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bolt {
+namespace collaboration {
+
+/**
+ * Collects the edit stream of a document for a short window before it is
+ * applied or fanned out.
+ *
+ * Consecutive edits from the same user are composed into one operation:
+ * typing, forward delete, backspace, and deleting text that was just typed.
+ * Cursor moves only keep the latest position per user. A document's batch
+ * becomes due once its oldest pending entry is older than the window.
+ */
+class OperationBatcher {
+public:
+    static constexpr std::chrono::milliseconds DEFAULT_WINDOW{5};
+
+    struct Batch {
+        std::string documentId;
+        std::vector<DocumentOperation> operations;  // Composed edits in arrival order
+        std::vector<DocumentOperation> cursors;     // Latest CURSOR_MOVE per user
+    };
+
+    explicit OperationBatcher(std::chrono::milliseconds window = DEFAULT_WINDOW) : window_(window) {}
+
+    void setWindow(std::chrono::milliseconds window) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        window_ = window;
+    }
+
+    std::chrono::milliseconds getWindow() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return window_;
+    }
+
+    void add(const std::string& documentId, const DocumentOperation& operation) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& pending = documents_[documentId];
+        if (pending.operations.empty() && pending.cursors.empty()) {
+            pending.firstQueued = std::chrono::steady_clock::now();
+        }
+
+        if (operation.getType() == OperationType::CURSOR_MOVE) {
+            pending.cursors.insert_or_assign(operation.getUserId(), operation);
+            return;
+        }
+        if (operation.getType() == OperationType::NOOP) {
+            return;
+        }
+
+        // Only the most recent edit may absorb the new one; composing past
+        // another user's edit would reorder them
+        if (!pending.operations.empty() && compose(pending.operations.back(), operation)) {
+            composedOperations_++;
+            return;
+        }
+        pending.operations.push_back(operation);
+    }
+
+    // Batches whose window has elapsed
+    std::vector<Batch> takeDue(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return takeLocked([&](const PendingDocument& pending) { return now - pending.firstQueued >= window_; });
+    }
+
+    std::vector<Batch> takeAll() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return takeLocked([](const PendingDocument&) { return true; });
+    }
+
+    bool empty() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return documents_.empty();
+    }
+
+    // Edits absorbed into an earlier operation since construction
+    size_t getComposedCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return composedOperations_;
+    }
+
+    // Merge next into first when applying first then next equals applying the
+    // merged operation. Operations must come from the same user and share a
+    // base revision; edits spanning lines are never merged.
+    static bool compose(DocumentOperation& first, const DocumentOperation& next) {
+        if (first.getUserId() != next.getUserId() || first.getBaseRevision() != next.getBaseRevision()) {
+            return false;
+        }
+
+        const Position& a = first.getPosition();
+        const Position& b = next.getPosition();
+        const std::string& firstText = first.getContent();
+        const std::string& nextText = next.getContent();
+        if (a.line != b.line || firstText.find('\n') != std::string::npos ||
+            nextText.find('\n') != std::string::npos) {
+            return false;
+        }
+
+        if (first.getType() == OperationType::INSERT && next.getType() == OperationType::INSERT) {
+            // Typing anywhere inside or right after the pending insert
+            if (b.character < a.character || b.character > a.character + firstText.length()) {
+                return false;
+            }
+            std::string merged = firstText;
+            merged.insert(b.character - a.character, nextText);
+            first.setContent(merged);
+            return true;
+        }
+
+        if (first.getType() == OperationType::DELETE && next.getType() == OperationType::DELETE) {
+            if (b.character == a.character) {
+                // Forward delete
+                first.setContent(firstText + nextText);
+                return true;
+            }
+            if (b.character + nextText.length() == a.character) {
+                // Backspace
+                first.setContent(nextText + firstText);
+                first.setPosition(b);
+                return true;
+            }
+            return false;
+        }
+
+        if (first.getType() == OperationType::INSERT && next.getType() == OperationType::DELETE) {
+            // Deleting text that is still pending just shortens the insert
+            if (b.character < a.character || b.character + nextText.length() > a.character + firstText.length()) {
+                return false;
+            }
+            std::string merged = firstText;
+            merged.erase(b.character - a.character, nextText.length());
+            first.setContent(merged);
+            return true;
+        }
+
+        return false;
+    }
+
+private:
+    struct PendingDocument {
+        std::vector<DocumentOperation> operations;
+        std::map<std::string, DocumentOperation> cursors;
+        std::chrono::steady_clock::time_point firstQueued;
+    };
+
+    template<typename Predicate>
+    std::vector<Batch> takeLocked(Predicate isDue) {
+        std::vector<Batch> batches;
+        for (auto it = documents_.begin(); it != documents_.end();) {
+            if (!isDue(it->second)) {
+                ++it;
+                continue;
+            }
+
+            Batch batch;
+            batch.documentId = it->first;
+            for (auto& operation : it->second.operations) {
+                // Typed-then-deleted text leaves an empty insert behind
+                if (operation.getType() != OperationType::INSERT || !operation.getContent().empty()) {
+                    batch.operations.push_back(std::move(operation));
+                }
+            }
+            for (auto& [userId, cursor] : it->second.cursors) {
+                batch.cursors.push_back(std::move(cursor));
+            }
+            batches.push_back(std::move(batch));
+            it = documents_.erase(it);
+        }
+        return batches;
+    }
+
+    mutable std::mutex mutex_;
+    std::chrono::milliseconds window_;
+    std::map<std::string, PendingDocument> documents_;
+    size_t composedOperations_ = 0;
+};
+
+/**
+ * Background thread that runs a flush callback one interval after work is
+ * scheduled. It sleeps while nothing is pending, so idle documents cost no
+ * wakeups; work scheduled during a flush triggers another one. Work still
+ * pending at stop() is left for the owner to flush.
+ */
+class FlushScheduler {
+public:
+    FlushScheduler() = default;
+
+    ~FlushScheduler() {
+        stop();
+    }
+
+    FlushScheduler(const FlushScheduler&) = delete;
+    FlushScheduler& operator=(const FlushScheduler&) = delete;
+
+    void start(std::chrono::milliseconds interval, std::function<void()> flush) {
+        stop();
+        std::lock_guard<std::mutex> lock(mutex_);
+        interval_ = interval;
+        flush_ = std::move(flush);
+        stopping_ = false;
+        pending_ = false;
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!thread_.joinable()) {
+                return;
+            }
+            stopping_ = true;
+        }
+        condition_.notify_all();
+        thread_.join();
+    }
+
+    bool isRunning() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return thread_.joinable() && !stopping_;
+    }
+
+    void schedule() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (pending_) {
+                return;
+            }
+            pending_ = true;
+        }
+        condition_.notify_all();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            condition_.wait(lock, [this]() { return stopping_ || pending_; });
+            if (stopping_) {
+                break;
+            }
+
+            // Let the window fill up; stop() cuts the wait short
+            condition_.wait_for(lock, interval_, [this]() { return stopping_; });
+            pending_ = false;
+
+            lock.unlock();
+            flush_();
+            lock.lock();
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    std::thread thread_;
+    std::function<void()> flush_;
+    std::chrono::milliseconds interval_{OperationBatcher::DEFAULT_WINDOW};
+    bool stopping_ = false;
+    bool pending_ = false;
+};
+
+} // namespace collaboration
+} // namespace bolt
+
+#endif
@@ -88,47 +88,32 @@ public:
     }
 
 private:
+    // Positions are mapped as if they were linear offsets: text inserted
+    // before a position moves it by the inserted lines and, on the line the
+    // insert ends on, by the length of its last line. Inserted and deleted
+    // text may span lines.
     static void transformInsert(DocumentOperation& insert, const DocumentOperation& other) {
         Position insertPos = insert.getPosition();
         Position otherPos = other.getPosition();
         
         switch (other.getType()) {
             case OperationType::INSERT: {
-                // If other insert is at same line and before/at current position
-                if (otherPos.line == insertPos.line && otherPos.character <= insertPos.character) {
-                    insertPos.character += other.getContent().length();
-                    insert.setPosition(insertPos);
-                }
-                // If other insert is on previous line
-                else if (otherPos.line < insertPos.line) {
-                    // Check if the insert contains newlines
-                    size_t newlineCount = std::count(other.getContent().begin(), 
-                                                   other.getContent().end(), '\n');
-                    if (newlineCount > 0) {
-                        insertPos.line += newlineCount;
-                        insert.setPosition(insertPos);
-                    }
+                // Concurrent inserts at one position are ordered by user id, so
+                // the server and every client put them in the same order
+                if (otherPos < insertPos ||
+                    (otherPos == insertPos && other.getUserId() > insert.getUserId())) {
+                    insert.setPosition(shiftPast(insertPos, otherPos, other.getContent()));
                 }
                 break;
             }
             case OperationType::DELETE: {
-                // If delete is at same line and before current position
-                if (otherPos.line == insertPos.line && otherPos.character < insertPos.character) {
-                    size_t deleteLen = std::min(other.getContent().length(),
-                                              insertPos.character - otherPos.character);
-                    insertPos.character -= deleteLen;
-                    insert.setPosition(insertPos);
-                }
-                // If delete is on previous line
-                else if (otherPos.line < insertPos.line) {
-                    // Check if the delete removes newlines
-                    size_t newlineCount = std::count(other.getContent().begin(),
-                                                   other.getContent().end(), '\n');
-                    if (newlineCount > 0) {
-                        insertPos.line -= std::min(newlineCount, insertPos.line);
-                        insert.setPosition(insertPos);
-                    }
+                // An insert strictly inside deleted text is deleted with it; the
+                // delete transformed past the insert removes the inserted text too
+                Position deleteEnd = endOf(otherPos, other.getContent());
+                if (otherPos < insertPos && insertPos < deleteEnd) {
+                    insert.setContent("");
                 }
+                insert.setPosition(shiftBack(insertPos, otherPos, deleteEnd));
                 break;
             }
             case OperationType::CURSOR_MOVE:
@@ -141,42 +126,34 @@ private:
     static void transformDelete(DocumentOperation& delete_op, const DocumentOperation& other) {
         Position deletePos = delete_op.getPosition();
         Position otherPos = other.getPosition();
+        const std::string& deleted = delete_op.getContent();
+        Position deleteEnd = endOf(deletePos, deleted);
         
         switch (other.getType()) {
             case OperationType::INSERT: {
-                // If insert is at same line and before/at current position
-                if (otherPos.line == deletePos.line && otherPos.character <= deletePos.character) {
-                    deletePos.character += other.getContent().length();
-                    delete_op.setPosition(deletePos);
-                }
-                // If insert is on previous line with newlines
-                else if (otherPos.line < deletePos.line) {
-                    size_t newlineCount = std::count(other.getContent().begin(),
-                                                   other.getContent().end(), '\n');
-                    if (newlineCount > 0) {
-                        deletePos.line += newlineCount;
-                        delete_op.setPosition(deletePos);
-                    }
+                // Inserts at or before the start go in front of the deleted text,
+                // ones strictly inside it are deleted along with it
+                if (!(deletePos < otherPos)) {
+                    delete_op.setPosition(shiftPast(deletePos, otherPos, other.getContent()));
+                } else if (otherPos < deleteEnd) {
+                    size_t split = offsetIn(deletePos, deleted, otherPos);
+                    delete_op.setContent(deleted.substr(0, split) + other.getContent() + deleted.substr(split));
                 }
                 break;
             }
             case OperationType::DELETE: {
-                // If other delete is at same line and before current position
-                if (otherPos.line == deletePos.line && otherPos.character < deletePos.character) {
-                    size_t deleteLen = std::min(other.getContent().length(),
-                                              deletePos.character - otherPos.character);
-                    deletePos.character -= deleteLen;
-                    delete_op.setPosition(deletePos);
-                }
-                // If delete is on previous line with newlines
-                else if (otherPos.line < deletePos.line) {
-                    size_t newlineCount = std::count(other.getContent().begin(),
-                                                   other.getContent().end(), '\n');
-                    if (newlineCount > 0) {
-                        deletePos.line -= std::min(newlineCount, deletePos.line);
-                        delete_op.setPosition(deletePos);
-                    }
+                // Text both deleted is left out; what remains is contiguous once
+                // the other delete has been applied. A delete whose text was all
+                // removed by the other one becomes empty.
+                Position otherEnd = endOf(otherPos, other.getContent());
+                Position overlapStart = std::max(deletePos, otherPos);
+                Position overlapEnd = std::min(deleteEnd, otherEnd);
+                if (overlapStart < overlapEnd) {
+                    size_t first = offsetIn(deletePos, deleted, overlapStart);
+                    size_t last = offsetIn(deletePos, deleted, overlapEnd);
+                    delete_op.setContent(deleted.substr(0, first) + deleted.substr(last));
                 }
+                delete_op.setPosition(shiftBack(deletePos, otherPos, otherEnd));
                 break;
             }
             case OperationType::CURSOR_MOVE:
@@ -192,39 +169,14 @@ private:
         
         switch (other.getType()) {
             case OperationType::INSERT: {
-                // If insert is at same line and before/at cursor position
-                if (otherPos.line == cursorPos.line && otherPos.character <= cursorPos.character) {
-                    cursorPos.character += other.getContent().length();
-                    cursor.setPosition(cursorPos);
-                }
-                // If insert is on previous line with newlines
-                else if (otherPos.line < cursorPos.line) {
-                    size_t newlineCount = std::count(other.getContent().begin(),
-                                                   other.getContent().end(), '\n');
-                    if (newlineCount > 0) {
-                        cursorPos.line += newlineCount;
-                        cursor.setPosition(cursorPos);
-                    }
+                // Text typed at the cursor pushes it along
+                if (!(cursorPos < otherPos)) {
+                    cursor.setPosition(shiftPast(cursorPos, otherPos, other.getContent()));
                 }
                 break;
             }
             case OperationType::DELETE: {
-                // If delete is at same line and before cursor position
-                if (otherPos.line == cursorPos.line && otherPos.character < cursorPos.character) {
-                    size_t deleteLen = std::min(other.getContent().length(),
-                                              cursorPos.character - otherPos.character);
-                    cursorPos.character -= deleteLen;
-                    cursor.setPosition(cursorPos);
-                }
-                // If delete is on previous line with newlines
-                else if (otherPos.line < cursorPos.line) {
-                    size_t newlineCount = std::count(other.getContent().begin(),
-                                                   other.getContent().end(), '\n');
-                    if (newlineCount > 0) {
-                        cursorPos.line -= std::min(newlineCount, cursorPos.line);
-                        cursor.setPosition(cursorPos);
-                    }
-                }
+                cursor.setPosition(shiftBack(cursorPos, otherPos, endOf(otherPos, other.getContent())));
                 break;
             }
             case OperationType::CURSOR_MOVE:
@@ -233,6 +185,49 @@ private:
                 break;
         }
     }
+    
+    // Position just past text that starts at start
+    static Position endOf(const Position& start, const std::string& text) {
+        size_t lastNewline = text.rfind('\n');
+        if (lastNewline == std::string::npos) {
+            return Position(start.line, start.character + text.length());
+        }
+        size_t newlineCount = std::count(text.begin(), text.end(), '\n');
+        return Position(start.line + newlineCount, text.length() - lastNewline - 1);
+    }
+    
+    // Where a position at or after at ends up once text is inserted at at
+    static Position shiftPast(const Position& position, const Position& at, const std::string& text) {
+        Position end = endOf(at, text);
+        if (position.line == at.line) {
+            return Position(end.line, end.character + position.character - at.character);
+        }
+        return Position(position.line + (end.line - at.line), position.character);
+    }
+    
+    // Where a position ends up once the text from from to to is deleted;
+    // positions inside the deleted text collapse onto its start
+    static Position shiftBack(const Position& position, const Position& from, const Position& to) {
+        if (!(from < position)) {
+            return position;
+        }
+        if (!(to < position)) {
+            return from;
+        }
+        if (position.line == to.line) {
+            return Position(from.line, from.character + position.character - to.character);
+        }
+        return Position(position.line - (to.line - from.line), position.character);
+    }
+    
+    // Offset into text starting at start of a position within it
+    static size_t offsetIn(const Position& start, const std::string& text, const Position& position) {
+        size_t offset = 0;
+        for (size_t line = start.line; line < position.line; ++line) {
+            offset = text.find('\n', offset) + 1;
+        }
+        return offset + position.character - (position.line == start.line ? start.character : 0);
+    }
 };
 
 } // namespace collaboration
@@ -0,0 +1,932 @@
+#ifndef SEQUENCE_CRDT_HPP
+#define SEQUENCE_CRDT_HPP
+
+#include "binary_encoding.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace bolt {
+namespace collaboration {
+
+// Identifies one character: the replica that inserted it and that replica's
+// running character count at the time
+struct ItemId {
+    uint64_t client;
+    uint64_t clock;
+
+    bool operator==(const ItemId& other) const {
+        return client == other.client && clock == other.clock;
+    }
+};
+
+/**
+ * Sequence CRDT for plain text (YATA ordering, as used by Yjs).
+ *
+ * Every inserted character is tagged with an ItemId and remembers its left
+ * and right neighbours at insertion time; concurrent inserts between the
+ * same neighbours are ordered deterministically, so replicas converge no
+ * matter the order updates arrive in. Deleted characters stay as tombstones
+ * without their text.
+ *
+ * Consecutive characters typed by one replica are stored as a single
+ * run-length encoded item. Items live in an order-statistic tree (a treap
+ * with visible-length and newline counts per subtree), so offset, line and
+ * id lookups as well as integration of remote items are O(log n).
+ *
+ * Replicas sync by exchanging state vectors (next expected clock per
+ * client) and the binary deltas computed from them. Updates that arrive
+ * before the items they depend on are buffered until they can be applied.
+ */
+class SequenceCRDT {
+public:
+    using StateVector = std::map<uint64_t, uint64_t>;
+
+    explicit SequenceCRDT(uint64_t clientId = generateClientId())
+        : clientId_(clientId), root_(nullptr), rng_(static_cast<uint32_t>(clientId ^ (clientId >> 32))) {}
+
+    SequenceCRDT(const SequenceCRDT&) = delete;
+    SequenceCRDT& operator=(const SequenceCRDT&) = delete;
+
+    // Random 53-bit id so it also survives a round trip through JavaScript numbers
+    static uint64_t generateClientId() {
+        std::random_device device;
+        uint64_t id = (static_cast<uint64_t>(device()) << 32) | device();
+        return id & ((uint64_t{1} << 53) - 1);
+    }
+
+    uint64_t getClientId() const { return clientId_; }
+
+    // Visible characters
+    size_t length() const { return root_ ? root_->subtreeLength : 0; }
+    size_t lineCount() const { return (root_ ? root_->subtreeNewlines : 0) + 1; }
+
+    // Number of stored items including tombstones; stays small thanks to run-length encoding
+    size_t itemCount() const { return root_ ? root_->subtreeItems : 0; }
+
+    std::string toString() const {
+        std::string result;
+        result.reserve(length());
+        forEachItem([&result](const Item& item) {
+            if (!item.deleted) {
+                result += item.text;
+            }
+        });
+        return result;
+    }
+
+    std::vector<std::string> toLines() const {
+        std::vector<std::string> lines(1);
+        forEachItem([&lines](const Item& item) {
+            if (item.deleted) {
+                return;
+            }
+            for (char c : item.text) {
+                if (c == '\n') {
+                    lines.emplace_back();
+                } else {
+                    lines.back() += c;
+                }
+            }
+        });
+        return lines;
+    }
+
+    // Offset of the first character of a line; line must be < lineCount()
+    size_t lineStart(size_t line) const {
+        if (line == 0) {
+            return 0;
+        }
+        return offsetOfNewline(line) + 1;
+    }
+
+    // Length of a line without its terminating newline
+    size_t lineLength(size_t line) const {
+        size_t start = lineStart(line);
+        size_t end = line + 1 < lineCount() ? offsetOfNewline(line + 1) : length();
+        return end - start;
+    }
+
+    // Local edits. When update is given it receives the binary delta to send to other replicas.
+    bool insert(size_t offset, const std::string& text, std::vector<uint8_t>* update = nullptr) {
+        if (offset > length()) {
+            return false;
+        }
+        if (text.empty()) {
+            return true;
+        }
+
+        Item* left = nullptr;
+        if (offset > 0) {
+            uint64_t inner = 0;
+            left = findVisible(offset - 1, inner);
+            if (inner + 1 < left->length) {
+                splitItem(left, inner + 1);
+            }
+        }
+        Item* right = left ? next(left) : first();
+
+        uint64_t clock = clockOf(clientId_);
+        auto item = makeItem({clientId_, clock}, text.size(), text, false);
+        item->hasOrigin = left != nullptr;
+        if (left) {
+            item->origin = left->lastId();
+        }
+        item->hasRightOrigin = right != nullptr;
+        if (right) {
+            item->rightOrigin = right->id;
+        }
+
+        placeItem(left, std::move(item));
+        stateVector_[clientId_] = clock + text.size();
+
+        if (update) {
+            *update = encodeUpdate({{clientId_, clock, clock + text.size()}}, {});
+        }
+        return true;
+    }
+
+    bool erase(size_t offset, size_t count, std::vector<uint8_t>* update = nullptr) {
+        if (offset > length() || count > length() - offset) {
+            return false;
+        }
+
+        DeleteSet deleted;
+        while (count > 0) {
+            uint64_t inner = 0;
+            Item* item = findVisible(offset, inner);
+            if (inner > 0) {
+                item = splitItem(item, inner);
+            }
+            if (item->length > count) {
+                splitItem(item, count);
+            }
+            markDeleted(item);
+            deleted[item->id.client].emplace_back(item->id.clock, item->length);
+            count -= item->length;
+        }
+
+        if (update) {
+            *update = encodeUpdate({}, deleted);
+        }
+        return true;
+    }
+
+    // Sync protocol
+    const StateVector& getStateVector() const { return stateVector_; }
+
+    std::vector<uint8_t> encodeStateVector() const {
+        BinaryWriter writer;
+        writer.writeVarUInt(stateVector_.size());
+        for (const auto& [client, clock] : stateVector_) {
+            writer.writeVarUInt(client);
+            writer.writeVarUInt(clock);
+        }
+        return writer.release();
+    }
+
+    static bool decodeStateVector(const std::vector<uint8_t>& data, StateVector& stateVector) {
+        stateVector.clear();
+        if (data.empty()) {
+            return true; // Empty vector: the peer knows nothing yet
+        }
+
+        BinaryReader reader(data);
+        uint64_t count;
+        if (!reader.readVarUInt(count)) {
+            return false;
+        }
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t client, clock;
+            if (!reader.readVarUInt(client) || !reader.readVarUInt(clock)) {
+                return false;
+            }
+            stateVector[client] = clock;
+        }
+        return reader.atEnd();
+    }
+
+    // Everything the peer with the given state vector is missing, plus the full delete set
+    std::vector<uint8_t> encodeStateAsUpdate(const StateVector& remote = {}) const {
+        std::vector<ClientRange> ranges;
+        for (const auto& [client, clock] : stateVector_) {
+            auto it = remote.find(client);
+            uint64_t from = it != remote.end() ? it->second : 0;
+            if (from < clock) {
+                ranges.push_back({client, from, clock});
+            }
+        }
+        return encodeUpdate(ranges, collectDeleteSet());
+    }
+
+    // Merge an update produced by any replica. Returns false only for malformed input;
+    // changed reports whether the visible document or tombstones were affected.
+    bool applyUpdate(const std::vector<uint8_t>& update, bool* changed = nullptr) {
+        std::vector<PendingItem> items;
+        DeleteSet deletes;
+        if (!decodeUpdate(update, items, deletes)) {
+            return false;
+        }
+
+        for (auto& item : items) {
+            pendingItems_.push_back(std::move(item));
+        }
+        for (const auto& [client, ranges] : deletes) {
+            for (const auto& range : ranges) {
+                pendingDeletes_.push_back({client, range.first, range.second});
+            }
+        }
+
+        bool integrated = integratePendingItems();
+        bool deletedAny = applyPendingDeletes();
+        if (changed) {
+            *changed = integrated || deletedAny;
+        }
+        return true;
+    }
+
+    // Items or deletes waiting for updates from other replicas
+    bool hasPendingUpdates() const {
+        return !pendingItems_.empty() || !pendingDeletes_.empty();
+    }
+
+private:
+    struct Item {
+        ItemId id;
+        ItemId origin{0, 0};
+        ItemId rightOrigin{0, 0};
+        bool hasOrigin = false;
+        bool hasRightOrigin = false;
+        bool deleted = false;
+        uint64_t length = 0;
+        std::string text;       // Empty once deleted
+        uint64_t newlines = 0;
+
+        // Treap links and subtree aggregates
+        Item* left = nullptr;
+        Item* right = nullptr;
+        Item* parent = nullptr;
+        uint32_t priority = 0;
+        uint64_t subtreeItems = 1;
+        uint64_t subtreeLength = 0;
+        uint64_t subtreeNewlines = 0;
+
+        uint64_t visibleLength() const { return deleted ? 0 : length; }
+        ItemId lastId() const { return {id.client, id.clock + length - 1}; }
+    };
+
+    // Decoded remote item that has not been integrated yet
+    struct PendingItem {
+        ItemId id;
+        ItemId origin{0, 0};
+        ItemId rightOrigin{0, 0};
+        bool hasOrigin = false;
+        bool hasRightOrigin = false;
+        bool deleted = false;
+        uint64_t length = 0;
+        std::string text;
+    };
+
+    struct ClientRange {
+        uint64_t client;
+        uint64_t from;
+        uint64_t to;
+    };
+
+    struct PendingDelete {
+        uint64_t client;
+        uint64_t clock;
+        uint64_t length;
+    };
+
+    // client -> (clock, length) ranges
+    using DeleteSet = std::map<uint64_t, std::vector<std::pair<uint64_t, uint64_t>>>;
+
+    // Item info byte
+    static constexpr uint8_t HAS_ORIGIN = 0x01;
+    static constexpr uint8_t HAS_RIGHT_ORIGIN = 0x02;
+    static constexpr uint8_t IS_DELETED = 0x04;
+    static constexpr uint8_t ORIGIN_IS_PREVIOUS = 0x08;  // Origin is the same client's previous clock
+
+    uint64_t clientId_;
+    Item* root_;
+    std::mt19937 rng_;
+    std::vector<std::unique_ptr<Item>> storage_;
+    std::unordered_map<uint64_t, std::map<uint64_t, Item*>> index_;  // client -> start clock -> item
+    StateVector stateVector_;
+    std::vector<PendingItem> pendingItems_;
+    std::vector<PendingDelete> pendingDeletes_;
+
+    uint64_t clockOf(uint64_t client) const {
+        auto it = stateVector_.find(client);
+        return it != stateVector_.end() ? it->second : 0;
+    }
+
+    bool isKnown(const ItemId& id) const {
+        return id.clock < clockOf(id.client);
+    }
+
+    static bool sameOrigin(bool hasA, const ItemId& a, bool hasB, const ItemId& b) {
+        return hasA == hasB && (!hasA || a == b);
+    }
+
+    // ===== Treap maintenance =====
+
+    static uint64_t items(const Item* node) { return node ? node->subtreeItems : 0; }
+    static uint64_t visible(const Item* node) { return node ? node->subtreeLength : 0; }
+    static uint64_t newlines(const Item* node) { return node ? node->subtreeNewlines : 0; }
+
+    static void update(Item* node) {
+        node->subtreeItems = 1 + items(node->left) + items(node->right);
+        node->subtreeLength = node->visibleLength() + visible(node->left) + visible(node->right);
+        node->subtreeNewlines = node->newlines + newlines(node->left) + newlines(node->right);
+        if (node->left) node->left->parent = node;
+        if (node->right) node->right->parent = node;
+    }
+
+    static void refreshUpwards(Item* node) {
+        for (; node; node = node->parent) {
+            update(node);
+        }
+    }
+
+    static Item* merge(Item* a, Item* b) {
+        if (!a) return b;
+        if (!b) return a;
+        if (a->priority > b->priority) {
+            a->right = merge(a->right, b);
+            update(a);
+            return a;
+        }
+        b->left = merge(a, b->left);
+        update(b);
+        return b;
+    }
+
+    // Split into the first count items and the rest
+    static void split(Item* node, uint64_t count, Item*& first, Item*& rest) {
+        if (!node) {
+            first = rest = nullptr;
+            return;
+        }
+        if (items(node->left) < count) {
+            split(node->right, count - items(node->left) - 1, node->right, rest);
+            first = node;
+            update(first);
+        } else {
+            split(node->left, count, first, node->left);
+            rest = node;
+            update(rest);
+        }
+    }
+
+    static uint64_t rank(const Item* node) {
+        uint64_t result = items(node->left);
+        for (; node->parent; node = node->parent) {
+            if (node == node->parent->right) {
+                result += items(node->parent->left) + 1;
+            }
+        }
+        return result;
+    }
+
+    Item* first() const {
+        Item* node = root_;
+        while (node && node->left) {
+            node = node->left;
+        }
+        return node;
+    }
+
+    static Item* next(Item* node) {
+        if (node->right) {
+            node = node->right;
+            while (node->left) {
+                node = node->left;
+            }
+            return node;
+        }
+        while (node->parent && node == node->parent->right) {
+            node = node->parent;
+        }
+        return node->parent;
+    }
+
+    void insertAfter(Item* left, Item* node) {
+        Item* before;
+        Item* after;
+        split(root_, left ? rank(left) + 1 : 0, before, after);
+        root_ = merge(merge(before, node), after);
+        root_->parent = nullptr;
+    }
+
+    // Item holding the visible character at offset, and the offset within it
+    Item* findVisible(uint64_t offset, uint64_t& inner) const {
+        Item* node = root_;
+        while (node) {
+            uint64_t leftLength = visible(node->left);
+            if (offset < leftLength) {
+                node = node->left;
+                continue;
+            }
+            offset -= leftLength;
+            if (offset < node->visibleLength()) {
+                inner = offset;
+                return node;
+            }
+            offset -= node->visibleLength();
+            node = node->right;
+        }
+        return nullptr;
+    }
+
+    // Visible offset of the n-th newline (1-based)
+    size_t offsetOfNewline(uint64_t n) const {
+        size_t offset = 0;
+        Item* node = root_;
+        while (node) {
+            uint64_t leftNewlines = newlines(node->left);
+            if (n <= leftNewlines) {
+                node = node->left;
+                continue;
+            }
+            offset += visible(node->left);
+            n -= leftNewlines;
+            if (n <= node->newlines) {
+                size_t pos = 0;
+                for (;; ++pos) {
+                    if (node->text[pos] == '\n' && --n == 0) {
+                        return offset + pos;
+                    }
+                }
+            }
+            n -= node->newlines;
+            offset += node->visibleLength();
+            node = node->right;
+        }
+        return length();
+    }
+
+    template<typename Visitor>
+    void forEachItem(Visitor&& visit) const {
+        std::vector<const Item*> stack;
+        const Item* node = root_;
+        while (node || !stack.empty()) {
+            while (node) {
+                stack.push_back(node);
+                node = node->left;
+            }
+            node = stack.back();
+            stack.pop_back();
+            visit(*node);
+            node = node->right;
+        }
+    }
+
+    // ===== Items =====
+
+    std::unique_ptr<Item> makeItem(const ItemId& id, uint64_t length, std::string text, bool deleted) {
+        auto item = std::make_unique<Item>();
+        item->id = id;
+        item->length = length;
+        item->deleted = deleted;
+        if (!deleted) {
+            item->text = std::move(text);
+            item->newlines = std::count(item->text.begin(), item->text.end(), '\n');
+        }
+        item->priority = static_cast<uint32_t>(rng_());
+        update(item.get());
+        return item;
+    }
+
+    // Attach a new item after left, extending left instead when it continues the same run
+    void placeItem(Item* left, std::unique_ptr<Item> item) {
+        if (left && left->id.client == item->id.client &&
+            left->id.clock + left->length == item->id.clock &&
+            left->deleted == item->deleted &&
+            item->hasOrigin && item->origin == left->lastId() &&
+            sameOrigin(left->hasRightOrigin, left->rightOrigin, item->hasRightOrigin, item->rightOrigin)) {
+            left->length += item->length;
+            left->text += item->text;
+            left->newlines += item->newlines;
+            refreshUpwards(left);
+            return;
+        }
+
+        Item* node = item.get();
+        storage_.push_back(std::move(item));
+        index_[node->id.client][node->id.clock] = node;
+        insertAfter(left, node);
+    }
+
+    Item* findItem(const ItemId& id) const {
+        auto clientIt = index_.find(id.client);
+        if (clientIt == index_.end()) {
+            return nullptr;
+        }
+        auto it = clientIt->second.upper_bound(id.clock);
+        if (it == clientIt->second.begin()) {
+            return nullptr;
+        }
+        Item* item = std::prev(it)->second;
+        return id.clock < item->id.clock + item->length ? item : nullptr;
+    }
+
+    // Keep the first count characters in item and return a new item holding the rest
+    Item* splitItem(Item* item, uint64_t count) {
+        auto rest = std::make_unique<Item>();
+        rest->id = {item->id.client, item->id.clock + count};
+        rest->origin = {item->id.client, item->id.clock + count - 1};
+        rest->hasOrigin = true;
+        rest->rightOrigin = item->rightOrigin;
+        rest->hasRightOrigin = item->hasRightOrigin;
+        rest->deleted = item->deleted;
+        rest->length = item->length - count;
+        if (!item->deleted) {
+            rest->text = item->text.substr(count);
+            item->text.resize(count);
+            rest->newlines = std::count(rest->text.begin(), rest->text.end(), '\n');
+            item->newlines -= rest->newlines;
+        }
+        rest->priority = static_cast<uint32_t>(rng_());
+        update(rest.get());
+
+        item->length = count;
+        refreshUpwards(item);
+
+        Item* node = rest.get();
+        storage_.push_back(std::move(rest));
+        index_[node->id.client][node->id.clock] = node;
+        insertAfter(item, node);
+        return node;
+    }
+
+    // Item that ends exactly at id
+    Item* cleanEnd(const ItemId& id) {
+        Item* item = findItem(id);
+        if (id.clock + 1 < item->id.clock + item->length) {
+            splitItem(item, id.clock - item->id.clock + 1);
+        }
+        return item;
+    }
+
+    // Item that starts exactly at id
+    Item* cleanStart(const ItemId& id) {
+        Item* item = findItem(id);
+        if (id.clock > item->id.clock) {
+            return splitItem(item, id.clock - item->id.clock);
+        }
+        return item;
+    }
+
+    void markDeleted(Item* item) {
+        item->deleted = true;
+        item->newlines = 0;
+        std::string().swap(item->text);
+        refreshUpwards(item);
+    }
+
+    // ===== Remote integration =====
+
+    bool integratePendingItems() {
+        bool changed = false;
+        bool progress = true;
+        while (progress && !pendingItems_.empty()) {
+            progress = false;
+            std::sort(pendingItems_.begin(), pendingItems_.end(), [](const PendingItem& a, const PendingItem& b) {
+                return a.id.client != b.id.client ? a.id.client < b.id.client : a.id.clock < b.id.clock;
+            });
+
+            std::vector<PendingItem> blocked;
+            for (auto& pending : pendingItems_) {
+                uint64_t known = clockOf(pending.id.client);
+                if (pending.id.clock + pending.length <= known) {
+                    continue; // Already have all of it
+                }
+                if (pending.id.clock > known ||
+                    (pending.hasOrigin && !isKnown(pending.origin)) ||
+                    (pending.hasRightOrigin && !isKnown(pending.rightOrigin))) {
+                    blocked.push_back(std::move(pending));
+                    continue;
+                }
+
+                // Drop the prefix we already have; the remainder hangs off its last character
+                if (pending.id.clock < known) {
+                    uint64_t overlap = known - pending.id.clock;
+                    pending.id.clock = known;
+                    pending.origin = {pending.id.client, known - 1};
+                    pending.hasOrigin = true;
+                    pending.length -= overlap;
+                    if (!pending.deleted) {
+                        pending.text.erase(0, overlap);
+                    }
+                }
+
+                integrate(pending);
+                stateVector_[pending.id.client] = pending.id.clock + pending.length;
+                changed = progress = true;
+            }
+            pendingItems_ = std::move(blocked);
+        }
+        return changed;
+    }
+
+    // YATA: scan the items between the origins and place the new item after
+    // every concurrent insert that must precede it
+    void integrate(PendingItem& pending) {
+        if (pending.hasRightOrigin) {
+            cleanStart(pending.rightOrigin);
+        }
+        if (pending.hasOrigin) {
+            cleanEnd(pending.origin);
+        }
+        Item* left = pending.hasOrigin ? findItem(pending.origin) : nullptr;
+        Item* rightStop = pending.hasRightOrigin ? findItem(pending.rightOrigin) : nullptr;
+
+        std::unordered_set<const Item*> itemsBeforeOrigin;
+        std::unordered_set<const Item*> conflicting;
+        for (Item* other = left ? next(left) : first(); other && other != rightStop; other = next(other)) {
+            itemsBeforeOrigin.insert(other);
+            conflicting.insert(other);
+
+            if (sameOrigin(other->hasOrigin, other->origin, pending.hasOrigin, pending.origin)) {
+                // Same left neighbour: lower client ids go first
+                if (other->id.client < pending.id.client) {
+                    left = other;
+                    conflicting.clear();
+                } else if (sameOrigin(other->hasRightOrigin, other->rightOrigin,
+                                      pending.hasRightOrigin, pending.rightOrigin)) {
+                    break;
+                }
+            } else if (other->hasOrigin && itemsBeforeOrigin.count(findItem(other->origin))) {
+                if (!conflicting.count(findItem(other->origin))) {
+                    left = other;
+                    conflicting.clear();
+                }
+            } else {
+                break;
+            }
+        }
+
+        auto item = makeItem(pending.id, pending.length, std::move(pending.text), pending.deleted);
+        item->origin = pending.origin;
+        item->hasOrigin = pending.hasOrigin;
+        item->rightOrigin = pending.rightOrigin;
+        item->hasRightOrigin = pending.hasRightOrigin;
+        placeItem(left, std::move(item));
+    }
+
+    bool applyPendingDeletes() {
+        bool changed = false;
+        std::vector<PendingDelete> blocked;
+        for (const auto& range : pendingDeletes_) {
+            uint64_t known = clockOf(range.client);
+            uint64_t from = range.clock;
+            uint64_t to = range.clock + range.length;
+
+            // Anything beyond what we know waits for the insert to arrive
+            if (to > known) {
+                uint64_t blockedFrom = std::max(from, known);
+                blocked.push_back({range.client, blockedFrom, to - blockedFrom});
+                to = std::max(from, known);
+            }
+
+            while (from < to) {
+                Item* item = findItem({range.client, from});
+                if (from > item->id.clock) {
+                    item = splitItem(item, from - item->id.clock);
+                }
+                if (item->length > to - from) {
+                    splitItem(item, to - from);
+                }
+                if (!item->deleted) {
+                    markDeleted(item);
+                    changed = true;
+                }
+                from += item->length;
+            }
+        }
+        pendingDeletes_ = std::move(blocked);
+        return changed;
+    }
+
+    DeleteSet collectDeleteSet() const {
+        DeleteSet deleted;
+        for (const auto& [client, items] : index_) {
+            auto& ranges = deleted[client];
+            for (const auto& [clock, item] : items) {
+                if (!item->deleted) {
+                    continue;
+                }
+                if (!ranges.empty() && ranges.back().first + ranges.back().second == clock) {
+                    ranges.back().second += item->length;
+                } else {
+                    ranges.emplace_back(clock, item->length);
+                }
+            }
+            if (ranges.empty()) {
+                deleted.erase(client);
+            }
+        }
+        return deleted;
+    }
+
+    // ===== Binary encoding =====
+    //
+    // Per client the items are written column by column (lengths, info bytes,
+    // origins, right origins, then the concatenated text). Clocks are implicit
+    // since each client's items are contiguous, and origins that point at the
+    // previous character of the same client are flagged rather than written.
+
+    std::vector<uint8_t> encodeUpdate(const std::vector<ClientRange>& ranges, const DeleteSet& deleted) const {
+        struct Slice {
+            const Item* item;
+            uint64_t offset;
+            uint64_t length;
+        };
+
+        BinaryWriter writer;
+        writer.writeVarUInt(ranges.size());
+        for (const auto& range : ranges) {
+            std::vector<Slice> slices;
+            const auto& items = index_.at(range.client);
+            auto it = items.upper_bound(range.from);
+            if (it != items.begin()) {
+                --it;
+            }
+            for (; it != items.end() && it->first < range.to; ++it) {
+                const Item* item = it->second;
+                uint64_t start = std::max(range.from, item->id.clock);
+                uint64_t end = std::min(range.to, item->id.clock + item->length);
+                if (start < end) {
+                    slices.push_back({item, start - item->id.clock, end - start});
+                }
+            }
+
+            writer.writeVarUInt(range.client);
+            writer.writeVarUInt(range.from);
+            writer.writeVarUInt(slices.size());
+
+            for (const auto& slice : slices) {
+                writer.writeVarUInt(slice.length);
+            }
+
+            std::vector<ItemId> origins;
+            for (const auto& slice : slices) {
+                uint64_t clock = slice.item->id.clock + slice.offset;
+                bool hasOrigin = slice.offset > 0 || slice.item->hasOrigin;
+                ItemId origin = slice.offset > 0 ? ItemId{range.client, clock - 1} : slice.item->origin;
+
+                uint8_t info = 0;
+                if (hasOrigin) {
+                    info |= HAS_ORIGIN;
+                    if (origin.client == range.client && origin.clock + 1 == clock) {
+                        info |= ORIGIN_IS_PREVIOUS;
+                    } else {
+                        origins.push_back(origin);
+                    }
+                }
+                if (slice.item->hasRightOrigin) info |= HAS_RIGHT_ORIGIN;
+                if (slice.item->deleted) info |= IS_DELETED;
+                writer.writeByte(info);
+            }
+
+            for (const auto& origin : origins) {
+                writer.writeVarUInt(origin.client);
+                writer.writeVarUInt(origin.clock);
+            }
+            for (const auto& slice : slices) {
+                if (slice.item->hasRightOrigin) {
+                    writer.writeVarUInt(slice.item->rightOrigin.client);
+                    writer.writeVarUInt(slice.item->rightOrigin.clock);
+                }
+            }
+            for (const auto& slice : slices) {
+                if (!slice.item->deleted) {
+                    writer.writeBytes(slice.item->text.data() + slice.offset, slice.length);
+                }
+            }
+        }
+
+        writer.writeVarUInt(deleted.size());
+        for (const auto& [client, clientRanges] : deleted) {
+            auto sorted = clientRanges;
+            std::sort(sorted.begin(), sorted.end());
+            writer.writeVarUInt(client);
+            writer.writeVarUInt(sorted.size());
+            uint64_t previousEnd = 0;
+            for (const auto& [clock, length] : sorted) {
+                writer.writeVarUInt(clock - previousEnd);  // Ranges are sorted and disjoint
+                writer.writeVarUInt(length);
+                previousEnd = clock + length;
+            }
+        }
+        return writer.release();
+    }
+
+    static bool decodeUpdate(const std::vector<uint8_t>& data, std::vector<PendingItem>& items, DeleteSet& deleted) {
+        BinaryReader reader(data);
+
+        uint64_t clientCount;
+        if (!reader.readVarUInt(clientCount)) {
+            return false;
+        }
+        for (uint64_t c = 0; c < clientCount; ++c) {
+            uint64_t client, clock, count;
+            if (!reader.readVarUInt(client) || !reader.readVarUInt(clock) ||
+                !reader.readVarUInt(count) || count > reader.remaining()) {
+                return false;
+            }
+
+            size_t firstItem = items.size();
+            for (uint64_t i = 0; i < count; ++i) {
+                PendingItem item;
+                if (!reader.readVarUInt(item.length) || item.length == 0 ||
+                    clock + item.length < clock) {
+                    return false;
+                }
+                item.id = {client, clock};
+                clock += item.length;
+                items.push_back(std::move(item));
+            }
+
+            std::vector<bool> explicitOrigin(count, false);
+            for (size_t i = firstItem; i < items.size(); ++i) {
+                uint8_t info;
+                if (!reader.readByte(info)) {
+                    return false;
+                }
+                items[i].hasOrigin = info & HAS_ORIGIN;
+                items[i].hasRightOrigin = info & HAS_RIGHT_ORIGIN;
+                items[i].deleted = info & IS_DELETED;
+                if (!items[i].hasOrigin) {
+                    continue;
+                }
+                if (info & ORIGIN_IS_PREVIOUS) {
+                    if (items[i].id.clock == 0) {
+                        return false;
+                    }
+                    items[i].origin = {client, items[i].id.clock - 1};
+                } else {
+                    explicitOrigin[i - firstItem] = true;
+                }
+            }
+
+            for (size_t i = firstItem; i < items.size(); ++i) {
+                if (explicitOrigin[i - firstItem] &&
+                    (!reader.readVarUInt(items[i].origin.client) || !reader.readVarUInt(items[i].origin.clock))) {
+                    return false;
+                }
+            }
+            for (size_t i = firstItem; i < items.size(); ++i) {
+                if (items[i].hasRightOrigin &&
+                    (!reader.readVarUInt(items[i].rightOrigin.client) || !reader.readVarUInt(items[i].rightOrigin.clock))) {
+                    return false;
+                }
+            }
+            for (size_t i = firstItem; i < items.size(); ++i) {
+                if (!items[i].deleted && !reader.readRaw(items[i].text, items[i].length)) {
+                    return false;
+                }
+            }
+        }
+
+        uint64_t deleteClients;
+        if (!reader.readVarUInt(deleteClients)) {
+            return false;
+        }
+        for (uint64_t c = 0; c < deleteClients; ++c) {
+            uint64_t client, rangeCount;
+            if (!reader.readVarUInt(client) || !reader.readVarUInt(rangeCount) || rangeCount > reader.remaining()) {
+                return false;
+            }
+            uint64_t previousEnd = 0;
+            for (uint64_t r = 0; r < rangeCount; ++r) {
+                uint64_t delta, length;
+                if (!reader.readVarUInt(delta) || !reader.readVarUInt(length)) {
+                    return false;
+                }
+                uint64_t clock = previousEnd + delta;
+                if (clock < previousEnd || clock + length < clock) {
+                    return false;
+                }
+                if (length > 0) {
+                    deleted[client].emplace_back(clock, length);
+                }
+                previousEnd = clock + length;
+            }
+        }
+        return reader.atEnd();
+    }
+};
+
+} // namespace collaboration
+} // namespace bolt
+
+#endif
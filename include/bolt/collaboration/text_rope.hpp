@@ -0,0 +1,459 @@
+#ifndef TEXT_ROPE_HPP
+#define TEXT_ROPE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bolt {
+namespace collaboration {
+
+/**
+ * Text buffer for large collaboratively edited documents.
+ *
+ * The text is kept as a balanced tree (treap) of chunks of at most
+ * MAX_CHUNK bytes. Every node caches the length and newline count of its
+ * subtree, which doubles as a line index: edits and line/offset lookups
+ * cost O(log n) whatever the document size and whether or not the edited
+ * text contains newlines. Edits that fit inside one chunk are made in
+ * place, so typing and backspacing do not fragment the tree. A chunk that
+ * an erase empties is unlinked, and one that shrinks below MIN_CHUNK is
+ * merged with a neighbour, so long runs of deletes don't leave the tree
+ * full of slivers.
+ */
+class TextRope {
+public:
+    static constexpr size_t MAX_CHUNK = 1024;
+    static constexpr size_t MIN_CHUNK = MAX_CHUNK / 4;
+
+    TextRope() = default;
+
+    explicit TextRope(const std::string& text) {
+        insert(0, text);
+    }
+
+    TextRope(const TextRope& other) : TextRope(other.toString()) {}
+
+    TextRope& operator=(const TextRope& other) {
+        if (this != &other) {
+            TextRope copy(other);
+            root_ = std::move(copy.root_);
+        }
+        return *this;
+    }
+
+    TextRope(TextRope&&) noexcept = default;
+    TextRope& operator=(TextRope&&) noexcept = default;
+
+    size_t length() const { return lengthOf(root_); }
+    bool empty() const { return length() == 0; }
+
+    // An empty document has one (empty) line
+    size_t lineCount() const { return newlinesOf(root_) + 1; }
+
+    // Offset of the first character of a line; length() for line >= lineCount()
+    size_t lineStart(size_t line) const {
+        if (line == 0) {
+            return 0;
+        }
+        if (line >= lineCount()) {
+            return length();
+        }
+        return offsetAfterNewline(line);
+    }
+
+    // Length of a line, not counting its newline
+    size_t lineLength(size_t line) const {
+        if (line >= lineCount()) {
+            return 0;
+        }
+        size_t start = lineStart(line);
+        size_t end = line + 1 < lineCount() ? offsetAfterNewline(line + 1) - 1 : length();
+        return end - start;
+    }
+
+    // Line containing the given offset
+    size_t lineOf(size_t offset) const {
+        return newlinesBefore(std::min(offset, length()));
+    }
+
+    // Returns false if offset is past the end
+    bool insert(size_t offset, const std::string& text) {
+        if (offset > length()) {
+            return false;
+        }
+        if (text.empty()) {
+            return true;
+        }
+
+        // Typing and other short edits land in an existing chunk
+        if (text.length() < MAX_CHUNK && insertInChunk(root_.get(), offset, text)) {
+            return true;
+        }
+
+        auto [left, right] = split(std::move(root_), offset);
+        NodePtr middle;
+        for (size_t pos = 0; pos < text.length(); pos += MAX_CHUNK) {
+            middle = merge(std::move(middle), makeNode(text.substr(pos, MAX_CHUNK)));
+        }
+        root_ = merge(merge(std::move(left), std::move(middle)), std::move(right));
+        return true;
+    }
+
+    // Returns false if the range runs past the end
+    bool erase(size_t offset, size_t count) {
+        if (offset > length() || count > length() - offset) {
+            return false;
+        }
+        if (count == 0) {
+            return true;
+        }
+
+        if (!eraseInChunk(root_, offset, count)) {
+            auto [left, rest] = split(std::move(root_), offset);
+            auto [removed, right] = split(std::move(rest), count);
+            root_ = merge(std::move(left), std::move(right));
+        }
+
+        // Chunks on either side of the erase point may now be undersized
+        if (offset > 0) {
+            coalesce(offset - 1);
+        }
+        if (offset < length()) {
+            coalesce(offset);
+        }
+        return true;
+    }
+
+    std::string substr(size_t offset, size_t count) const {
+        std::string result;
+        if (offset < length()) {
+            count = std::min(count, length() - offset);
+            result.reserve(count);
+            appendRange(root_.get(), offset, offset + count, result);
+        }
+        return result;
+    }
+
+    std::string line(size_t index) const {
+        return substr(lineStart(index), lineLength(index));
+    }
+
+    std::string toString() const {
+        return substr(0, length());
+    }
+
+    std::vector<std::string> toLines() const {
+        std::vector<std::string> lines(1);
+        forEachChunk(root_.get(), [&lines](const std::string& chunk) {
+            for (char c : chunk) {
+                if (c == '\n') {
+                    lines.emplace_back();
+                } else {
+                    lines.back() += c;
+                }
+            }
+        });
+        return lines;
+    }
+
+    // Number of chunks, for diagnostics
+    size_t chunkCount() const {
+        size_t count = 0;
+        forEachChunk(root_.get(), [&count](const std::string&) { count++; });
+        return count;
+    }
+
+private:
+    struct Node;
+    using NodePtr = std::unique_ptr<Node>;
+
+    struct Node {
+        std::string text;
+        uint32_t priority;
+        size_t textNewlines;
+        size_t subtreeLength;
+        size_t subtreeNewlines;
+        NodePtr left;
+        NodePtr right;
+    };
+
+    static size_t lengthOf(const NodePtr& node) { return node ? node->subtreeLength : 0; }
+    static size_t newlinesOf(const NodePtr& node) { return node ? node->subtreeNewlines : 0; }
+
+    static void update(Node* node) {
+        node->subtreeLength = lengthOf(node->left) + node->text.length() + lengthOf(node->right);
+        node->subtreeNewlines = newlinesOf(node->left) + node->textNewlines + newlinesOf(node->right);
+    }
+
+    NodePtr makeNode(std::string text) {
+        auto node = std::make_unique<Node>();
+        node->textNewlines = static_cast<size_t>(std::count(text.begin(), text.end(), '\n'));
+        node->text = std::move(text);
+        node->priority = nextPriority();
+        update(node.get());
+        return node;
+    }
+
+    // xorshift32; priorities only need to look random to keep the tree balanced
+    uint32_t nextPriority() {
+        seed_ ^= seed_ << 13;
+        seed_ ^= seed_ >> 17;
+        seed_ ^= seed_ << 5;
+        return seed_;
+    }
+
+    // Split into [0, offset) and [offset, end), cutting a chunk if needed
+    std::pair<NodePtr, NodePtr> split(NodePtr node, size_t offset) {
+        if (!node) {
+            return {nullptr, nullptr};
+        }
+
+        size_t leftLength = lengthOf(node->left);
+        if (offset <= leftLength) {
+            auto [left, right] = split(std::move(node->left), offset);
+            node->left = std::move(right);
+            update(node.get());
+            return {std::move(left), std::move(node)};
+        }
+
+        size_t nodeEnd = leftLength + node->text.length();
+        if (offset >= nodeEnd) {
+            auto [left, right] = split(std::move(node->right), offset - nodeEnd);
+            node->right = std::move(left);
+            update(node.get());
+            return {std::move(node), std::move(right)};
+        }
+
+        // The cut falls inside this chunk: keep the head here, move the tail to a new node
+        size_t cut = offset - leftLength;
+        NodePtr tail = makeNode(node->text.substr(cut));
+        tail->priority = node->priority; // Takes this node's place above its right subtree
+        node->text.erase(cut);
+        node->textNewlines -= tail->textNewlines;
+        tail->right = std::move(node->right);
+        update(tail.get());
+        update(node.get());
+        return {std::move(node), std::move(tail)};
+    }
+
+    static NodePtr merge(NodePtr left, NodePtr right) {
+        if (!left) return right;
+        if (!right) return left;
+
+        if (left->priority > right->priority) {
+            left->right = merge(std::move(left->right), std::move(right));
+            update(left.get());
+            return left;
+        }
+        right->left = merge(std::move(left), std::move(right->left));
+        update(right.get());
+        return right;
+    }
+
+    static bool insertInChunk(Node* node, size_t offset, const std::string& text) {
+        if (!node) {
+            return false;
+        }
+
+        size_t leftLength = lengthOf(node->left);
+        size_t nodeEnd = leftLength + node->text.length();
+        bool inserted;
+        if (offset < leftLength) {
+            inserted = insertInChunk(node->left.get(), offset, text);
+        } else if (offset <= nodeEnd && node->text.length() + text.length() <= MAX_CHUNK) {
+            node->text.insert(offset - leftLength, text);
+            node->textNewlines += static_cast<size_t>(std::count(text.begin(), text.end(), '\n'));
+            inserted = true;
+        } else if (offset >= nodeEnd) {
+            inserted = insertInChunk(node->right.get(), offset - nodeEnd, text);
+        } else {
+            inserted = false;
+        }
+
+        if (inserted) {
+            update(node);
+        }
+        return inserted;
+    }
+
+    static bool eraseInChunk(NodePtr& node, size_t offset, size_t count) {
+        if (!node) {
+            return false;
+        }
+
+        size_t leftLength = lengthOf(node->left);
+        size_t nodeEnd = leftLength + node->text.length();
+        bool erased;
+        if (offset < leftLength) {
+            erased = eraseInChunk(node->left, offset, count);
+        } else if (offset < nodeEnd) {
+            erased = offset + count <= nodeEnd;
+            if (erased) {
+                auto from = node->text.begin() + static_cast<std::ptrdiff_t>(offset - leftLength);
+                auto to = from + static_cast<std::ptrdiff_t>(count);
+                node->textNewlines -= static_cast<size_t>(std::count(from, to, '\n'));
+                node->text.erase(from, to);
+                if (node->text.empty()) {
+                    node = merge(std::move(node->left), std::move(node->right));
+                    return true;
+                }
+            }
+        } else {
+            erased = eraseInChunk(node->right, offset - nodeEnd, count);
+        }
+
+        if (erased) {
+            update(node.get());
+        }
+        return erased;
+    }
+
+    // Start and length of the chunk holding the character at offset < length()
+    std::pair<size_t, size_t> chunkAt(size_t offset) const {
+        size_t start = 0;
+        const Node* node = root_.get();
+        while (node) {
+            size_t leftLength = lengthOf(node->left);
+            if (offset < leftLength) {
+                node = node->left.get();
+                continue;
+            }
+            offset -= leftLength;
+            start += leftLength;
+            if (offset < node->text.length()) {
+                return {start, node->text.length()};
+            }
+            offset -= node->text.length();
+            start += node->text.length();
+            node = node->right.get();
+        }
+        return {start, 0};
+    }
+
+    // Merge the chunk holding offset with a neighbour if it is undersized;
+    // the result is cut in two if it would exceed MAX_CHUNK
+    void coalesce(size_t offset) {
+        auto [start, size] = chunkAt(offset);
+        if (size >= MIN_CHUNK) {
+            return;
+        }
+
+        size_t end = start + size;
+        if (end < length()) {
+            end += chunkAt(end).second;
+        } else if (start > 0) {
+            start = chunkAt(start - 1).first;
+        } else {
+            return; // The only chunk
+        }
+
+        auto [left, rest] = split(std::move(root_), start);
+        auto [window, right] = split(std::move(rest), end - start);
+        std::string text;
+        text.reserve(end - start);
+        forEachChunk(window.get(), [&text](const std::string& chunk) { text += chunk; });
+
+        NodePtr middle;
+        if (text.length() <= MAX_CHUNK) {
+            middle = makeNode(std::move(text));
+        } else {
+            size_t half = text.length() / 2;
+            middle = merge(makeNode(text.substr(0, half)), makeNode(text.substr(half)));
+        }
+        root_ = merge(merge(std::move(left), std::move(middle)), std::move(right));
+    }
+
+    // Offset just past the n-th newline (1-based); n must not exceed the newline count
+    size_t offsetAfterNewline(size_t n) const {
+        size_t offset = 0;
+        const Node* node = root_.get();
+        while (node) {
+            size_t leftNewlines = newlinesOf(node->left);
+            if (n <= leftNewlines) {
+                node = node->left.get();
+                continue;
+            }
+            n -= leftNewlines;
+            offset += lengthOf(node->left);
+            if (n <= node->textNewlines) {
+                size_t pos = 0;
+                for (size_t seen = 0;; ++pos) {
+                    if (node->text[pos] == '\n' && ++seen == n) {
+                        return offset + pos + 1;
+                    }
+                }
+            }
+            n -= node->textNewlines;
+            offset += node->text.length();
+            node = node->right.get();
+        }
+        return offset;
+    }
+
+    size_t newlinesBefore(size_t offset) const {
+        size_t newlines = 0;
+        const Node* node = root_.get();
+        while (node && offset > 0) {
+            size_t leftLength = lengthOf(node->left);
+            if (offset <= leftLength) {
+                node = node->left.get();
+                continue;
+            }
+            newlines += newlinesOf(node->left);
+            offset -= leftLength;
+            if (offset <= node->text.length()) {
+                newlines += static_cast<size_t>(std::count(node->text.begin(), node->text.begin() + offset, '\n'));
+                break;
+            }
+            newlines += node->textNewlines;
+            offset -= node->text.length();
+            node = node->right.get();
+        }
+        return newlines;
+    }
+
+    // Append text in [begin, end) of this subtree
+    static void appendRange(const Node* node, size_t begin, size_t end, std::string& out) {
+        if (!node || begin >= end) {
+            return;
+        }
+
+        size_t leftLength = lengthOf(node->left);
+        if (begin < leftLength) {
+            appendRange(node->left.get(), begin, std::min(end, leftLength), out);
+        }
+
+        size_t nodeEnd = leftLength + node->text.length();
+        if (begin < nodeEnd && end > leftLength) {
+            size_t from = begin > leftLength ? begin - leftLength : 0;
+            size_t to = std::min(end, nodeEnd) - leftLength;
+            out.append(node->text, from, to - from);
+        }
+
+        if (end > nodeEnd) {
+            appendRange(node->right.get(), begin > nodeEnd ? begin - nodeEnd : 0, end - nodeEnd, out);
+        }
+    }
+
+    template<typename Visitor>
+    static void forEachChunk(const Node* node, Visitor&& visit) {
+        if (!node) {
+            return;
+        }
+        forEachChunk(node->left.get(), visit);
+        visit(node->text);
+        forEachChunk(node->right.get(), visit);
+    }
+
+    NodePtr root_;
+    uint32_t seed_ = 2463534242u;
+};
+
+} // namespace collaboration
+} // namespace bolt
+
+#endif
@@ -4,12 +4,19 @@
 #include <memory>
 #include <functional>
 #include <map>
+#include <deque>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
 
 namespace bolt {
 namespace drawkern {
 
 // Forward declarations for integration
 class DISVM;
+class DISVMManager;
 class StyxServer; 
 class YaccGrammarSystem;
 class DISProgram;
@@ -92,6 +99,10 @@ public:
     virtual AIInferenceResponse chat(const std::string& message, const std::string& context = "") = 0;
     virtual AIInferenceResponse complete_code(const std::string& code, const std::string& language = "cpp") = 0;
     
+    // One forward pass over several requests, responses in request order.
+    // The default runs them one by one; backends that can batch override it.
+    virtual std::vector<AIInferenceResponse> generate_batch(const std::vector<AIInferenceRequest>& requests);
+    
     // Model info
     virtual std::string get_model_info() const = 0;
     virtual std::vector<std::string> get_capabilities() const = 0;
@@ -155,14 +166,22 @@ private:
     void update_state(const std::vector<int32_t>& tokens);
 };
 
-// AI Model Manager for DrawKern
+// AI Model Manager for DrawKern. Safe to use from several threads; each
+// model runs one inference at a time.
 class DrawKernAIManager {
 public:
+    using Completion = std::function<void(const AIInferenceResponse&)>;
+    
+    static constexpr size_t DEFAULT_MAX_BATCH_SIZE = 16;
+    static constexpr std::chrono::microseconds DEFAULT_BATCH_WINDOW{2000};
+    
     DrawKernAIManager();
     ~DrawKernAIManager();
     
-    // Model management
+    // Model management. The second form takes a model that is already
+    // constructed and loads it.
     bool load_model(const std::string& model_id, const AIModelConfig& config);
+    bool load_model(const std::string& model_id, std::unique_ptr<AIModel> model);
     bool unload_model(const std::string& model_id);
     bool is_model_loaded(const std::string& model_id) const;
     
@@ -171,6 +190,16 @@ public:
     AIInferenceResponse chat(const std::string& model_id, const std::string& message, const std::string& session_id = "");
     AIInferenceResponse complete_code(const std::string& model_id, const std::string& code, const std::string& language = "cpp");
     
+    // Queued inference. Requests for a model are collected until
+    // max_batch_size are waiting or the oldest has waited the batch window,
+    // then run as one generate_batch call. Completions run on the
+    // dispatcher thread and should not block; requests still queued when
+    // their model is unloaded or the manager is destroyed complete with
+    // an error.
+    void submit(const std::string& model_id, AIInferenceRequest request, Completion completion);
+    std::future<AIInferenceResponse> submit(const std::string& model_id, AIInferenceRequest request);
+    void set_batching(size_t max_batch_size, std::chrono::microseconds window);
+    
     // DrawKern integration
     void register_vm_ai_handler(const std::string& vm_id, std::function<void(const AIInferenceResponse&)> handler);
     void broadcast_to_vm(const std::string& vm_id, const AIInferenceResponse& response);
@@ -192,19 +221,63 @@ public:
         size_t successful_requests = 0;
         float average_inference_time_ms = 0.0f;
         size_t total_tokens_generated = 0;
+        
+        // Queued requests
+        size_t batches = 0;
+        float average_batch_size = 0.0f;
+        float average_queue_time_ms = 0.0f;  // Submit to start of its batch
+        float p50_latency_ms = 0.0f;         // Submit to completion, recent requests
+        float p99_latency_ms = 0.0f;
+        float requests_per_second = 0.0f;    // Since the first queued request
+        float tokens_per_second = 0.0f;
     };
     
     std::vector<ModelStats> get_model_statistics() const;
     
 private:
-    std::map<std::string, std::unique_ptr<AIModel>> models_;
+    static constexpr size_t LATENCY_WINDOW = 1024;
+    
+    struct PendingRequest {
+        AIInferenceRequest request;
+        Completion completion;
+        std::chrono::steady_clock::time_point queued_at;
+    };
+    
+    struct ModelSlot {
+        std::unique_ptr<AIModel> model;
+        std::mutex inference_mutex;  // One forward pass at a time
+        std::deque<PendingRequest> queue;
+        ModelStats stats;
+        
+        // Queued request bookkeeping behind the exported stats
+        std::deque<float> recent_latencies_ms;
+        size_t queued_completed = 0;
+        size_t queued_tokens = 0;
+        double total_queue_time_ms = 0.0;
+        std::chrono::steady_clock::time_point first_queued;
+        std::chrono::steady_clock::time_point last_completed;
+    };
+    
+    // Guards everything below except what ModelSlot::inference_mutex guards
+    mutable std::mutex mutex_;
+    std::map<std::string, std::shared_ptr<ModelSlot>> models_;
     std::map<std::string, std::string> sessions_;  // session_id -> model_id
     std::map<std::string, std::vector<std::string>> session_history_;
     std::map<std::string, std::function<void(const AIInferenceResponse&)>> vm_handlers_;
-    std::map<std::string, ModelStats> model_stats_;
+    
+    // Batching dispatcher, started by the first submit
+    std::condition_variable queue_cv_;
+    std::thread dispatcher_;
+    bool stopping_ = false;
+    size_t max_batch_size_ = DEFAULT_MAX_BATCH_SIZE;
+    std::chrono::microseconds batch_window_ = DEFAULT_BATCH_WINDOW;
     
     std::unique_ptr<AIModel> create_model(const AIModelConfig& config);
-    void update_stats(const std::string& model_id, const AIInferenceResponse& response);
+    std::shared_ptr<ModelSlot> find_slot(const std::string& model_id) const;
+    void update_stats(ModelSlot& slot, const AIInferenceResponse& response);
+    void dispatch_loop();
+    void run_batch(ModelSlot& slot, std::vector<PendingRequest> batch);
+    void notify_vm(const std::string& vm_id, const AIInferenceResponse& response);
 };
 
 // Factory for creating pre-configured AI models
@@ -268,6 +341,11 @@ namespace Integration {
     // Connect AI to DIS VMs
     void setup_dis_vm_ai_integration(DISVM& vm, DrawKernAIManager& ai_manager, const std::string& model_id);
     
+    // Route the AI opcodes of VMs the manager creates from now on through
+    // the batching queue; a VM parks until its response arrives. Destroy
+    // the AI manager before the VM manager.
+    void setup_dis_vm_manager_ai_integration(DISVMManager& vm_manager, DrawKernAIManager& ai_manager, const std::string& model_id);
+    
     // Connect AI to Styx protocol
     void setup_styx_ai_integration(StyxServer& server, DrawKernAIManager& ai_manager);
     
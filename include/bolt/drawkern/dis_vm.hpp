@@ -1,12 +1,21 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
+#include <algorithm>
 #include <map>
 #include <set>
-#include <stack>
 #include <memory>
 #include <functional>
+#include <optional>
+#include <atomic>
 #include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
 
 namespace bolt {
 namespace drawkern {
@@ -20,6 +29,10 @@ enum class DISOpcode : uint8_t {
     STORE   = 0x02,  // Store from stack to memory
     POP     = 0x03,  // Pop stack
     DUP     = 0x04,  // Duplicate top of stack
+    LOADG   = 0x05,  // Push global slot
+    STOREG  = 0x06,  // Pop into global slot
+    LOADL   = 0x07,  // Push local slot of the current frame
+    STOREL  = 0x08,  // Pop into local slot of the current frame
     
     // Arithmetic operations
     ADD     = 0x10,  // Add two values
@@ -42,6 +55,7 @@ enum class DISOpcode : uint8_t {
     JMPF    = 0x32,  // Jump if false
     CALL    = 0x33,  // Function call
     RET     = 0x34,  // Return from function
+    ENTER   = 0x35,  // Allocate the current frame's locals
     
     // String operations
     NEWSTR  = 0x40,  // Create new string
@@ -56,6 +70,8 @@ enum class DISOpcode : uint8_t {
     // I/O operations
     PRINT   = 0x60,  // Print to output
     READ    = 0x61,  // Read from input
+    RECV    = 0x62,  // Receive from the mailbox, waiting if it is empty
+    SEND    = 0x63,  // Send to another VM's mailbox
     
     // AI operations (DrawKern extensions)
     AI_INIT     = 0x70,  // Initialize AI model
@@ -71,25 +87,132 @@ enum class DISOpcode : uint8_t {
     HALT    = 0xFF   // Halt VM
 };
 
-struct DISValue {
-    enum Type { INT, FLOAT, STRING, LIST, REF } type;
+// A VM value in 16 bytes: a tag and an 8-byte payload. Integers and floats
+// are stored inline; strings and lists live in reference-counted heap
+// objects, so copying a value never copies text and moving it is free.
+// Heap objects are immutable once shared, and their counts are atomic
+// because values travel between VMs.
+class DISValue {
+public:
+    enum Type : uint8_t { INT, FLOAT, STRING, LIST, REF };
+    
+    DISValue() noexcept : int_(0), type_(INT) {}
+    DISValue(int64_t v) noexcept : int_(v), type_(INT) {}
+    DISValue(double v) noexcept : float_(v), type_(FLOAT) {}
+    DISValue(const char* v) : DISValue(std::string(v)) {}
+    DISValue(std::string v) : heap_(new StringObject(std::move(v))), type_(STRING) {}
+    DISValue(std::vector<DISValue> v) : heap_(new ListObject(std::move(v))), type_(LIST) {}
+    
+    static DISValue from_ref(void* ref) noexcept {
+        DISValue value;
+        value.ref_ = ref;
+        value.type_ = REF;
+        return value;
+    }
     
-    union {
-        int64_t int_val;
-        double float_val;
-        void* ptr_val;
+    DISValue(const DISValue& other) noexcept : int_(other.int_), type_(other.type_) {
+        retain();
+    }
+    
+    DISValue(DISValue&& other) noexcept : int_(other.int_), type_(other.type_) {
+        other.int_ = 0;
+        other.type_ = INT;
+    }
+    
+    DISValue& operator=(const DISValue& other) noexcept {
+        other.retain();
+        release();
+        int_ = other.int_;
+        type_ = other.type_;
+        return *this;
+    }
+    
+    DISValue& operator=(DISValue&& other) noexcept {
+        if (this != &other) {
+            release();
+            int_ = other.int_;
+            type_ = other.type_;
+            other.int_ = 0;
+            other.type_ = INT;
+        }
+        return *this;
+    }
+    
+    ~DISValue() { release(); }
+    
+    Type type() const { return type_; }
+    
+    // Typed accessors return 0 or an empty string/list for other types
+    int64_t int_value() const { return type_ == INT ? int_ : 0; }
+    double float_value() const { return type_ == FLOAT ? float_ : 0.0; }
+    void* ref_value() const { return type_ == REF ? ref_ : nullptr; }
+    
+    const std::string& string_value() const {
+        static const std::string empty;
+        return type_ == STRING ? static_cast<const StringObject*>(heap_)->text : empty;
+    }
+    
+    const std::vector<DISValue>& list_value() const {
+        static const std::vector<DISValue> empty;
+        return type_ == LIST ? static_cast<const ListObject*>(heap_)->items : empty;
+    }
+    
+    // Branch condition: non-zero numbers, non-empty strings and lists, non-null refs
+    bool truthy() const {
+        switch (type_) {
+            case INT: return int_ != 0;
+            case FLOAT: return float_ != 0.0;
+            case STRING: return !string_value().empty();
+            case LIST: return !list_value().empty();
+            case REF: return ref_ != nullptr;
+        }
+        return false;
+    }
+    
+private:
+    struct HeapObject {
+        mutable std::atomic<uint32_t> references{1};
+    };
+    
+    struct StringObject : HeapObject {
+        explicit StringObject(std::string t) : text(std::move(t)) {}
+        std::string text;
+    };
+    
+    struct ListObject : HeapObject {
+        explicit ListObject(std::vector<DISValue> i) : items(std::move(i)) {}
+        std::vector<DISValue> items;
     };
     
-    std::string string_val;
-    std::vector<DISValue> list_val;
+    bool is_heap() const { return type_ == STRING || type_ == LIST; }
     
-    DISValue() : type(INT), int_val(0) {}
-    DISValue(int64_t v) : type(INT), int_val(v) {}
-    DISValue(double v) : type(FLOAT), float_val(v) {}
-    DISValue(const std::string& v) : type(STRING), string_val(v) {}
-    DISValue(const std::vector<DISValue>& v) : type(LIST), list_val(v) {}
+    void retain() const noexcept {
+        if (is_heap()) {
+            heap_->references.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    
+    void release() noexcept {
+        if (is_heap() && heap_->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            if (type_ == STRING) {
+                delete static_cast<StringObject*>(heap_);
+            } else {
+                delete static_cast<ListObject*>(heap_);
+            }
+        }
+    }
+    
+    union {
+        int64_t int_;
+        double float_;
+        HeapObject* heap_;
+        void* ref_;
+    };
+    Type type_;
 };
 
+static_assert(sizeof(DISValue) == 16, "DISValue should stay a tag plus one word");
+
 struct DISInstruction {
     DISOpcode opcode;
     std::vector<DISValue> operands;
@@ -100,11 +223,23 @@ struct DISInstruction {
     }
 };
 
-// Limbo bytecode program
+// Function layout recorded by the compiler. Code addresses locals by
+// slot; the names are only kept for the debugger.
+struct DISFunction {
+    std::string name;
+    size_t entry;                     // Address of the function's ENTER
+    std::vector<std::string> locals;  // Local slot -> name
+};
+
+// Limbo bytecode program. Variables are addressed by slot: LOADG/STOREG
+// index the globals, LOADL/STOREL the locals of the current frame, and
+// jumps carry absolute addresses, so names play no part at run time.
 struct DISProgram {
     std::vector<DISInstruction> instructions;
     std::map<std::string, size_t> labels;    // Label -> instruction index
-    std::map<std::string, DISValue> globals; // Global variables
+    std::vector<std::string> global_names;   // Global slot -> name
+    std::vector<DISValue> globals;           // Initial value per global slot
+    std::vector<DISFunction> functions;
     std::string source_limbo;                // Original Limbo source
     
     void add_instruction(const DISInstruction& inst) {
@@ -115,27 +250,122 @@ struct DISProgram {
         labels[label] = instructions.size();
     }
     
-    size_t get_label_address(const std::string& label) const {
+    std::optional<size_t> get_label_address(const std::string& label) const {
         auto it = labels.find(label);
-        return it != labels.end() ? it->second : 0;
+        if (it == labels.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+    
+    // Returns the new global's slot
+    uint32_t add_global(const std::string& name, const DISValue& initial = DISValue()) {
+        global_names.push_back(name);
+        globals.push_back(initial);
+        return static_cast<uint32_t>(global_names.size() - 1);
+    }
+    
+    std::optional<uint32_t> find_global(const std::string& name) const {
+        auto it = std::find(global_names.begin(), global_names.end(), name);
+        if (it == global_names.end()) {
+            return std::nullopt;
+        }
+        return static_cast<uint32_t>(it - global_names.begin());
+    }
+    
+    // Function whose ENTER is at the given address
+    const DISFunction* find_function(size_t entry) const {
+        for (const auto& function : functions) {
+            if (function.entry == entry) {
+                return &function;
+            }
+        }
+        return nullptr;
     }
+    
+    // Versioned binary form: literals go in a deduplicated constant pool
+    // that instructions and globals refer to by index, and a checksum
+    // covers the whole image. Refs are host pointers and load as null.
+    static constexpr uint8_t FORMAT_VERSION = 1;
+    std::string serialize() const;
+    
+    // nullopt for another version, a bad checksum or a malformed image
+    static std::optional<DISProgram> deserialize(std::string_view data);
+};
+
+// Pre-decoded form of a DISProgram that the VM executes. Opcodes are
+// renumbered densely so they index a dispatch table directly, and each
+// instruction carries one fixed-width operand: a constant pool index for
+// LOAD/NEWSTR, a slot for LOADG/STOREG/LOADL/STOREL, a local count for
+// ENTER or an absolute target for JMP/JMPT/JMPF/CALL. Equal literals
+// share one constant. A trailing END instruction at program size catches
+// falling off the end and jumps past it.
+struct DISCode {
+    enum Handler : uint8_t {
+        NOP, PUSH_CONST, POP, DUP,
+        LOAD_GLOBAL, STORE_GLOBAL, LOAD_LOCAL, STORE_LOCAL,
+        ADD, SUB, MUL, DIV, MOD,
+        EQ, NE, LT, GT, LE, GE,
+        JMP, JMPT, JMPF, CALL, RET, ENTER,
+        CONCAT, STRLEN,
+        PRINT, READ, RECV, SEND,
+        AI_INIT, AI_COMPLETE, AI_CHAT,
+        RENDER_GLYPH, SPAWN_VM, MOUNT_NS,
+        HALT, INVALID, END,
+        HANDLER_COUNT
+    };
+    
+    static constexpr uint32_t NO_OPERAND = 0xFFFFFFFFu;
+    
+    // Locals one frame may hold; larger ENTER counts and LOADL/STOREL slots
+    // lower to INVALID, so bytecode cannot request huge frames
+    static constexpr uint32_t MAX_LOCALS = 4096;
+    
+    struct Instruction {
+        uint8_t handler;    // Handler
+        DISOpcode opcode;   // Original opcode, for diagnostics
+        uint32_t operand;   // Constant index, slot, count, jump target or NO_OPERAND
+    };
+    
+    std::vector<Instruction> instructions;
+    std::vector<DISValue> constants;
+    
+    // Lower a program; never fails, unknown opcodes, global slots the
+    // program does not declare and frames over MAX_LOCALS become INVALID
+    static DISCode lower(const DISProgram& program);
 };
 
+class DISBytecodeCache;
+class LimboCompiler;
+
 class DISVM {
 public:
+    // Operand stack slots allocated up front; deeper stacks still grow
+    static constexpr size_t INITIAL_STACK_CAPACITY = 256;
+    
+    // How a scheduling slice ended
+    enum class SliceResult { YIELDED, WAITING, HALTED };
+    
     DISVM();
     ~DISVM();
     
     // Program execution
     bool load_program(const DISProgram& program);
-    bool load_limbo_source(const std::string& source);
+    bool load_limbo_source(const std::string& source, const DISBytecodeCache* cache = nullptr);
     bool run();
     void step();
     void halt();
     
+    // Run until the program halts, waits in RECV or has made `budget`
+    // control transfers (jumps, calls, returns). Straight-line code between
+    // them is bounded by the program size, so this bounds the slice.
+    // Breakpoints are ignored; meant for schedulers.
+    SliceResult run_slice(size_t budget);
+    
     // State management
     void reset();
     bool is_running() const { return running_; }
+    bool is_waiting() const { return waiting_; }  // Parked in RECV or an async AI opcode
     size_t get_pc() const { return pc_; }
     size_t get_program_size() const { return program_.instructions.size(); }
     
@@ -145,18 +375,34 @@ public:
     DISValue peek() const;
     size_t stack_size() const { return stack_.size(); }
     
-    // Memory management
+    // Memory management. Compiled code reaches variables by slot; these
+    // look names up for the debugger and embedders. Setting an unknown
+    // global creates it.
     void set_global(const std::string& name, const DISValue& value);
     DISValue get_global(const std::string& name) const;
-    
-    // AI integration
+    std::map<std::string, DISValue> get_globals() const;
+    std::map<std::string, DISValue> get_locals() const;  // Current frame
+    
+    // AI integration. The handler answers inline while the VM waits. An
+    // async handler starts the request and passes the response to `resume`
+    // later, from any thread; the VM parks in the AI opcode meanwhile and
+    // the wake handler runs once the response is in.
+    using AIResume = std::function<void(std::string)>;
     void set_ai_handler(std::function<std::string(const std::string&, const std::string&)> handler);
+    void set_async_ai_handler(std::function<void(const std::string&, const std::string&, AIResume)> handler);
+    void set_wake_handler(std::function<void()> waker);
     
     // DrawKern integration
     void set_glyph_renderer(std::function<void(const std::string&)> renderer);
     void set_vm_spawner(std::function<bool(const std::string&)> spawner);
     void set_namespace_mounter(std::function<bool(const std::string&, const std::string&)> mounter);
     
+    // Messaging. The receiver fills in the next message or returns false
+    // when there is none, which parks the VM in RECV; SEND hands the
+    // target and message to the sender.
+    void set_message_receiver(std::function<bool(DISValue&)> receiver);
+    void set_message_sender(std::function<bool(const std::string&, const DISValue&)> sender);
+    
     // Debugging
     void dump_stack() const;
     void dump_globals() const;
@@ -182,14 +428,22 @@ public:
     
 private:
     DISProgram program_;
-    std::stack<DISValue> stack_;
-    std::map<std::string, DISValue> globals_;
+    std::vector<DISValue> stack_;  // Operand stack, top at the back
+    std::vector<DISValue> globals_;  // Indexed by global slot
+    std::vector<DISValue> locals_;   // Locals of every active frame
+    size_t frame_base_;              // First local of the current frame
     size_t pc_;          // Program counter
     bool running_;
     bool halted_;
+    bool waiting_;       // Parked in RECV until a message arrives, or on an AI response
     
     // Call stack for function calls
-    std::stack<size_t> call_stack_;
+    struct Frame {
+        size_t return_address;
+        size_t entry;        // Called address, identifies the function
+        size_t caller_base;  // Caller's frame_base_
+    };
+    std::vector<Frame> call_stack_;
     
     // Debugging state
     std::set<size_t> breakpoints_;
@@ -199,27 +453,49 @@ private:
     
     // Handler functions
     std::function<std::string(const std::string&, const std::string&)> ai_handler_;
+    std::function<void(const std::string&, const std::string&, AIResume)> async_ai_handler_;
+    std::function<void()> wake_handler_;
     std::function<void(const std::string&)> glyph_renderer_;
     std::function<bool(const std::string&)> vm_spawner_;
     std::function<bool(const std::string&, const std::string&)> namespace_mounter_;
-    
-    // Instruction execution
-    void execute_instruction(const DISInstruction& inst);
-    
-    // Opcode handlers
-    void handle_load(const DISInstruction& inst);
-    void handle_store(const DISInstruction& inst);
-    void handle_arithmetic(const DISInstruction& inst);
-    void handle_comparison(const DISInstruction& inst);
-    void handle_control_flow(const DISInstruction& inst);
-    void handle_string_ops(const DISInstruction& inst);
-    void handle_list_ops(const DISInstruction& inst);
-    void handle_io_ops(const DISInstruction& inst);
-    void handle_ai_ops(const DISInstruction& inst);
-    void handle_drawkern_ops(const DISInstruction& inst);
+    std::function<bool(DISValue&)> message_receiver_;
+    std::function<bool(const std::string&, const DISValue&)> message_sender_;
+    
+    // Async AI request the VM is parked on
+    struct PendingAI {
+        std::mutex mutex;
+        bool done = false;
+        std::string response;
+    };
+    std::shared_ptr<PendingAI> pending_ai_;
+    
+    // Program as executed; rebuilt from program_ on every load
+    DISCode code_;
+    
+    // Threaded interpreter over code_ starting at pc_. Runs until the
+    // program halts, falls off the end, waits in RECV, is stopped or has
+    // made `budget` control transfers; with SingleStep it returns after
+    // one instruction.
+    template<bool SingleStep>
+    void execute(size_t budget = SIZE_MAX);
+    
+    // Opcodes that are not on the hot path
+    void op_concat();
+    void op_strlen();
+    void op_print();
+    void op_read();
+    void op_send();
+    void op_ai_init();
+    bool op_ai_complete();  // False parks the VM on an async request
+    bool op_ai_chat();
+    void op_render_glyph();
+    void op_spawn_vm();
+    void op_mount_ns();
     
     // Helper methods
     bool check_stack_size(size_t required) const;
+    bool start_async_ai(const std::string& prompt, const std::string& context);
+    bool resume_async_ai();
     void runtime_error(const std::string& message);
 };
 
@@ -243,11 +519,42 @@ private:
     std::vector<std::string> tokenize(const std::string& source);
     DISProgram parse_tokens(const std::vector<std::string>& tokens);
     
+    // Integer or quoted string token
+    static std::optional<DISValue> parse_literal(const std::string& token);
+    
     void add_error(const std::string& error) {
         errors_.push_back(error);
     }
 };
 
+// On-disk cache of compiled programs, one file per source keyed by a
+// hash of the text. Entries keep the source, so a hash collision or a
+// stale file is a miss rather than the wrong program. Files are written
+// to a temporary name and renamed, so concurrent spawns never see half
+// an entry.
+class DISBytecodeCache {
+public:
+    explicit DISBytecodeCache(std::string directory);
+    
+    std::optional<DISProgram> load(const std::string& source) const;
+    bool store(const DISProgram& program) const;  // Keyed by program.source_limbo
+    
+    // Cached program, or compile it and cache it if it has no errors;
+    // errors are left in the compiler
+    DISProgram get_or_compile(const std::string& source, LimboCompiler& compiler) const;
+    
+    std::string path_for(const std::string& source) const;
+    const std::string& directory() const { return directory_; }
+    
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+    
+private:
+    std::string directory_;
+    mutable std::atomic<size_t> hits_;
+    mutable std::atomic<size_t> misses_;
+};
+
 // Factory for creating common DIS programs
 class DISProgramFactory {
 public:
@@ -263,14 +570,21 @@ public:
     // Create DrawKern renderer
     static DISProgram create_drawkern_renderer();
     
-    // Load program from Limbo source
-    static DISProgram from_limbo_source(const std::string& source);
+    // Load program from Limbo source, through the cache if one is given
+    static DISProgram from_limbo_source(const std::string& source, const DISBytecodeCache* cache = nullptr);
 };
 
-// VM manager for multiple DIS VMs
+// VM manager for multiple DIS VMs. VMs are green threads: a small pool
+// of workers runs them in budgeted slices, so thousands of VMs share a
+// few threads. Each worker keeps its own run queue and idle workers
+// steal from the others. A VM waiting in RECV holds no worker; a message
+// arriving in its mailbox makes it runnable again.
 class DISVMManager {
 public:
-    DISVMManager();
+    // Control transfers a VM may make before it yields its worker
+    static constexpr size_t DEFAULT_SLICE_BUDGET = 2000;
+    
+    explicit DISVMManager(size_t worker_count = 0);  // 0: one per hardware thread
     ~DISVMManager();
     
     // VM lifecycle
@@ -279,21 +593,76 @@ public:
     bool stop_vm(const std::string& vm_id);
     bool destroy_vm(const std::string& vm_id);
     
-    // VM communication
+    // VM communication. send_message delivers to a VM's mailbox, waking it
+    // if it waits in RECV. VMs SEND to an empty target to reach the host;
+    // get_messages drains those.
     bool send_message(const std::string& vm_id, const DISValue& message);
     std::vector<DISValue> get_messages(const std::string& vm_id);
     
+    // Block until the VM halts; false on timeout or unknown VM
+    bool wait_for_vm(const std::string& vm_id, std::chrono::milliseconds timeout);
+    
     // VM status
     std::vector<std::string> list_vms() const;
     bool is_vm_running(const std::string& vm_id) const;
     std::string get_vm_status(const std::string& vm_id) const;
     
+    // AI opcodes of VMs created from now on go to this handler with the
+    // VM's id; the VM parks until `resume` is called
+    using AIHandler = std::function<void(const std::string& vm_id, const std::string& prompt,
+                                         const std::string& context, DISVM::AIResume resume)>;
+    void set_ai_handler(AIHandler handler);
+    
+    // Scheduling
+    size_t worker_count() const { return workers_.size(); }
+    void set_slice_budget(size_t budget) { slice_budget_ = budget > 0 ? budget : 1; }
+    
 private:
-    std::map<std::string, std::unique_ptr<DISVM>> vms_;
-    std::map<std::string, std::vector<DISValue>> vm_message_queues_;
-    size_t next_vm_id_;
+    enum class VMState : uint8_t { CREATED, RUNNABLE, RUNNING, WAITING, HALTED };
+    
+    struct VMTask {
+        std::string id;
+        std::unique_ptr<DISVM> vm;
+        std::atomic<VMState> state{VMState::CREATED};
+        std::atomic<bool> stop_requested{false};
+        
+        // Guards the mailbox and every change out of CREATED, WAITING or RUNNING
+        std::mutex mailbox_mutex;
+        std::deque<DISValue> mailbox;
+        std::vector<DISValue> outbox;  // Messages for the host
+        bool woken = false;            // Woken by its VM while not WAITING
+    };
+    
+    struct Worker {
+        std::mutex queue_mutex;
+        std::deque<std::shared_ptr<VMTask>> queue;
+        std::thread thread;
+    };
+    
+    mutable std::shared_mutex vms_mutex_;
+    std::map<std::string, std::shared_ptr<VMTask>> vms_;
+    AIHandler ai_handler_;  // Guarded by vms_mutex_
+    std::atomic<size_t> next_vm_id_;
+    
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> next_worker_;    // Round robin for wakeups from outside the pool
+    std::atomic<size_t> queued_;         // Tasks in all run queues
+    std::atomic<size_t> slice_budget_;
+    std::atomic<bool> shutting_down_;
+    std::mutex idle_mutex_;
+    std::condition_variable idle_cv_;
+    std::mutex done_mutex_;
+    std::condition_variable done_cv_;
     
     std::string generate_vm_id();
+    std::shared_ptr<VMTask> find_task(const std::string& vm_id) const;
+    
+    void worker_loop(size_t index);
+    std::shared_ptr<VMTask> next_task(size_t index);
+    void run_task(const std::shared_ptr<VMTask>& task);
+    void enqueue(std::shared_ptr<VMTask> task);
+    void wake(const std::shared_ptr<VMTask>& task);
+    void finish(VMTask& task);
 };
 
 } // namespace drawkern
@@ -1,5 +1,8 @@
 #pragma once
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <memory>
@@ -42,6 +45,98 @@ struct DrawKernCommand {
     uint32_t color;
     std::string data;
     std::map<std::string, std::string> attributes;
+    
+    bool operator==(const DrawKernCommand& other) const;
+};
+
+struct DrawKernRect {
+    int32_t x = 0, y = 0, w = 0, h = 0;
+    
+    bool empty() const { return w <= 0 || h <= 0; }
+    bool intersects(const DrawKernRect& other) const;
+    DrawKernRect united(const DrawKernRect& other) const;
+    DrawKernRect intersected(const DrawKernRect& other) const;  // Empty when they don't overlap
+};
+
+// Area a command covers; empty sizes count as one cell
+DrawKernRect command_bounds(const DrawKernCommand& cmd);
+
+// Binary encoding of a frame of commands against the previous frame.
+// Commands are compared slot by slot: runs of unchanged slots become a
+// count, and a changed slot carries only the fields that differ, with
+// coordinates as varint deltas from the old slot (or the previous
+// command, for new slots). Each frame also lists the rectangles whose
+// pixels changed, so a client only redraws what lies under them.
+class DrawKernFrameEncoder {
+public:
+    static constexpr size_t MAX_DIRTY_RECTS = 16;
+    
+    // Empty when the frame equals the previous one and no keyframe is due
+    std::string encode(const std::vector<DrawKernCommand>& frame);
+    
+    // The last encoded frame as a keyframe, for clients joining or resyncing
+    std::string keyframe() const;
+    
+    // Encode the next frame as a keyframe
+    void reset();
+    uint64_t sequence() const { return sequence_; }
+    
+private:
+    std::vector<DrawKernCommand> previous_;
+    uint64_t sequence_ = 0;
+    bool keyframe_due_ = true;
+};
+
+class DrawKernFrameDecoder {
+public:
+    // False if the payload is malformed or was encoded against a frame
+    // this decoder does not hold; the sender should then send a keyframe
+    bool decode(std::string_view payload);
+    
+    const std::vector<DrawKernCommand>& frame() const { return frame_; }
+    const std::vector<DrawKernRect>& dirty_rects() const { return dirty_; }
+    bool full_redraw() const { return full_redraw_; }
+    uint64_t sequence() const { return sequence_; }
+    
+    // Areas to clear and repaint to bring the screen up to date: the dirty
+    // rectangles, or after a keyframe everything the old and new frame cover
+    const std::vector<DrawKernRect>& redraw_areas() const { return redraw_areas_; }
+    
+    // Commands to draw, in order, to repaint an area
+    std::vector<const DrawKernCommand*> commands_in(const DrawKernRect& area) const;
+    
+private:
+    std::vector<DrawKernCommand> frame_;
+    std::vector<DrawKernRect> dirty_;
+    std::vector<DrawKernRect> redraw_areas_;
+    uint64_t sequence_ = 0;
+    bool full_redraw_ = false;
+};
+
+// Server side of the frame stream. Commands pushed during a frame are
+// encoded once when it ends, and every client gets a single payload:
+// the shared delta, or a keyframe if it just joined or asked to resync.
+class DrawKernFrameBuffer {
+public:
+    using Sender = std::function<void(const std::string& client_id, const std::string& payload)>;
+    
+    explicit DrawKernFrameBuffer(Sender sender);
+    
+    void add_client(const std::string& client_id);
+    void remove_client(const std::string& client_id);
+    void request_keyframe(const std::string& client_id);
+    
+    void push(DrawKernCommand cmd);
+    size_t pending() const { return frame_.size(); }
+    
+    // Sends the frame and starts the next; returns the bytes sent
+    size_t end_frame();
+    
+private:
+    Sender sender_;
+    DrawKernFrameEncoder encoder_;
+    std::vector<DrawKernCommand> frame_;
+    std::map<std::string, bool> clients_;  // Client to whether it needs a keyframe
 };
 
 // "Yacc Grammar" for describing VM topologies as renderable glyphs
@@ -130,12 +225,23 @@ public:
     virtual void render_text(int32_t x, int32_t y, const std::string& text) = 0;
     virtual void render_ai_interface(const AIWorkbenchGlyph& workbench) = 0;
     
+    // Frame redraws are clipped to the area being repainted; rectangles are
+    // cut to it, and clients able to clip text restrict it here (null ends
+    // the clip). An area is cleared before it is repainted.
+    virtual void set_clip(const DrawKernRect* area) {}
+    virtual void clear_rect(int32_t x, int32_t y, int32_t w, int32_t h) { render_rect(x, y, w, h, 0); }
+    
     // Input handling
     void send_input(const DrawKernCommand& input);
     
+    // Apply an encoded frame and redraw what it changed. False means the
+    // frame could not be applied and a keyframe is needed.
+    bool apply_frame(std::string_view payload);
+    
 private:
     std::string server_address_;
     bool connected_;
+    DrawKernFrameDecoder frame_decoder_;
 };
 
 // Concrete implementations for different platforms
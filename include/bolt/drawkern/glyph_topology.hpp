@@ -0,0 +1,121 @@
+#pragma once
+
+#include "bolt/drawkern/yacc_grammar.hpp"
+#include "bolt/drawkern/drawkern.hpp"
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bolt {
+namespace drawkern {
+
+class DISVMManager;
+struct DISProgram;
+
+// What changed between two versions of a description, by declaration name
+struct GlyphTopologyDiff {
+    std::vector<std::string> added_vms;
+    std::vector<std::string> removed_vms;
+    std::vector<std::string> changed_vms;
+    std::vector<std::string> added_glyphs;
+    std::vector<std::string> removed_glyphs;
+    std::vector<std::string> changed_glyphs;
+
+    // Unchanged glyphs whose VM was replaced; filled in by GlyphTopology
+    std::vector<std::string> rebound_glyphs;
+
+    size_t reparsed = 0;  // Declarations parsed by this update
+
+    bool empty() const;
+};
+
+// One top-level vm, glyph or workbench declaration and the source text
+// it was parsed from. Text before the first declaration is kept as a
+// fragment with no node.
+struct GlyphFragment {
+    size_t begin = 0;   // Byte range in the current source
+    size_t end = 0;
+    size_t line = 1;    // Line of `begin` in the current source
+    std::shared_ptr<const GlyphAST> ast;
+
+    // The declaration, or null for a preamble or a declaration that failed to parse
+    const ASTNode* node() const;
+    std::string_view name() const;
+};
+
+// A description that is re-parsed incrementally. The source is split at
+// top-level declaration keywords; an update re-lexes from just before
+// the first changed byte until the boundaries line up with the old ones
+// again, parses only the fragments in between, and compares their
+// declarations structurally with the old ones. Positions inside a
+// reused fragment's AST are those of the update that parsed it.
+class GlyphDocument {
+public:
+    GlyphDocument();
+    ~GlyphDocument();
+
+    GlyphTopologyDiff update(std::string source);
+
+    const std::string& source() const { return source_; }
+    const std::vector<GlyphFragment>& fragments() const { return fragments_; }
+
+    const VMDeclNode* find_vm(std::string_view name) const;
+    const GlyphDeclNode* find_glyph(std::string_view name) const;
+
+    bool has_errors() const;
+    std::vector<std::string> get_errors() const;
+
+private:
+    std::string source_;
+    std::vector<GlyphFragment> fragments_;
+    std::map<std::string, size_t, std::less<>> vms_;     // Name to fragment index
+    std::map<std::string, size_t, std::less<>> glyphs_;
+    std::vector<std::string> duplicate_errors_;
+
+    void index_declarations();
+};
+
+// Keeps a running deployment in step with a description. Each apply()
+// redeploys only what the diff names: removed and changed DIS VMs are
+// destroyed, added and changed ones are created and started, and a glyph
+// is rendered again when it changed or its VM was replaced. Everything
+// else keeps running untouched.
+class GlyphTopology {
+public:
+    using ProgramFactory = std::function<DISProgram(const VMDeclNode&)>;
+    using GlyphRenderer = std::function<void(const std::string&, const VMGlyph&)>;
+
+    explicit GlyphTopology(DISVMManager& manager);
+    ~GlyphTopology();
+
+    GlyphTopologyDiff apply(std::string source);
+
+    // Program for a DIS VM declaration; by default the VM's `limbo` source
+    // or else a loop that waits on its mailbox
+    void set_program_factory(ProgramFactory factory) { program_factory_ = std::move(factory); }
+    void set_glyph_renderer(GlyphRenderer renderer) { glyph_renderer_ = std::move(renderer); }
+
+    const GlyphDocument& document() const { return document_; }
+
+    // DIS VM instance running a declared VM, or empty
+    std::string vm_instance(const std::string& vm_name) const;
+    size_t deployed_vm_count() const { return instances_.size(); }
+
+private:
+    DISVMManager& manager_;
+    GlyphDocument document_;
+    GlyphCodeGenerator generator_;
+    ProgramFactory program_factory_;
+    GlyphRenderer glyph_renderer_;
+    std::map<std::string, std::string> instances_;  // VM name to DIS VM id
+
+    void undeploy_vm(const std::string& name);
+    void deploy_vm(const std::string& name);
+    void render_glyph(const std::string& name);
+};
+
+} // namespace drawkern
+} // namespace bolt
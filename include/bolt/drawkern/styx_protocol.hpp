@@ -5,6 +5,15 @@
 #include <map>
 #include <memory>
 #include <functional>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <unordered_map>
+#include <optional>
+#include <future>
 
 namespace bolt {
 namespace drawkern {
@@ -70,9 +79,18 @@ struct StyxMessage {
     static StyxMessage deserialize(const std::vector<uint8_t>& buffer);
 };
 
+// 9P client. Requests are pipelined: up to max_outstanding tags can be in
+// flight on one connection, and a reader thread matches replies to them by
+// tag. The blocking calls sit on top of the asynchronous ones; reads and
+// writes larger than the negotiated msize are split into chunks that are
+// all sent before any reply is awaited. Callbacks run on the reader
+// thread and must not wait for other replies.
 class StyxConnection {
 public:
-    StyxConnection(const std::string& address);
+    static constexpr uint32_t DEFAULT_MSIZE = 1 << 20;
+    using Callback = std::function<void(StyxMessage)>;
+    
+    explicit StyxConnection(const std::string& address, size_t max_outstanding = 32);
     ~StyxConnection();
     
     bool connect();
@@ -80,73 +98,183 @@ public:
     bool is_connected() const { return connected_; }
     
     // Core protocol operations
-    bool version(const std::string& version = "9P2000");
+    bool version(const std::string& version = "9P2000", uint32_t msize = DEFAULT_MSIZE);
     bool attach(const std::string& aname = "", const std::string& uname = "drawkern");
+    uint32_t msize() const { return msize_; }  // Negotiated by version
     
-    // File operations
+    // File operations. walk returns the number of names walked and open
+    // the iounit, both ~0u on error; write returns the bytes written.
     uint32_t walk(uint32_t fid, uint32_t newfid, const std::vector<std::string>& path);
     uint32_t open(uint32_t fid, uint8_t mode);
     std::vector<uint8_t> read(uint32_t fid, uint64_t offset, uint32_t count);
+    size_t read(uint32_t fid, uint64_t offset, uint8_t* buffer, size_t count);
     uint32_t write(uint32_t fid, uint64_t offset, const std::vector<uint8_t>& data);
+    size_t write(uint32_t fid, uint64_t offset, const uint8_t* data, size_t length);
     bool clunk(uint32_t fid);
+    std::optional<StyxStat> stat(uint32_t fid);
+    uint32_t root_fid() const { return root_fid_; }  // Fid bound by attach
     
     // DrawKern specific operations
     bool send_glyph(const std::string& glyph_data);
     bool spawn_vm(const std::string& vm_spec);
     
+    // Asynchronous operations. The tag is assigned here; these block only
+    // while every tag is in flight. Failed requests complete with Terror.
+    std::future<StyxMessage> send_async(StyxMessage message);
+    void send_async(StyxMessage message, Callback callback);
+    
+    // Single-message read and write of at most msize() - 23 bytes. Rread
+    // data is received straight into `buffer`, which must stay valid until
+    // the future is ready; so must `data`.
+    std::future<size_t> read_async(uint32_t fid, uint64_t offset, uint8_t* buffer, uint32_t count);
+    std::future<uint32_t> write_async(uint32_t fid, uint64_t offset, const uint8_t* data, uint32_t count);
+    
     StyxMessage send_message(const StyxMessage& message);
     
 private:
+    struct Pending {
+        Callback callback;
+        uint8_t* destination = nullptr;  // Rread data lands here when set
+        size_t capacity = 0;
+    };
+    
     std::string address_;
     int socket_fd_;
-    bool connected_;
-    uint16_t next_tag_;
+    std::atomic<bool> connected_;
+    std::atomic<uint32_t> msize_;
     uint32_t next_fid_;
+    uint32_t root_fid_;
+    
+    // Tags 1..max_outstanding index pending_; free ones wait in free_tags_
+    std::mutex pending_mutex_;
+    std::condition_variable tags_cv_;
+    std::vector<Pending> pending_;
+    std::vector<uint16_t> free_tags_;
     
-    bool send_data(const std::vector<uint8_t>& data);
-    std::vector<uint8_t> receive_data();
+    std::mutex send_mutex_;
+    std::thread reader_;
+    
+    void submit(StyxMessage& message, const uint8_t* payload, size_t payload_length, Pending pending);
+    void reader_loop();
+    void fail_pending();
+    bool send_data(const std::vector<uint8_t>& data, const uint8_t* payload = nullptr, size_t payload_length = 0);
+    bool receive_exact(uint8_t* data, size_t length);
 };
 
+// Event-driven Styx server. One reactor thread accepts connections and
+// reads complete messages; a worker pool handles them, so the tags a
+// client has outstanding are served concurrently and replies go back in
+// completion order. Each connection has its own fid table. Replies are
+// marshalled into pooled buffers, and Rread data is written straight
+// from the shared file contents without a copy.
 class StyxServer {
 public:
-    StyxServer(const std::string& address);
+    // Largest message negotiated in Tversion
+    static constexpr uint32_t MAX_MESSAGE_SIZE = 1 << 20;
+    
+    explicit StyxServer(const std::string& address, size_t worker_count = 0);  // 0: one per hardware thread
     ~StyxServer();
     
     bool start();
     void stop();
-    void run();
+    void run();  // Serves until stop()
+    uint16_t port() const { return port_; }  // Bound port, also when the address asks for port 0
     
-    // File system interface for DrawKern
+    // File system interface for DrawKern. Paths are absolute; directories
+    // exist implicitly above every file. Safe while serving.
     void serve_file(const std::string& path, const std::string& content);
     void serve_vm_namespace(const std::string& vm_id);
+    std::optional<std::string> file_content(const std::string& path) const;
     
-    // DrawKern operations
+    // DrawKern operations; handlers may be called from several workers at once
     void register_glyph_handler(std::function<void(const std::string&)> handler);
     void register_vm_handler(std::function<void(const std::string&)> handler);
     
 private:
+    struct Connection;
+    
+    struct FileEntry {
+        std::shared_ptr<std::string> content;
+        uint32_t version = 0;
+        uint64_t qid_path = 0;
+    };
+    
+    // A reply: a marshalled header, plus for Rread a slice of file content
+    // that is sent in place
+    struct Reply {
+        std::vector<uint8_t> header;
+        std::shared_ptr<const std::string> body;
+        size_t body_offset = 0;
+        size_t body_length = 0;
+    };
+    
+    struct Request {
+        std::shared_ptr<Connection> connection;
+        std::vector<uint8_t> message;
+    };
+    
     std::string address_;
     int listen_fd_;
-    bool running_;
-    std::map<std::string, std::string> virtual_files_;
+    int wake_fds_[2];
+    uint16_t port_;
+    std::atomic<bool> running_;
+    size_t worker_count_;
+    
+    // Lets the destructor wait for run() to return
+    std::mutex loop_mutex_;
+    std::condition_variable loop_cv_;
+    bool loop_active_;
+    
+    mutable std::shared_mutex files_mutex_;
+    std::map<std::string, FileEntry> virtual_files_;
+    uint64_t next_qid_path_;
     std::function<void(const std::string&)> glyph_handler_;
     std::function<void(const std::string&)> vm_handler_;
     
-    void handle_client(int client_fd);
-    StyxMessage handle_message(const StyxMessage& message);
+    // Reactor state, touched only by run()
+    std::unordered_map<int, std::shared_ptr<Connection>> connections_;
+    
+    // Requests waiting for a worker
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::deque<Request> requests_;
+    std::vector<std::thread> workers_;
     
-    // Message handlers
-    StyxMessage handle_version(const StyxMessage& message);
-    StyxMessage handle_attach(const StyxMessage& message);
-    StyxMessage handle_walk(const StyxMessage& message);
-    StyxMessage handle_open(const StyxMessage& message);
-    StyxMessage handle_read(const StyxMessage& message);
-    StyxMessage handle_write(const StyxMessage& message);
-    StyxMessage handle_clunk(const StyxMessage& message);
+    // Recycled marshalling buffers
+    std::mutex pool_mutex_;
+    std::vector<std::vector<uint8_t>> buffer_pool_;
+    std::vector<uint8_t> acquire_buffer();
+    void release_buffer(std::vector<uint8_t> buffer);
+    
+    void accept_connections();
+    bool read_connection(Connection& connection);
+    bool flush_connection(Connection& connection);  // Caller holds the write lock
+    void worker_loop();
+    void wake();
+    
+    void process(Request& request);
+    void send_reply(Connection& connection, Reply reply);
+    Reply error_reply(uint16_t tag, const std::string& message);
+    
+    // Message handlers; `body` is the message after its 7-byte header
+    Reply handle_version(Connection& connection, uint16_t tag, const uint8_t* body, size_t length);
+    Reply handle_attach(Connection& connection, uint16_t tag, const uint8_t* body, size_t length);
+    Reply handle_flush(Connection& connection, uint16_t tag, const uint8_t* body, size_t length);
+    Reply handle_walk(Connection& connection, uint16_t tag, const uint8_t* body, size_t length);
+    Reply handle_open(Connection& connection, uint16_t tag, const uint8_t* body, size_t length);
+    Reply handle_read(Connection& connection, uint16_t tag, const uint8_t* body, size_t length);
+    Reply handle_write(Connection& connection, uint16_t tag, const uint8_t* body, size_t length);
+    Reply handle_clunk(Connection& connection, uint16_t tag, const uint8_t* body, size_t length);
+    Reply handle_stat(Connection& connection, uint16_t tag, const uint8_t* body, size_t length);
     
     // DrawKern extensions
-    StyxMessage handle_glyph(const StyxMessage& message);
-    StyxMessage handle_vm_spawn(const StyxMessage& message);
+    Reply handle_glyph(Connection& connection, StyxMessageType type, uint16_t tag, const uint8_t* body, size_t length);
+    Reply handle_vm_spawn(Connection& connection, uint16_t tag, const uint8_t* body, size_t length);
+    
+    // Directory listing as 9P stat records
+    std::string list_directory(const std::string& path) const;
+    bool find_qid(const std::string& path, StyxQid& qid, uint64_t* length = nullptr) const;
+    bool is_directory(const std::string& path) const;  // Caller holds files_mutex_
 };
 
 // Network file system mount point for DrawKern
@@ -5,6 +5,13 @@
 #include <memory>
 #include <functional>
 #include <variant>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+#include <new>
 
 namespace bolt {
 namespace drawkern {
@@ -41,6 +48,7 @@ enum class TokenType {
     ASSIGN,       // =
     SEMICOLON,    // ;
     COMMA,        // ,
+    COLON,        // :
     LBRACE,       // {
     RBRACE,       // }
     LPAREN,       // (
@@ -60,41 +68,98 @@ enum class TokenType {
 
 struct Token {
     TokenType type;
-    std::string value;
-    size_t line;
-    size_t column;
+    std::string_view value;  // Source text; string literals lose their quotes
+    uint32_t line;
+    uint32_t column;
+    bool has_escapes = false;  // String literal whose value still needs decoding
     
-    Token(TokenType t, const std::string& v, size_t l = 0, size_t c = 0) 
-        : type(t), value(v), line(l), column(c) {}
+    Token(TokenType t, std::string_view v, size_t l = 0, size_t c = 0) 
+        : type(t), value(v), line(static_cast<uint32_t>(l)), column(static_cast<uint32_t>(c)) {}
 };
 
-// AST Node base class
+// Attribute keys are interned per arena; these are always present
+using SymbolId = uint32_t;
+namespace ASTSymbol {
+    constexpr SymbolId NAME = 0;
+    constexpr SymbolId TYPE = 1;
+    constexpr SymbolId VALUE = 2;
+    constexpr SymbolId PREDEFINED_COUNT = 3;
+}
+
+// Bump allocator that owns an AST: nodes, their child and attribute arrays,
+// decoded strings and the interned attribute keys. Everything is released
+// together, so nodes must be trivially destructible.
+class ASTArena {
+public:
+    ASTArena();
+    ASTArena(const ASTArena&) = delete;
+    ASTArena& operator=(const ASTArena&) = delete;
+    ASTArena(ASTArena&&) noexcept = default;
+    ASTArena& operator=(ASTArena&&) noexcept = default;
+    
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+    
+    template<typename T>
+    T* allocate_array(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+        return count ? static_cast<T*>(allocate(sizeof(T) * count, alignof(T))) : nullptr;
+    }
+    
+    std::string_view store(std::string_view text);  // Copy into the arena
+    SymbolId intern(std::string_view name);
+    std::string_view symbol_name(SymbolId id) const { return symbols_[id]; }
+    size_t bytes_used() const { return used_; }
+    
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    
+    std::vector<std::unique_ptr<std::byte[]>> blocks_;
+    std::byte* cursor_ = nullptr;
+    size_t remaining_ = 0;
+    size_t used_ = 0;
+    std::vector<std::string_view> symbols_;
+    std::unordered_map<std::string_view, SymbolId> symbol_ids_;
+    
+    void* allocate(size_t size, size_t alignment);
+};
+
+struct ASTAttribute {
+    SymbolId key;
+    std::string_view value;
+};
+
+// AST node base class. Nodes live in an ASTArena and refer to their
+// children and attributes through flat arrays in the same arena.
 class ASTNode {
 public:
     ASTNodeType type;
-    std::vector<std::unique_ptr<ASTNode>> children;
-    std::map<std::string, std::string> attributes;
+    uint32_t line = 0;
+    uint32_t column = 0;
     
-    ASTNode(ASTNodeType t) : type(t) {}
-    virtual ~ASTNode() = default;
+    explicit ASTNode(ASTNodeType t) : type(t) {}
     
-    void add_child(std::unique_ptr<ASTNode> child) {
-        children.push_back(std::move(child));
-    }
+    std::span<ASTNode* const> children() const { return {children_, child_count_}; }
+    std::span<const ASTAttribute> attributes() const { return {attributes_, attribute_count_}; }
     
-    void set_attribute(const std::string& key, const std::string& value) {
-        attributes[key] = value;
-    }
+    void set_children(ASTArena& arena, std::span<ASTNode* const> children);
+    void set_attribute(ASTArena& arena, SymbolId key, std::string_view value);
+    std::string_view get_attribute(SymbolId key) const;
     
-    std::string get_attribute(const std::string& key) const {
-        auto it = attributes.find(key);
-        return it != attributes.end() ? it->second : "";
-    }
+    std::string to_string(const ASTArena& arena) const;
     
-    virtual std::string to_string() const;
+private:
+    ASTNode** children_ = nullptr;
+    uint32_t child_count_ = 0;
+    uint32_t attribute_count_ = 0;
+    ASTAttribute* attributes_ = nullptr;
 };
 
-// Specialized AST node types
+// Specialized AST node types; names and values view the source text or
+// strings stored in the arena
 class ProgramNode : public ASTNode {
 public:
     ProgramNode() : ASTNode(ASTNodeType::PROGRAM) {}
@@ -102,35 +167,59 @@ public:
 
 class VMDeclNode : public ASTNode {
 public:
-    std::string vm_id;
-    std::string vm_type;
+    std::string_view vm_id;
+    std::string_view vm_type;
     
-    VMDeclNode(const std::string& id, const std::string& type) 
+    VMDeclNode(std::string_view id, std::string_view type) 
         : ASTNode(ASTNodeType::VM_DECL), vm_id(id), vm_type(type) {}
 };
 
 class GlyphDeclNode : public ASTNode {
 public:
-    std::string glyph_id;
-    std::string base_vm;
+    std::string_view glyph_id;
+    std::string_view base_vm;
     
-    GlyphDeclNode(const std::string& id, const std::string& vm) 
+    GlyphDeclNode(std::string_view id, std::string_view vm) 
         : ASTNode(ASTNodeType::GLYPH_DECL), glyph_id(id), base_vm(vm) {}
 };
 
 class PropertyNode : public ASTNode {
 public:
-    std::string name;
-    std::string value;
+    std::string_view name;
+    std::string_view value;  // Lists keep their source text and get LITERAL children
     
-    PropertyNode(const std::string& n, const std::string& v) 
+    PropertyNode(std::string_view n, std::string_view v) 
         : ASTNode(ASTNodeType::PROPERTY), name(n), value(v) {}
 };
 
-// Lexer for tokenizing glyph description language
+// A parsed description: owns a copy of the source and the arena its AST
+// lives in, so it can be moved around and kept
+class GlyphAST {
+public:
+    // first_line numbers a fragment cut from a larger description
+    static GlyphAST parse(std::string_view source, size_t first_line = 1);
+    
+    const ProgramNode& root() const { return *root_; }
+    const ASTArena& arena() const { return arena_; }
+    std::string_view source() const { return source_; }
+    
+    bool has_errors() const { return !errors_.empty(); }
+    const std::vector<std::string>& get_errors() const { return errors_; }
+    
+private:
+    GlyphAST() = default;
+    
+    ASTArena arena_;
+    std::string_view source_;
+    ProgramNode* root_ = nullptr;
+    std::vector<std::string> errors_;
+};
+
+// Lexer for tokenizing glyph description language. Tokens view the input,
+// which must outlive them.
 class GlyphLexer {
 public:
-    GlyphLexer(const std::string& input);
+    explicit GlyphLexer(std::string_view input, size_t first_line = 1);
     ~GlyphLexer();
     
     std::vector<Token> tokenize();
@@ -140,58 +229,68 @@ public:
     std::vector<std::string> get_errors() const { return errors_; }
     
 private:
-    std::string input_;
+    std::string_view input_;
     size_t pos_;
     size_t line_;
-    size_t column_;
+    size_t line_start_;  // Offset of the first character of the current line
     std::vector<std::string> errors_;
     
-    char current_char();
-    char peek_char();
-    void advance();
-    void skip_whitespace();
-    void skip_comment();
+    size_t column() const { return pos_ - line_start_ + 1; }
+    void skip_whitespace_and_comments();
     
     Token read_identifier();
     Token read_string();
     Token read_number();
     
-    bool is_alpha(char c);
-    bool is_digit(char c);
-    bool is_alnum(char c);
-    
     void add_error(const std::string& message);
 };
 
-// Parser for glyph description language
+// Recursive-descent parser for glyph description language. Tokens are
+// pulled from the lexer as needed rather than materialized up front.
+// A syntax error is recorded and the parser resynchronizes at the next
+// ';', '}' or declaration keyword, so one bad property does not lose the rest.
 class GlyphParser {
 public:
-    GlyphParser(const std::vector<Token>& tokens);
+    GlyphParser(GlyphLexer& lexer, ASTArena& arena);
     ~GlyphParser();
     
-    std::unique_ptr<ProgramNode> parse();
+    ProgramNode* parse();
     
     bool has_errors() const { return !errors_.empty(); }
     std::vector<std::string> get_errors() const { return errors_; }
     
 private:
-    std::vector<Token> tokens_;
-    size_t pos_;
+    GlyphLexer& lexer_;
+    ASTArena& arena_;
+    Token current_;
+    Token next_;
+    Token previous_;
     std::vector<std::string> errors_;
+    std::vector<ASTNode*> scratch_;  // Children of the nodes being built, innermost last
     
-    Token current_token();
-    Token peek_token();
+    const Token& current_token() const;
+    const Token& peek_token() const;
     void advance();
-    bool match(TokenType type);
+    Token pull_token();
+    bool match(TokenType type) const;
     bool consume(TokenType type);
-    
-    std::unique_ptr<ASTNode> parse_statement();
-    std::unique_ptr<VMDeclNode> parse_vm_declaration();
-    std::unique_ptr<GlyphDeclNode> parse_glyph_declaration();
-    std::unique_ptr<PropertyNode> parse_property();
-    std::unique_ptr<ASTNode> parse_block();
-    std::unique_ptr<ASTNode> parse_expression();
-    std::unique_ptr<ASTNode> parse_list();
+    bool expect(TokenType type, const char* message);
+    
+    ASTNode* parse_statement();
+    VMDeclNode* parse_vm_declaration();
+    GlyphDeclNode* parse_glyph_declaration();
+    PropertyNode* parse_property();
+    ASTNode* parse_block();
+    ASTNode* parse_mount();
+    ASTNode* parse_expression();
+    ASTNode* parse_list();
+    
+    // Parses statements up to the closing '}' and attaches them to `node`
+    void parse_body(ASTNode* node);
+    void finish_children(ASTNode* node, size_t scratch_start);
+    std::string_view token_text(const Token& token);
+    void synchronize();
+    bool at_declaration() const;
     
     void add_error(const std::string& message);
 };
@@ -204,6 +303,7 @@ public:
     
     // Generate VM glyph from AST
     VMGlyph generate_vm_glyph(const ASTNode& ast);
+    VMGlyph generate_vm_glyph(const VMDeclNode* vm, const GlyphDeclNode& glyph);
     AIWorkbenchGlyph generate_ai_workbench(const ASTNode& ast);
     DISProgram generate_dis_program(const ASTNode& ast);
     
@@ -220,9 +320,10 @@ private:
     std::map<std::string, VMGlyph> vm_registry_;
     
     void add_error(const std::string& message);
-    void process_vm_declaration(const VMDeclNode& node);
-    void process_glyph_declaration(const GlyphDeclNode& node);
+    void process_vm_declaration(VMGlyph& glyph, const VMDeclNode& node);
+    void process_glyph_declaration(VMGlyph& glyph, const GlyphDeclNode& node);
     void process_properties(const ASTNode& node, std::map<std::string, std::string>& props);
+    void apply_property(VMGlyph& glyph, const PropertyNode& property);
 };
 
 // Grammar specification (BNF-like notation in comments)
@@ -286,13 +387,11 @@ public:
     std::string get_grammar_documentation();
     
 private:
-    std::unique_ptr<GlyphLexer> lexer_;
-    std::unique_ptr<GlyphParser> parser_;
     std::unique_ptr<GlyphCodeGenerator> generator_;
     std::vector<std::string> errors_;
     
     void clear_errors();
-    void collect_errors();
+    void collect_errors(const GlyphAST& ast);
 };
 
 // Example glyph descriptions as string constants
@@ -13,6 +13,8 @@
 #include <mutex>
 #include <thread>
 
+#include "bolt/ai/ai_stream.hpp"
+
 // Forward declaration
 namespace bolt { namespace ai { class EnhancedAIManager; } }
 
@@ -51,6 +53,15 @@ private:
     std::mutex chat_mutex_;
     std::vector<ChatMessage> pending_messages_;
     
+    // Streamed reply, guarded by chat_mutex_
+    bolt::ai::CancellationToken reply_cancel_;
+    size_t reply_generation_ = 0;   // Bumped per request so abandoned replies stay silent
+    size_t reply_index_ = 0;        // Position of the reply in chat_history_
+    std::string streamed_text_;     // Received but not yet shown
+    std::string finished_reply_;
+    bool reply_streaming_ = false;
+    bool reply_finished_ = false;
+    
     // UI State
     char chat_input_buffer_[1024] = "";
     char code_buffer_[8192] = "// Welcome to Bolt AI IDE!\n// Start typing your code here...\n\n";
@@ -100,7 +111,10 @@ private:
     void ProcessChatInput();
     void AddChatMessage(const std::string& author, const std::string& message, bool is_user);
     void AddConsoleLog(const std::string& message);
-    std::string GenerateAiResponse(const std::string& input);
+    std::string GenerateAiResponse(const std::string& input,
+                                   const bolt::ai::TokenCallback& on_token,
+                                   const bolt::ai::CancellationToken& cancel);
+    void StopChatReply();
     std::string GenerateFallbackResponse(const std::string& input);
     void ProcessPendingMessages();
     
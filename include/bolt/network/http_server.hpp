@@ -6,6 +6,7 @@
 #include <sstream>
 #include <unordered_map>
 #include "network_commands.hpp"
+#include "network_metrics.hpp"
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
@@ -112,13 +113,24 @@ public:
 private:
     void handleClient(int client_fd) {
         char buffer[1024] = {0};
-        read(client_fd, buffer, 1024);
+        auto bytesRead = read(client_fd, buffer, 1024);
+        auto& metrics = NetworkMetrics::getInstance();
+        if (bytesRead > 0) {
+            metrics.recordMessageSize("http", static_cast<uint64_t>(bytesRead));
+        }
         
         HTTPResponse response;
-        response.setHeader("Content-Type", "text/html");
-        response.setBody("<html><body><h1>Bolt C++ HTTP Server</h1></body></html>");
+        if (std::strncmp(buffer, "GET /metrics ", 13) == 0) {
+            // Scrape endpoint for Prometheus/OpenMetrics collectors
+            response.setHeader("Content-Type", "application/openmetrics-text; version=1.0.0; charset=utf-8");
+            response.setBody(NetworkMetrics::getInstance().generateOpenMetrics());
+        } else {
+            response.setHeader("Content-Type", "text/html");
+            response.setBody("<html><body><h1>Bolt C++ HTTP Server</h1></body></html>");
+        }
         
         std::string response_str = response.toString();
+        metrics.recordMessageSize("http", response_str.length());
         write(client_fd, response_str.c_str(), response_str.length());
     }
     
@@ -0,0 +1,109 @@
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace bolt {
+
+/**
+ * Point-in-time copy of a histogram, produced when metrics are scraped.
+ *
+ * Buckets use an HDR (high dynamic range) log-linear layout: values below
+ * 2^subBucketBits are counted exactly, larger values fall into one of
+ * 2^(subBucketBits-1) linear sub-buckets per power of two, which bounds the
+ * relative error of any reported percentile to 2^-(subBucketBits-1).
+ */
+class HistogramSnapshot {
+public:
+    HistogramSnapshot() = default;
+    HistogramSnapshot(uint32_t subBucketBits, uint64_t highestTrackableValue);
+
+    // Merge another snapshot with the same layout into this one
+    void merge(const HistogramSnapshot& other);
+
+    uint64_t getTotalCount() const { return totalCount_; }
+    uint64_t getSum() const { return sum_; }
+    uint64_t getMin() const { return totalCount_ > 0 ? min_ : 0; }
+    uint64_t getMax() const { return max_; }
+    double getMean() const;
+
+    // Highest value equivalent to the bucket holding the given percentile (0-100)
+    uint64_t valueAtPercentile(double percentile) const;
+
+    bool empty() const { return totalCount_ == 0; }
+
+private:
+    friend class LatencyHistogram;
+
+    uint32_t subBucketBits_ = 0;
+    uint64_t highestTrackableValue_ = 0;
+    std::vector<uint64_t> counts_;
+    uint64_t totalCount_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+};
+
+/**
+ * Lock-free HDR histogram for latency, size and queue-wait distributions.
+ *
+ * Recording threads are spread over a fixed set of shards, each allocated on
+ * first use, so the hot path is a handful of relaxed atomic increments on
+ * memory that is effectively private to the calling thread. Shards are only
+ * combined when snapshot() is called by the scraper.
+ */
+class LatencyHistogram {
+public:
+    static constexpr uint32_t DEFAULT_SUB_BUCKET_BITS = 7;          // < 1.6% error
+    static constexpr uint64_t DEFAULT_HIGHEST_VALUE = 1ULL << 36;   // ~19h in microseconds
+    static constexpr size_t SHARD_COUNT = 16;
+
+    explicit LatencyHistogram(uint32_t subBucketBits = DEFAULT_SUB_BUCKET_BITS,
+                              uint64_t highestTrackableValue = DEFAULT_HIGHEST_VALUE);
+    ~LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    // Values above the highest trackable value are clamped into the last bucket
+    void record(uint64_t value);
+    void recordMultiple(uint64_t value, uint64_t count);
+
+    // Merge all shards into a consistent-enough copy for reporting
+    HistogramSnapshot snapshot() const;
+
+    void reset();
+
+    uint32_t getSubBucketBits() const { return subBucketBits_; }
+    uint64_t getHighestTrackableValue() const { return highestTrackableValue_; }
+    size_t getBucketCount() const { return bucketCount_; }
+
+    // Bucket layout helpers, shared with HistogramSnapshot
+    static size_t bucketIndexFor(uint64_t value, uint32_t subBucketBits);
+    static uint64_t highestEquivalentValue(size_t index, uint32_t subBucketBits);
+
+private:
+    struct Shard {
+        explicit Shard(size_t buckets);
+
+        std::unique_ptr<std::atomic<uint64_t>[]> counts;
+        std::atomic<uint64_t> totalCount{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> min{UINT64_MAX};
+        std::atomic<uint64_t> max{0};
+    };
+
+    uint32_t subBucketBits_;
+    uint64_t highestTrackableValue_;
+    size_t bucketCount_;
+    std::atomic<Shard*> shards_[SHARD_COUNT];
+
+    Shard& shardForCurrentThread();
+};
+
+} // namespace bolt
+
+#endif
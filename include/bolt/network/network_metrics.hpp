@@ -1,6 +1,7 @@
 #ifndef NETWORK_METRICS_HPP
 #define NETWORK_METRICS_HPP
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <string>
@@ -8,6 +9,7 @@
 #include <vector>
 #include <mutex>
 #include <memory>
+#include "bolt/network/latency_histogram.hpp"
 
 namespace bolt {
 
@@ -182,6 +184,10 @@ public:
         return std::chrono::duration_cast<std::chrono::microseconds>(now - startTime_).count();
     }
     
+    void recordLatency(LatencyHistogram& histogram) const {
+        histogram.record(getMicroseconds());
+    }
+    
     void recordLatency(NetworkStats& stats) {
         uint64_t latency = getMicroseconds();
         stats.totalLatency += latency;
@@ -223,6 +229,44 @@ private:
     double peakBandwidth_;
     
     void cleanup();
+    double computeBandwidth() const;
+};
+
+/**
+ * Distributions tracked alongside the NetworkStats counters
+ */
+enum class HistogramKind {
+    LATENCY,     // per-message latency, microseconds
+    FRAME_SIZE,  // frame payload size, bytes
+    QUEUE_WAIT,  // time spent queued before send/processing, microseconds
+    MESSAGE_SIZE // whole HTTP request/response size, bytes
+};
+
+struct NetworkHistograms {
+    LatencyHistogram latency;
+    LatencyHistogram frameSize;
+    LatencyHistogram queueWait;
+    LatencyHistogram messageSize;
+    
+    LatencyHistogram& get(HistogramKind kind) {
+        switch (kind) {
+            case HistogramKind::FRAME_SIZE: return frameSize;
+            case HistogramKind::QUEUE_WAIT: return queueWait;
+            case HistogramKind::MESSAGE_SIZE: return messageSize;
+            default: return latency;
+        }
+    }
+    
+    const LatencyHistogram& get(HistogramKind kind) const {
+        return const_cast<NetworkHistograms*>(this)->get(kind);
+    }
+    
+    void reset() {
+        latency.reset();
+        frameSize.reset();
+        queueWait.reset();
+        messageSize.reset();
+    }
 };
 
 /**
@@ -248,6 +292,9 @@ public:
     void recordError(const std::string& endpoint, const std::string& errorType);
     void recordWebSocketFrame(const std::string& endpoint, bool sent, bool received);
     void recordHttpRequest(const std::string& endpoint, int statusCode);
+    void recordFrameSize(const std::string& endpoint, uint64_t bytes);
+    void recordQueueWait(const std::string& endpoint, uint64_t microseconds);
+    void recordMessageSize(const std::string& endpoint, uint64_t bytes);
     
     // Metrics retrieval
     NetworkStats getGlobalStats() const;
@@ -260,6 +307,10 @@ public:
     double getEndpointBandwidthIn(const std::string& endpoint) const;
     double getEndpointBandwidthOut(const std::string& endpoint) const;
     
+    // Distribution snapshots (shards are merged at call time)
+    HistogramSnapshot getGlobalHistogram(HistogramKind kind) const;
+    HistogramSnapshot getEndpointHistogram(const std::string& endpoint, HistogramKind kind) const;
+    
     // Reset functions
     void resetGlobalStats();
     void resetEndpointStats(const std::string& endpoint);
@@ -272,6 +323,10 @@ public:
     // Report generation
     std::string generateReport() const;
     std::string generateEndpointReport(const std::string& endpoint) const;
+    
+    // OpenMetrics text exposition, optionally including profiler counters
+    std::string generateOpenMetrics(bool includeProfiler = true) const;
+    bool exportOpenMetrics(const std::string& filename, bool includeProfiler = true) const;
 
 private:
     NetworkMetrics() : detailedMetrics_(true) {}
@@ -280,6 +335,17 @@ private:
     NetworkStats globalStats_;
     std::unordered_map<std::string, std::shared_ptr<NetworkStats>> endpointStats_;
     
+    // Histograms record lock-free. The endpoint lookup locks only the shard
+    // its name hashes to, so recording never contends on metricsMutex_.
+    // Callers holding metricsMutex_ may take a shard lock, never the reverse.
+    static constexpr size_t HISTOGRAM_SHARDS = 16;
+    struct HistogramShard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<NetworkHistograms>> histograms;
+    };
+    NetworkHistograms globalHistograms_;
+    std::array<HistogramShard, HISTOGRAM_SHARDS> histogramShards_;
+    
     // Bandwidth trackers
     std::unique_ptr<BandwidthTracker> globalBandwidthIn_;
     std::unique_ptr<BandwidthTracker> globalBandwidthOut_;
@@ -289,6 +355,10 @@ private:
     bool detailedMetrics_;
     
     NetworkStats& getOrCreateEndpointStats(const std::string& endpoint);
+    HistogramShard& histogramShard(const std::string& endpoint);
+    const HistogramShard& histogramShard(const std::string& endpoint) const;
+    std::shared_ptr<NetworkHistograms> getOrCreateEndpointHistograms(const std::string& endpoint);
+    void recordHistogramValue(const std::string& endpoint, HistogramKind kind, uint64_t value);
     BandwidthTracker& getOrCreateBandwidthTracker(
         std::unordered_map<std::string, std::unique_ptr<BandwidthTracker>>& trackers,
         const std::string& endpoint
@@ -306,10 +376,7 @@ public:
     }
     
     ~MetricRecorder() {
-        auto endpointStats = NetworkMetrics::getInstance().getEndpointStats(endpoint_);
-        if (endpointStats) {
-            latencyMeasurer_.recordLatency(*endpointStats);
-        }
+        NetworkMetrics::getInstance().recordLatency(endpoint_, latencyMeasurer_.getMicroseconds());
         NetworkMetrics::getInstance().recordDisconnection(endpoint_);
     }
     
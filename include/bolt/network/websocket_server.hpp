@@ -6,6 +6,8 @@
 #include <functional>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <unordered_set>
 #include <vector>
 #include "network_commands.hpp"
@@ -15,13 +17,17 @@ namespace bolt {
 class WebSocketConnection {
 public:
     WebSocketConnection(int socket) : socket_(socket) {}
+    // Thread-safe; a frame is never interleaved with another one
     void send(const std::string& message, bool binary = false);
     void close();
+    // Wakes the reader blocked on this connection without releasing the socket
+    void shutdown();
     bool performHandshake();
     int getSocket() const { return socket_; }
     
 private:
     int socket_;
+    std::mutex sendMutex_;
     std::string generateAcceptKey(const std::string& clientKey);
     std::vector<uint8_t> createFrame(const std::string& payload, bool binary);
 };
@@ -50,14 +56,23 @@ public:
     }
 
 private:
+    // Largest frame payload accepted from a client
+    static constexpr uint64_t MAX_FRAME_PAYLOAD = 16 * 1024 * 1024;
+    
     WebSocketServer() = default;
-    void handleClient(int clientSocket);
-    std::vector<uint8_t> parseFrame(const std::vector<uint8_t>& buffer, bool& isBinary);
+    void handleClient(WebSocketConnection* conn);
+    // Parses the frame at the front of data. Returns false until the whole
+    // frame is buffered; frameLength is set to the bytes it occupies, or to 0
+    // when the frame is malformed or too large.
+    static bool parseFrame(const uint8_t* data, size_t length, size_t& frameLength,
+                           uint8_t& opcode, bool& fin, std::vector<uint8_t>& payload);
     
-    bool running_ = false;
+    std::atomic<bool> running_{false};
     int serverSocket_ = -1;
     std::thread serverThread_;
     std::mutex connectionsMutex_;
+    std::condition_variable handlersDone_;
+    size_t activeHandlers_ = 0;
     std::unordered_set<WebSocketConnection*> connections_;
     std::function<void(const std::string&, WebSocketConnection*, bool)> messageCallback_;
     std::function<void(WebSocketConnection*)> connectCallback_;
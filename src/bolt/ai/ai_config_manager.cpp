@@ -173,6 +173,9 @@ bool AIConfigManager::load_config(const std::string& config_file) {
                 config.system_prompt = provider.get("system_prompt", "You are a helpful AI assistant.").asString();
                 config.timeout_seconds = provider.get("timeout_seconds", 30).asInt();
                 config.verify_ssl = provider.get("verify_ssl", true).asBool();
+                config.draft_model_path = provider.get("draft_model_path", "").asString();
+                config.draft_tokens = provider.get("draft_tokens", 4).asInt();
+                config.inference_slots = provider.get("inference_slots", 0).asInt();
                 
                 std::string api_type_str = provider.get("api_type", "llama_cpp").asString();
                 if (api_type_str == "openai") config.api_type = APIType::OPENAI;
@@ -217,6 +220,13 @@ bool AIConfigManager::save_config(const std::string& config_file) {
             provider["system_prompt"] = config.system_prompt;
             provider["timeout_seconds"] = config.timeout_seconds;
             provider["verify_ssl"] = config.verify_ssl;
+            if (!config.draft_model_path.empty()) {
+                provider["draft_model_path"] = config.draft_model_path;
+                provider["draft_tokens"] = config.draft_tokens;
+            }
+            if (config.inference_slots > 0) {
+                provider["inference_slots"] = config.inference_slots;
+            }
             
             std::string api_type_str;
             switch (config.api_type) {
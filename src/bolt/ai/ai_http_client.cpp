@@ -3,6 +3,8 @@
 #include <sstream>
 #include <thread>
 #include <chrono>
+#include <memory>
+#include <string_view>
 
 #ifdef BOLT_HAVE_CURL
 #include <curl/curl.h>
@@ -24,6 +26,123 @@ size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* use
     return total_size;
 }
 
+namespace {
+
+// Progress of one streamed reply
+struct StreamState {
+    SSEParser parser;
+    const TokenCallback* on_token = nullptr;
+    const CancellationToken* cancel = nullptr;
+    std::string text;    // Reply so far
+    std::string head;    // Start of the body, for error reports
+    std::string error;
+    int tokens_generated = 0;
+    int tokens_processed = 0;
+    bool stopped = false;  // Cancelled by the caller
+};
+
+constexpr size_t STREAM_HEAD_LIMIT = 4096;
+
+// One event of a streamed reply: an OpenAI-style chunk with a delta, an
+// Anthropic delta or a llama.cpp server chunk. False ends the transfer.
+bool handle_stream_event(StreamState& state, const std::string& data) {
+    if (data == "[DONE]") {
+        return true;
+    }
+    
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    Json::Value root;
+    std::string errors;
+    if (!reader->parse(data.data(), data.data() + data.size(), &root, &errors) || !root.isObject()) {
+        return true;  // Keep-alives and other non-JSON events
+    }
+    
+    std::string piece;
+    if (root.isMember("choices") && root["choices"].isArray() && !root["choices"].empty()) {
+        const Json::Value& delta = root["choices"][0]["delta"];
+        if (delta.isObject() && delta["content"].isString()) {
+            piece = delta["content"].asString();
+        }
+        if (root["usage"].isObject()) {
+            state.tokens_processed = root["usage"]["prompt_tokens"].asInt();
+            state.tokens_generated = root["usage"]["completion_tokens"].asInt();
+        }
+    } else if (root["delta"].isObject() && root["delta"]["text"].isString()) {
+        piece = root["delta"]["text"].asString();
+    } else if (root["content"].isString()) {
+        piece = root["content"].asString();
+        if (root["tokens_predicted"].isInt()) {
+            state.tokens_generated = root["tokens_predicted"].asInt();
+        }
+        if (root["tokens_evaluated"].isInt()) {
+            state.tokens_processed = root["tokens_evaluated"].asInt();
+        }
+    } else if (root.isMember("error")) {
+        const Json::Value& error = root["error"];
+        state.error = "API Error: " + (error.isObject() ? error["message"].asString() : error.asString());
+        return false;
+    }
+    
+    if (piece.empty()) {
+        return true;
+    }
+    state.text += piece;
+    if (state.cancel->is_cancelled() || (*state.on_token && !(*state.on_token)(piece))) {
+        state.stopped = true;
+        return false;
+    }
+    return true;
+}
+
+size_t StreamWriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+    auto& state = *static_cast<StreamState*>(userp);
+    std::string_view bytes(static_cast<const char*>(contents), size * nmemb);
+    if (state.head.size() < STREAM_HEAD_LIMIT) {
+        state.head.append(bytes.substr(0, STREAM_HEAD_LIMIT - state.head.size()));
+    }
+    if (state.cancel->is_cancelled()) {
+        state.stopped = true;
+        return 0;
+    }
+    
+    // Any short count makes curl abort the transfer
+    bool keep_going = state.parser.feed(bytes, [&state](const std::string& data) {
+        return handle_stream_event(state, data);
+    });
+    return keep_going ? bytes.size() : 0;
+}
+
+// Notices a cancel while the server is silent; curl calls this about once
+// a second when idle and more often while data flows
+int StreamProgressCallback(void* userp, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+    auto& state = *static_cast<StreamState*>(userp);
+    if (state.cancel->is_cancelled()) {
+        state.stopped = true;
+        return 1;
+    }
+    return 0;
+}
+
+// URL, headers and body of a request; the returned list must outlive the transfer
+curl_slist* apply_request(CURL* curl, const HttpRequest& request) {
+    curl_easy_setopt(curl, CURLOPT_URL, request.url.c_str());
+    
+    struct curl_slist* headers = nullptr;
+    for (const auto& header : request.headers) {
+        headers = curl_slist_append(headers, (header.first + ": " + header.second).c_str());
+    }
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    
+    if (!request.body.empty()) {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request.body.c_str());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, request.body.length());
+    }
+    return headers;
+}
+
+} // namespace
+
 AIHttpClient::AIHttpClient(const AIHttpConfig& config) : config_(config) {
     curl_global_init(CURL_GLOBAL_DEFAULT);
     curl_ = curl_easy_init();
@@ -70,22 +189,8 @@ drawkern::AIInferenceResponse AIHttpClient::send_request(const HttpRequest& requ
     auto start_time = std::chrono::high_resolution_clock::now();
     std::string response_data;
     
-    // Set URL
-    curl_easy_setopt(curl_, CURLOPT_URL, request.url.c_str());
     curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &response_data);
-    
-    // Set headers
-    struct curl_slist* headers = nullptr;
-    for (const auto& header : request.headers) {
-        headers = curl_slist_append(headers, (header.first + ": " + header.second).c_str());
-    }
-    curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, headers);
-    
-    // Set POST data if present
-    if (!request.body.empty()) {
-        curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, request.body.c_str());
-        curl_easy_setopt(curl_, CURLOPT_POSTFIELDSIZE, request.body.length());
-    }
+    struct curl_slist* headers = apply_request(curl_, request);
     
     // Perform the request
     CURLcode res = curl_easy_perform(curl_);
@@ -118,7 +223,86 @@ drawkern::AIInferenceResponse AIHttpClient::send_request(const HttpRequest& requ
     return parse_response(response_data, request.api_type);
 }
 
-HttpRequest AIHttpClient::create_chat_request(const std::string& message, const std::string& session_id) {
+drawkern::AIInferenceResponse AIHttpClient::chat_stream(const std::string& message, const std::string& session_id,
+                                                        const TokenCallback& on_token, const CancellationToken& cancel) {
+    if (cancel.is_cancelled()) {
+        drawkern::AIInferenceResponse response;
+        response.error = CANCELLED_ERROR;
+        return response;
+    }
+    
+    if (!config_.use_streaming) {
+        drawkern::AIInferenceResponse response = send_request(create_chat_request(message, session_id));
+        if (response.success && on_token) {
+            on_token(response.response);
+        }
+        return response;
+    }
+    return send_streaming_request(create_chat_request(message, session_id, true), on_token, cancel);
+}
+
+drawkern::AIInferenceResponse AIHttpClient::send_streaming_request(const HttpRequest& request, const TokenCallback& on_token,
+                                                                   const CancellationToken& cancel) {
+    drawkern::AIInferenceResponse response;
+    
+    if (!curl_) {
+        response.error = "HTTP client not initialized";
+        response.success = false;
+        return response;
+    }
+    
+    auto start_time = std::chrono::high_resolution_clock::now();
+    StreamState state;
+    state.on_token = &on_token;
+    state.cancel = &cancel;
+    
+    curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, StreamWriteCallback);
+    curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &state);
+    curl_easy_setopt(curl_, CURLOPT_XFERINFOFUNCTION, StreamProgressCallback);
+    curl_easy_setopt(curl_, CURLOPT_XFERINFODATA, &state);
+    curl_easy_setopt(curl_, CURLOPT_NOPROGRESS, 0L);
+    struct curl_slist* headers = apply_request(curl_, request);
+    
+    CURLcode res = curl_easy_perform(curl_);
+    
+    // Back to the defaults the other requests rely on
+    curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl_, CURLOPT_NOPROGRESS, 1L);
+    if (headers) {
+        curl_slist_free_all(headers);
+    }
+    
+    auto end_time = std::chrono::high_resolution_clock::now();
+    response.inference_time_ms = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+    response.response = state.text;
+    response.tokens_generated = state.tokens_generated;
+    response.tokens_processed = state.tokens_processed;
+    
+    if (state.stopped) {
+        response.error = CANCELLED_ERROR;
+        return response;
+    }
+    if (!state.error.empty()) {
+        response.error = state.error;
+        return response;
+    }
+    if (res != CURLE_OK) {
+        response.error = "HTTP request failed: " + std::string(curl_easy_strerror(res));
+        return response;
+    }
+    
+    long response_code;
+    curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &response_code);
+    if (response_code != 200) {
+        response.error = "HTTP error " + std::to_string(response_code) + ": " + state.head;
+        return response;
+    }
+    
+    response.success = true;
+    return response;
+}
+
+HttpRequest AIHttpClient::create_chat_request(const std::string& message, const std::string& session_id, bool stream) {
     HttpRequest request;
     request.url = config_.base_url + "/v1/chat/completions";
     request.api_type = config_.api_type;
@@ -138,7 +322,7 @@ HttpRequest AIHttpClient::create_chat_request(const std::string& message, const
         root["model"] = config_.model_name;
         root["max_tokens"] = config_.max_tokens;
         root["temperature"] = config_.temperature;
-        root["stream"] = false;
+        root["stream"] = stream;
         
         // Add system message if configured
         if (!config_.system_prompt.empty()) {
@@ -161,7 +345,7 @@ HttpRequest AIHttpClient::create_chat_request(const std::string& message, const
         root["n_predict"] = config_.max_tokens;
         root["temperature"] = config_.temperature;
         root["stop"] = Json::Value(Json::arrayValue);
-        root["stream"] = false;
+        root["stream"] = stream;
     }
     
     Json::StreamWriterBuilder builder;
@@ -337,10 +521,26 @@ drawkern::AIInferenceResponse AIHttpClient::send_request(const HttpRequest& requ
     return response;
 }
 
-HttpRequest AIHttpClient::create_chat_request(const std::string& message, const std::string& session_id) {
+HttpRequest AIHttpClient::create_chat_request(const std::string& message, const std::string& session_id, bool stream) {
     return HttpRequest{}; // Return empty request
 }
 
+drawkern::AIInferenceResponse AIHttpClient::chat_stream(const std::string& message, const std::string& session_id,
+                                                        const TokenCallback& on_token, const CancellationToken& cancel) {
+    drawkern::AIInferenceResponse response;
+    response.success = false;
+    response.error = "HTTP client built without CURL support";
+    return response;
+}
+
+drawkern::AIInferenceResponse AIHttpClient::send_streaming_request(const HttpRequest& request, const TokenCallback& on_token,
+                                                                   const CancellationToken& cancel) {
+    drawkern::AIInferenceResponse response;
+    response.success = false;
+    response.error = "HTTP client built without CURL support";
+    return response;
+}
+
 HttpRequest AIHttpClient::create_completion_request(const std::string& code, const std::string& language) {
     return HttpRequest{}; // Return empty request
 }
@@ -0,0 +1,69 @@
+#include "bolt/ai/ai_stream.hpp"
+
+namespace bolt {
+namespace ai {
+
+bool SSEParser::feed(std::string_view bytes, const EventHandler& on_event) {
+    while (!bytes.empty()) {
+        size_t newline = bytes.find('\n');
+        if (newline == std::string_view::npos) {
+            line_.append(bytes);
+            return true;
+        }
+
+        std::string_view line = bytes.substr(0, newline);
+        bytes.remove_prefix(newline + 1);
+        if (!line_.empty()) {
+            line_.append(line);
+            line = line_;
+        }
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+
+        bool keep_going = dispatch_line(line, on_event);
+        line_.clear();
+        if (!keep_going) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SSEParser::reset() {
+    line_.clear();
+    data_.clear();
+    has_data_ = false;
+}
+
+bool SSEParser::dispatch_line(std::string_view line, const EventHandler& on_event) {
+    // A blank line ends the event
+    if (line.empty()) {
+        if (!has_data_) {
+            return true;
+        }
+        std::string data;
+        data.swap(data_);
+        has_data_ = false;
+        return on_event(data);
+    }
+
+    // Comments and fields other than data (event, id, retry) carry no text
+    if (line.front() == ':' || line.substr(0, 5) != "data:") {
+        return true;
+    }
+
+    std::string_view value = line.substr(5);
+    if (!value.empty() && value.front() == ' ') {
+        value.remove_prefix(1);
+    }
+    if (has_data_) {
+        data_ += '\n';
+    }
+    data_.append(value);
+    has_data_ = true;
+    return true;
+}
+
+} // namespace ai
+} // namespace bolt
@@ -1,4 +1,5 @@
 #include "bolt/ai/direct_gguf_inference.hpp"
+#include "bolt/ai/speculative_decoder.hpp"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -9,6 +10,7 @@
 #include <chrono>
 #include <array>
 #include <filesystem>
+#include <cctype>
 
 #ifdef LLAMA_AVAILABLE
 #include <llama-cpp.h>
@@ -17,37 +19,260 @@
 namespace bolt {
 namespace ai {
 
+namespace {
+
+// Tokens per decode call during prompt prefill
+constexpr int DECODE_BATCH_SIZE = 64;
+
+// Entries per decode for the batching engine, shared by all its slots
+constexpr int ENGINE_BATCH_SIZE = 256;
+
+// Hand canned text to a stream a word at a time; false when cancelled
+bool stream_pieces(const std::string& text, const TokenCallback& on_token, const CancellationToken& cancel) {
+    size_t begin = 0;
+    while (begin < text.size()) {
+        if (cancel.is_cancelled()) {
+            return false;
+        }
+        size_t end = text.find_first_of(" \n", begin);
+        end = end == std::string::npos ? text.size() : end + 1;
+        if (on_token && !on_token(text.substr(begin, end - begin))) {
+            return false;
+        }
+        begin = end;
+    }
+    return true;
+}
+
+#ifdef LLAMA_AVAILABLE
+// Append one token to a batch, as llama.cpp's common helpers do
+void batch_add(llama_batch& batch, llama_token token, llama_pos position, llama_seq_id sequence, bool logits) {
+    batch.token[batch.n_tokens] = token;
+    batch.pos[batch.n_tokens] = position;
+    batch.n_seq_id[batch.n_tokens] = 1;
+    batch.seq_id[batch.n_tokens][0] = sequence;
+    batch.logits[batch.n_tokens] = logits;
+    batch.n_tokens++;
+}
+
+// A llama context's sequence 0 as the speculative decoder sees it, with the
+// prefix cache tracking what the KV cache holds
+class LlamaSequence : public SpeculativeModel {
+public:
+    LlamaSequence(llama_context* ctx, llama_batch& batch, KVPrefixCache& cache, size_t n_vocab)
+        : ctx_(ctx), batch_(batch), cache_(cache), n_vocab_(n_vocab) {}
+
+    size_t n_vocab() const override { return n_vocab_; }
+    size_t length() const override { return cache_.size(); }
+
+    bool decode(const int32_t* tokens, size_t count, size_t logits_from) override {
+        if (cache_.size() + count > (size_t)llama_n_ctx(ctx_)) {
+            return false;
+        }
+        // Logits are read from the last call, so it starts at logits_from
+        size_t done = 0;
+        while (done < count) {
+            size_t limit = done < logits_from ? logits_from : count;
+            size_t end = std::min(limit, done + DECODE_BATCH_SIZE);
+            batch_.n_tokens = 0;
+            for (size_t i = done; i < end; ++i) {
+                batch_add(batch_, tokens[i], (llama_pos)(cache_.size() + i - done), 0, i >= logits_from);
+            }
+            if (llama_decode(ctx_, batch_) != 0) {
+                return false;
+            }
+            cache_.append(tokens + done, end - done);
+            done = end;
+        }
+        return true;
+    }
+
+    float* logits(size_t i) override { return llama_get_logits_ith(ctx_, (int32_t)i); }
+
+    void truncate(size_t length) override {
+        llama_memory_seq_rm(llama_get_memory(ctx_), 0, (llama_pos)length, -1);
+        cache_.truncate(length);
+    }
+
+private:
+    llama_context* ctx_;
+    llama_batch& batch_;
+    KVPrefixCache& cache_;
+    size_t n_vocab_;
+};
+
+// A context of its own over a loaded model for the batching engine; slot
+// i is llama sequence i
+class LlamaBatchedModel : public BatchedModel {
+public:
+    static std::unique_ptr<LlamaBatchedModel> create(llama_model* model, const EngineConfig& config) {
+        llama_context_params ctx_params = llama_context_default_params();
+        ctx_params.n_ctx = (uint32_t)(config.slots * config.slot_context);
+        ctx_params.n_batch = ENGINE_BATCH_SIZE;
+        ctx_params.n_seq_max = (uint32_t)config.slots;
+
+        llama_context* ctx = llama_init_from_model(model, ctx_params);
+        if (!ctx) {
+            return nullptr;
+        }
+        return std::unique_ptr<LlamaBatchedModel>(new LlamaBatchedModel(model, ctx, config.slot_context));
+    }
+
+    ~LlamaBatchedModel() override {
+        llama_batch_free(batch_);
+        llama_free(ctx_);
+    }
+
+    size_t n_vocab() const override { return (size_t)llama_vocab_n_tokens(vocab_); }
+    size_t max_batch() const override { return ENGINE_BATCH_SIZE; }
+    size_t slot_context() const override { return slot_context_; }
+    int32_t eos() const override { return llama_vocab_eos(vocab_); }
+
+    std::vector<int32_t> tokenize(const std::string& text) override {
+        std::vector<llama_token> tokens(text.size() + 8);
+        int n = llama_tokenize(vocab_, text.c_str(), (int32_t)text.size(), tokens.data(), (int)tokens.size(), true, true);
+        tokens.resize(n > 0 ? n : 0);
+        return tokens;
+    }
+
+    std::string token_text(int32_t token) override {
+        char buf[32];
+        int n = llama_token_to_piece(vocab_, token, buf, sizeof(buf), 0, true);
+        return n > 0 ? std::string(buf, buf + n) : std::string();
+    }
+
+    bool decode(const std::vector<Entry>& entries) override {
+        batch_.n_tokens = 0;
+        for (const auto& entry : entries) {
+            batch_add(batch_, entry.token, entry.position, entry.slot, entry.logits);
+        }
+        return llama_decode(ctx_, batch_) == 0;
+    }
+
+    float* logits(size_t i) override { return llama_get_logits_ith(ctx_, (int32_t)i); }
+
+    void evict(int32_t slot, size_t from) override {
+        llama_memory_seq_rm(llama_get_memory(ctx_), slot, (llama_pos)from, -1);
+    }
+
+private:
+    const llama_vocab* vocab_;
+    llama_context* ctx_;
+    llama_batch batch_;
+    size_t slot_context_;
+
+    LlamaBatchedModel(llama_model* model, llama_context* ctx, size_t slot_context)
+        : vocab_(llama_model_get_vocab(model)), ctx_(ctx), batch_(llama_batch_init(ENGINE_BATCH_SIZE, 0, 1)),
+          slot_context_(slot_context) {}
+};
+#endif
+
+} // namespace
+
+size_t KVPrefixCache::reuse(const std::vector<int32_t>& tokens) {
+    size_t limit = std::min(tokens_.size(), tokens.size());
+    size_t keep = std::mismatch(tokens_.begin(), tokens_.begin() + limit, tokens.begin()).first - tokens_.begin();
+    if (keep == tokens.size() && keep > 0) {
+        --keep;
+    }
+    tokens_.resize(keep);
+    reused_tokens_ += keep;
+    return keep;
+}
+
+void KVPrefixCache::append(const int32_t* tokens, size_t count) {
+    tokens_.insert(tokens_.end(), tokens, tokens + count);
+    decoded_tokens_ += count;
+}
+
 struct DirectGGUFInference::ModelData {
 #ifdef LLAMA_AVAILABLE
     llama_model* model = nullptr;
+    const llama_vocab* vocab = nullptr;
     llama_context* ctx = nullptr;
+    llama_batch batch{};         // Reused by every decode call
+    
+    bool open(const std::string& path);
+    void close();
 #endif
     std::string model_info;
     bool initialized = false;
     std::string model_path;
+    
+    KVPrefixCache cache;         // What the context's KV cache holds
+    std::string active_session;  // Session that cache belongs to
+    TokenSampler sampler;
 };
 
+#ifdef LLAMA_AVAILABLE
+bool DirectGGUFInference::ModelData::open(const std::string& path) {
+    llama_model_params model_params = llama_model_default_params();
+    model_params.use_mmap = true;
+    model_params.use_mlock = false;
+
+    model = llama_model_load_from_file(path.c_str(), model_params);
+    if (!model) {
+        std::cout << "❌ Failed to load model via llama.cpp" << std::endl;
+        return false;
+    }
+
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = 2048;
+
+    ctx = llama_init_from_model(model, ctx_params);
+    if (!ctx) {
+        std::cout << "❌ Failed to create llama context" << std::endl;
+        llama_model_free(model);
+        model = nullptr;
+        return false;
+    }
+    vocab = llama_model_get_vocab(model);
+    batch = llama_batch_init(DECODE_BATCH_SIZE, 0, 1);
+    model_path = path;
+    initialized = true;
+    return true;
+}
+
+void DirectGGUFInference::ModelData::close() {
+    if (batch.token) {
+        llama_batch_free(batch);
+        batch = llama_batch{};
+    }
+    if (ctx) {
+        llama_free(ctx);
+        ctx = nullptr;
+    }
+    if (model) {
+        llama_model_free(model);
+        model = nullptr;
+        vocab = nullptr;
+    }
+    cache.clear();
+    initialized = false;
+}
+#endif
+
 DirectGGUFInference::DirectGGUFInference() 
     : model_data_(std::make_unique<ModelData>())
     , model_loaded_(false) {
+    std::error_code ec;
+    session_directory_ = (std::filesystem::temp_directory_path(ec) / "bolt_kv_sessions").string();
     std::cout << "📦 DirectGGUFInference initialized" << std::endl;
 }
 
 DirectGGUFInference::~DirectGGUFInference() {
+    disable_engine();
 #ifdef LLAMA_AVAILABLE
-    if (model_data_->ctx) {
-        llama_free(model_data_->ctx);
-        model_data_->ctx = nullptr;
-    }
-    if (model_data_->model) {
-        llama_free_model(model_data_->model);
-        model_data_->model = nullptr;
+    if (draft_data_) {
+        draft_data_->close();
     }
+    model_data_->close();
     llama_backend_free();
 #endif
 }
 
 bool DirectGGUFInference::load_model(const std::string& model_path) {
+    disable_engine();
     model_path_ = model_path;
     model_data_->model_path = model_path;
 
@@ -68,34 +293,14 @@ bool DirectGGUFInference::load_model(const std::string& model_path) {
     // Initialize backend
     llama_backend_init();
 
-    llama_model_params model_params = llama_model_default_params();
-    model_params.use_mmap = true;
-    model_params.use_mlock = false;
-
-    model_data_->model = llama_load_model_from_file(model_path.c_str(), model_params);
-    if (!model_data_->model) {
-        std::cout << "❌ Failed to load model via llama.cpp" << std::endl;
+    if (!model_data_->open(model_path)) {
         return false;
     }
-
-    llama_context_params ctx_params = llama_context_default_params();
-    ctx_params.n_ctx = 2048;
-    ctx_params.seed = 0;
-
-    model_data_->ctx = llama_new_context_with_model(model_data_->model, ctx_params);
-    if (!model_data_->ctx) {
-        std::cout << "❌ Failed to create llama context" << std::endl;
-        llama_free_model(model_data_->model);
-        model_data_->model = nullptr;
-        return false;
-    }
-
     model_loaded_ = true;
-    model_data_->initialized = true;
 
     std::ostringstream info;
     info << "GGUF Model loaded via llama.cpp: " << model_path << "\n";
-    info << "Context length: " << ctx_params.n_ctx << "\n";
+    info << "Context length: " << llama_n_ctx(model_data_->ctx) << "\n";
     model_data_->model_info = info.str();
 
     std::cout << "✅ Model loaded" << std::endl;
@@ -105,10 +310,119 @@ bool DirectGGUFInference::load_model(const std::string& model_path) {
 #endif
 }
 
+bool DirectGGUFInference::load_draft_model(const std::string& model_path) {
+    if (has_draft_model() && draft_data_->model_path == model_path) {
+        return true;
+    }
+    std::cout << "📥 Loading draft model: " << model_path << std::endl;
+
+    std::ifstream file(model_path);
+    if (!file.good()) {
+        std::cout << "❌ Draft model file not found: " << model_path << std::endl;
+        return false;
+    }
+
+#ifndef LLAMA_AVAILABLE
+    std::cout << "⚠️  llama.cpp not available - speculative decoding disabled" << std::endl;
+    return false;
+#else
+    if (!model_data_->initialized) {
+        std::cout << "❌ Load the main model before its draft" << std::endl;
+        return false;
+    }
+    unload_draft_model();
+
+    auto draft = std::make_unique<ModelData>();
+    if (!draft->open(model_path)) {
+        return false;
+    }
+    // Proposals are token ids, so both models must share a vocabulary
+    if (llama_vocab_n_tokens(draft->vocab) != llama_vocab_n_tokens(model_data_->vocab)) {
+        std::cout << "❌ Draft model vocabulary does not match the main model" << std::endl;
+        draft->close();
+        return false;
+    }
+    draft_data_ = std::move(draft);
+    std::cout << "✅ Draft model loaded" << std::endl;
+    return true;
+#endif
+}
+
+void DirectGGUFInference::unload_draft_model() {
+    if (!draft_data_) {
+        return;
+    }
+#ifdef LLAMA_AVAILABLE
+    draft_data_->close();
+#endif
+    draft_data_.reset();
+}
+
+bool DirectGGUFInference::has_draft_model() const {
+    return draft_data_ && draft_data_->initialized;
+}
+
+void DirectGGUFInference::set_draft_tokens(int draft_tokens) {
+    // The target checks every proposal plus one more token in a single batch
+    draft_tokens_ = std::clamp(draft_tokens, 0, DECODE_BATCH_SIZE - 1);
+}
+
+bool DirectGGUFInference::enable_engine(const EngineConfig& config) {
+#ifndef LLAMA_AVAILABLE
+    std::cout << "⚠️  llama.cpp not available - continuous batching disabled" << std::endl;
+    return false;
+#else
+    if (!model_data_->initialized) {
+        std::cout << "❌ Load a model before enabling continuous batching" << std::endl;
+        return false;
+    }
+    disable_engine();
+
+    auto batched = LlamaBatchedModel::create(model_data_->model, config);
+    if (!batched) {
+        std::cout << "❌ Failed to create batching context for " << config.slots << " slots" << std::endl;
+        return false;
+    }
+    engine_ = std::make_shared<InferenceEngine>(std::move(batched), config);
+    std::cout << "✅ Continuous batching enabled: " << engine_->slots() << " sequence slots" << std::endl;
+    return true;
+#endif
+}
+
+void DirectGGUFInference::disable_engine() {
+    // Stopping fails what is still queued or running
+    engine_.reset();
+}
+
 drawkern::AIInferenceResponse DirectGGUFInference::generate_text(
     const std::string& prompt, 
     int max_tokens,
     float temperature) {
+    return generate_text_stream(prompt, max_tokens, temperature, TokenCallback());
+}
+
+drawkern::AIInferenceResponse DirectGGUFInference::generate_text_stream(
+    const std::string& prompt,
+    int max_tokens,
+    float temperature,
+    const TokenCallback& on_token,
+    const CancellationToken& cancel) {
+    return generate_response(prompt, max_tokens, temperature, on_token, cancel, nullptr, RequestPriority::Normal);
+}
+
+drawkern::AIInferenceResponse DirectGGUFInference::complete_code(const std::string& code, int max_tokens) {
+    auto grammar = std::make_shared<BalancedCodeGrammar>();
+    grammar->accept(code);
+    // Inline completion is waited on by the editor, so it goes first
+    return generate_response(code, max_tokens, 0.2f, TokenCallback(), CancellationToken(), grammar,
+                             RequestPriority::Interactive);
+}
+
+drawkern::AIInferenceResponse DirectGGUFInference::generate_response(const std::string& prompt, int max_tokens,
+                                                                     float temperature, const TokenCallback& on_token,
+                                                                     const CancellationToken& cancel,
+                                                                     const std::shared_ptr<SamplingGrammar>& grammar,
+                                                                     RequestPriority priority) {
     auto start_time = std::chrono::high_resolution_clock::now();
 
     drawkern::AIInferenceResponse response;
@@ -116,15 +430,37 @@ drawkern::AIInferenceResponse DirectGGUFInference::generate_text(
 
     if (!model_loaded_) {
         response = get_fallback_response(prompt);
+        if (!stream_pieces(response.response, on_token, cancel)) {
+            response.success = false;
+            response.error = CANCELLED_ERROR;
+        }
         auto end_time = std::chrono::high_resolution_clock::now();
         response.inference_time_ms = std::chrono::duration<float, std::milli>(end_time - start_time).count();
         return response;
     }
 
+    if (engine_) {
+        EngineRequest request;
+        request.prompt = prompt;
+        request.max_tokens = max_tokens;
+        request.sampling = sampler_params_;
+        request.sampling.temperature = temperature;
+        request.priority = priority;
+        request.grammar = grammar;
+        request.on_token = on_token;
+        request.cancel = cancel;
+        return engine_->submit(std::move(request)).get();
+    }
+
     try {
-        std::string generated_text = generate_internal(prompt, max_tokens, temperature);
+        bool cancelled = false;
+        std::string generated_text = generate_internal(prompt, max_tokens, temperature, on_token, cancel,
+                                                       grammar.get(), cancelled);
         response.response = generated_text;
-        response.success = true;
+        response.success = !cancelled;
+        if (cancelled) {
+            response.error = CANCELLED_ERROR;
+        }
         response.tokens_generated = generated_text.length() / 4;
     } catch (const std::exception& e) {
         response.response = "Error during generation: " + std::string(e.what());
@@ -139,9 +475,105 @@ drawkern::AIInferenceResponse DirectGGUFInference::generate_text(
 
 drawkern::AIInferenceResponse DirectGGUFInference::chat(
     const std::string& message,
-    const std::vector<std::string>& conversation_history) {
+    const std::vector<std::string>& conversation_history,
+    const std::string& session_id) {
+    return chat_stream(message, conversation_history, session_id, TokenCallback());
+}
+
+drawkern::AIInferenceResponse DirectGGUFInference::chat_stream(
+    const std::string& message,
+    const std::vector<std::string>& conversation_history,
+    const std::string& session_id,
+    const TokenCallback& on_token,
+    const CancellationToken& cancel,
+    RequestPriority priority) {
+    // With the engine, a session's prefix stays in whichever slot served it
+    if (!session_id.empty() && !engine_) {
+        switch_session(session_id);
+    }
     std::string formatted_prompt = format_chat_prompt(message, conversation_history);
-    return generate_text(formatted_prompt, 150, 0.7f);
+    drawkern::AIInferenceResponse response = generate_response(formatted_prompt, 150, sampler_params_.temperature,
+                                                               on_token, cancel, nullptr, priority);
+    response.session_id = session_id;
+    return response;
+}
+
+bool DirectGGUFInference::switch_session(const std::string& session_id) {
+    ModelData& data = *model_data_;
+    if (session_id == data.active_session) {
+        return true;
+    }
+    
+    bool restored = true;
+#ifdef LLAMA_AVAILABLE
+    if (data.ctx) {
+        // Park the active session's cache on disk
+        const auto& cached = data.cache.tokens();
+        if (!data.active_session.empty() && !cached.empty()) {
+            std::error_code ec;
+            std::filesystem::create_directories(session_directory_, ec);
+            std::string path = session_cache_path(data.active_session);
+            if (!llama_state_save_file(data.ctx, path.c_str(), cached.data(), cached.size())) {
+                std::cout << "⚠️  Could not save KV cache for session: " << data.active_session << std::endl;
+            }
+        }
+        llama_memory_clear(llama_get_memory(data.ctx), true);
+        data.cache.clear();
+        
+        std::string path = session_cache_path(session_id);
+        std::error_code ec;
+        if (!session_id.empty() && std::filesystem::exists(path, ec)) {
+            std::vector<llama_token> tokens(llama_n_ctx(data.ctx));
+            size_t count = 0;
+            if (llama_state_load_file(data.ctx, path.c_str(), tokens.data(), tokens.size(), &count)) {
+                data.cache.append(tokens.data(), count);
+            } else {
+                std::cout << "⚠️  Could not restore KV cache for session: " << session_id << std::endl;
+                llama_memory_clear(llama_get_memory(data.ctx), true);
+                restored = false;
+            }
+        }
+    }
+#endif
+    data.active_session = session_id;
+    return restored;
+}
+
+void DirectGGUFInference::drop_session(const std::string& session_id) {
+    if (session_id == model_data_->active_session) {
+#ifdef LLAMA_AVAILABLE
+        if (model_data_->ctx) {
+            llama_memory_clear(llama_get_memory(model_data_->ctx), true);
+        }
+#endif
+        model_data_->cache.clear();
+        model_data_->active_session.clear();
+    }
+    std::error_code ec;
+    std::filesystem::remove(session_cache_path(session_id), ec);
+}
+
+const std::string& DirectGGUFInference::active_session() const {
+    return model_data_->active_session;
+}
+
+void DirectGGUFInference::set_session_directory(const std::string& directory) {
+    session_directory_ = directory;
+}
+
+std::string DirectGGUFInference::session_cache_path(const std::string& session_id) const {
+    // Session ids come from callers, so keep them to safe file name characters
+    std::string name;
+    name.reserve(session_id.size());
+    for (char c : session_id) {
+        bool safe = std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_';
+        name += safe ? c : '_';
+    }
+    return (std::filesystem::path(session_directory_) / (name + ".kvcache")).string();
+}
+
+const KVPrefixCache& DirectGGUFInference::kv_cache() const {
+    return model_data_->cache;
 }
 
 std::string DirectGGUFInference::get_model_info() const {
@@ -151,12 +583,19 @@ std::string DirectGGUFInference::get_model_info() const {
     return "No model loaded";
 }
 
-std::string DirectGGUFInference::generate_internal(const std::string& prompt, int max_tokens, float temperature) {
+std::string DirectGGUFInference::generate_internal(const std::string& prompt, int max_tokens, float temperature,
+                                                   const TokenCallback& on_token, const CancellationToken& cancel,
+                                                   SamplingGrammar* grammar, bool& cancelled) {
+    auto fallback = [&]() {
+        std::string text = get_smart_fallback(prompt);
+        cancelled = !stream_pieces(text, on_token, cancel);
+        return text;
+    };
 #ifndef LLAMA_AVAILABLE
-    return get_smart_fallback(prompt);
+    return fallback();
 #else
     if (!model_data_->initialized || !model_data_->ctx) {
-        return get_smart_fallback(prompt);
+        return fallback();
     }
 
     // Build a simple prompt and run llama.cpp generation
@@ -165,73 +604,146 @@ std::string DirectGGUFInference::generate_internal(const std::string& prompt, in
     system_prefix += prompt;
 
     llama_context* ctx = model_data_->ctx;
+    KVPrefixCache& cache = model_data_->cache;
 
     // Tokenize input
     std::vector<llama_token> tokens_in(system_prefix.size() + 8);
-    int n_in = llama_tokenize(ctx, system_prefix.c_str(), tokens_in.data(), (int)tokens_in.size(), true, true);
-    if (n_in < 0) return get_smart_fallback(prompt);
+    const llama_vocab* vocab = model_data_->vocab;
+    int n_in = llama_tokenize(vocab, system_prefix.c_str(), (int32_t)system_prefix.size(), tokens_in.data(),
+                              (int)tokens_in.size(), true, true);
+    if (n_in <= 0) return fallback();
     tokens_in.resize(n_in);
 
-    // Eval input
     int n_ctx = llama_n_ctx(ctx);
-    int n_batch = 64;
-    llama_batch batch = llama_batch_init(n_batch, 0, 1);
+    if (n_in >= n_ctx) return fallback();
+
+    // Keep the cached prefix and evict the rest, then decode only the new suffix
+    size_t keep = cache.reuse(tokens_in);
+    llama_memory_seq_rm(llama_get_memory(ctx), 0, (llama_pos)keep, -1);
+
+    // The sampler works on llama's logits row in place; the prompt's tail
+    // counts toward the repetition penalty
+    auto token_text = [vocab](int32_t token) {
+        char buf[32];
+        int n = llama_token_to_piece(vocab, token, buf, sizeof(buf), 0, true);
+        return n > 0 ? std::string(buf, buf + n) : std::string();
+    };
+    SamplerParams params = sampler_params_;
+    params.temperature = temperature;
+    TokenSampler& sampler = model_data_->sampler;
+    sampler.set_params(params);
+    sampler.reset();
+    size_t window = std::min(tokens_in.size(), (size_t)std::max(params.repeat_last_n, 0));
+    sampler.add_history(tokens_in.data() + tokens_in.size() - window, window);
+
+    std::string out;
+    out.reserve((size_t)max_tokens * 4);
+    const size_t n_vocab = (size_t)llama_vocab_n_tokens(vocab);
+    const llama_token eos = llama_vocab_eos(vocab);
 
-    int consumed = 0;
+    if (has_draft_model() && draft_tokens_ > 0) {
+        if (cancel.is_cancelled()) {
+            cancelled = true;
+            return "";
+        }
+        // The draft keeps its own prefix cache in step with the prompt
+        ModelData& draft = *draft_data_;
+        size_t draft_keep = draft.cache.reuse(tokens_in);
+        llama_memory_seq_rm(llama_get_memory(draft.ctx), 0, (llama_pos)draft_keep, -1);
+
+        LlamaSequence target_sequence(ctx, model_data_->batch, cache, n_vocab);
+        LlamaSequence draft_sequence(draft.ctx, draft.batch, draft.cache, n_vocab);
+        SpeculativeDecoder decoder(target_sequence, draft_sequence, sampler, (size_t)draft_tokens_);
+        std::vector<int32_t> sequence(tokens_in.begin(), tokens_in.end());
+
+        sampler.set_grammar(grammar, token_text);
+        decoder.generate(sequence, (size_t)max_tokens, eos, [&](int32_t token) {
+            if (cancel.is_cancelled()) {
+                cancelled = true;
+                return false;
+            }
+            std::string piece = token_text(token);
+            out += piece;
+            if (on_token && !piece.empty() && !on_token(piece)) {
+                cancelled = true;
+                return false;
+            }
+            return true;
+        });
+        sampler.set_grammar(nullptr, TokenSampler::TokenText());
+
+        const SpeculativeStats& round = decoder.stats();
+        speculative_stats_.rounds += round.rounds;
+        speculative_stats_.drafted += round.drafted;
+        speculative_stats_.accepted += round.accepted;
+        speculative_stats_.generated += round.generated;
+
+        if (out.empty() && !cancelled) {
+            return fallback();
+        }
+        return out;
+    }
+
+    llama_batch& batch = model_data_->batch;
+
+    int consumed = (int)keep;
     while (consumed < (int)tokens_in.size()) {
-        int to_eval = std::min(n_batch, (int)tokens_in.size() - consumed);
+        // What was decoded so far stays cached for the next prompt
+        if (cancel.is_cancelled()) {
+            cancelled = true;
+            return "";
+        }
+        int to_eval = std::min(DECODE_BATCH_SIZE, (int)tokens_in.size() - consumed);
         batch.n_tokens = 0;
         for (int i = 0; i < to_eval; ++i) {
-            llama_batch_add(batch, tokens_in[consumed + i], consumed + i, { 0 }, true);
+            bool last = consumed + i == (int)tokens_in.size() - 1;
+            batch_add(batch, tokens_in[consumed + i], consumed + i, 0, last);
         }
         if (llama_decode(ctx, batch) != 0) {
-            llama_batch_free(batch);
-            return get_smart_fallback(prompt);
+            // The cache may be partly written; start cold next time
+            llama_memory_clear(llama_get_memory(ctx), true);
+            cache.clear();
+            return fallback();
         }
+        cache.append(tokens_in.data() + consumed, to_eval);
         consumed += to_eval;
     }
+    int logits_index = batch.n_tokens - 1;
 
-    // Sampling loop
-    std::string out;
-    out.reserve((size_t)max_tokens * 4);
-
-    std::vector<float> logits(llama_n_vocab(model_data_->model));
-    std::vector<llama_token_data> candidates;
-    candidates.reserve(logits.size());
-
-    for (int i = 0; i < max_tokens; ++i) {
-        const float* cur_logits = llama_get_logits_ith(ctx, llama_get_kv_cache_token_count(ctx) - 1);
-        std::copy(cur_logits, cur_logits + (int)logits.size(), logits.begin());
-
-        candidates.clear();
-        for (int id = 0; id < (int)logits.size(); ++id) {
-            candidates.push_back({ id, logits[id], 0.0f });
+    sampler.set_grammar(grammar, token_text);
+    for (int i = 0; i < max_tokens && (int)cache.size() < n_ctx; ++i) {
+        if (cancel.is_cancelled()) {
+            cancelled = true;
+            break;
         }
-        llama_token_data_array cur_p = { candidates.data(), candidates.size(), false };
-
-        // Temperature sampling
-        llama_sample_temperature(ctx, &cur_p, temperature);
-        llama_token id = llama_sample_token(ctx, &cur_p);
-
-        if (id == llama_token_eos(model_data_->model)) break;
+        llama_token id = sampler.sample(llama_get_logits_ith(ctx, logits_index), n_vocab);
+        if (id < 0 || id == eos) break;
 
         // Append to output
-        char buf[8];
-        int n = llama_token_to_piece(ctx, id, buf, sizeof(buf), 0, true);
-        if (n > 0) out.append(buf, buf + n);
-
-        // Feed back the token
-        llama_batch batch_next = llama_batch_init(1, 0, 1);
-        llama_batch_add(batch_next, id, tokens_in.size() + i, { 0 }, true);
-        if (llama_decode(ctx, batch_next) != 0) {
-            llama_batch_free(batch_next);
+        std::string piece = token_text(id);
+        if (!piece.empty()) {
+            out += piece;
+            if (on_token && !on_token(piece)) {
+                cancelled = true;
+                break;
+            }
+        }
+
+        // Feed back the token; it stays cached for the next turn's prompt
+        batch.n_tokens = 0;
+        batch_add(batch, id, (llama_pos)cache.size(), 0, true);
+        if (llama_decode(ctx, batch) != 0) {
             break;
         }
-        llama_batch_free(batch_next);
+        cache.append(id);
+        logits_index = 0;
     }
+    sampler.set_grammar(nullptr, TokenSampler::TokenText());
 
-    llama_batch_free(batch);
-    return out.empty() ? get_smart_fallback(prompt) : out;
+    if (out.empty() && !cancelled) {
+        return fallback();
+    }
+    return out;
 #endif
 }
 
@@ -240,8 +752,15 @@ std::string DirectGGUFInference::format_chat_prompt(const std::string& message,
     prompt << "You are a helpful AI programming assistant specialized in C++ development. ";
     prompt << "Provide clear, concise answers focused on coding help, debugging, and best practices.\n\n";
 
-    int history_limit = 6; // Last 3 exchanges
-    int start_idx = std::max(0, static_cast<int>(history.size()) - history_limit);
+    // At least the last 3 exchanges. The start only moves every
+    // history_limit entries, so the prompt is the previous one plus the
+    // new turn most of the time and the KV cache covers all but that.
+    int history_limit = 6;
+    int history_size = static_cast<int>(history.size());
+    int start_idx = 0;
+    if (history_size >= 2 * history_limit) {
+        start_idx = (history_size - history_limit) / history_limit * history_limit;
+    }
 
     for (int i = start_idx; i < static_cast<int>(history.size()); i++) {
         if (i % 2 == 0) {
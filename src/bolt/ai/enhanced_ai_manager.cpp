@@ -19,6 +19,7 @@ bool EnhancedAIManager::load_gguf_model(const std::string& model_path) {
     if (direct_inference_->load_model(model_path)) {
         use_direct_inference_ = true;
         current_provider_ = "direct_gguf";
+        apply_local_config(config_manager_->get_active_config());
         std::cout << "✅ GGUF model loaded successfully!" << std::endl;
         return true;
     }
@@ -48,6 +49,7 @@ bool EnhancedAIManager::auto_detect_models() {
     if (direct_inference_->is_loaded()) {
         use_direct_inference_ = true;
         current_provider_ = "direct_gguf";
+        apply_local_config(config_manager_->get_active_config());
         std::cout << "✅ Auto-detected and loaded GGUF model!" << std::endl;
         return true;
     }
@@ -73,6 +75,10 @@ EnhancedAIManager::EnhancedAIManager() {
         use_direct_inference_ = true;
         current_provider_ = "direct_gguf";
         std::cout << "✅ Direct GGUF model loaded - using direct inference!" << std::endl;
+        
+        // The active provider's sampling and draft settings apply locally too
+        config_manager_->load_config();
+        apply_local_config(config_manager_->get_active_config());
     } else {
         std::cout << "📋 No direct models found, loading HTTP providers..." << std::endl;
         
@@ -99,6 +105,7 @@ bool EnhancedAIManager::initialize_active_provider() {
     try {
         http_client_ = std::make_unique<bolt::ai::AIHttpClient>(config);
         current_provider_ = active_provider;
+        apply_local_config(config);
         
         std::cout << "🔄 Initialized AI provider: " << active_provider 
                   << " (" << config.base_url << ")" << std::endl;
@@ -111,14 +118,25 @@ bool EnhancedAIManager::initialize_active_provider() {
 }
 
 bolt::drawkern::AIInferenceResponse EnhancedAIManager::chat(const std::string& message, const std::string& session_id) {
+    return chat_stream(message, session_id, TokenCallback());
+}
+
+bolt::drawkern::AIInferenceResponse EnhancedAIManager::chat_stream(const std::string& message, const std::string& session_id,
+                                                                   const TokenCallback& on_token, const CancellationToken& cancel) {
+    return chat_with_priority(message, session_id, on_token, cancel, RequestPriority::Normal);
+}
+
+bolt::drawkern::AIInferenceResponse EnhancedAIManager::chat_with_priority(const std::string& message,
+                                                                          const std::string& session_id,
+                                                                          const TokenCallback& on_token,
+                                                                          const CancellationToken& cancel,
+                                                                          RequestPriority priority) {
     // Use direct GGUF inference if available and loaded
     if (use_direct_inference_ && direct_inference_ && direct_inference_->is_loaded()) {
-        std::vector<std::string> history;
-        if (!session_id.empty() && session_history_.find(session_id) != session_history_.end()) {
-            history = session_history_[session_id];
-        }
-        auto response = direct_inference_->chat(message, history);
+        std::vector<std::string> history = get_session_history(session_id);
+        auto response = direct_inference_->chat_stream(message, history, session_id, on_token, cancel, priority);
         if (!session_id.empty()) {
+            std::lock_guard<std::mutex> lock(mutex_);
             session_history_[session_id].push_back("Human: " + message);
             if (response.success) session_history_[session_id].push_back("AI: " + response.response);
         }
@@ -131,23 +149,30 @@ bolt::drawkern::AIInferenceResponse EnhancedAIManager::chat(const std::string& m
         bolt::drawkern::AIInferenceResponse response;
         response.success = true;
         response.response = "[RWKV stub] Model loaded: " + rwkv_model_path_ + ". Real RWKV generation will be added next phase.";
+        if (on_token) on_token(response.response);
         update_stats(response);
         return response;
     }
     
     // Try HTTP client
     if (http_client_) {
-        if (!session_id.empty()) session_history_[session_id].push_back("Human: " + message);
-        auto response = http_client_->chat(message, session_id);
-        if (!response.success && direct_inference_) {
+        if (!session_id.empty()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            session_history_[session_id].push_back("Human: " + message);
+        }
+        bool streamed = false;
+        auto response = http_client_->chat_stream(message, session_id, [&](const std::string& piece) {
+            streamed = true;
+            return !on_token || on_token(piece);
+        }, cancel);
+        // Fall back only when nothing reached the caller and it still wants a reply
+        if (!response.success && !streamed && !cancel.is_cancelled() && direct_inference_) {
             std::cout << "🔄 HTTP failed, using intelligent fallback..." << std::endl;
-            std::vector<std::string> history;
-            if (!session_id.empty() && session_history_.find(session_id) != session_history_.end()) {
-                history = session_history_[session_id];
-            }
-            response = direct_inference_->chat(message, history);
+            std::vector<std::string> history = get_session_history(session_id);
+            response = direct_inference_->chat_stream(message, history, session_id, on_token, cancel, priority);
         }
         if (response.success && !session_id.empty()) {
+            std::lock_guard<std::mutex> lock(mutex_);
             session_history_[session_id].push_back("AI: " + response.response);
             auto& history = session_history_[session_id];
             if (history.size() > 40) history.erase(history.begin(), history.begin() + (history.size() - 40));
@@ -158,12 +183,10 @@ bolt::drawkern::AIInferenceResponse EnhancedAIManager::chat(const std::string& m
     
     // Final fallback to direct inference (even without loaded model)
     if (direct_inference_) {
-        std::vector<std::string> history;
-        if (!session_id.empty() && session_history_.find(session_id) != session_history_.end()) {
-            history = session_history_[session_id];
-        }
-        auto response = direct_inference_->chat(message, history);
+        std::vector<std::string> history = get_session_history(session_id);
+        auto response = direct_inference_->chat_stream(message, history, session_id, on_token, cancel, priority);
         if (!session_id.empty()) {
+            std::lock_guard<std::mutex> lock(mutex_);
             session_history_[session_id].push_back("Human: " + message);
             if (response.success) session_history_[session_id].push_back("AI: " + response.response);
         }
@@ -179,6 +202,11 @@ bolt::drawkern::AIInferenceResponse EnhancedAIManager::chat(const std::string& m
 }
 
 bolt::drawkern::AIInferenceResponse EnhancedAIManager::complete_code(const std::string& code, const std::string& language) {
+    if (has_direct_model()) {
+        auto response = direct_inference_->complete_code(code);
+        update_stats(response);
+        return response;
+    }
     if (!http_client_) {
         bolt::drawkern::AIInferenceResponse error_response;
         error_response.error = "No AI provider initialized";
@@ -193,7 +221,9 @@ bolt::drawkern::AIInferenceResponse EnhancedAIManager::complete_code(const std::
 bolt::drawkern::AIInferenceResponse EnhancedAIManager::analyze_code(const std::string& code, const std::string& language) {
     std::string analysis_prompt = "Please analyze this " + language + " code and provide feedback:\n\n" + code + 
                                  "\n\nPlease provide:\n1. Code quality assessment\n2. Potential improvements\n3. Any bugs or issues\n4. Best practices suggestions";
-    return chat(analysis_prompt, "analysis_session");
+    // Analysis runs in the background, behind chat and completion
+    return chat_with_priority(analysis_prompt, "analysis_session", TokenCallback(), CancellationToken(),
+                              RequestPriority::Background);
 }
 
 bool EnhancedAIManager::switch_provider(const std::string& provider_name) {
@@ -255,16 +285,26 @@ std::vector<bolt::ai::ProviderInfo> EnhancedAIManager::list_providers() const {
 }
 
 void EnhancedAIManager::create_session(const std::string& session_id) {
-    session_history_[session_id] = {};
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        session_history_[session_id] = {};
+    }
     std::cout << "📝 Created AI session: " << session_id << std::endl;
 }
 
 void EnhancedAIManager::destroy_session(const std::string& session_id) {
-    session_history_.erase(session_id);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        session_history_.erase(session_id);
+    }
+    if (direct_inference_) {
+        direct_inference_->drop_session(session_id);
+    }
     std::cout << "🗑️  Destroyed AI session: " << session_id << std::endl;
 }
 
 std::vector<std::string> EnhancedAIManager::list_sessions() const {
+    std::lock_guard<std::mutex> lock(mutex_);
     std::vector<std::string> sessions;
     for (const auto& [session_id, history] : session_history_) {
         sessions.push_back(session_id);
@@ -273,6 +313,7 @@ std::vector<std::string> EnhancedAIManager::list_sessions() const {
 }
 
 std::vector<std::string> EnhancedAIManager::get_session_history(const std::string& session_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
     auto it = session_history_.find(session_id);
     if (it != session_history_.end()) {
         return it->second;
@@ -281,16 +322,26 @@ std::vector<std::string> EnhancedAIManager::get_session_history(const std::strin
 }
 
 void EnhancedAIManager::clear_session_history(const std::string& session_id) {
-    session_history_[session_id].clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        session_history_[session_id].clear();
+    }
+    if (direct_inference_) {
+        direct_inference_->drop_session(session_id);
+    }
     std::cout << "🧹 Cleared history for session: " << session_id << std::endl;
 }
 
 bolt::ai::AIStats EnhancedAIManager::get_statistics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
     return stats_;
 }
 
 void EnhancedAIManager::reset_statistics() {
-    stats_ = bolt::ai::AIStats{};
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_ = bolt::ai::AIStats{};
+    }
     std::cout << "🔄 Reset AI statistics" << std::endl;
 }
 
@@ -300,6 +351,36 @@ void EnhancedAIManager::update_config(const bolt::ai::AIHttpConfig& config) {
         config_manager_->add_provider(current_provider_, config);
         std::cout << "🔄 Updated configuration for provider: " << current_provider_ << std::endl;
     }
+    apply_local_config(config);
+}
+
+void EnhancedAIManager::apply_local_config(const bolt::ai::AIHttpConfig& config) {
+    if (!direct_inference_) {
+        return;
+    }
+    // Local generation follows the same sampling settings
+    bolt::ai::SamplerParams params = direct_inference_->sampler_params();
+    params.temperature = config.temperature;
+    params.top_p = config.top_p;
+    direct_inference_->set_sampler_params(params);
+    
+    direct_inference_->set_draft_tokens(config.draft_tokens);
+    if (config.draft_model_path.empty()) {
+        direct_inference_->unload_draft_model();
+    } else if (direct_inference_->is_loaded()) {
+        direct_inference_->load_draft_model(config.draft_model_path);
+    }
+    
+    // Concurrent requests share decode steps once slots are configured
+    auto engine = direct_inference_->engine();
+    if (config.inference_slots <= 0) {
+        direct_inference_->disable_engine();
+    } else if (direct_inference_->is_loaded() &&
+               (!engine || engine->slots() != static_cast<size_t>(config.inference_slots))) {
+        bolt::ai::EngineConfig engine_config;
+        engine_config.slots = static_cast<size_t>(config.inference_slots);
+        direct_inference_->enable_engine(engine_config);
+    }
 }
 
 bool EnhancedAIManager::is_ready() const {
@@ -318,6 +399,7 @@ bolt::ai::AIHttpConfig EnhancedAIManager::get_current_config() const {
 }
 
 void EnhancedAIManager::update_stats(const bolt::drawkern::AIInferenceResponse& response) {
+    std::lock_guard<std::mutex> lock(mutex_);
     stats_.total_requests++;
     if (response.success) {
         stats_.successful_requests++;
@@ -0,0 +1,469 @@
+#include "bolt/ai/inference_engine.hpp"
+#include "bolt/ai/direct_gguf_inference.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace bolt {
+namespace ai {
+
+struct InferenceEngine::Sequence {
+    EngineRequest request;
+    std::promise<drawkern::AIInferenceResponse> promise;
+    std::vector<int32_t> tokens;   // Prompt, then generated; the last is not decoded yet
+    size_t prompt_size = 0;
+    size_t generated = 0;
+    std::string text;
+    TokenSampler sampler;
+    bool prepared = false;         // Tokenized and sampler set up on first admission
+    uint64_t order = 0;
+    int admitted_priority = 0;     // Effective priority when it took its slot
+    std::chrono::steady_clock::time_point submitted;
+    std::chrono::steady_clock::time_point waiting_since;
+};
+
+struct InferenceEngine::Slot {
+    KVPrefixCache cache;           // What the model holds for this slot
+    std::unique_ptr<Sequence> sequence;
+};
+
+namespace {
+
+// Tokens of one sequence in the current step
+struct Work {
+    size_t slot;
+    size_t start;
+    size_t count;
+    size_t logits_entry;
+    bool logits;
+};
+
+size_t common_prefix(const std::vector<int32_t>& a, const std::vector<int32_t>& b) {
+    size_t limit = std::min(a.size(), b.size());
+    return std::mismatch(a.begin(), a.begin() + limit, b.begin()).first - a.begin();
+}
+
+} // namespace
+
+InferenceEngine::InferenceEngine(std::unique_ptr<BatchedModel> model, const EngineConfig& config)
+    : model_(std::move(model)), config_(config) {
+    // Every generating sequence must fit in one decode
+    config_.slots = std::max<size_t>(1, std::min(config_.slots, model_->max_batch()));
+    config_.prefill_chunk = std::max<size_t>(1, config_.prefill_chunk);
+    slots_.resize(config_.slots);
+    worker_ = std::thread(&InferenceEngine::run, this);
+}
+
+InferenceEngine::~InferenceEngine() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_cv_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+std::future<drawkern::AIInferenceResponse> InferenceEngine::submit(EngineRequest request) {
+    auto sequence = std::make_unique<Sequence>();
+    sequence->request = std::move(request);
+    sequence->submitted = std::chrono::steady_clock::now();
+    sequence->waiting_since = sequence->submitted;
+    auto future = sequence->promise.get_future();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopping_) {
+        lock.unlock();
+        complete(std::move(sequence), false, "Inference engine stopped");
+        return future;
+    }
+    sequence->order = next_order_++;
+    queue_.push_back(std::move(sequence));
+    lock.unlock();
+    work_cv_.notify_one();
+    return future;
+}
+
+EngineStats InferenceEngine::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    EngineStats stats = stats_;
+    stats.queued = queue_.size();
+    stats.running = running_;
+    return stats;
+}
+
+size_t InferenceEngine::slots() const {
+    return slots_.size();
+}
+
+void InferenceEngine::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_cv_.wait(lock, [this] { return stopping_ || !queue_.empty() || running_ > 0; });
+            if (stopping_) {
+                break;
+            }
+        }
+        admit();
+        step();
+    }
+
+    std::deque<std::unique_ptr<Sequence>> queued;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued.swap(queue_);
+    }
+    for (auto& sequence : queued) {
+        complete(std::move(sequence), false, "Inference engine stopped");
+    }
+    for (auto& slot : slots_) {
+        if (slot.sequence) {
+            finish(slot, false, "Inference engine stopped");
+        }
+    }
+}
+
+int InferenceEngine::effective_priority(const Sequence& sequence, std::chrono::steady_clock::time_point now) const {
+    int level = static_cast<int>(sequence.request.priority);
+    if (config_.aging.count() > 0) {
+        level += static_cast<int>((now - sequence.waiting_since) / config_.aging);
+    }
+    return level;
+}
+
+void InferenceEngine::admit() {
+    std::vector<std::pair<std::unique_ptr<Sequence>, std::string>> rejected;
+    auto now = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    for (auto it = queue_.begin(); it != queue_.end();) {
+        if ((*it)->request.cancel.is_cancelled()) {
+            rejected.emplace_back(std::move(*it), CANCELLED_ERROR);
+            it = queue_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    while (!queue_.empty()) {
+        // Highest effective priority, oldest first
+        auto best = std::min_element(queue_.begin(), queue_.end(), [&](const auto& a, const auto& b) {
+            int pa = effective_priority(*a, now);
+            int pb = effective_priority(*b, now);
+            return pa != pb ? pa > pb : a->order < b->order;
+        });
+        Sequence& candidate = **best;
+
+        bool has_free = std::any_of(slots_.begin(), slots_.end(), [](const Slot& s) { return !s.sequence; });
+        if (!has_free) {
+            // Preempt the newest of the lowest-priority running sequences,
+            // if it was admitted below the candidate's effective priority
+            Slot* victim = nullptr;
+            for (auto& slot : slots_) {
+                if (!victim || slot.sequence->admitted_priority < victim->sequence->admitted_priority ||
+                    (slot.sequence->admitted_priority == victim->sequence->admitted_priority &&
+                     slot.sequence->order > victim->sequence->order)) {
+                    victim = &slot;
+                }
+            }
+            if (victim->sequence->admitted_priority >= effective_priority(candidate, now)) {
+                break;
+            }
+            victim->sequence->waiting_since = now;
+            queue_.push_back(std::move(victim->sequence));
+            --running_;
+            ++stats_.preempted;
+            // push_back may have moved the candidate's iterator
+            continue;
+        }
+
+        std::unique_ptr<Sequence> sequence = std::move(*best);
+        queue_.erase(best);
+        sequence->admitted_priority = effective_priority(*sequence, now);
+
+        if (!sequence->prepared) {
+            sequence->tokens = model_->tokenize(sequence->request.prompt);
+            sequence->prompt_size = sequence->tokens.size();
+            if (sequence->tokens.empty()) {
+                rejected.emplace_back(std::move(sequence), "Empty prompt");
+                continue;
+            }
+            if (sequence->tokens.size() >= model_->slot_context()) {
+                rejected.emplace_back(std::move(sequence), "Prompt exceeds the slot context");
+                continue;
+            }
+            sequence->sampler.set_params(sequence->request.sampling);
+            if (sequence->request.grammar) {
+                sequence->sampler.set_grammar(sequence->request.grammar.get(),
+                                              [this](int32_t token) { return model_->token_text(token); });
+            }
+            sequence->sampler.add_history(sequence->tokens.data(), sequence->tokens.size());
+            sequence->prepared = true;
+        }
+
+        // The free slot already holding most of this sequence
+        size_t chosen = slots_.size();
+        size_t best_prefix = 0;
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            if (slots_[i].sequence) {
+                continue;
+            }
+            size_t prefix = common_prefix(slots_[i].cache.tokens(), sequence->tokens);
+            if (chosen == slots_.size() || prefix > best_prefix) {
+                chosen = i;
+                best_prefix = prefix;
+            }
+        }
+        Slot& slot = slots_[chosen];
+        size_t keep = slot.cache.reuse(sequence->tokens);
+        model_->evict(static_cast<int32_t>(chosen), keep);
+        stats_.reused_tokens += keep;
+        slot.sequence = std::move(sequence);
+        ++running_;
+    }
+    lock.unlock();
+
+    for (auto& [sequence, error] : rejected) {
+        complete(std::move(sequence), false, error);
+    }
+}
+
+bool InferenceEngine::step() {
+    for (auto& slot : slots_) {
+        if (slot.sequence && slot.sequence->request.cancel.is_cancelled()) {
+            finish(slot, false, CANCELLED_ERROR);
+        }
+    }
+
+    // Generating sequences first, one token each, then prompt chunks in
+    // priority order while the batch has room
+    std::vector<size_t> order;
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        if (slots_[i].sequence) {
+            order.push_back(i);
+        }
+    }
+    auto remaining = [this](size_t i) { return slots_[i].sequence->tokens.size() - slots_[i].cache.size(); };
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        bool da = remaining(a) == 1;
+        bool db = remaining(b) == 1;
+        if (da != db) {
+            return da;
+        }
+        const Sequence& sa = *slots_[a].sequence;
+        const Sequence& sb = *slots_[b].sequence;
+        return sa.request.priority != sb.request.priority ? sa.request.priority > sb.request.priority
+                                                          : sa.order < sb.order;
+    });
+
+    std::vector<BatchedModel::Entry> batch;
+    std::vector<Work> work;
+    size_t budget = model_->max_batch();
+    size_t prompt_tokens = 0;
+    for (size_t i : order) {
+        Slot& slot = slots_[i];
+        const Sequence& sequence = *slot.sequence;
+        size_t start = slot.cache.size();
+        size_t count = std::min(remaining(i), budget);
+        if (remaining(i) > 1) {
+            count = std::min(count, config_.prefill_chunk);
+        }
+        if (count == 0) {
+            break;
+        }
+        bool logits = start + count == sequence.tokens.size();
+        for (size_t j = 0; j < count; ++j) {
+            batch.push_back({sequence.tokens[start + j], static_cast<int32_t>(start + j), static_cast<int32_t>(i),
+                             logits && j + 1 == count});
+            if (start + j < sequence.prompt_size) {
+                ++prompt_tokens;
+            }
+        }
+        work.push_back({i, start, count, batch.size() - 1, logits});
+        budget -= count;
+    }
+    if (batch.empty()) {
+        return false;
+    }
+
+    if (!model_->decode(batch)) {
+        std::cout << "❌ Batched decode failed for " << work.size() << " sequences" << std::endl;
+        for (const auto& w : work) {
+            slots_[w.slot].cache.clear();
+            model_->evict(static_cast<int32_t>(w.slot), 0);
+            finish(slots_[w.slot], false, "Batched decode failed");
+        }
+        return false;
+    }
+
+    // Stats land before any future resolves, so callers see this step
+    std::vector<std::pair<size_t, std::string>> done;
+    std::vector<size_t> succeeded;
+    size_t generated = 0;
+    for (const auto& w : work) {
+        Slot& slot = slots_[w.slot];
+        Sequence& sequence = *slot.sequence;
+        slot.cache.append(sequence.tokens.data() + w.start, w.count);
+        if (!w.logits) {
+            continue;
+        }
+
+        int32_t token = sequence.sampler.sample(model_->logits(w.logits_entry), model_->n_vocab());
+        if (token < 0 || token == model_->eos()) {
+            succeeded.push_back(w.slot);
+            continue;
+        }
+        std::string piece = model_->token_text(token);
+        sequence.tokens.push_back(token);
+        sequence.text += piece;
+        ++sequence.generated;
+        ++generated;
+
+        if (sequence.request.on_token && !piece.empty() && !sequence.request.on_token(piece)) {
+            done.emplace_back(w.slot, CANCELLED_ERROR);
+        } else if (sequence.generated >= static_cast<size_t>(std::max(0, sequence.request.max_tokens)) ||
+                   sequence.tokens.size() >= model_->slot_context()) {
+            succeeded.push_back(w.slot);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.steps;
+        stats_.batch_entries += batch.size();
+        stats_.prompt_tokens += prompt_tokens;
+        stats_.generated_tokens += generated;
+    }
+    for (size_t i : succeeded) {
+        finish(slots_[i], true, "");
+    }
+    for (const auto& [i, error] : done) {
+        finish(slots_[i], false, error);
+    }
+    return true;
+}
+
+void InferenceEngine::finish(Slot& slot, bool success, const std::string& error) {
+    // The slot keeps its cache for a later request sharing the prefix
+    std::unique_ptr<Sequence> sequence = std::move(slot.sequence);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --running_;
+    }
+    complete(std::move(sequence), success, error);
+}
+
+void InferenceEngine::complete(std::unique_ptr<Sequence> sequence, bool success, const std::string& error) {
+    drawkern::AIInferenceResponse response;
+    response.response = sequence->text;
+    response.success = success;
+    response.error = error;
+    response.tokens_generated = static_cast<int32_t>(sequence->generated);
+    response.tokens_processed = static_cast<int32_t>(sequence->prompt_size);
+    response.inference_time_ms =
+        std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - sequence->submitted).count();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.completed;
+    }
+    sequence->promise.set_value(std::move(response));
+}
+
+// EngineAIModel implementation
+EngineAIModel::EngineAIModel(std::shared_ptr<InferenceEngine> engine, const drawkern::AIModelConfig& config)
+    : AIModel(config), engine_(std::move(engine)) {}
+
+bool EngineAIModel::load() {
+    loaded_ = engine_ != nullptr;
+    return loaded_;
+}
+
+void EngineAIModel::unload() {
+    loaded_ = false;
+}
+
+std::future<drawkern::AIInferenceResponse> EngineAIModel::start(const drawkern::AIInferenceRequest& request) {
+    if (!loaded_) {
+        std::promise<drawkern::AIInferenceResponse> failed;
+        drawkern::AIInferenceResponse response;
+        response.error = "Model not loaded";
+        failed.set_value(response);
+        return failed.get_future();
+    }
+
+    auto parameter = [&](const char* name, float fallback) {
+        auto it = request.parameters.find(name);
+        return it != request.parameters.end() ? it->second : fallback;
+    };
+
+    EngineRequest engine_request;
+    engine_request.prompt = request.context.empty() ? request.prompt : request.context + "\n\n" + request.prompt;
+    engine_request.max_tokens = static_cast<int>(parameter("max_tokens", static_cast<float>(config_.max_tokens)));
+    engine_request.sampling.temperature = parameter("temperature", config_.temperature);
+    engine_request.sampling.top_p = parameter("top_p", config_.top_p);
+    engine_request.sampling.top_k = static_cast<int32_t>(parameter("top_k", static_cast<float>(config_.top_k)));
+    if (request.task_type == "completion") {
+        engine_request.priority = RequestPriority::Interactive;
+    } else if (request.task_type == "analysis") {
+        engine_request.priority = RequestPriority::Background;
+    }
+    return engine_->submit(std::move(engine_request));
+}
+
+drawkern::AIInferenceResponse EngineAIModel::generate(const drawkern::AIInferenceRequest& request) {
+    drawkern::AIInferenceResponse response = start(request).get();
+    response.vm_id = request.vm_id;
+    response.session_id = request.session_id;
+    return response;
+}
+
+std::vector<drawkern::AIInferenceResponse> EngineAIModel::generate_batch(
+    const std::vector<drawkern::AIInferenceRequest>& requests) {
+    // Submitted together, so they share decode steps with each other and
+    // with whatever the engine is already running
+    std::vector<std::future<drawkern::AIInferenceResponse>> pending;
+    pending.reserve(requests.size());
+    for (const auto& request : requests) {
+        pending.push_back(start(request));
+    }
+
+    std::vector<drawkern::AIInferenceResponse> responses;
+    responses.reserve(requests.size());
+    for (size_t i = 0; i < requests.size(); ++i) {
+        responses.push_back(pending[i].get());
+        responses.back().vm_id = requests[i].vm_id;
+        responses.back().session_id = requests[i].session_id;
+    }
+    return responses;
+}
+
+drawkern::AIInferenceResponse EngineAIModel::chat(const std::string& message, const std::string& context) {
+    drawkern::AIInferenceRequest request;
+    request.prompt = message;
+    request.context = context;
+    request.task_type = "chat";
+    return generate(request);
+}
+
+drawkern::AIInferenceResponse EngineAIModel::complete_code(const std::string& code, const std::string& language) {
+    drawkern::AIInferenceRequest request;
+    request.prompt = code;
+    request.task_type = "completion";
+    return generate(request);
+}
+
+std::string EngineAIModel::get_model_info() const {
+    std::string info = "Continuous batching engine: " + config_.model_name;
+    if (engine_) {
+        info += " (" + std::to_string(engine_->slots()) + " sequence slots)";
+    }
+    return info;
+}
+
+std::vector<std::string> EngineAIModel::get_capabilities() const {
+    return {"text_generation", "chat", "code_completion", "analysis", "batching"};
+}
+
+} // namespace ai
+} // namespace bolt
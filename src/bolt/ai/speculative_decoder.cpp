@@ -0,0 +1,106 @@
+#include "bolt/ai/speculative_decoder.hpp"
+#include <algorithm>
+
+namespace bolt {
+namespace ai {
+
+SpeculativeDecoder::SpeculativeDecoder(SpeculativeModel& target, SpeculativeModel& draft, TokenSampler& sampler,
+                                       size_t draft_tokens)
+    : target_(target), draft_(draft), sampler_(sampler), draft_tokens_(draft_tokens) {}
+
+size_t SpeculativeDecoder::generate(std::vector<int32_t>& tokens, size_t max_tokens, int32_t eos,
+                                    const TokenHandler& on_token) {
+    size_t produced = 0;
+    if (tokens.empty()) {
+        return 0;
+    }
+
+    while (produced < max_tokens) {
+        // The last token is always left for this pass to decode
+        if (target_.length() >= tokens.size()) {
+            target_.truncate(tokens.size() - 1);
+        }
+        propose(tokens, eos);
+        // Room for the accepted proposals plus the target's own token
+        proposals_.resize(std::min(proposals_.size(), max_tokens - produced - 1));
+
+        // One target pass over what it has not seen and every proposal;
+        // logits start at the last known token
+        size_t base = tokens.size();
+        size_t have = target_.length();
+        batch_.assign(tokens.begin() + have, tokens.end());
+        batch_.insert(batch_.end(), proposals_.begin(), proposals_.end());
+        if (!target_.decode(batch_.data(), batch_.size(), base - 1 - have)) {
+            target_.truncate(have);
+            break;
+        }
+        ++stats_.rounds;
+        stats_.drafted += proposals_.size();
+
+        size_t accepted = 0;
+        bool stop = false;
+        for (size_t i = 0; i <= proposals_.size(); ++i) {
+            int32_t token = sampler_.sample(target_.logits(i), target_.n_vocab());
+            if (token < 0 || token == eos) {
+                stop = true;
+                break;
+            }
+            bool match = i < proposals_.size() && token == proposals_[i];
+            tokens.push_back(token);
+            ++produced;
+            ++stats_.generated;
+            if (match) {
+                ++accepted;
+            }
+            if ((on_token && !on_token(token)) || produced >= max_tokens) {
+                stop = true;
+                break;
+            }
+            if (!match) {
+                break;
+            }
+        }
+        stats_.accepted += accepted;
+
+        // Both models drop the proposals that were turned down
+        target_.truncate(std::min(target_.length(), base + accepted));
+        draft_.truncate(std::min(draft_.length(), base + accepted));
+        if (stop) {
+            break;
+        }
+    }
+    return produced;
+}
+
+void SpeculativeDecoder::propose(const std::vector<int32_t>& tokens, int32_t eos) {
+    proposals_.clear();
+    if (draft_tokens_ == 0) {
+        return;
+    }
+
+    // Catch the draft up with the sequence, then extend it greedily
+    size_t have = std::min(draft_.length(), tokens.size() - 1);
+    draft_.truncate(have);
+    size_t count = tokens.size() - have;
+    if (!draft_.decode(tokens.data() + have, count, count - 1)) {
+        draft_.truncate(have);
+        return;
+    }
+
+    const size_t n_vocab = draft_.n_vocab();
+    for (size_t i = 0; i < draft_tokens_; ++i) {
+        const float* row = draft_.logits(0);
+        int32_t token = static_cast<int32_t>(std::max_element(row, row + n_vocab) - row);
+        if (token == eos) {
+            break;
+        }
+        proposals_.push_back(token);
+        // The last proposal is only decoded by the target
+        if (i + 1 == draft_tokens_ || !draft_.decode(&token, 1, 0)) {
+            break;
+        }
+    }
+}
+
+} // namespace ai
+} // namespace bolt
@@ -0,0 +1,310 @@
+#include "bolt/ai/token_sampler.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+
+namespace bolt {
+namespace ai {
+
+namespace {
+
+char opener_of(char closer) {
+    switch (closer) {
+        case ')': return '(';
+        case ']': return '[';
+        case '}': return '{';
+        default: return 0;
+    }
+}
+
+} // namespace
+
+bool BalancedCodeGrammar::allows(std::string_view piece) const {
+    State state = state_;
+    for (char c : piece) {
+        if (!advance(state, c, true)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BalancedCodeGrammar::accept(std::string_view piece) {
+    for (char c : piece) {
+        advance(state_, c, false);
+    }
+}
+
+bool BalancedCodeGrammar::advance(State& state, char c, bool strict) {
+    char prev = state.prev;
+    state.prev = c;
+
+    if (state.line_comment) {
+        state.line_comment = c != '\n';
+        return true;
+    }
+    if (state.block_comment) {
+        if (prev == '*' && c == '/') {
+            state.block_comment = false;
+            state.prev = 0;
+        }
+        return true;
+    }
+    if (state.quote) {
+        if (state.escape) {
+            state.escape = false;
+        } else if (c == '\\') {
+            state.escape = true;
+        } else if (c == state.quote || c == '\n') {
+            state.quote = 0;
+        }
+        return true;
+    }
+
+    if (prev == '/' && (c == '/' || c == '*')) {
+        state.line_comment = c == '/';
+        state.block_comment = c == '*';
+        state.prev = 0;
+        return true;
+    }
+
+    switch (c) {
+        case '"':
+            state.quote = c;
+            break;
+        case '\'':
+            // Not after a digit or letter: 1'000 and don't
+            if (!std::isalnum(static_cast<unsigned char>(prev))) {
+                state.quote = c;
+            }
+            break;
+        case '(':
+        case '[':
+        case '{':
+            state.open.push_back(c);
+            break;
+        case ')':
+        case ']':
+        case '}':
+            if (!state.open.empty() && state.open.back() == opener_of(c)) {
+                state.open.pop_back();
+            } else if (strict) {
+                return false;
+            }
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+TokenSampler::TokenSampler(const SamplerParams& params)
+    : params_(params), rng_(params.seed) {}
+
+void TokenSampler::set_params(const SamplerParams& params) {
+    // Keep the random sequence going unless the seed itself changed
+    if (params.seed != params_.seed) {
+        rng_.seed(params.seed);
+    }
+    if (params.repeat_last_n != params_.repeat_last_n) {
+        history_.clear();
+        history_next_ = 0;
+    }
+    params_ = params;
+}
+
+void TokenSampler::set_grammar(SamplingGrammar* grammar, TokenText token_text) {
+    grammar_ = grammar;
+    token_text_ = std::move(token_text);
+}
+
+int32_t TokenSampler::sample(float* logits, size_t n_vocab) {
+    if (n_vocab == 0) {
+        return -1;
+    }
+    apply_penalty(logits, n_vocab);
+    select_top_k(logits, n_vocab);
+    size_t count = params_.temperature > 0.0f ? truncate() : candidates_.size();
+
+    int32_t token = choose(count);
+    if (token >= 0) {
+        remember(token);
+        if (grammar_) {
+            grammar_->accept(piece_);
+        }
+    }
+    return token;
+}
+
+void TokenSampler::add_history(const int32_t* tokens, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        remember(tokens[i]);
+    }
+}
+
+void TokenSampler::reset() {
+    history_.clear();
+    history_next_ = 0;
+}
+
+bool TokenSampler::allowed(int32_t token) {
+    if (!grammar_) {
+        return true;
+    }
+    piece_ = token_text_ ? token_text_(token) : std::string();
+    return grammar_->allows(piece_);
+}
+
+void TokenSampler::remember(int32_t token) {
+    size_t window = params_.repeat_last_n > 0 ? static_cast<size_t>(params_.repeat_last_n) : 0;
+    if (window == 0) {
+        return;
+    }
+    if (history_.size() < window) {
+        history_.push_back(token);
+        return;
+    }
+    history_[history_next_] = token;
+    history_next_ = (history_next_ + 1) % window;
+}
+
+void TokenSampler::apply_penalty(float* logits, size_t n_vocab) {
+    float penalty = params_.repeat_penalty;
+    if (penalty == 1.0f || penalty <= 0.0f || history_.empty()) {
+        return;
+    }
+    // Each token in the window is penalized once however often it appears
+    penalized_.assign(history_.begin(), history_.end());
+    std::sort(penalized_.begin(), penalized_.end());
+    penalized_.erase(std::unique(penalized_.begin(), penalized_.end()), penalized_.end());
+    for (int32_t token : penalized_) {
+        if (token < 0 || static_cast<size_t>(token) >= n_vocab) {
+            continue;
+        }
+        float& logit = logits[token];
+        logit = logit > 0.0f ? logit / penalty : logit * penalty;
+    }
+}
+
+void TokenSampler::select_top_k(const float* logits, size_t n_vocab) {
+    size_t k = params_.top_k > 0 ? std::min(static_cast<size_t>(params_.top_k), n_vocab) : n_vocab;
+    auto better = [](const Candidate& a, const Candidate& b) { return a.logit > b.logit; };
+
+    candidates_.clear();
+    if (k == n_vocab) {
+        for (size_t id = 0; id < n_vocab; ++id) {
+            candidates_.push_back({static_cast<int32_t>(id), logits[id], 0.0f});
+        }
+        std::sort(candidates_.begin(), candidates_.end(), better);
+        return;
+    }
+
+    // Min-heap of the best k so far; most logits fail the floor comparison
+    for (size_t id = 0; id < k; ++id) {
+        candidates_.push_back({static_cast<int32_t>(id), logits[id], 0.0f});
+    }
+    std::make_heap(candidates_.begin(), candidates_.end(), better);
+    float floor = candidates_.front().logit;
+    for (size_t id = k; id < n_vocab; ++id) {
+        if (logits[id] <= floor) {
+            continue;
+        }
+        std::pop_heap(candidates_.begin(), candidates_.end(), better);
+        candidates_.back() = {static_cast<int32_t>(id), logits[id], 0.0f};
+        std::push_heap(candidates_.begin(), candidates_.end(), better);
+        floor = candidates_.front().logit;
+    }
+    std::sort_heap(candidates_.begin(), candidates_.end(), better);
+}
+
+size_t TokenSampler::truncate() {
+    size_t count = candidates_.size();
+    if (count == 0) {
+        return 0;
+    }
+
+    // Temperature and softmax numerators, relative to the best logit
+    const float scale = 1.0f / params_.temperature;
+    const float best = candidates_.front().logit;
+    for (auto& candidate : candidates_) {
+        candidate.p = std::exp((candidate.logit - best) * scale);
+    }
+
+    // Min-p: the best candidate has p == 1
+    if (params_.min_p > 0.0f) {
+        size_t keep = 1;
+        while (keep < count && candidates_[keep].p >= params_.min_p) {
+            ++keep;
+        }
+        count = keep;
+    }
+
+    // Top-p over what min-p kept
+    if (params_.top_p > 0.0f && params_.top_p < 1.0f) {
+        float total = 0.0f;
+        for (size_t i = 0; i < count; ++i) {
+            total += candidates_[i].p;
+        }
+        float target = params_.top_p * total;
+        float cumulative = 0.0f;
+        for (size_t i = 0; i < count; ++i) {
+            cumulative += candidates_[i].p;
+            if (cumulative >= target) {
+                count = i + 1;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+int32_t TokenSampler::choose(size_t count) {
+    if (params_.temperature <= 0.0f) {
+        for (const auto& candidate : candidates_) {
+            if (allowed(candidate.id)) {
+                return candidate.id;
+            }
+        }
+        return -1;
+    }
+
+    float total = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        total += candidates_[i].p;
+    }
+
+    // Draw, and redraw without a candidate the grammar turned down
+    while (total > 0.0f) {
+        float r = std::uniform_real_distribution<float>(0.0f, total)(rng_);
+        size_t pick = count;
+        for (size_t i = 0; i < count; ++i) {
+            if (candidates_[i].p <= 0.0f) {
+                continue;
+            }
+            pick = i;
+            r -= candidates_[i].p;
+            if (r < 0.0f) {
+                break;
+            }
+        }
+        if (pick == count) {
+            break;
+        }
+        if (allowed(candidates_[pick].id)) {
+            return candidates_[pick].id;
+        }
+        total -= candidates_[pick].p;
+        candidates_[pick].p = 0.0f;
+    }
+
+    // Everything kept was rejected; try the rest of the top k in order
+    for (size_t i = count; i < candidates_.size(); ++i) {
+        if (allowed(candidates_[i].id)) {
+            return candidates_[i].id;
+        }
+    }
+    return -1;
+}
+
+} // namespace ai
+} // namespace bolt
@@ -0,0 +1,10 @@
+#include "bolt/collaboration/document_store.hpp"
+
+namespace bolt {
+namespace collaboration {
+
+// All implementation is in the header for template-heavy classes
+// This file exists to ensure proper compilation and linking
+
+} // namespace collaboration
+} // namespace bolt
\ No newline at end of file
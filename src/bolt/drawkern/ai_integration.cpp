@@ -3,6 +3,7 @@
 #include "bolt/drawkern/styx_protocol.hpp"
 #include "bolt/drawkern/yacc_grammar.hpp"
 #include <iostream>
+#include <algorithm>
 #include <chrono>
 #include <thread>
 #include <sstream>
@@ -20,6 +21,15 @@ AIModel::~AIModel() {
     loaded_ = false;
 }
 
+std::vector<AIInferenceResponse> AIModel::generate_batch(const std::vector<AIInferenceRequest>& requests) {
+    std::vector<AIInferenceResponse> responses;
+    responses.reserve(requests.size());
+    for (const auto& request : requests) {
+        responses.push_back(generate(request));
+    }
+    return responses;
+}
+
 // GGMLModel implementation
 GGMLModel::GGMLModel(const AIModelConfig& config) : AIModel(config) {
 }
@@ -329,73 +339,137 @@ DrawKernAIManager::DrawKernAIManager() {
 }
 
 DrawKernAIManager::~DrawKernAIManager() {
-    // Unload all models
-    for (auto& [model_id, model] : models_) {
-        model->unload();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    queue_cv_.notify_all();
+    if (dispatcher_.joinable()) {
+        dispatcher_.join();
+    }
+    
+    // Fail whatever is still queued, then unload all models
+    std::vector<PendingRequest> abandoned;
+    for (auto& [model_id, slot] : models_) {
+        for (auto& pending : slot->queue) {
+            abandoned.push_back(std::move(pending));
+        }
+        slot->queue.clear();
+    }
+    for (auto& pending : abandoned) {
+        AIInferenceResponse response;
+        response.error = "AI manager shut down";
+        response.vm_id = pending.request.vm_id;
+        response.session_id = pending.request.session_id;
+        pending.completion(response);
+    }
+    for (auto& [model_id, slot] : models_) {
+        slot->model->unload();
     }
 }
 
 bool DrawKernAIManager::load_model(const std::string& model_id, const AIModelConfig& config) {
-    if (models_.count(model_id)) {
+    if (find_slot(model_id)) {
         std::cout << "Model " << model_id << " already loaded" << std::endl;
         return true;
     }
     
     auto model = create_model(config);
+    if (!model) {
+        std::cerr << "Failed to load model: " << model_id << std::endl;
+        return false;
+    }
+    return load_model(model_id, std::move(model));
+}
+
+bool DrawKernAIManager::load_model(const std::string& model_id, std::unique_ptr<AIModel> model) {
     if (!model || !model->load()) {
         std::cerr << "Failed to load model: " << model_id << std::endl;
         return false;
     }
     
-    models_[model_id] = std::move(model);
-    model_stats_[model_id] = ModelStats{model_id};
+    auto slot = std::make_shared<ModelSlot>();
+    slot->model = std::move(model);
+    slot->stats.model_id = model_id;
+    std::string model_type = slot->model->get_config().model_type;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (models_.count(model_id)) {
+            std::cout << "Model " << model_id << " already loaded" << std::endl;
+            return true;
+        }
+        models_[model_id] = std::move(slot);
+    }
     
-    std::cout << "Loaded model: " << model_id << " (type: " << config.model_type << ")" << std::endl;
+    std::cout << "Loaded model: " << model_id << " (type: " << model_type << ")" << std::endl;
     return true;
 }
 
 bool DrawKernAIManager::unload_model(const std::string& model_id) {
-    auto it = models_.find(model_id);
-    if (it == models_.end()) {
-        return false;
+    std::shared_ptr<ModelSlot> slot;
+    std::deque<PendingRequest> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = models_.find(model_id);
+        if (it == models_.end()) {
+            return false;
+        }
+        slot = std::move(it->second);
+        models_.erase(it);
+        abandoned.swap(slot->queue);
     }
     
-    it->second->unload();
-    models_.erase(it);
-    model_stats_.erase(model_id);
+    for (auto& pending : abandoned) {
+        AIInferenceResponse response;
+        response.error = "Model unloaded: " + model_id;
+        response.vm_id = pending.request.vm_id;
+        response.session_id = pending.request.session_id;
+        pending.completion(response);
+    }
+    
+    // Waits for a batch the dispatcher is running on this model
+    {
+        std::lock_guard<std::mutex> lock(slot->inference_mutex);
+        slot->model->unload();
+    }
     
     std::cout << "Unloaded model: " << model_id << std::endl;
     return true;
 }
 
 bool DrawKernAIManager::is_model_loaded(const std::string& model_id) const {
-    auto it = models_.find(model_id);
-    return it != models_.end() && it->second->is_loaded();
+    auto slot = find_slot(model_id);
+    return slot && slot->model->is_loaded();
 }
 
 AIInferenceResponse DrawKernAIManager::generate(const std::string& model_id, const AIInferenceRequest& request) {
-    auto it = models_.find(model_id);
-    if (it == models_.end()) {
+    auto slot = find_slot(model_id);
+    if (!slot) {
         AIInferenceResponse error_response;
         error_response.error = "Model not found: " + model_id;
         error_response.success = false;
         return error_response;
     }
     
-    AIInferenceResponse response = it->second->generate(request);
-    update_stats(model_id, response);
+    AIInferenceResponse response;
+    {
+        std::lock_guard<std::mutex> lock(slot->inference_mutex);
+        response = slot->model->generate(request);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        update_stats(*slot, response);
+    }
     
     // Broadcast to VM if handler is registered
-    if (!request.vm_id.empty() && vm_handlers_.count(request.vm_id)) {
-        vm_handlers_[request.vm_id](response);
-    }
+    notify_vm(request.vm_id, response);
     
     return response;
 }
 
 AIInferenceResponse DrawKernAIManager::chat(const std::string& model_id, const std::string& message, const std::string& session_id) {
-    auto it = models_.find(model_id);
-    if (it == models_.end()) {
+    auto slot = find_slot(model_id);
+    if (!slot) {
         AIInferenceResponse error_response;
         error_response.error = "Model not found: " + model_id;
         error_response.success = false;
@@ -404,15 +478,24 @@ AIInferenceResponse DrawKernAIManager::chat(const std::string& model_id, const s
     
     // Get session context
     std::string context;
-    if (!session_id.empty() && session_history_.count(session_id)) {
-        const auto& history = session_history_[session_id];
-        for (const auto& msg : history) {
-            context += msg + "\n";
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!session_id.empty() && session_history_.count(session_id)) {
+            const auto& history = session_history_[session_id];
+            for (const auto& msg : history) {
+                context += msg + "\n";
+            }
         }
     }
     
-    AIInferenceResponse response = it->second->chat(message, context);
-    update_stats(model_id, response);
+    AIInferenceResponse response;
+    {
+        std::lock_guard<std::mutex> lock(slot->inference_mutex);
+        response = slot->model->chat(message, context);
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    update_stats(*slot, response);
     
     // Update session history
     if (!session_id.empty() && response.success) {
@@ -430,44 +513,108 @@ AIInferenceResponse DrawKernAIManager::chat(const std::string& model_id, const s
 }
 
 AIInferenceResponse DrawKernAIManager::complete_code(const std::string& model_id, const std::string& code, const std::string& language) {
-    auto it = models_.find(model_id);
-    if (it == models_.end()) {
+    auto slot = find_slot(model_id);
+    if (!slot) {
         AIInferenceResponse error_response;
         error_response.error = "Model not found: " + model_id;
         error_response.success = false;
         return error_response;
     }
     
-    AIInferenceResponse response = it->second->complete_code(code, language);
-    update_stats(model_id, response);
+    AIInferenceResponse response;
+    {
+        std::lock_guard<std::mutex> lock(slot->inference_mutex);
+        response = slot->model->complete_code(code, language);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    update_stats(*slot, response);
     
     return response;
 }
 
+void DrawKernAIManager::submit(const std::string& model_id, AIInferenceRequest request, Completion completion) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = models_.find(model_id);
+    if (it == models_.end() || stopping_) {
+        lock.unlock();
+        AIInferenceResponse error_response;
+        error_response.error = it == models_.end() ? "Model not found: " + model_id : "AI manager shut down";
+        error_response.vm_id = request.vm_id;
+        error_response.session_id = request.session_id;
+        completion(error_response);
+        return;
+    }
+    
+    ModelSlot& slot = *it->second;
+    auto now = std::chrono::steady_clock::now();
+    if (slot.queued_completed == 0 && slot.queue.empty()) {
+        slot.first_queued = now;
+    }
+    slot.queue.push_back(PendingRequest{std::move(request), std::move(completion), now});
+    
+    if (!dispatcher_.joinable()) {
+        dispatcher_ = std::thread([this]() { dispatch_loop(); });
+    }
+    
+    // The dispatcher needs a deadline for a new batch and an early start
+    // for a full one; anything else it already waits for
+    bool wake = slot.queue.size() == 1 || slot.queue.size() >= max_batch_size_;
+    lock.unlock();
+    if (wake) {
+        queue_cv_.notify_one();
+    }
+}
+
+std::future<AIInferenceResponse> DrawKernAIManager::submit(const std::string& model_id, AIInferenceRequest request) {
+    auto promise = std::make_shared<std::promise<AIInferenceResponse>>();
+    std::future<AIInferenceResponse> future = promise->get_future();
+    submit(model_id, std::move(request), [promise](const AIInferenceResponse& response) {
+        promise->set_value(response);
+    });
+    return future;
+}
+
+void DrawKernAIManager::set_batching(size_t max_batch_size, std::chrono::microseconds window) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        max_batch_size_ = max_batch_size > 0 ? max_batch_size : 1;
+        batch_window_ = window;
+    }
+    queue_cv_.notify_one();
+}
+
 void DrawKernAIManager::register_vm_ai_handler(const std::string& vm_id, std::function<void(const AIInferenceResponse&)> handler) {
-    vm_handlers_[vm_id] = handler;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        vm_handlers_[vm_id] = handler;
+    }
     std::cout << "Registered AI handler for VM: " << vm_id << std::endl;
 }
 
 void DrawKernAIManager::broadcast_to_vm(const std::string& vm_id, const AIInferenceResponse& response) {
-    if (vm_handlers_.count(vm_id)) {
-        vm_handlers_[vm_id](response);
-    }
+    notify_vm(vm_id, response);
 }
 
 void DrawKernAIManager::create_session(const std::string& session_id, const std::string& model_id) {
-    sessions_[session_id] = model_id;
-    session_history_[session_id] = {};
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sessions_[session_id] = model_id;
+        session_history_[session_id] = {};
+    }
     std::cout << "Created AI session: " << session_id << " (model: " << model_id << ")" << std::endl;
 }
 
 void DrawKernAIManager::destroy_session(const std::string& session_id) {
-    sessions_.erase(session_id);
-    session_history_.erase(session_id);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sessions_.erase(session_id);
+        session_history_.erase(session_id);
+    }
     std::cout << "Destroyed AI session: " << session_id << std::endl;
 }
 
 std::vector<std::string> DrawKernAIManager::list_sessions() const {
+    std::lock_guard<std::mutex> lock(mutex_);
     std::vector<std::string> session_list;
     for (const auto& [session_id, model_id] : sessions_) {
         session_list.push_back(session_id);
@@ -476,8 +623,9 @@ std::vector<std::string> DrawKernAIManager::list_sessions() const {
 }
 
 std::vector<std::string> DrawKernAIManager::list_models() const {
+    std::lock_guard<std::mutex> lock(mutex_);
     std::vector<std::string> model_list;
-    for (const auto& [model_id, model] : models_) {
+    for (const auto& [model_id, slot] : models_) {
         model_list.push_back(model_id);
     }
     return model_list;
@@ -508,9 +656,27 @@ AIModelConfig DrawKernAIManager::get_default_config(const std::string& model_typ
     return config;
 }
 
+
 std::vector<DrawKernAIManager::ModelStats> DrawKernAIManager::get_model_statistics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
     std::vector<ModelStats> stats;
-    for (const auto& [model_id, model_stats] : model_stats_) {
+    for (const auto& [model_id, slot] : models_) {
+        ModelStats model_stats = slot->stats;
+        
+        if (slot->queued_completed > 0) {
+            model_stats.average_queue_time_ms = static_cast<float>(slot->total_queue_time_ms / slot->queued_completed);
+            
+            std::vector<float> latencies(slot->recent_latencies_ms.begin(), slot->recent_latencies_ms.end());
+            std::sort(latencies.begin(), latencies.end());
+            model_stats.p50_latency_ms = latencies[(latencies.size() - 1) * 50 / 100];
+            model_stats.p99_latency_ms = latencies[(latencies.size() - 1) * 99 / 100];
+            
+            float seconds = std::chrono::duration<float>(slot->last_completed - slot->first_queued).count();
+            if (seconds > 0.0f) {
+                model_stats.requests_per_second = slot->queued_completed / seconds;
+                model_stats.tokens_per_second = slot->queued_tokens / seconds;
+            }
+        }
         stats.push_back(model_stats);
     }
     return stats;
@@ -527,8 +693,14 @@ std::unique_ptr<AIModel> DrawKernAIManager::create_model(const AIModelConfig& co
     return nullptr;
 }
 
-void DrawKernAIManager::update_stats(const std::string& model_id, const AIInferenceResponse& response) {
-    auto& stats = model_stats_[model_id];
+std::shared_ptr<DrawKernAIManager::ModelSlot> DrawKernAIManager::find_slot(const std::string& model_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = models_.find(model_id);
+    return it != models_.end() ? it->second : nullptr;
+}
+
+void DrawKernAIManager::update_stats(ModelSlot& slot, const AIInferenceResponse& response) {
+    auto& stats = slot.stats;
     stats.total_requests++;
     
     if (response.success) {
@@ -541,6 +713,118 @@ void DrawKernAIManager::update_stats(const std::string& model_id, const AIInfere
     }
 }
 
+void DrawKernAIManager::dispatch_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        // Serve the model whose oldest request has waited longest among
+        // those with a full batch or a request that waited out the window
+        auto now = std::chrono::steady_clock::now();
+        std::shared_ptr<ModelSlot> ready;
+        auto deadline = std::chrono::steady_clock::time_point::max();
+        for (const auto& [model_id, slot] : models_) {
+            if (slot->queue.empty()) {
+                continue;
+            }
+            auto queued_at = slot->queue.front().queued_at;
+            bool full = slot->queue.size() >= max_batch_size_;
+            if ((full || queued_at + batch_window_ <= now) &&
+                (!ready || queued_at < ready->queue.front().queued_at)) {
+                ready = slot;
+            }
+            deadline = std::min(deadline, queued_at + batch_window_);
+        }
+        
+        if (!ready) {
+            if (deadline == std::chrono::steady_clock::time_point::max()) {
+                queue_cv_.wait(lock);
+            } else {
+                queue_cv_.wait_until(lock, deadline);
+            }
+            continue;
+        }
+        
+        size_t count = std::min(ready->queue.size(), max_batch_size_);
+        std::vector<PendingRequest> batch(std::make_move_iterator(ready->queue.begin()),
+                                          std::make_move_iterator(ready->queue.begin() + count));
+        ready->queue.erase(ready->queue.begin(), ready->queue.begin() + count);
+        
+        lock.unlock();
+        run_batch(*ready, std::move(batch));
+        lock.lock();
+    }
+}
+
+void DrawKernAIManager::run_batch(ModelSlot& slot, std::vector<PendingRequest> batch) {
+    auto started = std::chrono::steady_clock::now();
+    
+    std::vector<AIInferenceRequest> requests;
+    requests.reserve(batch.size());
+    for (const auto& pending : batch) {
+        requests.push_back(pending.request);
+    }
+    
+    std::vector<AIInferenceResponse> responses;
+    std::string failure = "Model returned no response";
+    try {
+        std::lock_guard<std::mutex> lock(slot.inference_mutex);
+        responses = slot.model->generate_batch(requests);
+    } catch (const std::exception& e) {
+        responses.clear();
+        failure = "Batched inference failed: " + std::string(e.what());
+    }
+    for (size_t i = responses.size(); i < requests.size(); ++i) {
+        AIInferenceResponse missing;
+        missing.error = failure;
+        missing.vm_id = requests[i].vm_id;
+        missing.session_id = requests[i].session_id;
+        responses.push_back(std::move(missing));
+    }
+    
+    auto finished = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ModelStats& stats = slot.stats;
+        stats.batches++;
+        stats.average_batch_size += (static_cast<float>(batch.size()) - stats.average_batch_size) / stats.batches;
+        
+        for (size_t i = 0; i < batch.size(); ++i) {
+            update_stats(slot, responses[i]);
+            slot.total_queue_time_ms += std::chrono::duration<double, std::milli>(started - batch[i].queued_at).count();
+            slot.recent_latencies_ms.push_back(std::chrono::duration<float, std::milli>(finished - batch[i].queued_at).count());
+            if (slot.recent_latencies_ms.size() > LATENCY_WINDOW) {
+                slot.recent_latencies_ms.pop_front();
+            }
+            if (responses[i].success) {
+                slot.queued_tokens += responses[i].tokens_generated;
+            }
+        }
+        slot.queued_completed += batch.size();
+        slot.last_completed = finished;
+    }
+    
+    for (size_t i = 0; i < batch.size(); ++i) {
+        batch[i].completion(responses[i]);
+        notify_vm(requests[i].vm_id, responses[i]);
+    }
+}
+
+void DrawKernAIManager::notify_vm(const std::string& vm_id, const AIInferenceResponse& response) {
+    if (vm_id.empty()) {
+        return;
+    }
+    
+    std::function<void(const AIInferenceResponse&)> handler;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = vm_handlers_.find(vm_id);
+        if (it == vm_handlers_.end()) {
+            return;
+        }
+        handler = it->second;
+    }
+    handler(response);
+}
+
 // AIModelFactory implementation
 AIModelConfig AIModelFactory::create_rwkv_config(const std::string& model_path, const std::string& size) {
     AIModelConfig config;
@@ -642,6 +926,24 @@ namespace Integration {
         std::cout << "Set up AI integration for DIS VM with model: " << model_id << std::endl;
     }
     
+    void setup_dis_vm_manager_ai_integration(DISVMManager& vm_manager, DrawKernAIManager& ai_manager, const std::string& model_id) {
+        auto ai_handler = [&ai_manager, model_id](const std::string& vm_id, const std::string& prompt,
+                                                  const std::string& context, DISVM::AIResume resume) {
+            AIInferenceRequest request;
+            request.prompt = prompt;
+            request.context = context;
+            request.task_type = "chat";
+            request.vm_id = vm_id;
+            
+            ai_manager.submit(model_id, std::move(request), [resume = std::move(resume)](const AIInferenceResponse& response) {
+                resume(response.success ? response.response : "AI Error: " + response.error);
+            });
+        };
+        
+        vm_manager.set_ai_handler(ai_handler);
+        std::cout << "Set up batched AI integration for DIS VMs with model: " << model_id << std::endl;
+    }
+    
     void setup_styx_ai_integration(StyxServer& server, DrawKernAIManager& ai_manager) {
         // Register AI handlers for Styx server
         auto ai_handler = [&ai_manager](const std::string& request) {
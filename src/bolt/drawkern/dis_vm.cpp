@@ -4,12 +4,504 @@
 #include <algorithm>
 #include <regex>
 #include <thread>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
 
 namespace bolt {
 namespace drawkern {
 
+// DISProgram serialization
+namespace {
+
+constexpr char PROGRAM_MAGIC[4] = {'D', 'I', 'S', 'B'};
+constexpr size_t MAX_LIST_DEPTH = 64;
+
+// FNV-1a; catches torn writes and bit rot, not tampering
+uint32_t image_checksum(const char* data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+class ImageWriter {
+public:
+    void byte(uint8_t value) { out_.push_back(static_cast<char>(value)); }
+    
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            byte(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        byte(static_cast<uint8_t>(value));
+    }
+    
+    void fixed(uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i) {
+            byte(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+    
+    void string(const std::string& value) {
+        varint(value.size());
+        out_.append(value);
+    }
+    
+    void raw(const char* data, size_t length) { out_.append(data, length); }
+    std::string& data() { return out_; }
+    
+private:
+    std::string out_;
+};
+
+class ImageReader {
+public:
+    explicit ImageReader(std::string_view data) : data_(data) {}
+    
+    bool byte(uint8_t& value) {
+        if (pos_ >= data_.size()) return false;
+        value = static_cast<uint8_t>(data_[pos_++]);
+        return true;
+    }
+    
+    bool varint(uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b;
+            if (!byte(b)) return false;
+            value |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+    
+    // A count of items that each take at least one byte
+    bool count(size_t& value) {
+        uint64_t n;
+        if (!varint(n) || n > data_.size() - pos_) return false;
+        value = static_cast<size_t>(n);
+        return true;
+    }
+    
+    bool fixed(uint64_t& value, int bytes) {
+        if (data_.size() - pos_ < static_cast<size_t>(bytes)) return false;
+        value = 0;
+        for (int i = 0; i < bytes; ++i) {
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(data_[pos_++])) << (8 * i);
+        }
+        return true;
+    }
+    
+    bool string(std::string& value) {
+        size_t length;
+        if (!count(length)) return false;
+        value.assign(data_.substr(pos_, length));
+        pos_ += length;
+        return true;
+    }
+    
+    bool at_end() const { return pos_ == data_.size(); }
+    
+private:
+    std::string_view data_;
+    size_t pos_ = 0;
+};
+
+void write_value(ImageWriter& writer, const DISValue& value) {
+    writer.byte(value.type());
+    switch (value.type()) {
+        case DISValue::INT: {
+            // Zigzag keeps small negative numbers short
+            uint64_t bits = static_cast<uint64_t>(value.int_value());
+            writer.varint((bits << 1) ^ (value.int_value() < 0 ? ~uint64_t(0) : 0));
+            break;
+        }
+        case DISValue::FLOAT: {
+            double number = value.float_value();
+            uint64_t bits;
+            std::memcpy(&bits, &number, sizeof(bits));
+            writer.fixed(bits, 8);
+            break;
+        }
+        case DISValue::STRING:
+            writer.string(value.string_value());
+            break;
+        case DISValue::LIST:
+            writer.varint(value.list_value().size());
+            for (const auto& item : value.list_value()) {
+                write_value(writer, item);
+            }
+            break;
+        case DISValue::REF:
+            break;
+    }
+}
+
+bool read_value(ImageReader& reader, DISValue& value, size_t depth = 0) {
+    uint8_t type;
+    if (!reader.byte(type)) return false;
+    switch (type) {
+        case DISValue::INT: {
+            uint64_t bits;
+            if (!reader.varint(bits)) return false;
+            value = DISValue(static_cast<int64_t>((bits >> 1) ^ (~(bits & 1) + 1)));
+            return true;
+        }
+        case DISValue::FLOAT: {
+            uint64_t bits;
+            if (!reader.fixed(bits, 8)) return false;
+            double number;
+            std::memcpy(&number, &bits, sizeof(number));
+            value = DISValue(number);
+            return true;
+        }
+        case DISValue::STRING: {
+            std::string text;
+            if (!reader.string(text)) return false;
+            value = DISValue(std::move(text));
+            return true;
+        }
+        case DISValue::LIST: {
+            size_t size;
+            if (depth >= MAX_LIST_DEPTH || !reader.count(size)) return false;
+            std::vector<DISValue> items(size);
+            for (auto& item : items) {
+                if (!read_value(reader, item, depth + 1)) return false;
+            }
+            value = DISValue(std::move(items));
+            return true;
+        }
+        case DISValue::REF:
+            value = DISValue::from_ref(nullptr);
+            return true;
+    }
+    return false;
+}
+
+} // namespace
+
+// Interpreter integer arithmetic wraps like the two's complement machine
+// Limbo targets instead of overflowing into undefined behaviour
+namespace {
+
+int64_t wrapping_add(int64_t a, int64_t b) {
+    return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+}
+
+int64_t wrapping_sub(int64_t a, int64_t b) {
+    return static_cast<int64_t>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b));
+}
+
+int64_t wrapping_mul(int64_t a, int64_t b) {
+    return static_cast<int64_t>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b));
+}
+
+// INT64_MIN / -1 is the one quotient that does not fit; it wraps to INT64_MIN
+int64_t wrapping_div(int64_t a, int64_t b) {
+    return b == -1 ? wrapping_sub(0, a) : a / b;
+}
+
+int64_t wrapping_mod(int64_t a, int64_t b) {
+    return b == -1 ? 0 : a % b;
+}
+
+} // namespace
+
+std::string DISProgram::serialize() const {
+    // Intern literals the way DISCode::lower does
+    std::vector<const DISValue*> pool;
+    std::map<int64_t, size_t> int_constants;
+    std::map<std::string, size_t> string_constants;
+    auto intern = [&](const DISValue& value) -> size_t {
+        size_t index = pool.size();
+        if (value.type() == DISValue::INT) {
+            auto [it, inserted] = int_constants.try_emplace(value.int_value(), index);
+            if (!inserted) return it->second;
+        } else if (value.type() == DISValue::STRING) {
+            auto [it, inserted] = string_constants.try_emplace(value.string_value(), index);
+            if (!inserted) return it->second;
+        }
+        pool.push_back(&value);
+        return index;
+    };
+    
+    std::vector<size_t> operand_indices;
+    for (const auto& inst : instructions) {
+        for (const auto& operand : inst.operands) {
+            operand_indices.push_back(intern(operand));
+        }
+    }
+    std::vector<size_t> global_indices;
+    for (const auto& value : globals) {
+        global_indices.push_back(intern(value));
+    }
+    
+    ImageWriter writer;
+    writer.raw(PROGRAM_MAGIC, sizeof(PROGRAM_MAGIC));
+    writer.byte(FORMAT_VERSION);
+    writer.string(source_limbo);
+    
+    writer.varint(pool.size());
+    for (const DISValue* value : pool) {
+        write_value(writer, *value);
+    }
+    
+    writer.varint(instructions.size());
+    size_t next_operand = 0;
+    for (const auto& inst : instructions) {
+        writer.byte(static_cast<uint8_t>(inst.opcode));
+        writer.varint(inst.operands.size());
+        for (size_t i = 0; i < inst.operands.size(); ++i) {
+            writer.varint(operand_indices[next_operand++]);
+        }
+    }
+    
+    writer.varint(labels.size());
+    for (const auto& [label, address] : labels) {
+        writer.string(label);
+        writer.varint(address);
+    }
+    
+    writer.varint(global_names.size());
+    for (size_t slot = 0; slot < global_names.size(); ++slot) {
+        writer.string(global_names[slot]);
+        writer.varint(slot < global_indices.size() ? global_indices[slot] + 1 : 0);  // 0: no initial value
+    }
+    
+    writer.varint(functions.size());
+    for (const auto& function : functions) {
+        writer.string(function.name);
+        writer.varint(function.entry);
+        writer.varint(function.locals.size());
+        for (const auto& local : function.locals) {
+            writer.string(local);
+        }
+    }
+    
+    writer.fixed(image_checksum(writer.data().data(), writer.data().size()), 4);
+    return std::move(writer.data());
+}
+
+std::optional<DISProgram> DISProgram::deserialize(std::string_view data) {
+    uint64_t stored_checksum;
+    if (data.size() < sizeof(PROGRAM_MAGIC) + 1 + 4 ||
+        std::memcmp(data.data(), PROGRAM_MAGIC, sizeof(PROGRAM_MAGIC)) != 0 ||
+        static_cast<uint8_t>(data[sizeof(PROGRAM_MAGIC)]) != FORMAT_VERSION ||
+        !ImageReader(data.substr(data.size() - 4)).fixed(stored_checksum, 4) ||
+        image_checksum(data.data(), data.size() - 4) != stored_checksum) {
+        return std::nullopt;
+    }
+    
+    ImageReader reader(data.substr(sizeof(PROGRAM_MAGIC) + 1, data.size() - sizeof(PROGRAM_MAGIC) - 1 - 4));
+    DISProgram program;
+    size_t count;
+    if (!reader.string(program.source_limbo) || !reader.count(count)) {
+        return std::nullopt;
+    }
+    
+    std::vector<DISValue> pool(count);
+    for (auto& value : pool) {
+        if (!read_value(reader, value)) return std::nullopt;
+    }
+    auto constant = [&pool, &reader](DISValue& value) {
+        uint64_t index;
+        if (!reader.varint(index) || index >= pool.size()) return false;
+        value = pool[static_cast<size_t>(index)];
+        return true;
+    };
+    
+    if (!reader.count(count)) return std::nullopt;
+    program.instructions.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t opcode;
+        size_t operand_count;
+        if (!reader.byte(opcode) || !reader.count(operand_count)) return std::nullopt;
+        DISInstruction inst(static_cast<DISOpcode>(opcode));
+        inst.operands.resize(operand_count);
+        for (auto& operand : inst.operands) {
+            if (!constant(operand)) return std::nullopt;
+        }
+        program.instructions.push_back(std::move(inst));
+    }
+    
+    if (!reader.count(count)) return std::nullopt;
+    for (size_t i = 0; i < count; ++i) {
+        std::string label;
+        uint64_t address;
+        if (!reader.string(label) || !reader.varint(address)) return std::nullopt;
+        program.labels[label] = static_cast<size_t>(address);
+    }
+    
+    if (!reader.count(count)) return std::nullopt;
+    for (size_t i = 0; i < count; ++i) {
+        std::string name;
+        uint64_t index;
+        if (!reader.string(name) || !reader.varint(index) || index > pool.size()) return std::nullopt;
+        program.add_global(name, index > 0 ? pool[static_cast<size_t>(index - 1)] : DISValue());
+    }
+    
+    if (!reader.count(count)) return std::nullopt;
+    for (size_t i = 0; i < count; ++i) {
+        DISFunction function;
+        uint64_t entry;
+        size_t local_count;
+        if (!reader.string(function.name) || !reader.varint(entry) || !reader.count(local_count)) {
+            return std::nullopt;
+        }
+        function.entry = static_cast<size_t>(entry);
+        function.locals.resize(local_count);
+        for (auto& local : function.locals) {
+            if (!reader.string(local)) return std::nullopt;
+        }
+        program.functions.push_back(std::move(function));
+    }
+    
+    if (!reader.at_end()) {
+        return std::nullopt;
+    }
+    return program;
+}
+
+// DISCode implementation
+DISCode DISCode::lower(const DISProgram& program) {
+    DISCode code;
+    const size_t size = program.instructions.size();
+    code.instructions.reserve(size + 1);
+    
+    std::map<int64_t, uint32_t> int_constants;
+    std::map<std::string, uint32_t> string_constants;
+    auto intern = [&code, &int_constants, &string_constants](const DISValue& value) -> uint32_t {
+        uint32_t index = static_cast<uint32_t>(code.constants.size());
+        if (value.type() == DISValue::INT) {
+            auto [it, inserted] = int_constants.try_emplace(value.int_value(), index);
+            if (!inserted) return it->second;
+        } else if (value.type() == DISValue::STRING) {
+            auto [it, inserted] = string_constants.try_emplace(value.string_value(), index);
+            if (!inserted) return it->second;
+        }
+        code.constants.push_back(value);
+        return index;
+    };
+    
+    // Targets past the end land on END; a jump without a usable target
+    // stays put (JMP, CALL) or falls through (JMPT, JMPF), as before lowering
+    auto target = [size](const DISInstruction& inst, size_t missing) -> uint32_t {
+        if (inst.operands.empty() || inst.operands[0].type() != DISValue::INT) {
+            return static_cast<uint32_t>(missing);
+        }
+        int64_t address = inst.operands[0].int_value();
+        return static_cast<uint32_t>(address < 0 || static_cast<uint64_t>(address) > size ? size : address);
+    };
+    
+    // Slots and counts must be non-negative integers below the limit
+    auto slot = [](const DISInstruction& inst, size_t limit) -> uint32_t {
+        if (inst.operands.empty() || inst.operands[0].type() != DISValue::INT) {
+            return NO_OPERAND;
+        }
+        int64_t index = inst.operands[0].int_value();
+        return index < 0 || static_cast<uint64_t>(index) >= limit ? NO_OPERAND : static_cast<uint32_t>(index);
+    };
+    
+    for (size_t pc = 0; pc < size; ++pc) {
+        const DISInstruction& inst = program.instructions[pc];
+        Instruction lowered{INVALID, inst.opcode, NO_OPERAND};
+        switch (inst.opcode) {
+            case DISOpcode::LOAD:
+                if (!inst.operands.empty()) {
+                    lowered.handler = PUSH_CONST;
+                    lowered.operand = intern(inst.operands[0]);
+                } else {
+                    lowered.handler = NOP;
+                }
+                break;
+            case DISOpcode::NEWSTR:
+                // Pushes the operand's text whatever its type
+                if (!inst.operands.empty()) {
+                    lowered.handler = PUSH_CONST;
+                    lowered.operand = intern(DISValue(inst.operands[0].string_value()));
+                } else {
+                    lowered.handler = NOP;
+                }
+                break;
+            case DISOpcode::STORE: lowered.handler = NOP; break;
+            case DISOpcode::LOADG:
+                lowered.operand = slot(inst, program.globals.size());
+                lowered.handler = lowered.operand != NO_OPERAND ? LOAD_GLOBAL : INVALID;
+                break;
+            case DISOpcode::STOREG:
+                lowered.operand = slot(inst, program.globals.size());
+                lowered.handler = lowered.operand != NO_OPERAND ? STORE_GLOBAL : INVALID;
+                break;
+            case DISOpcode::LOADL:
+                lowered.operand = slot(inst, MAX_LOCALS);
+                lowered.handler = lowered.operand != NO_OPERAND ? LOAD_LOCAL : INVALID;
+                break;
+            case DISOpcode::STOREL:
+                lowered.operand = slot(inst, MAX_LOCALS);
+                lowered.handler = lowered.operand != NO_OPERAND ? STORE_LOCAL : INVALID;
+                break;
+            case DISOpcode::POP: lowered.handler = POP; break;
+            case DISOpcode::DUP: lowered.handler = DUP; break;
+            case DISOpcode::ADD: lowered.handler = ADD; break;
+            case DISOpcode::SUB: lowered.handler = SUB; break;
+            case DISOpcode::MUL: lowered.handler = MUL; break;
+            case DISOpcode::DIV: lowered.handler = DIV; break;
+            case DISOpcode::MOD: lowered.handler = MOD; break;
+            case DISOpcode::EQ: lowered.handler = EQ; break;
+            case DISOpcode::NE: lowered.handler = NE; break;
+            case DISOpcode::LT: lowered.handler = LT; break;
+            case DISOpcode::GT: lowered.handler = GT; break;
+            case DISOpcode::LE: lowered.handler = LE; break;
+            case DISOpcode::GE: lowered.handler = GE; break;
+            case DISOpcode::JMP:
+                lowered.handler = JMP;
+                lowered.operand = target(inst, pc);
+                break;
+            case DISOpcode::JMPT:
+                lowered.handler = JMPT;
+                lowered.operand = target(inst, pc + 1);
+                break;
+            case DISOpcode::JMPF:
+                lowered.handler = JMPF;
+                lowered.operand = target(inst, pc + 1);
+                break;
+            case DISOpcode::CALL:
+                lowered.handler = CALL;
+                lowered.operand = target(inst, pc);
+                break;
+            case DISOpcode::RET: lowered.handler = RET; break;
+            case DISOpcode::ENTER:
+                lowered.operand = slot(inst, MAX_LOCALS + 1);
+                lowered.handler = lowered.operand != NO_OPERAND ? ENTER : INVALID;
+                break;
+            case DISOpcode::CONCAT: lowered.handler = CONCAT; break;
+            case DISOpcode::STRLEN: lowered.handler = STRLEN; break;
+            case DISOpcode::PRINT: lowered.handler = PRINT; break;
+            case DISOpcode::READ: lowered.handler = READ; break;
+            case DISOpcode::RECV: lowered.handler = RECV; break;
+            case DISOpcode::SEND: lowered.handler = SEND; break;
+            case DISOpcode::AI_INIT: lowered.handler = AI_INIT; break;
+            case DISOpcode::AI_COMPLETE: lowered.handler = AI_COMPLETE; break;
+            case DISOpcode::AI_CHAT: lowered.handler = AI_CHAT; break;
+            case DISOpcode::RENDER_GLYPH: lowered.handler = RENDER_GLYPH; break;
+            case DISOpcode::SPAWN_VM: lowered.handler = SPAWN_VM; break;
+            case DISOpcode::MOUNT_NS: lowered.handler = MOUNT_NS; break;
+            case DISOpcode::HALT: lowered.handler = HALT; break;
+            default: break; // NEWLIST, APPEND, INDEX and unassigned values
+        }
+        code.instructions.push_back(lowered);
+    }
+    
+    code.instructions.push_back(Instruction{END, DISOpcode::HALT, NO_OPERAND});
+    return code;
+}
+
 // DISVM implementation
-DISVM::DISVM() : pc_(0), running_(false), halted_(false), at_breakpoint_(false), step_mode_(false), step_depth_(0) {
+DISVM::DISVM() : frame_base_(0), pc_(0), running_(false), halted_(false), waiting_(false), at_breakpoint_(false), step_mode_(false), step_depth_(0) {
+    stack_.reserve(INITIAL_STACK_CAPACITY);
     reset();
 }
 
@@ -19,22 +511,27 @@ DISVM::~DISVM() {
 
 bool DISVM::load_program(const DISProgram& program) {
     program_ = program;
+    code_ = DISCode::lower(program_);
     globals_ = program.globals;
     pc_ = 0;
     running_ = false;
     halted_ = false;
+    waiting_ = false;
+    pending_ai_.reset();
     
     // Clear stacks
-    while (!stack_.empty()) stack_.pop();
-    while (!call_stack_.empty()) call_stack_.pop();
+    stack_.clear();
+    call_stack_.clear();
+    locals_.clear();
+    frame_base_ = 0;
     
     std::cout << "Loaded DIS program with " << program_.instructions.size() << " instructions" << std::endl;
     return true;
 }
 
-bool DISVM::load_limbo_source(const std::string& source) {
+bool DISVM::load_limbo_source(const std::string& source, const DISBytecodeCache* cache) {
     LimboCompiler compiler;
-    DISProgram program = compiler.compile(source);
+    DISProgram program = cache ? cache->get_or_compile(source, compiler) : compiler.compile(source);
     
     if (compiler.has_errors()) {
         std::cout << "Compilation errors:" << std::endl;
@@ -55,15 +552,24 @@ bool DISVM::run() {
     
     running_ = true;
     halted_ = false;
+    waiting_ = false;
     
     std::cout << "Starting DIS VM execution..." << std::endl;
     
-    while (running_ && !halted_ && pc_ < program_.instructions.size()) {
-        step();
+    // Breakpoints need a check before every instruction; without any the
+    // program runs straight through the threaded interpreter
+    if (breakpoints_.empty()) {
+        execute<false>();
+    } else {
+        while (running_ && !halted_ && pc_ < program_.instructions.size()) {
+            step();
+        }
     }
     
     if (halted_) {
         std::cout << "DIS VM halted normally" << std::endl;
+    } else if (waiting_) {
+        std::cout << "DIS VM waiting for a message" << std::endl;
     } else if (pc_ >= program_.instructions.size()) {
         std::cout << "DIS VM reached end of program" << std::endl;
     } else {
@@ -87,36 +593,37 @@ void DISVM::step() {
     }
     
     at_breakpoint_ = false;
-    const DISInstruction& inst = program_.instructions[pc_];
-    
-    try {
-        execute_instruction(inst);
-        
-        // Advance PC unless it was modified by a jump/call instruction
-        if (inst.opcode != DISOpcode::JMP && 
-            inst.opcode != DISOpcode::JMPT && 
-            inst.opcode != DISOpcode::JMPF && 
-            inst.opcode != DISOpcode::CALL &&
-            inst.opcode != DISOpcode::RET) {
-            pc_++;
+    execute<true>();
+    
+    // Handle step mode
+    if (step_mode_) {
+        if (step_depth_ > 0 && call_stack_.size() < step_depth_) {
+            // Step out completed
+            step_mode_ = false;
+            step_depth_ = 0;
+        } else if (step_depth_ == 0) {
+            // Single step completed
+            step_mode_ = false;
         }
-        
-        // Handle step mode
-        if (step_mode_) {
-            if (step_depth_ > 0 && call_stack_.size() < step_depth_) {
-                // Step out completed
-                step_mode_ = false;
-                step_depth_ = 0;
-            } else if (step_depth_ == 0) {
-                // Single step completed
-                step_mode_ = false;
-            }
-        }
-    } catch (const std::exception& e) {
-        runtime_error("Exception during execution: " + std::string(e.what()));
     }
 }
 
+DISVM::SliceResult DISVM::run_slice(size_t budget) {
+    if (halted_ || pc_ >= program_.instructions.size()) {
+        return SliceResult::HALTED;
+    }
+    
+    running_ = true;
+    waiting_ = false;
+    execute<false>(budget > 0 ? budget : 1);
+    running_ = false;
+    
+    if (halted_ || pc_ >= program_.instructions.size()) {
+        return SliceResult::HALTED;
+    }
+    return waiting_ ? SliceResult::WAITING : SliceResult::YIELDED;
+}
+
 void DISVM::halt() {
     halted_ = true;
     running_ = false;
@@ -127,20 +634,25 @@ void DISVM::reset() {
     pc_ = 0;
     running_ = false;
     halted_ = false;
+    waiting_ = false;
+    pending_ai_.reset();
     at_breakpoint_ = false;
     step_mode_ = false;
     step_depth_ = 0;
     
-    while (!stack_.empty()) stack_.pop();
-    while (!call_stack_.empty()) call_stack_.pop();
+    stack_.clear();
+    call_stack_.clear();
+    locals_.clear();
+    frame_base_ = 0;
     
     globals_.clear();
     program_ = DISProgram{};
+    code_ = DISCode::lower(program_);
     // Note: breakpoints are preserved across resets
 }
 
 void DISVM::push(const DISValue& value) {
-    stack_.push(value);
+    stack_.push_back(value);
 }
 
 DISValue DISVM::pop() {
@@ -149,8 +661,8 @@ DISValue DISVM::pop() {
         return DISValue(int64_t(0));
     }
     
-    DISValue value = stack_.top();
-    stack_.pop();
+    DISValue value = std::move(stack_.back());
+    stack_.pop_back();
     return value;
 }
 
@@ -158,22 +670,60 @@ DISValue DISVM::peek() const {
     if (stack_.empty()) {
         return DISValue(int64_t(0));
     }
-    return stack_.top();
+    return stack_.back();
 }
 
 void DISVM::set_global(const std::string& name, const DISValue& value) {
-    globals_[name] = value;
+    auto slot = program_.find_global(name);
+    if (slot) {
+        globals_[*slot] = value;
+        return;
+    }
+    // No compiled code refers to the new slot, so the code needs no relowering
+    program_.add_global(name, value);
+    globals_.push_back(value);
 }
 
 DISValue DISVM::get_global(const std::string& name) const {
-    auto it = globals_.find(name);
-    return it != globals_.end() ? it->second : DISValue(int64_t(0));
+    auto slot = program_.find_global(name);
+    return slot ? globals_[*slot] : DISValue(int64_t(0));
+}
+
+std::map<std::string, DISValue> DISVM::get_globals() const {
+    std::map<std::string, DISValue> globals;
+    for (size_t slot = 0; slot < program_.global_names.size(); ++slot) {
+        globals[program_.global_names[slot]] = globals_[slot];
+    }
+    return globals;
+}
+
+std::map<std::string, DISValue> DISVM::get_locals() const {
+    std::map<std::string, DISValue> locals;
+    if (call_stack_.empty()) {
+        return locals;
+    }
+    const DISFunction* function = program_.find_function(call_stack_.back().entry);
+    if (!function) {
+        return locals;
+    }
+    for (size_t slot = 0; slot < function->locals.size() && frame_base_ + slot < locals_.size(); ++slot) {
+        locals[function->locals[slot]] = locals_[frame_base_ + slot];
+    }
+    return locals;
 }
 
 void DISVM::set_ai_handler(std::function<std::string(const std::string&, const std::string&)> handler) {
     ai_handler_ = handler;
 }
 
+void DISVM::set_async_ai_handler(std::function<void(const std::string&, const std::string&, AIResume)> handler) {
+    async_ai_handler_ = handler;
+}
+
+void DISVM::set_wake_handler(std::function<void()> waker) {
+    wake_handler_ = waker;
+}
+
 void DISVM::set_glyph_renderer(std::function<void(const std::string&)> renderer) {
     glyph_renderer_ = renderer;
 }
@@ -186,372 +736,453 @@ void DISVM::set_namespace_mounter(std::function<bool(const std::string&, const s
     namespace_mounter_ = mounter;
 }
 
-void DISVM::execute_instruction(const DISInstruction& inst) {
-    switch (inst.opcode) {
-        case DISOpcode::LOAD:
-        case DISOpcode::STORE:
-        case DISOpcode::POP:
-        case DISOpcode::DUP:
-            handle_load(inst);
-            break;
-            
-        case DISOpcode::ADD:
-        case DISOpcode::SUB:
-        case DISOpcode::MUL:
-        case DISOpcode::DIV:
-        case DISOpcode::MOD:
-            handle_arithmetic(inst);
-            break;
-            
-        case DISOpcode::EQ:
-        case DISOpcode::NE:
-        case DISOpcode::LT:
-        case DISOpcode::GT:
-        case DISOpcode::LE:
-        case DISOpcode::GE:
-            handle_comparison(inst);
-            break;
-            
-        case DISOpcode::JMP:
-        case DISOpcode::JMPT:
-        case DISOpcode::JMPF:
-        case DISOpcode::CALL:
-        case DISOpcode::RET:
-            handle_control_flow(inst);
-            break;
-            
-        case DISOpcode::NEWSTR:
-        case DISOpcode::CONCAT:
-        case DISOpcode::STRLEN:
-            handle_string_ops(inst);
-            break;
-            
-        case DISOpcode::PRINT:
-        case DISOpcode::READ:
-            handle_io_ops(inst);
-            break;
-            
-        case DISOpcode::AI_INIT:
-        case DISOpcode::AI_COMPLETE:
-        case DISOpcode::AI_CHAT:
-            handle_ai_ops(inst);
-            break;
-            
-        case DISOpcode::RENDER_GLYPH:
-        case DISOpcode::SPAWN_VM:
-        case DISOpcode::MOUNT_NS:
-            handle_drawkern_ops(inst);
-            break;
-            
-        case DISOpcode::HALT:
-            halt();
-            break;
-            
-        default:
-            runtime_error("Unknown opcode: " + std::to_string(static_cast<int>(inst.opcode)));
-            break;
-    }
+void DISVM::set_message_receiver(std::function<bool(DISValue&)> receiver) {
+    message_receiver_ = receiver;
 }
 
-void DISVM::handle_load(const DISInstruction& inst) {
-    switch (inst.opcode) {
-        case DISOpcode::LOAD:
-            if (!inst.operands.empty()) {
-                push(inst.operands[0]);
-            }
-            break;
-            
-        case DISOpcode::POP:
+void DISVM::set_message_sender(std::function<bool(const std::string&, const DISValue&)> sender) {
+    message_sender_ = sender;
+}
+
+// Computed goto where the compiler supports it, a switch loop elsewhere
+#if defined(__GNUC__) || defined(__clang__)
+#define DIS_THREADED_DISPATCH 1
+#else
+#define DIS_THREADED_DISPATCH 0
+#endif
+
+template<bool SingleStep>
+void DISVM::execute(size_t budget) {
+    const DISCode::Instruction* code = code_.instructions.data();
+    const DISValue* constants = code_.constants.data();
+    size_t pc = pc_;
+    
+#if DIS_THREADED_DISPATCH
+    // Same order as DISCode::Handler
+    static void* const dispatch_table[DISCode::HANDLER_COUNT] = {
+        &&L_NOP, &&L_PUSH_CONST, &&L_POP, &&L_DUP,
+        &&L_LOAD_GLOBAL, &&L_STORE_GLOBAL, &&L_LOAD_LOCAL, &&L_STORE_LOCAL,
+        &&L_ADD, &&L_SUB, &&L_MUL, &&L_DIV, &&L_MOD,
+        &&L_EQ, &&L_NE, &&L_LT, &&L_GT, &&L_LE, &&L_GE,
+        &&L_JMP, &&L_JMPT, &&L_JMPF, &&L_CALL, &&L_RET, &&L_ENTER,
+        &&L_CONCAT, &&L_STRLEN,
+        &&L_PRINT, &&L_READ, &&L_RECV, &&L_SEND,
+        &&L_AI_INIT, &&L_AI_COMPLETE, &&L_AI_CHAT,
+        &&L_RENDER_GLYPH, &&L_SPAWN_VM, &&L_MOUNT_NS,
+        &&L_HALT, &&L_INVALID, &&L_END
+    };
+#define DIS_OP(name) L_##name:
+#define DIS_DISPATCH() goto *dispatch_table[code[pc].handler]
+#else
+#define DIS_OP(name) case DISCode::name:
+#define DIS_DISPATCH() goto dispatch
+#endif
+
+// Fall through to the next instruction
+#define DIS_NEXT() do { ++pc; if (SingleStep) goto stop; DIS_DISPATCH(); } while (0)
+
+// Like DIS_NEXT for instructions that may have halted the VM
+#define DIS_NEXT_CHECKED() do { if (halted_) { ++pc; goto stop; } DIS_NEXT(); } while (0)
+
+// Transfer control; a VM stopped from outside or out of budget notices at
+// the next branch, since straight-line code always runs out
+#define DIS_JUMP(target) \
+    do { pc = (target); if (SingleStep || !running_ || --budget == 0) goto stop; DIS_DISPATCH(); } while (0)
+
+// Halt with a runtime error reported at this instruction
+#define DIS_FAIL(message) do { pc_ = pc; runtime_error(message); ++pc; goto stop; } while (0)
+
+// Stack underflow halts the VM; jumps leave the pc where it is
+#define DIS_REQUIRE(count, advance) \
+    do { if (stack_.size() < (count)) { pc_ = pc; check_stack_size(count); pc += (advance); goto stop; } } while (0)
+
+// Binary operators work on the two top slots in place
+#define DIS_ARITHMETIC(name, expression) \
+    DIS_OP(name) { \
+        DIS_REQUIRE(2, 1); \
+        DISValue& b = stack_.back(); \
+        DISValue& a = stack_[stack_.size() - 2]; \
+        a = a.type() == DISValue::INT && b.type() == DISValue::INT ? DISValue(int64_t(expression)) \
+                                                                   : DISValue(int64_t(0)); \
+        stack_.pop_back(); \
+        DIS_NEXT(); \
+    }
+
+#define DIS_DIVISION(name, function, message) \
+    DIS_OP(name) { \
+        DIS_REQUIRE(2, 1); \
+        DISValue& b = stack_.back(); \
+        DISValue& a = stack_[stack_.size() - 2]; \
+        bool integers = a.type() == DISValue::INT && b.type() == DISValue::INT; \
+        bool by_zero = integers && b.int_value() == 0; \
+        a = integers && !by_zero ? DISValue(function(a.int_value(), b.int_value())) : DISValue(int64_t(0)); \
+        stack_.pop_back(); \
+        if (by_zero) { \
+            DIS_FAIL(message); \
+        } \
+        DIS_NEXT(); \
+    }
+
+#define DIS_COMPARISON(name, op) \
+    DIS_OP(name) { \
+        DIS_REQUIRE(2, 1); \
+        DISValue& b = stack_.back(); \
+        DISValue& a = stack_[stack_.size() - 2]; \
+        bool result = a.type() == DISValue::INT && b.type() == DISValue::INT && a.int_value() op b.int_value(); \
+        a = DISValue(int64_t(result ? 1 : 0)); \
+        stack_.pop_back(); \
+        DIS_NEXT(); \
+    }
+
+#define DIS_COLD(name, method) \
+    DIS_OP(name) { \
+        pc_ = pc; \
+        method(); \
+        DIS_NEXT_CHECKED(); \
+    }
+
+// Cold opcodes that may park the VM like RECV, with the pc left on them
+// so they run again when resumed
+#define DIS_PARKING(name, method) \
+    DIS_OP(name) { \
+        pc_ = pc; \
+        if (!method()) { \
+            waiting_ = true; \
+            running_ = false; \
+            goto stop; \
+        } \
+        DIS_NEXT_CHECKED(); \
+    }
+    
+    try {
+#if DIS_THREADED_DISPATCH
+        DIS_DISPATCH();
+#else
+    dispatch:
+        switch (code[pc].handler) {
+#endif
+        DIS_OP(NOP) {
+            DIS_NEXT();
+        }
+        DIS_OP(PUSH_CONST) {
+            stack_.push_back(constants[code[pc].operand]);
+            DIS_NEXT();
+        }
+        DIS_OP(POP) {
             if (!stack_.empty()) {
-                pop();
+                stack_.pop_back();
             }
-            break;
-            
-        case DISOpcode::DUP:
+            DIS_NEXT();
+        }
+        DIS_OP(DUP) {
             if (!stack_.empty()) {
-                push(peek());
+                DISValue top = stack_.back();
+                stack_.push_back(std::move(top));
             }
-            break;
-            
+            DIS_NEXT();
+        }
+        
+        // Slots were checked when lowering, except locals against the frame size
+        DIS_OP(LOAD_GLOBAL) {
+            stack_.push_back(globals_[code[pc].operand]);
+            DIS_NEXT();
+        }
+        DIS_OP(STORE_GLOBAL) {
+            DIS_REQUIRE(1, 1);
+            globals_[code[pc].operand] = std::move(stack_.back());
+            stack_.pop_back();
+            DIS_NEXT();
+        }
+        DIS_OP(LOAD_LOCAL) {
+            size_t slot = frame_base_ + code[pc].operand;
+            if (slot >= locals_.size()) {
+                DIS_FAIL("Local slot out of range: " + std::to_string(code[pc].operand));
+            }
+            stack_.push_back(locals_[slot]);
+            DIS_NEXT();
+        }
+        DIS_OP(STORE_LOCAL) {
+            DIS_REQUIRE(1, 1);
+            size_t slot = frame_base_ + code[pc].operand;
+            if (slot >= locals_.size()) {
+                DIS_FAIL("Local slot out of range: " + std::to_string(code[pc].operand));
+            }
+            locals_[slot] = std::move(stack_.back());
+            stack_.pop_back();
+            DIS_NEXT();
+        }
+        
+        DIS_ARITHMETIC(ADD, wrapping_add(a.int_value(), b.int_value()))
+        DIS_ARITHMETIC(SUB, wrapping_sub(a.int_value(), b.int_value()))
+        DIS_ARITHMETIC(MUL, wrapping_mul(a.int_value(), b.int_value()))
+        DIS_DIVISION(DIV, wrapping_div, "Division by zero")
+        DIS_DIVISION(MOD, wrapping_mod, "Modulo by zero")
+        
+        DIS_COMPARISON(EQ, ==)
+        DIS_COMPARISON(NE, !=)
+        DIS_COMPARISON(LT, <)
+        DIS_COMPARISON(GT, >)
+        DIS_COMPARISON(LE, <=)
+        DIS_COMPARISON(GE, >=)
+        
+        DIS_OP(JMP) {
+            DIS_JUMP(code[pc].operand);
+        }
+        DIS_OP(JMPT) {
+            DIS_REQUIRE(1, 0);
+            bool taken = stack_.back().truthy();
+            stack_.pop_back();
+            DIS_JUMP(taken ? code[pc].operand : pc + 1);
+        }
+        DIS_OP(JMPF) {
+            DIS_REQUIRE(1, 0);
+            bool taken = !stack_.back().truthy();
+            stack_.pop_back();
+            DIS_JUMP(taken ? code[pc].operand : pc + 1);
+        }
+        DIS_OP(CALL) {
+            call_stack_.push_back(Frame{pc + 1, code[pc].operand, frame_base_});
+            frame_base_ = locals_.size();
+            DIS_JUMP(code[pc].operand);
+        }
+        DIS_OP(RET) {
+            if (call_stack_.empty()) {
+                pc_ = pc;
+                halt();
+                goto stop;
+            }
+            Frame frame = call_stack_.back();
+            call_stack_.pop_back();
+            locals_.resize(frame_base_);
+            frame_base_ = frame.caller_base;
+            DIS_JUMP(frame.return_address);
+        }
+        DIS_OP(ENTER) {
+            locals_.resize(frame_base_ + code[pc].operand);
+            DIS_NEXT();
+        }
+        
+        DIS_COLD(CONCAT, op_concat)
+        DIS_COLD(STRLEN, op_strlen)
+        DIS_COLD(PRINT, op_print)
+        DIS_COLD(READ, op_read)
+        DIS_COLD(SEND, op_send)
+        DIS_OP(RECV) {
+            DISValue message;
+            if (!message_receiver_ || !message_receiver_(message)) {
+                // Park with the pc on RECV so it retries when resumed
+                waiting_ = true;
+                running_ = false;
+                goto stop;
+            }
+            stack_.push_back(std::move(message));
+            DIS_NEXT();
+        }
+        DIS_COLD(AI_INIT, op_ai_init)
+        DIS_PARKING(AI_COMPLETE, op_ai_complete)
+        DIS_PARKING(AI_CHAT, op_ai_chat)
+        DIS_COLD(RENDER_GLYPH, op_render_glyph)
+        DIS_COLD(SPAWN_VM, op_spawn_vm)
+        DIS_COLD(MOUNT_NS, op_mount_ns)
+        
+        DIS_OP(HALT) {
+            pc_ = pc;
+            halt();
+            ++pc;
+            goto stop;
+        }
+        DIS_OP(INVALID) {
+            DIS_FAIL("Invalid instruction: opcode " + std::to_string(static_cast<int>(code[pc].opcode)));
+        }
+        DIS_OP(END) {
+            goto stop;
+        }
+#if !DIS_THREADED_DISPATCH
         default:
-            break;
+            goto stop;
+        }
+#endif
+    } catch (const std::exception& e) {
+        pc_ = pc;
+        runtime_error("Exception during execution: " + std::string(e.what()));
+        return;
     }
+    
+stop:
+    pc_ = pc;
+
+#undef DIS_PARKING
+#undef DIS_COLD
+#undef DIS_COMPARISON
+#undef DIS_DIVISION
+#undef DIS_ARITHMETIC
+#undef DIS_REQUIRE
+#undef DIS_FAIL
+#undef DIS_JUMP
+#undef DIS_NEXT_CHECKED
+#undef DIS_NEXT
+#undef DIS_DISPATCH
+#undef DIS_OP
 }
 
-void DISVM::handle_arithmetic(const DISInstruction& inst) {
+void DISVM::op_concat() {
     if (!check_stack_size(2)) return;
-    
     DISValue b = pop();
     DISValue a = pop();
-    DISValue result(int64_t(0));
+    push(DISValue(a.string_value() + b.string_value()));
+}
+
+void DISVM::op_strlen() {
+    if (!check_stack_size(1)) return;
+    DISValue str = pop();
+    push(DISValue(static_cast<int64_t>(str.string_value().length())));
+}
+
+void DISVM::op_print() {
+    if (!check_stack_size(1)) return;
+    DISValue value = pop();
+    if (value.type() == DISValue::STRING) {
+        std::cout << value.string_value();
+    } else if (value.type() == DISValue::INT) {
+        std::cout << value.int_value();
+    }
+    std::cout.flush();
+}
+
+void DISVM::op_read() {
+    // Simplified - just push a placeholder
+    push(DISValue("input"));
+}
+
+void DISVM::op_send() {
+    if (!check_stack_size(2)) return;
+    DISValue message = pop();
+    DISValue target = pop();
+    bool success = message_sender_ && message_sender_(target.string_value(), message);
+    push(DISValue(success ? int64_t(1) : int64_t(0)));
+}
+
+void DISVM::op_ai_init() {
+    if (!check_stack_size(1)) return;
+    DISValue model = pop();
+    std::cout << "🤖 Initializing AI model: " << model.string_value() << std::endl;
+    push(DISValue(int64_t(1))); // Success
+}
+
+bool DISVM::op_ai_complete() {
+    if (pending_ai_) {
+        return resume_async_ai();
+    }
+    if (!check_stack_size(2)) return true;
+    DISValue context = pop();
+    DISValue prompt = pop();
+    
+    std::string response;
+    if (async_ai_handler_) {
+        return start_async_ai(prompt.string_value(), context.string_value());
+    } else if (ai_handler_) {
+        response = ai_handler_(prompt.string_value(), context.string_value());
+    } else {
+        response = "🤖 AI: " + prompt.string_value() + " (completed)";
+    }
     
-    if (a.type == DISValue::INT && b.type == DISValue::INT) {
-        switch (inst.opcode) {
-            case DISOpcode::ADD:
-                result = DISValue(a.int_val + b.int_val);
-                break;
-            case DISOpcode::SUB:
-                result = DISValue(a.int_val - b.int_val);
-                break;
-            case DISOpcode::MUL:
-                result = DISValue(a.int_val * b.int_val);
-                break;
-            case DISOpcode::DIV:
-                if (b.int_val != 0) {
-                    result = DISValue(a.int_val / b.int_val);
-                } else {
-                    runtime_error("Division by zero");
-                }
-                break;
-            case DISOpcode::MOD:
-                if (b.int_val != 0) {
-                    result = DISValue(a.int_val % b.int_val);
-                } else {
-                    runtime_error("Modulo by zero");
-                }
-                break;
-            default:
-                break;
-        }
+    push(DISValue(response));
+    return true;
+}
+
+bool DISVM::op_ai_chat() {
+    if (pending_ai_) {
+        return resume_async_ai();
+    }
+    if (!check_stack_size(1)) return true;
+    DISValue message = pop();
+    std::string response;
+    
+    if (async_ai_handler_) {
+        return start_async_ai(message.string_value(), "chat");
+    } else if (ai_handler_) {
+        response = ai_handler_(message.string_value(), "chat");
+    } else {
+        response = "🤖 AI Chat: Hello! You said: " + message.string_value();
     }
     
-    push(result);
+    push(DISValue(response));
+    return true;
 }
 
-void DISVM::handle_comparison(const DISInstruction& inst) {
-    if (!check_stack_size(2)) return;
-    
-    DISValue b = pop();
-    DISValue a = pop();
-    bool result = false;
-    
-    if (a.type == DISValue::INT && b.type == DISValue::INT) {
-        switch (inst.opcode) {
-            case DISOpcode::EQ: result = a.int_val == b.int_val; break;
-            case DISOpcode::NE: result = a.int_val != b.int_val; break;
-            case DISOpcode::LT: result = a.int_val < b.int_val; break;
-            case DISOpcode::GT: result = a.int_val > b.int_val; break;
-            case DISOpcode::LE: result = a.int_val <= b.int_val; break;
-            case DISOpcode::GE: result = a.int_val >= b.int_val; break;
-            default: break;
+bool DISVM::start_async_ai(const std::string& prompt, const std::string& context) {
+    auto pending = std::make_shared<PendingAI>();
+    pending_ai_ = pending;
+    async_ai_handler_(prompt, context, [pending, waker = wake_handler_](std::string response) {
+        {
+            std::lock_guard<std::mutex> lock(pending->mutex);
+            pending->response = std::move(response);
+            pending->done = true;
         }
-    }
+        if (waker) {
+            waker();
+        }
+    });
     
-    push(DISValue(result ? int64_t(1) : int64_t(0)));
-}
-
-void DISVM::handle_control_flow(const DISInstruction& inst) {
-    switch (inst.opcode) {
-        case DISOpcode::JMP:
-            if (!inst.operands.empty() && inst.operands[0].type == DISValue::INT) {
-                pc_ = inst.operands[0].int_val;
-            }
-            break;
-            
-        case DISOpcode::JMPT:
-            if (!check_stack_size(1)) break;
-            {
-                DISValue condition = pop();
-                if (condition.int_val != 0 && !inst.operands.empty()) {
-                    pc_ = inst.operands[0].int_val;
-                } else {
-                    pc_++;
-                }
-            }
-            break;
-            
-        case DISOpcode::JMPF:
-            if (!check_stack_size(1)) break;
-            {
-                DISValue condition = pop();
-                if (condition.int_val == 0 && !inst.operands.empty()) {
-                    pc_ = inst.operands[0].int_val;
-                } else {
-                    pc_++;
-                }
-            }
-            break;
-            
-        case DISOpcode::CALL:
-            call_stack_.push(pc_ + 1);
-            if (!inst.operands.empty()) {
-                pc_ = inst.operands[0].int_val;
-            }
-            break;
-            
-        case DISOpcode::RET:
-            if (!call_stack_.empty()) {
-                pc_ = call_stack_.top();
-                call_stack_.pop();
-            } else {
-                halt();
-            }
-            break;
-            
-        default:
-            break;
-    }
+    // The handler may have answered already
+    return resume_async_ai();
 }
 
-void DISVM::handle_string_ops(const DISInstruction& inst) {
-    switch (inst.opcode) {
-        case DISOpcode::NEWSTR:
-            if (!inst.operands.empty()) {
-                push(DISValue(inst.operands[0].string_val));
-            }
-            break;
-            
-        case DISOpcode::CONCAT:
-            if (!check_stack_size(2)) break;
-            {
-                DISValue b = pop();
-                DISValue a = pop();
-                std::string result = a.string_val + b.string_val;
-                push(DISValue(result));
-            }
-            break;
-            
-        case DISOpcode::STRLEN:
-            if (!check_stack_size(1)) break;
-            {
-                DISValue str = pop();
-                push(DISValue(static_cast<int64_t>(str.string_val.length())));
-            }
-            break;
-            
-        default:
-            break;
+bool DISVM::resume_async_ai() {
+    std::string response;
+    {
+        std::lock_guard<std::mutex> lock(pending_ai_->mutex);
+        if (!pending_ai_->done) {
+            return false;
+        }
+        response = std::move(pending_ai_->response);
     }
+    pending_ai_.reset();
+    push(DISValue(response));
+    return true;
 }
 
-void DISVM::handle_io_ops(const DISInstruction& inst) {
-    switch (inst.opcode) {
-        case DISOpcode::PRINT:
-            if (!check_stack_size(1)) break;
-            {
-                DISValue value = pop();
-                if (value.type == DISValue::STRING) {
-                    std::cout << value.string_val;
-                } else if (value.type == DISValue::INT) {
-                    std::cout << value.int_val;
-                }
-                std::cout.flush();
-            }
-            break;
-            
-        case DISOpcode::READ:
-            // Simplified - just push a placeholder
-            push(DISValue("input"));
-            break;
-            
-        default:
-            break;
+void DISVM::op_render_glyph() {
+    if (!check_stack_size(1)) return;
+    DISValue glyph = pop();
+    if (glyph_renderer_) {
+        glyph_renderer_(glyph.string_value());
+    } else {
+        std::cout << "🎨 Rendering glyph: " << glyph.string_value() << std::endl;
     }
+    push(DISValue(int64_t(1))); // Success
 }
 
-void DISVM::handle_ai_ops(const DISInstruction& inst) {
-    switch (inst.opcode) {
-        case DISOpcode::AI_INIT:
-            if (!check_stack_size(1)) break;
-            {
-                DISValue model = pop();
-                std::cout << "🤖 Initializing AI model: " << model.string_val << std::endl;
-                push(DISValue(int64_t(1))); // Success
-            }
-            break;
-            
-        case DISOpcode::AI_COMPLETE:
-            if (!check_stack_size(2)) break;
-            {
-                DISValue context = pop();
-                DISValue prompt = pop();
-                
-                std::string response;
-                if (ai_handler_) {
-                    response = ai_handler_(prompt.string_val, context.string_val);
-                } else {
-                    response = "🤖 AI: " + prompt.string_val + " (completed)";
-                }
-                
-                push(DISValue(response));
-            }
-            break;
-            
-        case DISOpcode::AI_CHAT:
-            if (!check_stack_size(1)) break;
-            {
-                DISValue message = pop();
-                std::string response;
-                
-                if (ai_handler_) {
-                    response = ai_handler_(message.string_val, "chat");
-                } else {
-                    response = "🤖 AI Chat: Hello! You said: " + message.string_val;
-                }
-                
-                push(DISValue(response));
-            }
-            break;
-            
-        default:
-            break;
+void DISVM::op_spawn_vm() {
+    if (!check_stack_size(1)) return;
+    DISValue spec = pop();
+    bool success = false;
+    
+    if (vm_spawner_) {
+        success = vm_spawner_(spec.string_value());
+    } else {
+        std::cout << "🚀 Spawning VM: " << spec.string_value() << std::endl;
+        success = true;
     }
+    
+    push(DISValue(success ? int64_t(1) : int64_t(0)));
 }
 
-void DISVM::handle_drawkern_ops(const DISInstruction& inst) {
-    switch (inst.opcode) {
-        case DISOpcode::RENDER_GLYPH:
-            if (!check_stack_size(1)) break;
-            {
-                DISValue glyph = pop();
-                if (glyph_renderer_) {
-                    glyph_renderer_(glyph.string_val);
-                } else {
-                    std::cout << "🎨 Rendering glyph: " << glyph.string_val << std::endl;
-                }
-                push(DISValue(int64_t(1))); // Success
-            }
-            break;
-            
-        case DISOpcode::SPAWN_VM:
-            if (!check_stack_size(1)) break;
-            {
-                DISValue spec = pop();
-                bool success = false;
-                
-                if (vm_spawner_) {
-                    success = vm_spawner_(spec.string_val);
-                } else {
-                    std::cout << "🚀 Spawning VM: " << spec.string_val << std::endl;
-                    success = true;
-                }
-                
-                push(DISValue(success ? int64_t(1) : int64_t(0)));
-            }
-            break;
-            
-        case DISOpcode::MOUNT_NS:
-            if (!check_stack_size(2)) break;
-            {
-                DISValue local_path = pop();
-                DISValue remote_addr = pop();
-                bool success = false;
-                
-                if (namespace_mounter_) {
-                    success = namespace_mounter_(remote_addr.string_val, local_path.string_val);
-                } else {
-                    std::cout << "🔗 Mounting namespace: " << remote_addr.string_val 
-                              << " -> " << local_path.string_val << std::endl;
-                    success = true;
-                }
-                
-                push(DISValue(success ? int64_t(1) : int64_t(0)));
-            }
-            break;
-            
-        default:
-            break;
+void DISVM::op_mount_ns() {
+    if (!check_stack_size(2)) return;
+    DISValue local_path = pop();
+    DISValue remote_addr = pop();
+    bool success = false;
+    
+    if (namespace_mounter_) {
+        success = namespace_mounter_(remote_addr.string_value(), local_path.string_value());
+    } else {
+        std::cout << "🔗 Mounting namespace: " << remote_addr.string_value() 
+                  << " -> " << local_path.string_value() << std::endl;
+        success = true;
     }
+    
+    push(DISValue(success ? int64_t(1) : int64_t(0)));
 }
 
 bool DISVM::check_stack_size(size_t required) const {
@@ -571,17 +1202,32 @@ void DISVM::runtime_error(const std::string& message) {
 
 void DISVM::dump_stack() const {
     std::cout << "Stack (" << stack_.size() << " items):" << std::endl;
-    // Note: Can't easily iterate through std::stack, so just show size
+    for (size_t i = stack_.size(); i-- > 0;) {
+        const DISValue& value = stack_[i];
+        std::cout << "  [" << i << "] ";
+        if (value.type() == DISValue::INT) {
+            std::cout << value.int_value();
+        } else if (value.type() == DISValue::FLOAT) {
+            std::cout << value.float_value();
+        } else if (value.type() == DISValue::STRING) {
+            std::cout << "\"" << value.string_value() << "\"";
+        } else if (value.type() == DISValue::LIST) {
+            std::cout << "list(" << value.list_value().size() << ")";
+        } else {
+            std::cout << "ref";
+        }
+        std::cout << std::endl;
+    }
 }
 
 void DISVM::dump_globals() const {
     std::cout << "Globals:" << std::endl;
-    for (const auto& [name, value] : globals_) {
+    for (const auto& [name, value] : get_globals()) {
         std::cout << "  " << name << " = ";
-        if (value.type == DISValue::INT) {
-            std::cout << value.int_val;
-        } else if (value.type == DISValue::STRING) {
-            std::cout << "\"" << value.string_val << "\"";
+        if (value.type() == DISValue::INT) {
+            std::cout << value.int_value();
+        } else if (value.type() == DISValue::STRING) {
+            std::cout << "\"" << value.string_value() << "\"";
         }
         std::cout << std::endl;
     }
@@ -602,6 +1248,10 @@ std::string DISVM::get_instruction_info(size_t pc) const {
         case DISOpcode::STORE: ss << "STORE"; break;
         case DISOpcode::POP: ss << "POP"; break;
         case DISOpcode::DUP: ss << "DUP"; break;
+        case DISOpcode::LOADG: ss << "LOADG"; break;
+        case DISOpcode::STOREG: ss << "STOREG"; break;
+        case DISOpcode::LOADL: ss << "LOADL"; break;
+        case DISOpcode::STOREL: ss << "STOREL"; break;
         case DISOpcode::ADD: ss << "ADD"; break;
         case DISOpcode::SUB: ss << "SUB"; break;
         case DISOpcode::MUL: ss << "MUL"; break;
@@ -618,11 +1268,14 @@ std::string DISVM::get_instruction_info(size_t pc) const {
         case DISOpcode::JMPF: ss << "JMPF"; break;
         case DISOpcode::CALL: ss << "CALL"; break;
         case DISOpcode::RET: ss << "RET"; break;
+        case DISOpcode::ENTER: ss << "ENTER"; break;
         case DISOpcode::NEWSTR: ss << "NEWSTR"; break;
         case DISOpcode::CONCAT: ss << "CONCAT"; break;
         case DISOpcode::STRLEN: ss << "STRLEN"; break;
         case DISOpcode::PRINT: ss << "PRINT"; break;
         case DISOpcode::READ: ss << "READ"; break;
+        case DISOpcode::RECV: ss << "RECV"; break;
+        case DISOpcode::SEND: ss << "SEND"; break;
         case DISOpcode::AI_INIT: ss << "AI_INIT"; break;
         case DISOpcode::AI_COMPLETE: ss << "AI_COMPLETE"; break;
         case DISOpcode::AI_CHAT: ss << "AI_CHAT"; break;
@@ -638,10 +1291,10 @@ std::string DISVM::get_instruction_info(size_t pc) const {
         for (size_t i = 0; i < inst.operands.size(); ++i) {
             if (i > 0) ss << ", ";
             const auto& operand = inst.operands[i];
-            if (operand.type == DISValue::INT) {
-                ss << operand.int_val;
-            } else if (operand.type == DISValue::STRING) {
-                ss << "\"" << operand.string_val << "\"";
+            if (operand.type() == DISValue::INT) {
+                ss << operand.int_value();
+            } else if (operand.type() == DISValue::STRING) {
+                ss << "\"" << operand.string_value() << "\"";
             }
         }
     }
@@ -746,6 +1399,10 @@ void DISVM::continue_execution() {
     std::cout << "▶️ Continuing execution from PC " << pc_ << std::endl;
     
     // Continue until breakpoint or halt
+    if (breakpoints_.empty()) {
+        execute<false>();
+        return;
+    }
     while (running_ && !halted_ && !at_breakpoint_ && pc_ < program_.instructions.size()) {
         step();
     }
@@ -757,16 +1414,12 @@ bool DISVM::is_at_breakpoint() const {
 
 // Call stack inspection
 std::vector<size_t> DISVM::get_call_stack() const {
+    // Return addresses, outermost call first
     std::vector<size_t> result;
-    std::stack<size_t> temp = call_stack_;
-    
-    while (!temp.empty()) {
-        result.push_back(temp.top());
-        temp.pop();
+    result.reserve(call_stack_.size());
+    for (const auto& frame : call_stack_) {
+        result.push_back(frame.return_address);
     }
-    
-    // Reverse to show most recent call first
-    std::reverse(result.begin(), result.end());
     return result;
 }
 
@@ -785,7 +1438,9 @@ DISProgram LimboCompiler::compile(const std::string& source) {
     errors_.clear();
     
     std::vector<std::string> tokens = tokenize(source);
-    return parse_tokens(tokens);
+    DISProgram program = parse_tokens(tokens);
+    program.source_limbo = source;
+    return program;
 }
 
 std::vector<std::string> LimboCompiler::tokenize(const std::string& source) {
@@ -800,9 +1455,84 @@ std::vector<std::string> LimboCompiler::tokenize(const std::string& source) {
     return tokens;
 }
 
+std::optional<DISValue> LimboCompiler::parse_literal(const std::string& token) {
+    if (token.size() >= 2 && token.front() == '"' && token.back() == '"') {
+        return DISValue(token.substr(1, token.size() - 2));
+    }
+    if (token.empty()) {
+        return std::nullopt;
+    }
+    size_t digits = token[0] == '-' ? 1 : 0;
+    if (digits == token.size() ||
+        !std::all_of(token.begin() + digits, token.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        return std::nullopt;
+    }
+    try {
+        return DISValue(static_cast<int64_t>(std::stoll(token)));
+    } catch (const std::out_of_range&) {
+        return std::nullopt;
+    }
+}
+
+// Names are resolved here: globals and locals to slots, labels and
+// functions to absolute addresses. References to labels not yet seen are
+// patched at the end, and anything left unresolved is an error.
 DISProgram LimboCompiler::parse_tokens(const std::vector<std::string>& tokens) {
     DISProgram program;
-    program.source_limbo = "";
+    
+    struct Fixup {
+        size_t address;
+        std::string label;
+    };
+    std::vector<Fixup> fixups;
+    std::map<std::string, uint32_t> global_slots;
+    
+    // Function being compiled: its locals and the instructions to patch at "end"
+    DISFunction* function = nullptr;
+    std::map<std::string, uint32_t> local_slots;
+    size_t skip_jump = 0;
+    
+    auto emit = [&program](DISOpcode opcode) { program.add_instruction(DISInstruction(opcode)); };
+    auto emit_with = [&program](DISOpcode opcode, int64_t operand) {
+        program.add_instruction(DISInstruction(opcode, DISValue(operand)));
+    };
+    auto emit_jump = [&](DISOpcode opcode, const std::string& label) {
+        fixups.push_back(Fixup{program.instructions.size(), label});
+        emit_with(opcode, 0);
+    };
+    // Locals shadow globals
+    auto emit_variable = [&](bool store, const std::string& name) -> bool {
+        auto local = local_slots.find(name);
+        if (local != local_slots.end()) {
+            emit_with(store ? DISOpcode::STOREL : DISOpcode::LOADL, local->second);
+            return true;
+        }
+        auto global = global_slots.find(name);
+        if (global != global_slots.end()) {
+            emit_with(store ? DISOpcode::STOREG : DISOpcode::LOADG, global->second);
+            return true;
+        }
+        add_error("Undefined variable: " + name);
+        return false;
+    };
+    auto operand = [&tokens](size_t& i) -> const std::string* {
+        return i + 1 < tokens.size() ? &tokens[++i] : nullptr;
+    };
+    
+    static const std::map<std::string, DISOpcode> simple_opcodes = {
+        {"dup", DISOpcode::DUP}, {"pop", DISOpcode::POP},
+        {"add", DISOpcode::ADD}, {"sub", DISOpcode::SUB}, {"mul", DISOpcode::MUL},
+        {"div", DISOpcode::DIV}, {"mod", DISOpcode::MOD},
+        {"eq", DISOpcode::EQ}, {"ne", DISOpcode::NE}, {"lt", DISOpcode::LT},
+        {"gt", DISOpcode::GT}, {"le", DISOpcode::LE}, {"ge", DISOpcode::GE},
+        {"concat", DISOpcode::CONCAT}, {"strlen", DISOpcode::STRLEN},
+        {"recv", DISOpcode::RECV}, {"send", DISOpcode::SEND},
+        {"ret", DISOpcode::RET}, {"halt", DISOpcode::HALT}
+    };
+    static const std::map<std::string, DISOpcode> jump_opcodes = {
+        {"jmp", DISOpcode::JMP}, {"jmpt", DISOpcode::JMPT},
+        {"jmpf", DISOpcode::JMPF}, {"call", DISOpcode::CALL}
+    };
     
     // Very simplified compiler - just handle basic cases for demo
     for (size_t i = 0; i < tokens.size(); i++) {
@@ -810,7 +1540,12 @@ DISProgram LimboCompiler::parse_tokens(const std::vector<std::string>& tokens) {
         
         if (token == "print") {
             if (i + 1 < tokens.size()) {
-                program.add_instruction(DISInstruction(DISOpcode::NEWSTR, DISValue(tokens[i + 1])));
+                const std::string& value = tokens[i + 1];
+                if (local_slots.count(value) || global_slots.count(value)) {
+                    emit_variable(false, value);
+                } else {
+                    program.add_instruction(DISInstruction(DISOpcode::NEWSTR, DISValue(value)));
+                }
                 program.add_instruction(DISInstruction(DISOpcode::PRINT));
                 i++; // Skip next token
             }
@@ -827,11 +1562,183 @@ DISProgram LimboCompiler::parse_tokens(const std::vector<std::string>& tokens) {
                 program.add_instruction(DISInstruction(DISOpcode::RENDER_GLYPH));
                 i++; // Skip next token
             }
-        } else if (token == "halt") {
-            program.add_instruction(DISInstruction(DISOpcode::HALT));
+        } else if (token == "global") {
+            // global NAME [literal]
+            const std::string* name = operand(i);
+            if (!name) {
+                add_error("Expected a name after global");
+            } else if (global_slots.count(*name)) {
+                add_error("Global already declared: " + *name);
+            } else {
+                std::optional<DISValue> initial;
+                if (i + 1 < tokens.size()) {
+                    initial = parse_literal(tokens[i + 1]);
+                }
+                if (initial) {
+                    i++;
+                }
+                global_slots[*name] = program.add_global(*name, initial.value_or(DISValue()));
+            }
+        } else if (token == "local") {
+            const std::string* name = operand(i);
+            if (!name) {
+                add_error("Expected a name after local");
+            } else if (!function) {
+                add_error("Local outside a function: " + *name);
+            } else if (local_slots.count(*name)) {
+                add_error("Local already declared: " + *name);
+            } else if (function->locals.size() >= DISCode::MAX_LOCALS) {
+                add_error("Too many locals in " + function->name);
+            } else {
+                local_slots[*name] = static_cast<uint32_t>(function->locals.size());
+                function->locals.push_back(*name);
+            }
+        } else if (token == "func") {
+            // Functions are compiled inline behind a jump that skips them
+            const std::string* name = operand(i);
+            if (!name) {
+                add_error("Expected a name after func");
+            } else if (function) {
+                add_error("Nested function: " + *name);
+            } else if (program.labels.count(*name)) {
+                add_error("Duplicate label: " + *name);
+            } else {
+                skip_jump = program.instructions.size();
+                emit_with(DISOpcode::JMP, 0);
+                program.add_label(*name);
+                program.functions.push_back(DISFunction{*name, program.instructions.size(), {}});
+                function = &program.functions.back();
+                emit_with(DISOpcode::ENTER, 0);
+            }
+        } else if (token == "end") {
+            if (!function) {
+                add_error("end outside a function");
+            } else {
+                emit(DISOpcode::RET);
+                program.instructions[function->entry].operands[0] =
+                    DISValue(static_cast<int64_t>(function->locals.size()));
+                program.instructions[skip_jump].operands[0] =
+                    DISValue(static_cast<int64_t>(program.instructions.size()));
+                function = nullptr;
+                local_slots.clear();
+            }
+        } else if (token == "push") {
+            const std::string* value = operand(i);
+            std::optional<DISValue> literal = value ? parse_literal(*value) : std::nullopt;
+            if (literal) {
+                program.add_instruction(DISInstruction(DISOpcode::LOAD, *literal));
+            } else {
+                add_error("Expected a literal after push");
+            }
+        } else if (token == "load" || token == "store") {
+            const std::string* name = operand(i);
+            if (name) {
+                emit_variable(token == "store", *name);
+            } else {
+                add_error("Expected a name after " + token);
+            }
+        } else if (jump_opcodes.count(token)) {
+            const std::string* label = operand(i);
+            if (label) {
+                emit_jump(jump_opcodes.at(token), *label);
+            } else {
+                add_error("Expected a label after " + token);
+            }
+        } else if (simple_opcodes.count(token)) {
+            emit(simple_opcodes.at(token));
+        } else if (token.size() > 1 && token.back() == ':') {
+            std::string label = token.substr(0, token.size() - 1);
+            if (program.labels.count(label)) {
+                add_error("Duplicate label: " + label);
+            } else {
+                program.add_label(label);
+            }
+        }
+    }
+    
+    if (function) {
+        add_error("Missing end for function: " + function->name);
+    }
+    
+    for (const auto& fixup : fixups) {
+        auto address = program.get_label_address(fixup.label);
+        if (address) {
+            program.instructions[fixup.address].operands[0] = DISValue(static_cast<int64_t>(*address));
+        } else {
+            add_error("Undefined label: " + fixup.label);
+        }
+    }
+    
+    return program;
+}
+
+// DISBytecodeCache implementation
+DISBytecodeCache::DISBytecodeCache(std::string directory)
+    : directory_(std::move(directory)), hits_(0), misses_(0) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+}
+
+std::string DISBytecodeCache::path_for(const std::string& source) const {
+    // FNV-1a 64; the format version is part of the name so old entries are never read
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : source) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+    }
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << hash
+         << ".v" << std::dec << static_cast<int>(DISProgram::FORMAT_VERSION) << ".disb";
+    return (std::filesystem::path(directory_) / name.str()).string();
+}
+
+std::optional<DISProgram> DISBytecodeCache::load(const std::string& source) const {
+    std::ifstream file(path_for(source), std::ios::binary | std::ios::ate);
+    std::optional<DISProgram> program;
+    if (file) {
+        std::string image(static_cast<size_t>(file.tellg()), '\0');
+        file.seekg(0);
+        if (file.read(image.data(), static_cast<std::streamsize>(image.size()))) {
+            program = DISProgram::deserialize(image);
+        }
+    }
+    
+    if (program && program->source_limbo == source) {
+        hits_++;
+        return program;
+    }
+    misses_++;
+    return std::nullopt;
+}
+
+bool DISBytecodeCache::store(const DISProgram& program) const {
+    std::string path = path_for(program.source_limbo);
+    std::string temporary = path + ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    std::string image = program.serialize();
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.write(image.data(), static_cast<std::streamsize>(image.size()))) {
+            return false;
         }
     }
     
+    std::error_code ec;
+    std::filesystem::rename(temporary, path, ec);
+    if (ec) {
+        std::filesystem::remove(temporary, ec);
+        return false;
+    }
+    return true;
+}
+
+DISProgram DISBytecodeCache::get_or_compile(const std::string& source, LimboCompiler& compiler) const {
+    if (auto cached = load(source)) {
+        return std::move(*cached);
+    }
+    
+    DISProgram program = compiler.compile(source);
+    if (!compiler.has_errors()) {
+        store(program);
+    }
     return program;
 }
 
@@ -895,103 +1802,378 @@ DISProgram DISProgramFactory::create_drawkern_renderer() {
     return program;
 }
 
-DISProgram DISProgramFactory::from_limbo_source(const std::string& source) {
+DISProgram DISProgramFactory::from_limbo_source(const std::string& source, const DISBytecodeCache* cache) {
     LimboCompiler compiler;
-    return compiler.compile(source);
+    return cache ? cache->get_or_compile(source, compiler) : compiler.compile(source);
 }
 
 // DISVMManager implementation
-DISVMManager::DISVMManager() : next_vm_id_(1) {
+DISVMManager::DISVMManager(size_t worker_count)
+    : next_vm_id_(1), next_worker_(0), queued_(0), slice_budget_(DEFAULT_SLICE_BUDGET), shutting_down_(false) {
+    if (worker_count == 0) {
+        worker_count = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    workers_.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers_[i]->thread = std::thread([this, i]() { worker_loop(i); });
+    }
 }
 
 DISVMManager::~DISVMManager() {
-    // Clean up all VMs
-    for (auto& [vm_id, vm] : vms_) {
-        vm->halt();
+    // Workers finish their current slice; queued and waiting VMs are dropped
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        shutting_down_ = true;
+    }
+    idle_cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker->thread.join();
     }
 }
 
 std::string DISVMManager::create_vm(const DISProgram& program) {
-    std::string vm_id = generate_vm_id();
-    
-    auto vm = std::make_unique<DISVM>();
-    if (!vm->load_program(program)) {
+    auto task = std::make_shared<VMTask>();
+    task->id = generate_vm_id();
+    task->vm = std::make_unique<DISVM>();
+    if (!task->vm->load_program(program)) {
         return "";
     }
     
-    vms_[vm_id] = std::move(vm);
-    vm_message_queues_[vm_id] = {};
+    // The VM lives inside its task, so the hooks can hold a plain pointer
+    VMTask* raw = task.get();
+    task->vm->set_message_receiver([raw](DISValue& message) {
+        std::lock_guard<std::mutex> lock(raw->mailbox_mutex);
+        if (raw->mailbox.empty()) {
+            return false;
+        }
+        message = std::move(raw->mailbox.front());
+        raw->mailbox.pop_front();
+        return true;
+    });
+    task->vm->set_message_sender([this, raw](const std::string& target, const DISValue& message) {
+        if (target.empty()) {
+            std::lock_guard<std::mutex> lock(raw->mailbox_mutex);
+            raw->outbox.push_back(message);
+            return true;
+        }
+        return send_message(target, message);
+    });
+    
+    // Responses may outlive the task, so wakeups hold it weakly
+    std::weak_ptr<VMTask> weak = task;
+    task->vm->set_wake_handler([this, weak]() {
+        if (auto woken = weak.lock()) {
+            wake(woken);
+        }
+    });
+    
+    std::string vm_id = task->id;
+    {
+        std::unique_lock<std::shared_mutex> lock(vms_mutex_);
+        if (ai_handler_) {
+            task->vm->set_async_ai_handler([handler = ai_handler_, vm_id](const std::string& prompt, const std::string& context,
+                                                                          DISVM::AIResume resume) {
+                handler(vm_id, prompt, context, std::move(resume));
+            });
+        }
+        vms_[vm_id] = std::move(task);
+    }
     
     std::cout << "Created DIS VM: " << vm_id << std::endl;
     return vm_id;
 }
 
 bool DISVMManager::start_vm(const std::string& vm_id) {
-    auto it = vms_.find(vm_id);
-    if (it == vms_.end()) {
+    auto task = find_task(vm_id);
+    if (!task) {
         return false;
     }
     
-    // Run VM in separate thread
-    std::thread vm_thread([&vm = it->second]() {
-        vm->run();
-    });
-    vm_thread.detach();
+    {
+        std::lock_guard<std::mutex> lock(task->mailbox_mutex);
+        if (task->state != VMState::CREATED) {
+            return false;
+        }
+        task->state = VMState::RUNNABLE;
+    }
+    enqueue(task);
     
     std::cout << "Started DIS VM: " << vm_id << std::endl;
     return true;
 }
 
 bool DISVMManager::stop_vm(const std::string& vm_id) {
-    auto it = vms_.find(vm_id);
-    if (it == vms_.end()) {
+    auto task = find_task(vm_id);
+    if (!task) {
         return false;
     }
     
-    it->second->halt();
+    // A running VM stops at the end of its slice, a queued one when it is
+    // next picked up; one that holds no worker stops here
+    task->stop_requested = true;
+    bool idle;
+    {
+        std::lock_guard<std::mutex> lock(task->mailbox_mutex);
+        idle = task->state == VMState::CREATED || task->state == VMState::WAITING;
+    }
+    if (idle) {
+        finish(*task);
+    }
+    
     std::cout << "Stopped DIS VM: " << vm_id << std::endl;
     return true;
 }
 
 bool DISVMManager::destroy_vm(const std::string& vm_id) {
-    auto it = vms_.find(vm_id);
-    if (it == vms_.end()) {
+    if (!stop_vm(vm_id)) {
         return false;
     }
     
-    it->second->halt();
-    vms_.erase(it);
-    vm_message_queues_.erase(vm_id);
+    // A worker still running the VM keeps the task alive until its slice ends
+    {
+        std::unique_lock<std::shared_mutex> lock(vms_mutex_);
+        vms_.erase(vm_id);
+    }
     
     std::cout << "Destroyed DIS VM: " << vm_id << std::endl;
     return true;
 }
 
+bool DISVMManager::send_message(const std::string& vm_id, const DISValue& message) {
+    auto task = find_task(vm_id);
+    if (!task) {
+        return false;
+    }
+    
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(task->mailbox_mutex);
+        if (task->state == VMState::HALTED) {
+            return false;
+        }
+        task->mailbox.push_back(message);
+        if (task->state == VMState::WAITING) {
+            task->state = VMState::RUNNABLE;
+            wake = true;
+        }
+    }
+    if (wake) {
+        enqueue(task);
+    }
+    return true;
+}
+
+std::vector<DISValue> DISVMManager::get_messages(const std::string& vm_id) {
+    auto task = find_task(vm_id);
+    if (!task) {
+        return {};
+    }
+    
+    std::lock_guard<std::mutex> lock(task->mailbox_mutex);
+    std::vector<DISValue> messages;
+    messages.swap(task->outbox);
+    return messages;
+}
+
+bool DISVMManager::wait_for_vm(const std::string& vm_id, std::chrono::milliseconds timeout) {
+    auto task = find_task(vm_id);
+    if (!task) {
+        return false;
+    }
+    
+    std::unique_lock<std::mutex> lock(done_mutex_);
+    return done_cv_.wait_for(lock, timeout, [&task]() { return task->state == VMState::HALTED; });
+}
+
+void DISVMManager::set_ai_handler(AIHandler handler) {
+    std::unique_lock<std::shared_mutex> lock(vms_mutex_);
+    ai_handler_ = std::move(handler);
+}
+
 std::vector<std::string> DISVMManager::list_vms() const {
+    std::shared_lock<std::shared_mutex> lock(vms_mutex_);
     std::vector<std::string> vm_list;
-    for (const auto& [vm_id, vm] : vms_) {
+    vm_list.reserve(vms_.size());
+    for (const auto& [vm_id, task] : vms_) {
         vm_list.push_back(vm_id);
     }
     return vm_list;
 }
 
 bool DISVMManager::is_vm_running(const std::string& vm_id) const {
-    auto it = vms_.find(vm_id);
-    return it != vms_.end() && it->second->is_running();
+    auto task = find_task(vm_id);
+    if (!task) {
+        return false;
+    }
+    VMState state = task->state;
+    return state == VMState::RUNNABLE || state == VMState::RUNNING || state == VMState::WAITING;
 }
 
 std::string DISVMManager::get_vm_status(const std::string& vm_id) const {
-    auto it = vms_.find(vm_id);
-    if (it == vms_.end()) {
+    auto task = find_task(vm_id);
+    if (!task) {
         return "not found";
     }
     
-    return it->second->is_running() ? "running" : "stopped";
+    switch (task->state.load()) {
+        case VMState::CREATED: return "created";
+        case VMState::RUNNABLE: return "runnable";
+        case VMState::RUNNING: return "running";
+        case VMState::WAITING: return "waiting";
+        case VMState::HALTED: return "stopped";
+    }
+    return "stopped";
 }
 
 std::string DISVMManager::generate_vm_id() {
     return "vm_" + std::to_string(next_vm_id_++);
 }
 
+std::shared_ptr<DISVMManager::VMTask> DISVMManager::find_task(const std::string& vm_id) const {
+    std::shared_lock<std::shared_mutex> lock(vms_mutex_);
+    auto it = vms_.find(vm_id);
+    return it != vms_.end() ? it->second : nullptr;
+}
+
+// The worker running the current thread, so yields and wakeups from
+// inside a slice stay on the same queue
+static thread_local const DISVMManager* current_manager = nullptr;
+static thread_local size_t current_worker = 0;
+
+void DISVMManager::worker_loop(size_t index) {
+    current_manager = this;
+    current_worker = index;
+    
+    while (true) {
+        std::shared_ptr<VMTask> task = next_task(index);
+        if (!task) {
+            std::unique_lock<std::mutex> lock(idle_mutex_);
+            idle_cv_.wait(lock, [this]() { return shutting_down_ || queued_ > 0; });
+            if (shutting_down_) {
+                return;
+            }
+            continue;
+        }
+        if (shutting_down_) {
+            return;
+        }
+        run_task(task);
+    }
+}
+
+std::shared_ptr<DISVMManager::VMTask> DISVMManager::next_task(size_t index) {
+    // Own queue first, oldest task first for fairness
+    {
+        Worker& worker = *workers_[index];
+        std::lock_guard<std::mutex> lock(worker.queue_mutex);
+        if (!worker.queue.empty()) {
+            auto task = std::move(worker.queue.front());
+            worker.queue.pop_front();
+            queued_--;
+            return task;
+        }
+    }
+    
+    // Steal the newest task of another worker, leaving its warm front alone
+    for (size_t offset = 1; offset < workers_.size(); ++offset) {
+        Worker& victim = *workers_[(index + offset) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.queue_mutex);
+        if (!victim.queue.empty()) {
+            auto task = std::move(victim.queue.back());
+            victim.queue.pop_back();
+            queued_--;
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void DISVMManager::run_task(const std::shared_ptr<VMTask>& task) {
+    if (task->stop_requested) {
+        finish(*task);
+        return;
+    }
+    
+    task->state = VMState::RUNNING;
+    DISVM::SliceResult result = task->vm->run_slice(slice_budget_);
+    
+    if (result == DISVM::SliceResult::HALTED || task->stop_requested) {
+        finish(*task);
+        return;
+    }
+    
+    if (result == DISVM::SliceResult::WAITING) {
+        // A message, AI response or stop that arrived during the slice found
+        // the VM RUNNING and left it to us, so check for all three before parking
+        bool stopped;
+        {
+            std::lock_guard<std::mutex> lock(task->mailbox_mutex);
+            stopped = task->stop_requested;
+            if (!stopped && task->mailbox.empty() && !task->woken) {
+                task->state = VMState::WAITING;
+                return;
+            }
+            task->woken = false;
+        }
+        if (stopped) {
+            finish(*task);
+            return;
+        }
+    }
+    
+    // Back of this worker's queue; idle workers may steal it
+    task->state = VMState::RUNNABLE;
+    enqueue(task);
+}
+
+void DISVMManager::enqueue(std::shared_ptr<VMTask> task) {
+    size_t index = current_manager == this ? current_worker : next_worker_++ % workers_.size();
+    {
+        Worker& worker = *workers_[index];
+        std::lock_guard<std::mutex> lock(worker.queue_mutex);
+        worker.queue.push_back(std::move(task));
+        queued_++;
+    }
+    // Taking the idle lock orders this with a worker about to sleep
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+    }
+    idle_cv_.notify_one();
+}
+
+void DISVMManager::wake(const std::shared_ptr<VMTask>& task) {
+    if (shutting_down_) {
+        return;
+    }
+    
+    bool runnable = false;
+    {
+        std::lock_guard<std::mutex> lock(task->mailbox_mutex);
+        if (task->state == VMState::WAITING) {
+            task->state = VMState::RUNNABLE;
+            runnable = true;
+        } else if (task->state != VMState::HALTED) {
+            task->woken = true;
+        }
+    }
+    if (runnable) {
+        enqueue(task);
+    }
+}
+
+void DISVMManager::finish(VMTask& task) {
+    {
+        std::lock_guard<std::mutex> lock(task.mailbox_mutex);
+        task.state = VMState::HALTED;
+    }
+    {
+        std::lock_guard<std::mutex> lock(done_mutex_);
+    }
+    done_cv_.notify_all();
+}
+
 } // namespace drawkern
 } // namespace bolt
\ No newline at end of file
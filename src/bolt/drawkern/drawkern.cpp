@@ -41,6 +41,38 @@ void DrawKernClient::send_input(const DrawKernCommand& input) {
     // Send input back to server
 }
 
+bool DrawKernClient::apply_frame(std::string_view payload) {
+    if (!frame_decoder_.decode(payload)) {
+        return false;
+    }
+    
+    // Clear each changed area and draw, in order, the commands under it,
+    // clipped to it: drawing around the area stays as it is, and commands
+    // removed from the frame disappear
+    for (const DrawKernRect& area : frame_decoder_.redraw_areas()) {
+        set_clip(&area);
+        clear_rect(area.x, area.y, area.w, area.h);
+        for (const DrawKernCommand* cmd : frame_decoder_.commands_in(area)) {
+            switch (cmd->op) {
+                case DrawKernOp::RECT: {
+                    DrawKernRect visible = DrawKernRect{cmd->x, cmd->y, cmd->w, cmd->h}.intersected(area);
+                    if (!visible.empty()) {
+                        render_rect(visible.x, visible.y, visible.w, visible.h, cmd->color);
+                    }
+                    break;
+                }
+                case DrawKernOp::STRING:
+                    render_text(cmd->x, cmd->y, cmd->data);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    set_clip(nullptr);
+    return true;
+}
+
 // Example: Create an AI Workbench "glyph" that can be rendered anywhere
 AIWorkbenchGlyph create_bolt_ai_glyph() {
     AIWorkbenchGlyph glyph;
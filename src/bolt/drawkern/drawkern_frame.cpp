@@ -0,0 +1,456 @@
+#include "bolt/drawkern/drawkern.hpp"
+#include <algorithm>
+
+namespace bolt {
+namespace drawkern {
+
+namespace {
+    constexpr uint8_t FRAME_MAGIC[2] = {'D', 'K'};
+    constexpr uint8_t FRAME_VERSION = 1;
+
+    // Slot records
+    constexpr uint8_t SLOT_KEEP = 0;  // Run of unchanged slots
+    constexpr uint8_t SLOT_SET = 1;   // Slot rebuilt from its base and the fields in the mask
+
+    // Field mask bits of a SET record
+    constexpr uint8_t FIELD_OP = 1 << 0;
+    constexpr uint8_t FIELD_X = 1 << 1;
+    constexpr uint8_t FIELD_Y = 1 << 2;
+    constexpr uint8_t FIELD_W = 1 << 3;
+    constexpr uint8_t FIELD_H = 1 << 4;
+    constexpr uint8_t FIELD_COLOR = 1 << 5;
+    constexpr uint8_t FIELD_DATA = 1 << 6;
+    constexpr uint8_t FIELD_ATTRIBUTES = 1 << 7;
+
+    const DrawKernCommand EMPTY_COMMAND{};
+
+    class FrameWriter {
+    public:
+        explicit FrameWriter(std::string& out) : out_(out) {}
+
+        void u8(uint8_t value) { out_.push_back(static_cast<char>(value)); }
+
+        void varint(uint64_t value) {
+            while (value >= 0x80) {
+                out_.push_back(static_cast<char>((value & 0x7f) | 0x80));
+                value >>= 7;
+            }
+            out_.push_back(static_cast<char>(value));
+        }
+
+        void zigzag(int64_t value) {
+            varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+        }
+
+        void bytes(const std::string& value) {
+            varint(value.size());
+            out_ += value;
+        }
+
+    private:
+        std::string& out_;
+    };
+
+    class FrameReader {
+    public:
+        explicit FrameReader(std::string_view in) : in_(in) {}
+
+        bool u8(uint8_t& value) {
+            if (pos_ >= in_.size()) return false;
+            value = static_cast<uint8_t>(in_[pos_++]);
+            return true;
+        }
+
+        bool varint(uint64_t& value) {
+            value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                uint8_t byte;
+                if (!u8(byte)) return false;
+                value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) return true;
+            }
+            return false;
+        }
+
+        bool zigzag(int64_t& value) {
+            uint64_t raw;
+            if (!varint(raw)) return false;
+            value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+            return true;
+        }
+
+        bool bytes(std::string& value) {
+            uint64_t size;
+            if (!varint(size) || size > in_.size() - pos_) return false;
+            value.assign(in_.substr(pos_, size));
+            pos_ += size;
+            return true;
+        }
+
+        size_t remaining() const { return in_.size() - pos_; }
+
+    private:
+        std::string_view in_;
+        size_t pos_ = 0;
+    };
+
+    void write_rect(FrameWriter& writer, const DrawKernRect& rect) {
+        writer.zigzag(rect.x);
+        writer.zigzag(rect.y);
+        writer.varint(static_cast<uint32_t>(rect.w));
+        writer.varint(static_cast<uint32_t>(rect.h));
+    }
+
+    bool read_rect(FrameReader& reader, DrawKernRect& rect) {
+        int64_t x, y;
+        uint64_t w, h;
+        if (!reader.zigzag(x) || !reader.zigzag(y) || !reader.varint(w) || !reader.varint(h)) {
+            return false;
+        }
+        rect = DrawKernRect{static_cast<int32_t>(x), static_cast<int32_t>(y), static_cast<int32_t>(w), static_cast<int32_t>(h)};
+        return true;
+    }
+
+    void write_slot(FrameWriter& writer, const DrawKernCommand& base, const DrawKernCommand& cmd) {
+        uint8_t mask = 0;
+        if (cmd.op != base.op) mask |= FIELD_OP;
+        if (cmd.x != base.x) mask |= FIELD_X;
+        if (cmd.y != base.y) mask |= FIELD_Y;
+        if (cmd.w != base.w) mask |= FIELD_W;
+        if (cmd.h != base.h) mask |= FIELD_H;
+        if (cmd.color != base.color) mask |= FIELD_COLOR;
+        if (cmd.data != base.data) mask |= FIELD_DATA;
+        if (cmd.attributes != base.attributes) mask |= FIELD_ATTRIBUTES;
+
+        writer.u8(SLOT_SET);
+        writer.u8(mask);
+        if (mask & FIELD_OP) writer.u8(static_cast<uint8_t>(cmd.op));
+        if (mask & FIELD_X) writer.zigzag(int64_t(cmd.x) - base.x);
+        if (mask & FIELD_Y) writer.zigzag(int64_t(cmd.y) - base.y);
+        if (mask & FIELD_W) writer.zigzag(int64_t(cmd.w) - base.w);
+        if (mask & FIELD_H) writer.zigzag(int64_t(cmd.h) - base.h);
+        if (mask & FIELD_COLOR) writer.varint(cmd.color ^ base.color);
+        if (mask & FIELD_DATA) writer.bytes(cmd.data);
+        if (mask & FIELD_ATTRIBUTES) {
+            writer.varint(cmd.attributes.size());
+            for (const auto& [key, value] : cmd.attributes) {
+                writer.bytes(key);
+                writer.bytes(value);
+            }
+        }
+    }
+
+    bool read_slot(FrameReader& reader, const DrawKernCommand& base, DrawKernCommand& cmd) {
+        uint8_t mask;
+        if (!reader.u8(mask)) return false;
+        cmd = base;
+
+        int64_t delta;
+        uint64_t value;
+        if (mask & FIELD_OP) {
+            uint8_t op;
+            if (!reader.u8(op) || op > static_cast<uint8_t>(DrawKernOp::CODE_EXECUTION)) return false;
+            cmd.op = static_cast<DrawKernOp>(op);
+        }
+        if (mask & FIELD_X) { if (!reader.zigzag(delta)) return false; cmd.x = static_cast<int32_t>(base.x + delta); }
+        if (mask & FIELD_Y) { if (!reader.zigzag(delta)) return false; cmd.y = static_cast<int32_t>(base.y + delta); }
+        if (mask & FIELD_W) { if (!reader.zigzag(delta)) return false; cmd.w = static_cast<int32_t>(base.w + delta); }
+        if (mask & FIELD_H) { if (!reader.zigzag(delta)) return false; cmd.h = static_cast<int32_t>(base.h + delta); }
+        if (mask & FIELD_COLOR) { if (!reader.varint(value)) return false; cmd.color = base.color ^ static_cast<uint32_t>(value); }
+        if ((mask & FIELD_DATA) && !reader.bytes(cmd.data)) return false;
+        if (mask & FIELD_ATTRIBUTES) {
+            uint64_t count;
+            if (!reader.varint(count) || count > reader.remaining()) return false;
+            cmd.attributes.clear();
+            for (uint64_t i = 0; i < count; ++i) {
+                std::string key, attribute;
+                if (!reader.bytes(key) || !reader.bytes(attribute)) return false;
+                cmd.attributes.emplace(std::move(key), std::move(attribute));
+            }
+        }
+        return true;
+    }
+
+    // Merges touching rectangles, then falls back to the bounding box when
+    // too many are left for a client to be better off clipping to each
+    void coalesce(std::vector<DrawKernRect>& rects) {
+        if (rects.size() > DrawKernFrameEncoder::MAX_DIRTY_RECTS * 4) {
+            DrawKernRect box = rects.front();
+            for (const auto& rect : rects) box = box.united(rect);
+            rects.assign(1, box);
+            return;
+        }
+
+        bool merged = true;
+        while (merged) {
+            merged = false;
+            for (size_t i = 0; i < rects.size() && !merged; ++i) {
+                for (size_t j = i + 1; j < rects.size(); ++j) {
+                    DrawKernRect grown{rects[i].x - 1, rects[i].y - 1, rects[i].w + 2, rects[i].h + 2};
+                    if (grown.intersects(rects[j])) {
+                        rects[i] = rects[i].united(rects[j]);
+                        rects.erase(rects.begin() + j);
+                        merged = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (rects.size() > DrawKernFrameEncoder::MAX_DIRTY_RECTS) {
+            DrawKernRect box = rects.front();
+            for (const auto& rect : rects) box = box.united(rect);
+            rects.assign(1, box);
+        }
+    }
+
+    std::string encode_frame(const std::vector<DrawKernCommand>& frame, const std::vector<DrawKernCommand>* previous,
+                             uint64_t sequence, uint64_t base_sequence) {
+        std::string out;
+        out.reserve(16 + frame.size() * 8);
+        FrameWriter writer(out);
+        writer.u8(FRAME_MAGIC[0]);
+        writer.u8(FRAME_MAGIC[1]);
+        writer.u8(FRAME_VERSION);
+        writer.varint(sequence);
+        writer.varint(previous ? base_sequence : 0);
+        writer.varint(frame.size());
+
+        std::vector<DrawKernRect> dirty;
+        if (previous) {
+            for (size_t i = 0; i < std::max(frame.size(), previous->size()); ++i) {
+                bool in_old = i < previous->size();
+                bool in_new = i < frame.size();
+                if (in_old && in_new && (*previous)[i] == frame[i]) continue;
+                if (in_old) dirty.push_back(command_bounds((*previous)[i]));
+                if (in_new) dirty.push_back(command_bounds(frame[i]));
+            }
+            if (!dirty.empty()) coalesce(dirty);
+        }
+        writer.varint(dirty.size());
+        for (const auto& rect : dirty) {
+            write_rect(writer, rect);
+        }
+
+        size_t i = 0;
+        while (i < frame.size()) {
+            if (previous && i < previous->size() && (*previous)[i] == frame[i]) {
+                size_t run = 1;
+                while (i + run < frame.size() && i + run < previous->size() && (*previous)[i + run] == frame[i + run]) {
+                    run++;
+                }
+                writer.u8(SLOT_KEEP);
+                writer.varint(run);
+                i += run;
+                continue;
+            }
+
+            const DrawKernCommand& base = previous && i < previous->size() ? (*previous)[i]
+                                        : i > 0 ? frame[i - 1] : EMPTY_COMMAND;
+            write_slot(writer, base, frame[i]);
+            i++;
+        }
+        return out;
+    }
+}
+
+bool DrawKernCommand::operator==(const DrawKernCommand& other) const {
+    return op == other.op && x == other.x && y == other.y && w == other.w && h == other.h &&
+           color == other.color && data == other.data && attributes == other.attributes;
+}
+
+bool DrawKernRect::intersects(const DrawKernRect& other) const {
+    return int64_t(x) < int64_t(other.x) + other.w && int64_t(other.x) < int64_t(x) + w &&
+           int64_t(y) < int64_t(other.y) + other.h && int64_t(other.y) < int64_t(y) + h;
+}
+
+DrawKernRect DrawKernRect::united(const DrawKernRect& other) const {
+    int64_t left = std::min(x, other.x);
+    int64_t top = std::min(y, other.y);
+    int64_t right = std::max(int64_t(x) + w, int64_t(other.x) + other.w);
+    int64_t bottom = std::max(int64_t(y) + h, int64_t(other.y) + other.h);
+    return DrawKernRect{static_cast<int32_t>(left), static_cast<int32_t>(top),
+                        static_cast<int32_t>(right - left), static_cast<int32_t>(bottom - top)};
+}
+
+DrawKernRect DrawKernRect::intersected(const DrawKernRect& other) const {
+    int64_t left = std::max(x, other.x);
+    int64_t top = std::max(y, other.y);
+    int64_t right = std::min(int64_t(x) + w, int64_t(other.x) + other.w);
+    int64_t bottom = std::min(int64_t(y) + h, int64_t(other.y) + other.h);
+    if (right <= left || bottom <= top) {
+        return DrawKernRect{};
+    }
+    return DrawKernRect{static_cast<int32_t>(left), static_cast<int32_t>(top),
+                        static_cast<int32_t>(right - left), static_cast<int32_t>(bottom - top)};
+}
+
+DrawKernRect command_bounds(const DrawKernCommand& cmd) {
+    return DrawKernRect{cmd.x, cmd.y, std::max(cmd.w, 1), std::max(cmd.h, 1)};
+}
+
+// DrawKernFrameEncoder implementation
+std::string DrawKernFrameEncoder::encode(const std::vector<DrawKernCommand>& frame) {
+    if (!keyframe_due_ && frame == previous_) {
+        return "";
+    }
+
+    uint64_t base = sequence_;
+    sequence_++;
+    std::string out = encode_frame(frame, keyframe_due_ ? nullptr : &previous_, sequence_, base);
+    previous_ = frame;
+    keyframe_due_ = false;
+    return out;
+}
+
+std::string DrawKernFrameEncoder::keyframe() const {
+    return encode_frame(previous_, nullptr, sequence_, 0);
+}
+
+void DrawKernFrameEncoder::reset() {
+    keyframe_due_ = true;
+}
+
+// DrawKernFrameDecoder implementation
+bool DrawKernFrameDecoder::decode(std::string_view payload) {
+    FrameReader reader(payload);
+    uint8_t magic0, magic1, version;
+    uint64_t sequence, base, count, dirty_count;
+    if (!reader.u8(magic0) || !reader.u8(magic1) || !reader.u8(version) ||
+        magic0 != FRAME_MAGIC[0] || magic1 != FRAME_MAGIC[1] || version != FRAME_VERSION) {
+        return false;
+    }
+    if (!reader.varint(sequence) || !reader.varint(base) || !reader.varint(count) || !reader.varint(dirty_count)) {
+        return false;
+    }
+
+    // A delta only applies to the frame it was made from
+    bool keyframe = base == 0;
+    if (!keyframe && base != sequence_) {
+        return false;
+    }
+    if (dirty_count > reader.remaining()) {
+        return false;
+    }
+
+    std::vector<DrawKernRect> dirty(dirty_count);
+    for (auto& rect : dirty) {
+        if (!read_rect(reader, rect)) return false;
+    }
+
+    // Every slot costs at least a byte unless it is kept from the old frame
+    const std::vector<DrawKernCommand>* previous = keyframe ? nullptr : &frame_;
+    if (count > reader.remaining() + (previous ? previous->size() : 0)) {
+        return false;
+    }
+
+    std::vector<DrawKernCommand> frame;
+    frame.reserve(count);
+    while (frame.size() < count) {
+        uint8_t tag;
+        if (!reader.u8(tag)) return false;
+
+        if (tag == SLOT_KEEP) {
+            uint64_t run;
+            if (!previous || !reader.varint(run) || run == 0 ||
+                run > count - frame.size() || frame.size() + run > previous->size()) {
+                return false;
+            }
+            frame.insert(frame.end(), previous->begin() + frame.size(), previous->begin() + frame.size() + run);
+        } else if (tag == SLOT_SET) {
+            size_t i = frame.size();
+            const DrawKernCommand& base_cmd = previous && i < previous->size() ? (*previous)[i]
+                                            : i > 0 ? frame[i - 1] : EMPTY_COMMAND;
+            DrawKernCommand cmd;
+            if (!read_slot(reader, base_cmd, cmd)) return false;
+            frame.push_back(std::move(cmd));
+        } else {
+            return false;
+        }
+    }
+    if (reader.remaining() != 0) {
+        return false;
+    }
+
+    // A keyframe repaints whatever either frame covers, so nothing of the
+    // old frame is left behind
+    std::vector<DrawKernRect> areas;
+    if (keyframe) {
+        for (const auto* commands : {&frame_, &frame}) {
+            for (const auto& cmd : *commands) {
+                DrawKernRect bounds = command_bounds(cmd);
+                areas.assign(1, areas.empty() ? bounds : areas.front().united(bounds));
+            }
+        }
+    } else {
+        areas = dirty;
+    }
+
+    frame_ = std::move(frame);
+    dirty_ = std::move(dirty);
+    redraw_areas_ = std::move(areas);
+    sequence_ = sequence;
+    full_redraw_ = keyframe;
+    return true;
+}
+
+std::vector<const DrawKernCommand*> DrawKernFrameDecoder::commands_in(const DrawKernRect& area) const {
+    std::vector<const DrawKernCommand*> commands;
+    for (const auto& cmd : frame_) {
+        if (command_bounds(cmd).intersects(area)) {
+            commands.push_back(&cmd);
+        }
+    }
+    return commands;
+}
+
+// DrawKernFrameBuffer implementation
+DrawKernFrameBuffer::DrawKernFrameBuffer(Sender sender) : sender_(std::move(sender)) {
+}
+
+void DrawKernFrameBuffer::add_client(const std::string& client_id) {
+    clients_[client_id] = true;
+}
+
+void DrawKernFrameBuffer::remove_client(const std::string& client_id) {
+    clients_.erase(client_id);
+}
+
+void DrawKernFrameBuffer::request_keyframe(const std::string& client_id) {
+    auto it = clients_.find(client_id);
+    if (it != clients_.end()) {
+        it->second = true;
+    }
+}
+
+void DrawKernFrameBuffer::push(DrawKernCommand cmd) {
+    frame_.push_back(std::move(cmd));
+}
+
+size_t DrawKernFrameBuffer::end_frame() {
+    bool first = encoder_.sequence() == 0;
+    std::string delta = encoder_.encode(frame_);
+    frame_.clear();
+
+    std::string keyframe;
+    size_t sent = 0;
+    for (auto& [client_id, needs_keyframe] : clients_) {
+        const std::string* payload = &delta;
+        if (needs_keyframe && !first) {
+            if (keyframe.empty()) {
+                keyframe = encoder_.keyframe();
+            }
+            payload = &keyframe;
+        }
+        needs_keyframe = false;
+        if (payload->empty()) {
+            continue;
+        }
+        sender_(client_id, *payload);
+        sent += payload->size();
+    }
+    return sent;
+}
+
+} // namespace drawkern
+} // namespace bolt
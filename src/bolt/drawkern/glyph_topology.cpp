@@ -0,0 +1,407 @@
+#include "bolt/drawkern/glyph_topology.hpp"
+#include "bolt/drawkern/dis_vm.hpp"
+#include <algorithm>
+#include <iostream>
+#include <set>
+
+namespace bolt {
+namespace drawkern {
+
+namespace {
+    bool is_declaration(TokenType type) {
+        return type == TokenType::VM || type == TokenType::GLYPH || type == TokenType::WORKBENCH;
+    }
+
+    // Compares two declarations ignoring positions and formatting. The
+    // parser only uses the predefined attribute keys, whose ids are the
+    // same in every arena.
+    bool same_structure(const ASTNode& a, const ASTNode& b) {
+        if (a.type != b.type || a.children().size() != b.children().size() ||
+            a.attributes().size() != b.attributes().size()) {
+            return false;
+        }
+
+        switch (a.type) {
+            case ASTNodeType::VM_DECL: {
+                const auto& x = static_cast<const VMDeclNode&>(a);
+                const auto& y = static_cast<const VMDeclNode&>(b);
+                if (x.vm_id != y.vm_id || x.vm_type != y.vm_type) return false;
+                break;
+            }
+            case ASTNodeType::GLYPH_DECL: {
+                const auto& x = static_cast<const GlyphDeclNode&>(a);
+                const auto& y = static_cast<const GlyphDeclNode&>(b);
+                if (x.glyph_id != y.glyph_id || x.base_vm != y.base_vm) return false;
+                break;
+            }
+            case ASTNodeType::PROPERTY: {
+                const auto& x = static_cast<const PropertyNode&>(a);
+                const auto& y = static_cast<const PropertyNode&>(b);
+                // A list value is its source text; its elements are compared below
+                if (x.name != y.name || (x.children().empty() && x.value != y.value)) return false;
+                break;
+            }
+            default:
+                break;
+        }
+
+        for (size_t i = 0; i < a.attributes().size(); ++i) {
+            if (a.attributes()[i].key != b.attributes()[i].key || a.attributes()[i].value != b.attributes()[i].value) {
+                return false;
+            }
+        }
+        for (size_t i = 0; i < a.children().size(); ++i) {
+            if (!same_structure(*a.children()[i], *b.children()[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Adds names that appear in `next` but not `previous` to `added`, and
+    // names in both whose declarations differ to `changed`
+    void diff_declarations(const std::map<std::string, size_t, std::less<>>& previous,
+                           const std::vector<GlyphFragment>& previous_fragments,
+                           const std::map<std::string, size_t, std::less<>>& next,
+                           const std::vector<GlyphFragment>& next_fragments,
+                           std::vector<std::string>& added, std::vector<std::string>& removed,
+                           std::vector<std::string>& changed) {
+        for (const auto& [name, index] : next) {
+            auto it = previous.find(name);
+            if (it == previous.end()) {
+                added.push_back(name);
+                continue;
+            }
+            const GlyphFragment& before = previous_fragments[it->second];
+            const GlyphFragment& after = next_fragments[index];
+            if (before.ast != after.ast && !same_structure(*before.node(), *after.node())) {
+                changed.push_back(name);
+            }
+        }
+        for (const auto& [name, index] : previous) {
+            if (next.find(name) == next.end()) {
+                removed.push_back(name);
+            }
+        }
+    }
+
+    // Waits on the mailbox forever, dropping what arrives
+    DISProgram create_idle_service() {
+        DISProgram program;
+        program.add_instruction(DISInstruction(DISOpcode::RECV));
+        program.add_instruction(DISInstruction(DISOpcode::POP));
+        program.add_instruction(DISInstruction(DISOpcode::JMP, DISValue(int64_t(0))));
+        return program;
+    }
+}
+
+bool GlyphTopologyDiff::empty() const {
+    return added_vms.empty() && removed_vms.empty() && changed_vms.empty() &&
+           added_glyphs.empty() && removed_glyphs.empty() && changed_glyphs.empty() &&
+           rebound_glyphs.empty();
+}
+
+const ASTNode* GlyphFragment::node() const {
+    if (!ast) {
+        return nullptr;
+    }
+    for (const ASTNode* child : ast->root().children()) {
+        if (child->type == ASTNodeType::VM_DECL || child->type == ASTNodeType::GLYPH_DECL) {
+            return child;
+        }
+    }
+    return nullptr;
+}
+
+std::string_view GlyphFragment::name() const {
+    const ASTNode* declaration = node();
+    if (!declaration) {
+        return {};
+    }
+    if (declaration->type == ASTNodeType::VM_DECL) {
+        return static_cast<const VMDeclNode*>(declaration)->vm_id;
+    }
+    return static_cast<const GlyphDeclNode*>(declaration)->glyph_id;
+}
+
+// GlyphDocument implementation
+GlyphDocument::GlyphDocument() {
+}
+
+GlyphDocument::~GlyphDocument() {
+}
+
+GlyphTopologyDiff GlyphDocument::update(std::string next) {
+    GlyphTopologyDiff diff;
+    if (next == source_ && !fragments_.empty()) {
+        return diff;
+    }
+
+    // The edit lies between a common prefix and a common suffix
+    size_t prefix = 0;
+    size_t limit = std::min(source_.size(), next.size());
+    while (prefix < limit && source_[prefix] == next[prefix]) {
+        prefix++;
+    }
+    size_t suffix = 0;
+    while (suffix < limit - prefix &&
+           source_[source_.size() - 1 - suffix] == next[next.size() - 1 - suffix]) {
+        suffix++;
+    }
+    const ptrdiff_t delta = static_cast<ptrdiff_t>(next.size()) - static_cast<ptrdiff_t>(source_.size());
+
+    // Re-lex from the fragment before the one holding the first changed
+    // byte: an edit to a declaration keyword moves where that one ends
+    size_t first = 0;
+    if (!fragments_.empty()) {
+        auto holding = std::upper_bound(fragments_.begin(), fragments_.end(), prefix,
+            [](size_t offset, const GlyphFragment& fragment) { return offset < fragment.begin; });
+        first = static_cast<size_t>(std::max<ptrdiff_t>(0, holding - fragments_.begin() - 2));
+    }
+    size_t start = first < fragments_.size() ? fragments_[first].begin : 0;
+    size_t start_line = first < fragments_.size() ? fragments_[first].line : 1;
+
+    // Collect new boundaries until one falls on an old boundary inside the
+    // unchanged suffix; from there on the old fragments still hold
+    std::vector<std::pair<size_t, size_t>> boundaries{{start, start_line}};
+    size_t scan_end = next.size();
+    size_t resume = fragments_.size();
+    size_t resume_line = 0;
+    const size_t stable_from = next.size() - suffix;
+
+    GlyphLexer lexer(std::string_view(next).substr(start), start_line);
+    for (Token token = lexer.next_token(); token.type != TokenType::END_OF_FILE; token = lexer.next_token()) {
+        if (!is_declaration(token.type)) {
+            continue;
+        }
+        size_t offset = static_cast<size_t>(token.value.data() - next.data());
+        if (offset == start) {
+            continue;
+        }
+        if (offset >= stable_from) {
+            size_t old_offset = static_cast<size_t>(static_cast<ptrdiff_t>(offset) - delta);
+            auto match = std::lower_bound(fragments_.begin() + first, fragments_.end(), old_offset,
+                [](const GlyphFragment& fragment, size_t value) { return fragment.begin < value; });
+            if (match != fragments_.end() && match->begin == old_offset) {
+                scan_end = offset;
+                resume = static_cast<size_t>(match - fragments_.begin());
+                resume_line = token.line;
+                break;
+            }
+        }
+        boundaries.emplace_back(offset, token.line);
+    }
+
+    std::vector<GlyphFragment> updated;
+    updated.reserve(first + boundaries.size() + (fragments_.size() - resume));
+    updated.insert(updated.end(), fragments_.begin(), fragments_.begin() + first);
+
+    for (size_t i = 0; i < boundaries.size(); ++i) {
+        GlyphFragment fragment;
+        fragment.begin = boundaries[i].first;
+        fragment.end = i + 1 < boundaries.size() ? boundaries[i + 1].first : scan_end;
+        fragment.line = boundaries[i].second;
+        fragment.ast = std::make_shared<const GlyphAST>(
+            GlyphAST::parse(std::string_view(next).substr(fragment.begin, fragment.end - fragment.begin), fragment.line));
+        updated.push_back(std::move(fragment));
+        diff.reparsed++;
+    }
+
+    if (resume < fragments_.size()) {
+        ptrdiff_t line_shift = static_cast<ptrdiff_t>(resume_line) - static_cast<ptrdiff_t>(fragments_[resume].line);
+        for (size_t i = resume; i < fragments_.size(); ++i) {
+            GlyphFragment fragment = fragments_[i];
+            fragment.begin = static_cast<size_t>(static_cast<ptrdiff_t>(fragment.begin) + delta);
+            fragment.end = static_cast<size_t>(static_cast<ptrdiff_t>(fragment.end) + delta);
+            fragment.line = static_cast<size_t>(static_cast<ptrdiff_t>(fragment.line) + line_shift);
+            // Error messages carry line numbers, so a moved fragment with errors is parsed again
+            if (line_shift != 0 && fragment.ast->has_errors()) {
+                fragment.ast = std::make_shared<const GlyphAST>(
+                    GlyphAST::parse(std::string_view(next).substr(fragment.begin, fragment.end - fragment.begin), fragment.line));
+            }
+            updated.push_back(std::move(fragment));
+        }
+    }
+
+    auto previous_vms = std::move(vms_);
+    auto previous_glyphs = std::move(glyphs_);
+    std::vector<GlyphFragment> previous_fragments = std::move(fragments_);
+
+    source_ = std::move(next);
+    fragments_ = std::move(updated);
+    index_declarations();
+
+    diff_declarations(previous_vms, previous_fragments, vms_, fragments_,
+                      diff.added_vms, diff.removed_vms, diff.changed_vms);
+    diff_declarations(previous_glyphs, previous_fragments, glyphs_, fragments_,
+                      diff.added_glyphs, diff.removed_glyphs, diff.changed_glyphs);
+    return diff;
+}
+
+void GlyphDocument::index_declarations() {
+    vms_.clear();
+    glyphs_.clear();
+    duplicate_errors_.clear();
+
+    for (size_t i = 0; i < fragments_.size(); ++i) {
+        const ASTNode* declaration = fragments_[i].node();
+        if (!declaration) {
+            continue;
+        }
+        bool is_vm = declaration->type == ASTNodeType::VM_DECL;
+        auto& index = is_vm ? vms_ : glyphs_;
+        std::string name(fragments_[i].name());
+        if (!index.emplace(name, i).second) {
+            duplicate_errors_.push_back("Line " + std::to_string(fragments_[i].line) + ": duplicate " +
+                                        (is_vm ? "vm '" : "glyph '") + name + "'");
+        }
+    }
+}
+
+const VMDeclNode* GlyphDocument::find_vm(std::string_view name) const {
+    auto it = vms_.find(name);
+    return it == vms_.end() ? nullptr : static_cast<const VMDeclNode*>(fragments_[it->second].node());
+}
+
+const GlyphDeclNode* GlyphDocument::find_glyph(std::string_view name) const {
+    auto it = glyphs_.find(name);
+    return it == glyphs_.end() ? nullptr : static_cast<const GlyphDeclNode*>(fragments_[it->second].node());
+}
+
+bool GlyphDocument::has_errors() const {
+    if (!duplicate_errors_.empty()) {
+        return true;
+    }
+    return std::any_of(fragments_.begin(), fragments_.end(),
+                       [](const GlyphFragment& fragment) { return fragment.ast->has_errors(); });
+}
+
+std::vector<std::string> GlyphDocument::get_errors() const {
+    std::vector<std::string> errors;
+    for (const auto& fragment : fragments_) {
+        auto fragment_errors = fragment.ast->get_errors();
+        errors.insert(errors.end(), fragment_errors.begin(), fragment_errors.end());
+    }
+    errors.insert(errors.end(), duplicate_errors_.begin(), duplicate_errors_.end());
+    return errors;
+}
+
+// GlyphTopology implementation
+GlyphTopology::GlyphTopology(DISVMManager& manager) : manager_(manager) {
+}
+
+GlyphTopology::~GlyphTopology() {
+    for (const auto& [name, vm_id] : instances_) {
+        manager_.destroy_vm(vm_id);
+    }
+}
+
+GlyphTopologyDiff GlyphTopology::apply(std::string source) {
+    GlyphTopologyDiff diff = document_.update(std::move(source));
+
+    for (const auto& name : diff.removed_vms) {
+        undeploy_vm(name);
+    }
+    for (const auto& name : diff.changed_vms) {
+        undeploy_vm(name);
+        deploy_vm(name);
+    }
+    for (const auto& name : diff.added_vms) {
+        deploy_vm(name);
+    }
+
+    for (const auto& name : diff.added_glyphs) {
+        render_glyph(name);
+    }
+    for (const auto& name : diff.changed_glyphs) {
+        render_glyph(name);
+    }
+
+    // Glyphs that did not change but sit on a VM that was replaced
+    std::set<std::string_view> replaced;
+    replaced.insert(diff.changed_vms.begin(), diff.changed_vms.end());
+    replaced.insert(diff.added_vms.begin(), diff.added_vms.end());
+    replaced.insert(diff.removed_vms.begin(), diff.removed_vms.end());
+    if (!replaced.empty()) {
+        std::set<std::string_view> rendered(diff.added_glyphs.begin(), diff.added_glyphs.end());
+        rendered.insert(diff.changed_glyphs.begin(), diff.changed_glyphs.end());
+        for (const auto& fragment : document_.fragments()) {
+            const ASTNode* declaration = fragment.node();
+            if (!declaration || declaration->type != ASTNodeType::GLYPH_DECL) {
+                continue;
+            }
+            const auto* glyph = static_cast<const GlyphDeclNode*>(declaration);
+            if (replaced.count(glyph->base_vm) && !rendered.count(glyph->glyph_id) &&
+                document_.find_glyph(glyph->glyph_id) == glyph) {
+                diff.rebound_glyphs.emplace_back(glyph->glyph_id);
+                render_glyph(diff.rebound_glyphs.back());
+            }
+        }
+    }
+
+    if (!diff.empty()) {
+        std::cout << "🔄 Glyph topology updated: " << diff.reparsed << " declarations parsed, "
+                  << diff.added_vms.size() + diff.changed_vms.size() << " VMs started, "
+                  << diff.removed_vms.size() + diff.changed_vms.size() << " VMs stopped, "
+                  << diff.added_glyphs.size() + diff.changed_glyphs.size() + diff.rebound_glyphs.size()
+                  << " glyphs rendered" << std::endl;
+    }
+    return diff;
+}
+
+std::string GlyphTopology::vm_instance(const std::string& vm_name) const {
+    auto it = instances_.find(vm_name);
+    return it == instances_.end() ? "" : it->second;
+}
+
+void GlyphTopology::undeploy_vm(const std::string& name) {
+    auto it = instances_.find(name);
+    if (it == instances_.end()) {
+        return;
+    }
+    manager_.destroy_vm(it->second);
+    instances_.erase(it);
+}
+
+void GlyphTopology::deploy_vm(const std::string& name) {
+    const VMDeclNode* declaration = document_.find_vm(name);
+    // Only DIS VMs have a runtime here; native and wasm ones are just declared
+    if (!declaration || declaration->vm_type != "dis") {
+        return;
+    }
+
+    DISProgram program;
+    if (program_factory_) {
+        program = program_factory_(*declaration);
+    } else {
+        std::string_view limbo;
+        for (const ASTNode* statement : declaration->children()) {
+            if (statement->type == ASTNodeType::PROPERTY && static_cast<const PropertyNode*>(statement)->name == "limbo") {
+                limbo = static_cast<const PropertyNode*>(statement)->value;
+            }
+        }
+        program = limbo.empty() ? create_idle_service() : DISProgramFactory::from_limbo_source(std::string(limbo));
+    }
+
+    std::string vm_id = manager_.create_vm(program);
+    if (vm_id.empty()) {
+        return;
+    }
+    if (!manager_.start_vm(vm_id)) {
+        // Not tracked in instances_, so nothing else would ever release it
+        manager_.destroy_vm(vm_id);
+        return;
+    }
+    instances_[name] = vm_id;
+}
+
+void GlyphTopology::render_glyph(const std::string& name) {
+    const GlyphDeclNode* glyph = document_.find_glyph(name);
+    if (!glyph || !glyph_renderer_) {
+        return;
+    }
+    glyph_renderer_(name, generator_.generate_vm_glyph(document_.find_vm(glyph->base_vm), *glyph));
+}
+
+} // namespace drawkern
+} // namespace bolt
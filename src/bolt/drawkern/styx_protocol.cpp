@@ -11,11 +11,18 @@
     typedef SSIZE_T ssize_t;
 #else
     #include <unistd.h>
+    #include <fcntl.h>
+    #include <poll.h>
     #include <sys/socket.h>
+    #include <sys/uio.h>
     #include <netinet/in.h>
+    #include <netinet/tcp.h>
     #include <arpa/inet.h>
 #endif
 
+#include <algorithm>
+#include <cerrno>
+#include <string_view>
 #include <thread>
 
 namespace bolt {
@@ -35,6 +42,11 @@ namespace {
         buffer.push_back((value >> 24) & 0xFF);
     }
     
+    void write_uint64(std::vector<uint8_t>& buffer, uint64_t value) {
+        write_uint32(buffer, static_cast<uint32_t>(value));
+        write_uint32(buffer, static_cast<uint32_t>(value >> 32));
+    }
+    
     void write_string(std::vector<uint8_t>& buffer, const std::string& str) {
         write_uint16(buffer, str.length());
         buffer.insert(buffer.end(), str.begin(), str.end());
@@ -53,11 +65,178 @@ namespace {
         return value;
     }
     
-    std::string read_string(const std::vector<uint8_t>& buffer, size_t& offset) {
-        uint16_t length = read_uint16(buffer, offset);
-        std::string str(buffer.begin() + offset, buffer.begin() + offset + length);
-        offset += length;
-        return str;
+}
+
+// Marshalling shared by the client and server
+namespace {
+    constexpr size_t HEADER_SIZE = 7;           // size[4] type[1] tag[2]
+    constexpr size_t RREAD_HEADER_SIZE = 11;    // header + count[4]
+    constexpr size_t TWRITE_HEADER_SIZE = 23;   // header + fid[4] offset[8] count[4]
+    constexpr size_t MAX_WALK_ELEMENTS = 16;
+    constexpr uint8_t QTDIR = 0x80;
+    constexpr uint32_t DMDIR = 0x80000000;
+    constexpr uint8_t OWRITE = 1;
+    constexpr uint8_t ORDWR = 2;
+    constexpr uint8_t OTRUNC = 0x10;
+    constexpr uint64_t MAX_FILE_SIZE = 1ULL << 30;
+    constexpr size_t POOLED_BUFFERS = 256;
+    constexpr size_t POOLED_CAPACITY = 4096;
+    constexpr size_t POOLED_MAX_CAPACITY = 65536;
+    constexpr size_t MAX_IOVECS = 64;
+    constexpr size_t READ_CHUNK = 65536;
+    constexpr size_t READ_BUDGET = 1 << 20;     // Per connection per reactor pass
+    
+    // Marshals little-endian fields straight into a buffer. begin() reserves
+    // the size field and finish() fills it in.
+    template<typename Buffer>
+    class StyxWriter {
+    public:
+        explicit StyxWriter(Buffer& buffer) : buffer_(buffer), start_(buffer.size()) {}
+        
+        void begin(StyxMessageType type, uint16_t tag) {
+            start_ = buffer_.size();
+            u32(0);
+            u8(static_cast<uint8_t>(type));
+            u16(tag);
+        }
+        
+        void u8(uint8_t value) { buffer_.push_back(static_cast<typename Buffer::value_type>(value)); }
+        void u16(uint16_t value) { put(value, 2); }
+        void u32(uint32_t value) { put(value, 4); }
+        void u64(uint64_t value) { put(value, 8); }
+        
+        void str(std::string_view value) {
+            u16(static_cast<uint16_t>(value.size()));
+            buffer_.insert(buffer_.end(), value.begin(), value.end());
+        }
+        
+        void qid(const StyxQid& qid) {
+            u8(qid.type);
+            u32(qid.vers);
+            u64(qid.path);
+        }
+        
+        // `extra` counts bytes sent after the buffer, such as an Rread slice
+        void finish(size_t extra = 0) {
+            uint32_t size = static_cast<uint32_t>(buffer_.size() - start_ + extra);
+            for (size_t i = 0; i < 4; ++i) {
+                buffer_[start_ + i] = static_cast<typename Buffer::value_type>(size >> (8 * i));
+            }
+        }
+        
+    private:
+        void put(uint64_t value, size_t bytes) {
+            for (size_t i = 0; i < bytes; ++i) {
+                buffer_.push_back(static_cast<typename Buffer::value_type>(value >> (8 * i)));
+            }
+        }
+        
+        Buffer& buffer_;
+        size_t start_;
+    };
+    
+    // Bounds-checked view of a received message; ok() turns false on a short read
+    class StyxReader {
+    public:
+        StyxReader(const uint8_t* data, size_t length) : data_(data), left_(length) {}
+        
+        bool ok() const { return ok_; }
+        uint8_t u8() { return static_cast<uint8_t>(get(1)); }
+        uint16_t u16() { return static_cast<uint16_t>(get(2)); }
+        uint32_t u32() { return static_cast<uint32_t>(get(4)); }
+        uint64_t u64() { return get(8); }
+        
+        std::string_view str() {
+            size_t length = u16();
+            const uint8_t* start = bytes(length);
+            return start ? std::string_view(reinterpret_cast<const char*>(start), length) : std::string_view();
+        }
+        
+        const uint8_t* bytes(size_t length) {
+            if (!ok_ || length > left_) {
+                ok_ = false;
+                return nullptr;
+            }
+            const uint8_t* start = data_;
+            data_ += length;
+            left_ -= length;
+            return start;
+        }
+        
+    private:
+        uint64_t get(size_t length) {
+            const uint8_t* start = bytes(length);
+            uint64_t value = 0;
+            for (size_t i = 0; start && i < length; ++i) {
+                value |= static_cast<uint64_t>(start[i]) << (8 * i);
+            }
+            return value;
+        }
+        
+        const uint8_t* data_;
+        size_t left_;
+        bool ok_ = true;
+    };
+    
+    std::string parent_path(const std::string& path) {
+        size_t slash = path.rfind('/');
+        return slash == 0 || slash == std::string::npos ? "/" : path.substr(0, slash);
+    }
+    
+    std::string base_name(const std::string& path) {
+        return path == "/" ? "/" : path.substr(path.rfind('/') + 1);
+    }
+    
+    // Empty for names a walk may not contain
+    std::string child_path(const std::string& directory, std::string_view name) {
+        if (name.empty() || name.find('/') != std::string_view::npos) {
+            return {};
+        }
+        if (name == ".") {
+            return directory;
+        }
+        if (name == "..") {
+            return parent_path(directory);
+        }
+        return (directory == "/" ? "" : directory) + "/" + std::string(name);
+    }
+    
+    // Directories have no entry of their own, so their qid path is a hash of
+    // the name, kept apart from the counter that numbers files
+    uint64_t directory_qid_path(const std::string& path) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (char c : path) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 1099511628211ULL;
+        }
+        return hash | (1ULL << 63);
+    }
+    
+    // One stat record: size[2] type[2] dev[4] qid[13] mode[4] atime[4] mtime[4]
+    // length[8] name[s] uid[s] gid[s] muid[s]
+    template<typename Buffer>
+    void write_stat(Buffer& buffer, const std::string& name, const StyxQid& qid, uint64_t length) {
+        size_t start = buffer.size();
+        StyxWriter<Buffer> writer(buffer);
+        writer.u16(0);
+        writer.u16(0);
+        writer.u32(0);
+        writer.qid(qid);
+        writer.u32(qid.type & QTDIR ? DMDIR | 0555 : 0666);
+        writer.u32(0);
+        writer.u32(0);
+        writer.u64(qid.type & QTDIR ? 0 : length);
+        writer.str(name);
+        writer.str("drawkern");
+        writer.str("drawkern");
+        writer.str("drawkern");
+        uint16_t size = static_cast<uint16_t>(buffer.size() - start - 2);
+        buffer[start] = static_cast<typename Buffer::value_type>(size & 0xFF);
+        buffer[start + 1] = static_cast<typename Buffer::value_type>(size >> 8);
+    }
+    
+    void set_nonblocking(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
     }
 }
 
@@ -82,8 +261,13 @@ StyxMessage StyxMessage::deserialize(const std::vector<uint8_t>& buffer) {
 }
 
 // StyxConnection implementation
-StyxConnection::StyxConnection(const std::string& address) 
-    : address_(address), socket_fd_(-1), connected_(false), next_tag_(1), next_fid_(1) {
+StyxConnection::StyxConnection(const std::string& address, size_t max_outstanding)
+    : address_(address), socket_fd_(-1), connected_(false), msize_(8192), next_fid_(1), root_fid_(~0U) {
+    max_outstanding = std::clamp<size_t>(max_outstanding, 1, 0xFFFE);
+    pending_.resize(max_outstanding + 1);
+    for (size_t tag = max_outstanding; tag >= 1; --tag) {
+        free_tags_.push_back(static_cast<uint16_t>(tag));
+    }
 }
 
 StyxConnection::~StyxConnection() {
@@ -91,6 +275,10 @@ StyxConnection::~StyxConnection() {
 }
 
 bool StyxConnection::connect() {
+    if (connected_) {
+        return true;
+    }
+    
     // Parse address (simplified - assumes localhost:port format)
     size_t colon_pos = address_.find(':');
     if (colon_pos == std::string::npos) {
@@ -114,6 +302,7 @@ bool StyxConnection::connect() {
     } else {
         // For simplicity, only support localhost in this implementation
         close(socket_fd_);
+        socket_fd_ = -1;
         return false;
     }
     
@@ -123,32 +312,49 @@ bool StyxConnection::connect() {
         return false;
     }
     
+    int opt = 1;
+    setsockopt(socket_fd_, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&opt), sizeof(opt));
+    
     connected_ = true;
+    reader_ = std::thread(&StyxConnection::reader_loop, this);
     return true;
 }
 
 void StyxConnection::disconnect() {
+    if (socket_fd_ >= 0) {
+        shutdown(socket_fd_, SHUT_RDWR);
+    }
+    if (reader_.joinable()) {
+        reader_.join();
+    }
     if (socket_fd_ >= 0) {
         close(socket_fd_);
         socket_fd_ = -1;
     }
     connected_ = false;
+    fail_pending();
 }
 
-bool StyxConnection::version(const std::string& version) {
+bool StyxConnection::version(const std::string& version, uint32_t msize) {
     if (!connected_) return false;
     
     StyxMessage msg;
     msg.type = StyxMessageType::Tversion;
-    msg.tag = next_tag_++;
     
     // Tversion message data: msize[4] version[s]
-    write_uint32(msg.data, 8192);  // Max message size
+    write_uint32(msg.data, msize);
     write_string(msg.data, version);
     msg.size = msg.data.size() + 7;  // Header size
     
+    // Replies up to the proposed size are accepted until the server answers
+    msize_ = msize;
     StyxMessage response = send_message(msg);
-    return response.type == StyxMessageType::Rversion;
+    if (response.type != StyxMessageType::Rversion || response.data.size() < 4) {
+        return false;
+    }
+    size_t offset = 0;
+    msize_ = std::min(msize, read_uint32(response.data, offset));
+    return msize_ >= 256;
 }
 
 bool StyxConnection::attach(const std::string& aname, const std::string& uname) {
@@ -156,17 +362,170 @@ bool StyxConnection::attach(const std::string& aname, const std::string& uname)
     
     StyxMessage msg;
     msg.type = StyxMessageType::Tattach;
-    msg.tag = next_tag_++;
     
     // Tattach message data: fid[4] afid[4] uname[s] aname[s]
-    write_uint32(msg.data, next_fid_++);  // fid
+    uint32_t fid = next_fid_++;
+    write_uint32(msg.data, fid);          // fid
     write_uint32(msg.data, ~0U);          // afid (no auth)
     write_string(msg.data, uname);
     write_string(msg.data, aname);
     msg.size = msg.data.size() + 7;
     
     StyxMessage response = send_message(msg);
-    return response.type == StyxMessageType::Rattach;
+    if (response.type != StyxMessageType::Rattach) {
+        return false;
+    }
+    root_fid_ = fid;
+    return true;
+}
+
+uint32_t StyxConnection::walk(uint32_t fid, uint32_t newfid, const std::vector<std::string>& path) {
+    if (!connected_) return ~0U;
+    
+    StyxMessage msg;
+    msg.type = StyxMessageType::Twalk;
+    
+    // Twalk message data: fid[4] newfid[4] nwname[2] nwname*(wname[s])
+    write_uint32(msg.data, fid);
+    write_uint32(msg.data, newfid);
+    write_uint16(msg.data, path.size());
+    for (const auto& name : path) {
+        write_string(msg.data, name);
+    }
+    msg.size = msg.data.size() + 7;
+    
+    StyxMessage response = send_message(msg);
+    if (response.type != StyxMessageType::Rwalk || response.data.size() < 2) {
+        return ~0U;
+    }
+    size_t offset = 0;
+    return read_uint16(response.data, offset);
+}
+
+uint32_t StyxConnection::open(uint32_t fid, uint8_t mode) {
+    if (!connected_) return ~0U;
+    
+    StyxMessage msg;
+    msg.type = StyxMessageType::Topen;
+    
+    // Topen message data: fid[4] mode[1]
+    write_uint32(msg.data, fid);
+    msg.data.push_back(mode);
+    msg.size = msg.data.size() + 7;
+    
+    // Ropen message data: qid[13] iounit[4]
+    StyxMessage response = send_message(msg);
+    if (response.type != StyxMessageType::Ropen || response.data.size() < 17) {
+        return ~0U;
+    }
+    size_t offset = 13;
+    return read_uint32(response.data, offset);
+}
+
+std::vector<uint8_t> StyxConnection::read(uint32_t fid, uint64_t offset, uint32_t count) {
+    std::vector<uint8_t> data(count);
+    data.resize(read(fid, offset, data.data(), count));
+    return data;
+}
+
+size_t StyxConnection::read(uint32_t fid, uint64_t offset, uint8_t* buffer, size_t count) {
+    if (!connected_) return 0;
+    
+    // Every chunk is requested before the first reply is awaited
+    size_t chunk = msize_ - RREAD_HEADER_SIZE;
+    std::vector<std::future<size_t>> parts;
+    for (size_t position = 0; position < count; position += chunk) {
+        parts.push_back(read_async(fid, offset + position, buffer + position,
+                                   static_cast<uint32_t>(std::min(chunk, count - position))));
+    }
+    
+    // The file ends at the first short chunk
+    size_t total = 0;
+    bool ended = false;
+    for (size_t i = 0; i < parts.size(); ++i) {
+        size_t received = parts[i].get();
+        if (!ended) {
+            total += received;
+            ended = received < std::min(chunk, count - i * chunk);
+        }
+    }
+    return total;
+}
+
+uint32_t StyxConnection::write(uint32_t fid, uint64_t offset, const std::vector<uint8_t>& data) {
+    return static_cast<uint32_t>(write(fid, offset, data.data(), data.size()));
+}
+
+size_t StyxConnection::write(uint32_t fid, uint64_t offset, const uint8_t* data, size_t length) {
+    if (!connected_) return 0;
+    
+    size_t chunk = msize_ - TWRITE_HEADER_SIZE;
+    std::vector<std::future<uint32_t>> parts;
+    for (size_t position = 0; position < length; position += chunk) {
+        parts.push_back(write_async(fid, offset + position, data + position,
+                                    static_cast<uint32_t>(std::min(chunk, length - position))));
+    }
+    
+    size_t total = 0;
+    bool stopped = false;
+    for (size_t i = 0; i < parts.size(); ++i) {
+        size_t written = parts[i].get();
+        if (!stopped) {
+            total += written;
+            stopped = written < std::min(chunk, length - i * chunk);
+        }
+    }
+    return total;
+}
+
+bool StyxConnection::clunk(uint32_t fid) {
+    if (!connected_) return false;
+    
+    StyxMessage msg;
+    msg.type = StyxMessageType::Tclunk;
+    
+    write_uint32(msg.data, fid);
+    msg.size = msg.data.size() + 7;
+    
+    StyxMessage response = send_message(msg);
+    return response.type == StyxMessageType::Rclunk;
+}
+
+std::optional<StyxStat> StyxConnection::stat(uint32_t fid) {
+    if (!connected_) return std::nullopt;
+    
+    StyxMessage msg;
+    msg.type = StyxMessageType::Tstat;
+    
+    write_uint32(msg.data, fid);
+    msg.size = msg.data.size() + 7;
+    
+    // Rstat message data: n[2] stat[n]
+    StyxMessage response = send_message(msg);
+    if (response.type != StyxMessageType::Rstat) {
+        return std::nullopt;
+    }
+    StyxReader in(response.data.data(), response.data.size());
+    in.u16();
+    StyxStat stat;
+    stat.size = in.u16();
+    stat.type = in.u16();
+    stat.dev = in.u32();
+    stat.qid.type = in.u8();
+    stat.qid.vers = in.u32();
+    stat.qid.path = in.u64();
+    stat.mode = in.u32();
+    stat.atime = in.u32();
+    stat.mtime = in.u32();
+    stat.length = in.u64();
+    stat.name = in.str();
+    stat.uid = in.str();
+    stat.gid = in.str();
+    stat.muid = in.str();
+    if (!in.ok()) {
+        return std::nullopt;
+    }
+    return stat;
 }
 
 bool StyxConnection::send_glyph(const std::string& glyph_data) {
@@ -174,7 +533,6 @@ bool StyxConnection::send_glyph(const std::string& glyph_data) {
     
     StyxMessage msg;
     msg.type = StyxMessageType::Tdrawkern;
-    msg.tag = next_tag_++;
     
     // Custom DrawKern message format
     write_string(msg.data, "glyph");
@@ -190,7 +548,6 @@ bool StyxConnection::spawn_vm(const std::string& vm_spec) {
     
     StyxMessage msg;
     msg.type = StyxMessageType::Tvmspawn;
-    msg.tag = next_tag_++;
     
     write_string(msg.data, vm_spec);
     msg.size = msg.data.size() + 7;
@@ -200,70 +557,269 @@ bool StyxConnection::spawn_vm(const std::string& vm_spec) {
 }
 
 StyxMessage StyxConnection::send_message(const StyxMessage& message) {
-    std::vector<uint8_t> buffer;
-    message.serialize(buffer);
+    return send_async(message).get();
+}
+
+std::future<StyxMessage> StyxConnection::send_async(StyxMessage message) {
+    auto promise = std::make_shared<std::promise<StyxMessage>>();
+    std::future<StyxMessage> result = promise->get_future();
+    send_async(std::move(message), [promise](StyxMessage reply) {
+        promise->set_value(std::move(reply));
+    });
+    return result;
+}
+
+void StyxConnection::send_async(StyxMessage message, Callback callback) {
+    Pending pending;
+    pending.callback = std::move(callback);
+    submit(message, nullptr, 0, std::move(pending));
+}
+
+std::future<size_t> StyxConnection::read_async(uint32_t fid, uint64_t offset, uint8_t* buffer, uint32_t count) {
+    StyxMessage msg;
+    msg.type = StyxMessageType::Tread;
+    
+    // Tread message data: fid[4] offset[8] count[4]
+    write_uint32(msg.data, fid);
+    write_uint64(msg.data, offset);
+    write_uint32(msg.data, count);
+    msg.size = msg.data.size() + 7;
+    
+    // Rread message data: count[4] data[count]; the data is already in `buffer`
+    auto promise = std::make_shared<std::promise<size_t>>();
+    std::future<size_t> result = promise->get_future();
+    Pending pending;
+    pending.destination = buffer;
+    pending.capacity = count;
+    pending.callback = [promise, count](StyxMessage reply) {
+        size_t offset = 0;
+        size_t received = 0;
+        if (reply.type == StyxMessageType::Rread && reply.data.size() >= 4) {
+            received = std::min<size_t>(read_uint32(reply.data, offset), count);
+        }
+        promise->set_value(received);
+    };
+    submit(msg, nullptr, 0, std::move(pending));
+    return result;
+}
+
+std::future<uint32_t> StyxConnection::write_async(uint32_t fid, uint64_t offset, const uint8_t* data, uint32_t count) {
+    StyxMessage msg;
+    msg.type = StyxMessageType::Twrite;
+    
+    // Twrite message data: fid[4] offset[8] count[4] data[count]; the data
+    // is sent from the caller's memory
+    write_uint32(msg.data, fid);
+    write_uint64(msg.data, offset);
+    write_uint32(msg.data, count);
+    msg.size = msg.data.size() + 7 + count;
     
-    if (!send_data(buffer)) {
+    // Rwrite message data: count[4]
+    auto promise = std::make_shared<std::promise<uint32_t>>();
+    std::future<uint32_t> result = promise->get_future();
+    Pending pending;
+    pending.callback = [promise](StyxMessage reply) {
+        size_t offset = 0;
+        bool ok = reply.type == StyxMessageType::Rwrite && reply.data.size() >= 4;
+        promise->set_value(ok ? read_uint32(reply.data, offset) : 0);
+    };
+    submit(msg, data, count, std::move(pending));
+    return result;
+}
+
+void StyxConnection::submit(StyxMessage& message, const uint8_t* payload, size_t payload_length, Pending pending) {
+    uint16_t tag = 0;
+    {
+        std::unique_lock<std::mutex> lock(pending_mutex_);
+        tags_cv_.wait(lock, [this] { return !free_tags_.empty() || !connected_; });
+        if (connected_) {
+            tag = free_tags_.back();
+            free_tags_.pop_back();
+            pending_[tag] = std::move(pending);
+        }
+    }
+    if (tag == 0) {
         StyxMessage error;
         error.type = StyxMessageType::Terror;
-        return error;
+        pending.callback(std::move(error));
+        return;
     }
     
-    std::vector<uint8_t> response_data = receive_data();
-    if (response_data.empty()) {
+    message.tag = tag;
+    std::vector<uint8_t> buffer;
+    message.serialize(buffer);
+    if (!send_data(buffer, payload, payload_length)) {
+        // The reader sees the broken socket too and fails this tag with the rest
+        shutdown(socket_fd_, SHUT_RDWR);
+    }
+}
+
+void StyxConnection::reader_loop() {
+    std::vector<uint8_t> header(HEADER_SIZE);
+    while (receive_exact(header.data(), HEADER_SIZE)) {
+        size_t offset = 0;
+        StyxMessage reply = StyxMessage::deserialize(header);
+        uint32_t size = read_uint32(header, offset);
+        if (size < HEADER_SIZE || size > msize_) {
+            break;
+        }
+        
+        Pending pending;
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            if (reply.tag < pending_.size() && pending_[reply.tag].callback) {
+                pending = std::move(pending_[reply.tag]);
+                pending_[reply.tag] = Pending();
+            }
+        }
+        
+        // Rread data goes straight into the caller's buffer
+        size_t body = size - HEADER_SIZE;
+        bool received = true;
+        if (reply.type == StyxMessageType::Rread && pending.destination && body >= 4) {
+            reply.data.resize(4);
+            received = receive_exact(reply.data.data(), 4);
+            size_t length = body - 4;
+            size_t direct = std::min(length, pending.capacity);
+            received = received && receive_exact(pending.destination, direct);
+            std::vector<uint8_t> excess(length - direct);
+            received = received && receive_exact(excess.data(), excess.size());
+        } else {
+            reply.data.resize(body);
+            received = receive_exact(reply.data.data(), body);
+        }
+        
+        if (pending.callback) {
+            {
+                std::lock_guard<std::mutex> lock(pending_mutex_);
+                free_tags_.push_back(reply.tag);
+            }
+            tags_cv_.notify_one();
+            if (!received) {
+                reply.type = StyxMessageType::Terror;
+            }
+            pending.callback(std::move(reply));
+        }
+        if (!received) {
+            break;
+        }
+    }
+    
+    connected_ = false;
+    fail_pending();
+}
+
+void StyxConnection::fail_pending() {
+    std::vector<Callback> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        for (size_t tag = 1; tag < pending_.size(); ++tag) {
+            if (pending_[tag].callback) {
+                callbacks.push_back(std::move(pending_[tag].callback));
+                pending_[tag] = Pending();
+                free_tags_.push_back(static_cast<uint16_t>(tag));
+            }
+        }
+    }
+    tags_cv_.notify_all();
+    for (auto& callback : callbacks) {
         StyxMessage error;
         error.type = StyxMessageType::Terror;
-        return error;
+        callback(std::move(error));
     }
-    
-    return StyxMessage::deserialize(response_data);
 }
 
-bool StyxConnection::send_data(const std::vector<uint8_t>& data) {
+bool StyxConnection::send_data(const std::vector<uint8_t>& data, const uint8_t* payload, size_t payload_length) {
     if (socket_fd_ < 0) return false;
     
-    size_t sent = 0;
-    while (sent < data.size()) {
-        ssize_t result = send(socket_fd_, reinterpret_cast<const char*>(data.data() + sent), data.size() - sent, 0);
+    // Header and payload go out in one scatter-gather send; the lock keeps
+    // concurrent requests from interleaving
+    iovec vectors[2] = {{const_cast<uint8_t*>(data.data()), data.size()},
+                        {const_cast<uint8_t*>(payload), payload_length}};
+    size_t count = payload_length > 0 ? 2 : 1;
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    iovec* next = vectors;
+    while (count > 0) {
+        msghdr message{};
+        message.msg_iov = next;
+        message.msg_iovlen = count;
+        ssize_t result = sendmsg(socket_fd_, &message, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR) continue;
         if (result <= 0) return false;
-        sent += result;
+        
+        size_t sent = static_cast<size_t>(result);
+        while (count > 0 && sent >= next->iov_len) {
+            sent -= next->iov_len;
+            ++next;
+            --count;
+        }
+        if (count > 0) {
+            next->iov_base = static_cast<uint8_t*>(next->iov_base) + sent;
+            next->iov_len -= sent;
+        }
     }
     return true;
 }
 
-std::vector<uint8_t> StyxConnection::receive_data() {
-    if (socket_fd_ < 0) return {};
-    
-    // First read the size field
-    uint8_t size_buffer[4];
-    if (recv(socket_fd_, reinterpret_cast<char*>(size_buffer), 4, MSG_WAITALL) != 4) {
-        return {};
+bool StyxConnection::receive_exact(uint8_t* data, size_t length) {
+    while (length > 0) {
+        ssize_t result = recv(socket_fd_, reinterpret_cast<char*>(data), length, MSG_WAITALL);
+        if (result < 0 && errno == EINTR) continue;
+        if (result <= 0) return false;
+        data += result;
+        length -= static_cast<size_t>(result);
     }
+    return true;
+}
+
+// StyxServer implementation
+struct StyxServer::Connection {
+    struct Fid {
+        std::string path;
+        bool directory = false;
+        bool open = false;
+        uint8_t mode = 0;
+    };
     
-    uint32_t message_size = size_buffer[0] | (size_buffer[1] << 8) | 
-                           (size_buffer[2] << 16) | (size_buffer[3] << 24);
+    explicit Connection(int descriptor) : fd(descriptor) {}
+    ~Connection() { close(fd); }
     
-    if (message_size > 8192 || message_size < 7) {
-        return {};
-    }
+    int fd;
+    std::atomic<bool> closed{false};
+    std::atomic<uint32_t> msize{MAX_MESSAGE_SIZE};
     
-    std::vector<uint8_t> buffer(message_size);
-    memcpy(buffer.data(), size_buffer, 4);
+    // Bytes received but not yet framed; reactor only
+    std::vector<uint8_t> input;
     
-    if (recv(socket_fd_, reinterpret_cast<char*>(buffer.data() + 4), message_size - 4, MSG_WAITALL) != (message_size - 4)) {
-        return {};
-    }
+    // Fid table and in-flight tags
+    std::mutex state_mutex;
+    std::unordered_map<uint32_t, Fid> fids;
+    std::unordered_map<uint16_t, bool> tags;  // tag -> flushed
     
-    return buffer;
-}
+    // Replies waiting for the socket; output_offset bytes of the first are sent
+    std::mutex write_mutex;
+    std::deque<Reply> output;
+    size_t output_offset = 0;
+    std::atomic<bool> pending_output{false};
+};
 
-// StyxServer implementation (minimal for demo)
-StyxServer::StyxServer(const std::string& address) 
-    : address_(address), listen_fd_(-1), running_(false) {
+StyxServer::StyxServer(const std::string& address, size_t worker_count)
+    : address_(address), listen_fd_(-1), wake_fds_{-1, -1}, port_(0), running_(false),
+      worker_count_(worker_count ? worker_count : std::max(1u, std::thread::hardware_concurrency())),
+      loop_active_(false), next_qid_path_(1) {
 }
 
 StyxServer::~StyxServer() {
     stop();
+    {
+        std::unique_lock<std::mutex> lock(loop_mutex_);
+        loop_cv_.wait(lock, [this] { return !loop_active_; });
+    }
+    for (int fd : {listen_fd_, wake_fds_[0], wake_fds_[1]}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
 }
 
 bool StyxServer::start() {
@@ -288,15 +844,20 @@ bool StyxServer::start() {
     server_addr.sin_addr.s_addr = INADDR_ANY;
     server_addr.sin_port = htons(port);
     
-    if (bind(listen_fd_, (sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+    if (bind(listen_fd_, (sockaddr*)&server_addr, sizeof(server_addr)) < 0 ||
+        listen(listen_fd_, SOMAXCONN) < 0 || pipe(wake_fds_) < 0) {
         close(listen_fd_);
+        listen_fd_ = -1;
         return false;
     }
     
-    if (listen(listen_fd_, 5) < 0) {
-        close(listen_fd_);
-        return false;
-    }
+    socklen_t addr_len = sizeof(server_addr);
+    getsockname(listen_fd_, (sockaddr*)&server_addr, &addr_len);
+    port_ = ntohs(server_addr.sin_port);
+    
+    set_nonblocking(listen_fd_);
+    set_nonblocking(wake_fds_[0]);
+    set_nonblocking(wake_fds_[1]);
     
     running_ = true;
     std::cout << "Styx server listening on " << address_ << std::endl;
@@ -305,66 +866,861 @@ bool StyxServer::start() {
 
 void StyxServer::stop() {
     running_ = false;
-    if (listen_fd_ >= 0) {
-        close(listen_fd_);
-        listen_fd_ = -1;
+    wake();
+    queue_cv_.notify_all();
+}
+
+void StyxServer::wake() {
+    if (wake_fds_[1] >= 0) {
+        char byte = 1;
+        [[maybe_unused]] ssize_t written = ::write(wake_fds_[1], &byte, 1);
     }
 }
 
 void StyxServer::run() {
+    if (!running_) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(loop_mutex_);
+        loop_active_ = true;
+    }
+    for (size_t i = 0; i < worker_count_; ++i) {
+        workers_.emplace_back(&StyxServer::worker_loop, this);
+    }
+    
+    std::vector<pollfd> fds;
+    std::vector<std::shared_ptr<Connection>> polled;
     while (running_) {
-        sockaddr_in client_addr{};
-        socklen_t client_len = sizeof(client_addr);
+        fds.clear();
+        polled.clear();
+        fds.push_back({listen_fd_, POLLIN, 0});
+        fds.push_back({wake_fds_[0], POLLIN, 0});
+        for (auto it = connections_.begin(); it != connections_.end();) {
+            if (it->second->closed) {
+                shutdown(it->first, SHUT_RDWR);
+                it = connections_.erase(it);
+                continue;
+            }
+            short events = POLLIN;
+            if (it->second->pending_output) {
+                events |= POLLOUT;
+            }
+            fds.push_back({it->first, events, 0});
+            polled.push_back(it->second);
+            ++it;
+        }
+        
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Styx server poll failed" << std::endl;
+            break;
+        }
         
-        int client_fd = accept(listen_fd_, (sockaddr*)&client_addr, &client_len);
+        if (fds[1].revents) {
+            char drain[64];
+            while (::read(wake_fds_[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            accept_connections();
+        }
+        for (size_t i = 0; i < polled.size(); ++i) {
+            Connection& connection = *polled[i];
+            short revents = fds[i + 2].revents;
+            bool alive = !connection.closed;
+            if (alive && (revents & POLLOUT)) {
+                std::lock_guard<std::mutex> lock(connection.write_mutex);
+                alive = flush_connection(connection);
+            }
+            if (alive && (revents & (POLLIN | POLLHUP | POLLERR))) {
+                alive = read_connection(connection);
+            }
+            if (!alive) {
+                connection.closed = true;
+            }
+        }
+    }
+    
+    for (auto& [fd, connection] : connections_) {
+        connection->closed = true;
+        shutdown(fd, SHUT_RDWR);
+    }
+    connections_.clear();
+    queue_cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+    requests_.clear();
+    
+    {
+        std::lock_guard<std::mutex> lock(loop_mutex_);
+        loop_active_ = false;
+    }
+    loop_cv_.notify_all();
+}
+
+void StyxServer::accept_connections() {
+    while (true) {
+        int client_fd = accept(listen_fd_, nullptr, nullptr);
         if (client_fd < 0) {
-            if (running_) {
-                std::cerr << "Accept failed" << std::endl;
+            return;
+        }
+        set_nonblocking(client_fd);
+        int opt = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&opt), sizeof(opt));
+        connections_[client_fd] = std::make_shared<Connection>(client_fd);
+    }
+}
+
+bool StyxServer::read_connection(Connection& connection) {
+    // Messages are framed after every recv so workers start while a large
+    // upload is still arriving; the budget keeps one busy client from
+    // holding the reactor
+    auto& input = connection.input;
+    for (size_t budget = READ_BUDGET; budget > 0;) {
+        size_t used = input.size();
+        size_t chunk = std::min(budget, READ_CHUNK);
+        input.resize(used + chunk);
+        ssize_t bytes = recv(connection.fd, reinterpret_cast<char*>(input.data() + used), chunk, 0);
+        input.resize(used + (bytes > 0 ? bytes : 0));
+        if (bytes == 0) {
+            return false;
+        }
+        if (bytes < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        budget -= static_cast<size_t>(bytes);
+        
+        std::deque<Request> batch;
+        size_t consumed = 0;
+        while (input.size() - consumed >= 4) {
+            const uint8_t* start = input.data() + consumed;
+            uint32_t size = start[0] | (start[1] << 8) | (start[2] << 16) | (static_cast<uint32_t>(start[3]) << 24);
+            if (size < HEADER_SIZE || size > MAX_MESSAGE_SIZE) {
+                return false;
+            }
+            if (input.size() - consumed < size) {
+                break;
+            }
+            
+            uint16_t tag = start[5] | (start[6] << 8);
+            {
+                std::lock_guard<std::mutex> lock(connection.state_mutex);
+                connection.tags[tag] = false;
+            }
+            Request request;
+            request.connection = connections_[connection.fd];
+            request.message = acquire_buffer();
+            request.message.assign(start, start + size);
+            batch.push_back(std::move(request));
+            consumed += size;
+        }
+        if (consumed > 0) {
+            input.erase(input.begin(), input.begin() + consumed);
+        }
+        
+        if (!batch.empty()) {
+            size_t count = batch.size();
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+                for (auto& request : batch) {
+                    requests_.push_back(std::move(request));
+                }
+            }
+            if (count == 1) {
+                queue_cv_.notify_one();
+            } else {
+                queue_cv_.notify_all();
+            }
+        }
+    }
+    return true;
+}
+
+bool StyxServer::flush_connection(Connection& connection) {
+    while (!connection.output.empty()) {
+        // Gather headers and file slices into one scatter-gather send
+        iovec vectors[MAX_IOVECS];
+        size_t count = 0;
+        size_t skip = connection.output_offset;
+        for (const auto& reply : connection.output) {
+            if (count + 2 > MAX_IOVECS) {
+                break;
+            }
+            const char* parts[2] = {reinterpret_cast<const char*>(reply.header.data()),
+                                    reply.body ? reply.body->data() + reply.body_offset : nullptr};
+            size_t lengths[2] = {reply.header.size(), reply.body_length};
+            for (size_t i = 0; i < 2; ++i) {
+                if (skip >= lengths[i]) {
+                    skip -= lengths[i];
+                    continue;
+                }
+                vectors[count].iov_base = const_cast<char*>(parts[i] + skip);
+                vectors[count].iov_len = lengths[i] - skip;
+                skip = 0;
+                count++;
             }
-            continue;
         }
         
-        std::cout << "Styx client connected" << std::endl;
+        msghdr message{};
+        message.msg_iov = vectors;
+        message.msg_iovlen = count;
+        ssize_t sent = sendmsg(connection.fd, &message, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                connection.pending_output = true;
+                return true;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            connection.output.clear();
+            return false;
+        }
         
-        // Handle client in separate thread
-        std::thread client_thread([this, client_fd]() {
-            handle_client(client_fd);
-        });
-        client_thread.detach();
+        size_t remaining = connection.output_offset + static_cast<size_t>(sent);
+        while (!connection.output.empty()) {
+            Reply& reply = connection.output.front();
+            size_t length = reply.header.size() + reply.body_length;
+            if (remaining < length) {
+                break;
+            }
+            remaining -= length;
+            release_buffer(std::move(reply.header));
+            connection.output.pop_front();
+        }
+        connection.output_offset = remaining;
     }
+    connection.pending_output = false;
+    return true;
 }
 
-void StyxServer::serve_file(const std::string& path, const std::string& content) {
-    virtual_files_[path] = content;
+void StyxServer::worker_loop() {
+    while (true) {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait(lock, [this] { return !requests_.empty() || !running_; });
+            if (!running_) {
+                return;
+            }
+            request = std::move(requests_.front());
+            requests_.pop_front();
+        }
+        process(request);
+        release_buffer(std::move(request.message));
+    }
 }
 
-void StyxServer::register_glyph_handler(std::function<void(const std::string&)> handler) {
-    glyph_handler_ = handler;
+std::vector<uint8_t> StyxServer::acquire_buffer() {
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        if (!buffer_pool_.empty()) {
+            std::vector<uint8_t> buffer = std::move(buffer_pool_.back());
+            buffer_pool_.pop_back();
+            return buffer;
+        }
+    }
+    std::vector<uint8_t> buffer;
+    buffer.reserve(POOLED_CAPACITY);
+    return buffer;
 }
 
-void StyxServer::register_vm_handler(std::function<void(const std::string&)> handler) {
-    vm_handler_ = handler;
+void StyxServer::release_buffer(std::vector<uint8_t> buffer) {
+    // Oversized buffers from large writes are not worth keeping
+    if (buffer.capacity() < POOLED_CAPACITY || buffer.capacity() > POOLED_MAX_CAPACITY) {
+        return;
+    }
+    buffer.clear();
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    if (buffer_pool_.size() < POOLED_BUFFERS) {
+        buffer_pool_.push_back(std::move(buffer));
+    }
 }
 
-void StyxServer::handle_client(int client_fd) {
-    // Simplified client handling for demo
-    std::cout << "Handling Styx client connection" << std::endl;
+void StyxServer::process(Request& request) {
+    Connection& connection = *request.connection;
+    const uint8_t* message = request.message.data();
+    auto type = static_cast<StyxMessageType>(message[4]);
+    uint16_t tag = message[5] | (message[6] << 8);
+    const uint8_t* body = message + HEADER_SIZE;
+    size_t length = request.message.size() - HEADER_SIZE;
     
-    // Echo back basic responses for now
-    char buffer[1024];
-    while (running_) {
-        ssize_t bytes = recv(client_fd, reinterpret_cast<char*>(buffer), sizeof(buffer), 0);
-        if (bytes <= 0) break;
-        
-        std::cout << "Received Styx message: " << bytes << " bytes" << std::endl;
+    Reply reply;
+    switch (type) {
+        case StyxMessageType::Tversion: reply = handle_version(connection, tag, body, length); break;
+        case StyxMessageType::Tattach:  reply = handle_attach(connection, tag, body, length); break;
+        case StyxMessageType::Tflush:   reply = handle_flush(connection, tag, body, length); break;
+        case StyxMessageType::Twalk:    reply = handle_walk(connection, tag, body, length); break;
+        case StyxMessageType::Topen:    reply = handle_open(connection, tag, body, length); break;
+        case StyxMessageType::Tread:    reply = handle_read(connection, tag, body, length); break;
+        case StyxMessageType::Twrite:   reply = handle_write(connection, tag, body, length); break;
+        case StyxMessageType::Tclunk:   reply = handle_clunk(connection, tag, body, length); break;
+        case StyxMessageType::Tstat:    reply = handle_stat(connection, tag, body, length); break;
+        case StyxMessageType::Tdrawkern:
+        case StyxMessageType::Tglyph:   reply = handle_glyph(connection, type, tag, body, length); break;
+        case StyxMessageType::Tvmspawn: reply = handle_vm_spawn(connection, tag, body, length); break;
+        default:                        reply = error_reply(tag, "operation not supported"); break;
+    }
+    
+    // Holding the state lock orders this against a Tflush for the same tag:
+    // either the reply is queued first or it is dropped
+    std::lock_guard<std::mutex> lock(connection.state_mutex);
+    auto it = connection.tags.find(tag);
+    bool flushed = it != connection.tags.end() && it->second;
+    if (it != connection.tags.end()) {
+        connection.tags.erase(it);
+    }
+    if (flushed) {
+        release_buffer(std::move(reply.header));
+        return;
+    }
+    send_reply(connection, std::move(reply));
+}
+
+void StyxServer::send_reply(Connection& connection, Reply reply) {
+    std::lock_guard<std::mutex> lock(connection.write_mutex);
+    if (connection.closed) {
+        release_buffer(std::move(reply.header));
+        return;
+    }
+    connection.output.push_back(std::move(reply));
+    if (connection.output.size() > 1) {
+        return;  // Already waiting on the socket
+    }
+    
+    // Write straight away; the reactor only sees replies the socket would not take
+    if (!flush_connection(connection)) {
+        connection.closed = true;
+        wake();
+    } else if (connection.pending_output) {
+        wake();
+    }
+}
+
+StyxServer::Reply StyxServer::error_reply(uint16_t tag, const std::string& message) {
+    Reply reply;
+    reply.header = acquire_buffer();
+    StyxWriter writer(reply.header);
+    writer.begin(StyxMessageType::Rerror, tag);
+    writer.str(message);
+    writer.finish();
+    return reply;
+}
+
+StyxServer::Reply StyxServer::handle_version(Connection& connection, uint16_t tag, const uint8_t* body, size_t length) {
+    StyxReader in(body, length);
+    uint32_t msize = in.u32();
+    std::string_view version = in.str();
+    if (!in.ok() || msize < 256) {
+        return error_reply(tag, "bad version message");
+    }
+    
+    // A new session starts without fids
+    msize = std::min(msize, MAX_MESSAGE_SIZE);
+    connection.msize = msize;
+    {
+        std::lock_guard<std::mutex> lock(connection.state_mutex);
+        connection.fids.clear();
+    }
+    
+    Reply reply;
+    reply.header = acquire_buffer();
+    StyxWriter writer(reply.header);
+    writer.begin(StyxMessageType::Rversion, tag);
+    writer.u32(msize);
+    writer.str(version.substr(0, 6) == "9P2000" ? "9P2000" : "unknown");
+    writer.finish();
+    return reply;
+}
+
+StyxServer::Reply StyxServer::handle_attach(Connection& connection, uint16_t tag, const uint8_t* body, size_t length) {
+    StyxReader in(body, length);
+    uint32_t fid = in.u32();
+    in.u32();  // afid: no authentication
+    in.str();  // uname
+    in.str();  // aname
+    if (!in.ok()) {
+        return error_reply(tag, "bad attach message");
+    }
+    {
+        std::lock_guard<std::mutex> lock(connection.state_mutex);
+        if (!connection.fids.emplace(fid, Connection::Fid{"/", true}).second) {
+            return error_reply(tag, "fid in use");
+        }
+    }
+    
+    StyxQid qid{};
+    find_qid("/", qid);
+    Reply reply;
+    reply.header = acquire_buffer();
+    StyxWriter writer(reply.header);
+    writer.begin(StyxMessageType::Rattach, tag);
+    writer.qid(qid);
+    writer.finish();
+    return reply;
+}
+
+StyxServer::Reply StyxServer::handle_flush(Connection& connection, uint16_t tag, const uint8_t* body, size_t length) {
+    StyxReader in(body, length);
+    uint16_t old_tag = in.u16();
+    if (!in.ok()) {
+        return error_reply(tag, "bad flush message");
+    }
+    if (old_tag != tag) {
+        std::lock_guard<std::mutex> lock(connection.state_mutex);
+        auto it = connection.tags.find(old_tag);
+        if (it != connection.tags.end()) {
+            it->second = true;
+        }
+    }
+    
+    Reply reply;
+    reply.header = acquire_buffer();
+    StyxWriter writer(reply.header);
+    writer.begin(StyxMessageType::Rflush, tag);
+    writer.finish();
+    return reply;
+}
+
+StyxServer::Reply StyxServer::handle_walk(Connection& connection, uint16_t tag, const uint8_t* body, size_t length) {
+    StyxReader in(body, length);
+    uint32_t fid = in.u32();
+    uint32_t newfid = in.u32();
+    uint16_t count = in.u16();
+    if (!in.ok() || count > MAX_WALK_ELEMENTS) {
+        return error_reply(tag, "bad walk message");
+    }
+    std::string_view names[MAX_WALK_ELEMENTS];
+    for (uint16_t i = 0; i < count; ++i) {
+        names[i] = in.str();
+    }
+    if (!in.ok()) {
+        return error_reply(tag, "bad walk message");
+    }
+    
+    Connection::Fid start;
+    {
+        std::lock_guard<std::mutex> lock(connection.state_mutex);
+        auto it = connection.fids.find(fid);
+        if (it == connection.fids.end()) {
+            return error_reply(tag, "unknown fid");
+        }
+        if (it->second.open) {
+            return error_reply(tag, "fid is open");
+        }
+        if (newfid != fid && connection.fids.count(newfid)) {
+            return error_reply(tag, "fid in use");
+        }
+        start = it->second;
+    }
+    
+    // Walk as far as the names lead; only a complete walk binds newfid
+    StyxQid qids[MAX_WALK_ELEMENTS];
+    size_t walked = 0;
+    std::string path = start.path;
+    bool directory = start.directory;
+    for (; walked < count && directory; ++walked) {
+        std::string next = child_path(path, names[walked]);
+        if (next.empty() || !find_qid(next, qids[walked])) {
+            break;
+        }
+        path = std::move(next);
+        directory = qids[walked].type & QTDIR;
+    }
+    if (count > 0 && walked == 0) {
+        return error_reply(tag, "file does not exist");
+    }
+    if (walked == count) {
+        std::lock_guard<std::mutex> lock(connection.state_mutex);
+        connection.fids[newfid] = Connection::Fid{path, directory};
+    }
+    
+    Reply reply;
+    reply.header = acquire_buffer();
+    StyxWriter writer(reply.header);
+    writer.begin(StyxMessageType::Rwalk, tag);
+    writer.u16(static_cast<uint16_t>(walked));
+    for (size_t i = 0; i < walked; ++i) {
+        writer.qid(qids[i]);
+    }
+    writer.finish();
+    return reply;
+}
+
+StyxServer::Reply StyxServer::handle_open(Connection& connection, uint16_t tag, const uint8_t* body, size_t length) {
+    StyxReader in(body, length);
+    uint32_t fid = in.u32();
+    uint8_t mode = in.u8();
+    if (!in.ok()) {
+        return error_reply(tag, "bad open message");
+    }
+    
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(connection.state_mutex);
+        auto it = connection.fids.find(fid);
+        if (it == connection.fids.end()) {
+            return error_reply(tag, "unknown fid");
+        }
+        Connection::Fid& entry = it->second;
+        if (entry.open) {
+            return error_reply(tag, "fid already open");
+        }
+        if (entry.directory && ((mode & 3) != 0 || (mode & OTRUNC))) {
+            return error_reply(tag, "is a directory");
+        }
+        entry.open = true;
+        entry.mode = mode;
+        path = entry.path;
+    }
+    
+    if (mode & OTRUNC) {
+        std::unique_lock<std::shared_mutex> lock(files_mutex_);
+        auto it = virtual_files_.find(path);
+        if (it != virtual_files_.end()) {
+            it->second.content = std::make_shared<std::string>();
+            it->second.version++;
+        }
+    }
+    
+    StyxQid qid{};
+    if (!find_qid(path, qid)) {
+        return error_reply(tag, "file does not exist");
+    }
+    Reply reply;
+    reply.header = acquire_buffer();
+    StyxWriter writer(reply.header);
+    writer.begin(StyxMessageType::Ropen, tag);
+    writer.qid(qid);
+    writer.u32(connection.msize - static_cast<uint32_t>(RREAD_HEADER_SIZE));
+    writer.finish();
+    return reply;
+}
+
+StyxServer::Reply StyxServer::handle_read(Connection& connection, uint16_t tag, const uint8_t* body, size_t length) {
+    StyxReader in(body, length);
+    uint32_t fid = in.u32();
+    uint64_t offset = in.u64();
+    uint32_t count = in.u32();
+    if (!in.ok()) {
+        return error_reply(tag, "bad read message");
+    }
+    count = std::min<uint32_t>(count, connection.msize - static_cast<uint32_t>(RREAD_HEADER_SIZE));
+    
+    Connection::Fid entry;
+    {
+        std::lock_guard<std::mutex> lock(connection.state_mutex);
+        auto it = connection.fids.find(fid);
+        if (it == connection.fids.end()) {
+            return error_reply(tag, "unknown fid");
+        }
+        entry = it->second;
+    }
+    if (!entry.open || (entry.mode & 3) == OWRITE) {
+        return error_reply(tag, "fid not open for reading");
+    }
+    
+    Reply reply;
+    if (entry.directory) {
+        // Directory reads return whole stat records, starting at a record boundary
+        auto listing = std::make_shared<const std::string>(list_directory(entry.path));
+        size_t start = 0;
+        size_t end = 0;
+        for (size_t position = 0; position + 2 <= listing->size();) {
+            size_t record = 2 + (static_cast<uint8_t>((*listing)[position]) | (static_cast<uint8_t>((*listing)[position + 1]) << 8));
+            if (position < offset) {
+                start = end = position + record;
+            } else if (end + record - start <= count) {
+                end += record;
+            } else {
+                break;
+            }
+            position += record;
+        }
+        reply.body = std::move(listing);
+        reply.body_offset = start;
+        reply.body_length = end - start;
+    } else {
+        std::shared_ptr<const std::string> content;
+        {
+            std::shared_lock<std::shared_mutex> lock(files_mutex_);
+            auto it = virtual_files_.find(entry.path);
+            if (it == virtual_files_.end()) {
+                return error_reply(tag, "file does not exist");
+            }
+            content = it->second.content;
+        }
+        size_t start = static_cast<size_t>(std::min<uint64_t>(offset, content->size()));
+        reply.body_offset = start;
+        reply.body_length = std::min<size_t>(count, content->size() - start);
+        reply.body = std::move(content);
+    }
+    
+    reply.header = acquire_buffer();
+    StyxWriter writer(reply.header);
+    writer.begin(StyxMessageType::Rread, tag);
+    writer.u32(static_cast<uint32_t>(reply.body_length));
+    writer.finish(reply.body_length);
+    return reply;
+}
+
+StyxServer::Reply StyxServer::handle_write(Connection& connection, uint16_t tag, const uint8_t* body, size_t length) {
+    StyxReader in(body, length);
+    uint32_t fid = in.u32();
+    uint64_t offset = in.u64();
+    uint32_t count = in.u32();
+    const uint8_t* data = in.bytes(count);
+    if (!in.ok()) {
+        return error_reply(tag, "bad write message");
+    }
+    
+    Connection::Fid entry;
+    {
+        std::lock_guard<std::mutex> lock(connection.state_mutex);
+        auto it = connection.fids.find(fid);
+        if (it == connection.fids.end()) {
+            return error_reply(tag, "unknown fid");
+        }
+        entry = it->second;
+    }
+    if (!entry.open || ((entry.mode & 3) != OWRITE && (entry.mode & 3) != ORDWR)) {
+        return error_reply(tag, "fid not open for writing");
+    }
+    if (offset > MAX_FILE_SIZE || count > MAX_FILE_SIZE - offset) {
+        return error_reply(tag, "file too large");
+    }
+    
+    {
+        std::unique_lock<std::shared_mutex> lock(files_mutex_);
+        auto it = virtual_files_.find(entry.path);
+        if (it == virtual_files_.end()) {
+            return error_reply(tag, "file does not exist");
+        }
         
-        // Send a simple response
-        const char* response = "Styx DrawKern server ready\n";
-        send(client_fd, reinterpret_cast<const char*>(response), strlen(response), 0);
+        // Contents still referenced by an unsent Rread are copied first; new
+        // references are only taken under the shared lock
+        auto& content = it->second.content;
+        if (content.use_count() > 1) {
+            content = std::make_shared<std::string>(*content);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (content->size() < offset + count) {
+            content->resize(offset + count);
+        }
+        std::memcpy(content->data() + offset, data, count);
+        it->second.version++;
+    }
+    
+    Reply reply;
+    reply.header = acquire_buffer();
+    StyxWriter writer(reply.header);
+    writer.begin(StyxMessageType::Rwrite, tag);
+    writer.u32(count);
+    writer.finish();
+    return reply;
+}
+
+StyxServer::Reply StyxServer::handle_clunk(Connection& connection, uint16_t tag, const uint8_t* body, size_t length) {
+    StyxReader in(body, length);
+    uint32_t fid = in.u32();
+    if (!in.ok()) {
+        return error_reply(tag, "bad clunk message");
+    }
+    {
+        std::lock_guard<std::mutex> lock(connection.state_mutex);
+        if (connection.fids.erase(fid) == 0) {
+            return error_reply(tag, "unknown fid");
+        }
     }
     
-    close(client_fd);
-    std::cout << "Styx client disconnected" << std::endl;
+    Reply reply;
+    reply.header = acquire_buffer();
+    StyxWriter writer(reply.header);
+    writer.begin(StyxMessageType::Rclunk, tag);
+    writer.finish();
+    return reply;
+}
+
+StyxServer::Reply StyxServer::handle_stat(Connection& connection, uint16_t tag, const uint8_t* body, size_t length) {
+    StyxReader in(body, length);
+    uint32_t fid = in.u32();
+    if (!in.ok()) {
+        return error_reply(tag, "bad stat message");
+    }
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(connection.state_mutex);
+        auto it = connection.fids.find(fid);
+        if (it == connection.fids.end()) {
+            return error_reply(tag, "unknown fid");
+        }
+        path = it->second.path;
+    }
+    StyxQid qid{};
+    uint64_t file_length = 0;
+    if (!find_qid(path, qid, &file_length)) {
+        return error_reply(tag, "file does not exist");
+    }
+    
+    // Rstat message data: n[2] stat[n]
+    Reply reply;
+    reply.header = acquire_buffer();
+    StyxWriter writer(reply.header);
+    writer.begin(StyxMessageType::Rstat, tag);
+    size_t size_at = reply.header.size();
+    writer.u16(0);
+    write_stat(reply.header, base_name(path), qid, file_length);
+    uint16_t stat_size = static_cast<uint16_t>(reply.header.size() - size_at - 2);
+    reply.header[size_at] = stat_size & 0xFF;
+    reply.header[size_at + 1] = stat_size >> 8;
+    writer.finish();
+    return reply;
+}
+
+StyxServer::Reply StyxServer::handle_glyph(Connection& connection, StyxMessageType type, uint16_t tag,
+                                           const uint8_t* body, size_t length) {
+    (void)connection;
+    StyxReader in(body, length);
+    
+    // Tdrawkern message data: command[s] payload[s]; Tglyph carries the glyph alone
+    if (type == StyxMessageType::Tdrawkern && in.str() != "glyph") {
+        return in.ok() ? error_reply(tag, "unknown drawkern command") : error_reply(tag, "bad drawkern message");
+    }
+    std::string_view glyph = in.str();
+    if (!in.ok()) {
+        return error_reply(tag, "bad glyph message");
+    }
+    
+    std::function<void(const std::string&)> handler;
+    {
+        std::shared_lock<std::shared_mutex> lock(files_mutex_);
+        handler = glyph_handler_;
+    }
+    if (handler) {
+        handler(std::string(glyph));
+    }
+    
+    Reply reply;
+    reply.header = acquire_buffer();
+    StyxWriter writer(reply.header);
+    writer.begin(type == StyxMessageType::Tdrawkern ? StyxMessageType::Rdrawkern : StyxMessageType::Rglyph, tag);
+    writer.finish();
+    return reply;
+}
+
+StyxServer::Reply StyxServer::handle_vm_spawn(Connection& connection, uint16_t tag, const uint8_t* body, size_t length) {
+    (void)connection;
+    StyxReader in(body, length);
+    std::string_view spec = in.str();
+    if (!in.ok()) {
+        return error_reply(tag, "bad vmspawn message");
+    }
+    
+    std::function<void(const std::string&)> handler;
+    {
+        std::shared_lock<std::shared_mutex> lock(files_mutex_);
+        handler = vm_handler_;
+    }
+    if (handler) {
+        handler(std::string(spec));
+    }
+    
+    Reply reply;
+    reply.header = acquire_buffer();
+    StyxWriter writer(reply.header);
+    writer.begin(StyxMessageType::Rvmspawn, tag);
+    writer.finish();
+    return reply;
+}
+
+bool StyxServer::is_directory(const std::string& path) const {
+    if (path == "/") {
+        return true;
+    }
+    std::string prefix = path + "/";
+    auto it = virtual_files_.lower_bound(prefix);
+    return it != virtual_files_.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+}
+
+bool StyxServer::find_qid(const std::string& path, StyxQid& qid, uint64_t* length) const {
+    std::shared_lock<std::shared_mutex> lock(files_mutex_);
+    auto it = virtual_files_.find(path);
+    if (it != virtual_files_.end()) {
+        qid = StyxQid{0, it->second.version, it->second.qid_path};
+        if (length) {
+            *length = it->second.content->size();
+        }
+        return true;
+    }
+    if (is_directory(path)) {
+        qid = StyxQid{QTDIR, 0, directory_qid_path(path)};
+        return true;
+    }
+    return false;
+}
+
+std::string StyxServer::list_directory(const std::string& path) const {
+    std::string listing;
+    std::string prefix = path == "/" ? "/" : path + "/";
+    std::string last_directory;
+    
+    std::shared_lock<std::shared_mutex> lock(files_mutex_);
+    for (auto it = virtual_files_.lower_bound(prefix);
+         it != virtual_files_.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+        std::string rest = it->first.substr(prefix.size());
+        size_t slash = rest.find('/');
+        if (slash == std::string::npos) {
+            write_stat(listing, rest, StyxQid{0, it->second.version, it->second.qid_path}, it->second.content->size());
+            continue;
+        }
+        // Files below one subdirectory sort together, so one record covers them
+        std::string name = rest.substr(0, slash);
+        if (name != last_directory) {
+            write_stat(listing, name, StyxQid{QTDIR, 0, directory_qid_path(prefix + name)}, 0);
+            last_directory = name;
+        }
+    }
+    return listing;
+}
+
+void StyxServer::serve_file(const std::string& path, const std::string& content) {
+    std::unique_lock<std::shared_mutex> lock(files_mutex_);
+    FileEntry& entry = virtual_files_[path];
+    if (entry.qid_path == 0) {
+        entry.qid_path = next_qid_path_++;
+    } else {
+        entry.version++;
+    }
+    entry.content = std::make_shared<std::string>(content);
+}
+
+void StyxServer::serve_vm_namespace(const std::string& vm_id) {
+    serve_file("/vm/" + vm_id + "/ctl", "");
+    serve_file("/vm/" + vm_id + "/status", "running");
+}
+
+std::optional<std::string> StyxServer::file_content(const std::string& path) const {
+    std::shared_lock<std::shared_mutex> lock(files_mutex_);
+    auto it = virtual_files_.find(path);
+    if (it == virtual_files_.end()) {
+        return std::nullopt;
+    }
+    return *it->second.content;
+}
+
+void StyxServer::register_glyph_handler(std::function<void(const std::string&)> handler) {
+    std::unique_lock<std::shared_mutex> lock(files_mutex_);
+    glyph_handler_ = handler;
+}
+
+void StyxServer::register_vm_handler(std::function<void(const std::string&)> handler) {
+    std::unique_lock<std::shared_mutex> lock(files_mutex_);
+    vm_handler_ = handler;
 }
 
 // DrawKernNamespace implementation
@@ -4,13 +4,179 @@
 #include <iostream>
 #include <sstream>
 #include <algorithm>
-#include <cctype>
+#include <array>
+#include <charconv>
+#include <cstring>
 
 namespace bolt {
 namespace drawkern {
 
+namespace {
+    // Character classes for the lexer
+    enum CharClass : uint8_t {
+        SPACE = 1,
+        ALPHA = 2,   // Letters and '_'
+        DIGIT = 4
+    };
+    
+    constexpr std::array<uint8_t, 256> make_char_classes() {
+        std::array<uint8_t, 256> classes{};
+        for (char c : {' ', '\t', '\n', '\r', '\v', '\f'}) classes[static_cast<uint8_t>(c)] = SPACE;
+        for (int c = 'a'; c <= 'z'; ++c) classes[c] = ALPHA;
+        for (int c = 'A'; c <= 'Z'; ++c) classes[c] = ALPHA;
+        classes['_'] = ALPHA;
+        for (int c = '0'; c <= '9'; ++c) classes[c] = DIGIT;
+        return classes;
+    }
+    
+    constexpr std::array<uint8_t, 256> CHAR_CLASSES = make_char_classes();
+    
+    inline bool has_class(char c, uint8_t mask) {
+        return CHAR_CLASSES[static_cast<uint8_t>(c)] & mask;
+    }
+    
+    TokenType keyword_type(std::string_view word) {
+        switch (word.size()) {
+            case 2:
+                if (word == "vm") return TokenType::VM;
+                if (word == "ai") return TokenType::AI;
+                break;
+            case 3:
+                if (word == "dis") return TokenType::DIS;
+                break;
+            case 4:
+                if (word == "wasm") return TokenType::WASM;
+                break;
+            case 5:
+                if (word == "glyph") return TokenType::GLYPH;
+                if (word == "model") return TokenType::MODEL;
+                if (word == "tools") return TokenType::TOOLS;
+                break;
+            case 6:
+                if (word == "native") return TokenType::NATIVE;
+                if (word == "render") return TokenType::RENDER;
+                break;
+            case 9:
+                if (word == "workbench") return TokenType::WORKBENCH;
+                if (word == "namespace") return TokenType::NAMESPACE;
+                break;
+        }
+        return TokenType::IDENTIFIER;
+    }
+    
+    bool is_keyword(TokenType type) {
+        return type >= TokenType::VM && type <= TokenType::NAMESPACE;
+    }
+    
+    const char* token_description(TokenType type) {
+        switch (type) {
+            case TokenType::ASSIGN: return "'='";
+            case TokenType::SEMICOLON: return "';'";
+            case TokenType::COMMA: return "','";
+            case TokenType::COLON: return "':'";
+            case TokenType::LBRACE: return "'{'";
+            case TokenType::RBRACE: return "'}'";
+            case TokenType::LPAREN: return "'('";
+            case TokenType::RPAREN: return "')'";
+            case TokenType::LBRACKET: return "'['";
+            case TokenType::RBRACKET: return "']'";
+            case TokenType::STRING: return "string";
+            case TokenType::NUMBER: return "number";
+            case TokenType::END_OF_FILE: return "end of input";
+            default: return "identifier";
+        }
+    }
+    
+    const Token END_TOKEN(TokenType::END_OF_FILE, "", 0, 0);
+    
+    VMGlyph default_vm_glyph() {
+        VMGlyph glyph;
+        glyph.vm_type = "dis";
+        glyph.architecture = "portable";
+        glyph.render.width = 800;
+        glyph.render.height = 600;
+        glyph.render.background_color = 0x1e1e1e;
+        glyph.render.interactive = true;
+        glyph.render.ai_enabled = false;
+        return glyph;
+    }
+}
+
+// ASTArena implementation
+ASTArena::ASTArena() {
+    for (std::string_view name : {"name", "type", "value"}) {
+        intern(name);
+    }
+}
+
+void* ASTArena::allocate(size_t size, size_t alignment) {
+    size_t padding = (alignment - reinterpret_cast<uintptr_t>(cursor_) % alignment) % alignment;
+    if (padding + size > remaining_) {
+        size_t block_size = std::max(BLOCK_SIZE, size + alignment);
+        blocks_.push_back(std::make_unique<std::byte[]>(block_size));
+        cursor_ = blocks_.back().get();
+        remaining_ = block_size;
+        padding = (alignment - reinterpret_cast<uintptr_t>(cursor_) % alignment) % alignment;
+    }
+    std::byte* result = cursor_ + padding;
+    cursor_ = result + size;
+    remaining_ -= padding + size;
+    used_ += padding + size;
+    return result;
+}
+
+std::string_view ASTArena::store(std::string_view text) {
+    char* copy = allocate_array<char>(text.size());
+    if (copy) {
+        std::memcpy(copy, text.data(), text.size());
+    }
+    return std::string_view(copy, text.size());
+}
+
+SymbolId ASTArena::intern(std::string_view name) {
+    auto it = symbol_ids_.find(name);
+    if (it != symbol_ids_.end()) {
+        return it->second;
+    }
+    std::string_view stored = store(name);
+    SymbolId id = static_cast<SymbolId>(symbols_.size());
+    symbols_.push_back(stored);
+    symbol_ids_.emplace(stored, id);
+    return id;
+}
+
 // ASTNode implementation
-std::string ASTNode::to_string() const {
+void ASTNode::set_children(ASTArena& arena, std::span<ASTNode* const> children) {
+    children_ = arena.allocate_array<ASTNode*>(children.size());
+    std::copy(children.begin(), children.end(), children_);
+    child_count_ = static_cast<uint32_t>(children.size());
+}
+
+void ASTNode::set_attribute(ASTArena& arena, SymbolId key, std::string_view value) {
+    for (uint32_t i = 0; i < attribute_count_; ++i) {
+        if (attributes_[i].key == key) {
+            attributes_[i].value = value;
+            return;
+        }
+    }
+    // Nodes carry one or two attributes, so growing by copy is cheap
+    ASTAttribute* grown = arena.allocate_array<ASTAttribute>(attribute_count_ + 1);
+    std::copy(attributes_, attributes_ + attribute_count_, grown);
+    grown[attribute_count_] = ASTAttribute{key, value};
+    attributes_ = grown;
+    attribute_count_++;
+}
+
+std::string_view ASTNode::get_attribute(SymbolId key) const {
+    for (const auto& attribute : attributes()) {
+        if (attribute.key == key) {
+            return attribute.value;
+        }
+    }
+    return {};
+}
+
+std::string ASTNode::to_string(const ASTArena& arena) const {
     std::string result;
     switch (type) {
         case ASTNodeType::PROGRAM: result = "Program"; break;
@@ -25,10 +191,13 @@ std::string ASTNode::to_string() const {
         case ASTNodeType::CALL: result = "Call"; break;
     }
     
-    if (!attributes.empty()) {
+    if (attribute_count_ > 0) {
         result += " {";
-        for (const auto& [key, value] : attributes) {
-            result += " " + key + "=" + value;
+        for (const auto& attribute : attributes()) {
+            result += " ";
+            result += arena.symbol_name(attribute.key);
+            result += "=";
+            result += attribute.value;
         }
         result += " }";
     }
@@ -36,9 +205,24 @@ std::string ASTNode::to_string() const {
     return result;
 }
 
+// GlyphAST implementation
+GlyphAST GlyphAST::parse(std::string_view source, size_t first_line) {
+    GlyphAST ast;
+    ast.source_ = ast.arena_.store(source);
+    
+    GlyphLexer lexer(ast.source_, first_line);
+    GlyphParser parser(lexer, ast.arena_);
+    ast.root_ = parser.parse();
+    
+    ast.errors_ = lexer.get_errors();
+    auto parser_errors = parser.get_errors();
+    ast.errors_.insert(ast.errors_.end(), parser_errors.begin(), parser_errors.end());
+    return ast;
+}
+
 // GlyphLexer implementation
-GlyphLexer::GlyphLexer(const std::string& input) 
-    : input_(input), pos_(0), line_(1), column_(1) {
+GlyphLexer::GlyphLexer(std::string_view input, size_t first_line) 
+    : input_(input), pos_(0), line_(first_line), line_start_(0) {
 }
 
 GlyphLexer::~GlyphLexer() {
@@ -46,9 +230,10 @@ GlyphLexer::~GlyphLexer() {
 
 std::vector<Token> GlyphLexer::tokenize() {
     std::vector<Token> tokens;
+    tokens.reserve(input_.size() / 6 + 1);
     errors_.clear();
     
-    while (pos_ < input_.length()) {
+    while (true) {
         Token token = next_token();
         if (token.type != TokenType::UNKNOWN) {
             tokens.push_back(token);
@@ -63,222 +248,180 @@ std::vector<Token> GlyphLexer::tokenize() {
 }
 
 Token GlyphLexer::next_token() {
-    skip_whitespace();
+    skip_whitespace_and_comments();
     
-    if (pos_ >= input_.length()) {
-        return Token(TokenType::END_OF_FILE, "", line_, column_);
+    if (pos_ >= input_.size()) {
+        return Token(TokenType::END_OF_FILE, "", line_, column());
     }
     
-    char ch = current_char();
-    
-    // Comments
-    if (ch == '/' && peek_char() == '/') {
-        skip_comment();
-        return next_token();
-    }
+    char ch = input_[pos_];
     
     // Single character tokens
+    TokenType single = TokenType::UNKNOWN;
     switch (ch) {
-        case '=': advance(); return Token(TokenType::ASSIGN, "=", line_, column_ - 1);
-        case ';': advance(); return Token(TokenType::SEMICOLON, ";", line_, column_ - 1);
-        case ',': advance(); return Token(TokenType::COMMA, ",", line_, column_ - 1);
-        case '{': advance(); return Token(TokenType::LBRACE, "{", line_, column_ - 1);
-        case '}': advance(); return Token(TokenType::RBRACE, "}", line_, column_ - 1);
-        case '(': advance(); return Token(TokenType::LPAREN, "(", line_, column_ - 1);
-        case ')': advance(); return Token(TokenType::RPAREN, ")", line_, column_ - 1);
-        case '[': advance(); return Token(TokenType::LBRACKET, "[", line_, column_ - 1);
-        case ']': advance(); return Token(TokenType::RBRACKET, "]", line_, column_ - 1);
+        case '=': single = TokenType::ASSIGN; break;
+        case ';': single = TokenType::SEMICOLON; break;
+        case ',': single = TokenType::COMMA; break;
+        case ':': single = TokenType::COLON; break;
+        case '{': single = TokenType::LBRACE; break;
+        case '}': single = TokenType::RBRACE; break;
+        case '(': single = TokenType::LPAREN; break;
+        case ')': single = TokenType::RPAREN; break;
+        case '[': single = TokenType::LBRACKET; break;
+        case ']': single = TokenType::RBRACKET; break;
+        case '"': return read_string();
     }
-    
-    // String literals
-    if (ch == '"') {
-        return read_string();
+    if (single != TokenType::UNKNOWN) {
+        Token token(single, input_.substr(pos_, 1), line_, column());
+        pos_++;
+        return token;
     }
     
-    // Numbers
-    if (is_digit(ch)) {
+    if (has_class(ch, DIGIT)) {
         return read_number();
     }
     
     // Identifiers and keywords
-    if (is_alpha(ch) || ch == '_') {
+    if (has_class(ch, ALPHA)) {
         return read_identifier();
     }
     
     add_error("Unexpected character: " + std::string(1, ch));
-    advance();
-    return Token(TokenType::UNKNOWN, std::string(1, ch), line_, column_ - 1);
-}
-
-char GlyphLexer::current_char() {
-    if (pos_ >= input_.length()) return '\0';
-    return input_[pos_];
-}
-
-char GlyphLexer::peek_char() {
-    if (pos_ + 1 >= input_.length()) return '\0';
-    return input_[pos_ + 1];
+    Token token(TokenType::UNKNOWN, input_.substr(pos_, 1), line_, column());
+    pos_++;
+    return token;
 }
 
-void GlyphLexer::advance() {
-    if (pos_ < input_.length()) {
-        if (input_[pos_] == '\n') {
+void GlyphLexer::skip_whitespace_and_comments() {
+    while (pos_ < input_.size()) {
+        char ch = input_[pos_];
+        if (ch == '\n') {
+            pos_++;
             line_++;
-            column_ = 1;
+            line_start_ = pos_;
+        } else if (has_class(ch, SPACE)) {
+            pos_++;
+        } else if (ch == '/' && pos_ + 1 < input_.size() && input_[pos_ + 1] == '/') {
+            size_t end = input_.find('\n', pos_);
+            pos_ = end == std::string_view::npos ? input_.size() : end;
         } else {
-            column_++;
+            break;
         }
-        pos_++;
-    }
-}
-
-void GlyphLexer::skip_whitespace() {
-    while (pos_ < input_.length() && std::isspace(current_char())) {
-        advance();
-    }
-}
-
-void GlyphLexer::skip_comment() {
-    while (pos_ < input_.length() && current_char() != '\n') {
-        advance();
     }
 }
 
 Token GlyphLexer::read_identifier() {
-    size_t start_line = line_;
-    size_t start_column = column_;
-    std::string value;
-    
-    while (pos_ < input_.length() && (is_alnum(current_char()) || current_char() == '_')) {
-        value += current_char();
-        advance();
+    size_t start = pos_;
+    while (pos_ < input_.size() && has_class(input_[pos_], ALPHA | DIGIT)) {
+        pos_++;
     }
     
-    // Check for keywords
-    TokenType type = TokenType::IDENTIFIER;
-    if (value == "vm") type = TokenType::VM;
-    else if (value == "glyph") type = TokenType::GLYPH;
-    else if (value == "workbench") type = TokenType::WORKBENCH;
-    else if (value == "dis") type = TokenType::DIS;
-    else if (value == "native") type = TokenType::NATIVE;
-    else if (value == "wasm") type = TokenType::WASM;
-    else if (value == "render") type = TokenType::RENDER;
-    else if (value == "ai") type = TokenType::AI;
-    else if (value == "model") type = TokenType::MODEL;
-    else if (value == "tools") type = TokenType::TOOLS;
-    else if (value == "namespace") type = TokenType::NAMESPACE;
-    
-    return Token(type, value, start_line, start_column);
+    std::string_view value = input_.substr(start, pos_ - start);
+    return Token(keyword_type(value), value, line_, start - line_start_ + 1);
 }
 
 Token GlyphLexer::read_string() {
     size_t start_line = line_;
-    size_t start_column = column_;
-    std::string value;
-    
-    advance(); // Skip opening quote
-    
-    while (pos_ < input_.length() && current_char() != '"') {
-        if (current_char() == '\\' && peek_char() != '\0') {
-            advance();
-            char escaped = current_char();
-            switch (escaped) {
-                case 'n': value += '\n'; break;
-                case 't': value += '\t'; break;
-                case 'r': value += '\r'; break;
-                case '\\': value += '\\'; break;
-                case '"': value += '"'; break;
-                default: value += escaped; break;
-            }
-        } else {
-            value += current_char();
+    size_t start_column = column();
+    size_t start = ++pos_;  // Skip opening quote
+    bool escapes = false;
+    
+    // The value stays a view of the source; escapes are decoded by whoever keeps it
+    while (pos_ < input_.size() && input_[pos_] != '"') {
+        if (input_[pos_] == '\\' && pos_ + 1 < input_.size()) {
+            escapes = true;
+            pos_++;
         }
-        advance();
+        if (input_[pos_] == '\n') {
+            line_++;
+            line_start_ = pos_ + 1;
+        }
+        pos_++;
     }
     
-    if (current_char() == '"') {
-        advance(); // Skip closing quote
+    Token token(TokenType::STRING, input_.substr(start, pos_ - start), start_line, start_column);
+    token.has_escapes = escapes;
+    if (pos_ < input_.size()) {
+        pos_++; // Skip closing quote
     } else {
         add_error("Unterminated string literal");
     }
-    
-    return Token(TokenType::STRING, value, start_line, start_column);
+    return token;
 }
 
 Token GlyphLexer::read_number() {
-    size_t start_line = line_;
-    size_t start_column = column_;
-    std::string value;
-    
-    while (pos_ < input_.length() && (is_digit(current_char()) || current_char() == '.')) {
-        value += current_char();
-        advance();
+    size_t start = pos_;
+    while (pos_ < input_.size() && (has_class(input_[pos_], DIGIT) || input_[pos_] == '.')) {
+        pos_++;
     }
     
-    return Token(TokenType::NUMBER, value, start_line, start_column);
-}
-
-bool GlyphLexer::is_alpha(char c) {
-    return std::isalpha(c);
-}
-
-bool GlyphLexer::is_digit(char c) {
-    return std::isdigit(c);
-}
-
-bool GlyphLexer::is_alnum(char c) {
-    return std::isalnum(c);
+    return Token(TokenType::NUMBER, input_.substr(start, pos_ - start), line_, start - line_start_ + 1);
 }
 
 void GlyphLexer::add_error(const std::string& message) {
-    errors_.push_back("Line " + std::to_string(line_) + ", Column " + std::to_string(column_) + ": " + message);
+    errors_.push_back("Line " + std::to_string(line_) + ", Column " + std::to_string(column()) + ": " + message);
 }
 
 // GlyphParser implementation
-GlyphParser::GlyphParser(const std::vector<Token>& tokens) 
-    : tokens_(tokens), pos_(0) {
+GlyphParser::GlyphParser(GlyphLexer& lexer, ASTArena& arena) 
+    : lexer_(lexer), arena_(arena), current_(END_TOKEN), next_(END_TOKEN), previous_(END_TOKEN) {
 }
 
 GlyphParser::~GlyphParser() {
 }
 
-std::unique_ptr<ProgramNode> GlyphParser::parse() {
+ProgramNode* GlyphParser::parse() {
     errors_.clear();
-    pos_ = 0;
+    scratch_.clear();
+    current_ = pull_token();
+    next_ = pull_token();
     
-    auto program = std::make_unique<ProgramNode>();
+    auto* program = arena_.make<ProgramNode>();
+    size_t scratch_start = scratch_.size();
     
-    while (pos_ < tokens_.size() && current_token().type != TokenType::END_OF_FILE) {
-        auto statement = parse_statement();
+    while (!match(TokenType::END_OF_FILE)) {
+        if (match(TokenType::RBRACE)) {
+            add_error("Unexpected '}'");
+            advance();
+            continue;
+        }
+        auto* statement = parse_statement();
         if (statement) {
-            program->add_child(std::move(statement));
+            scratch_.push_back(statement);
         }
     }
     
+    finish_children(program, scratch_start);
     return program;
 }
 
-Token GlyphParser::current_token() {
-    if (pos_ >= tokens_.size()) {
-        return Token(TokenType::END_OF_FILE, "", 0, 0);
-    }
-    return tokens_[pos_];
+const Token& GlyphParser::current_token() const {
+    return current_;
 }
 
-Token GlyphParser::peek_token() {
-    if (pos_ + 1 >= tokens_.size()) {
-        return Token(TokenType::END_OF_FILE, "", 0, 0);
-    }
-    return tokens_[pos_ + 1];
+const Token& GlyphParser::peek_token() const {
+    return next_;
 }
 
 void GlyphParser::advance() {
-    if (pos_ < tokens_.size()) {
-        pos_++;
+    if (current_.type == TokenType::END_OF_FILE) {
+        return;
+    }
+    previous_ = current_;
+    current_ = next_;
+    next_ = next_.type == TokenType::END_OF_FILE ? next_ : pull_token();
+}
+
+// The lexer has already reported characters it could not classify
+Token GlyphParser::pull_token() {
+    Token token = lexer_.next_token();
+    while (token.type == TokenType::UNKNOWN) {
+        token = lexer_.next_token();
     }
+    return token;
 }
 
-bool GlyphParser::match(TokenType type) {
+bool GlyphParser::match(TokenType type) const {
     return current_token().type == type;
 }
 
@@ -290,204 +433,290 @@ bool GlyphParser::consume(TokenType type) {
     return false;
 }
 
-std::unique_ptr<ASTNode> GlyphParser::parse_statement() {
-    if (match(TokenType::VM)) {
+bool GlyphParser::expect(TokenType type, const char* message) {
+    if (consume(type)) {
+        return true;
+    }
+    add_error(message);
+    return false;
+}
+
+bool GlyphParser::at_declaration() const {
+    TokenType type = current_token().type;
+    return type == TokenType::VM || type == TokenType::GLYPH || type == TokenType::WORKBENCH;
+}
+
+// Skip to just past the next ';', or to the '}' or declaration that ends
+// the enclosing body, stepping over nested braces and brackets
+void GlyphParser::synchronize() {
+    int depth = 0;
+    while (!match(TokenType::END_OF_FILE)) {
+        TokenType type = current_token().type;
+        if (depth == 0 && (type == TokenType::RBRACE || at_declaration())) {
+            return;
+        }
+        if (type == TokenType::LBRACE || type == TokenType::LBRACKET) {
+            depth++;
+        } else if ((type == TokenType::RBRACE || type == TokenType::RBRACKET) && depth > 0) {
+            depth--;
+        }
+        advance();
+        if (depth == 0 && type == TokenType::SEMICOLON) {
+            return;
+        }
+    }
+}
+
+std::string_view GlyphParser::token_text(const Token& token) {
+    if (!token.has_escapes) {
+        return token.value;
+    }
+    
+    std::string decoded;
+    decoded.reserve(token.value.size());
+    for (size_t i = 0; i < token.value.size(); ++i) {
+        char ch = token.value[i];
+        if (ch == '\\' && i + 1 < token.value.size()) {
+            switch (char escaped = token.value[++i]) {
+                case 'n': decoded += '\n'; break;
+                case 't': decoded += '\t'; break;
+                case 'r': decoded += '\r'; break;
+                default: decoded += escaped; break;
+            }
+        } else {
+            decoded += ch;
+        }
+    }
+    return arena_.store(decoded);
+}
+
+void GlyphParser::finish_children(ASTNode* node, size_t scratch_start) {
+    node->set_children(arena_, std::span<ASTNode* const>(scratch_.data() + scratch_start, scratch_.size() - scratch_start));
+    scratch_.resize(scratch_start);
+}
+
+ASTNode* GlyphParser::parse_statement() {
+    const Token& token = current_token();
+    if (token.type == TokenType::VM) {
         return parse_vm_declaration();
-    } else if (match(TokenType::GLYPH) || match(TokenType::WORKBENCH)) {
+    }
+    if (token.type == TokenType::GLYPH || token.type == TokenType::WORKBENCH) {
         return parse_glyph_declaration();
-    } else if (match(TokenType::IDENTIFIER)) {
+    }
+    
+    // Keywords double as property names: model = "...";
+    if (peek_token().type == TokenType::ASSIGN && (token.type == TokenType::IDENTIFIER || is_keyword(token.type))) {
         return parse_property();
-    } else {
-        add_error("Expected statement, got " + current_token().value);
-        advance();
-        return nullptr;
     }
+    if ((token.type == TokenType::RENDER || token.type == TokenType::AI || token.type == TokenType::NAMESPACE) &&
+        peek_token().type == TokenType::LBRACE) {
+        return parse_block();
+    }
+    if (token.type == TokenType::IDENTIFIER && token.value == "mount") {
+        return parse_mount();
+    }
+    
+    add_error("Expected statement, got " + std::string(token_description(token.type)) +
+              (token.value.empty() ? "" : " '" + std::string(token.value) + "'"));
+    advance();
+    synchronize();
+    return nullptr;
 }
 
-std::unique_ptr<VMDeclNode> GlyphParser::parse_vm_declaration() {
-    if (!consume(TokenType::VM)) {
-        return nullptr;
-    }
+VMDeclNode* GlyphParser::parse_vm_declaration() {
+    Token keyword = current_token();
+    advance();
     
     if (!match(TokenType::IDENTIFIER)) {
         add_error("Expected VM name");
+        synchronize();
         return nullptr;
     }
-    
-    std::string vm_id = current_token().value;
+    std::string_view vm_id = current_token().value;
     advance();
     
-    if (!consume(TokenType::ASSIGN)) {
+    // vm name : type, also accepted with '='
+    if (!consume(TokenType::COLON) && !consume(TokenType::ASSIGN)) {
         add_error("Expected ':' after VM name");
-        return nullptr;
     }
     
-    std::string vm_type;
-    if (match(TokenType::DIS)) {
-        vm_type = "dis";
-        advance();
-    } else if (match(TokenType::NATIVE)) {
-        vm_type = "native";
-        advance();
-    } else if (match(TokenType::WASM)) {
-        vm_type = "wasm";
+    std::string_view vm_type;
+    if (match(TokenType::DIS) || match(TokenType::NATIVE) || match(TokenType::WASM)) {
+        vm_type = current_token().value;
         advance();
     } else {
         add_error("Expected VM type (dis, native, wasm)");
-        return nullptr;
-    }
-    
-    auto vm_node = std::make_unique<VMDeclNode>(vm_id, vm_type);
-    
-    if (consume(TokenType::LBRACE)) {
-        auto block = parse_block();
-        if (block) {
-            vm_node->add_child(std::move(block));
-        }
     }
     
+    auto* vm_node = arena_.make<VMDeclNode>(vm_id, vm_type);
+    vm_node->line = keyword.line;
+    vm_node->column = keyword.column;
+    parse_body(vm_node);
     return vm_node;
 }
 
-std::unique_ptr<GlyphDeclNode> GlyphParser::parse_glyph_declaration() {
-    bool is_workbench = match(TokenType::WORKBENCH);
-    
-    if (!(consume(TokenType::GLYPH) || consume(TokenType::WORKBENCH))) {
-        return nullptr;
-    }
+GlyphDeclNode* GlyphParser::parse_glyph_declaration() {
+    Token keyword = current_token();
+    bool is_workbench = keyword.type == TokenType::WORKBENCH;
+    advance();
     
     if (!match(TokenType::IDENTIFIER)) {
         add_error("Expected glyph name");
+        synchronize();
         return nullptr;
     }
-    
-    std::string glyph_id = current_token().value;
+    std::string_view glyph_id = current_token().value;
     advance();
     
-    // Expect 'on' keyword (simplified - using identifier)
-    if (!match(TokenType::IDENTIFIER) || current_token().value != "on") {
+    // Expect 'on' keyword (an identifier, so it stays usable as a name)
+    std::string_view base_vm;
+    if (match(TokenType::IDENTIFIER) && current_token().value == "on") {
+        advance();
+        if (match(TokenType::IDENTIFIER)) {
+            base_vm = current_token().value;
+            advance();
+        } else {
+            add_error("Expected VM name after 'on'");
+        }
+    } else {
         add_error("Expected 'on' after glyph name");
-        return nullptr;
     }
-    advance();
     
-    if (!match(TokenType::IDENTIFIER)) {
-        add_error("Expected VM name after 'on'");
-        return nullptr;
-    }
-    
-    std::string base_vm = current_token().value;
-    advance();
-    
-    auto glyph_node = std::make_unique<GlyphDeclNode>(glyph_id, base_vm);
+    auto* glyph_node = arena_.make<GlyphDeclNode>(glyph_id, base_vm);
+    glyph_node->line = keyword.line;
+    glyph_node->column = keyword.column;
     if (is_workbench) {
-        glyph_node->set_attribute("type", "workbench");
+        glyph_node->set_attribute(arena_, ASTSymbol::TYPE, "workbench");
     }
-    
-    if (consume(TokenType::LBRACE)) {
-        auto block = parse_block();
-        if (block) {
-            glyph_node->add_child(std::move(block));
-        }
-    }
-    
+    parse_body(glyph_node);
     return glyph_node;
 }
 
-std::unique_ptr<PropertyNode> GlyphParser::parse_property() {
-    if (!match(TokenType::IDENTIFIER)) {
-        return nullptr;
+void GlyphParser::parse_body(ASTNode* node) {
+    size_t scratch_start = scratch_.size();
+    if (expect(TokenType::LBRACE, "Expected '{'")) {
+        while (!match(TokenType::RBRACE) && !match(TokenType::END_OF_FILE) && !at_declaration()) {
+            if (auto* statement = parse_statement()) {
+                scratch_.push_back(statement);
+            }
+        }
+        expect(TokenType::RBRACE, "Expected '}'");
+    } else {
+        synchronize();
     }
-    
-    std::string name = current_token().value;
+    finish_children(node, scratch_start);
+}
+
+PropertyNode* GlyphParser::parse_property() {
+    Token name = current_token();
     advance();
+    advance(); // '='
     
-    if (!consume(TokenType::ASSIGN)) {
-        add_error("Expected '=' after property name");
-        return nullptr;
-    }
-    
-    std::string value;
-    if (match(TokenType::STRING) || match(TokenType::NUMBER) || match(TokenType::IDENTIFIER)) {
-        value = current_token().value;
-        advance();
-    } else if (match(TokenType::LBRACKET)) {
-        // Handle list values (simplified)
-        value = "[";
+    ASTNode* list = nullptr;
+    std::string_view value;
+    const Token& token = current_token();
+    if (token.type == TokenType::STRING || token.type == TokenType::NUMBER || token.type == TokenType::IDENTIFIER) {
+        value = token_text(token);
         advance();
-        while (!match(TokenType::RBRACKET) && !match(TokenType::END_OF_FILE)) {
-            value += current_token().value;
-            advance();
-            if (match(TokenType::COMMA)) {
-                value += ",";
-                advance();
-            }
-        }
-        if (consume(TokenType::RBRACKET)) {
-            value += "]";
-        }
+    } else if (token.type == TokenType::LBRACKET) {
+        // The value keeps the list's source text; the elements become children
+        const char* begin = token.value.data();
+        list = parse_list();
+        value = std::string_view(begin, previous_.value.data() + previous_.value.size() - begin);
     } else {
         add_error("Expected property value");
+        synchronize();
         return nullptr;
     }
     
     consume(TokenType::SEMICOLON); // Optional semicolon
     
-    return std::make_unique<PropertyNode>(name, value);
+    auto* property = arena_.make<PropertyNode>(name.value, value);
+    property->line = name.line;
+    property->column = name.column;
+    if (list) {
+        property->set_children(arena_, std::span<ASTNode* const>(&list, 1));
+    }
+    return property;
 }
 
-std::unique_ptr<ASTNode> GlyphParser::parse_block() {
-    auto block = std::make_unique<ASTNode>(ASTNodeType::BLOCK);
-    
-    while (!match(TokenType::RBRACE) && !match(TokenType::END_OF_FILE)) {
-        auto statement = parse_statement();
-        if (statement) {
-            block->add_child(std::move(statement));
-        } else {
-            advance(); // Skip problematic tokens
-        }
-    }
-    
-    consume(TokenType::RBRACE);
+ASTNode* GlyphParser::parse_block() {
+    Token keyword = current_token();
+    auto* block = arena_.make<ASTNode>(ASTNodeType::BLOCK);
+    block->line = keyword.line;
+    block->column = keyword.column;
+    block->set_attribute(arena_, ASTSymbol::NAME, keyword.value);
+    advance();
+    parse_body(block);
     return block;
 }
 
-std::unique_ptr<ASTNode> GlyphParser::parse_expression() {
-    // Simplified expression parsing
-    auto expr = std::make_unique<ASTNode>(ASTNodeType::EXPRESSION);
+// mount "source" as "target";
+ASTNode* GlyphParser::parse_mount() {
+    Token keyword = current_token();
+    advance();
+    
+    auto* mount = arena_.make<ASTNode>(ASTNodeType::CALL);
+    mount->line = keyword.line;
+    mount->column = keyword.column;
+    mount->set_attribute(arena_, ASTSymbol::NAME, keyword.value);
     
-    if (match(TokenType::IDENTIFIER) || match(TokenType::STRING) || match(TokenType::NUMBER)) {
-        expr->set_attribute("value", current_token().value);
+    ASTNode* paths[2] = {nullptr, nullptr};
+    paths[0] = match(TokenType::STRING) ? parse_expression() : nullptr;
+    bool as = match(TokenType::IDENTIFIER) && current_token().value == "as";
+    if (as) {
         advance();
     }
-    
+    paths[1] = as && match(TokenType::STRING) ? parse_expression() : nullptr;
+    if (!paths[0] || !paths[1]) {
+        add_error("Expected mount \"source\" as \"target\"");
+        synchronize();
+        return nullptr;
+    }
+    consume(TokenType::SEMICOLON);
+    mount->set_children(arena_, paths);
+    return mount;
+}
+
+ASTNode* GlyphParser::parse_expression() {
+    const Token& token = current_token();
+    auto* expr = arena_.make<ASTNode>(token.type == TokenType::IDENTIFIER ? ASTNodeType::IDENTIFIER : ASTNodeType::LITERAL);
+    expr->line = token.line;
+    expr->column = token.column;
+    expr->set_attribute(arena_, ASTSymbol::VALUE, token_text(token));
+    advance();
     return expr;
 }
 
-std::unique_ptr<ASTNode> GlyphParser::parse_list() {
-    auto list = std::make_unique<ASTNode>(ASTNodeType::LIST);
-    
-    if (!consume(TokenType::LBRACKET)) {
-        return nullptr;
-    }
+ASTNode* GlyphParser::parse_list() {
+    auto* list = arena_.make<ASTNode>(ASTNodeType::LIST);
+    list->line = current_token().line;
+    list->column = current_token().column;
+    advance(); // '['
     
+    size_t scratch_start = scratch_.size();
     while (!match(TokenType::RBRACKET) && !match(TokenType::END_OF_FILE)) {
-        auto expr = parse_expression();
-        if (expr) {
-            list->add_child(std::move(expr));
+        if (match(TokenType::STRING) || match(TokenType::NUMBER) || match(TokenType::IDENTIFIER)) {
+            scratch_.push_back(parse_expression());
+        } else {
+            add_error("Expected list element");
+            break;
         }
-        
         if (!consume(TokenType::COMMA)) {
             break;
         }
     }
+    finish_children(list, scratch_start);
     
-    consume(TokenType::RBRACKET);
+    if (!consume(TokenType::RBRACKET)) {
+        add_error("Expected ']'");
+        synchronize();
+    }
     return list;
 }
 
 void GlyphParser::add_error(const std::string& message) {
-    Token token = current_token();
+    const Token& token = current_token();
     errors_.push_back("Line " + std::to_string(token.line) + ", Column " + std::to_string(token.column) + ": " + message);
 }
 
@@ -500,49 +729,95 @@ GlyphCodeGenerator::~GlyphCodeGenerator() {
 
 VMGlyph GlyphCodeGenerator::generate_vm_glyph(const ASTNode& ast) {
     errors_.clear();
-    VMGlyph glyph;
-    
-    // Set defaults
-    glyph.vm_type = "dis";
-    glyph.architecture = "portable";
-    glyph.render.width = 800;
-    glyph.render.height = 600;
-    glyph.render.background_color = 0x1e1e1e;
-    glyph.render.interactive = true;
-    glyph.render.ai_enabled = false;
+    VMGlyph glyph = default_vm_glyph();
     
     // Process AST nodes
-    for (const auto& child : ast.children) {
+    for (const ASTNode* child : ast.children()) {
         if (child->type == ASTNodeType::VM_DECL) {
-            const VMDeclNode* vm_decl = static_cast<const VMDeclNode*>(child.get());
-            glyph.vm_type = vm_decl->vm_type;
+            process_vm_declaration(glyph, *static_cast<const VMDeclNode*>(child));
         } else if (child->type == ASTNodeType::GLYPH_DECL) {
-            // Process glyph properties
-            for (const auto& grandchild : child->children) {
-                if (grandchild->type == ASTNodeType::BLOCK) {
-                    for (const auto& prop_child : grandchild->children) {
-                        if (prop_child->type == ASTNodeType::PROPERTY) {
-                            const PropertyNode* prop = static_cast<const PropertyNode*>(prop_child.get());
-                            
-                            if (prop->name == "width") {
-                                glyph.render.width = std::stoi(prop->value);
-                            } else if (prop->name == "height") {
-                                glyph.render.height = std::stoi(prop->value);
-                            } else if (prop->name == "architecture") {
-                                glyph.architecture = prop->value;
-                            } else if (prop->name == "interactive") {
-                                glyph.render.interactive = (prop->value == "true");
-                            }
-                        }
-                    }
-                }
-            }
+            process_glyph_declaration(glyph, *static_cast<const GlyphDeclNode*>(child));
         }
     }
     
     return glyph;
 }
 
+VMGlyph GlyphCodeGenerator::generate_vm_glyph(const VMDeclNode* vm, const GlyphDeclNode& glyph_decl) {
+    errors_.clear();
+    VMGlyph glyph = default_vm_glyph();
+    if (vm) {
+        process_vm_declaration(glyph, *vm);
+    }
+    process_glyph_declaration(glyph, glyph_decl);
+    return glyph;
+}
+
+void GlyphCodeGenerator::process_vm_declaration(VMGlyph& glyph, const VMDeclNode& node) {
+    glyph.vm_type = node.vm_type;
+    for (const ASTNode* statement : node.children()) {
+        if (statement->type == ASTNodeType::PROPERTY) {
+            apply_property(glyph, *static_cast<const PropertyNode*>(statement));
+        }
+    }
+}
+
+void GlyphCodeGenerator::process_glyph_declaration(VMGlyph& glyph, const GlyphDeclNode& node) {
+    for (const ASTNode* statement : node.children()) {
+        if (statement->type == ASTNodeType::PROPERTY) {
+            apply_property(glyph, *static_cast<const PropertyNode*>(statement));
+        } else if (statement->type == ASTNodeType::BLOCK) {
+            std::string_view block = statement->get_attribute(ASTSymbol::NAME);
+            if (block == "ai") {
+                glyph.render.ai_enabled = true;
+            }
+            for (const ASTNode* inner : statement->children()) {
+                if (inner->type == ASTNodeType::PROPERTY && block == "render") {
+                    apply_property(glyph, *static_cast<const PropertyNode*>(inner));
+                } else if (inner->type == ASTNodeType::CALL && inner->children().size() == 2) {
+                    glyph.namespace_mounts[std::string(inner->children()[1]->get_attribute(ASTSymbol::VALUE))] =
+                        std::string(inner->children()[0]->get_attribute(ASTSymbol::VALUE));
+                }
+            }
+        }
+    }
+}
+
+void GlyphCodeGenerator::apply_property(VMGlyph& glyph, const PropertyNode& property) {
+    auto parse_int = [&](auto& target, int base) {
+        std::string_view digits = property.value;
+        if (base == 16 && !digits.empty() && digits.front() == '#') {
+            digits.remove_prefix(1);
+        }
+        auto result = std::from_chars(digits.data(), digits.data() + digits.size(), target, base);
+        if (result.ec != std::errc() || result.ptr != digits.data() + digits.size()) {
+            add_error("Line " + std::to_string(property.line) + ": invalid value for " + std::string(property.name) +
+                      ": " + std::string(property.value));
+        }
+    };
+    
+    if (property.name == "width") {
+        parse_int(glyph.render.width, 10);
+    } else if (property.name == "height") {
+        parse_int(glyph.render.height, 10);
+    } else if (property.name == "background") {
+        parse_int(glyph.render.background_color, 16);
+    } else if (property.name == "font") {
+        glyph.render.font_family = property.value;
+    } else if (property.name == "architecture") {
+        glyph.architecture = property.value;
+    } else if (property.name == "interactive") {
+        glyph.render.interactive = (property.value == "true");
+    } else if (property.name == "ai_enabled") {
+        glyph.render.ai_enabled = (property.value == "true");
+    } else if (property.name == "capabilities" && !property.children().empty()) {
+        glyph.capabilities.clear();
+        for (const ASTNode* element : property.children()[0]->children()) {
+            glyph.capabilities.emplace_back(element->get_attribute(ASTSymbol::VALUE));
+        }
+    }
+}
+
 AIWorkbenchGlyph GlyphCodeGenerator::generate_ai_workbench(const ASTNode& ast) {
     AIWorkbenchGlyph workbench;
     
@@ -656,45 +931,34 @@ YaccGrammarSystem::~YaccGrammarSystem() {
 VMGlyph YaccGrammarSystem::parse_vm_glyph(const std::string& description) {
     clear_errors();
     
-    lexer_ = std::make_unique<GlyphLexer>(description);
-    auto tokens = lexer_->tokenize();
-    
-    parser_ = std::make_unique<GlyphParser>(tokens);
-    auto ast = parser_->parse();
+    GlyphAST ast = GlyphAST::parse(description);
     
     generator_ = std::make_unique<GlyphCodeGenerator>();
-    VMGlyph glyph = generator_->generate_vm_glyph(*ast);
+    VMGlyph glyph = generator_->generate_vm_glyph(ast.root());
     
-    collect_errors();
+    collect_errors(ast);
     return glyph;
 }
 
 AIWorkbenchGlyph YaccGrammarSystem::parse_ai_workbench(const std::string& description) {
     clear_errors();
     
-    lexer_ = std::make_unique<GlyphLexer>(description);
-    auto tokens = lexer_->tokenize();
-    
-    parser_ = std::make_unique<GlyphParser>(tokens);
-    auto ast = parser_->parse();
+    GlyphAST ast = GlyphAST::parse(description);
     
     generator_ = std::make_unique<GlyphCodeGenerator>();
-    AIWorkbenchGlyph workbench = generator_->generate_ai_workbench(*ast);
+    AIWorkbenchGlyph workbench = generator_->generate_ai_workbench(ast.root());
     
-    collect_errors();
+    collect_errors(ast);
     return workbench;
 }
 
 bool YaccGrammarSystem::validate_description(const std::string& description) {
     clear_errors();
     
-    lexer_ = std::make_unique<GlyphLexer>(description);
-    auto tokens = lexer_->tokenize();
+    GlyphAST ast = GlyphAST::parse(description);
+    generator_.reset();
     
-    parser_ = std::make_unique<GlyphParser>(tokens);
-    auto ast = parser_->parse();
-    
-    collect_errors();
+    collect_errors(ast);
     return errors_.empty();
 }
 
@@ -705,16 +969,12 @@ std::vector<std::string> YaccGrammarSystem::get_validation_errors() const {
 std::string YaccGrammarSystem::generate_cpp_code(const std::string& description) {
     clear_errors();
     
-    lexer_ = std::make_unique<GlyphLexer>(description);
-    auto tokens = lexer_->tokenize();
-    
-    parser_ = std::make_unique<GlyphParser>(tokens);
-    auto ast = parser_->parse();
+    GlyphAST ast = GlyphAST::parse(description);
     
     generator_ = std::make_unique<GlyphCodeGenerator>();
-    std::string code = generator_->generate_cpp_code(*ast);
+    std::string code = generator_->generate_cpp_code(ast.root());
     
-    collect_errors();
+    collect_errors(ast);
     return code;
 }
 
@@ -791,16 +1051,9 @@ void YaccGrammarSystem::clear_errors() {
     errors_.clear();
 }
 
-void YaccGrammarSystem::collect_errors() {
-    if (lexer_ && lexer_->has_errors()) {
-        auto lexer_errors = lexer_->get_errors();
-        errors_.insert(errors_.end(), lexer_errors.begin(), lexer_errors.end());
-    }
-    
-    if (parser_ && parser_->has_errors()) {
-        auto parser_errors = parser_->get_errors();
-        errors_.insert(errors_.end(), parser_errors.begin(), parser_errors.end());
-    }
+void YaccGrammarSystem::collect_errors(const GlyphAST& ast) {
+    auto parse_errors = ast.get_errors();
+    errors_.insert(errors_.end(), parse_errors.begin(), parse_errors.end());
     
     if (generator_ && generator_->has_errors()) {
         auto generator_errors = generator_->get_errors();
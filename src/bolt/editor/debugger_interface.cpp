@@ -7,6 +7,21 @@
 
 namespace bolt {
 
+namespace {
+
+std::string format_value(const drawkern::DISValue& value) {
+    switch (value.type()) {
+        case drawkern::DISValue::INT: return std::to_string(value.int_value());
+        case drawkern::DISValue::FLOAT: return std::to_string(value.float_value());
+        case drawkern::DISValue::STRING: return "\"" + value.string_value() + "\"";
+        case drawkern::DISValue::LIST: return "list(" + std::to_string(value.list_value().size()) + ")";
+        case drawkern::DISValue::REF: return "ref";
+    }
+    return "";
+}
+
+} // namespace
+
 DebuggerInterface::DebuggerInterface() 
     : vm_(std::make_unique<drawkern::DISVM>())
     , state_(DebugState::STOPPED)
@@ -357,7 +372,9 @@ std::vector<std::string> DebuggerInterface::get_stack_contents() const {
 
 std::map<std::string, std::string> DebuggerInterface::get_global_variables() const {
     std::map<std::string, std::string> variables;
-    // TODO: Implement once VM provides access to globals inspection
+    for (const auto& [name, value] : vm_->get_globals()) {
+        variables[name] = format_value(value);
+    }
     return variables;
 }
 
@@ -513,8 +530,19 @@ std::pair<std::string, size_t> DebuggerInterface::find_line_for_pc(size_t pc) co
 }
 
 std::string DebuggerInterface::evaluate_watch_expression(const std::string& expression) {
+    // Variable names resolve to the current frame's locals, then globals
+    auto locals = vm_->get_locals();
+    auto local = locals.find(expression);
+    if (local != locals.end()) {
+        return format_value(local->second);
+    }
+    auto globals = vm_->get_globals();
+    auto global = globals.find(expression);
+    if (global != globals.end()) {
+        return format_value(global->second);
+    }
+    
     // TODO: Implement expression evaluation
-    // For now, return placeholder
     return "TODO: evaluate " + expression;
 }
 
@@ -448,6 +448,13 @@ void BoltGuiApp::RenderMainMenuBar() {
                 show_ai_completion_ = !show_ai_completion_;
             }
             if (ImGui::MenuItem("Clear Chat History")) {
+                {
+                    // Abandon the reply being streamed along with its message
+                    std::lock_guard<std::mutex> lock(chat_mutex_);
+                    reply_cancel_.cancel();
+                    ++reply_generation_;
+                    reply_streaming_ = false;
+                }
                 chat_history_.clear();
                 AddChatMessage("Assistant", "Chat history cleared. How can I help you?", false);
             }
@@ -545,7 +552,15 @@ void BoltGuiApp::RenderChatPanel() {
     ImGui::PopItemWidth();
     
     ImGui::SameLine();
-    bool send_clicked = ImGui::Button("Send");
+    bool streaming;
+    {
+        std::lock_guard<std::mutex> lock(chat_mutex_);
+        streaming = reply_streaming_;
+    }
+    if (streaming && ImGui::Button("Stop")) {
+        StopChatReply();
+    }
+    bool send_clicked = !streaming && ImGui::Button("Send");
     
     if (enter_pressed || send_clicked) {
         ProcessChatInput();
@@ -648,17 +663,47 @@ void BoltGuiApp::ProcessChatInput() {
     // Clear input buffer first
     chat_input_buffer_[0] = '\0';
     
+    // Start an empty reply that fills in as pieces arrive
+    bolt::ai::CancellationToken cancel;
+    size_t generation;
+    {
+        std::lock_guard<std::mutex> lock(chat_mutex_);
+        reply_cancel_.cancel();
+        reply_cancel_ = cancel;
+        generation = ++reply_generation_;
+        chat_history_.emplace_back("Assistant", "", false);
+        reply_index_ = chat_history_.size() - 1;
+        streamed_text_.clear();
+        finished_reply_.clear();
+        reply_streaming_ = true;
+        reply_finished_ = false;
+    }
+    
     // Generate AI response asynchronously to avoid blocking UI
-    std::thread([this, input]() {
-        std::string response = GenerateAiResponse(input);
+    std::thread([this, input, cancel, generation]() {
+        auto on_token = [this, generation](const std::string& piece) {
+            std::lock_guard<std::mutex> lock(chat_mutex_);
+            if (generation != reply_generation_) {
+                return false;
+            }
+            streamed_text_ += piece;
+            return true;
+        };
+        std::string response = GenerateAiResponse(input, on_token, cancel);
         
-        // Add response on main thread (note: this is a simplified approach)
-        // In production, you'd want to use a proper thread-safe message queue
         std::lock_guard<std::mutex> lock(chat_mutex_);
-        pending_messages_.push_back({"Assistant", response, false});
+        if (generation == reply_generation_) {
+            finished_reply_ = response;
+            reply_finished_ = true;
+        }
     }).detach();
 }
 
+void BoltGuiApp::StopChatReply() {
+    std::lock_guard<std::mutex> lock(chat_mutex_);
+    reply_cancel_.cancel();
+}
+
 void BoltGuiApp::AddChatMessage(const std::string& author, const std::string& message, bool is_user) {
     chat_history_.emplace_back(author, message, is_user);
     
@@ -675,7 +720,9 @@ void BoltGuiApp::AddConsoleLog(const std::string& message) {
     }
 }
 
-std::string BoltGuiApp::GenerateAiResponse(const std::string& input) {
+std::string BoltGuiApp::GenerateAiResponse(const std::string& input,
+                                           const bolt::ai::TokenCallback& on_token,
+                                           const bolt::ai::CancellationToken& cancel) {
     // Check if AI manager is available
     if (!ai_manager_ || !ai_ready_) {
         return GenerateFallbackResponse(input);
@@ -683,10 +730,12 @@ std::string BoltGuiApp::GenerateAiResponse(const std::string& input) {
     
     try {
         // Use real AI inference
-        auto response = ai_manager_->chat(input, "gui_session");
+        auto response = ai_manager_->chat_stream(input, "gui_session", on_token, cancel);
         
         if (response.success) {
             return response.response;
+        } else if (response.error == bolt::ai::CANCELLED_ERROR) {
+            return response.response + "\n⏹️ Stopped";
         } else {
             std::string error_msg = "❌ AI Error: " + response.error;
             std::cerr << error_msg << std::endl;
@@ -839,6 +888,7 @@ void BoltGuiApp::HandleKeyboardShortcuts() {
 }
 
 void BoltGuiApp::Shutdown() {
+    StopChatReply();
     if (window_) {
         ImGui_ImplOpenGL3_Shutdown();
         ImGui_ImplGlfw_Shutdown();
@@ -856,6 +906,20 @@ void BoltGuiApp::ProcessPendingMessages() {
         chat_history_.push_back(msg);
     }
     pending_messages_.clear();
+    
+    if (!reply_streaming_) {
+        return;
+    }
+    auto& reply = chat_history_[reply_index_];
+    if (reply_finished_) {
+        // The final text also covers replies that never streamed (errors, fallbacks)
+        reply.content = finished_reply_;
+        reply_streaming_ = false;
+        AddConsoleLog("[Assistant] " + reply.content);
+    } else {
+        reply.content += streamed_text_;
+    }
+    streamed_text_.clear();
 }
 
 void BoltGuiApp::RenderAiSettingsWindow() {
@@ -0,0 +1,229 @@
+#include "bolt/network/latency_histogram.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace bolt {
+
+namespace {
+
+constexpr uint32_t MIN_SUB_BUCKET_BITS = 2;
+constexpr uint32_t MAX_SUB_BUCKET_BITS = 16;
+
+uint32_t clampSubBucketBits(uint32_t bits) {
+    return std::clamp(bits, MIN_SUB_BUCKET_BITS, MAX_SUB_BUCKET_BITS);
+}
+
+// Each thread gets a stable slot the first time it records into any histogram
+size_t currentThreadSlot() {
+    static std::atomic<size_t> nextSlot{0};
+    thread_local size_t slot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+    return slot;
+}
+
+void atomicMin(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (value < current &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed));
+}
+
+void atomicMax(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (value > current &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed));
+}
+
+} // namespace
+
+// LatencyHistogram Implementation
+
+size_t LatencyHistogram::bucketIndexFor(uint64_t value, uint32_t subBucketBits) {
+    const uint64_t linearLimit = 1ULL << subBucketBits;
+    if (value < linearLimit) {
+        return static_cast<size_t>(value);
+    }
+
+    const uint32_t msb = 63 - static_cast<uint32_t>(__builtin_clzll(value));
+    const uint32_t exponent = msb - subBucketBits + 1;
+    const uint64_t halfCount = 1ULL << (subBucketBits - 1);
+    const uint64_t mantissa = value >> exponent;
+
+    return static_cast<size_t>(linearLimit + (exponent - 1) * halfCount + (mantissa - halfCount));
+}
+
+uint64_t LatencyHistogram::highestEquivalentValue(size_t index, uint32_t subBucketBits) {
+    const uint64_t linearLimit = 1ULL << subBucketBits;
+    if (index < linearLimit) {
+        return index;
+    }
+
+    const uint64_t halfCount = 1ULL << (subBucketBits - 1);
+    const uint64_t offset = index - linearLimit;
+    const uint64_t exponent = offset / halfCount + 1;
+    const uint64_t mantissa = offset % halfCount + halfCount;
+
+    return (mantissa << exponent) + ((1ULL << exponent) - 1);
+}
+
+LatencyHistogram::Shard::Shard(size_t buckets)
+    : counts(new std::atomic<uint64_t>[buckets]) {
+    for (size_t i = 0; i < buckets; ++i) {
+        counts[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+LatencyHistogram::LatencyHistogram(uint32_t subBucketBits, uint64_t highestTrackableValue)
+    : subBucketBits_(clampSubBucketBits(subBucketBits)),
+      highestTrackableValue_(std::max(highestTrackableValue, uint64_t{1} << clampSubBucketBits(subBucketBits))),
+      bucketCount_(bucketIndexFor(highestTrackableValue_, subBucketBits_) + 1) {
+    for (auto& shard : shards_) {
+        shard.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+LatencyHistogram::~LatencyHistogram() {
+    for (auto& shard : shards_) {
+        delete shard.load(std::memory_order_acquire);
+    }
+}
+
+LatencyHistogram::Shard& LatencyHistogram::shardForCurrentThread() {
+    auto& slot = shards_[currentThreadSlot() % SHARD_COUNT];
+
+    Shard* shard = slot.load(std::memory_order_acquire);
+    if (shard) {
+        return *shard;
+    }
+
+    // Lazily allocate; if another thread won the race, use its shard
+    auto* created = new Shard(bucketCount_);
+    Shard* expected = nullptr;
+    if (slot.compare_exchange_strong(expected, created, std::memory_order_acq_rel)) {
+        return *created;
+    }
+    delete created;
+    return *expected;
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    recordMultiple(value, 1);
+}
+
+void LatencyHistogram::recordMultiple(uint64_t value, uint64_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    const uint64_t clamped = std::min(value, highestTrackableValue_);
+    auto& shard = shardForCurrentThread();
+
+    shard.counts[bucketIndexFor(clamped, subBucketBits_)].fetch_add(count, std::memory_order_relaxed);
+    shard.totalCount.fetch_add(count, std::memory_order_relaxed);
+    shard.sum.fetch_add(value * count, std::memory_order_relaxed);
+    atomicMin(shard.min, value);
+    atomicMax(shard.max, value);
+}
+
+HistogramSnapshot LatencyHistogram::snapshot() const {
+    HistogramSnapshot result(subBucketBits_, highestTrackableValue_);
+
+    for (const auto& slot : shards_) {
+        const Shard* shard = slot.load(std::memory_order_acquire);
+        if (!shard) {
+            continue;
+        }
+
+        for (size_t i = 0; i < bucketCount_; ++i) {
+            result.counts_[i] += shard->counts[i].load(std::memory_order_relaxed);
+        }
+        result.totalCount_ += shard->totalCount.load(std::memory_order_relaxed);
+        result.sum_ += shard->sum.load(std::memory_order_relaxed);
+        result.min_ = std::min(result.min_, shard->min.load(std::memory_order_relaxed));
+        result.max_ = std::max(result.max_, shard->max.load(std::memory_order_relaxed));
+    }
+
+    return result;
+}
+
+void LatencyHistogram::reset() {
+    for (auto& slot : shards_) {
+        Shard* shard = slot.load(std::memory_order_acquire);
+        if (!shard) {
+            continue;
+        }
+
+        for (size_t i = 0; i < bucketCount_; ++i) {
+            shard->counts[i].store(0, std::memory_order_relaxed);
+        }
+        shard->totalCount.store(0, std::memory_order_relaxed);
+        shard->sum.store(0, std::memory_order_relaxed);
+        shard->min.store(UINT64_MAX, std::memory_order_relaxed);
+        shard->max.store(0, std::memory_order_relaxed);
+    }
+}
+
+// HistogramSnapshot Implementation
+
+HistogramSnapshot::HistogramSnapshot(uint32_t subBucketBits, uint64_t highestTrackableValue)
+    : subBucketBits_(subBucketBits),
+      highestTrackableValue_(highestTrackableValue),
+      counts_(LatencyHistogram::bucketIndexFor(highestTrackableValue, subBucketBits) + 1, 0) {
+}
+
+void HistogramSnapshot::merge(const HistogramSnapshot& other) {
+    if (other.totalCount_ == 0) {
+        return;
+    }
+
+    if (counts_.empty()) {
+        *this = other;
+        return;
+    }
+
+    if (other.subBucketBits_ == subBucketBits_ && other.counts_.size() == counts_.size()) {
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            counts_[i] += other.counts_[i];
+        }
+    } else {
+        // Different layouts: re-bucket by each source bucket's representative value
+        for (size_t i = 0; i < other.counts_.size(); ++i) {
+            if (other.counts_[i] == 0) {
+                continue;
+            }
+            uint64_t value = std::min(LatencyHistogram::highestEquivalentValue(i, other.subBucketBits_),
+                                      highestTrackableValue_);
+            counts_[LatencyHistogram::bucketIndexFor(value, subBucketBits_)] += other.counts_[i];
+        }
+    }
+
+    totalCount_ += other.totalCount_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+double HistogramSnapshot::getMean() const {
+    return totalCount_ > 0 ? static_cast<double>(sum_) / totalCount_ : 0.0;
+}
+
+uint64_t HistogramSnapshot::valueAtPercentile(double percentile) const {
+    if (totalCount_ == 0) {
+        return 0;
+    }
+
+    percentile = std::clamp(percentile, 0.0, 100.0);
+    uint64_t target = static_cast<uint64_t>(std::ceil(percentile / 100.0 * totalCount_));
+    target = std::max<uint64_t>(target, 1);
+
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        cumulative += counts_[i];
+        if (cumulative >= target) {
+            uint64_t value = LatencyHistogram::highestEquivalentValue(i, subBucketBits_);
+            return std::clamp(value, getMin(), max_);
+        }
+    }
+
+    return max_;
+}
+
+} // namespace bolt
@@ -1,7 +1,10 @@
 #include "bolt/network/network_metrics.hpp"
+#include "bolt/core/performance_profiler.hpp"
 #include <algorithm>
 #include <sstream>
 #include <iomanip>
+#include <fstream>
+#include <map>
 
 namespace bolt {
 
@@ -19,8 +22,8 @@ void BandwidthTracker::recordBytes(uint64_t bytes) {
     
     cleanup();
     
-    // Update peak bandwidth
-    double currentBandwidth = getCurrentBandwidth();
+    // Update peak bandwidth (mutex_ is already held)
+    double currentBandwidth = computeBandwidth();
     if (currentBandwidth > peakBandwidth_) {
         peakBandwidth_ = currentBandwidth;
     }
@@ -28,7 +31,10 @@ void BandwidthTracker::recordBytes(uint64_t bytes) {
 
 double BandwidthTracker::getCurrentBandwidth() const {
     std::lock_guard<std::mutex> lock(mutex_);
-    
+    return computeBandwidth();
+}
+
+double BandwidthTracker::computeBandwidth() const {
     if (dataPoints_.size() < 2) {
         return 0.0;
     }
@@ -80,6 +86,87 @@ void BandwidthTracker::cleanup() {
     );
 }
 
+namespace {
+
+// Quantiles exported for every summary; SLOs are written against the tail
+constexpr double EXPORTED_QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+std::string escapeLabelValue(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        switch (c) {
+            case '\\': escaped += "\\\\"; break;
+            case '"':  escaped += "\\\""; break;
+            case '\n': escaped += "\\n"; break;
+            default:   escaped += c; break;
+        }
+    }
+    return escaped;
+}
+
+std::string labelSet(const std::string& endpoint, const std::string& extra = "") {
+    std::string labels;
+    if (!endpoint.empty()) {
+        labels = "endpoint=\"" + escapeLabelValue(endpoint) + "\"";
+    }
+    if (!extra.empty()) {
+        labels += (labels.empty() ? "" : ",") + extra;
+    }
+    return labels.empty() ? "" : "{" + labels + "}";
+}
+
+struct ExportedCounter {
+    const char* name;
+    const char* help;
+    std::atomic<uint64_t> NetworkStats::*field;
+};
+
+const ExportedCounter EXPORTED_COUNTERS[] = {
+    {"bolt_network_connections_opened", "Connections opened", &NetworkStats::connectionsOpened},
+    {"bolt_network_connections_closed", "Connections closed", &NetworkStats::connectionsClosed},
+    {"bolt_network_connections_failed", "Connections that failed to open", &NetworkStats::connectionsFailed},
+    {"bolt_network_connections_timed_out", "Connections that timed out", &NetworkStats::connectionsTimedOut},
+    {"bolt_network_received_bytes", "Bytes received", &NetworkStats::bytesReceived},
+    {"bolt_network_sent_bytes", "Bytes sent", &NetworkStats::bytesSent},
+    {"bolt_network_messages_received", "Messages received", &NetworkStats::messagesReceived},
+    {"bolt_network_messages_sent", "Messages sent", &NetworkStats::messagesSent},
+    {"bolt_network_send_errors", "Send errors", &NetworkStats::sendErrors},
+    {"bolt_network_receive_errors", "Receive errors", &NetworkStats::receiveErrors},
+    {"bolt_network_protocol_errors", "Protocol errors", &NetworkStats::protocolErrors},
+    {"bolt_network_compression_errors", "Compression errors", &NetworkStats::compressionErrors},
+    {"bolt_network_frames_received", "WebSocket frames received", &NetworkStats::framesReceived},
+    {"bolt_network_frames_sent", "WebSocket frames sent", &NetworkStats::framesSent},
+    {"bolt_network_http_requests", "HTTP requests processed", &NetworkStats::requestsProcessed},
+};
+
+struct ExportedSummary {
+    const char* name;
+    const char* help;
+    const char* unit;
+    HistogramKind kind;
+};
+
+const ExportedSummary EXPORTED_SUMMARIES[] = {
+    {"bolt_network_latency_microseconds", "Per-message latency", "microseconds", HistogramKind::LATENCY},
+    {"bolt_network_frame_size_bytes", "Frame payload size", "bytes", HistogramKind::FRAME_SIZE},
+    {"bolt_network_queue_wait_microseconds", "Time spent queued", "microseconds", HistogramKind::QUEUE_WAIT},
+    {"bolt_network_message_size_bytes", "HTTP message size", "bytes", HistogramKind::MESSAGE_SIZE},
+};
+
+void writeSummary(std::ostringstream& out, const std::string& name,
+                  const std::string& endpoint, const HistogramSnapshot& snapshot) {
+    for (double quantile : EXPORTED_QUANTILES) {
+        std::ostringstream q;
+        q << "quantile=\"" << quantile << "\"";
+        out << name << labelSet(endpoint, q.str()) << " " << snapshot.valueAtPercentile(quantile * 100.0) << "\n";
+    }
+    out << name << "_count" << labelSet(endpoint) << " " << snapshot.getTotalCount() << "\n";
+    out << name << "_sum" << labelSet(endpoint) << " " << snapshot.getSum() << "\n";
+}
+
+} // namespace
+
 // NetworkMetrics Implementation
 
 void NetworkMetrics::registerEndpoint(const std::string& name) {
@@ -102,6 +189,11 @@ void NetworkMetrics::unregisterEndpoint(const std::string& name) {
     std::lock_guard<std::mutex> lock(metricsMutex_);
     
     endpointStats_.erase(name);
+    {
+        auto& shard = histogramShard(name);
+        std::lock_guard<std::mutex> shardLock(shard.mutex);
+        shard.histograms.erase(name);
+    }
     endpointBandwidthIn_.erase(name);
     endpointBandwidthOut_.erase(name);
 }
@@ -175,6 +267,8 @@ void NetworkMetrics::recordDataReceived(const std::string& endpoint, uint64_t by
 }
 
 void NetworkMetrics::recordLatency(const std::string& endpoint, uint64_t microseconds) {
+    recordHistogramValue(endpoint, HistogramKind::LATENCY, microseconds);
+    
     std::lock_guard<std::mutex> lock(metricsMutex_);
     
     globalStats_.totalLatency += microseconds;
@@ -256,6 +350,24 @@ void NetworkMetrics::recordHttpRequest(const std::string& endpoint, int statusCo
     }
 }
 
+void NetworkMetrics::recordFrameSize(const std::string& endpoint, uint64_t bytes) {
+    recordHistogramValue(endpoint, HistogramKind::FRAME_SIZE, bytes);
+}
+
+void NetworkMetrics::recordQueueWait(const std::string& endpoint, uint64_t microseconds) {
+    recordHistogramValue(endpoint, HistogramKind::QUEUE_WAIT, microseconds);
+}
+
+void NetworkMetrics::recordMessageSize(const std::string& endpoint, uint64_t bytes) {
+    recordHistogramValue(endpoint, HistogramKind::MESSAGE_SIZE, bytes);
+}
+
+void NetworkMetrics::recordHistogramValue(const std::string& endpoint, HistogramKind kind, uint64_t value) {
+    std::shared_ptr<NetworkHistograms> histograms = getOrCreateEndpointHistograms(endpoint);
+    globalHistograms_.get(kind).record(value);
+    histograms->get(kind).record(value);
+}
+
 NetworkStats NetworkMetrics::getGlobalStats() const {
     std::lock_guard<std::mutex> lock(metricsMutex_);
     return globalStats_.copy();
@@ -309,9 +421,29 @@ double NetworkMetrics::getEndpointBandwidthOut(const std::string& endpoint) cons
     return it != endpointBandwidthOut_.end() ? it->second->getCurrentBandwidth() : 0.0;
 }
 
+HistogramSnapshot NetworkMetrics::getGlobalHistogram(HistogramKind kind) const {
+    return globalHistograms_.get(kind).snapshot();
+}
+
+HistogramSnapshot NetworkMetrics::getEndpointHistogram(const std::string& endpoint, HistogramKind kind) const {
+    std::shared_ptr<NetworkHistograms> histograms;
+    {
+        const auto& shard = histogramShard(endpoint);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.histograms.find(endpoint);
+        if (it == shard.histograms.end()) {
+            return HistogramSnapshot();
+        }
+        histograms = it->second;
+    }
+    
+    return histograms->get(kind).snapshot();
+}
+
 void NetworkMetrics::resetGlobalStats() {
     std::lock_guard<std::mutex> lock(metricsMutex_);
     globalStats_.reset();
+    globalHistograms_.reset();
     
     if (globalBandwidthIn_) {
         globalBandwidthIn_->reset();
@@ -329,6 +461,15 @@ void NetworkMetrics::resetEndpointStats(const std::string& endpoint) {
         it->second->reset();
     }
     
+    {
+        auto& shard = histogramShard(endpoint);
+        std::lock_guard<std::mutex> shardLock(shard.mutex);
+        auto histIt = shard.histograms.find(endpoint);
+        if (histIt != shard.histograms.end()) {
+            histIt->second->reset();
+        }
+    }
+    
     auto inIt = endpointBandwidthIn_.find(endpoint);
     if (inIt != endpointBandwidthIn_.end()) {
         inIt->second->reset();
@@ -349,6 +490,14 @@ void NetworkMetrics::resetAllStats() {
         stats->reset();
     }
     
+    globalHistograms_.reset();
+    for (auto& shard : histogramShards_) {
+        std::lock_guard<std::mutex> shardLock(shard.mutex);
+        for (auto& [name, histograms] : shard.histograms) {
+            histograms->reset();
+        }
+    }
+    
     if (globalBandwidthIn_) {
         globalBandwidthIn_->reset();
     }
@@ -489,6 +638,90 @@ std::string NetworkMetrics::generateEndpointReport(const std::string& endpoint)
     return report.str();
 }
 
+std::string NetworkMetrics::generateOpenMetrics(bool includeProfiler) const {
+    // Copy what we need under the lock, then format without holding it
+    NetworkStats global;
+    std::vector<std::pair<std::string, std::shared_ptr<NetworkStats>>> endpoints;
+    std::map<std::string, std::shared_ptr<NetworkHistograms>> histograms;
+    {
+        std::lock_guard<std::mutex> lock(metricsMutex_);
+        global = globalStats_.copy();
+        endpoints.assign(endpointStats_.begin(), endpointStats_.end());
+    }
+    for (const auto& shard : histogramShards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        histograms.insert(shard.histograms.begin(), shard.histograms.end());
+    }
+    std::sort(endpoints.begin(), endpoints.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    
+    std::ostringstream out;
+    
+    for (const auto& counter : EXPORTED_COUNTERS) {
+        out << "# TYPE " << counter.name << " counter\n";
+        out << "# HELP " << counter.name << " " << counter.help << "\n";
+        out << counter.name << "_total " << (global.*counter.field).load() << "\n";
+        for (const auto& [name, stats] : endpoints) {
+            out << counter.name << "_total" << labelSet(name) << " " << ((*stats).*counter.field).load() << "\n";
+        }
+    }
+    
+    out << "# TYPE bolt_network_connections_active gauge\n";
+    out << "# HELP bolt_network_connections_active Currently open connections\n";
+    out << "bolt_network_connections_active " << global.connectionsActive.load() << "\n";
+    for (const auto& [name, stats] : endpoints) {
+        out << "bolt_network_connections_active" << labelSet(name) << " " << stats->connectionsActive.load() << "\n";
+    }
+    
+    for (const auto& summary : EXPORTED_SUMMARIES) {
+        out << "# TYPE " << summary.name << " summary\n";
+        out << "# UNIT " << summary.name << " " << summary.unit << "\n";
+        out << "# HELP " << summary.name << " " << summary.help << "\n";
+        writeSummary(out, summary.name, "", globalHistograms_.get(summary.kind).snapshot());
+        for (const auto& [name, endpointHistograms] : histograms) {
+            writeSummary(out, summary.name, name, endpointHistograms->get(summary.kind).snapshot());
+        }
+    }
+    
+    if (includeProfiler) {
+        auto& profiler = PerformanceProfiler::getInstance();
+        
+        out << "# TYPE bolt_profiler_metrics gauge\n";
+        out << "# HELP bolt_profiler_metrics Profiler metrics currently retained, by category\n";
+        std::vector<std::pair<std::string, double>> durations;
+        for (const auto& category : profiler.getCategories()) {
+            auto metrics = profiler.getMetricsByCategory(category);
+            double totalMs = 0.0;
+            for (const auto& metric : metrics) {
+                totalMs += metric->getDurationMs();
+            }
+            std::string labels = "{category=\"" + escapeLabelValue(category) + "\"}";
+            out << "bolt_profiler_metrics" << labels << " " << metrics.size() << "\n";
+            durations.emplace_back(labels, totalMs);
+        }
+        
+        out << "# TYPE bolt_profiler_duration_milliseconds gauge\n";
+        out << "# UNIT bolt_profiler_duration_milliseconds milliseconds\n";
+        out << "# HELP bolt_profiler_duration_milliseconds Total duration of retained profiler metrics\n";
+        for (const auto& [labels, totalMs] : durations) {
+            out << "bolt_profiler_duration_milliseconds" << labels << " " << totalMs << "\n";
+        }
+    }
+    
+    out << "# EOF\n";
+    return out.str();
+}
+
+bool NetworkMetrics::exportOpenMetrics(const std::string& filename, bool includeProfiler) const {
+    std::ofstream file(filename, std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    file << generateOpenMetrics(includeProfiler);
+    return file.good();
+}
+
 NetworkStats& NetworkMetrics::getOrCreateEndpointStats(const std::string& endpoint) {
     auto it = endpointStats_.find(endpoint);
     if (it == endpointStats_.end()) {
@@ -498,6 +731,24 @@ NetworkStats& NetworkMetrics::getOrCreateEndpointStats(const std::string& endpoi
     return *it->second;
 }
 
+NetworkMetrics::HistogramShard& NetworkMetrics::histogramShard(const std::string& endpoint) {
+    return histogramShards_[std::hash<std::string>{}(endpoint) % HISTOGRAM_SHARDS];
+}
+
+const NetworkMetrics::HistogramShard& NetworkMetrics::histogramShard(const std::string& endpoint) const {
+    return histogramShards_[std::hash<std::string>{}(endpoint) % HISTOGRAM_SHARDS];
+}
+
+std::shared_ptr<NetworkHistograms> NetworkMetrics::getOrCreateEndpointHistograms(const std::string& endpoint) {
+    auto& shard = histogramShard(endpoint);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto& histograms = shard.histograms[endpoint];
+    if (!histograms) {
+        histograms = std::make_shared<NetworkHistograms>();
+    }
+    return histograms;
+}
+
 BandwidthTracker& NetworkMetrics::getOrCreateBandwidthTracker(
     std::unordered_map<std::string, std::unique_ptr<BandwidthTracker>>& trackers,
     const std::string& endpoint) {
@@ -1,14 +1,19 @@
 
 #include "bolt/network/websocket_server.hpp"
+#include "bolt/network/network_metrics.hpp"
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #define close closesocket
+#define SHUT_RDWR SD_BOTH
 #else
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <unistd.h>
 #endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
 #include <iostream>
 #include <cstring>
 
@@ -21,10 +26,16 @@
 #endif
 
 #include <algorithm>
+#include <chrono>
 #include <sstream>
 
 namespace bolt {
 
+namespace {
+// NetworkMetrics endpoint for frame sizes and send queue waits
+const char* const METRICS_ENDPOINT = "websocket";
+}
+
 std::string WebSocketConnection::generateAcceptKey(const std::string& clientKey) {
 #ifdef BOLT_HAVE_OPENSSL
     std::string magic = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
@@ -110,7 +121,23 @@ std::vector<uint8_t> WebSocketConnection::createFrame(const std::string& payload
 
 void WebSocketConnection::send(const std::string& message, bool binary) {
     auto frame = createFrame(message, binary);
-    ::send(socket_, frame.data(), frame.size(), 0);
+    auto queued = std::chrono::steady_clock::now();
+    
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    // Frames to one connection queue on sendMutex_; the wait ends here
+    auto& metrics = NetworkMetrics::getInstance();
+    metrics.recordQueueWait(METRICS_ENDPOINT, static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - queued).count()));
+    metrics.recordFrameSize(METRICS_ENDPOINT, message.size());
+    size_t sent = 0;
+    while (sent < frame.size() && socket_ >= 0) {
+        // A peer that has gone away must not raise SIGPIPE; its reader notices the close
+        auto bytes = ::send(socket_, reinterpret_cast<const char*>(frame.data()) + sent, frame.size() - sent, MSG_NOSIGNAL);
+        if (bytes <= 0) {
+            break;
+        }
+        sent += static_cast<size_t>(bytes);
+    }
 }
 
 void WebSocketConnection::close() {
@@ -120,12 +147,22 @@ void WebSocketConnection::close() {
     }
 }
 
+void WebSocketConnection::shutdown() {
+    if (socket_ >= 0) {
+        ::shutdown(socket_, SHUT_RDWR);
+    }
+}
+
 void WebSocketServer::start(int port) {
     serverSocket_ = socket(AF_INET, SOCK_STREAM, 0);
     if (serverSocket_ < 0) {
         throw std::runtime_error("Failed to create socket");
     }
 
+    // Allow restarting on a port that still has connections in TIME_WAIT
+    int reuse = 1;
+    setsockopt(serverSocket_, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
     struct sockaddr_in serverAddr;
     serverAddr.sin_family = AF_INET;
     serverAddr.sin_addr.s_addr = INADDR_ANY;
@@ -135,7 +172,7 @@ void WebSocketServer::start(int port) {
         throw std::runtime_error("Failed to bind socket");
     }
 
-    if (listen(serverSocket_, 5) < 0) {
+    if (listen(serverSocket_, SOMAXCONN) < 0) {
         throw std::runtime_error("Failed to listen on socket");
     }
 
@@ -152,12 +189,14 @@ void WebSocketServer::start(int port) {
                     {
                         std::lock_guard<std::mutex> lock(connectionsMutex_);
                         connections_.insert(conn);
+                        activeHandlers_++;
                     }
                     if (connectCallback_) {
                         connectCallback_(conn);
                     }
-                    std::thread(&WebSocketServer::handleClient, this, clientSocket).detach();
+                    std::thread(&WebSocketServer::handleClient, this, conn).detach();
                 } else {
+                    conn->close();
                     delete conn;
                 }
             }
@@ -165,83 +204,107 @@ void WebSocketServer::start(int port) {
     });
 }
 
-std::vector<uint8_t> WebSocketServer::parseFrame(const std::vector<uint8_t>& buffer, bool& isBinary) {
-    if (buffer.size() < 2) return {};
-    
-    uint8_t firstByte = buffer[0];
-    uint8_t secondByte = buffer[1];
+bool WebSocketServer::parseFrame(const uint8_t* data, size_t length, size_t& frameLength,
+                                 uint8_t& opcode, bool& fin, std::vector<uint8_t>& payload) {
+    frameLength = 0;
+    if (length < 2) return false;
     
-    bool fin = (firstByte & 0x80) != 0;
-    (void)fin; // Suppress unused variable warning
-    uint8_t opcode = firstByte & 0x0F;
-    bool masked = (secondByte & 0x80) != 0;
-    uint64_t payloadLen = secondByte & 0x7F;
-    
-    isBinary = (opcode == 0x02);
+    fin = (data[0] & 0x80) != 0;
+    opcode = data[0] & 0x0F;
+    bool masked = (data[1] & 0x80) != 0;
+    uint64_t payloadLen = data[1] & 0x7F;
     
     size_t headerLen = 2;
     if (payloadLen == 126) {
         headerLen += 2;
-        payloadLen = (buffer[2] << 8) | buffer[3];
+        if (length < headerLen) return false;
+        payloadLen = (static_cast<uint64_t>(data[2]) << 8) | data[3];
     } else if (payloadLen == 127) {
         headerLen += 8;
+        if (length < headerLen) return false;
         payloadLen = 0;
         for (int i = 0; i < 8; ++i) {
-            payloadLen = (payloadLen << 8) | buffer[2 + i];
+            payloadLen = (payloadLen << 8) | data[2 + i];
         }
     }
+    if (payloadLen > MAX_FRAME_PAYLOAD) {
+        return true; // frameLength stays 0: the connection is dropped
+    }
     
+    const uint8_t* mask = data + headerLen;
     if (masked) {
-        uint8_t mask[4];
-        std::copy(buffer.begin() + headerLen, buffer.begin() + headerLen + 4, mask);
         headerLen += 4;
-        
-        std::vector<uint8_t> payload(payloadLen);
-        for (size_t i = 0; i < payloadLen; ++i) {
-            payload[i] = buffer[headerLen + i] ^ mask[i % 4];
-        }
-        return payload;
-    } else {
-        return std::vector<uint8_t>(buffer.begin() + headerLen, buffer.begin() + headerLen + payloadLen);
     }
-}
-
-void WebSocketServer::handleClient(int clientSocket) {
-    std::vector<uint8_t> buffer(1024);
-    WebSocketConnection* conn = nullptr;
+    if (length < headerLen + payloadLen) return false;
     
-    {
-        std::lock_guard<std::mutex> lock(connectionsMutex_);
-        for (auto c : connections_) {
-            if (c->getSocket() == clientSocket) {
-                conn = c;
-                break;
-            }
+    payload.assign(data + headerLen, data + headerLen + payloadLen);
+    if (masked) {
+        for (size_t i = 0; i < payload.size(); ++i) {
+            payload[i] ^= mask[i % 4];
         }
     }
+    frameLength = headerLen + static_cast<size_t>(payloadLen);
+    return true;
+}
 
-    while (running_ && conn) {
-        int bytesRead = recv(clientSocket, buffer.data(), buffer.size(), 0);
+// Reads until the peer goes away. TCP may split a frame over several reads
+// or deliver several frames at once, so bytes are buffered until complete
+// frames are available, and fragmented messages are reassembled.
+void WebSocketServer::handleClient(WebSocketConnection* conn) {
+    std::vector<uint8_t> buffer(16 * 1024);
+    std::vector<uint8_t> pending;
+    std::vector<uint8_t> message;
+    std::vector<uint8_t> payload;
+    uint8_t messageOpcode = 0;
+    bool open = true;
+
+    while (running_ && open) {
+        auto bytesRead = recv(conn->getSocket(), reinterpret_cast<char*>(buffer.data()), buffer.size(), 0);
         if (bytesRead <= 0) break;
+        pending.insert(pending.end(), buffer.begin(), buffer.begin() + bytesRead);
         
-        bool isBinary;
-        auto payload = parseFrame(std::vector<uint8_t>(buffer.begin(), buffer.begin() + bytesRead), isBinary);
-        
-        if (!payload.empty() && messageCallback_) {
-            std::string message(payload.begin(), payload.end());
-            messageCallback_(message, conn, isBinary);
+        size_t offset = 0;
+        size_t frameLength;
+        uint8_t opcode;
+        bool fin;
+        while (open && parseFrame(pending.data() + offset, pending.size() - offset, frameLength, opcode, fin, payload)) {
+            if (frameLength == 0 || opcode == 0x08) {
+                open = false; // Oversized frame or close frame
+                break;
+            }
+            offset += frameLength;
+            NetworkMetrics::getInstance().recordFrameSize(METRICS_ENDPOINT, payload.size());
+            
+            if (opcode == 0x01 || opcode == 0x02) {
+                message.swap(payload);
+                messageOpcode = opcode;
+            } else if (opcode == 0x00 && messageOpcode != 0) {
+                message.insert(message.end(), payload.begin(), payload.end());
+            } else {
+                continue; // Ping/pong and stray continuations
+            }
+            
+            if (fin) {
+                if (!message.empty() && messageCallback_) {
+                    messageCallback_(std::string(message.begin(), message.end()), conn, messageOpcode == 0x02);
+                }
+                message.clear();
+                messageOpcode = 0;
+            }
         }
+        pending.erase(pending.begin(), pending.begin() + offset);
     }
 
     if (disconnectCallback_) {
         disconnectCallback_(conn);
     }
 
-    {
-        std::lock_guard<std::mutex> lock(connectionsMutex_);
-        connections_.erase(conn);
-    }
+    std::lock_guard<std::mutex> lock(connectionsMutex_);
+    connections_.erase(conn);
+    conn->close();
     delete conn;
+    activeHandlers_--;
+    handlersDone_.notify_all();
 }
 
 void WebSocketServer::broadcast(const std::string& message, bool binary) {
@@ -254,6 +317,8 @@ void WebSocketServer::broadcast(const std::string& message, bool binary) {
 void WebSocketServer::stop() {
     running_ = false;
     if (serverSocket_ >= 0) {
+        // Closing alone does not wake a thread blocked in accept() on Linux
+        shutdown(serverSocket_, SHUT_RDWR);
         close(serverSocket_);
         serverSocket_ = -1;
     }
@@ -262,12 +327,12 @@ void WebSocketServer::stop() {
         serverThread_.join();
     }
 
-    std::lock_guard<std::mutex> lock(connectionsMutex_);
+    // Every connection is owned by its reader thread, which deletes it on exit
+    std::unique_lock<std::mutex> lock(connectionsMutex_);
     for (auto conn : connections_) {
-        conn->close();
-        delete conn;
+        conn->shutdown();
     }
-    connections_.clear();
+    handlersDone_.wait(lock, [this]() { return activeHandlers_ == 0; });
 }
 
 } // namespace bolt
@@ -0,0 +1,185 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/drawkern/ai_integration.hpp"
+#include "bolt/drawkern/dis_vm.hpp"
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace bolt::drawkern;
+
+namespace {
+
+AIModelConfig echo_config() {
+    AIModelConfig config;
+    config.model_type = "echo";
+    return config;
+}
+
+// Echoes prompts and records the size of every batch it runs
+class EchoModel : public AIModel {
+public:
+    explicit EchoModel(std::shared_ptr<std::vector<size_t>> batch_sizes)
+        : AIModel(echo_config()), batch_sizes_(std::move(batch_sizes)) {}
+
+    bool load() override { loaded_ = true; return true; }
+    void unload() override { loaded_ = false; }
+    bool is_loaded() const override { return loaded_; }
+
+    AIInferenceResponse generate(const AIInferenceRequest& request) override {
+        AIInferenceResponse response;
+        response.response = "echo: " + request.prompt;
+        response.success = true;
+        response.tokens_generated = 2;
+        response.vm_id = request.vm_id;
+        return response;
+    }
+
+    AIInferenceResponse chat(const std::string& message, const std::string& context) override {
+        AIInferenceRequest request;
+        request.prompt = message;
+        request.context = context;
+        return generate(request);
+    }
+
+    AIInferenceResponse complete_code(const std::string& code, const std::string&) override {
+        AIInferenceRequest request;
+        request.prompt = code;
+        return generate(request);
+    }
+
+    std::vector<AIInferenceResponse> generate_batch(const std::vector<AIInferenceRequest>& requests) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            batch_sizes_->push_back(requests.size());
+        }
+        return AIModel::generate_batch(requests);
+    }
+
+    std::string get_model_info() const override { return "echo"; }
+    std::vector<std::string> get_capabilities() const override { return {"chat"}; }
+
+private:
+    std::shared_ptr<std::vector<size_t>> batch_sizes_;
+    std::mutex mutex_;
+};
+
+AIInferenceRequest make_request(const std::string& prompt) {
+    AIInferenceRequest request;
+    request.prompt = prompt;
+    request.task_type = "chat";
+    return request;
+}
+
+DrawKernAIManager::ModelStats stats_for(const DrawKernAIManager& manager, const std::string& model_id) {
+    for (const auto& stats : manager.get_model_statistics()) {
+        if (stats.model_id == model_id) {
+            return stats;
+        }
+    }
+    return {};
+}
+
+} // namespace
+
+BOLT_TEST(AIBatching, CollectsRequestsIntoBatches) {
+    auto batch_sizes = std::make_shared<std::vector<size_t>>();
+    DrawKernAIManager manager;
+    BOLT_ASSERT_TRUE(manager.load_model("echo", std::make_unique<EchoModel>(batch_sizes)));
+
+    // A full batch runs at once without waiting out the window
+    manager.set_batching(8, std::chrono::seconds(5));
+    std::vector<std::future<AIInferenceResponse>> futures;
+    for (int i = 0; i < 8; ++i) {
+        futures.push_back(manager.submit("echo", make_request("p" + std::to_string(i))));
+    }
+    for (int i = 0; i < 8; ++i) {
+        BOLT_ASSERT_TRUE(futures[i].wait_for(std::chrono::seconds(2)) == std::future_status::ready);
+        AIInferenceResponse response = futures[i].get();
+        BOLT_ASSERT_TRUE(response.success);
+        BOLT_ASSERT_EQ("echo: p" + std::to_string(i), response.response);
+    }
+
+    // A partial batch runs once its oldest request has waited the window
+    manager.set_batching(8, std::chrono::milliseconds(20));
+    futures.clear();
+    for (int i = 0; i < 3; ++i) {
+        futures.push_back(manager.submit("echo", make_request("q")));
+    }
+    for (auto& future : futures) {
+        BOLT_ASSERT_TRUE(future.get().success);
+    }
+
+    BOLT_ASSERT_EQ(2u, batch_sizes->size());
+    BOLT_ASSERT_EQ(8u, (*batch_sizes)[0]);
+    BOLT_ASSERT_EQ(3u, (*batch_sizes)[1]);
+
+    auto stats = stats_for(manager, "echo");
+    BOLT_ASSERT_EQ(11u, stats.total_requests);
+    BOLT_ASSERT_EQ(2u, stats.batches);
+    BOLT_ASSERT_TRUE(stats.average_batch_size > 5.4f && stats.average_batch_size < 5.6f);
+    BOLT_ASSERT_TRUE(stats.p50_latency_ms > 0.0f);
+    BOLT_ASSERT_TRUE(stats.p99_latency_ms >= stats.p50_latency_ms);
+    BOLT_ASSERT_TRUE(stats.requests_per_second > 0.0f);
+    BOLT_ASSERT_TRUE(stats.tokens_per_second > stats.requests_per_second);
+}
+
+BOLT_TEST(AIBatching, FailsQueuedRequestsOnUnload) {
+    auto batch_sizes = std::make_shared<std::vector<size_t>>();
+    DrawKernAIManager manager;
+    manager.load_model("echo", std::make_unique<EchoModel>(batch_sizes));
+    manager.set_batching(8, std::chrono::seconds(10));
+
+    auto first = manager.submit("echo", make_request("a"));
+    auto second = manager.submit("echo", make_request("b"));
+    BOLT_ASSERT_TRUE(manager.unload_model("echo"));
+
+    AIInferenceResponse response = first.get();
+    BOLT_ASSERT_FALSE(response.success);
+    BOLT_ASSERT_TRUE(response.error.find("unloaded") != std::string::npos);
+    BOLT_ASSERT_FALSE(second.get().success);
+    BOLT_ASSERT_TRUE(batch_sizes->empty());
+
+    AIInferenceResponse missing = manager.submit("echo", make_request("c")).get();
+    BOLT_ASSERT_FALSE(missing.success);
+    BOLT_ASSERT_TRUE(missing.error.find("not found") != std::string::npos);
+}
+
+BOLT_TEST(AIBatching, ParkedVMsResumeWithResponses) {
+    auto batch_sizes = std::make_shared<std::vector<size_t>>();
+    DISVMManager vm_manager(2);
+    DrawKernAIManager ai_manager;
+    ai_manager.load_model("echo", std::make_unique<EchoModel>(batch_sizes));
+    ai_manager.set_batching(16, std::chrono::milliseconds(100));
+    Integration::setup_dis_vm_manager_ai_integration(vm_manager, ai_manager, "echo");
+
+    // Ask the model, then send its answer to the host
+    const size_t vm_count = 6;
+    std::vector<std::string> vm_ids;
+    for (size_t i = 0; i < vm_count; ++i) {
+        DISProgram program;
+        program.add_instruction(DISInstruction(DISOpcode::LOAD, DISValue(std::string())));
+        program.add_instruction(DISInstruction(DISOpcode::LOAD, DISValue("prompt " + std::to_string(i))));
+        program.add_instruction(DISInstruction(DISOpcode::AI_CHAT));
+        program.add_instruction(DISInstruction(DISOpcode::SEND));
+        program.add_instruction(DISInstruction(DISOpcode::HALT));
+        vm_ids.push_back(vm_manager.create_vm(program));
+    }
+    for (const auto& vm_id : vm_ids) {
+        BOLT_ASSERT_TRUE(vm_manager.start_vm(vm_id));
+    }
+
+    for (size_t i = 0; i < vm_count; ++i) {
+        BOLT_ASSERT_TRUE(vm_manager.wait_for_vm(vm_ids[i], std::chrono::seconds(5)));
+        auto messages = vm_manager.get_messages(vm_ids[i]);
+        BOLT_ASSERT_EQ(1u, messages.size());
+        BOLT_ASSERT_EQ("echo: prompt " + std::to_string(i), messages[0].string_value());
+    }
+
+    // The VMs parked on their requests instead of running them one by one
+    auto stats = stats_for(ai_manager, "echo");
+    BOLT_ASSERT_EQ(vm_count, stats.successful_requests);
+    BOLT_ASSERT_TRUE(batch_sizes->size() < vm_count);
+}
@@ -0,0 +1,231 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/ai/ai_stream.hpp"
+#include "bolt/ai/direct_gguf_inference.hpp"
+#ifdef BOLT_HAVE_CURL
+#include "bolt/ai/ai_http_client.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+#endif
+#include <string>
+#include <vector>
+
+using namespace bolt::ai;
+
+BOLT_TEST(AIStreaming, ParsesEventsSplitAcrossChunks) {
+    SSEParser parser;
+    std::vector<std::string> events;
+    auto collect = [&](const std::string& data) {
+        events.push_back(data);
+        return true;
+    };
+
+    BOLT_ASSERT_TRUE(parser.feed(": keep-alive\r\n\r\nda", collect));
+    BOLT_ASSERT_TRUE(parser.feed("ta: one\r\n\r\nevent: delta\ndata: two\nda", collect));
+    BOLT_ASSERT_TRUE(parser.feed("ta:three\n\ndata: [DONE]\n\n", collect));
+
+    BOLT_ASSERT_EQ(3u, events.size());
+    BOLT_ASSERT_EQ(std::string("one"), events[0]);
+    BOLT_ASSERT_EQ(std::string("two\nthree"), events[1]);
+    BOLT_ASSERT_EQ(std::string("[DONE]"), events[2]);
+}
+
+BOLT_TEST(AIStreaming, HandlerStopsTheParser) {
+    SSEParser parser;
+    size_t seen = 0;
+    bool keep_going = parser.feed("data: a\n\ndata: b\n\ndata: c\n\n", [&](const std::string&) {
+        return ++seen < 2;
+    });
+    BOLT_ASSERT_FALSE(keep_going);
+    BOLT_ASSERT_EQ(2u, seen);
+}
+
+BOLT_TEST(AIStreaming, DirectInferenceStreamsPieces) {
+    DirectGGUFInference inference;
+    std::string streamed;
+    size_t pieces = 0;
+    auto response = inference.generate_text_stream("explain this function", 64, 0.7f,
+        [&](const std::string& piece) {
+            streamed += piece;
+            ++pieces;
+            return true;
+        });
+    BOLT_ASSERT_TRUE(response.success);
+    BOLT_ASSERT_TRUE(pieces > 1);
+    BOLT_ASSERT_EQ(response.response, streamed);
+
+    // Returning false from the callback stops the reply after one piece
+    pieces = 0;
+    response = inference.generate_text_stream("explain this function", 64, 0.7f,
+        [&](const std::string&) { return ++pieces < 1; });
+    BOLT_ASSERT_FALSE(response.success);
+    BOLT_ASSERT_EQ(std::string(CANCELLED_ERROR), response.error);
+    BOLT_ASSERT_EQ(1u, pieces);
+
+    // So does a token cancelled before the request starts
+    CancellationToken cancel;
+    cancel.cancel();
+    pieces = 0;
+    response = inference.generate_text_stream("hello", 64, 0.7f,
+        [&](const std::string&) { return ++pieces > 0; }, cancel);
+    BOLT_ASSERT_EQ(std::string(CANCELLED_ERROR), response.error);
+    BOLT_ASSERT_EQ(0u, pieces);
+}
+
+#ifdef BOLT_HAVE_CURL
+
+namespace {
+
+// Answers one request with the given SSE events, then holds the connection
+// open for hold_ms or until the client hangs up
+class SSEServer {
+public:
+    SSEServer(std::vector<std::string> events, int hold_ms)
+        : events_(std::move(events)), hold_ms_(hold_ms) {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        listen(listen_fd_, 1);
+        socklen_t len = sizeof(addr);
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+        port_ = ntohs(addr.sin_port);
+        thread_ = std::thread([this] { serve(); });
+    }
+
+    ~SSEServer() {
+        thread_.join();
+        close(listen_fd_);
+    }
+
+    std::string url() const { return "http://127.0.0.1:" + std::to_string(port_); }
+    const std::string& request() const { return request_; }
+
+private:
+    std::vector<std::string> events_;
+    int hold_ms_;
+    int listen_fd_ = -1;
+    int port_ = 0;
+    std::string request_;
+    std::thread thread_;
+
+    void serve() {
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            return;
+        }
+        read_request(fd);
+
+        std::string head = "HTTP/1.1 200 OK\r\n"
+                           "Content-Type: text/event-stream\r\n"
+                           "Connection: close\r\n\r\n";
+        send(fd, head.data(), head.size(), MSG_NOSIGNAL);
+        for (const auto& event : events_) {
+            std::string frame = "data: " + event + "\n\n";
+            send(fd, frame.data(), frame.size(), MSG_NOSIGNAL);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        // Wait for the client to hang up
+        pollfd waiter{fd, POLLIN, 0};
+        char byte;
+        while (poll(&waiter, 1, hold_ms_) > 0 && recv(fd, &byte, 1, 0) > 0) {
+        }
+        close(fd);
+    }
+
+    void read_request(int fd) {
+        char buffer[4096];
+        size_t body_length = 0;
+        size_t header_end = std::string::npos;
+        while (header_end == std::string::npos || request_.size() < header_end + 4 + body_length) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                return;
+            }
+            request_.append(buffer, static_cast<size_t>(n));
+            if (header_end == std::string::npos) {
+                header_end = request_.find("\r\n\r\n");
+                size_t length_at = request_.find("Content-Length: ");
+                if (length_at != std::string::npos && length_at < header_end) {
+                    body_length = std::stoul(request_.substr(length_at + 16));
+                }
+                if (header_end != std::string::npos && request_.find("Expect: 100-continue") < header_end) {
+                    std::string go_on = "HTTP/1.1 100 Continue\r\n\r\n";
+                    send(fd, go_on.data(), go_on.size(), MSG_NOSIGNAL);
+                }
+            }
+        }
+    }
+};
+
+AIHttpConfig streaming_config(const std::string& url) {
+    AIHttpConfig config;
+    config.base_url = url;
+    config.api_type = APIType::OPENAI;
+    config.use_streaming = true;
+    config.timeout_seconds = 10;
+    return config;
+}
+
+std::string delta(const std::string& text) {
+    return "{\"choices\":[{\"delta\":{\"content\":\"" + text + "\"}}]}";
+}
+
+} // namespace
+
+BOLT_TEST(AIStreaming, HttpClientStreamsServerSentEvents) {
+    SSEServer server({delta("Hel"), delta("lo"), ": comment", delta(" there"), "[DONE]"}, 0);
+    AIHttpClient client(streaming_config(server.url()));
+
+    std::vector<std::string> pieces;
+    auto response = client.chat_stream("hi", "s", [&](const std::string& piece) {
+        pieces.push_back(piece);
+        return true;
+    });
+    BOLT_ASSERT_TRUE(response.success);
+    BOLT_ASSERT_EQ(std::string("Hello there"), response.response);
+    BOLT_ASSERT_EQ(3u, pieces.size());
+    BOLT_ASSERT_EQ(std::string("lo"), pieces[1]);
+    BOLT_ASSERT_TRUE(server.request().find("\"stream\" : true") != std::string::npos);
+}
+
+BOLT_TEST(AIStreaming, HttpClientStopsWhenCancelled) {
+    // The callback declines the second piece
+    {
+        SSEServer server({delta("a"), delta("b"), delta("c")}, 5000);
+        AIHttpClient client(streaming_config(server.url()));
+        size_t pieces = 0;
+        auto start = std::chrono::steady_clock::now();
+        auto response = client.chat_stream("hi", "s", [&](const std::string&) { return ++pieces < 2; });
+        BOLT_ASSERT_FALSE(response.success);
+        BOLT_ASSERT_EQ(std::string(CANCELLED_ERROR), response.error);
+        BOLT_ASSERT_EQ(2u, pieces);
+        BOLT_ASSERT_TRUE(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+    }
+
+    // Another thread cancels while the server is silent
+    {
+        SSEServer server({delta("partial")}, 5000);
+        AIHttpClient client(streaming_config(server.url()));
+        CancellationToken cancel;
+        std::thread canceller([cancel] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            cancel.cancel();
+        });
+        auto start = std::chrono::steady_clock::now();
+        auto response = client.chat_stream("hi", "s", [](const std::string&) { return true; }, cancel);
+        canceller.join();
+        BOLT_ASSERT_EQ(std::string(CANCELLED_ERROR), response.error);
+        BOLT_ASSERT_EQ(std::string("partial"), response.response);
+        BOLT_ASSERT_TRUE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(2500));
+    }
+}
+
+#endif // BOLT_HAVE_CURL
@@ -0,0 +1,347 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/collaboration/collaboration_protocol.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace bolt::collaboration;
+using namespace std::chrono_literals;
+
+namespace {
+
+// Blocking WebSocket client speaking the binary protocol; BATCH messages are
+// unpacked so callers see messages in the order the server sent them
+class TestClient {
+public:
+    ~TestClient() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    bool connect(int port) {
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd_ < 0) {
+            return false;
+        }
+        timeval timeout{0, 200 * 1000};
+        setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        int noDelay = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::connect(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            return false;
+        }
+
+        std::string request = "GET / HTTP/1.1\r\nHost: 127.0.0.1:" + std::to_string(port) +
+                              "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                              "Sec-WebSocket-Version: 13\r\n\r\n";
+        if (!write(request)) {
+            return false;
+        }
+        auto deadline = std::chrono::steady_clock::now() + 5s;
+        size_t headerEnd;
+        while ((headerEnd = buffer_.find("\r\n\r\n")) == std::string::npos) {
+            if (std::chrono::steady_clock::now() > deadline || !fill()) {
+                return false;
+            }
+        }
+        bool upgraded = buffer_.compare(0, 12, "HTTP/1.1 101") == 0;
+        buffer_.erase(0, headerEnd + 4);
+        return upgraded;
+    }
+
+    bool send(const ProtocolMessage& msg, bool binary) {
+        std::string payload = binary ? msg.serializeBinary() : msg.serialize();
+        std::string frame(1, static_cast<char>(binary ? 0x82 : 0x81));
+        if (payload.size() <= 125) {
+            frame.push_back(static_cast<char>(0x80 | payload.size()));
+        } else {
+            frame.push_back(static_cast<char>(0x80 | 126));
+            frame.push_back(static_cast<char>(payload.size() >> 8));
+            frame.push_back(static_cast<char>(payload.size() & 0xFF));
+        }
+        const char mask[4] = {0x12, 0x34, 0x56, 0x78};
+        frame.append(mask, sizeof(mask));
+        for (size_t i = 0; i < payload.size(); ++i) {
+            frame.push_back(static_cast<char>(payload[i] ^ mask[i % 4]));
+        }
+        return write(frame);
+    }
+
+    // Next message, or false once nothing arrives for the receive timeout
+    bool receive(ProtocolMessage& msg) {
+        while (pending_.empty()) {
+            if (!readFrame()) {
+                return false;
+            }
+        }
+        msg = std::move(pending_.front());
+        pending_.pop_front();
+        return true;
+    }
+
+private:
+    bool write(const std::string& bytes) {
+        size_t offset = 0;
+        while (offset < bytes.size()) {
+            auto sent = ::send(fd_, bytes.data() + offset, bytes.size() - offset, MSG_NOSIGNAL);
+            if (sent <= 0) {
+                return false;
+            }
+            offset += static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    bool fill() {
+        char chunk[16 * 1024];
+        auto received = recv(fd_, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            return false;
+        }
+        buffer_.append(chunk, static_cast<size_t>(received));
+        return true;
+    }
+
+    // Server frames are unmasked and never fragmented
+    bool readFrame() {
+        for (;;) {
+            const auto* data = reinterpret_cast<const uint8_t*>(buffer_.data());
+            size_t header = 2;
+            uint64_t length = buffer_.size() >= 2 ? (data[1] & 0x7F) : 0;
+            if (buffer_.size() >= 2 && (length == 126 || length == 127)) {
+                header += length == 126 ? 2 : 8;
+                length = 0;
+                for (size_t i = 2; i < header && i < buffer_.size(); ++i) {
+                    length = (length << 8) | data[i];
+                }
+            }
+            if (buffer_.size() >= header && buffer_.size() >= header + length) {
+                uint8_t opcode = data[0] & 0x0F;
+                std::string payload = buffer_.substr(header, static_cast<size_t>(length));
+                buffer_.erase(0, header + static_cast<size_t>(length));
+                if (opcode == 0x01) {
+                    pending_.push_back(ProtocolMessage::deserialize(payload));
+                } else if (opcode == 0x02) {
+                    unpack(payload);
+                }
+                return opcode != 0x08;
+            }
+            if (!fill()) {
+                return false;
+            }
+        }
+    }
+
+    void unpack(const std::string& bytes) {
+        ProtocolMessage msg;
+        if (!ProtocolMessage::deserializeBinary(bytes, msg)) {
+            return;
+        }
+        if (msg.type != MessageType::BATCH) {
+            pending_.push_back(std::move(msg));
+            return;
+        }
+        BinaryReader reader(msg.data);
+        uint64_t count;
+        std::string message;
+        if (!reader.readVarUInt(count)) {
+            return;
+        }
+        for (uint64_t i = 0; i < count && reader.readString(message); ++i) {
+            unpack(message);
+        }
+    }
+
+    int fd_ = -1;
+    std::string buffer_;
+    std::deque<ProtocolMessage> pending_;
+};
+
+// A joining replica: loads the state stream, then follows the broadcast
+// edits, which must continue exactly where the state left off
+struct Replica {
+    TestClient client;
+    TextRope text;
+    std::string snapshot;
+    uint64_t revision = 0;
+    uint64_t tailExpected = 0;
+    bool loaded = false;
+    std::string error;
+
+    void follow(const std::atomic<uint64_t>& finalRevision) {
+        auto deadline = std::chrono::steady_clock::now() + 20s;
+        while (error.empty() && std::chrono::steady_clock::now() < deadline &&
+               !(loaded && tailExpected == 0 && revision == finalRevision.load())) {
+            ProtocolMessage msg;
+            if (client.receive(msg)) {
+                handle(msg);
+            }
+        }
+        if (error.empty() && revision != finalRevision.load()) {
+            error = "stopped at revision " + std::to_string(revision);
+        }
+    }
+
+    void handle(const ProtocolMessage& msg) {
+        if (msg.type == MessageType::DOCUMENT_STATE) {
+            BinaryReader reader(msg.data);
+            uint64_t stateRevision, length, chunks;
+            if (loaded || !reader.readVarUInt(stateRevision) || !reader.readVarUInt(revision) ||
+                !reader.readVarUInt(length) || !reader.readVarUInt(chunks) || !reader.readVarUInt(tailExpected)) {
+                error = "unexpected document state";
+            }
+            loaded = true;
+        } else if (msg.type == MessageType::SNAPSHOT_CHUNK) {
+            BinaryReader reader(msg.data);
+            uint64_t index;
+            std::string chunk;
+            reader.readVarUInt(index);
+            reader.readRaw(chunk, reader.remaining());
+            snapshot += chunk;
+            text = TextRope(snapshot);
+        } else if (msg.type == MessageType::DOCUMENT_OPERATION) {
+            auto operation = DocumentOperation::decodeBinary(msg.data);
+            if (!loaded) {
+                error = "edit before the document state";
+            } else if (!operation || operation->getBaseRevision() != revision) {
+                error = "edit " + std::to_string(operation ? operation->getBaseRevision() : 0) +
+                        " at revision " + std::to_string(revision);
+            } else if (!operation->apply(text)) {
+                error = "edit did not apply";
+            } else {
+                revision++;
+                if (tailExpected > 0) {
+                    tailExpected--;
+                }
+            }
+        }
+    }
+};
+
+int testPort(int offset) {
+    return 30000 + static_cast<int>((getpid() + offset) % 10000);
+}
+
+} // namespace
+
+BOLT_TEST(CollaborationProtocol, JoinWhileEditsAreBroadcast) {
+    auto& protocol = CollaborationProtocol::getInstance();
+    auto& session = CollaborativeSession::getInstance();
+
+    // Once batched per tick and once sent as each edit commits
+    for (auto tick : {OperationBatcher::DEFAULT_WINDOW, std::chrono::milliseconds(0)}) {
+        std::string documentId = "join_race_" + std::to_string(tick.count());
+        int port = testPort(static_cast<int>(tick.count()));
+        protocol.setTickInterval(tick);
+        try {
+            protocol.initialize(port);
+        } catch (const std::exception& e) {
+            protocol.shutdown();
+            protocol.setTickInterval(OperationBatcher::DEFAULT_WINDOW);
+            std::cout << "  Loopback server unavailable (" << e.what() << "), skipped\n";
+            return;
+        }
+        BOLT_ASSERT_TRUE(session.createDocument(documentId, "seed"));
+        BOLT_ASSERT_TRUE(session.joinDocument("writer", "Writer", documentId));
+
+        // Edits at the start of the text, so a dropped or repeated one changes it
+        std::atomic<bool> joining{true};
+        std::atomic<uint64_t> finalRevision{UINT64_MAX};
+        std::thread writer([&]() {
+            for (int i = 0; joining.load() || i < 200; ++i) {
+                DocumentOperation op(OperationType::INSERT, "writer", Position(0, 0),
+                                     std::string(1, static_cast<char>('a' + i % 26)));
+                session.applyOperation(op, documentId);
+                std::this_thread::yield();
+            }
+        });
+
+        std::vector<std::unique_ptr<Replica>> replicas;
+        std::vector<std::thread> readers;
+        for (int i = 0; i < 16; ++i) {
+            auto replica = std::make_unique<Replica>();
+            ProtocolMessage join;
+            join.type = MessageType::JOIN_DOCUMENT;
+            join.documentId = documentId;
+            join.userId = "joiner" + std::to_string(i);
+            if (replica->client.connect(port) && replica->client.send(join, true)) {
+                readers.emplace_back(&Replica::follow, replica.get(), std::cref(finalRevision));
+            } else {
+                replica->error = "could not join";
+            }
+            replicas.push_back(std::move(replica));
+            std::this_thread::sleep_for(2ms);
+        }
+        joining = false;
+        writer.join();
+        finalRevision = session.getDocumentRevision(documentId);
+        for (auto& reader : readers) {
+            reader.join();
+        }
+
+        std::string content = session.getDocumentContent(documentId);
+        for (const auto& replica : replicas) {
+            BOLT_ASSERT_EQ(std::string(), replica->error);
+            BOLT_ASSERT_EQ(content, replica->text.toString());
+        }
+        protocol.shutdown();
+        session.removeDocument(documentId);
+    }
+    protocol.setTickInterval(OperationBatcher::DEFAULT_WINDOW);
+}
+
+BOLT_TEST(CollaborationProtocol, CrdtDocumentsRequireBinaryClients) {
+    auto& protocol = CollaborationProtocol::getInstance();
+    auto& session = CollaborativeSession::getInstance();
+    int port = testPort(7);
+    try {
+        protocol.initialize(port);
+    } catch (const std::exception& e) {
+        protocol.shutdown();
+        std::cout << "  Loopback server unavailable (" << e.what() << "), skipped\n";
+        return;
+    }
+    const std::string documentId = "crdt_formats";
+    BOLT_ASSERT_TRUE(session.createDocument(documentId, "shared", DocumentBackend::SEQUENCE_CRDT));
+
+    // A JSON client could not follow the CRDT_UPDATE traffic, so it is turned away
+    TestClient json;
+    ProtocolMessage join;
+    join.type = MessageType::JOIN_DOCUMENT;
+    join.documentId = documentId;
+    join.userId = "json_user";
+    ProtocolMessage reply;
+    bool jsonJoined = json.connect(port) && json.send(join, false) && json.receive(reply);
+    BOLT_ASSERT_TRUE(jsonJoined);
+    BOLT_ASSERT_TRUE(reply.type == MessageType::ERROR_MESSAGE);
+
+    // Binary clients join as replicas
+    TestClient binary;
+    join.userId = "binary_user";
+    bool binaryJoined = binary.connect(port) && binary.send(join, true) && binary.receive(reply);
+    BOLT_ASSERT_TRUE(binaryJoined);
+    BOLT_ASSERT_TRUE(reply.type == MessageType::DOCUMENT_STATE);
+
+    auto users = session.getActiveUsers(documentId);
+    protocol.shutdown();
+    session.removeDocument(documentId);
+    BOLT_ASSERT_EQ(1u, users.size());
+    BOLT_ASSERT_EQ(std::string("binary_user"), users[0].userId);
+}
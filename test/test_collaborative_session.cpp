@@ -0,0 +1,265 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/collaboration/collaborative_session.hpp"
+#include "bolt/collaboration/document_operation.hpp"
+#include "bolt/collaboration/operational_transform.hpp"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace bolt::collaboration;
+
+namespace {
+
+// Creates a document with two joined editors, removed again on scope exit
+class TwoEditorDocument {
+public:
+    TwoEditorDocument(const std::string& id, const std::string& content)
+        : session(CollaborativeSession::getInstance()), documentId(id) {
+        session.createDocument(documentId, content);
+        session.joinDocument("userA", "User A", documentId);
+        session.joinDocument("userB", "User B", documentId);
+    }
+
+    ~TwoEditorDocument() {
+        session.removeDocument(documentId);
+    }
+
+    bool apply(const DocumentOperation& operation) {
+        return session.applyOperation(operation, documentId);
+    }
+
+    std::string content() const {
+        return session.getDocumentContent(documentId);
+    }
+
+    CollaborativeSession& session;
+    std::string documentId;
+};
+
+// Commits two edits made against revision 0 in both orders, and replays
+// them as each author's client does: its own edit first, then the other one
+// transformed past it. Every copy must match; returns the common text.
+std::string convergedContent(const std::string& initial, const DocumentOperation& a, const DocumentOperation& b) {
+    std::string expected;
+    for (bool aFirst : {true, false}) {
+        TwoEditorDocument doc("converge_test", initial);
+        BOLT_ASSERT_TRUE(doc.apply(aFirst ? a : b));
+        BOLT_ASSERT_TRUE(doc.apply(aFirst ? b : a));
+        if (aFirst) {
+            expected = doc.content();
+        }
+        BOLT_ASSERT_EQ(expected, doc.content());
+
+        for (const auto* own : {&a, &b}) {
+            const DocumentOperation& remote = own == &a ? b : a;
+            TextRope replica(initial);
+            BOLT_ASSERT_TRUE(own->apply(replica));
+            BOLT_ASSERT_TRUE(OperationalTransform::transform(remote, *own)->apply(replica));
+            BOLT_ASSERT_EQ(expected, replica.toString());
+        }
+    }
+    return expected;
+}
+
+} // namespace
+
+BOLT_TEST(CollaborationHistory, TransformsAgainstOpsAfterBaseRevision) {
+    TwoEditorDocument doc("revision_test", "abcdef");
+    BOLT_ASSERT_EQ(0u, doc.session.getDocumentRevision(doc.documentId));
+
+    // Both clients edit against revision 0; B's op must be shifted past A's
+    BOLT_ASSERT_TRUE(doc.apply(DocumentOperation(OperationType::INSERT, "userA", Position(0, 0), "XX", 0)));
+    BOLT_ASSERT_TRUE(doc.apply(DocumentOperation(OperationType::INSERT, "userB", Position(0, 3), "Y", 0)));
+    BOLT_ASSERT_EQ("XXabcYdef", doc.content());
+    BOLT_ASSERT_EQ(2u, doc.session.getDocumentRevision(doc.documentId));
+
+    // Cursor moves don't advance the revision
+    BOLT_ASSERT_TRUE(doc.apply(DocumentOperation(OperationType::CURSOR_MOVE, "userA", Position(0, 1), "", 2)));
+    BOLT_ASSERT_EQ(2u, doc.session.getDocumentRevision(doc.documentId));
+}
+
+BOLT_TEST(CollaborationHistory, ConcurrentInsertsAtOnePositionConverge) {
+    DocumentOperation a(OperationType::INSERT, "userA", Position(0, 1), "A", 0);
+    DocumentOperation b(OperationType::INSERT, "userB", Position(0, 1), "B", 0);
+    BOLT_ASSERT_EQ("aBAbc", convergedContent("abc", a, b));
+}
+
+BOLT_TEST(CollaborationHistory, ConcurrentMultiLineEditsConverge) {
+    const std::string text = "one\ntwo\nthree";
+
+    // An insert that splits a line moves a later insert on that line onto the new one
+    DocumentOperation splitLine(OperationType::INSERT, "userA", Position(1, 1), "X\nY", 0);
+    DocumentOperation sameLine(OperationType::INSERT, "userB", Position(1, 2), "Z", 0);
+    BOLT_ASSERT_EQ("one\ntX\nYwZo\nthree", convergedContent(text, splitLine, sameLine));
+
+    // A delete joining two lines moves an insert on the second line onto the first
+    DocumentOperation joinLines(OperationType::DELETE, "userA", Position(1, 2), "o\nthr", 0);
+    DocumentOperation laterLine(OperationType::INSERT, "userB", Position(2, 4), "Q", 0);
+    BOLT_ASSERT_EQ("one\ntweQe", convergedContent(text, joinLines, laterLine));
+
+    // Overlapping deletes across lines remove the union once
+    DocumentOperation front(OperationType::DELETE, "userA", Position(0, 1), "ne\ntwo\nth", 0);
+    DocumentOperation back(OperationType::DELETE, "userB", Position(1, 2), "o\nthree", 0);
+    BOLT_ASSERT_EQ("o", convergedContent(text, front, back));
+    DocumentOperation sameText(OperationType::DELETE, "userA", Position(1, 2), "o\nthree", 0);
+    BOLT_ASSERT_EQ("one\ntw", convergedContent(text, sameText, back));
+
+    // Text inserted inside a concurrently deleted range goes with it
+    DocumentOperation inside(OperationType::INSERT, "userA", Position(1, 2), "1\n2", 0);
+    DocumentOperation around(OperationType::DELETE, "userB", Position(1, 1), "wo\nth", 0);
+    BOLT_ASSERT_EQ("one\ntree", convergedContent(text, inside, around));
+}
+
+BOLT_TEST(CollaborationHistory, PipelinedEditsAreRejected) {
+    TwoEditorDocument doc("pipelined_test", "abcdef");
+
+    // C's concurrent edit lands before A's first; A's second edit was written
+    // on top of its first and would land after 'c' if transformed against C's
+    BOLT_ASSERT_TRUE(doc.apply(DocumentOperation(OperationType::INSERT, "userB", Position(0, 3), "Q", 0)));
+    BOLT_ASSERT_TRUE(doc.apply(DocumentOperation(OperationType::INSERT, "userA", Position(0, 0), "XX", 0)));
+    BOLT_ASSERT_FALSE(doc.apply(DocumentOperation(OperationType::INSERT, "userA", Position(0, 4), "Z", 0)));
+    BOLT_ASSERT_EQ("XXabcQdef", doc.content());
+    BOLT_ASSERT_EQ(2u, doc.session.getDocumentRevision(doc.documentId));
+
+    // Resent against the acknowledged revision it lands where it was meant to
+    BOLT_ASSERT_TRUE(doc.apply(DocumentOperation(OperationType::INSERT, "userA", Position(0, 4), "Z", 2)));
+    BOLT_ASSERT_EQ("XXabZcQdef", doc.content());
+
+    // A concurrent edit to the right of the author's previous one is rejected as well
+    BOLT_ASSERT_TRUE(doc.apply(DocumentOperation(OperationType::INSERT, "userA", Position(0, 0), "<", 3)));
+    BOLT_ASSERT_TRUE(doc.apply(DocumentOperation(OperationType::INSERT, "userB", Position(0, 8), "Y", 3)));
+    BOLT_ASSERT_FALSE(doc.apply(DocumentOperation(OperationType::INSERT, "userA", Position(0, 1), ">", 3)));
+    BOLT_ASSERT_EQ("<XXabZcQdYef", doc.content());
+}
+
+BOLT_TEST(CollaborationHistory, PrunesAcknowledgedAndCapsHistory) {
+    TwoEditorDocument doc("prune_test", "abcdef");
+    BOLT_ASSERT_TRUE(doc.apply(DocumentOperation(OperationType::INSERT, "userA", Position(0, 0), "XX", 0)));
+    BOLT_ASSERT_TRUE(doc.apply(DocumentOperation(OperationType::INSERT, "userB", Position(0, 3), "Y", 0)));
+
+    // Once both clients acknowledge revision 2 the history is released
+    BOLT_ASSERT_TRUE(doc.session.acknowledgeRevision("userA", doc.documentId, 2));
+    BOLT_ASSERT_TRUE(doc.session.acknowledgeRevision("userB", doc.documentId, 2));
+    BOLT_ASSERT_EQ(0u, doc.session.getStats().retainedOperations);
+
+    // An op based on a pruned revision must be rejected so the client resyncs
+    BOLT_ASSERT_FALSE(doc.apply(DocumentOperation(OperationType::INSERT, "userB", Position(0, 0), "Z", 1)));
+
+    // The hard cap bounds history even if a client never acknowledges
+    doc.session.setMaxHistorySize(4);
+    for (int i = 0; i < 10; ++i) {
+        BOLT_ASSERT_TRUE(doc.apply(DocumentOperation(OperationType::INSERT, "userA", Position(0, 0), "q")));
+    }
+    BOLT_ASSERT_TRUE(doc.session.getStats().retainedOperations <= 4);
+    doc.session.setMaxHistorySize(10000);
+}
+
+BOLT_TEST(CollaborationHistory, BaseRevisionSurvivesSerialization) {
+    DocumentOperation edit(OperationType::INSERT, "userB", Position(0, 3), "Y", 0);
+    auto roundTrip = DocumentOperation::deserialize(edit.serialize());
+    BOLT_ASSERT_EQ(0u, roundTrip->getBaseRevision());
+
+    DocumentOperation cursor(OperationType::CURSOR_MOVE, "userA", Position(0, 1), "", 2);
+    auto headOp = DocumentOperation::deserialize(cursor.serialize());
+    BOLT_ASSERT_EQ(2u, headOp->getBaseRevision());
+}
+
+BOLT_TEST(CollaborationStrands, ConcurrentSubmitAcrossDocuments) {
+    auto& session = CollaborativeSession::getInstance();
+    const int documentCount = 4;
+    const int opsPerDocument = 50;
+
+    for (int d = 0; d < documentCount; ++d) {
+        std::string docId = "strand_test_" + std::to_string(d);
+        session.createDocument(docId);
+        session.joinDocument("writer" + std::to_string(d), "Writer", docId);
+    }
+
+    // Callbacks run after the document lock is released, so they may query the session
+    std::mutex observedMutex;
+    std::map<std::string, std::vector<uint64_t>> observedRevisions;
+    std::atomic<int> reentrantFailures{0};
+    session.onOperation([&](const DocumentOperation& op, const std::string& documentId) {
+        if (session.getDocumentRevision(documentId) <= op.getBaseRevision()) {
+            reentrantFailures++;
+        }
+        std::lock_guard<std::mutex> lock(observedMutex);
+        observedRevisions[documentId].push_back(op.getBaseRevision());
+    });
+
+    std::atomic<int> completed{0};
+    std::atomic<int> failed{0};
+    std::vector<std::thread> producers;
+    for (int d = 0; d < documentCount; ++d) {
+        producers.emplace_back([&, d]() {
+            std::string docId = "strand_test_" + std::to_string(d);
+            std::string userId = "writer" + std::to_string(d);
+            for (int i = 0; i < opsPerDocument; ++i) {
+                DocumentOperation op(OperationType::INSERT, userId, Position(0, i), "x");
+                session.submitOperation(op, docId, [&](bool success) {
+                    if (!success) failed++;
+                    completed++;
+                });
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (completed < documentCount * opsPerDocument && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    session.onOperation(nullptr);
+    BOLT_ASSERT_EQ(documentCount * opsPerDocument, completed.load());
+    BOLT_ASSERT_EQ(0, failed.load());
+    BOLT_ASSERT_EQ(0, reentrantFailures.load());
+
+    for (int d = 0; d < documentCount; ++d) {
+        std::string docId = "strand_test_" + std::to_string(d);
+        BOLT_ASSERT_EQ(std::string(opsPerDocument, 'x'), session.getDocumentContent(docId));
+        BOLT_ASSERT_EQ(static_cast<uint64_t>(opsPerDocument), session.getDocumentRevision(docId));
+        BOLT_ASSERT_EQ(0u, session.getPendingOperationCount(docId));
+    }
+
+    // Every document saw its operations in submission order
+    {
+        std::lock_guard<std::mutex> lock(observedMutex);
+        for (const auto& [docId, revisions] : observedRevisions) {
+            BOLT_ASSERT_EQ(static_cast<size_t>(opsPerDocument), revisions.size());
+            for (size_t i = 0; i < revisions.size(); ++i) {
+                BOLT_ASSERT_EQ(i, revisions[i]);
+            }
+        }
+    }
+
+    for (int d = 0; d < documentCount; ++d) {
+        session.removeDocument("strand_test_" + std::to_string(d));
+    }
+}
+
+BOLT_TEST(CollaborationStrands, SubmitToMissingDocumentFails) {
+    auto& session = CollaborativeSession::getInstance();
+    DocumentOperation orphan(OperationType::INSERT, "nobody", Position(0, 0), "x");
+    bool orphanResult = true;
+    bool submitted = session.submitOperation(orphan, "strand_missing", [&](bool success) { orphanResult = success; });
+    BOLT_ASSERT_FALSE(submitted);
+    BOLT_ASSERT_FALSE(orphanResult);
+}
+
+BOLT_TEST(CollaborationStrands, PostDuringShutdownRunsInline) {
+    std::atomic<bool> requeued{false};
+    {
+        CollaborationWorkerPool pool(1);
+        pool.post([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            pool.post([&]() { requeued = true; });
+        });
+    }
+    BOLT_ASSERT_TRUE(requeued.load());
+}
@@ -2,7 +2,11 @@
 #include "bolt/editor/debugger_interface.hpp"
 #include "bolt/editor/debugger_ui.hpp"
 #include "bolt/drawkern/dis_vm.hpp"
+#include <filesystem>
+#include <fstream>
+#include <limits>
 #include <memory>
+#include <unistd.h>
 
 using namespace bolt;
 using namespace bolt::drawkern;
@@ -214,6 +218,340 @@ BOLT_TEST(Debugger, VM_CallStackInspection) {
     BOLT_ASSERT_EQ(0, stack.size());
 }
 
+// Counts down from n on the stack: the loop exits with 0 on top
+static DISProgram create_countdown_program(int64_t n) {
+    DISProgram program;
+    program.add_instruction(DISInstruction(DISOpcode::LOAD, DISValue(n)));
+    program.add_label("loop");
+    program.add_instruction(DISInstruction(DISOpcode::DUP));
+    program.add_instruction(DISInstruction(DISOpcode::JMPF, DISValue(int64_t(6))));
+    program.add_instruction(DISInstruction(DISOpcode::LOAD, DISValue(int64_t(1))));
+    program.add_instruction(DISInstruction(DISOpcode::SUB));
+    program.add_instruction(DISInstruction(DISOpcode::JMP, DISValue(int64_t(1))));
+    program.add_instruction(DISInstruction(DISOpcode::HALT));
+    return program;
+}
+
+BOLT_TEST(Debugger, VM_CodeLowering) {
+    DISProgram program = create_countdown_program(5);
+    program.add_instruction(DISInstruction(DISOpcode::LOAD, DISValue(int64_t(1))));
+    program.add_instruction(DISInstruction(DISOpcode::JMP, DISValue(int64_t(100))));
+    program.add_instruction(DISInstruction(static_cast<DISOpcode>(0x5F)));
+
+    DISCode code = DISCode::lower(program);
+    BOLT_ASSERT_EQ(program.instructions.size() + 1, code.instructions.size());
+    BOLT_ASSERT_EQ(static_cast<int>(DISCode::END), static_cast<int>(code.instructions.back().handler));
+
+    // Both LOAD 1 instructions share one constant
+    BOLT_ASSERT_EQ(2, code.constants.size());
+    BOLT_ASSERT_EQ(code.instructions[3].operand, code.instructions[7].operand);
+
+    // Jump targets are resolved; past the end means END
+    BOLT_ASSERT_EQ(6u, code.instructions[2].operand);
+    BOLT_ASSERT_EQ(program.instructions.size(), code.instructions[8].operand);
+    BOLT_ASSERT_EQ(static_cast<int>(DISCode::INVALID), static_cast<int>(code.instructions[9].handler));
+
+    // Frames are capped at MAX_LOCALS slots
+    DISProgram frames;
+    frames.add_instruction(DISInstruction(DISOpcode::ENTER, DISValue(int64_t(DISCode::MAX_LOCALS))));
+    frames.add_instruction(DISInstruction(DISOpcode::ENTER, DISValue(int64_t(DISCode::MAX_LOCALS) + 1)));
+    frames.add_instruction(DISInstruction(DISOpcode::ENTER, DISValue(int64_t(0xFFFFFFFE))));
+    frames.add_instruction(DISInstruction(DISOpcode::LOADL, DISValue(int64_t(DISCode::MAX_LOCALS) - 1)));
+    frames.add_instruction(DISInstruction(DISOpcode::STOREL, DISValue(int64_t(DISCode::MAX_LOCALS))));
+    DISCode capped = DISCode::lower(frames);
+    BOLT_ASSERT_EQ(static_cast<int>(DISCode::ENTER), static_cast<int>(capped.instructions[0].handler));
+    BOLT_ASSERT_EQ(static_cast<int>(DISCode::INVALID), static_cast<int>(capped.instructions[1].handler));
+    BOLT_ASSERT_EQ(static_cast<int>(DISCode::INVALID), static_cast<int>(capped.instructions[2].handler));
+    BOLT_ASSERT_EQ(static_cast<int>(DISCode::LOAD_LOCAL), static_cast<int>(capped.instructions[3].handler));
+    BOLT_ASSERT_EQ(static_cast<int>(DISCode::INVALID), static_cast<int>(capped.instructions[4].handler));
+}
+
+BOLT_TEST(Debugger, VM_ThreadedExecution) {
+    DISVM vm;
+    BOLT_ASSERT_TRUE(vm.load_program(create_countdown_program(1000)));
+    BOLT_ASSERT_TRUE(vm.run());
+    BOLT_ASSERT_EQ(1, vm.stack_size());
+    BOLT_ASSERT_EQ(0, vm.peek().int_value());
+    BOLT_ASSERT_EQ(7, vm.get_pc());
+
+    // A breakpoint switches to per-instruction stepping with the same result
+    DISVM debug_vm;
+    BOLT_ASSERT_TRUE(debug_vm.load_program(create_countdown_program(1000)));
+    BOLT_ASSERT_TRUE(debug_vm.set_breakpoint(4));
+    BOLT_ASSERT_TRUE(debug_vm.run());
+    BOLT_ASSERT_EQ(1, debug_vm.stack_size());
+    BOLT_ASSERT_EQ(0, debug_vm.peek().int_value());
+    BOLT_ASSERT_EQ(7, debug_vm.get_pc());
+}
+
+BOLT_TEST(Debugger, VM_RuntimeErrorHalts) {
+    DISProgram program;
+    program.add_instruction(DISInstruction(DISOpcode::LOAD, DISValue(int64_t(1))));
+    program.add_instruction(DISInstruction(DISOpcode::LOAD, DISValue(int64_t(0))));
+    program.add_instruction(DISInstruction(DISOpcode::DIV));
+    program.add_instruction(DISInstruction(DISOpcode::LOAD, DISValue(int64_t(42))));
+
+    DISVM vm;
+    BOLT_ASSERT_TRUE(vm.load_program(program));
+    BOLT_ASSERT_TRUE(vm.run());
+    BOLT_ASSERT_FALSE(vm.is_running());
+    BOLT_ASSERT_EQ(3, vm.get_pc());
+    BOLT_ASSERT_EQ(1, vm.stack_size());
+    BOLT_ASSERT_EQ(0, vm.peek().int_value());
+}
+
+BOLT_TEST(Debugger, VM_ArithmeticWraps) {
+    const int64_t min = std::numeric_limits<int64_t>::min();
+    const int64_t max = std::numeric_limits<int64_t>::max();
+    auto evaluate = [](int64_t a, int64_t b, DISOpcode opcode) {
+        DISProgram program;
+        program.add_instruction(DISInstruction(DISOpcode::LOAD, DISValue(a)));
+        program.add_instruction(DISInstruction(DISOpcode::LOAD, DISValue(b)));
+        program.add_instruction(DISInstruction(opcode));
+        program.add_instruction(DISInstruction(DISOpcode::HALT));
+        DISVM vm;
+        vm.load_program(program);
+        vm.run();
+        return vm.peek().int_value();
+    };
+
+    BOLT_ASSERT_EQ(min, evaluate(max, 1, DISOpcode::ADD));
+    BOLT_ASSERT_EQ(max, evaluate(min, 1, DISOpcode::SUB));
+    BOLT_ASSERT_EQ(min, evaluate(min, -1, DISOpcode::MUL));
+    BOLT_ASSERT_EQ(min, evaluate(min, -1, DISOpcode::DIV));
+    BOLT_ASSERT_EQ(0, evaluate(min, -1, DISOpcode::MOD));
+    BOLT_ASSERT_EQ(-3, evaluate(-7, 2, DISOpcode::DIV));
+    BOLT_ASSERT_EQ(-1, evaluate(-7, 2, DISOpcode::MOD));
+}
+
+BOLT_TEST(Debugger, Compiler_SlotResolution) {
+    std::string source = R"(
+        global result 0
+        global greeting "hi"
+        call probe
+        push 5 call fact store result
+        halt
+        func probe
+            local x
+            push 7 store x
+            ai_chat ping
+        end
+        func fact
+            local n
+            store n
+            load n push 1 le jmpf recurse
+            push 1 ret
+        recurse:
+            load n load n push 1 sub call fact mul
+        end
+    )";
+
+    LimboCompiler compiler;
+    DISProgram program = compiler.compile(source);
+    BOLT_ASSERT_FALSE(compiler.has_errors());
+    BOLT_ASSERT_EQ(2, program.global_names.size());
+    BOLT_ASSERT_EQ(2, program.functions.size());
+    BOLT_ASSERT_EQ(1, program.functions[1].locals.size());
+    BOLT_ASSERT_EQ(program.functions[1].entry, program.get_label_address("fact").value());
+
+    DISVM vm;
+    std::map<std::string, DISValue> probe_locals;
+    vm.set_ai_handler([&](const std::string&, const std::string&) {
+        probe_locals = vm.get_locals();
+        return std::string();
+    });
+    BOLT_ASSERT_TRUE(vm.load_program(program));
+    BOLT_ASSERT_TRUE(vm.run());
+    BOLT_ASSERT_EQ(120, vm.get_global("result").int_value());
+    BOLT_ASSERT_EQ("hi", vm.get_global("greeting").string_value());
+    BOLT_ASSERT_EQ(7, probe_locals["x"].int_value());
+    BOLT_ASSERT_EQ(0, vm.get_call_stack_depth());
+
+    // Name-based access for embedders and the debugger
+    vm.set_global("result", DISValue(int64_t(1)));
+    vm.set_global("extra", DISValue(int64_t(2)));
+    BOLT_ASSERT_EQ(1, vm.get_globals()["result"].int_value());
+    BOLT_ASSERT_EQ(2, vm.get_global("extra").int_value());
+}
+
+BOLT_TEST(Debugger, Compiler_UnresolvedNames) {
+    LimboCompiler compiler;
+    compiler.compile("jmp nowhere load missing halt");
+    BOLT_ASSERT_EQ(2, compiler.get_errors().size());
+
+    compiler.compile("func f local a end local b");
+    BOLT_ASSERT_EQ(1, compiler.get_errors().size());
+
+    DISProgram program;
+    program.add_label("start");
+    BOLT_ASSERT_EQ(0, program.get_label_address("start").value());
+    BOLT_ASSERT_FALSE(program.get_label_address("missing").has_value());
+
+    // Hand-built code naming an undeclared global halts instead of growing memory
+    program.add_instruction(DISInstruction(DISOpcode::LOADG, DISValue(int64_t(3))));
+    DISVM vm;
+    BOLT_ASSERT_TRUE(vm.load_program(program));
+    BOLT_ASSERT_TRUE(vm.run());
+    BOLT_ASSERT_EQ(0, vm.stack_size());
+    BOLT_ASSERT_EQ(1, vm.get_pc());
+}
+
+BOLT_TEST(Debugger, Program_Serialization) {
+    LimboCompiler compiler;
+    DISProgram program = compiler.compile(
+        "global total -5 global name \"dis\" func twice local x store x load x load x add end "
+        "push 21 call twice store total halt");
+    BOLT_ASSERT_FALSE(compiler.has_errors());
+    program.add_instruction(DISInstruction(DISOpcode::LOAD, DISValue(2.5)));
+    program.add_instruction(DISInstruction(DISOpcode::LOAD, DISValue(std::vector<DISValue>{DISValue("a"), DISValue(int64_t(-1))})));
+
+    std::string image = program.serialize();
+    auto loaded = DISProgram::deserialize(image);
+    BOLT_ASSERT_TRUE(loaded.has_value());
+    BOLT_ASSERT_EQ(program.source_limbo, loaded->source_limbo);
+    BOLT_ASSERT_EQ(program.instructions.size(), loaded->instructions.size());
+    BOLT_ASSERT_EQ(program.labels.size(), loaded->labels.size());
+    BOLT_ASSERT_EQ(-5, loaded->globals[0].int_value());
+    BOLT_ASSERT_EQ("dis", loaded->globals[1].string_value());
+    BOLT_ASSERT_EQ("x", loaded->functions[0].locals[0]);
+    BOLT_ASSERT_EQ(2.5, loaded->instructions[loaded->instructions.size() - 2].operands[0].float_value());
+    const auto& list = loaded->instructions.back().operands[0].list_value();
+    BOLT_ASSERT_EQ(2, list.size());
+    BOLT_ASSERT_EQ(-1, list[1].int_value());
+
+    DISVM vm;
+    BOLT_ASSERT_TRUE(vm.load_program(*loaded));
+    BOLT_ASSERT_TRUE(vm.run());
+    BOLT_ASSERT_EQ(42, vm.get_global("total").int_value());
+
+    // Corruption, truncation and other versions are rejected
+    std::string corrupt = image;
+    corrupt[corrupt.size() / 2] ^= 0x40;
+    BOLT_ASSERT_FALSE(DISProgram::deserialize(corrupt).has_value());
+    BOLT_ASSERT_FALSE(DISProgram::deserialize(image.substr(0, image.size() - 1)).has_value());
+    std::string other_version = image;
+    other_version[4] = static_cast<char>(DISProgram::FORMAT_VERSION + 1);
+    BOLT_ASSERT_FALSE(DISProgram::deserialize(other_version).has_value());
+}
+
+BOLT_TEST(Debugger, Program_BytecodeCache) {
+    std::string directory = "/tmp/bolt_dis_cache_test_" + std::to_string(::getpid());
+    std::filesystem::remove_all(directory);
+    DISBytecodeCache cache(directory);
+
+    std::string source = "global n 3 loop: load n jmpf done load n push 1 sub store n jmp loop done: halt";
+    DISVM first;
+    BOLT_ASSERT_TRUE(first.load_limbo_source(source, &cache));
+    BOLT_ASSERT_EQ(0, cache.hits());
+    BOLT_ASSERT_EQ(1, cache.misses());
+    BOLT_ASSERT_TRUE(std::filesystem::exists(cache.path_for(source)));
+
+    DISVM second;
+    BOLT_ASSERT_TRUE(second.load_limbo_source(source, &cache));
+    BOLT_ASSERT_EQ(1, cache.hits());
+    BOLT_ASSERT_TRUE(second.run());
+    BOLT_ASSERT_EQ(0, second.get_global("n").int_value());
+
+    // Programs with errors are not cached
+    DISVM broken;
+    BOLT_ASSERT_FALSE(broken.load_limbo_source("jmp nowhere", &cache));
+    BOLT_ASSERT_FALSE(std::filesystem::exists(cache.path_for("jmp nowhere")));
+
+    // A damaged entry is a miss and gets rewritten
+    {
+        std::ofstream damage(cache.path_for(source), std::ios::binary | std::ios::trunc);
+        damage << "DISB garbage";
+    }
+    DISProgram recompiled = DISProgramFactory::from_limbo_source(source, &cache);
+    BOLT_ASSERT_EQ(3, cache.misses());
+    BOLT_ASSERT_TRUE(cache.load(source).has_value());
+    BOLT_ASSERT_EQ(recompiled.instructions.size(), cache.load(source)->instructions.size());
+
+    std::filesystem::remove_all(directory);
+}
+
+BOLT_TEST(Debugger, VM_SliceBudgetAndWaiting) {
+    LimboCompiler compiler;
+    DISVM vm;
+    BOLT_ASSERT_TRUE(vm.load_program(compiler.compile("loop: jmp loop")));
+    BOLT_ASSERT_EQ(static_cast<int>(DISVM::SliceResult::YIELDED), static_cast<int>(vm.run_slice(100)));
+
+    // RECV without a message parks on the RECV and retries when resumed
+    std::deque<DISValue> mailbox;
+    DISVM receiver;
+    receiver.set_message_receiver([&mailbox](DISValue& message) {
+        if (mailbox.empty()) return false;
+        message = mailbox.front();
+        mailbox.pop_front();
+        return true;
+    });
+    BOLT_ASSERT_TRUE(receiver.load_program(compiler.compile("recv halt")));
+    BOLT_ASSERT_EQ(static_cast<int>(DISVM::SliceResult::WAITING), static_cast<int>(receiver.run_slice(100)));
+    BOLT_ASSERT_TRUE(receiver.is_waiting());
+    BOLT_ASSERT_EQ(0, receiver.get_pc());
+    mailbox.push_back(DISValue(int64_t(9)));
+    BOLT_ASSERT_EQ(static_cast<int>(DISVM::SliceResult::HALTED), static_cast<int>(receiver.run_slice(100)));
+    BOLT_ASSERT_EQ(9, receiver.peek().int_value());
+}
+
+BOLT_TEST(Debugger, VMManager_Scheduling) {
+    LimboCompiler compiler;
+    // Echo every message back to the host until a 0 arrives
+    DISProgram echo = compiler.compile(
+        "global m loop: recv store m load m jmpf done push \"\" load m send pop jmp loop done: halt");
+    BOLT_ASSERT_FALSE(compiler.has_errors());
+    DISProgram spin = compiler.compile("loop: jmp loop");
+
+    // One worker: the spinning VM must not starve the others
+    DISVMManager manager(1);
+    BOLT_ASSERT_EQ(1, manager.worker_count());
+    std::string spinner = manager.create_vm(spin);
+    BOLT_ASSERT_TRUE(manager.start_vm(spinner));
+
+    std::vector<std::string> ids;
+    for (int i = 0; i < 50; ++i) {
+        ids.push_back(manager.create_vm(echo));
+        BOLT_ASSERT_TRUE(manager.start_vm(ids.back()));
+    }
+    for (const auto& id : ids) {
+        BOLT_ASSERT_TRUE(manager.send_message(id, DISValue(int64_t(7))));
+        BOLT_ASSERT_TRUE(manager.send_message(id, DISValue(int64_t(0))));
+    }
+    for (const auto& id : ids) {
+        BOLT_ASSERT_TRUE(manager.wait_for_vm(id, std::chrono::milliseconds(5000)));
+        auto messages = manager.get_messages(id);
+        BOLT_ASSERT_EQ(1, messages.size());
+        BOLT_ASSERT_EQ(7, messages[0].int_value());
+        BOLT_ASSERT_EQ("stopped", manager.get_vm_status(id));
+    }
+
+    BOLT_ASSERT_TRUE(manager.is_vm_running(spinner));
+    BOLT_ASSERT_TRUE(manager.stop_vm(spinner));
+    BOLT_ASSERT_TRUE(manager.wait_for_vm(spinner, std::chrono::milliseconds(5000)));
+    BOLT_ASSERT_FALSE(manager.send_message(spinner, DISValue(int64_t(1))));
+    BOLT_ASSERT_TRUE(manager.destroy_vm(spinner));
+    BOLT_ASSERT_EQ("not found", manager.get_vm_status(spinner));
+}
+
+BOLT_TEST(Debugger, VM_ValueRepresentation) {
+    BOLT_ASSERT_EQ(16, sizeof(DISValue));
+
+    DISValue text("hello");
+    DISValue copy = text;
+    BOLT_ASSERT_EQ("hello", copy.string_value());
+    BOLT_ASSERT_EQ(text.string_value().data(), copy.string_value().data());
+
+    DISValue moved = std::move(copy);
+    BOLT_ASSERT_EQ(static_cast<int>(DISValue::STRING), static_cast<int>(moved.type()));
+    BOLT_ASSERT_EQ(static_cast<int>(DISValue::INT), static_cast<int>(copy.type()));
+    BOLT_ASSERT_EQ(0, copy.int_value());
+
+    BOLT_ASSERT_TRUE(DISValue(int64_t(3)).truthy());
+    BOLT_ASSERT_FALSE(DISValue(int64_t(0)).truthy());
+    BOLT_ASSERT_TRUE(text.truthy());
+    BOLT_ASSERT_FALSE(DISValue("").truthy());
+}
+
 BOLT_TEST(Debugger, DebuggerInterface_EventCallback) {
     auto debugger = std::make_unique<DebuggerInterface>();
     
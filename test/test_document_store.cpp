@@ -0,0 +1,143 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/collaboration/document_store.hpp"
+#include "bolt/collaboration/collaborative_session.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace bolt::collaboration;
+
+namespace {
+
+// Attaches a fresh store in a temporary directory to the session
+class StoreFixture {
+public:
+    explicit StoreFixture(const std::string& name)
+        : directory((std::filesystem::temp_directory_path() / name).string()),
+          session(CollaborativeSession::getInstance()) {
+        std::filesystem::remove_all(directory);
+        store = std::make_shared<DocumentStore>(directory);
+        opened = store->open();
+        session.setDocumentStore(store);
+        session.setSnapshotInterval(4);
+    }
+
+    ~StoreFixture() {
+        session.setDocumentStore(nullptr);
+        session.setSnapshotInterval(1000);
+        std::filesystem::remove_all(directory);
+    }
+
+    std::string directory;
+    CollaborativeSession& session;
+    std::shared_ptr<DocumentStore> store;
+    bool opened = false;
+};
+
+} // namespace
+
+BOLT_TEST(DocumentStore, LateJoinFromSnapshotAndTail) {
+    StoreFixture fixture("bolt_collab_store_join");
+    BOLT_ASSERT_TRUE(fixture.opened);
+    auto& session = fixture.session;
+
+    // Ten edits: snapshots at revisions 4 and 8, two edits in the tail
+    session.createDocument("persist_join", "first line\nsecond line");
+    for (size_t i = 0; i < 10; ++i) {
+        session.applyOperation(DocumentOperation(OperationType::INSERT, "writer", Position(1, i), "x"), "persist_join");
+    }
+    std::string content = session.getDocumentContent("persist_join");
+
+    CollaborativeSession::JoinState joinState;
+    BOLT_ASSERT_TRUE(session.getJoinState("persist_join", joinState));
+    BOLT_ASSERT_TRUE(joinState.revision == 10 && joinState.snapshotRevision == 8);
+    BOLT_ASSERT_EQ(2u, joinState.tail.size());
+
+    // A late joiner rebuilds the head from the snapshot and the tail
+    TextRope joined(*joinState.snapshot);
+    for (const auto& op : joinState.tail) {
+        BOLT_ASSERT_TRUE(op.apply(joined));
+    }
+    BOLT_ASSERT_EQ(content, joined.toString());
+    session.removeDocument("persist_join");
+}
+
+BOLT_TEST(DocumentStore, RecoveryFromSnapshotAndLog) {
+    StoreFixture fixture("bolt_collab_store_recover");
+    BOLT_ASSERT_TRUE(fixture.opened);
+    auto& session = fixture.session;
+    auto& store = fixture.store;
+
+    session.createDocument("persist_doc", "first line\nsecond line");
+    for (size_t i = 0; i < 10; ++i) {
+        session.applyOperation(DocumentOperation(OperationType::INSERT, "writer", Position(1, i), "x"), "persist_doc");
+    }
+    std::string content = session.getDocumentContent("persist_doc");
+    session.createDocument("persist_crdt", "abc", DocumentBackend::SEQUENCE_CRDT);
+    session.applyOperation(DocumentOperation(OperationType::INSERT, "writer", Position(0, 3), "def"), "persist_crdt");
+    session.applyOperation(DocumentOperation(OperationType::DELETE, "writer", Position(0, 0), "a"), "persist_crdt");
+
+    // Restart: drop both documents from memory and recover them from disk
+    BOLT_ASSERT_TRUE(session.closeDocument("persist_doc") && session.closeDocument("persist_crdt"));
+    BOLT_ASSERT_TRUE(session.getDocumentContent("persist_doc").empty());
+    BOLT_ASSERT_EQ(2u, session.recoverDocuments());
+    BOLT_ASSERT_EQ(content, session.getDocumentContent("persist_doc"));
+    BOLT_ASSERT_EQ(10u, session.getDocumentRevision("persist_doc"));
+    BOLT_ASSERT_EQ("bcdef", session.getDocumentContent("persist_crdt"));
+    BOLT_ASSERT_TRUE(session.getDocumentBackend("persist_crdt") == DocumentBackend::SEQUENCE_CRDT);
+
+    // Edits continue from the recovered revision
+    BOLT_ASSERT_TRUE(session.applyOperation(DocumentOperation(OperationType::INSERT, "writer", Position(0, 0), ">"), "persist_doc"));
+    content = session.getDocumentContent("persist_doc");
+
+    // A torn record at the end of the log is dropped, earlier ones survive
+    BOLT_ASSERT_TRUE(session.closeDocument("persist_doc"));
+    {
+        std::ofstream log(store->logPath("persist_doc"), std::ios::binary | std::ios::app);
+        log << "\x0c\x05xy";
+    }
+    BOLT_ASSERT_TRUE(session.recoverDocument("persist_doc"));
+    BOLT_ASSERT_EQ(content, session.getDocumentContent("persist_doc"));
+    BOLT_ASSERT_EQ(4u, store->getStats().discardedBytes);
+
+    // Removing a document deletes its files
+    BOLT_ASSERT_TRUE(session.removeDocument("persist_doc") && session.removeDocument("persist_crdt"));
+    BOLT_ASSERT_FALSE(store->contains("persist_doc"));
+    BOLT_ASSERT_FALSE(session.recoverDocument("persist_doc"));
+}
+
+BOLT_TEST(DocumentStore, FailedWritesAreRetried) {
+    auto directory = (std::filesystem::temp_directory_path() / "bolt_collab_store_retry").string();
+    std::filesystem::remove_all(directory);
+    {
+        // Zero interval: every append flushes synchronously
+        DocumentStore store(directory, std::chrono::milliseconds(0));
+        BOLT_ASSERT_TRUE(store.open());
+        DocumentSnapshot snapshot;
+        snapshot.state = {'a', 'b'};
+        store.create("retry_doc", snapshot);
+
+        // A directory in place of the op log makes every log write fail
+        std::filesystem::remove(store.logPath("retry_doc"));
+        std::filesystem::create_directory(store.logPath("retry_doc"));
+        store.append("retry_doc", LogRecord{1, {'x'}});
+        store.append("retry_doc", LogRecord{2, {'y'}});
+        BOLT_ASSERT_EQ(2u, store.getStats().failedWrites);
+        BOLT_ASSERT_FALSE(store.flush());
+
+        // Once the log is writable again nothing is lost and order is kept
+        std::filesystem::remove(store.logPath("retry_doc"));
+        BOLT_ASSERT_TRUE(store.flush());
+        DocumentSnapshot loaded;
+        std::vector<LogRecord> records;
+        BOLT_ASSERT_TRUE(store.load("retry_doc", loaded, records));
+        BOLT_ASSERT_EQ(2u, records.size());
+        BOLT_ASSERT_EQ(1u, records[0].revision);
+        BOLT_ASSERT_EQ(2u, records[1].revision);
+        BOLT_ASSERT_TRUE(records[1].payload == std::vector<uint8_t>{'y'});
+    }
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,201 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/drawkern/drawkern.hpp"
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace bolt::drawkern;
+
+namespace {
+
+DrawKernCommand make_rect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+    DrawKernCommand cmd{};
+    cmd.op = DrawKernOp::RECT;
+    cmd.x = x;
+    cmd.y = y;
+    cmd.w = w;
+    cmd.h = h;
+    cmd.color = color;
+    return cmd;
+}
+
+DrawKernCommand make_text(int32_t x, int32_t y, const std::string& text) {
+    DrawKernCommand cmd{};
+    cmd.op = DrawKernOp::STRING;
+    cmd.x = x;
+    cmd.y = y;
+    cmd.w = static_cast<int32_t>(text.size()) * 8;
+    cmd.h = 16;
+    cmd.data = text;
+    return cmd;
+}
+
+std::vector<DrawKernCommand> make_editor(const std::string& line) {
+    std::vector<DrawKernCommand> frame{make_rect(0, 0, 1200, 800, 0x1e1e1e)};
+    for (int i = 0; i < 40; ++i) {
+        frame.push_back(make_text(40, 20 + i * 16, i == 5 ? line : "line " + std::to_string(i)));
+    }
+    return frame;
+}
+
+// Screen of 8-pixel-wide cells, one row per pixel line: text fills the 16
+// rows under it, rectangles blank their cells and cleared cells read '.'.
+// Drawing honours the clip.
+class ScreenClient : public DrawKernClient {
+public:
+    ScreenClient() : DrawKernClient("test"), rows(800, std::string(150, '.')) {}
+
+    void render_rect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t) override {
+        rects++;
+        fill(DrawKernRect{x, y, w, h}, ' ');
+    }
+    void render_text(int32_t x, int32_t y, const std::string& text) override {
+        texts.push_back(text);
+        for (size_t i = 0; i < text.size(); ++i) {
+            fill(DrawKernRect{x + static_cast<int32_t>(i) * 8, y, 8, 16}, text[i]);
+        }
+    }
+    void render_ai_interface(const AIWorkbenchGlyph&) override {}
+    void set_clip(const DrawKernRect* area) override { clip = area ? *area : SCREEN; }
+    void clear_rect(int32_t x, int32_t y, int32_t w, int32_t h) override { fill(DrawKernRect{x, y, w, h}, '.'); }
+
+    // Text on the screen at a pixel position, up to the first blank cell
+    std::string text_at(int32_t x, int32_t y) const {
+        const std::string& row = rows[static_cast<size_t>(y)];
+        size_t start = static_cast<size_t>(x / 8);
+        return row.substr(start, row.find_first_of(" .", start) - start);
+    }
+
+    int rects = 0;
+    std::vector<std::string> texts;
+
+private:
+    static constexpr DrawKernRect SCREEN{0, 0, 1200, 800};
+
+    void fill(const DrawKernRect& rect, char c) {
+        DrawKernRect area = rect.intersected(clip).intersected(SCREEN);
+        for (int32_t y = area.y; y < area.y + area.h; ++y) {
+            for (int32_t x = area.x / 8; x * 8 < area.x + area.w; ++x) {
+                rows[static_cast<size_t>(y)][static_cast<size_t>(x)] = c;
+            }
+        }
+    }
+
+    std::vector<std::string> rows;
+    DrawKernRect clip = SCREEN;
+};
+
+} // namespace
+
+BOLT_TEST(DrawKernFrame, DeltaRoundTrip) {
+    DrawKernFrameEncoder encoder;
+    DrawKernFrameDecoder decoder;
+
+    auto frame = make_editor("int x = 1;");
+    std::string keyframe = encoder.encode(frame);
+    BOLT_ASSERT_TRUE(decoder.decode(keyframe));
+    BOLT_ASSERT_TRUE(decoder.full_redraw());
+    BOLT_ASSERT_TRUE(decoder.frame() == frame);
+
+    // An unchanged frame is not sent at all
+    BOLT_ASSERT_TRUE(encoder.encode(frame).empty());
+
+    frame = make_editor("int x = 12;");
+    frame[20].attributes["style"] = "bold";
+    std::string delta = encoder.encode(frame);
+    BOLT_ASSERT_TRUE(delta.size() * 4 < keyframe.size());
+    BOLT_ASSERT_TRUE(decoder.decode(delta));
+    BOLT_ASSERT_FALSE(decoder.full_redraw());
+    BOLT_ASSERT_TRUE(decoder.frame() == frame);
+    BOLT_ASSERT_EQ(2u, decoder.dirty_rects().size());
+
+    frame.pop_back();
+    frame.push_back(make_rect(-20, 300, 4, 16, 0xffffff));
+    BOLT_ASSERT_TRUE(decoder.decode(encoder.encode(frame)));
+    BOLT_ASSERT_TRUE(decoder.frame() == frame);
+
+    // A delta against a frame the decoder never saw, or a damaged one, is refused
+    std::string skipped = encoder.encode(make_editor("gap"));
+    std::string next = encoder.encode(make_editor("gap!"));
+    BOLT_ASSERT_FALSE(decoder.decode(next));
+    BOLT_ASSERT_FALSE(decoder.decode(skipped.substr(0, skipped.size() - 1)));
+    BOLT_ASSERT_TRUE(decoder.frame() == frame);
+    BOLT_ASSERT_TRUE(decoder.decode(encoder.keyframe()));
+    BOLT_ASSERT_TRUE(decoder.frame() == make_editor("gap!"));
+}
+
+BOLT_TEST(DrawKernFrame, FrameBufferSendsOnePayloadPerClient) {
+    std::map<std::string, std::vector<std::string>> sent;
+    DrawKernFrameBuffer buffer([&](const std::string& client, const std::string& payload) {
+        sent[client].push_back(payload);
+    });
+    buffer.add_client("terminal");
+    buffer.add_client("web");
+
+    for (const auto& cmd : make_editor("a")) {
+        buffer.push(cmd);
+    }
+    BOLT_ASSERT_EQ(41u, buffer.pending());
+    buffer.end_frame();
+    BOLT_ASSERT_EQ(0u, buffer.pending());
+    BOLT_ASSERT_EQ(1u, sent["terminal"].size());
+    BOLT_ASSERT_TRUE(sent["terminal"][0] == sent["web"][0]);
+
+    // A late client gets a keyframe while the others get the shared delta
+    buffer.add_client("late");
+    for (const auto& cmd : make_editor("ab")) {
+        buffer.push(cmd);
+    }
+    buffer.end_frame();
+    BOLT_ASSERT_TRUE(sent["terminal"][1] == sent["web"][1]);
+    BOLT_ASSERT_TRUE(sent["late"][0].size() > sent["web"][1].size());
+
+    DrawKernFrameDecoder web, late;
+    BOLT_ASSERT_TRUE(web.decode(sent["web"][0]));
+    BOLT_ASSERT_TRUE(web.decode(sent["web"][1]));
+    BOLT_ASSERT_TRUE(late.decode(sent["late"][0]));
+    BOLT_ASSERT_TRUE(web.frame() == late.frame());
+
+    // Nothing changed, nothing sent
+    for (const auto& cmd : make_editor("ab")) {
+        buffer.push(cmd);
+    }
+    BOLT_ASSERT_EQ(0u, buffer.end_frame());
+}
+
+BOLT_TEST(DrawKernFrame, ClientRepaintsOnlyDirtyAreas) {
+    DrawKernFrameEncoder encoder;
+    ScreenClient client;
+
+    auto frame = make_editor("first");
+    BOLT_ASSERT_TRUE(client.apply_frame(encoder.encode(frame)));
+    BOLT_ASSERT_EQ(1, client.rects);
+    BOLT_ASSERT_EQ(40u, client.texts.size());
+    BOLT_ASSERT_EQ(std::string("first"), client.text_at(40, 100));
+
+    // The background is repainted only under the edit, so the lines around it survive
+    client.rects = 0;
+    client.texts.clear();
+    frame = make_editor("second");
+    BOLT_ASSERT_TRUE(client.apply_frame(encoder.encode(frame)));
+    BOLT_ASSERT_EQ(1, client.rects);
+    BOLT_ASSERT_EQ(1u, client.texts.size());
+    BOLT_ASSERT_EQ(std::string("second"), client.text_at(40, 100));
+    BOLT_ASSERT_EQ(std::string("line"), client.text_at(40, 84));
+    BOLT_ASSERT_EQ(std::string("line"), client.text_at(40, 116));
+    BOLT_ASSERT_EQ(std::string("line"), client.text_at(40, 20));
+
+    // A removed command's area is cleared
+    frame.pop_back();
+    BOLT_ASSERT_TRUE(client.apply_frame(encoder.encode(frame)));
+    BOLT_ASSERT_EQ(std::string(""), client.text_at(40, 20 + 39 * 16));
+    BOLT_ASSERT_EQ(std::string("line"), client.text_at(40, 20 + 38 * 16));
+
+    // Shorter text leaves nothing of the longer text behind
+    frame[6].data = "x";
+    BOLT_ASSERT_TRUE(client.apply_frame(encoder.encode(frame)));
+    BOLT_ASSERT_EQ(std::string("x"), client.text_at(40, 100));
+    BOLT_ASSERT_EQ(std::string("line"), client.text_at(40, 84));
+
+    BOLT_ASSERT_FALSE(client.apply_frame("not a frame"));
+}
@@ -0,0 +1,211 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/drawkern/dis_vm.hpp"
+#include "bolt/drawkern/drawkern.hpp"
+#include "bolt/drawkern/glyph_topology.hpp"
+#include "bolt/drawkern/yacc_grammar.hpp"
+#include <map>
+#include <string>
+
+using namespace bolt::drawkern;
+
+BOLT_TEST(GlyphGrammar, ParsesDeclarations) {
+    GlyphAST ast = GlyphAST::parse(R"(
+vm host : dis {
+    architecture = "portable";
+    capabilities = ["ai-inference", "file-io"];
+}
+
+// A workbench with nested blocks
+workbench bench on host {
+    title = "say \"hi\"";
+    render { width = 1200; height = 800; background = "#1e1e1e"; }
+    namespace { mount "/ai" as "/n/ai"; }
+}
+)");
+    BOLT_ASSERT_FALSE(ast.has_errors());
+    BOLT_ASSERT_EQ(2u, ast.root().children().size());
+
+    const auto* vm = static_cast<const VMDeclNode*>(ast.root().children()[0]);
+    BOLT_ASSERT_TRUE(vm->type == ASTNodeType::VM_DECL);
+    BOLT_ASSERT_TRUE(vm->vm_id == "host");
+    BOLT_ASSERT_TRUE(vm->vm_type == "dis");
+    BOLT_ASSERT_EQ(2u, vm->children().size());
+
+    const auto* capabilities = static_cast<const PropertyNode*>(vm->children()[1]);
+    BOLT_ASSERT_EQ(1u, capabilities->children().size());
+    BOLT_ASSERT_EQ(2u, capabilities->children()[0]->children().size());
+    BOLT_ASSERT_TRUE(capabilities->children()[0]->children()[1]->get_attribute(ASTSymbol::VALUE) == "file-io");
+
+    const auto* bench = static_cast<const GlyphDeclNode*>(ast.root().children()[1]);
+    BOLT_ASSERT_TRUE(bench->base_vm == "host");
+    BOLT_ASSERT_TRUE(bench->get_attribute(ASTSymbol::TYPE) == "workbench");
+    BOLT_ASSERT_EQ(3u, bench->children().size());
+    BOLT_ASSERT_TRUE(static_cast<const PropertyNode*>(bench->children()[0])->value == "say \"hi\"");
+    BOLT_ASSERT_TRUE(bench->children()[1]->get_attribute(ASTSymbol::NAME) == "render");
+}
+
+BOLT_TEST(GlyphGrammar, RecoversFromErrors) {
+    GlyphAST ast = GlyphAST::parse(
+        "vm a : dis { x = ; y = 3; }\n"
+        "glyph b on a { width = 5 @ ; }\n"
+        "vm c : wasm { z = [1, 2; }\n"
+        "glyph d on c { w = 1;");
+    BOLT_ASSERT_TRUE(ast.has_errors());
+    BOLT_ASSERT_EQ(4u, ast.root().children().size());
+    BOLT_ASSERT_EQ(1u, ast.root().children()[0]->children().size());
+    BOLT_ASSERT_EQ(1u, ast.root().children()[1]->children().size());
+    BOLT_ASSERT_TRUE(static_cast<const VMDeclNode*>(ast.root().children()[2])->vm_type == "wasm");
+
+    // Errors keep their source position
+    bool positioned = false;
+    for (const auto& error : ast.get_errors()) {
+        positioned |= error.rfind("Line 1, Column 18:", 0) == 0;
+    }
+    BOLT_ASSERT_TRUE(positioned);
+}
+
+BOLT_TEST(GlyphGrammar, GeneratesVMGlyph) {
+    YaccGrammarSystem grammar;
+    BOLT_ASSERT_TRUE(grammar.validate_description(grammar.get_ai_workbench_template()));
+    BOLT_ASSERT_TRUE(grammar.validate_description(grammar.get_file_server_template()));
+    BOLT_ASSERT_TRUE(grammar.validate_description(grammar.get_echo_server_template()));
+
+    VMGlyph glyph = grammar.parse_vm_glyph(R"(
+vm host : native { architecture = "arm64"; capabilities = ["gpu"]; }
+workbench bench on host {
+    render { width = 640; height = 480; background = "#102030"; font = "Fira Code"; }
+    ai { model = "rwkv"; }
+}
+)");
+    BOLT_ASSERT_TRUE(grammar.get_validation_errors().empty());
+    BOLT_ASSERT_TRUE(glyph.vm_type == "native");
+    BOLT_ASSERT_TRUE(glyph.architecture == "arm64");
+    BOLT_ASSERT_EQ(1u, glyph.capabilities.size());
+    BOLT_ASSERT_EQ(640, glyph.render.width);
+    BOLT_ASSERT_EQ(480, glyph.render.height);
+    BOLT_ASSERT_EQ(0x102030u, glyph.render.background_color);
+    BOLT_ASSERT_TRUE(glyph.render.font_family == "Fira Code");
+    BOLT_ASSERT_TRUE(glyph.render.ai_enabled);
+}
+
+namespace {
+
+std::string make_topology(int count) {
+    std::string source = "// generated topology\n";
+    for (int i = 0; i < count; ++i) {
+        std::string id = std::to_string(i);
+        source += "vm vm_" + id + " : dis {\n    architecture = \"portable\";\n}\n";
+        source += "glyph g_" + id + " on vm_" + id + " {\n    width = " + std::to_string(800 + i) + ";\n}\n";
+    }
+    return source;
+}
+
+std::string replace_once(std::string text, const std::string& from, const std::string& to) {
+    return text.replace(text.find(from), from.size(), to);
+}
+
+} // namespace
+
+BOLT_TEST(GlyphTopology, IncrementalUpdate) {
+    GlyphDocument document;
+    std::string source = make_topology(50);
+    GlyphTopologyDiff diff = document.update(source);
+    BOLT_ASSERT_EQ(50u, diff.added_vms.size());
+    BOLT_ASSERT_EQ(50u, diff.added_glyphs.size());
+
+    // Only the fragments around the edit are parsed again
+    source = replace_once(source, "width = 820;", "width = 1024;");
+    diff = document.update(source);
+    BOLT_ASSERT_TRUE(diff.reparsed <= 3);
+    BOLT_ASSERT_TRUE(diff.changed_vms.empty());
+    BOLT_ASSERT_EQ(1u, diff.changed_glyphs.size());
+    BOLT_ASSERT_TRUE(diff.changed_glyphs[0] == "g_20");
+
+    // Formatting and comments are not changes
+    source = replace_once(source, "vm vm_7 : dis {", "// seventh\nvm   vm_7 : dis {");
+    diff = document.update(source);
+    BOLT_ASSERT_TRUE(diff.empty());
+
+    source = replace_once(source, "vm vm_30 : dis {", "vm vm_30 : dis {\n    limbo = \"x\";");
+    source += "glyph extra on vm_1 { width = 10; }\n";
+    source = replace_once(source, "glyph g_40 on vm_40 {\n    width = 840;\n}\n", "");
+    diff = document.update(source);
+    BOLT_ASSERT_EQ(1u, diff.changed_vms.size());
+    BOLT_ASSERT_TRUE(diff.changed_vms[0] == "vm_30");
+    BOLT_ASSERT_EQ(1u, diff.added_glyphs.size());
+    BOLT_ASSERT_EQ(1u, diff.removed_glyphs.size());
+    BOLT_ASSERT_TRUE(diff.removed_glyphs[0] == "g_40");
+
+    // The incremental result matches a parse from scratch, positions included
+    GlyphDocument fresh;
+    fresh.update(source);
+    BOLT_ASSERT_EQ(fresh.fragments().size(), document.fragments().size());
+    for (size_t i = 0; i < fresh.fragments().size(); ++i) {
+        BOLT_ASSERT_EQ(fresh.fragments()[i].begin, document.fragments()[i].begin);
+        BOLT_ASSERT_EQ(fresh.fragments()[i].line, document.fragments()[i].line);
+    }
+    BOLT_ASSERT_NOT_NULL(document.find_glyph("extra"));
+    BOLT_ASSERT_FALSE(document.has_errors());
+
+    // An unterminated string swallows what follows until the source is fixed
+    std::string broken = replace_once(source, "\"portable\"", "\"portable");
+    diff = document.update(broken);
+    BOLT_ASSERT_TRUE(document.has_errors());
+    BOLT_ASSERT_FALSE(diff.removed_vms.empty());
+    diff = document.update(source);
+    BOLT_ASSERT_FALSE(document.has_errors());
+    BOLT_ASSERT_FALSE(diff.added_vms.empty());
+    BOLT_ASSERT_TRUE(diff.removed_vms.empty());
+    for (int i = 0; i < 50; ++i) {
+        BOLT_ASSERT_NOT_NULL(document.find_vm("vm_" + std::to_string(i)));
+    }
+}
+
+BOLT_TEST(GlyphTopology, RedeploysOnlyChangedVMs) {
+    DISVMManager manager(1);
+    std::map<std::string, int> renders;
+    {
+        GlyphTopology topology(manager);
+        topology.set_glyph_renderer([&](const std::string& name, const VMGlyph&) { renders[name]++; });
+
+        std::string source = make_topology(20);
+        topology.apply(source);
+        BOLT_ASSERT_EQ(20u, topology.deployed_vm_count());
+        BOLT_ASSERT_EQ(20u, renders.size());
+        BOLT_ASSERT_TRUE(manager.is_vm_running(topology.vm_instance("vm_3")));
+
+        std::map<std::string, std::string> before;
+        for (int i = 0; i < 20; ++i) {
+            std::string name = "vm_" + std::to_string(i);
+            before[name] = topology.vm_instance(name);
+        }
+        renders.clear();
+
+        source = replace_once(source, "vm vm_5 : dis {\n    architecture = \"portable\";",
+                              "vm vm_5 : dis {\n    architecture = \"arm64\";");
+        GlyphTopologyDiff diff = topology.apply(source);
+        BOLT_ASSERT_EQ(1u, diff.changed_vms.size());
+        BOLT_ASSERT_EQ(1u, diff.rebound_glyphs.size());
+        BOLT_ASSERT_TRUE(diff.rebound_glyphs[0] == "g_5");
+        BOLT_ASSERT_EQ(1u, renders.size());
+        BOLT_ASSERT_EQ(1, renders["g_5"]);
+
+        for (const auto& [name, vm_id] : before) {
+            if (name == "vm_5") {
+                BOLT_ASSERT_TRUE(topology.vm_instance(name) != vm_id);
+                BOLT_ASSERT_TRUE(manager.get_vm_status(vm_id) == "not found");
+            } else {
+                BOLT_ASSERT_TRUE(topology.vm_instance(name) == vm_id);
+            }
+        }
+
+        source = replace_once(source, "vm vm_9 : dis {\n    architecture = \"portable\";\n}\n", "");
+        diff = topology.apply(source);
+        BOLT_ASSERT_EQ(1u, diff.removed_vms.size());
+        BOLT_ASSERT_EQ(19u, topology.deployed_vm_count());
+        BOLT_ASSERT_TRUE(topology.vm_instance("vm_9").empty());
+    }
+
+    // The topology takes its VMs down with it
+    BOLT_ASSERT_TRUE(manager.list_vms().empty());
+}
@@ -0,0 +1,356 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/ai/inference_engine.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace bolt::ai;
+
+namespace {
+
+const size_t VOCAB = 26;
+
+// Letters are tokens and the model predicts the next letter. Each decode
+// checks that a slot's positions continue what it holds, and records
+// which slots it served. Decoding can be held to line up submissions.
+class AlphabetModel : public BatchedModel {
+public:
+    explicit AlphabetModel(size_t slots, size_t max_batch = 16,
+                           std::chrono::milliseconds delay = std::chrono::milliseconds(0))
+        : contents_(slots), max_batch_(max_batch), delay_(delay) {}
+
+    size_t n_vocab() const override { return VOCAB; }
+    size_t max_batch() const override { return max_batch_; }
+    size_t slot_context() const override { return 64; }
+    int32_t eos() const override { return -1; }
+
+    std::vector<int32_t> tokenize(const std::string& text) override {
+        std::vector<int32_t> tokens;
+        for (char c : text) {
+            if (c >= 'a' && c <= 'z') {
+                tokens.push_back(c - 'a');
+            }
+        }
+        return tokens;
+    }
+
+    std::string token_text(int32_t token) override { return std::string(1, static_cast<char>('a' + token)); }
+
+    bool decode(const std::vector<Entry>& batch) override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ++waiting_;
+        cv_.wait(lock, [this] { return !held_; });
+        --waiting_;
+        if (delay_.count() > 0) {
+            std::this_thread::sleep_for(delay_);
+        }
+
+        rows_.assign(batch.size(), std::vector<float>());
+        std::set<int32_t> slots;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            const Entry& entry = batch[i];
+            auto& content = contents_[entry.slot];
+            if (entry.position != static_cast<int32_t>(content.size())) {
+                return false;
+            }
+            content.push_back(entry.token);
+            slots.insert(entry.slot);
+            if (entry.logits) {
+                rows_[i].assign(VOCAB, 0.0f);
+                rows_[i][(entry.token + 1) % VOCAB] = 10.0f;
+            }
+        }
+        steps_.push_back(slots.size());
+        return true;
+    }
+
+    float* logits(size_t i) override { return rows_[i].data(); }
+
+    void evict(int32_t slot, size_t from) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& content = contents_[slot];
+        content.resize(std::min(from, content.size()));
+    }
+
+    void hold() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        held_ = true;
+    }
+
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            held_ = false;
+        }
+        cv_.notify_all();
+    }
+
+    // Wait until the engine is parked in a held decode
+    void wait_blocked() {
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (waiting_ > 0) {
+                    return;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // Most slots any single decode served
+    size_t widest_step() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return steps_.empty() ? 0 : *std::max_element(steps_.begin(), steps_.end());
+    }
+
+private:
+    std::vector<std::vector<int32_t>> contents_;
+    std::vector<std::vector<float>> rows_;
+    std::vector<size_t> steps_;
+    size_t max_batch_;
+    std::chrono::milliseconds delay_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool held_ = false;
+    int waiting_ = 0;
+};
+
+EngineRequest request(const std::string& prompt, int max_tokens,
+                      RequestPriority priority = RequestPriority::Normal) {
+    EngineRequest r;
+    r.prompt = prompt;
+    r.max_tokens = max_tokens;
+    r.priority = priority;
+    r.sampling.temperature = 0.0f;
+    r.sampling.repeat_penalty = 1.0f;
+    return r;
+}
+
+EngineConfig config(size_t slots) {
+    EngineConfig c;
+    c.slots = slots;
+    c.prefill_chunk = 4;
+    c.aging = std::chrono::milliseconds(0);
+    return c;
+}
+
+// Letters following the prompt's last one
+std::string continuation(char last, int count) {
+    std::string text;
+    for (int i = 1; i <= count; ++i) {
+        text += static_cast<char>('a' + (last - 'a' + i) % VOCAB);
+    }
+    return text;
+}
+
+} // namespace
+
+BOLT_TEST(InferenceEngine, ConcurrentRequestsShareDecodeSteps) {
+    auto owned = std::make_unique<AlphabetModel>(4);
+    AlphabetModel& model = *owned;
+    model.hold();
+    InferenceEngine engine(std::move(owned), config(4));
+
+    std::vector<std::string> prompts{"abc", "hello", "xyz", "mno"};
+    std::vector<std::future<bolt::drawkern::AIInferenceResponse>> futures;
+    for (const auto& prompt : prompts) {
+        futures.push_back(engine.submit(request(prompt, 10)));
+    }
+    model.release();
+
+    // Each output is what the request would produce alone
+    for (size_t i = 0; i < prompts.size(); ++i) {
+        auto response = futures[i].get();
+        BOLT_ASSERT_TRUE(response.success);
+        BOLT_ASSERT_EQ(continuation(prompts[i].back(), 10), response.response);
+        BOLT_ASSERT_EQ(10, response.tokens_generated);
+        BOLT_ASSERT_EQ(static_cast<int32_t>(prompts[i].size()), response.tokens_processed);
+    }
+
+    // One at a time would take at least 40 decodes
+    EngineStats stats = engine.stats();
+    BOLT_ASSERT_EQ(4u, model.widest_step());
+    BOLT_ASSERT_TRUE(stats.steps < 20);
+    BOLT_ASSERT_TRUE(stats.average_batch() > 2.0f);
+    BOLT_ASSERT_EQ(40u, stats.generated_tokens);
+    BOLT_ASSERT_EQ(4u, stats.completed);
+}
+
+BOLT_TEST(InferenceEngine, LateRequestJoinsRunningBatch) {
+    auto owned = std::make_unique<AlphabetModel>(2, 16, std::chrono::milliseconds(2));
+    AlphabetModel& model = *owned;
+    InferenceEngine engine(std::move(owned), config(2));
+
+    std::atomic<int> streamed{0};
+    EngineRequest first = request("abc", 30);
+    first.on_token = [&](const std::string&) {
+        ++streamed;
+        return true;
+    };
+    auto long_running = engine.submit(first);
+    while (streamed < 5) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // Admitted while the first is generating, and done before it
+    auto late = engine.submit(request("pqr", 3)).get();
+    BOLT_ASSERT_TRUE(late.success);
+    BOLT_ASSERT_EQ(std::string("stu"), late.response);
+    BOLT_ASSERT_TRUE(streamed < 30);
+    BOLT_ASSERT_EQ(2u, model.widest_step());
+
+    auto response = long_running.get();
+    BOLT_ASSERT_TRUE(response.success);
+    BOLT_ASSERT_EQ(continuation('c', 30), response.response);
+}
+
+BOLT_TEST(InferenceEngine, InteractivePreemptsBackground) {
+    auto owned = std::make_unique<AlphabetModel>(1);
+    AlphabetModel& model = *owned;
+    model.hold();
+    InferenceEngine engine(std::move(owned), config(1));
+
+    std::mutex log_mutex;
+    std::string log;
+    auto tagged = [&](const std::string& prompt, int max_tokens, RequestPriority priority, char tag) {
+        EngineRequest r = request(prompt, max_tokens, priority);
+        r.on_token = [&, tag](const std::string&) {
+            std::lock_guard<std::mutex> lock(log_mutex);
+            log += tag;
+            return true;
+        };
+        return r;
+    };
+
+    auto analysis = engine.submit(tagged("abc", 6, RequestPriority::Background, 'A'));
+    model.wait_blocked();
+    auto chat = engine.submit(tagged("hij", 3, RequestPriority::Normal, 'N'));
+    auto completion = engine.submit(tagged("uvw", 3, RequestPriority::Interactive, 'I'));
+    model.release();
+
+    auto analysis_response = analysis.get();
+    auto chat_response = chat.get();
+    auto completion_response = completion.get();
+
+    // The analysis got its first token, then waited for both others
+    BOLT_ASSERT_EQ(std::string("AIIINNNAAAAA"), log);
+    BOLT_ASSERT_EQ(1u, engine.stats().preempted);
+    BOLT_ASSERT_EQ(std::string("xyz"), completion_response.response);
+    BOLT_ASSERT_EQ(std::string("klm"), chat_response.response);
+
+    // Resumed from its tokens so far, with nothing lost or repeated
+    BOLT_ASSERT_TRUE(analysis_response.success);
+    BOLT_ASSERT_EQ(continuation('c', 6), analysis_response.response);
+}
+
+BOLT_TEST(InferenceEngine, AgedRequestPreemptsByEffectivePriority) {
+    auto owned = std::make_unique<AlphabetModel>(1);
+    AlphabetModel& model = *owned;
+    model.hold();
+    EngineConfig aging = config(1);
+    aging.aging = std::chrono::milliseconds(20);
+    InferenceEngine engine(std::move(owned), aging);
+
+    std::mutex log_mutex;
+    std::string log;
+    auto tagged = [&](const std::string& prompt, int max_tokens, RequestPriority priority, char tag) {
+        EngineRequest r = request(prompt, max_tokens, priority);
+        r.on_token = [&, tag](const std::string&) {
+            std::lock_guard<std::mutex> lock(log_mutex);
+            log += tag;
+            return true;
+        };
+        return r;
+    };
+
+    auto chat = engine.submit(tagged("abc", 6, RequestPriority::Normal, 'N'));
+    model.wait_blocked();
+    auto analysis = engine.submit(tagged("hij", 3, RequestPriority::Background, 'B'));
+
+    // Two aging intervals lift the background request above the running chat
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    model.release();
+
+    BOLT_ASSERT_TRUE(analysis.get().success);
+    BOLT_ASSERT_TRUE(chat.get().success);
+    BOLT_ASSERT_EQ(std::string("NBBBNNNNN"), log);
+    BOLT_ASSERT_EQ(1u, engine.stats().preempted);
+}
+
+BOLT_TEST(InferenceEngine, CancellationAndStoppedStreams) {
+    auto owned = std::make_unique<AlphabetModel>(1);
+    AlphabetModel& model = *owned;
+    model.hold();
+    InferenceEngine engine(std::move(owned), config(1));
+
+    int seen = 0;
+    EngineRequest running = request("abc", 20);
+    running.on_token = [&](const std::string&) { return ++seen < 3; };
+    auto stopped = engine.submit(running);
+    model.wait_blocked();
+
+    EngineRequest waiting = request("xyz", 20);
+    auto cancelled = engine.submit(waiting);
+    waiting.cancel.cancel();
+    model.release();
+
+    auto stopped_response = stopped.get();
+    BOLT_ASSERT_FALSE(stopped_response.success);
+    BOLT_ASSERT_EQ(std::string(CANCELLED_ERROR), stopped_response.error);
+    BOLT_ASSERT_EQ(std::string("def"), stopped_response.response);
+
+    auto cancelled_response = cancelled.get();
+    BOLT_ASSERT_FALSE(cancelled_response.success);
+    BOLT_ASSERT_EQ(std::string(CANCELLED_ERROR), cancelled_response.error);
+    BOLT_ASSERT_EQ(0, cancelled_response.tokens_generated);
+}
+
+BOLT_TEST(InferenceEngine, FreeSlotWithSharedPrefixIsReused) {
+    InferenceEngine engine(std::make_unique<AlphabetModel>(2), config(2));
+
+    BOLT_ASSERT_EQ(std::string("ij"), engine.submit(request("abcdefgh", 2)).get().response);
+    BOLT_ASSERT_EQ(0u, engine.stats().reused_tokens);
+
+    // The slot still holds "abcdefghi"; only "z" is new
+    auto response = engine.submit(request("abcdefghiz", 2)).get();
+    BOLT_ASSERT_EQ(std::string("ab"), response.response);
+    BOLT_ASSERT_EQ(9u, engine.stats().reused_tokens);
+    BOLT_ASSERT_EQ(9u, engine.stats().prompt_tokens);
+}
+
+BOLT_TEST(InferenceEngine, DrawKernModelBatchesThroughEngine) {
+    auto engine = std::make_shared<InferenceEngine>(std::make_unique<AlphabetModel>(3), config(3));
+    bolt::drawkern::AIModelConfig model_config;
+    model_config.model_name = "alphabet";
+    model_config.max_tokens = 4;
+    model_config.temperature = 0.0f;
+    EngineAIModel model(engine, model_config);
+    BOLT_ASSERT_TRUE(model.load());
+
+    std::vector<bolt::drawkern::AIInferenceRequest> requests(3);
+    const char* prompts[] = {"abc", "klm", "rst"};
+    const char* tasks[] = {"completion", "chat", "analysis"};
+    for (size_t i = 0; i < requests.size(); ++i) {
+        requests[i].prompt = prompts[i];
+        requests[i].task_type = tasks[i];
+        requests[i].vm_id = "vm" + std::to_string(i);
+    }
+
+    auto responses = model.generate_batch(requests);
+    BOLT_ASSERT_EQ(3u, responses.size());
+    BOLT_ASSERT_EQ(std::string("defg"), responses[0].response);
+    BOLT_ASSERT_EQ(std::string("nopq"), responses[1].response);
+    BOLT_ASSERT_EQ(std::string("uvwx"), responses[2].response);
+    for (size_t i = 0; i < responses.size(); ++i) {
+        BOLT_ASSERT_TRUE(responses[i].success);
+        BOLT_ASSERT_EQ(requests[i].vm_id, responses[i].vm_id);
+    }
+    BOLT_ASSERT_EQ(12u, engine->stats().generated_tokens);
+}
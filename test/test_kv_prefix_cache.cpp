@@ -0,0 +1,78 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/ai/direct_gguf_inference.hpp"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace bolt::ai;
+
+namespace {
+
+std::vector<int32_t> sequence(int32_t first, int32_t last) {
+    std::vector<int32_t> tokens;
+    for (int32_t token = first; token <= last; ++token) {
+        tokens.push_back(token);
+    }
+    return tokens;
+}
+
+} // namespace
+
+BOLT_TEST(KVPrefixCache, DecodesOnlyTheNewSuffix) {
+    KVPrefixCache cache;
+    auto first_turn = sequence(1, 10);
+    BOLT_ASSERT_EQ(0u, cache.reuse(first_turn));
+    cache.append(first_turn.data(), first_turn.size());
+
+    // The next turn extends the cached sequence
+    auto second_turn = sequence(1, 14);
+    size_t keep = cache.reuse(second_turn);
+    BOLT_ASSERT_EQ(10u, keep);
+    cache.append(second_turn.data() + keep, second_turn.size() - keep);
+    BOLT_ASSERT_EQ(14u, cache.size());
+
+    BOLT_ASSERT_EQ(10u, cache.reused_tokens());
+    BOLT_ASSERT_EQ(14u, cache.decoded_tokens());
+}
+
+BOLT_TEST(KVPrefixCache, EvictsPastTheCommonPrefix) {
+    KVPrefixCache cache;
+    auto tokens = sequence(1, 8);
+    cache.append(tokens.data(), tokens.size());
+
+    // A prompt that diverges at position 3 keeps only three tokens
+    std::vector<int32_t> diverging{1, 2, 3, 99, 100};
+    BOLT_ASSERT_EQ(3u, cache.reuse(diverging));
+    BOLT_ASSERT_EQ(3u, cache.size());
+
+    // Repeating the cached sequence still leaves its last token to decode
+    cache.append(diverging.data() + 3, 2);
+    BOLT_ASSERT_EQ(4u, cache.reuse(diverging));
+
+    cache.clear();
+    BOLT_ASSERT_EQ(0u, cache.reuse(diverging));
+}
+
+BOLT_TEST(KVPrefixCache, TracksSessionCaches) {
+    auto directory = std::filesystem::temp_directory_path() / "bolt_kv_prefix_cache_test";
+    std::filesystem::create_directories(directory);
+
+    DirectGGUFInference inference;
+    inference.set_session_directory(directory.string());
+    BOLT_ASSERT_EQ((directory / "a_b_c.kvcache").string(), inference.session_cache_path("a/b c"));
+
+    BOLT_ASSERT_TRUE(inference.switch_session("first"));
+    BOLT_ASSERT_EQ(std::string("first"), inference.active_session());
+    BOLT_ASSERT_TRUE(inference.switch_session("second"));
+    BOLT_ASSERT_EQ(std::string("second"), inference.active_session());
+
+    // Dropping a session deletes its saved cache
+    std::ofstream(inference.session_cache_path("first")) << "state";
+    inference.drop_session("first");
+    BOLT_ASSERT_FALSE(std::filesystem::exists(inference.session_cache_path("first")));
+    inference.drop_session("second");
+    BOLT_ASSERT_TRUE(inference.active_session().empty());
+
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,45 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/collaboration/load_generator.hpp"
+#include "bolt/collaboration/collaboration_protocol.hpp"
+#include <unistd.h>
+#include <chrono>
+#include <iostream>
+
+using namespace bolt::collaboration;
+using namespace std::chrono_literals;
+
+BOLT_TEST(LoadGenerator, SimulatedClientsConverge) {
+    // A handful of fast typists against an in-process server on loopback
+    auto& protocol = CollaborationProtocol::getInstance();
+    int port = 20000 + static_cast<int>(getpid() % 10000);
+    try {
+        protocol.initialize(port);
+    } catch (const std::exception& e) {
+        protocol.shutdown();
+        std::cout << "  Loopback server unavailable (" << e.what() << "), skipped\n";
+        return;
+    }
+
+    LoadTestConfig config;
+    config.port = port;
+    config.clients = 6;
+    config.clientsPerDocument = 3;
+    config.typistsPerLine = 3;  // Everyone types at the same spot
+    config.threads = 2;
+    config.duration = 1500ms;
+    config.medianKeyInterval = 20ms;
+    config.pauseProbability = 0.0;
+    config.setupTimeout = 10000ms;
+    LoadGenerator generator(config);
+    LoadTestReport report = generator.run();
+    protocol.shutdown();
+
+    BOLT_ASSERT_EQ(6u, report.connectedClients);
+    BOLT_ASSERT_TRUE(report.operationsAcknowledged > 0 && report.operationsRejected == 0);
+    BOLT_ASSERT_TRUE(report.propagationLatency.getTotalCount() > 0);
+    BOLT_ASSERT_EQ(6u + 2u, report.joinLatency.getTotalCount());
+
+    // Replicas converge with a fresh join
+    BOLT_ASSERT_TRUE(report.documentsConverged == 2 && report.clientsDiverged == 0);
+    BOLT_ASSERT_TRUE(report.desyncedClients == 0 && report.converged());
+}
@@ -0,0 +1,141 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/network/network_metrics.hpp"
+#include "bolt/network/latency_histogram.hpp"
+#include "bolt/network/websocket_server.hpp"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+
+// ===== Latency Histogram Tests =====
+
+BOLT_TEST(NetworkMetrics, HistogramExactSmallValues) {
+    bolt::LatencyHistogram histogram;
+    for (uint64_t v = 1; v <= 100; ++v) {
+        histogram.record(v);
+    }
+
+    auto snapshot = histogram.snapshot();
+    BOLT_ASSERT_EQ(100u, snapshot.getTotalCount());
+    BOLT_ASSERT_EQ(1u, snapshot.getMin());
+    BOLT_ASSERT_EQ(100u, snapshot.getMax());
+    BOLT_ASSERT_EQ(50u, snapshot.valueAtPercentile(50.0));
+    BOLT_ASSERT_EQ(99u, snapshot.valueAtPercentile(99.0));
+    BOLT_ASSERT_EQ(100u, snapshot.valueAtPercentile(100.0));
+}
+
+BOLT_TEST(NetworkMetrics, HistogramTailPrecision) {
+    bolt::LatencyHistogram histogram;
+    for (int i = 0; i < 9990; ++i) {
+        histogram.record(1000);
+    }
+    for (int i = 0; i < 10; ++i) {
+        histogram.record(250000);
+    }
+
+    auto snapshot = histogram.snapshot();
+    uint64_t p99 = snapshot.valueAtPercentile(99.0);
+    uint64_t p9999 = snapshot.valueAtPercentile(99.99);
+
+    // Bucket error is bounded by 2^-(subBucketBits-1)
+    BOLT_ASSERT_TRUE(p99 >= 1000 && p99 <= 1016);
+    BOLT_ASSERT_TRUE(p9999 >= 246000 && p9999 <= 250000);
+}
+
+BOLT_TEST(NetworkMetrics, HistogramConcurrentRecording) {
+    bolt::LatencyHistogram histogram;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&histogram, t]() {
+            for (int i = 0; i < 1000; ++i) {
+                histogram.record(static_cast<uint64_t>(t * 1000 + i));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto snapshot = histogram.snapshot();
+    BOLT_ASSERT_EQ(8000u, snapshot.getTotalCount());
+    BOLT_ASSERT_EQ(0u, snapshot.getMin());
+    BOLT_ASSERT_EQ(7999u, snapshot.getMax());
+
+    histogram.reset();
+    BOLT_ASSERT_TRUE(histogram.snapshot().empty());
+}
+
+BOLT_TEST(NetworkMetrics, SnapshotMerge) {
+    bolt::LatencyHistogram a;
+    bolt::LatencyHistogram b;
+    a.record(10);
+    b.record(20);
+    b.record(30);
+
+    auto merged = a.snapshot();
+    merged.merge(b.snapshot());
+    BOLT_ASSERT_EQ(3u, merged.getTotalCount());
+    BOLT_ASSERT_EQ(60u, merged.getSum());
+    BOLT_ASSERT_EQ(30u, merged.getMax());
+}
+
+// ===== NetworkMetrics Integration Tests =====
+
+BOLT_TEST(NetworkMetrics, EndpointHistograms) {
+    auto& metrics = bolt::NetworkMetrics::getInstance();
+    metrics.resetAllStats();
+
+    metrics.recordLatency("hist-endpoint", 1500);
+    metrics.recordLatency("hist-endpoint", 2500);
+    metrics.recordFrameSize("hist-endpoint", 512);
+    metrics.recordQueueWait("hist-endpoint", 40);
+    metrics.recordMessageSize("hist-endpoint", 2048);
+
+    auto latency = metrics.getEndpointHistogram("hist-endpoint", bolt::HistogramKind::LATENCY);
+    BOLT_ASSERT_EQ(2u, latency.getTotalCount());
+    BOLT_ASSERT_EQ(1u, metrics.getEndpointHistogram("hist-endpoint", bolt::HistogramKind::FRAME_SIZE).getTotalCount());
+    BOLT_ASSERT_EQ(1u, metrics.getGlobalHistogram(bolt::HistogramKind::QUEUE_WAIT).getTotalCount());
+    // HTTP message sizes stay out of the frame-size distribution
+    BOLT_ASSERT_EQ(2048u, metrics.getEndpointHistogram("hist-endpoint", bolt::HistogramKind::MESSAGE_SIZE).getSum());
+    BOLT_ASSERT_EQ(512u, metrics.getGlobalHistogram(bolt::HistogramKind::FRAME_SIZE).getSum());
+    BOLT_ASSERT_TRUE(metrics.getEndpointHistogram("missing", bolt::HistogramKind::LATENCY).empty());
+
+    // Counters keep working alongside the histograms
+    auto stats = metrics.getEndpointStats("hist-endpoint");
+    BOLT_ASSERT_NOT_NULL(stats.get());
+    BOLT_ASSERT_EQ(2u, stats->latencySamples.load());
+}
+
+BOLT_TEST(NetworkMetrics, WebSocketSendRecordsFrames) {
+    auto& metrics = bolt::NetworkMetrics::getInstance();
+    metrics.resetAllStats();
+
+    int fds[2];
+    BOLT_ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    bolt::WebSocketConnection conn(fds[0]);
+    conn.send("hello");
+    conn.send(std::string(300, 'x'));
+    conn.close();
+    ::close(fds[1]);
+
+    auto frames = metrics.getEndpointHistogram("websocket", bolt::HistogramKind::FRAME_SIZE);
+    BOLT_ASSERT_EQ(2u, frames.getTotalCount());
+    BOLT_ASSERT_EQ(305u, frames.getSum());
+    BOLT_ASSERT_EQ(2u, metrics.getEndpointHistogram("websocket", bolt::HistogramKind::QUEUE_WAIT).getTotalCount());
+}
+
+BOLT_TEST(NetworkMetrics, OpenMetricsExposition) {
+    auto& metrics = bolt::NetworkMetrics::getInstance();
+    metrics.resetAllStats();
+
+    metrics.recordDataSent("ws\"main", 1024);
+    metrics.recordLatency("ws\"main", 800);
+
+    std::string text = metrics.generateOpenMetrics(false);
+    BOLT_ASSERT_TRUE(text.find("# TYPE bolt_network_sent_bytes counter") != std::string::npos);
+    BOLT_ASSERT_TRUE(text.find("bolt_network_sent_bytes_total{endpoint=\"ws\\\"main\"} 1024") != std::string::npos);
+    BOLT_ASSERT_TRUE(text.find("# TYPE bolt_network_latency_microseconds summary") != std::string::npos);
+    BOLT_ASSERT_TRUE(text.find("quantile=\"0.999\"") != std::string::npos);
+    BOLT_ASSERT_TRUE(text.find("bolt_profiler_metrics") == std::string::npos);
+    BOLT_ASSERT_TRUE(text.size() >= 6 && text.compare(text.size() - 6, 6, "# EOF\n") == 0);
+}
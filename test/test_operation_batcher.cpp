@@ -0,0 +1,96 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/collaboration/operation_batcher.hpp"
+#include "bolt/collaboration/collaborative_session.hpp"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace bolt::collaboration;
+
+namespace {
+
+// Fast typing, a typo fixed with backspace, then more typing
+std::vector<DocumentOperation> typingBurst() {
+    std::vector<DocumentOperation> keystrokes;
+    std::string typed = "hello wrld";
+    for (size_t i = 0; i < typed.size(); ++i) {
+        keystrokes.emplace_back(OperationType::INSERT, "typist", Position(0, 3 + i), std::string(1, typed[i]));
+    }
+    keystrokes.emplace_back(OperationType::DELETE, "typist", Position(0, 12), "d");
+    keystrokes.emplace_back(OperationType::DELETE, "typist", Position(0, 11), "l");
+    keystrokes.emplace_back(OperationType::DELETE, "typist", Position(0, 10), "r");
+    keystrokes.emplace_back(OperationType::INSERT, "typist", Position(0, 10), "orld");
+    return keystrokes;
+}
+
+} // namespace
+
+BOLT_TEST(OperationBatcher, KeystrokesComposeIntoOneOperation) {
+    OperationBatcher batcher(std::chrono::hours(1));
+    auto keystrokes = typingBurst();
+    for (const auto& op : keystrokes) {
+        batcher.add("batch_doc", op);
+    }
+    for (size_t i = 0; i < 50; ++i) {
+        batcher.add("batch_doc", DocumentOperation(OperationType::CURSOR_MOVE, "typist", Position(0, i)));
+    }
+
+    // Nothing is due before the window elapses
+    BOLT_ASSERT_TRUE(batcher.takeDue().empty());
+    auto batches = batcher.takeDue(std::chrono::steady_clock::now() + std::chrono::hours(2));
+    BOLT_ASSERT_TRUE(batches.size() == 1 && batcher.empty());
+    BOLT_ASSERT_EQ(1u, batches[0].operations.size());
+    BOLT_ASSERT_EQ("hello world", batches[0].operations[0].getContent());
+    BOLT_ASSERT_EQ(1u, batches[0].cursors.size());
+    BOLT_ASSERT_TRUE(batches[0].cursors[0].getPosition() == Position(0, 49));
+
+    // The composed operation has the same effect as the individual keystrokes
+    auto& session = CollaborativeSession::getInstance();
+    session.createDocument("batch_individual", "abc\ndef");
+    session.createDocument("batch_composed", "abc\ndef");
+    for (const auto& op : keystrokes) {
+        session.applyOperation(op, "batch_individual");
+    }
+    session.applyOperation(batches[0].operations[0], "batch_composed");
+    BOLT_ASSERT_EQ(session.getDocumentContent("batch_composed"), session.getDocumentContent("batch_individual"));
+    session.removeDocument("batch_individual");
+    session.removeDocument("batch_composed");
+}
+
+BOLT_TEST(OperationBatcher, CompositionRules) {
+    // Forward deletes merge; other users, other lines and other revisions don't
+    DocumentOperation forward(OperationType::DELETE, "u1", Position(2, 3), "a");
+    BOLT_ASSERT_TRUE(OperationBatcher::compose(forward, DocumentOperation(OperationType::DELETE, "u1", Position(2, 3), "b")));
+    BOLT_ASSERT_EQ("ab", forward.getContent());
+    DocumentOperation mine(OperationType::INSERT, "u1", Position(0, 0), "x");
+    BOLT_ASSERT_FALSE(OperationBatcher::compose(mine, DocumentOperation(OperationType::INSERT, "u2", Position(0, 1), "y")));
+    BOLT_ASSERT_FALSE(OperationBatcher::compose(mine, DocumentOperation(OperationType::INSERT, "u1", Position(1, 0), "y")));
+    BOLT_ASSERT_FALSE(OperationBatcher::compose(mine, DocumentOperation(OperationType::INSERT, "u1", Position(0, 1), "y", 3)));
+    BOLT_ASSERT_FALSE(OperationBatcher::compose(mine, DocumentOperation(OperationType::INSERT, "u1", Position(0, 1), "\n")));
+
+    // Interleaved users keep their order
+    OperationBatcher batcher(std::chrono::hours(1));
+    batcher.add("order_doc", DocumentOperation(OperationType::INSERT, "u1", Position(0, 0), "a"));
+    batcher.add("order_doc", DocumentOperation(OperationType::INSERT, "u2", Position(0, 1), "b"));
+    batcher.add("order_doc", DocumentOperation(OperationType::INSERT, "u1", Position(0, 1), "c"));
+    auto ordered = batcher.takeAll();
+    BOLT_ASSERT_EQ(3u, ordered[0].operations.size());
+}
+
+BOLT_TEST(OperationBatcher, FlushSchedulerRunsAfterInterval) {
+    // The scheduler flushes one interval after work is scheduled
+    std::atomic<int> flushes{0};
+    {
+        FlushScheduler scheduler;
+        scheduler.start(std::chrono::milliseconds(2), [&]() { flushes++; });
+        scheduler.schedule();
+        scheduler.schedule();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (flushes == 0 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    BOLT_ASSERT_TRUE(flushes >= 1);
+}
@@ -0,0 +1,101 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/collaboration/sequence_crdt.hpp"
+#include "bolt/collaboration/collaborative_session.hpp"
+#include <string>
+#include <vector>
+
+using namespace bolt::collaboration;
+
+BOLT_TEST(SequenceCRDT, ConcurrentEditsConverge) {
+    // Concurrent inserts at the same spot converge regardless of delivery order
+    SequenceCRDT alice(1), bob(2), carol(3);
+    std::vector<uint8_t> base;
+    BOLT_ASSERT_TRUE(alice.insert(0, "hello world", &base));
+    BOLT_ASSERT_TRUE(bob.applyUpdate(base) && carol.applyUpdate(base));
+
+    std::vector<uint8_t> fromAlice, fromBob, fromCarol;
+    BOLT_ASSERT_TRUE(alice.insert(5, " there", &fromAlice) && bob.insert(5, ",", &fromBob) &&
+                     carol.erase(0, 1, &fromCarol));
+
+    BOLT_ASSERT_TRUE(alice.applyUpdate(fromBob) && alice.applyUpdate(fromCarol) &&
+                     bob.applyUpdate(fromCarol) && bob.applyUpdate(fromAlice) &&
+                     carol.applyUpdate(fromAlice) && carol.applyUpdate(fromBob));
+    BOLT_ASSERT_EQ(bob.toString(), alice.toString());
+    BOLT_ASSERT_EQ(carol.toString(), bob.toString());
+    BOLT_ASSERT_TRUE(alice.toString() == "ello, there world" || alice.toString() == "ello there, world");
+}
+
+BOLT_TEST(SequenceCRDT, OutOfOrderDeliveryIsHeldBack) {
+    SequenceCRDT late(4);
+    std::vector<uint8_t> first, second;
+    SequenceCRDT writer(5);
+    BOLT_ASSERT_TRUE(writer.insert(0, "ab", &first) && writer.insert(1, "X", &second));
+
+    BOLT_ASSERT_TRUE(late.applyUpdate(second));
+    BOLT_ASSERT_TRUE(late.hasPendingUpdates() && late.length() == 0);
+    BOLT_ASSERT_TRUE(late.applyUpdate(first));
+    BOLT_ASSERT_TRUE(!late.hasPendingUpdates() && late.toString() == "aXb");
+}
+
+BOLT_TEST(SequenceCRDT, StateVectorDeltaSync) {
+    SequenceCRDT alice(1);
+    BOLT_ASSERT_TRUE(alice.insert(0, "hello world"));
+
+    // Offline catch-up ships only what the peer's state vector is missing
+    SequenceCRDT offline(6);
+    BOLT_ASSERT_TRUE(offline.applyUpdate(alice.encodeStateAsUpdate()));
+    std::vector<uint8_t> offlineState = offline.encodeStateVector();
+    BOLT_ASSERT_TRUE(alice.insert(alice.length(), "!\nsecond line"));
+
+    SequenceCRDT::StateVector remote;
+    BOLT_ASSERT_TRUE(SequenceCRDT::decodeStateVector(offlineState, remote));
+    std::vector<uint8_t> delta = alice.encodeStateAsUpdate(remote);
+    BOLT_ASSERT_TRUE(delta.size() < alice.encodeStateAsUpdate().size());
+    BOLT_ASSERT_TRUE(offline.applyUpdate(delta));
+    BOLT_ASSERT_EQ(alice.toString(), offline.toString());
+    BOLT_ASSERT_TRUE(offline.lineCount() == 2 && offline.lineLength(1) == 11);
+}
+
+BOLT_TEST(SequenceCRDT, RunLengthEncodingAndMalformedInput) {
+    // Sequential typing stays one run-length encoded item
+    SequenceCRDT typist(7);
+    for (int i = 0; i < 500; ++i) {
+        BOLT_ASSERT_TRUE(typist.insert(typist.length(), "x"));
+    }
+    BOLT_ASSERT_EQ(1u, typist.itemCount());
+
+    std::vector<uint8_t> malformed = {3, 1};
+    BOLT_ASSERT_FALSE(typist.applyUpdate(malformed));
+}
+
+BOLT_TEST(SequenceCRDT, SessionDocumentBackend) {
+    // Session documents can opt into the CRDT backend per document
+    auto& session = CollaborativeSession::getInstance();
+    std::vector<std::vector<uint8_t>> relayed;
+    session.onDocumentUpdate([&](const std::vector<uint8_t>& update, const std::string&) {
+        relayed.push_back(update);
+    });
+    BOLT_ASSERT_TRUE(session.createDocument("crdt_test", "line one\nline two", DocumentBackend::SEQUENCE_CRDT));
+    BOLT_ASSERT_TRUE(session.getDocumentBackend("crdt_test") == DocumentBackend::SEQUENCE_CRDT);
+    session.joinDocument("userA", "User A", "crdt_test");
+
+    BOLT_ASSERT_TRUE(session.applyOperation(DocumentOperation(OperationType::INSERT, "userA", Position(1, 5), "2:"), "crdt_test"));
+    BOLT_ASSERT_TRUE(session.applyOperation(DocumentOperation(OperationType::DELETE, "userA", Position(0, 0), "line "), "crdt_test"));
+    BOLT_ASSERT_EQ("one\nline 2:two", session.getDocumentContent("crdt_test"));
+    BOLT_ASSERT_EQ(2u, session.getDocumentLines("crdt_test").size());
+    BOLT_ASSERT_EQ(2u, relayed.size());
+
+    // A remote replica catches up from the session and sends an edit back
+    SequenceCRDT replica(8);
+    BOLT_ASSERT_TRUE(replica.applyUpdate(session.encodeStateAsUpdate("crdt_test")));
+    BOLT_ASSERT_EQ("one\nline 2:two", replica.toString());
+    std::vector<uint8_t> replicaEdit;
+    BOLT_ASSERT_TRUE(replica.insert(0, ">", &replicaEdit));
+    BOLT_ASSERT_TRUE(session.applyUpdate("crdt_test", replicaEdit));
+    BOLT_ASSERT_EQ(">one\nline 2:two", session.getDocumentContent("crdt_test"));
+    BOLT_ASSERT_EQ(3u, session.getDocumentRevision("crdt_test"));
+    BOLT_ASSERT_FALSE(session.applyUpdate("missing_doc", replicaEdit));
+
+    session.onDocumentUpdate(nullptr);
+    session.removeDocument("crdt_test");
+}
@@ -0,0 +1,133 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/ai/speculative_decoder.hpp"
+#include <cstdint>
+#include <vector>
+
+using namespace bolt::ai;
+
+namespace {
+
+const size_t VOCAB = 32;
+
+// Predicts last + 1, except that every `wrong_every`-th token it predicts
+// last + 2 instead
+class CountingModel : public SpeculativeModel {
+public:
+    explicit CountingModel(int32_t wrong_every = 0) : wrong_every_(wrong_every) {}
+
+    size_t n_vocab() const override { return VOCAB; }
+    size_t length() const override { return sequence_.size(); }
+
+    bool decode(const int32_t* tokens, size_t count, size_t logits_from) override {
+        ++passes;
+        rows_.clear();
+        for (size_t i = 0; i < count; ++i) {
+            sequence_.push_back(tokens[i]);
+            if (i >= logits_from) {
+                std::vector<float> row(VOCAB, 0.0f);
+                row[next(tokens[i])] = 10.0f;
+                rows_.push_back(row);
+            }
+        }
+        return true;
+    }
+
+    float* logits(size_t i) override { return rows_[i].data(); }
+    void truncate(size_t length) override { sequence_.resize(std::min(length, sequence_.size())); }
+
+    const std::vector<int32_t>& sequence() const { return sequence_; }
+    size_t passes = 0;
+
+private:
+    int32_t wrong_every_;
+    std::vector<int32_t> sequence_;
+    std::vector<std::vector<float>> rows_;
+
+    int32_t next(int32_t token) const {
+        bool wrong = wrong_every_ > 0 && (token + 1) % wrong_every_ == 0;
+        return (token + (wrong ? 2 : 1)) % static_cast<int32_t>(VOCAB);
+    }
+};
+
+SamplerParams greedy() {
+    SamplerParams params;
+    params.temperature = 0.0f;
+    params.repeat_penalty = 1.0f;
+    return params;
+}
+
+std::vector<int32_t> counting(int32_t first, int32_t count) {
+    std::vector<int32_t> tokens;
+    for (int32_t i = 0; i < count; ++i) {
+        tokens.push_back((first + i) % static_cast<int32_t>(VOCAB));
+    }
+    return tokens;
+}
+
+} // namespace
+
+BOLT_TEST(SpeculativeDecoder, PerfectDraftCutsTargetPasses) {
+    CountingModel target;
+    CountingModel draft;
+    TokenSampler sampler(greedy());
+    SpeculativeDecoder decoder(target, draft, sampler, 4);
+
+    std::vector<int32_t> tokens{0, 1, 2};
+    BOLT_ASSERT_EQ(20u, decoder.generate(tokens, 20, -1, nullptr));
+    BOLT_ASSERT_TRUE(counting(0, 23) == tokens);
+
+    // Four proposals and the target's own token per pass
+    BOLT_ASSERT_EQ(4u, decoder.stats().rounds);
+    BOLT_ASSERT_EQ(4u, target.passes);
+    BOLT_ASSERT_EQ(1.0f, decoder.stats().acceptance_rate());
+    BOLT_ASSERT_EQ(5.0f, decoder.stats().tokens_per_round());
+}
+
+BOLT_TEST(SpeculativeDecoder, OutputMatchesPlainDecoding) {
+    // The draft goes wrong every third token
+    CountingModel target;
+    CountingModel draft(3);
+    TokenSampler sampler(greedy());
+    SpeculativeDecoder decoder(target, draft, sampler, 4);
+    std::vector<int32_t> tokens{5};
+    decoder.generate(tokens, 25, -1, nullptr);
+
+    CountingModel plain_target;
+    CountingModel unused;
+    TokenSampler plain_sampler(greedy());
+    SpeculativeDecoder plain(plain_target, unused, plain_sampler, 0);
+    std::vector<int32_t> expected{5};
+    plain.generate(expected, 25, -1, nullptr);
+
+    BOLT_ASSERT_TRUE(expected == tokens);
+    BOLT_ASSERT_EQ(25u, plain.stats().rounds);
+    BOLT_ASSERT_EQ(0u, unused.passes);
+    BOLT_ASSERT_TRUE(decoder.stats().rounds < plain.stats().rounds);
+    BOLT_ASSERT_TRUE(decoder.stats().acceptance_rate() > 0.0f);
+    BOLT_ASSERT_TRUE(decoder.stats().acceptance_rate() < 1.0f);
+
+    // Rejected proposals were cut from both models
+    std::vector<int32_t> decoded(tokens.begin(), tokens.begin() + target.length());
+    BOLT_ASSERT_TRUE(decoded == target.sequence());
+    BOLT_ASSERT_TRUE(draft.length() < tokens.size());
+    std::vector<int32_t> drafted(tokens.begin(), tokens.begin() + draft.length());
+    BOLT_ASSERT_TRUE(drafted == draft.sequence());
+}
+
+BOLT_TEST(SpeculativeDecoder, StopsAtEosAndWhenTold) {
+    CountingModel target;
+    CountingModel draft;
+    TokenSampler sampler(greedy());
+    SpeculativeDecoder decoder(target, draft, sampler, 8);
+
+    // End of sequence is never emitted
+    std::vector<int32_t> tokens{0};
+    BOLT_ASSERT_EQ(5u, decoder.generate(tokens, 50, 6, nullptr));
+    BOLT_ASSERT_TRUE(counting(0, 6) == tokens);
+
+    // The handler can stop generation part-way through a pass
+    std::vector<int32_t> more{10};
+    size_t seen = 0;
+    BOLT_ASSERT_EQ(3u, decoder.generate(more, 50, -1, [&](int32_t) { return ++seen < 3; }));
+    BOLT_ASSERT_TRUE(counting(10, 4) == more);
+}
@@ -0,0 +1,340 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/drawkern/styx_protocol.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <future>
+#include <map>
+#include <string>
+#include <thread>
+
+using namespace bolt::drawkern;
+
+namespace {
+
+// Runs a server on an ephemeral port for the duration of a test
+class ServerFixture {
+public:
+    ServerFixture() : server("localhost:0", 4) {
+        server.serve_file("/glyphs/hello", "hello, styx");
+        server.serve_file("/glyphs/big", std::string(20000, 'x'));
+        server.serve_file("/status", "running");
+        started = server.start();
+        if (started) {
+            thread = std::thread([this] { server.run(); });
+        }
+    }
+
+    ~ServerFixture() {
+        server.stop();
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    std::string address() const { return "localhost:" + std::to_string(server.port()); }
+
+    StyxServer server;
+    bool started = false;
+    std::thread thread;
+};
+
+void put_uint(std::vector<uint8_t>& data, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        data.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+std::vector<uint8_t> frame(StyxMessageType type, uint16_t tag, const std::vector<uint8_t>& data) {
+    StyxMessage message;
+    message.type = type;
+    message.tag = tag;
+    message.data = data;
+    message.size = static_cast<uint32_t>(data.size() + 7);
+    std::vector<uint8_t> buffer;
+    message.serialize(buffer);
+    return buffer;
+}
+
+bool read_exact(int fd, uint8_t* data, size_t length) {
+    while (length > 0) {
+        ssize_t bytes = recv(fd, data, length, 0);
+        if (bytes <= 0) {
+            return false;
+        }
+        data += bytes;
+        length -= static_cast<size_t>(bytes);
+    }
+    return true;
+}
+
+StyxMessage receive(int fd) {
+    uint8_t size_field[4];
+    if (!read_exact(fd, size_field, 4)) {
+        return StyxMessage();
+    }
+    uint32_t size = size_field[0] | (size_field[1] << 8) | (size_field[2] << 16) | (size_field[3] << 24);
+    std::vector<uint8_t> buffer(size);
+    std::copy(size_field, size_field + 4, buffer.begin());
+    if (size < 7 || !read_exact(fd, buffer.data() + 4, size - 4)) {
+        return StyxMessage();
+    }
+    return StyxMessage::deserialize(buffer);
+}
+
+} // namespace
+
+BOLT_TEST(Styx, FileOperations) {
+    ServerFixture fixture;
+    BOLT_ASSERT_TRUE(fixture.started);
+
+    StyxConnection client(fixture.address());
+    BOLT_ASSERT_TRUE(client.connect());
+    BOLT_ASSERT_TRUE(client.version("9P2000", 8192));
+    BOLT_ASSERT_EQ(8192u, client.msize());
+    BOLT_ASSERT_TRUE(client.attach());
+    uint32_t root = client.root_fid();
+
+    // Walks bind the new fid only when every name resolves
+    BOLT_ASSERT_EQ(2u, client.walk(root, 10, {"glyphs", "hello"}));
+    BOLT_ASSERT_EQ(1u, client.walk(root, 11, {"glyphs", "missing"}));
+    BOLT_ASSERT_EQ(~0u, client.walk(root, 11, {"missing"}));
+    BOLT_ASSERT_EQ(~0u, client.walk(root, 10, {"status"}));
+    BOLT_ASSERT_FALSE(client.clunk(11));
+
+    // Reads need an open fid and respect offset and count
+    BOLT_ASSERT_TRUE(client.read(10, 0, 100).empty());
+    BOLT_ASSERT_TRUE(client.open(10, 2) != ~0u);
+    auto data = client.read(10, 0, 100);
+    BOLT_ASSERT_EQ(std::string("hello, styx"), std::string(data.begin(), data.end()));
+    data = client.read(10, 7, 3);
+    BOLT_ASSERT_EQ(std::string("sty"), std::string(data.begin(), data.end()));
+    BOLT_ASSERT_TRUE(client.read(10, 100, 10).empty());
+
+    // Reads larger than the negotiated msize are split and reassembled
+    BOLT_ASSERT_EQ(1u, client.walk(root, 12, {"glyphs"}));
+    BOLT_ASSERT_EQ(1u, client.walk(12, 13, {"big"}));
+    BOLT_ASSERT_TRUE(client.open(13, 0) != ~0u);
+    size_t total = 0;
+    for (auto chunk = client.read(13, 0, 16384); !chunk.empty(); chunk = client.read(13, total, 16384)) {
+        BOLT_ASSERT_TRUE(chunk.size() <= 16384);
+        total += chunk.size();
+    }
+    BOLT_ASSERT_EQ(20000u, total);
+
+    // Writes replace the content seen by later reads and by the server
+    std::string update = "HELLO";
+    BOLT_ASSERT_EQ(5u, client.write(10, 0, std::vector<uint8_t>(update.begin(), update.end())));
+    data = client.read(10, 0, 100);
+    BOLT_ASSERT_EQ(std::string("HELLO, styx"), std::string(data.begin(), data.end()));
+    BOLT_ASSERT_EQ(std::string("HELLO, styx"), *fixture.server.file_content("/glyphs/hello"));
+    BOLT_ASSERT_EQ(0u, client.write(13, 0, std::vector<uint8_t>(update.begin(), update.end())));
+
+    // Directories list their children as stat records
+    BOLT_ASSERT_TRUE(client.open(12, 0) != ~0u);
+    auto listing = client.read(12, 0, 4096);
+    std::string text(listing.begin(), listing.end());
+    BOLT_ASSERT_TRUE(text.find("hello") != std::string::npos);
+    BOLT_ASSERT_TRUE(text.find("big") != std::string::npos);
+    BOLT_ASSERT_TRUE(client.read(12, listing.size(), 4096).empty());
+
+    BOLT_ASSERT_TRUE(client.clunk(10));
+    BOLT_ASSERT_FALSE(client.clunk(10));
+    BOLT_ASSERT_TRUE(client.send_glyph("circle"));
+    BOLT_ASSERT_TRUE(client.spawn_vm("echo"));
+}
+
+BOLT_TEST(Styx, WriteBeyondMaxFileSize) {
+    ServerFixture fixture;
+    BOLT_ASSERT_TRUE(fixture.started);
+
+    StyxConnection client(fixture.address());
+    BOLT_ASSERT_TRUE(client.connect());
+    BOLT_ASSERT_TRUE(client.version("9P2000", 8192));
+    BOLT_ASSERT_TRUE(client.attach());
+    BOLT_ASSERT_EQ(2u, client.walk(client.root_fid(), 10, {"glyphs", "hello"}));
+    BOLT_ASSERT_TRUE(client.open(10, 2) != ~0u);
+
+    // offset + count wraps around; the write must be refused, not performed
+    std::vector<uint8_t> byte = {'!'};
+    BOLT_ASSERT_EQ(0u, client.write(10, ~0ull, byte));
+    BOLT_ASSERT_EQ(0u, client.write(10, ~0ull - 1024, std::vector<uint8_t>(2048, 'x')));
+    BOLT_ASSERT_EQ(std::string("hello, styx"), *fixture.server.file_content("/glyphs/hello"));
+
+    // The connection is still usable afterwards
+    BOLT_ASSERT_EQ(1u, client.write(10, 0, byte));
+    BOLT_ASSERT_EQ(std::string("!ello, styx"), *fixture.server.file_content("/glyphs/hello"));
+}
+
+BOLT_TEST(Styx, PipelinedTags) {
+    std::atomic<int> glyphs{0};
+    ServerFixture fixture;
+    BOLT_ASSERT_TRUE(fixture.started);
+    fixture.server.register_glyph_handler([&glyphs](const std::string&) { glyphs++; });
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(fixture.server.port());
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    BOLT_ASSERT_EQ(0, connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+
+    // Open a fid on /status before pipelining reads of it
+    std::vector<uint8_t> data;
+    put_uint(data, 8192, 4);
+    put_uint(data, 6, 2);
+    data.insert(data.end(), {'9', 'P', '2', '0', '0', '0'});
+    auto message = frame(StyxMessageType::Tversion, 0xFFFF, data);
+    BOLT_ASSERT_EQ(static_cast<ssize_t>(message.size()), send(fd, message.data(), message.size(), 0));
+    BOLT_ASSERT_EQ(static_cast<int>(StyxMessageType::Rversion), static_cast<int>(receive(fd).type));
+
+    data.clear();
+    put_uint(data, 1, 4);
+    put_uint(data, ~0u, 4);
+    put_uint(data, 0, 2);
+    put_uint(data, 0, 2);
+    message = frame(StyxMessageType::Tattach, 1, data);
+    send(fd, message.data(), message.size(), 0);
+    BOLT_ASSERT_EQ(static_cast<int>(StyxMessageType::Rattach), static_cast<int>(receive(fd).type));
+
+    data.clear();
+    put_uint(data, 1, 4);
+    put_uint(data, 2, 4);
+    put_uint(data, 1, 2);
+    put_uint(data, 6, 2);
+    data.insert(data.end(), {'s', 't', 'a', 't', 'u', 's'});
+    message = frame(StyxMessageType::Twalk, 1, data);
+    send(fd, message.data(), message.size(), 0);
+    BOLT_ASSERT_EQ(static_cast<int>(StyxMessageType::Rwalk), static_cast<int>(receive(fd).type));
+
+    data.clear();
+    put_uint(data, 2, 4);
+    put_uint(data, 0, 1);
+    message = frame(StyxMessageType::Topen, 1, data);
+    send(fd, message.data(), message.size(), 0);
+    BOLT_ASSERT_EQ(static_cast<int>(StyxMessageType::Ropen), static_cast<int>(receive(fd).type));
+
+    // Many outstanding tags in one write; every tag gets exactly one reply
+    const uint16_t requests = 200;
+    std::vector<uint8_t> batch;
+    for (uint16_t tag = 10; tag < 10 + requests; ++tag) {
+        data.clear();
+        if (tag % 2 == 0) {
+            put_uint(data, 2, 4);
+            put_uint(data, 0, 8);
+            put_uint(data, 100, 4);
+            message = frame(StyxMessageType::Tread, tag, data);
+        } else {
+            put_uint(data, 1, 2);
+            data.push_back('g');
+            message = frame(StyxMessageType::Tglyph, tag, data);
+        }
+        batch.insert(batch.end(), message.begin(), message.end());
+    }
+    BOLT_ASSERT_EQ(static_cast<ssize_t>(batch.size()), send(fd, batch.data(), batch.size(), 0));
+
+    std::map<uint16_t, StyxMessage> replies;
+    for (uint16_t i = 0; i < requests; ++i) {
+        StyxMessage reply = receive(fd);
+        BOLT_ASSERT_TRUE(reply.size > 0);
+        replies[reply.tag] = reply;
+    }
+    BOLT_ASSERT_EQ(static_cast<size_t>(requests), replies.size());
+    for (auto& [tag, reply] : replies) {
+        if (tag % 2 == 0) {
+            BOLT_ASSERT_EQ(static_cast<int>(StyxMessageType::Rread), static_cast<int>(reply.type));
+            BOLT_ASSERT_EQ(std::string("running"), std::string(reply.data.begin() + 4, reply.data.end()));
+        } else {
+            BOLT_ASSERT_EQ(static_cast<int>(StyxMessageType::Rglyph), static_cast<int>(reply.type));
+        }
+    }
+    BOLT_ASSERT_EQ(requests / 2, glyphs.load());
+
+    // Unknown fids are errors, not dropped connections
+    data.clear();
+    put_uint(data, 99, 4);
+    message = frame(StyxMessageType::Tclunk, 5, data);
+    send(fd, message.data(), message.size(), 0);
+    StyxMessage error = receive(fd);
+    BOLT_ASSERT_EQ(static_cast<int>(StyxMessageType::Rerror), static_cast<int>(error.type));
+    BOLT_ASSERT_EQ(5, error.tag);
+
+    close(fd);
+}
+
+BOLT_TEST(Styx, ClientPipelining) {
+    ServerFixture fixture;
+    BOLT_ASSERT_TRUE(fixture.started);
+    std::string content(300000, '\0');
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = static_cast<char>(i * 31 + i / 7);
+    }
+    fixture.server.serve_file("/data/source", content);
+    fixture.server.serve_file("/data/copy", "");
+
+    StyxConnection client(fixture.address(), 8);
+    BOLT_ASSERT_TRUE(client.connect());
+    BOLT_ASSERT_TRUE(client.version("9P2000", 8192));
+    BOLT_ASSERT_TRUE(client.attach());
+    BOLT_ASSERT_EQ(2u, client.walk(client.root_fid(), 2, {"data", "source"}));
+    BOLT_ASSERT_EQ(2u, client.walk(client.root_fid(), 3, {"data", "copy"}));
+    BOLT_ASSERT_TRUE(client.open(2, 0) != ~0u);
+    BOLT_ASSERT_TRUE(client.open(3, 1) != ~0u);
+
+    auto stat = client.stat(2);
+    BOLT_ASSERT_TRUE(stat.has_value());
+    BOLT_ASSERT_EQ(std::string("source"), stat->name);
+    BOLT_ASSERT_EQ(static_cast<uint64_t>(content.size()), stat->length);
+
+    // One call moves the whole file through many more requests than there are tags
+    std::vector<uint8_t> buffer(stat->length + 100);
+    BOLT_ASSERT_EQ(content.size(), client.read(2, 0, buffer.data(), buffer.size()));
+    BOLT_ASSERT_TRUE(content == std::string(buffer.begin(), buffer.begin() + content.size()));
+    BOLT_ASSERT_EQ(content.size(), client.write(3, 0, buffer.data(), content.size()));
+    BOLT_ASSERT_EQ(content, *fixture.server.file_content("/data/copy"));
+
+    // Futures and callbacks complete out of order, matched by tag
+    uint8_t parts[4][100];
+    std::vector<std::future<size_t>> reads;
+    for (int i = 0; i < 4; ++i) {
+        reads.push_back(client.read_async(2, 1000 * i, parts[i], 100));
+    }
+    std::promise<StyxMessageType> clunked;
+    StyxMessage message;
+    message.type = StyxMessageType::Tclunk;
+    message.data = {99, 0, 0, 0};
+    message.size = 11;
+    client.send_async(message, [&clunked](StyxMessage reply) { clunked.set_value(reply.type); });
+    for (int i = 0; i < 4; ++i) {
+        BOLT_ASSERT_EQ(100u, reads[i].get());
+        BOLT_ASSERT_EQ(content.substr(1000 * i, 100), std::string(parts[i], parts[i] + 100));
+    }
+    BOLT_ASSERT_EQ(static_cast<int>(StyxMessageType::Rerror), static_cast<int>(clunked.get_future().get()));
+
+    // Threads can share the connection
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&client, &content, &mismatches, t] {
+            for (int i = 0; i < 25; ++i) {
+                size_t offset = static_cast<size_t>(t * 25 + i) * 2000;
+                auto data = client.read(2, offset, 3000);
+                if (std::string(data.begin(), data.end()) != content.substr(offset, 3000)) {
+                    mismatches++;
+                }
+            }
+        });
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    BOLT_ASSERT_EQ(0, mismatches.load());
+
+    // Requests after the connection drops fail instead of blocking
+    client.disconnect();
+    BOLT_ASSERT_FALSE(client.is_connected());
+    BOLT_ASSERT_EQ(static_cast<int>(StyxMessageType::Terror),
+                   static_cast<int>(client.send_async(message).get().type));
+}
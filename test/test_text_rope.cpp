@@ -0,0 +1,87 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/collaboration/text_rope.hpp"
+#include "bolt/collaboration/document_operation.hpp"
+#include <algorithm>
+#include <string>
+
+using namespace bolt::collaboration;
+
+BOLT_TEST(TextRope, LineIndex) {
+    TextRope text("alpha\nbeta\ngamma");
+    BOLT_ASSERT_EQ(3u, text.lineCount());
+    BOLT_ASSERT_TRUE(text.lineStart(2) == 11 && text.lineLength(1) == 4);
+    BOLT_ASSERT_EQ("gamma", text.line(2));
+    BOLT_ASSERT_TRUE(text.lineOf(6) == 1 && text.lineOf(5) == 0);
+    BOLT_ASSERT_TRUE(Position(1, 2).toLinear(text) == 8);
+    BOLT_ASSERT_TRUE(Position::fromLinear(12, text) == Position(2, 1));
+}
+
+BOLT_TEST(TextRope, MultiLineEdits) {
+    TextRope text("alpha\nbeta\ngamma");
+
+    // Inserted newlines split lines and deletes may join them
+    BOLT_ASSERT_TRUE(DocumentOperation(OperationType::INSERT, "u", Position(1, 2), "\nnew\n").apply(text));
+    BOLT_ASSERT_EQ("alpha\nbe\nnew\nta\ngamma", text.toString());
+    BOLT_ASSERT_EQ(5u, text.lineCount());
+    BOLT_ASSERT_TRUE(DocumentOperation(OperationType::DELETE, "u", Position(0, 5), "\nbe\nnew\n").apply(text));
+    BOLT_ASSERT_EQ("alphata\ngamma", text.toString());
+}
+
+BOLT_TEST(TextRope, StrictPositionValidation) {
+    TextRope text("alphata\ngamma");
+
+    // Positions are validated instead of padded or clamped
+    BOLT_ASSERT_FALSE(DocumentOperation(OperationType::INSERT, "u", Position(0, 8), "x").apply(text));
+    BOLT_ASSERT_FALSE(DocumentOperation(OperationType::INSERT, "u", Position(2, 0), "x").apply(text));
+    BOLT_ASSERT_FALSE(DocumentOperation(OperationType::DELETE, "u", Position(1, 3), "mma!").apply(text));
+    BOLT_ASSERT_TRUE(DocumentOperation(OperationType::INSERT, "u", Position(1, 5), "!").apply(text));
+    BOLT_ASSERT_EQ("alphata\ngamma!", text.toString());
+}
+
+BOLT_TEST(TextRope, EditBurstOnLargeDocument) {
+    // A 10k edit burst on a 100k line document
+    std::string large;
+    for (int i = 0; i < 100000; ++i) {
+        large += "line " + std::to_string(i) + "\n";
+    }
+    TextRope document(large);
+    for (size_t i = 0; i < 10000; ++i) {
+        size_t line = (i * 7919) % 100000;
+        DocumentOperation op(i % 4 == 3 ? OperationType::DELETE : OperationType::INSERT, "u", Position(line, 2), "xy");
+        op.apply(document);
+    }
+    BOLT_ASSERT_EQ(100001u, document.lineCount());
+    BOLT_ASSERT_EQ(large.length() + 2 * 5000, document.length());
+}
+
+BOLT_TEST(TextRope, DeletesDoNotFragmentTheTree) {
+    std::string large;
+    for (int i = 0; i < 5000; ++i) {
+        large += "line " + std::to_string(i) + "\n";
+    }
+    TextRope text(large);
+    std::string expected = large;
+
+    // Backspace through the middle of the document one character at a time
+    size_t cursor = large.length() / 2 + 20000;
+    for (size_t i = 0; i < 40000; ++i) {
+        cursor--;
+        BOLT_ASSERT_TRUE(text.erase(cursor, 1));
+    }
+    expected.erase(cursor, 40000);
+    BOLT_ASSERT_EQ(expected, text.toString());
+    BOLT_ASSERT_TRUE(text.chunkCount() <= expected.length() / TextRope::MIN_CHUNK + 2);
+
+    // Forward deletes at the start, then everything that is left
+    for (size_t i = 0; i < 3000; ++i) {
+        BOLT_ASSERT_TRUE(text.erase(0, 1));
+    }
+    expected.erase(0, 3000);
+    BOLT_ASSERT_EQ(expected, text.toString());
+    BOLT_ASSERT_EQ(static_cast<size_t>(std::count(expected.begin(), expected.end(), '\n')) + 1, text.lineCount());
+    BOLT_ASSERT_TRUE(text.chunkCount() <= expected.length() / TextRope::MIN_CHUNK + 2);
+    while (!text.empty()) {
+        BOLT_ASSERT_TRUE(text.erase(text.length() - 1, 1));
+    }
+    BOLT_ASSERT_EQ(0u, text.chunkCount());
+}
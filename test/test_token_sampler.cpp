@@ -0,0 +1,147 @@
+#include "bolt/test_framework.hpp"
+#include "bolt/ai/token_sampler.hpp"
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace bolt::ai;
+
+namespace {
+
+SamplerParams plain_params() {
+    SamplerParams params;
+    params.temperature = 1.0f;
+    params.top_k = 0;
+    params.top_p = 1.0f;
+    params.min_p = 0.0f;
+    params.repeat_penalty = 1.0f;
+    return params;
+}
+
+// Tokens drawn over many steps from the same logits
+std::set<int32_t> drawn(TokenSampler& sampler, const std::vector<float>& logits, int steps) {
+    std::set<int32_t> tokens;
+    for (int i = 0; i < steps; ++i) {
+        std::vector<float> row = logits;
+        tokens.insert(sampler.sample(row.data(), row.size()));
+    }
+    return tokens;
+}
+
+} // namespace
+
+BOLT_TEST(TokenSampler, TopKKeepsTheBestLogits) {
+    // Best tokens are scattered through a large vocabulary
+    std::vector<float> logits(5000, 0.0f);
+    logits[4321] = 5.0f;
+    logits[17] = 4.9f;
+    logits[2500] = 4.8f;
+    logits[9] = 4.7f;
+
+    SamplerParams params = plain_params();
+    params.top_k = 3;
+    TokenSampler sampler(params);
+    BOLT_ASSERT_TRUE((std::set<int32_t>{4321, 17, 2500}) == drawn(sampler, logits, 300));
+
+    params.temperature = 0.0f;
+    sampler.set_params(params);
+    BOLT_ASSERT_TRUE((std::set<int32_t>{4321}) == drawn(sampler, logits, 5));
+}
+
+BOLT_TEST(TokenSampler, MinPAndTopPTrimTheTail) {
+    std::vector<float> logits{3.0f, 2.9f, 0.0f, -1.0f};
+
+    // Min-p 0.5 keeps tokens at least half as likely as the best
+    SamplerParams params = plain_params();
+    params.min_p = 0.5f;
+    TokenSampler sampler(params);
+    BOLT_ASSERT_TRUE((std::set<int32_t>{0, 1}) == drawn(sampler, logits, 300));
+
+    // Probabilities are about 0.7, 0.2, 0.1: top-p 0.6 keeps only the first
+    std::vector<float> skewed{2.0f, 0.75f, 0.05f};
+    params = plain_params();
+    params.top_p = 0.6f;
+    sampler.set_params(params);
+    BOLT_ASSERT_TRUE((std::set<int32_t>{0}) == drawn(sampler, skewed, 100));
+
+    params.top_p = 0.95f;
+    sampler.set_params(params);
+    BOLT_ASSERT_EQ(3u, drawn(sampler, skewed, 500).size());
+}
+
+BOLT_TEST(TokenSampler, PenalizesRecentTokens) {
+    SamplerParams params = plain_params();
+    params.temperature = 0.0f;
+    params.repeat_penalty = 2.0f;
+    params.repeat_last_n = 2;
+    TokenSampler sampler(params);
+
+    std::vector<int32_t> seen{0, 2};
+    sampler.add_history(seen.data(), seen.size());
+    std::vector<float> logits{2.0f, 1.5f, -1.0f};
+    BOLT_ASSERT_EQ(1, sampler.sample(logits.data(), logits.size()));
+    BOLT_ASSERT_EQ(1.0f, logits[0]);
+    BOLT_ASSERT_EQ(-2.0f, logits[2]);
+
+    // Token 1 replaced token 0, the oldest in the window
+    std::vector<float> again{2.0f, 1.5f, -1.0f};
+    BOLT_ASSERT_EQ(0, sampler.sample(again.data(), again.size()));
+}
+
+BOLT_TEST(TokenSampler, SeedMakesSamplingRepeatable) {
+    std::vector<float> logits{1.0f, 0.9f, 0.8f, 0.7f, 0.6f};
+    SamplerParams params = plain_params();
+    params.seed = 42;
+    TokenSampler first(params);
+    TokenSampler second(params);
+    for (int i = 0; i < 50; ++i) {
+        std::vector<float> a = logits;
+        std::vector<float> b = logits;
+        BOLT_ASSERT_EQ(first.sample(a.data(), a.size()), second.sample(b.data(), b.size()));
+    }
+}
+
+BOLT_TEST(TokenSampler, BalancedCodeGrammarTracksBrackets) {
+    BalancedCodeGrammar grammar;
+    grammar.accept("call(a, {");
+    BOLT_ASSERT_EQ(2u, grammar.depth());
+    BOLT_ASSERT_FALSE(grammar.allows(")"));
+    BOLT_ASSERT_TRUE(grammar.allows("})"));
+    BOLT_ASSERT_FALSE(grammar.allows("}))"));
+
+    // Brackets in literals and comments do not count
+    BOLT_ASSERT_TRUE(grammar.allows("\")]\" ')' // ]\n"));
+    BOLT_ASSERT_TRUE(grammar.allows("/* ) */ }"));
+    BOLT_ASSERT_FALSE(grammar.allows("// x\n)"));
+
+    // State carries across pieces, including a comment opener split in two
+    grammar.accept("/");
+    BOLT_ASSERT_TRUE(grammar.allows("/ )"));
+    grammar.accept("* ] */ x = 1'000; }");
+    BOLT_ASSERT_EQ(1u, grammar.depth());
+    BOLT_ASSERT_TRUE(grammar.allows(")"));
+}
+
+BOLT_TEST(TokenSampler, GrammarSteersTheChoice) {
+    std::vector<std::string> pieces{")", "}", "x"};
+    BalancedCodeGrammar grammar;
+    grammar.accept("{");
+
+    SamplerParams params = plain_params();
+    TokenSampler sampler(params);
+    sampler.set_grammar(&grammar, [&](int32_t token) { return pieces[token]; });
+
+    // ")" is far likelier but cannot close "{"
+    std::vector<float> logits{10.0f, 0.0f, -50.0f};
+    BOLT_ASSERT_EQ(1, sampler.sample(logits.data(), logits.size()));
+    BOLT_ASSERT_EQ(0u, grammar.depth());
+
+    // With nothing open, only "x" remains
+    std::vector<float> next{10.0f, 9.0f, -2.0f};
+    BOLT_ASSERT_EQ(2, sampler.sample(next.data(), next.size()));
+
+    // And with no acceptable candidate there is no token
+    pieces[2] = "]";
+    std::vector<float> last{10.0f, 9.0f, -2.0f};
+    BOLT_ASSERT_EQ(-1, sampler.sample(last.data(), last.size()));
+}